@@ -31,8 +31,64 @@ class NotAnArchiveError(TypeError):
 PKG_ITEM_PYMODULE = 'm'  # Python module
 PKG_ITEM_PYSOURCE = 's'  # Python script (v3)
 PKG_ITEM_DATA = 'x'  # data
+PKG_ITEM_LAZY_DATA = 'X'  # data, extracted on demand
 PKG_ITEM_RUNTIME_OPTION = 'o'  # runtime option
 PKG_ITEM_SPLASH = 'l'  # splash resources
+PKG_ITEM_SOLID_BLOCK = 'k'  # solid block - compressed data of multiple small DATA entries
+# Alias - a BINARY or DATA entry whose contents are identical to those of another (canonical) entry; its data fields
+# refer to the data of the canonical entry.
+PKG_ITEM_ALIAS = 'D'
+# Checksum table - CRC-32 checksums of the uncompressed data of all TOC entries, stored as little-endian 32-bit values
+# in the TOC order. This is always the last TOC entry; its own checksum (and those of entries without data) is zero.
+PKG_ITEM_CHECKSUMS = 'c'
+# Filesystem image - uncompressed squashfs image with the contents of the application's top-level directory, which the
+# bootloader of onefile application mounts (or unpacks) instead of extracting individual entries.
+PKG_ITEM_FSIMAGE = 'F'
+
+# Compression methods for CArchive TOC entries (values of compression flag)
+PKG_COMPRESSION_NONE = 0  # uncompressed
+PKG_COMPRESSION_ZLIB = 1  # zlib stream
+PKG_COMPRESSION_ZSTD = 2  # Zstandard frame (requires `zstandard` package)
+PKG_COMPRESSION_LZ4 = 3  # LZ4 frame (requires `lz4` package)
+# Member of a solid block; the entry's offset field holds the data offset of the block (PKG_ITEM_SOLID_BLOCK entry),
+# and its length field holds the offset of the entry's data within the decompressed block.
+PKG_COMPRESSION_SOLID = 4
+# Cold entry; a lazily-extracted DATA entry whose data is stored in a separate cold archive (named by the
+# `pyi-cold-archive` OPTION entry), under the same name. The entry itself has no data.
+PKG_COMPRESSION_COLD = 5
+# Framed entry; the data starts with the frame header (frame size, number of frames, and compression method of the
+# frames), followed by the offsets of the frames (and of the end of data) relative to the start of the data, and by
+# the independently compressed frames, each of which holds `frame size` bytes of the uncompressed data (except for the
+# last one, which can be shorter).
+PKG_COMPRESSION_FRAMED = 6
+
+# Format of the header of framed entry's data (frame size, number of frames, compression method of the frames).
+PKG_FRAME_HEADER_FORMAT = '<IIB7x'
+
+
+def decompress_pkg_data(data, compression_flag):
+    """
+    Decompress the data of CArchive entry, based on its compression flag.
+    """
+    if compression_flag == PKG_COMPRESSION_NONE:
+        return data
+    elif compression_flag == PKG_COMPRESSION_ZLIB:
+        import zlib
+        return zlib.decompress(data)
+    elif compression_flag == PKG_COMPRESSION_ZSTD:
+        import zstandard
+        return zstandard.ZstdDecompressor().decompress(data)
+    elif compression_flag == PKG_COMPRESSION_LZ4:
+        import lz4.frame
+        return lz4.frame.decompress(data)
+    elif compression_flag == PKG_COMPRESSION_FRAMED:
+        header_length = struct.calcsize(PKG_FRAME_HEADER_FORMAT)
+        _, num_frames, frame_compression_flag = struct.unpack_from(PKG_FRAME_HEADER_FORMAT, data)
+        offsets = struct.unpack_from(f'<{num_frames + 1}Q', data, header_length)
+        return b''.join(
+            decompress_pkg_data(data[start:end], frame_compression_flag) for start, end in zip(offsets, offsets[1:])
+        )
+    raise ArchiveReadError(f"Unsupported compression method: {compression_flag}")
 
 
 class CArchiveReader:
@@ -58,6 +114,41 @@ class CArchiveReader:
     _COOKIE_FORMAT = '!8sIIII64s'
     _COOKIE_LENGTH = struct.calcsize(_COOKIE_FORMAT)
 
+    # Cookie of archive format version 2, with 64-bit offsets and little-endian byte order. The field following the
+    # magic pattern holds a marker value that cannot appear as archive length in the version 1 cookie:
+    #
+    # typedef struct _archive_cookie_v2
+    # {
+    #     char magic[8];
+    #     uint32_t marker; /* 0xFFFFFFFF */
+    #     uint32_t format_version;
+    #     uint64_t pkg_length;
+    #     uint64_t toc_offset;
+    #     uint64_t toc_length;
+    #     uint64_t toc_count;
+    #     uint32_t python_version;
+    #     uint32_t reserved;
+    #     char python_libname[64];
+    # } ARCHIVE_COOKIE_V2;
+    #
+    _COOKIE_V2_MARKER = b'\xff\xff\xff\xff'
+
+    _COOKIE_V2_FORMAT = '<8s4sIQQQQII64s'
+    _COOKIE_V2_LENGTH = struct.calcsize(_COOKIE_V2_FORMAT)
+
+    # Optional locator footer at the end of the executable, pointing to the cookie:
+    # typedef struct _archive_locator
+    # {
+    #     char magic[8];
+    #     uint32_t cookie_offset_high;
+    #     uint32_t cookie_offset_low;
+    #     uint32_t cookie_checksum;
+    #     uint32_t checksum;
+    # }
+    _LOCATOR_MAGIC_PATTERN = b'MEI\017\013\012\013\016'
+    _LOCATOR_FORMAT = '!8sIIII'
+    _LOCATOR_LENGTH = struct.calcsize(_LOCATOR_FORMAT)
+
     # TOC entry:
     #
     # typedef struct _toc_entry
@@ -74,6 +165,24 @@ class CArchiveReader:
     _TOC_ENTRY_FORMAT = '!IIIIBc'
     _TOC_ENTRY_LENGTH = struct.calcsize(_TOC_ENTRY_FORMAT)
 
+    # TOC entry of archive format version 2 (fixed-size, little-endian). The entries are followed by the string table
+    # with NUL-terminated names; the position of the name is relative to the start of the entry.
+    #
+    # typedef struct _toc_entry_v2
+    # {
+    #     uint64_t offset;
+    #     uint64_t length;
+    #     uint64_t uncompressed_length;
+    #     uint32_t name_offset;
+    #     uint32_t name_length;
+    #     unsigned char compression_flag;
+    #     char typecode;
+    #     unsigned char reserved[6];
+    # } TOC_ENTRY_V2;
+    #
+    _TOC_ENTRY_V2_FORMAT = '<QQQIIBc6x'
+    _TOC_ENTRY_V2_LENGTH = struct.calcsize(_TOC_ENTRY_V2_FORMAT)
+
     def __init__(self, filename):
         self._filename = filename
         self._start_offset = 0
@@ -81,25 +190,35 @@ def __init__(self, filename):
         self._toc_offset = 0
         self._toc_length = 0
 
+        self.format_version = 1
+
         self.toc = {}
         self.options = []
 
         # Load TOC
         with open(self._filename, "rb") as fp:
             # Find cookie MAGIC pattern
-            cookie_start_offset = self._find_magic_pattern(fp, self._COOKIE_MAGIC_PATTERN)
+            # Try the locator footer first, then fall back to full scan.
+            cookie_start_offset = self._read_locator(fp)
+            if cookie_start_offset == -1:
+                cookie_start_offset = self._find_magic_pattern(fp, self._COOKIE_MAGIC_PATTERN)
             if cookie_start_offset == -1:
                 raise ArchiveReadError("Could not find COOKIE magic pattern!")
 
             # Read the whole cookie
-            fp.seek(cookie_start_offset, os.SEEK_SET)
-            cookie_data = fp.read(self._COOKIE_LENGTH)
-
-            magic, archive_length, toc_offset, toc_length, pyvers, pylib_name = \
-                struct.unpack(self._COOKIE_FORMAT, cookie_data)
+            cookie_data = self._read_cookie(fp, cookie_start_offset)
+            if cookie_data[8:12] == self._COOKIE_V2_MARKER:
+                magic, _, self.format_version, archive_length, toc_offset, toc_length, toc_count, pyvers, _, \
+                    pylib_name = struct.unpack(self._COOKIE_V2_FORMAT, cookie_data)
+                if self.format_version != 2:
+                    raise ArchiveReadError(f"Unsupported archive format version {self.format_version}!")
+            else:
+                magic, archive_length, toc_offset, toc_length, pyvers, pylib_name = \
+                    struct.unpack(self._COOKIE_FORMAT, cookie_data)
+                toc_count = None
 
             # Compute start and end offset of the the archive
-            self._end_offset = cookie_start_offset + self._COOKIE_LENGTH
+            self._end_offset = cookie_start_offset + len(cookie_data)
             self._start_offset = self._end_offset - archive_length
 
             # Verify that Python shared library name is set
@@ -110,7 +229,50 @@ def __init__(self, filename):
             fp.seek(self._start_offset + toc_offset)
             toc_data = fp.read(toc_length)
 
-            self.toc, self.options = self._parse_toc(toc_data)
+            if self.format_version == 2:
+                self.toc, self.options = self._parse_toc_v2(toc_data, toc_count)
+            else:
+                self.toc, self.options = self._parse_toc(toc_data)
+
+    @classmethod
+    def _read_cookie(cls, fp, cookie_offset):
+        """
+        Read the raw data of the cookie (of either format version) at the given offset.
+        """
+        fp.seek(cookie_offset, os.SEEK_SET)
+        cookie_data = fp.read(cls._COOKIE_LENGTH)
+        if cookie_data[8:12] == cls._COOKIE_V2_MARKER:
+            cookie_data += fp.read(cls._COOKIE_V2_LENGTH - cls._COOKIE_LENGTH)
+        return cookie_data
+
+    @classmethod
+    def _read_locator(cls, fp):
+        """
+        Read and validate the locator footer at the end of the file. Returns the offset of the cookie, or -1 if valid
+        locator is not available.
+        """
+        import zlib
+
+        fp.seek(0, os.SEEK_END)
+        file_size = fp.tell()
+        if file_size < cls._LOCATOR_LENGTH + cls._COOKIE_LENGTH:
+            return -1
+
+        fp.seek(file_size - cls._LOCATOR_LENGTH, os.SEEK_SET)
+        locator_data = fp.read(cls._LOCATOR_LENGTH)
+        magic, offset_high, offset_low, cookie_checksum, checksum = struct.unpack(cls._LOCATOR_FORMAT, locator_data)
+        if magic != cls._LOCATOR_MAGIC_PATTERN or checksum != zlib.crc32(locator_data[:-4]):
+            return -1
+
+        cookie_offset = (offset_high << 32) | offset_low
+        if cookie_offset > file_size - cls._LOCATOR_LENGTH - cls._COOKIE_LENGTH:
+            return -1
+
+        cookie_data = cls._read_cookie(fp, cookie_offset)
+        if not cookie_data.startswith(cls._COOKIE_MAGIC_PATTERN) or zlib.crc32(cookie_data) != cookie_checksum:
+            return -1
+
+        return cookie_offset
 
     @staticmethod
     def _find_magic_pattern(fp, magic_pattern):
@@ -167,6 +329,27 @@ def _parse_toc(cls, data):
 
         return toc, options
 
+    @classmethod
+    def _parse_toc_v2(cls, data, count):
+        options = []
+        toc = {}
+        for idx in range(count):
+            entry_pos = idx * cls._TOC_ENTRY_V2_LENGTH
+            entry_offset, data_length, uncompressed_length, name_offset, name_length, compression_flag, typecode = \
+                struct.unpack_from(cls._TOC_ENTRY_V2_FORMAT, data, entry_pos)
+            name_pos = entry_pos + name_offset
+            name = data[name_pos:(name_pos + name_length)].decode('utf-8')
+
+            typecode = typecode.decode('ascii')
+
+            # Same as with version 1 TOC, keep OPTION entries in a separate list.
+            if typecode == 'o':
+                options.append(name)
+            else:
+                toc[name] = (entry_offset, data_length, uncompressed_length, compression_flag, typecode)
+
+        return toc, options
+
     def extract(self, name):
         """
         Extract data for the given entry name.
@@ -177,15 +360,72 @@ def extract(self, name):
             raise KeyError(f"No entry named {name!r} found in the archive!")
 
         entry_offset, data_length, uncompressed_length, compression_flag, typecode = entry
+        if compression_flag == PKG_COMPRESSION_COLD:
+            raise ArchiveReadError(f"Data of entry {name!r} is stored in the cold archive!")
+        if compression_flag == PKG_COMPRESSION_SOLID:
+            block_data = self._extract_solid_block(entry_offset)
+            return block_data[data_length:(data_length + uncompressed_length)]
+
         with open(self._filename, "rb") as fp:
             fp.seek(self._start_offset + entry_offset, os.SEEK_SET)
             data = fp.read(data_length)
 
-        if compression_flag:
-            import zlib
-            data = zlib.decompress(data)
+        return decompress_pkg_data(data, compression_flag)
 
-        return data
+    def _extract_solid_block(self, block_offset):
+        """
+        Extract the decompressed data of the solid block whose data starts at the given offset.
+        """
+        for entry_offset, data_length, uncompressed_length, compression_flag, typecode in self.toc.values():
+            if typecode == PKG_ITEM_SOLID_BLOCK and entry_offset == block_offset:
+                break
+        else:
+            raise ArchiveReadError(f"No solid block found at offset {block_offset}!")
+
+        with open(self._filename, "rb") as fp:
+            fp.seek(self._start_offset + entry_offset, os.SEEK_SET)
+            data = fp.read(data_length)
+
+        return decompress_pkg_data(data, compression_flag)
+
+    def extract_range(self, name, offset, length):
+        """
+        Extract the given range of the (uncompressed) data of the given entry. For framed entries, only the frames
+        that cover the range are read and decompressed, same as in the bootloader's `pyi_archive_read_range()`.
+        """
+
+        entry = self.toc.get(name)
+        if entry is None:
+            raise KeyError(f"No entry named {name!r} found in the archive!")
+
+        entry_offset, data_length, uncompressed_length, compression_flag, typecode = entry
+        if offset < 0 or length < 0 or offset + length > uncompressed_length:
+            raise ValueError(f"Requested range exceeds the data of entry {name!r}!")
+        if compression_flag != PKG_COMPRESSION_FRAMED:
+            return self.extract(name)[offset:(offset + length)]
+        if length == 0:
+            return b''
+
+        with open(self._filename, "rb") as fp:
+            fp.seek(self._start_offset + entry_offset, os.SEEK_SET)
+            header = fp.read(struct.calcsize(PKG_FRAME_HEADER_FORMAT))
+            frame_size, num_frames, frame_compression_flag = struct.unpack(PKG_FRAME_HEADER_FORMAT, header)
+            offsets = struct.unpack(f'<{num_frames + 1}Q', fp.read((num_frames + 1) * 8))
+
+            # Read and decompress the frames that cover the range.
+            first_frame = offset // frame_size
+            last_frame = (offset + length - 1) // frame_size
+            fp.seek(self._start_offset + entry_offset + offsets[first_frame], os.SEEK_SET)
+            frames_data = fp.read(offsets[last_frame + 1] - offsets[first_frame])
+
+        data = b''.join(
+            decompress_pkg_data(
+                frames_data[(start - offsets[first_frame]):(end - offsets[first_frame])],
+                frame_compression_flag,
+            ) for start, end in zip(offsets[first_frame:last_frame + 1], offsets[first_frame + 1:last_frame + 2])
+        )
+        range_offset = offset - first_frame * frame_size
+        return data[range_offset:(range_offset + length)]
 
     def raw_pkg_data(self):
         """
@@ -12,16 +12,31 @@
 Utilities to create data structures for embedding Python modules and additional files into the executable.
 """
 
+import collections
+import concurrent.futures
+import functools
+import hashlib
 import marshal
 import os
 import shutil
 import struct
 import sys
+import tempfile
+import threading
+import time
 import zlib
 
+from PyInstaller import log as logging
 from PyInstaller.building.utils import get_code_object, replace_filename_in_code_object
+from PyInstaller.archive.readers import PKG_COMPRESSION_COLD, PKG_COMPRESSION_FRAMED, PKG_COMPRESSION_LZ4, \
+    PKG_COMPRESSION_NONE, PKG_COMPRESSION_SOLID, PKG_COMPRESSION_ZLIB, PKG_COMPRESSION_ZSTD, PKG_FRAME_HEADER_FORMAT, \
+    PKG_ITEM_ALIAS, PKG_ITEM_CHECKSUMS, PKG_ITEM_SOLID_BLOCK
 from PyInstaller.compat import BYTECODE_MAGIC, is_win, strict_collect_mode
-from PyInstaller.loader.pyimod01_archive import PYZ_ITEM_MODULE, PYZ_ITEM_NSPKG, PYZ_ITEM_PKG
+from PyInstaller.loader.pyimod01_archive import PYZ_ITEM_MODULE, PYZ_ITEM_NSPKG, PYZ_ITEM_PKG, ZlibArchiveReader, \
+    ZlibArchiveTOC, build_pyz_prefix_tree
+from PyInstaller.utils import misc
+
+logger = logging.getLogger(__name__)
 
 
 class ZlibArchiveWriter:
@@ -31,9 +46,19 @@ class ZlibArchiveWriter:
     """
     _PYZ_MAGIC_PATTERN = b'PYZ\0'
     _HEADER_LENGTH = 12 + 5
+    _FORMAT_VERSION = 2
     _COMPRESSION_LEVEL = 6  # zlib compression level
 
-    def __init__(self, filename, entries, code_dict=None):
+    def __init__(
+        self,
+        filename,
+        entries,
+        code_dict=None,
+        compression_dictionary=False,
+        access_order=None,
+        compression_workers=None,
+        cache=None,
+    ):
         """
         filename
             Target filename of the archive.
@@ -43,37 +68,125 @@ def __init__(self, filename, entries, code_dict=None):
             file from which the resource is read, and `typecode` is the Analysis-level TOC typecode (`PYMODULE`).
         code_dict
             Optional code dictionary containing code objects for analyzed/collected python modules.
+        compression_dictionary
+            If enabled, a preset compression dictionary is trained over the serialized code objects, stored in the
+            archive, and used for compression of all entries. This improves compression ratio of small modules, which
+            make up the majority of entries.
+        access_order
+            Optional list of entry names in the order in which they were first accessed during a recorded run of the
+            application (see `PyInstaller.building.utils.load_access_profile`). The data of listed entries is placed
+            at the start of the archive in that order, followed by the remaining entries in their original order. The
+            length of this hot prefix is stored in the TOC header.
+        compression_workers
+            Optional number of threads that compress the entries in parallel; defaults to the number of CPU cores. The
+            contents of the archive do not depend on the number of threads.
+        cache
+            Optional `CompressionCache`, from which the compressed data of the entries whose code objects did not
+            change since the previous build is re-used.
         """
         code_dict = code_dict or {}
 
+        # Serialize entries' code objects
+        serialized_entries = [self._serialize_entry(entry, code_dict) for entry in entries]
+
+        # Lay out the entries in the order of their first access, if available. The sort is stable, so the entries that
+        # were not accessed retain their original order.
+        num_hot_entries = 0
+        if access_order:
+            access_rank = {name: rank for rank, name in enumerate(access_order)}
+            num_entries = len(serialized_entries)
+            serialized_entries.sort(key=lambda entry: access_rank.get(entry[0], num_entries))
+            num_hot_entries = sum(1 for name, *_ in serialized_entries if name in access_rank)
+
+        zdict = b''
+        if compression_dictionary:
+            zdict = _train_compression_dictionary([data for _, _, data in serialized_entries if data is not None])
+
         with open(filename, "wb") as fp:
             # Reserve space for the header.
             fp.write(b'\0' * self._HEADER_LENGTH)
 
-            # Write entries' data and collect TOC entries
+            # The compression dictionary (if any) immediately follows the header.
+            fp.write(zdict)
+
+            # Write entries' data and collect TOC entries. The entries are compressed by the worker threads, and
+            # written in their original order.
             toc = []
-            for entry in entries:
-                toc_entry = self._write_entry(fp, entry, code_dict)
+            hot_length = 0
+            compressed_entries = _map_in_order(
+                functools.partial(self._compress_entry, zdict=zdict, cache=cache),
+                [data for _, _, data in serialized_entries],
+                compression_workers,
+            )
+            for idx, ((name, typecode, _), obj) in enumerate(zip(serialized_entries, compressed_entries)):
+                toc_entry = self._write_entry(fp, name, typecode, obj)
                 toc.append(toc_entry)
+                if idx < num_hot_entries:
+                    hot_length = fp.tell()
 
             # Write TOC
             toc_offset = fp.tell()
-            toc_data = marshal.dumps(toc)
+            toc_data = self._serialize_toc(toc, hot_length)
             fp.write(toc_data)
 
             # Write header:
             #  - PYZ magic pattern (4 bytes)
             #  - python bytecode magic pattern (4 bytes)
             #  - TOC offset (32-bit int, 4 bytes)
-            #  - 4 unused bytes
+            #  - archive format version (8-bit int, 1 byte)
+            #  - length of compression dictionary (32-bit int, 4 bytes); zero if dictionary is not used
             fp.seek(0, os.SEEK_SET)
 
             fp.write(self._PYZ_MAGIC_PATTERN)
             fp.write(BYTECODE_MAGIC)
-            fp.write(struct.pack('!i', toc_offset))
+            fp.write(struct.pack('!iBI', toc_offset, self._FORMAT_VERSION, len(zdict)))
 
-    @classmethod
-    def _write_entry(cls, fp, entry, code_dict):
+        if cache is not None:
+            cache.save()
+
+    @staticmethod
+    def _serialize_toc(toc, hot_length):
+        """
+        Serialize the TOC in the format that is searched in place by the run-time reader (see
+        `PyInstaller.loader.pyimod01_archive.ZlibArchiveTOC`): header, array of records sorted by UTF-8 encoded entry
+        names, name table, and marshaled prefix tree. The header also stores the length of the archive's hot prefix.
+        """
+        entries = sorted(((name.encode('utf-8'), entry_data) for name, entry_data in toc), key=lambda entry: entry[0])
+
+        records = []
+        names = []
+        name_offset = 0
+        for encoded_name, (typecode, entry_offset, entry_length) in entries:
+            records.append(
+                struct.pack(
+                    ZlibArchiveTOC.RECORD_FORMAT,
+                    name_offset,
+                    len(encoded_name),
+                    typecode,
+                    entry_offset,
+                    entry_length,
+                )
+            )
+            names.append(encoded_name)
+            name_offset += len(encoded_name)
+
+        tree_data = marshal.dumps(build_pyz_prefix_tree((name, entry_data[0]) for name, entry_data in toc))
+
+        names_offset = ZlibArchiveTOC.HEADER_LENGTH + len(records) * ZlibArchiveTOC.RECORD_LENGTH
+        tree_offset = names_offset + name_offset
+        header = struct.pack(
+            ZlibArchiveTOC.HEADER_FORMAT,
+            len(records),
+            names_offset,
+            tree_offset,
+            len(tree_data),
+            hot_length,
+        )
+
+        return header + b''.join(records) + b''.join(names) + tree_data
+
+    @staticmethod
+    def _serialize_entry(entry, code_dict):
         name, src_path, typecode = entry
         assert typecode in {'PYMODULE', 'PYMODULE-1', 'PYMODULE-2'}
 
@@ -81,7 +194,7 @@ def _write_entry(cls, fp, entry, code_dict):
             # PEP-420 namespace package; these do not have code objects, but we still need an entry in PYZ to inform our
             # run-time module finder/loader of the package's existence. So create a TOC entry for 0-byte data blob,
             # and write no data.
-            return (name, (PYZ_ITEM_NSPKG, fp.tell(), 0))
+            return (name, PYZ_ITEM_NSPKG, None)
 
         code_object = code_dict[name]
 
@@ -97,10 +210,37 @@ def _write_entry(cls, fp, entry, code_dict):
         code_object = replace_filename_in_code_object(code_object, co_filename)
 
         # Serialize
-        data = marshal.dumps(code_object)
+        return (name, typecode, marshal.dumps(code_object))
 
-        # First compress, then encrypt.
-        obj = zlib.compress(data, cls._COMPRESSION_LEVEL)
+    @classmethod
+    def _compress_entry(cls, data, zdict, cache):
+        if data is None:
+            return None
+
+        # Look up the compressed data in cache; the key includes the digest of the preset dictionary.
+        if cache is not None:
+            cache_params = ('pyz', cls._COMPRESSION_LEVEL, hashlib.sha256(zdict).hexdigest() if zdict else None)
+            cache_digests = [hashlib.sha256(data).hexdigest()]
+            cached = cache.load(cache_params, cache_digests)
+            if cached is not None:
+                return cached[1]
+
+        # Compress, using the preset dictionary if available.
+        if zdict:
+            compressor = zlib.compressobj(cls._COMPRESSION_LEVEL, zdict=zdict)
+            obj = compressor.compress(data) + compressor.flush()
+        else:
+            obj = zlib.compress(data, cls._COMPRESSION_LEVEL)
+
+        if cache is not None:
+            cache.store(cache_params, cache_digests, len(data), obj)
+
+        return obj
+
+    @staticmethod
+    def _write_entry(fp, name, typecode, obj):
+        if obj is None:
+            return (name, (typecode, fp.tell(), 0))
 
         # Create TOC entry
         toc_entry = (name, (typecode, fp.tell(), len(obj)))
@@ -111,6 +251,320 @@ def _write_entry(cls, fp, entry, code_dict):
         return toc_entry
 
 
+def _map_in_order(function, items, num_workers=None):
+    """
+    Apply the function to the items in a pool of `num_workers` threads (by default, one per CPU core), and yield the
+    results in the order of the items. This is used to compress the archive entries in parallel (zlib and the other
+    compression libraries release the GIL), while writing them in a deterministic order. To bound the memory taken by
+    the pending results, only up to twice as many items as there are workers are processed ahead of the consumer.
+    With a single worker, the items are processed in the calling thread.
+    """
+    if num_workers is None:
+        num_workers = os.cpu_count() or 1
+
+    if num_workers <= 1:
+        for item in items:
+            yield function(item)
+        return
+
+    with concurrent.futures.ThreadPoolExecutor(max_workers=num_workers) as executor:
+        pending = collections.deque()
+        for item in items:
+            if len(pending) >= 2 * num_workers:
+                yield pending.popleft().result()
+            pending.append(executor.submit(function, item))
+        while pending:
+            yield pending.popleft().result()
+
+
+class CompressionCache:
+    """
+    On-disk cache of compressed data blobs, which allows the archive writers to re-use the compressed data of entries
+    that did not change since the previous build, instead of compressing them again.
+
+    Each blob is stored in its own file, under a key that is derived from the digests of the uncompressed data and from
+    the compression parameters. To avoid reading and hashing all source files on every build, the index keeps the
+    digest of each source file, along with its size and modification time. As the blobs are content-addressed, the
+    cache can be shared by all builds; use `pyinstaller --clean` to remove it, or `--no-compression-cache` to disable
+    it. The cache is safe to use from multiple threads.
+
+    The modification time of a blob is updated whenever the blob is used; when the index is saved, the blobs that were
+    not used for `max_age` seconds are removed, and then the least recently used blobs are removed until the total
+    size of the blobs is at most `max_size` bytes.
+    """
+
+    # Part of the blob key; increase whenever the format of the cached data changes.
+    _CACHE_VERSION = 2
+
+    # Default limits of the blob eviction.
+    _MAX_SIZE = 2 * 1024 * 1024 * 1024
+    _MAX_AGE = 30 * 24 * 60 * 60
+
+    def __init__(self, cache_dir, max_size=_MAX_SIZE, max_age=_MAX_AGE):
+        self._cache_dir = cache_dir
+        self._max_size = max_size
+        self._max_age = max_age
+        self._index_file = os.path.join(cache_dir, 'index.dat')
+        self._lock = threading.Lock()
+        self._index_modified = False
+        self._blobs_stored = False
+
+        self.num_hits = 0
+        self.num_misses = 0
+
+        # The cache is only an optimization; start afresh if its index is unavailable or corrupted.
+        try:
+            self._index = misc.load_py_data_struct(self._index_file)
+        except FileNotFoundError:
+            self._index = {}
+        except Exception:
+            logger.warning("Compression cache index %r is corrupted; ignoring it.", self._index_file)
+            self._index = {}
+
+    def get_file_digest(self, filename):
+        """
+        Return the digest of the file's contents from the index, or None if the file is not in the index or if its size
+        or modification time changed.
+        """
+        stat = os.stat(filename)
+        with self._lock:
+            entry = self._index.get(os.path.normcase(os.path.abspath(filename)))
+        if entry is None or entry[:2] != (stat.st_size, stat.st_mtime_ns):
+            return None
+        return entry[2]
+
+    def read_file(self, filename):
+        """
+        Read the contents of the file, and record their digest in the index. Returns tuple (data, digest). Used for the
+        files whose contents are needed anyway; to only compute the digest, use `hash_file`.
+        """
+        stat = os.stat(filename)  # Before reading; if the file is modified while it is being read, the entry is stale.
+        with open(filename, 'rb') as fp:
+            data = fp.read()
+        digest = hashlib.sha256(data).hexdigest()
+        with self._lock:
+            self._index[os.path.normcase(os.path.abspath(filename))] = (stat.st_size, stat.st_mtime_ns, digest)
+            self._index_modified = True
+        return data, digest
+
+    def hash_file(self, filename):
+        """
+        Compute the digest of the file's contents, reading it in chunks, and record it in the index. Returns the digest.
+        """
+        stat = os.stat(filename)  # Before reading; if the file is modified while it is being read, the entry is stale.
+        digest = _hash_file(filename)
+        with self._lock:
+            self._index[os.path.normcase(os.path.abspath(filename))] = (stat.st_size, stat.st_mtime_ns, digest)
+            self._index_modified = True
+        return digest
+
+    def _get_blob_filename(self, params, digests):
+        key = hashlib.sha256(repr((self._CACHE_VERSION, params, digests)).encode('utf-8')).hexdigest()
+        return os.path.join(self._cache_dir, key[:2], key[2:])
+
+    def load(self, params, digests):
+        """
+        Look up the blob for the data with given digests and compression parameters. Returns tuple
+        (data_length, compressed_data, checksums), or None if the blob is not available; `checksums` is the tuple of
+        CRC-32 checksums that were stored along with the blob.
+        """
+        blob = self.open_blob(params, digests)
+        if blob is None:
+            return None
+        data_length, fp, checksums = blob
+        with fp:
+            return data_length, fp.read(), checksums
+
+    def open_blob(self, params, digests):
+        """
+        Same as `load`, except that instead of the compressed data, the blob file is returned as an open file object,
+        positioned at the start of the compressed data; the caller is responsible for closing it. This allows copying
+        the blobs of large files without reading them into memory.
+        """
+        fp = None
+        try:
+            fp = open(self._get_blob_filename(params, digests), 'rb')
+            header = fp.read(12)
+            data_length, num_checksums = struct.unpack('<QI', header)
+            checksums_data = fp.read(4 * num_checksums)
+            checksums = struct.unpack(f'<{num_checksums}I', checksums_data)
+        except (OSError, struct.error):
+            if fp is not None:
+                fp.close()
+            with self._lock:
+                self.num_misses += 1
+            return None
+        with self._lock:
+            self.num_hits += 1
+
+        # Mark the blob as recently used, for the eviction in `save`.
+        try:
+            os.utime(fp.name)
+        except OSError:
+            pass
+
+        return data_length, fp, checksums
+
+    def store(self, params, digests, data_length, compressed_data, checksums=()):
+        """
+        Store the blob for the data with given digests and compression parameters; `compressed_data` is either bytes,
+        or a file object, whose whole contents are copied. The blob is written into temporary file first, so that
+        concurrent builds never observe a partially-written blob. Failure to store the blob is not an error.
+        """
+        blob_filename = self._get_blob_filename(params, digests)
+        tmp_filename = f"{blob_filename}.{os.getpid()}-{threading.get_ident()}.tmp"
+        try:
+            os.makedirs(os.path.dirname(blob_filename), exist_ok=True)
+            with open(tmp_filename, 'wb') as fp:
+                fp.write(struct.pack(f'<QI{len(checksums)}I', data_length, len(checksums), *checksums))
+                if isinstance(compressed_data, bytes):
+                    fp.write(compressed_data)
+                else:
+                    compressed_data.seek(0, os.SEEK_SET)
+                    shutil.copyfileobj(compressed_data, fp)
+            os.replace(tmp_filename, blob_filename)
+            self._blobs_stored = True
+        except OSError as e:
+            logger.debug("Failed to store blob in compression cache: %s", e)
+
+    def save(self):
+        """
+        Save the index of file digests, if it was modified, and evict the old blobs, if new blobs were stored.
+        """
+        with self._lock:
+            index_modified = self._index_modified
+            blobs_stored = self._blobs_stored
+            index = dict(self._index)
+            self._index_modified = False
+            self._blobs_stored = False
+
+        if index_modified:
+            # Drop the entries of source files that no longer exist, so that the index does not grow without bounds.
+            index = {filename: entry for filename, entry in index.items() if os.path.exists(filename)}
+            try:
+                misc.save_py_data_struct(self._index_file, index)
+            except OSError as e:
+                logger.debug("Failed to save compression cache index: %s", e)
+
+        if blobs_stored:
+            self._evict_blobs()
+
+    def _evict_blobs(self):
+        """
+        Remove the blobs that exceed the age and size limits of the cache, least recently used first. The blobs that are
+        still being written (or that cannot be removed) are skipped; failure to remove a blob is not an error.
+        """
+        blobs = []
+        try:
+            with os.scandir(self._cache_dir) as it:
+                subdirs = [entry.path for entry in it if entry.is_dir() and len(entry.name) == 2]
+            for subdir in subdirs:
+                with os.scandir(subdir) as it:
+                    for entry in it:
+                        if entry.name.endswith('.tmp') or not entry.is_file():
+                            continue
+                        stat = entry.stat()
+                        blobs.append((stat.st_mtime, stat.st_size, entry.path))
+        except OSError as e:
+            logger.debug("Failed to scan compression cache: %s", e)
+            return
+
+        blobs.sort()  # Oldest first.
+        total_size = sum(size for _, size, _ in blobs)
+        min_mtime = time.time() - self._max_age
+        num_removed = 0
+        for mtime, size, path in blobs:
+            if mtime >= min_mtime and total_size <= self._max_size:
+                break
+            try:
+                os.remove(path)
+            except OSError:
+                continue
+            total_size -= size
+            num_removed += 1
+
+        if num_removed:
+            logger.debug("Removed %d old blobs from compression cache; %d bytes remain.", num_removed, total_size)
+
+
+def _train_compression_dictionary(samples, dictionary_size=32 * 1024, segment_length=256, kmer_length=8):
+    """
+    Train a preset compression dictionary for zlib from the given list of samples (serialized code objects).
+
+    zlib does not provide dictionary training, so this implements a simplified variant of the COVER algorithm that is
+    used by zstd: the sample data is divided into epochs, one for each dictionary segment, and from each epoch, the
+    segment whose k-mers (substrings of length `kmer_length`) occur in most samples is selected. The k-mers of selected
+    segment do not count towards the score of subsequent segments. The segments are ordered by ascending score, so that
+    the most useful ones end up at the end of dictionary, which is closest to (and therefore cheapest to reference
+    from) the compressed data.
+
+    The training is deterministic, and to keep its run-time bounded, only up to 1 MiB of evenly-spaced samples is used.
+    """
+    max_sample_data = 1024 * 1024
+
+    # Select samples; skip the ones that are too short to contain a full segment.
+    samples = [sample for sample in samples if len(sample) >= segment_length]
+    total_length = sum(len(sample) for sample in samples)
+    if total_length > max_sample_data:
+        step = total_length / max_sample_data
+        samples = [samples[int(idx * step)] for idx in range(int(len(samples) / step))]
+    if not samples:
+        return b''
+
+    # Count the number of samples in which each k-mer occurs.
+    frequencies = {}
+    for sample in samples:
+        for kmer in {sample[pos:pos + kmer_length] for pos in range(len(sample) - kmer_length + 1)}:
+            frequencies[kmer] = frequencies.get(kmer, 0) + 1
+    frequencies = {kmer: count for kmer, count in frequencies.items() if count > 1}
+
+    data = b''.join(samples)
+    num_segments = dictionary_size // segment_length
+    epoch_length = max(len(data) // num_segments, segment_length)
+
+    segments = []
+    for epoch_start in range(0, len(data) - segment_length + 1, epoch_length):
+        epoch_end = min(epoch_start + epoch_length, len(data))
+
+        # Slide the segment-sized window over the epoch, and find the position with the highest score (the sum of
+        # frequencies of distinct k-mers in the window). K-mers that occur in only one sample were removed from the
+        # frequency table, and do not contribute.
+        window = {}
+        score = 0
+        best_score = 0
+        best_start = epoch_start
+        for pos in range(epoch_start, epoch_end - kmer_length + 1):
+            kmer = data[pos:pos + kmer_length]
+            count = window.get(kmer, 0)
+            if count == 0:
+                score += frequencies.get(kmer, 0)
+            window[kmer] = count + 1
+
+            start = pos + kmer_length - segment_length
+            if start > epoch_start:
+                old_kmer = data[start - 1:start - 1 + kmer_length]
+                count = window[old_kmer] - 1
+                if count == 0:
+                    del window[old_kmer]
+                    score -= frequencies.get(old_kmer, 0)
+                else:
+                    window[old_kmer] = count
+            if start >= epoch_start and score > best_score:
+                best_score = score
+                best_start = start
+
+        if best_score == 0:
+            continue
+
+        segment = data[best_start:best_start + segment_length]
+        for pos in range(segment_length - kmer_length + 1):
+            frequencies[segment[pos:pos + kmer_length]] = 0
+        segments.append((best_score, len(segments), segment))
+
+    segments.sort()
+    return b''.join(segment for *_, segment in segments)[-dictionary_size:]
+
+
 class CArchiveWriter:
     """
     Writer for PyInstaller's CArchive (PKG) archive.
@@ -129,9 +583,64 @@ class CArchiveWriter:
     _TOC_ENTRY_FORMAT = '!IIIIBc'
     _TOC_ENTRY_LENGTH = struct.calcsize(_TOC_ENTRY_FORMAT)
 
-    _COMPRESSION_LEVEL = 9  # zlib compression level
+    # Archive format version 2 (64-bit offsets, fixed-size TOC entries followed by string table).
+    _COOKIE_V2_MARKER = b'\xff\xff\xff\xff'
+    _COOKIE_V2_FORMAT = '<8s4sIQQQQII64s'
+    _COOKIE_V2_LENGTH = struct.calcsize(_COOKIE_V2_FORMAT)
 
-    def __init__(self, filename, entries, pylib_name):
+    _TOC_ENTRY_V2_FORMAT = '<QQQIIBc6x'
+    _TOC_ENTRY_V2_LENGTH = struct.calcsize(_TOC_ENTRY_V2_FORMAT)
+
+    # Supported archive format versions.
+    FORMAT_VERSIONS = (1, 2)
+
+    _COMPRESSION_LEVEL = 9  # zlib compression level
+    _ZSTD_COMPRESSION_LEVEL = 19  # zstd compression level (maximum ratio, without --ultra levels)
+    _LZ4_COMPRESSION_LEVEL = 12  # lz4 (HC) compression level; does not affect decompression speed
+
+    # Maximal size of DATA entries that are eligible for solid blocks. Larger entries are compressed well enough on
+    # their own; also, the bootloader needs to keep the whole decompressed block in memory.
+    _SOLID_MEMBER_MAX_SIZE = 64 * 1024
+
+    # Maximal frame size of framed entries; the bootloader refuses entries with larger frames.
+    _FRAME_SIZE_MAX = 64 * 1024 * 1024
+
+    # Compressed source files larger than this are not read into memory; they are compressed in chunks of the given
+    # size into a temporary file, from which the compressed data is copied into the archive. This way, the memory taken
+    # by the jobs that are processed ahead of the writer does not depend on the size of the largest files.
+    _STREAMING_THRESHOLD = 16 * 1024 * 1024
+    _STREAMING_CHUNK_SIZE = 1024 * 1024
+
+    # Supported compression codecs and their compression flag values.
+    CODECS = {
+        'zlib': PKG_COMPRESSION_ZLIB,
+        'zstd': PKG_COMPRESSION_ZSTD,
+        'lz4': PKG_COMPRESSION_LZ4,
+    }
+
+    # Compression levels by compression flag; part of the compression cache key.
+    _COMPRESSION_LEVELS = {
+        PKG_COMPRESSION_ZLIB: _COMPRESSION_LEVEL,
+        PKG_COMPRESSION_ZSTD: _ZSTD_COMPRESSION_LEVEL,
+        PKG_COMPRESSION_LZ4: _LZ4_COMPRESSION_LEVEL,
+    }
+
+    def __init__(
+        self,
+        filename,
+        entries,
+        pylib_name,
+        codecs=None,
+        format_version=None,
+        access_order=None,
+        solid_block_size=None,
+        deduplicate=False,
+        compression_workers=None,
+        cache=None,
+        checksums=False,
+        cold_entries=None,
+        frame_size=None,
+    ):
         """
         filename
             Target filename of the archive.
@@ -142,46 +651,353 @@ def __init__(self, filename, entries, pylib_name):
             boolean compression flag, and `typecode` is the Analysis-level TOC typecode.
         pylib_name
             Name of the python shared library.
+        codecs
+            Optional dictionary mapping CArchive typecodes to names of compression codecs ('zlib', 'zstd', or 'lz4')
+            that are used for entries with enabled compression; for example, ``{'b': 'lz4', 'x': 'zstd'}``. Entries
+            with typecodes not listed in the dictionary use 'zlib'. Decoding of 'zstd' and 'lz4' entries requires the
+            bootloader to be built with the corresponding library.
+        format_version
+            Archive format version; 1 (32-bit offsets, supported by all bootloader versions) or 2 (64-bit offsets and
+            fixed-size TOC entries that the bootloader can use directly from the memory-mapped executable). If not
+            specified, version 1 is used unless the archive exceeds its 4 GB limit.
+        access_order
+            Optional list of entry names in the order in which their data was first accessed during a recorded run of
+            the application (see `PyInstaller.building.utils.load_access_profile`). The data of listed entries is
+            placed at the start of the archive in that order, followed by the data of remaining entries; the order
+            of TOC entries is not affected. The length of this hot prefix is stored in the `pyi-hot-prefix-length`
+            OPTION entry, so that the bootloader can request its read-ahead at startup.
+        solid_block_size
+            Optional target size (in bytes) of solid blocks. If specified, consecutive small compressed DATA entries
+            are compressed together, as a single stream of up to approximately the given size, which improves the
+            compression ratio for large numbers of small files, and allows the bootloader to extract all members of
+            a block with a single decompression pass. The block is stored as a separate entry, and the TOC entries of
+            its members refer to their data within it. Requires a bootloader built from this version of sources.
+        deduplicate
+            If True, the data of BINARY and DATA entries whose contents are identical to those of an entry that precedes
+            them in write order (and has the same typecode) is not written again; instead, they are stored as ALIAS
+            entries, whose data fields refer to the data of that (canonical) entry. The bootloader creates their files
+            by cloning the extracted file of the canonical entry. Requires a bootloader built from this version of
+            sources.
+        compression_workers
+            Optional number of threads that read and compress the entries' data in parallel; defaults to the number of
+            CPU cores. The data is written in the same order regardless of the number of threads, so the contents of
+            the archive do not depend on it.
+        cache
+            Optional `CompressionCache`, from which the compressed data of the entries whose source files did not
+            change since the previous build is re-used.
+        checksums
+            If True, the CRC-32 checksums of the uncompressed data of all entries are stored in a checksum table entry
+            at the end of the TOC, which allows the bootloader to verify the extracted data, and to validate the
+            contents of the extraction cache. Requires a bootloader built from this version of sources.
+        cold_entries
+            Optional collection of destination names of lazily-extracted DATA entries ('X') whose data is stored in a
+            separate cold archive (see `PKG`). They are written as entries without data, with PKG_COMPRESSION_COLD
+            compression flag, so that the bootloader can look them up in this archive, and extract their data from the
+            cold archive. Requires a bootloader built from this version of sources.
+        frame_size
+            Optional frame size (in bytes). If specified, the compressed DATA entries whose data is larger than the
+            frame size are written as framed entries: their data is split into frames of the given (uncompressed)
+            size, which are compressed independently, and preceded by the index of the frames. This allows the
+            bootloader to decompress the frames of a large entry in parallel, and to read a range of its data by
+            decompressing only the frames that cover it. Requires a bootloader built from this version of sources.
         """
         self._collected_names = set()  # Track collected names for strict package mode.
+        self._tmp_dir = os.path.dirname(os.path.abspath(filename))  # For temporary files with compressed data.
+        self._solid_block_size = solid_block_size or 0
+        self._cache = cache
+        self._checksums = checksums
+        self._cold_entries = frozenset(cold_entries or ())
 
-        with open(filename, "wb") as fp:
-            # Write entries' data and collect TOC entries
-            toc = []
-            for entry in entries:
-                toc_entry = self._write_entry(fp, entry)
-                toc.append(toc_entry)
+        if frame_size is not None and not 0 < frame_size <= self._FRAME_SIZE_MAX:
+            raise ValueError(f"Frame size must be between 1 and {self._FRAME_SIZE_MAX} bytes!")
+        self._frame_size = frame_size or 0
 
-            # Write TOC
-            toc_offset = fp.tell()
-            toc_data = self._serialize_toc(toc)
-            toc_length = len(toc_data)
+        self._codecs = codecs or {}
+        for typecode, codec in self._codecs.items():
+            if codec not in self.CODECS:
+                raise ValueError(f"Unsupported compression codec {codec!r} for typecode {typecode!r}!")
 
-            fp.write(toc_data)
+        if format_version is not None and format_version not in self.FORMAT_VERSIONS:
+            raise ValueError(f"Unsupported archive format version: {format_version!r}")
+
+        entries = list(entries)
+        write_order, num_hot_entries = self._compute_write_order(entries, access_order)
+
+        aliases = self._find_duplicates(entries, write_order) if deduplicate else {}
+        jobs = self._prepare_jobs(entries, [idx for idx in write_order if idx not in aliases])
+
+        with open(filename, "wb") as fp:
+            # Write entries' data and collect TOC entries, which are kept in the original order. The data is read and
+            # compressed by the worker threads, but written in the order of the jobs. The TOC entries of solid blocks
+            # are placed after the regular entries.
+            toc = [None] * len(entries)
+            toc_checksums = [0] * len(entries)
+            solid_blocks = {}
+            results = _map_in_order(self._process_job, (job for job, _ in jobs), compression_workers)
+            for (job, target), result in zip(jobs, results):
+                toc_entry, job_checksums = self._write_job(fp, job, result)
+                if not isinstance(target, list):
+                    toc[target] = toc_entry
+                    toc_checksums[target] = job_checksums[0]
+                    continue
+                block_offset = toc_entry[0]
+                solid_blocks[block_offset] = toc_entry
+                for (idx, member_offset, member_length, typecode, dest_name), checksum in zip(target, job_checksums):
+                    toc[idx] = (block_offset, member_offset, member_length, PKG_COMPRESSION_SOLID, typecode, dest_name)
+                    toc_checksums[idx] = checksum
+
+            # The alias entries share the data fields (and checksums) of their canonical entries.
+            for idx, canonical_idx in aliases.items():
+                dest_name, _, _, typecode = entries[idx]
+                dest_name = self._normalize_dest_name(dest_name, typecode)
+                toc[idx] = (*toc[canonical_idx][:4], PKG_ITEM_ALIAS, dest_name)
+                toc_checksums[idx] = toc_checksums[canonical_idx]
+
+            toc += solid_blocks.values()
+
+            # As the entries are written sequentially, the hot prefix ends with the last accessed entry.
+            hot_length = 0
+            for idx in write_order[:num_hot_entries]:
+                hot_length = max(hot_length, self._get_hot_length(entries[idx], toc[idx], solid_blocks))
+
+            if hot_length:
+                toc.append((fp.tell(), 0, 0, PKG_COMPRESSION_NONE, 'o', f"pyi-hot-prefix-length {hot_length}"))
+
+            # The checksum table has a slot for every TOC entry, including itself, and must be the last TOC entry,
+            # which is where the bootloader looks for it. Entries without data of their own have zero checksum.
+            if self._checksums:
+                toc_checksums += [0] * (len(toc) + 1 - len(toc_checksums))
+                checksum_data = struct.pack(f'<{len(toc_checksums)}I', *toc_checksums)
+                toc.append((
+                    fp.tell(),
+                    len(checksum_data),
+                    len(checksum_data),
+                    PKG_COMPRESSION_NONE,
+                    PKG_ITEM_CHECKSUMS,
+                    "pyi-checksums",
+                ))
+                fp.write(checksum_data)
+
+            # Serialize the version 1 TOC, and switch to version 2 if the archive does not fit its 32-bit fields. As
+            # all entries' data precedes the TOC, it is sufficient to check the total archive length.
+            if format_version is None:
+                toc_data = self._serialize_toc(toc)
+                if fp.tell() + len(toc_data) + self._COOKIE_LENGTH > 0xFFFFFFFF:
+                    format_version = 2
+                else:
+                    format_version = 1
 
-            # Write cookie
-            archive_length = toc_offset + toc_length + self._COOKIE_LENGTH
             pyvers = sys.version_info[0] * 100 + sys.version_info[1]
-            cookie_data = struct.pack(
-                self._COOKIE_FORMAT,
-                self._COOKIE_MAGIC_PATTERN,
-                archive_length,
-                toc_offset,
-                toc_length,
-                pyvers,
-                pylib_name.encode('ascii'),
-            )
+            if format_version == 2:
+                # Align the TOC on 8-byte boundary, so that the bootloader can use its entries in-place.
+                fp.write(b'\0' * (-fp.tell() % 8))
+
+                # Write TOC
+                toc_offset = fp.tell()
+                toc_data = self._serialize_toc_v2(toc)
+                toc_length = len(toc_data)
+
+                fp.write(toc_data)
+
+                # Write cookie
+                archive_length = toc_offset + toc_length + self._COOKIE_V2_LENGTH
+                cookie_data = struct.pack(
+                    self._COOKIE_V2_FORMAT,
+                    self._COOKIE_MAGIC_PATTERN,
+                    self._COOKIE_V2_MARKER,
+                    format_version,
+                    archive_length,
+                    toc_offset,
+                    toc_length,
+                    len(toc),
+                    pyvers,
+                    0,
+                    pylib_name.encode('ascii'),
+                )
+            else:
+                # Write TOC
+                toc_offset = fp.tell()
+                toc_data = self._serialize_toc(toc)
+                toc_length = len(toc_data)
+
+                fp.write(toc_data)
+
+                # Write cookie
+                archive_length = toc_offset + toc_length + self._COOKIE_LENGTH
+                cookie_data = struct.pack(
+                    self._COOKIE_FORMAT,
+                    self._COOKIE_MAGIC_PATTERN,
+                    archive_length,
+                    toc_offset,
+                    toc_length,
+                    pyvers,
+                    pylib_name.encode('ascii'),
+                )
 
             fp.write(cookie_data)
 
-    def _write_entry(self, fp, entry):
+        if cache is not None:
+            cache.save()
+
+    @staticmethod
+    def _compute_write_order(entries, access_order):
+        """
+        Compute the order in which the entries' data is written into the archive: the entries listed in the access
+        order come first (in that order), followed by the remaining entries in their original order. The PYZ archive
+        is placed at the end of the accessed entries, so that only its own hot prefix (see `ZlibArchiveWriter`) needs
+        to be included in the archive's hot prefix. Returns the list of entry indices, and the number of the accessed
+        entries.
+        """
+        if not access_order:
+            return list(range(len(entries))), 0
+
+        access_rank = {os.path.normpath(name): rank for rank, name in enumerate(access_order)}
+
+        hot_indices = []
+        cold_indices = []
+        for idx, (dest_name, _, _, typecode) in enumerate(entries):
+            if typecode != 'o' and os.path.normpath(dest_name) in access_rank:
+                hot_indices.append(idx)
+            else:
+                cold_indices.append(idx)
+
+        hot_indices.sort(key=lambda idx: (entries[idx][3] == 'z', access_rank[os.path.normpath(entries[idx][0])]))
+
+        return hot_indices + cold_indices, len(hot_indices)
+
+    @staticmethod
+    def _get_hot_length(entry, toc_entry, solid_blocks):
+        """
+        Compute the length of the archive's hot prefix that ends with the given (accessed) entry.
+        """
+        _, src_name, _, typecode = entry
+        data_offset, data_length, _, compression_flag, *_ = toc_entry
+
+        # Solid block members are accessed by decompressing the whole block.
+        if compression_flag == PKG_COMPRESSION_SOLID:
+            data_offset, data_length, *_ = solid_blocks[data_offset]
+
+        # For uncompressed PYZ archive, include only its hot prefix, if available.
+        if typecode == 'z' and compression_flag == PKG_COMPRESSION_NONE:
+            try:
+                pyz_toc = ZlibArchiveReader(src_name).toc
+            except Exception:
+                pyz_toc = None
+            if isinstance(pyz_toc, ZlibArchiveTOC) and pyz_toc.hot_length:
+                return data_offset + min(pyz_toc.hot_length, data_length)
+
+        return data_offset + data_length
+
+    def _find_duplicates(self, entries, write_order):
+        """
+        Find the BINARY and DATA entries whose contents are identical to those of an entry of the same type that
+        precedes them in write order. Returns a dictionary mapping the index of each duplicate entry to the index of
+        its canonical entry. Only the files whose size matches that of another candidate are hashed; empty files are
+        not de-duplicated, as there is no data to share.
+        """
+        candidates = collections.defaultdict(list)
+        for idx in write_order:
+            _, src_name, _, typecode = entries[idx]
+            if typecode not in ('b', 'x'):
+                continue
+            data_length = os.stat(src_name).st_size
+            if data_length:
+                candidates[(typecode, data_length)].append(idx)
+
+        duplicates = {}
+        for indices in candidates.values():
+            if len(indices) < 2:
+                continue
+            canonical_indices = {}
+            for idx in indices:
+                canonical_idx = canonical_indices.setdefault(self._get_file_digest(entries[idx][1]), idx)
+                if canonical_idx != idx:
+                    duplicates[idx] = canonical_idx
+
+        return duplicates
+
+    def _get_file_digest(self, filename):
+        """
+        Compute the digest of the file's contents; if available, the compression cache is used to avoid re-reading the
+        unchanged files.
+        """
+        if self._cache is not None:
+            return self._cache.get_file_digest(filename) or self._cache.hash_file(filename)
+        return _hash_file(filename)
+
+    def _get_solid_member_length(self, entry):
+        """
+        Return the data length of the entry if it is eligible for placement into a solid block, and None otherwise.
+        Only compressed DATA entries are eligible; binaries might be extracted into memory-backed files, and other
+        entry types are not extracted at all.
+        """
         dest_name, src_name, compress, typecode = entry
+        if not self._solid_block_size or typecode != 'x' or not compress:
+            return None
+        data_length = os.stat(src_name).st_size
+        if data_length > self._SOLID_MEMBER_MAX_SIZE:
+            return None
+        return data_length
 
-        # Write OPTION entries as-is, without normalizing them. This also exempts them from duplication check,
-        # allowing them to be specified multiple times.
-        if typecode == 'o':
-            return self._write_blob(fp, b"", dest_name, typecode)
+    def _prepare_jobs(self, entries, write_order):
+        """
+        Prepare the jobs for writing the entries in the given order, grouping the consecutive eligible DATA entries
+        into solid blocks. Returns a list of (job, target) tuples, where target is either the index of the entry, or,
+        for solid blocks, the list of (index, member_offset, member_length, typecode, dest_name) tuples describing its
+        members. The jobs are prepared in the calling thread, and in order, so that the duplicate names are detected
+        deterministically.
+        """
+        jobs = []
+        solid_members = []
+        solid_length = 0
+        num_blocks = 0
+        for idx in write_order + [None]:
+            member_length = None if idx is None else self._get_solid_member_length(entries[idx])
+            if member_length is not None:
+                solid_members.append((idx, member_length))
+                solid_length += member_length
+                if solid_length < self._solid_block_size:
+                    continue
+                idx = None  # Block is complete.
+
+            # Close the pending block; a lone member is written as a regular entry.
+            if len(solid_members) > 1:
+                jobs.append(self._prepare_solid_block(entries, solid_members, f"pyi-solid-block-{num_blocks}"))
+                num_blocks += 1
+            else:
+                jobs += [(self._prepare_entry(entries[member_idx]), member_idx) for member_idx, _ in solid_members]
+            solid_members, solid_length = [], 0
 
+            if idx is not None:
+                jobs.append((self._prepare_entry(entries[idx]), idx))
+
+        return jobs
+
+    def _prepare_solid_block(self, entries, members, block_name):
+        """
+        Prepare the job for writing the given (index, data_length) members as a single solid block. The block is
+        compressed with the codec for DATA entries.
+        """
+        src_names = []
+        target = []
+        block_length = 0
+        for idx, member_length in members:
+            dest_name, src_name, _, typecode = entries[idx]
+            dest_name = self._normalize_dest_name(dest_name, typecode)
+            src_names.append(src_name)
+            target.append((idx, block_length, member_length, typecode, dest_name))
+            block_length += member_length
+
+        compression_flag = self._get_compression_flag('x', True)
+        job = (block_name, PKG_ITEM_SOLID_BLOCK, compression_flag, tuple(src_names), None)
+
+        return job, target
+
+    def _normalize_dest_name(self, dest_name, typecode):
+        """
+        Normalize the destination name of the entry, and, in strict collect mode, check that it does not duplicate
+        the name of previously collected entry.
+        """
         # Ensure forward slashes in paths are on Windows converted to back slashes '\\', as on Windows the bootloader
         # works only with back slashes.
         dest_name = os.path.normpath(dest_name)
@@ -190,11 +1006,6 @@ def _write_entry(self, fp, entry):
             # manually.
             dest_name = dest_name.replace(os.path.sep, '\\')
 
-            # For symbolic link entries, also ensure that the symlink target path (stored in src_name) is using
-            # Windows-style back slash separators.
-            if typecode == 'n':
-                src_name = src_name.replace(os.path.sep, '\\')
-
         # Strict pack/collect mode: keep track of the destination names, and raise an error if we try to add a duplicate
         # (a file with same destination name, subject to OS case normalization rules).
         if strict_collect_mode:
@@ -213,71 +1024,307 @@ def _write_entry(self, fp, entry):
                     )
                 self._collected_names.add(normalized_dest)
 
+        return dest_name
+
+    def _prepare_entry(self, entry):
+        """
+        Prepare the job for writing the given entry: a (dest_name, typecode, compression_flag, src_names, read_data)
+        tuple, where `read_data` is an optional callable that produces the entry's data. If it is None, the data is
+        the concatenated contents of the `src_names` files (of which there are several only for solid blocks).
+        """
+        dest_name, src_name, compress, typecode = entry
+
+        # Write OPTION entries as-is, without normalizing them. This also exempts them from duplication check,
+        # allowing them to be specified multiple times.
+        if typecode == 'o':
+            return (dest_name, typecode, PKG_COMPRESSION_NONE, (), lambda: b"")
+
+        is_cold = typecode == 'X' and dest_name in self._cold_entries
+        dest_name = self._normalize_dest_name(dest_name, typecode)
+
+        # The data of cold entries is stored in the cold archive.
+        if is_cold:
+            return (dest_name, typecode, PKG_COMPRESSION_COLD, (), lambda: b"")
+
+        # For symbolic link entries, ensure that the symlink target path (stored in src_name) is on Windows using
+        # back slash separators, even when building under MSYS.
+        if is_win and os.path.sep == '/' and typecode == 'n':
+            src_name = src_name.replace(os.path.sep, '\\')
+
         if typecode == 'd':
             # Dependency; merge src_name (= reference path prefix) and dest_name (= name) into single-string format that
             # is parsed by bootloader.
-            return self._write_blob(fp, b"", f"{src_name}:{dest_name}", typecode)
+            return (f"{src_name}:{dest_name}", typecode, PKG_COMPRESSION_NONE, (), lambda: b"")
         elif typecode in {'s', 's1', 's2'}:
             # If it is a source code file, compile it to a code object and marshal the object, so it can be unmarshalled
             # by the bootloader. For that, we need to know target optimization level, which is stored in typecode.
             optim_level = {'s': 0, 's1': 1, 's2': 2}[typecode]
-            code = get_code_object(dest_name, src_name, optimize=optim_level)
-            co_filename = dest_name + os.path.splitext(src_name)[1]  # Use dest name with suffix from source filename.
-            code = replace_filename_in_code_object(code, co_filename)
-            return self._write_blob(fp, marshal.dumps(code), dest_name, 's', compress=compress)
+            read_data = functools.partial(self._compile_script, dest_name, src_name, optim_level)
+            return (dest_name, 's', self._get_compression_flag('s', compress), (), read_data)
         elif typecode in ('m', 'M'):
-            # Read the PYC file. We do not perform compilation here (in contrast to script files in the above branch),
-            # so typecode does not contain optimization level information.
-            with open(src_name, "rb") as in_fp:
-                data = in_fp.read()
-            assert data[:4] == BYTECODE_MAGIC
-            # Skip the PYC header, load the code object.
-            code = marshal.loads(data[16:])
-            co_filename = dest_name + '.py'  # Use dest name with added .py suffix.
-            code = replace_filename_in_code_object(code, co_filename)
-            # These module entries are loaded and executed within the bootloader, which requires only the code
-            # object, without the PYC header.
-            return self._write_blob(fp, marshal.dumps(code), dest_name, typecode, compress=compress)
+            read_data = functools.partial(self._read_module, dest_name, src_name)
+            return (dest_name, typecode, self._get_compression_flag(typecode, compress), (), read_data)
         elif typecode == 'n':
             # Symbolic link; store target name (as NULL-terminated string)
             data = src_name.encode('utf-8') + b'\x00'
-            return self._write_blob(fp, data, dest_name, typecode, compress=compress)
+            return (dest_name, typecode, self._get_compression_flag(typecode, compress), (), lambda: data)
         else:
-            return self._write_file(fp, src_name, dest_name, typecode, compress=compress)
+            compression_flag = self._get_compression_flag(typecode, compress)
+            if self._is_framed(typecode, compression_flag, src_name):
+                compression_flag = PKG_COMPRESSION_FRAMED
+            return (dest_name, typecode, compression_flag, (src_name,), None)
 
-    def _write_blob(self, out_fp, blob: bytes, dest_name, typecode, compress=False):
+    def _is_framed(self, typecode, compression_flag, src_name):
         """
-        Write the binary contents (**blob**) of a small file to the archive and return the corresponding CArchive TOC
-        entry.
+        Check if the DATA entry with given compression flag should be written as framed entry; i.e., if it is
+        compressed, and its data is larger than the frame size.
         """
-        data_offset = out_fp.tell()
-        data_length = len(blob)
-        if compress:
-            blob = zlib.compress(blob, level=self._COMPRESSION_LEVEL)
-        out_fp.write(blob)
+        if not self._frame_size or typecode not in ('x', 'X') or compression_flag == PKG_COMPRESSION_NONE:
+            return False
+        return os.stat(src_name).st_size > self._frame_size
 
-        return (data_offset, len(blob), data_length, int(compress), typecode, dest_name)
+    def _compress_framed(self, data, frame_compression_flag):
+        """
+        Compress the data as framed entry: the frame header and the frame index, followed by the frames, each of which
+        is compressed independently with the given compression method.
+        """
+        frames = []
+        for frame_offset in range(0, len(data), self._frame_size):
+            frame_data = data[frame_offset:frame_offset + self._frame_size]
+            compressor = self._create_compressor(frame_compression_flag, len(frame_data))
+            frames.append(compressor.compress(frame_data) + compressor.flush())
+
+        header = struct.pack(PKG_FRAME_HEADER_FORMAT, self._frame_size, len(frames), frame_compression_flag)
+
+        # The offsets of the frames (and of the end of the data) are relative to the start of the data.
+        offsets = [len(header) + (len(frames) + 1) * 8]
+        for frame in frames:
+            offsets.append(offsets[-1] + len(frame))
+
+        return b''.join([header, struct.pack(f'<{len(offsets)}Q', *offsets), *frames])
+
+    @staticmethod
+    def _compile_script(dest_name, src_name, optim_level):
+        code = get_code_object(dest_name, src_name, optimize=optim_level)
+        co_filename = dest_name + os.path.splitext(src_name)[1]  # Use dest name with suffix from source filename.
+        code = replace_filename_in_code_object(code, co_filename)
+        return marshal.dumps(code)
+
+    @staticmethod
+    def _read_module(dest_name, src_name):
+        # Read the PYC file. We do not perform compilation here (in contrast to script files), so typecode does not
+        # contain optimization level information.
+        with open(src_name, "rb") as in_fp:
+            data = in_fp.read()
+        assert data[:4] == BYTECODE_MAGIC
+        # Skip the PYC header, load the code object.
+        code = marshal.loads(data[16:])
+        co_filename = dest_name + '.py'  # Use dest name with added .py suffix.
+        code = replace_filename_in_code_object(code, co_filename)
+        # These module entries are loaded and executed within the bootloader, which requires only the code object,
+        # without the PYC header.
+        return marshal.dumps(code)
+
+    def _get_compression_flag(self, typecode, compress, codec=None):
+        """
+        Determine the compression flag for an entry with given typecode; the codec can be explicitly specified via
+        **codec** argument, otherwise the codec is looked up in the per-typecode codec dictionary.
+        """
+        if not compress:
+            return PKG_COMPRESSION_NONE
+        if codec is None:
+            codec = self._codecs.get(typecode, 'zlib')
+        return self.CODECS[codec]
 
-    def _write_file(self, out_fp, src_name, dest_name, typecode, compress=False):
+    def _create_compressor(self, compression_flag, data_length):
         """
-        Stream copy a large file into the archive and return the corresponding CArchive TOC entry.
+        Create streaming compressor object with `compress()` and `flush()` methods for the given compression flag.
         """
-        data_offset = out_fp.tell()
-        data_length = os.stat(src_name).st_size
-        with open(src_name, 'rb') as in_fp:
-            if compress:
-                tmp_buffer = bytearray(16 * 1024)
-                compressor = zlib.compressobj(self._COMPRESSION_LEVEL)
-                while True:
-                    num_read = in_fp.readinto(tmp_buffer)
-                    if not num_read:
-                        break
-                    out_fp.write(compressor.compress(tmp_buffer[:num_read]))
-                out_fp.write(compressor.flush())
+        if compression_flag == PKG_COMPRESSION_ZLIB:
+            return zlib.compressobj(self._COMPRESSION_LEVEL)
+        elif compression_flag == PKG_COMPRESSION_ZSTD:
+            import zstandard
+            # Store the content size in the frame header; the bootloader decompresses in-memory entries in a single
+            # call.
+            compressor = zstandard.ZstdCompressor(level=self._ZSTD_COMPRESSION_LEVEL, write_content_size=True)
+            return compressor.compressobj(size=data_length)
+        elif compression_flag == PKG_COMPRESSION_LZ4:
+            import lz4.frame
+            compressor = lz4.frame.LZ4FrameCompressor(compression_level=self._LZ4_COMPRESSION_LEVEL)
+            return _LZ4StreamingCompressor(compressor, data_length)
+        raise ValueError(f"Unsupported compression flag: {compression_flag}")
+
+    def _process_job(self, job):
+        """
+        Read (or produce) and compress the data of the given job; called from the worker threads. Returns a tuple
+        (data_length, data, checksums), where `data` is the data to be written into the archive, or None for
+        uncompressed files, which are stream-copied into the archive when the job is written, or an open file object
+        with the compressed data of a large file (see `_process_large_file`). The `checksums` is the tuple of CRC-32
+        checksums of the uncompressed data of each of the job's members (or None, if the data was not read). The
+        compressed data of source files is looked up in (and stored into) the compression cache, if available.
+        """
+        _, typecode, compression_flag, src_names, read_data = job
+        if read_data is None and compression_flag == PKG_COMPRESSION_NONE:
+            return os.stat(src_names[0]).st_size, None, None
+
+        # The frames of framed entries are compressed with the codec for the entry's typecode.
+        frame_compression_flag = None
+        if compression_flag == PKG_COMPRESSION_FRAMED:
+            frame_compression_flag = self._get_compression_flag(typecode, True)
+
+        cache = self._cache if read_data is None else None
+        cache_params = None
+        if cache is not None:
+            if frame_compression_flag is not None:
+                cache_params = (
+                    'carchive',
+                    compression_flag,
+                    frame_compression_flag,
+                    self._COMPRESSION_LEVELS[frame_compression_flag],
+                    self._frame_size,
+                )
             else:
+                cache_params = ('carchive', compression_flag, self._COMPRESSION_LEVELS[compression_flag])
+
+        if read_data is None and len(src_names) == 1 and os.stat(src_names[0]).st_size > self._STREAMING_THRESHOLD:
+            return self._process_large_file(src_names[0], compression_flag, frame_compression_flag, cache, cache_params)
+
+        if cache is not None:
+            cache_digests = [cache.get_file_digest(src_name) for src_name in src_names]
+            if None not in cache_digests:
+                cached = cache.load(cache_params, cache_digests)
+                if cached is not None:
+                    return cached
+
+            # Read the files (which also updates their digests), and retry the look-up; the files might have been
+            # only touched, or restored from version control.
+            members, cache_digests = zip(*(cache.read_file(src_name) for src_name in src_names))
+            cached = cache.load(cache_params, list(cache_digests))
+            if cached is not None:
+                return cached
+        elif read_data is None:
+            members = _read_files(src_names)
+        else:
+            members = [read_data()]
+
+        # Computing the checksums is cheap compared to compression, so they are computed (and cached) even if the
+        # archive does not store them.
+        checksums = tuple(zlib.crc32(member) for member in members)
+        data = b''.join(members)
+
+        data_length = len(data)
+        if frame_compression_flag is not None:
+            data = self._compress_framed(data, frame_compression_flag)
+        elif compression_flag not in (PKG_COMPRESSION_NONE, PKG_COMPRESSION_COLD):
+            compressor = self._create_compressor(compression_flag, data_length)
+            data = compressor.compress(data) + compressor.flush()
+
+        if cache is not None:
+            cache.store(cache_params, list(cache_digests), data_length, data, checksums)
+
+        return data_length, data, checksums
+
+    def _process_large_file(self, src_name, compression_flag, frame_compression_flag, cache, cache_params):
+        """
+        Process the job of a large, compressed source file. The file is read and compressed in chunks into a temporary
+        file, so that neither its data nor its compressed data is held in memory. Returns the same tuple as
+        `_process_job`, with the data being an open file object (the temporary file, or the blob file from the
+        compression cache), which is closed once its contents are copied into the archive.
+        """
+        if cache is not None:
+            digest = cache.get_file_digest(src_name) or cache.hash_file(src_name)
+            cached = cache.open_blob(cache_params, [digest])
+            if cached is not None:
+                return cached
+
+        data_length = os.stat(src_name).st_size
+        out_fp = tempfile.TemporaryFile(dir=self._tmp_dir)
+        try:
+            with open(src_name, 'rb') as in_fp:
+                if frame_compression_flag is not None:
+                    checksum = self._compress_framed_file(in_fp, out_fp, data_length, frame_compression_flag)
+                else:
+                    checksum = self._compress_file(in_fp, out_fp, data_length, compression_flag, 0)
+            if cache is not None:
+                cache.store(cache_params, [digest], data_length, out_fp, (checksum,))
+            out_fp.seek(0, os.SEEK_SET)
+        except BaseException:
+            out_fp.close()
+            raise
+
+        return data_length, out_fp, (checksum,)
+
+    def _compress_file(self, in_fp, out_fp, length, compression_flag, checksum):
+        """
+        Compress the next `length` bytes of the input file into the output file, reading them in chunks. Returns the
+        CRC-32 checksum of the read data, continuing from the given `checksum`.
+        """
+        compressor = self._create_compressor(compression_flag, length)
+        while length > 0:
+            chunk = in_fp.read(min(length, self._STREAMING_CHUNK_SIZE))
+            if not chunk:
+                raise ValueError(f"File {in_fp.name!r} was truncated while it was being read!")
+            length -= len(chunk)
+            checksum = zlib.crc32(chunk, checksum)
+            out_fp.write(compressor.compress(chunk))
+        out_fp.write(compressor.flush())
+        return checksum
+
+    def _compress_framed_file(self, in_fp, out_fp, data_length, frame_compression_flag):
+        """
+        Compress the `data_length` bytes of the input file into the output file as framed entry, in the same format as
+        `_compress_framed`. The space for the frame index is reserved first, and the index is written once the frames
+        are compressed. Returns the CRC-32 checksum of the read data.
+        """
+        num_frames = (data_length + self._frame_size - 1) // self._frame_size
+        header = struct.pack(PKG_FRAME_HEADER_FORMAT, self._frame_size, num_frames, frame_compression_flag)
+        out_fp.write(header)
+        out_fp.write(b'\0' * ((num_frames + 1) * 8))
+
+        # The offsets of the frames (and of the end of the data) are relative to the start of the data, which is also
+        # the start of the output file.
+        offsets = [out_fp.tell()]
+        checksum = 0
+        for frame_offset in range(0, data_length, self._frame_size):
+            frame_length = min(self._frame_size, data_length - frame_offset)
+            checksum = self._compress_file(in_fp, out_fp, frame_length, frame_compression_flag, checksum)
+            offsets.append(out_fp.tell())
+
+        out_fp.seek(len(header), os.SEEK_SET)
+        out_fp.write(struct.pack(f'<{len(offsets)}Q', *offsets))
+        out_fp.seek(0, os.SEEK_END)
+        return checksum
+
+    def _write_job(self, out_fp, job, result):
+        """
+        Write the data of the processed job into the archive. Returns tuple (toc_entry, checksums) with the
+        corresponding CArchive TOC entry and the checksums of its members; the checksum of a stream-copied file is
+        computed during the copy, if the archive stores checksums.
+        """
+        dest_name, typecode, compression_flag, src_names, _ = job
+        data_length, data, checksums = result
+
+        data_offset = out_fp.tell()
+        if data is None and self._checksums:
+            checksum = 0
+            with open(src_names[0], 'rb') as in_fp:
+                for chunk in iter(functools.partial(in_fp.read, 1024 * 1024), b''):
+                    checksum = zlib.crc32(chunk, checksum)
+                    out_fp.write(chunk)
+            checksums = (checksum,)
+        elif data is None:
+            with open(src_names[0], 'rb') as in_fp:
                 shutil.copyfileobj(in_fp, out_fp)
+            checksums = (0,)
+        elif isinstance(data, bytes):
+            out_fp.write(data)
+        else:
+            # Compressed data of a large file, in a temporary file or in a blob file of the compression cache.
+            with data:
+                shutil.copyfileobj(data, out_fp)
 
-        return (data_offset, out_fp.tell() - data_offset, data_length, int(compress), typecode, dest_name)
+        toc_entry = (data_offset, out_fp.tell() - data_offset, data_length, compression_flag, typecode, dest_name)
+        return toc_entry, checksums
 
     @classmethod
     def _serialize_toc(cls, toc):
@@ -313,6 +1360,106 @@ def _serialize_toc(cls, toc):
 
         return b''.join(serialized_toc)
 
+    @classmethod
+    def _serialize_toc_v2(cls, toc):
+        # Fixed-size entries, followed by the string table with NUL-terminated names. The position of each name is
+        # stored relative to the start of its entry, so that the entries can be used without knowing where the TOC
+        # is located.
+        serialized_entries = []
+        serialized_names = []
+        entries_length = len(toc) * cls._TOC_ENTRY_V2_LENGTH
+        names_length = 0
+        for idx, toc_entry in enumerate(toc):
+            data_offset, compressed_length, data_length, compress, typecode, name = toc_entry
+
+            name = name.encode('utf-8')
+            name_offset = entries_length - idx * cls._TOC_ENTRY_V2_LENGTH + names_length
+
+            serialized_entries.append(
+                struct.pack(
+                    cls._TOC_ENTRY_V2_FORMAT,
+                    data_offset,
+                    compressed_length,
+                    data_length,
+                    name_offset,
+                    len(name),
+                    compress,
+                    typecode.encode('ascii'),
+                )
+            )
+            serialized_names.append(name + b'\0')
+            names_length += len(name) + 1
+
+        return b''.join(serialized_entries + serialized_names)
+
+
+def _hash_file(filename):
+    """
+    Compute the SHA-256 digest of the file's contents, reading the file in chunks.
+    """
+    hasher = hashlib.sha256()
+    with open(filename, 'rb') as fp:
+        for chunk in iter(functools.partial(fp.read, 1024 * 1024), b''):
+            hasher.update(chunk)
+    return hasher.hexdigest()
+
+
+def _read_files(filenames):
+    """
+    Read the contents of the given files; returns the list of their data.
+    """
+    data = []
+    for filename in filenames:
+        with open(filename, 'rb') as in_fp:
+            data.append(in_fp.read())
+    return data
+
+
+def append_carchive_locator(filename):
+    """
+    Append the locator footer to the end of the executable with embedded CArchive (PKG). The footer records the
+    position of the archive's cookie, and allows the bootloader to locate it without scanning the executable for the
+    cookie's magic pattern. For the footer format, see `PyInstaller.archive.readers.CArchiveReader`.
+    """
+    from PyInstaller.archive.readers import CArchiveReader
+
+    with open(filename, 'r+b') as fp:
+        cookie_offset = CArchiveReader._find_magic_pattern(fp, CArchiveWriter._COOKIE_MAGIC_PATTERN)
+        if cookie_offset == -1:
+            raise ValueError(f"Could not find CArchive cookie in {filename}!")
+
+        cookie_data = CArchiveReader._read_cookie(fp, cookie_offset)
+
+        # Pack all fields except trailing checksum, which is computed over the packed fields.
+        locator_data = struct.pack(
+            '!8sIII',
+            CArchiveReader._LOCATOR_MAGIC_PATTERN,
+            cookie_offset >> 32,
+            cookie_offset & 0xFFFFFFFF,
+            zlib.crc32(cookie_data),
+        )
+        locator_data += struct.pack('!I', zlib.crc32(locator_data))
+
+        fp.seek(0, os.SEEK_END)
+        fp.write(locator_data)
+
+
+class _LZ4StreamingCompressor:
+    """
+    Adapter that provides zlib-like `compress()` and `flush()` interface for `lz4.frame.LZ4FrameCompressor`.
+    """
+    def __init__(self, compressor, data_length):
+        self._compressor = compressor
+        self._header = compressor.begin(source_size=data_length)
+
+    def compress(self, data):
+        header, self._header = self._header, b''
+        return header + self._compressor.compress(bytes(data))
+
+    def flush(self):
+        header, self._header = self._header, b''
+        return header + self._compressor.flush()
+
 
 class SplashWriter:
     """
@@ -339,14 +1486,57 @@ class SplashWriter:
     #
     #     uint32_t requirements_len;
     #     uint32_t requirements_offset;
+    #
+    #     uint32_t backend;
+    #     uint32_t flags;
+    #
+    #     uint32_t image_width;
+    #     uint32_t image_height;
+    #
+    #     char text_font[32];
+    #     int32_t text_pos_x;
+    #     int32_t text_pos_y;
+    #     int32_t text_size;
+    #     uint32_t text_color;
+    #
+    #     int32_t progress_bar_x0;
+    #     int32_t progress_bar_y0;
+    #     int32_t progress_bar_x1;
+    #     int32_t progress_bar_y1;
+    #     uint32_t progress_bar_color;
     # } SPLASH_DATA_HEADER;
     #
-    _HEADER_FORMAT = '!32s 32s 16s II II II'
+    # The fields following `requirements_offset` are used only by the native backend, in which case the Tcl/Tk fields
+    # are empty, the image is stored as raw RGBA pixels, and the script field holds the initial status text.
+    _HEADER_FORMAT = '!32s 32s 16s II II II II II 32s iiiI iiiiI'
     _HEADER_LENGTH = struct.calcsize(_HEADER_FORMAT)
 
+    BACKEND_TCLTK = 0
+    BACKEND_NATIVE = 1
+
+    FLAG_ALWAYS_ON_TOP = 0x01
+    FLAG_TEXT = 0x02
+    FLAG_PROGRESS_BAR = 0x04
+
+    class NativeOptions:
+        """
+        Options of the native splash screen backend; the colors are 0xRRGGBB integers, and the positions are in pixels
+        of the image.
+        """
+        def __init__(self, image_width, image_height, always_on_top=True):
+            self.image_width = image_width
+            self.image_height = image_height
+            self.always_on_top = always_on_top
+            self.text_pos = None
+            self.text_size = 0
+            self.text_color = 0
+            self.text_font = ''
+            self.progress_bar_pos = None
+            self.progress_bar_color = 0
+
     # The created archive is compressed by the CArchive, so no need to compress the data here.
 
-    def __init__(self, filename, name_list, tcl_libname, tk_libname, tklib, image, script):
+    def __init__(self, filename, name_list, tcl_libname, tk_libname, tklib, image, script, native_options=None):
         """
         Writer for splash screen resources that are bundled into the CArchive as a single archive/entry.
 
@@ -357,6 +1547,8 @@ def __init__(self, filename, name_list, tcl_libname, tk_libname, tklib, image, s
         :param str tklib: Root of tk library (e.g. tk/)
         :param Union[str, bytes] image: Image like object
         :param str script: The tcl/tk script to execute to create the screen.
+        :param NativeOptions native_options: Options for the native backend; if given, the native backend is used, and
+            `image` must be a buffer with raw RGBA pixels, and `script` the initial status text.
         """
 
         # Ensure forward slashes in dependency names are on Windows converted to back slashes '\\', as on Windows the
@@ -387,8 +1579,9 @@ def _normalize_filename(filename):
 
             # Write splash script
             script_offset = fp.tell()
-            script_len = len(script)
-            fp.write(script.encode("utf-8"))
+            script_data = script.encode("utf-8")
+            script_len = len(script_data)
+            fp.write(script_data)
 
             # Write splash image. If image is a bytes buffer, it is written directly into the archive. Otherwise, it
             # is assumed to be a path and the file is copied into the archive.
@@ -418,6 +1611,32 @@ def _encode_str(value, field_name, limit):
 
                 return enc_value
 
+            # Native backend options
+            backend = self.BACKEND_TCLTK
+            flags = 0
+            image_width = image_height = 0
+            text_font = ''
+            text_pos = (0, 0)
+            text_size = text_color = 0
+            progress_bar_pos = (0, 0, 0, 0)
+            progress_bar_color = 0
+            if native_options is not None:
+                backend = self.BACKEND_NATIVE
+                image_width = native_options.image_width
+                image_height = native_options.image_height
+                if native_options.always_on_top:
+                    flags |= self.FLAG_ALWAYS_ON_TOP
+                if native_options.text_pos is not None:
+                    flags |= self.FLAG_TEXT
+                    text_pos = native_options.text_pos
+                    text_size = native_options.text_size
+                    text_color = native_options.text_color
+                    text_font = native_options.text_font
+                if native_options.progress_bar_pos is not None:
+                    flags |= self.FLAG_PROGRESS_BAR
+                    progress_bar_pos = native_options.progress_bar_pos
+                    progress_bar_color = native_options.progress_bar_color
+
             # Write header
             header_data = struct.pack(
                 self._HEADER_FORMAT,
@@ -430,6 +1649,16 @@ def _encode_str(value, field_name, limit):
                 image_offset,
                 requirements_len,
                 requirements_offset,
+                backend,
+                flags,
+                image_width,
+                image_height,
+                _encode_str(text_font, 'text_font', 32),
+                *text_pos,
+                text_size,
+                text_color,
+                *progress_bar_pos,
+                progress_bar_color,
             )
 
             fp.seek(0, os.SEEK_SET)
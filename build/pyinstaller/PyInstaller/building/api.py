@@ -25,10 +25,11 @@
 
 from PyInstaller import HOMEPATH, PLATFORM
 from PyInstaller import log as logging
-from PyInstaller.archive.writers import CArchiveWriter, ZlibArchiveWriter
+from PyInstaller.archive.writers import CArchiveWriter, CompressionCache, ZlibArchiveWriter, append_carchive_locator
 from PyInstaller.building.datastruct import Target, _check_guts_eq, normalize_pyz_toc, normalize_toc
 from PyInstaller.building.utils import (
-    _check_guts_toc, _make_clean_directory, _rmtree, process_collected_binary, get_code_object, compile_pymodule
+    _check_guts_toc, _make_clean_directory, _rmtree, process_collected_binary, get_code_object, compile_pymodule,
+    load_access_profile
 )
 from PyInstaller.building.splash import Splash  # argument type validation in EXE
 from PyInstaller.compat import is_cygwin, is_darwin, is_linux, is_win, strict_collect_mode, is_nogil, is_aix
@@ -38,6 +39,10 @@
 
 logger = logging.getLogger(__name__)
 
+# Name of the file in the contents directory of onedir application, which lists the shared libraries that the
+# bootloader preloads in no-restart mode.
+PRELOAD_LIST_FILENAME = "pyi-preload-libraries.txt"
+
 if is_win:
     from PyInstaller.utils.win32 import (icon, versioninfo, winmanifest, winresource, winutils)
 
@@ -45,6 +50,25 @@
     import PyInstaller.utils.osx as osxutils
 
 
+def _get_compression_cache():
+    """
+    Return the compression cache of archive writers, which is shared by all builds, and located in CONF['cachedir'].
+    Returns None if the cache is disabled (`--no-compression-cache`).
+    """
+    from PyInstaller.config import CONF
+    if not CONF.get('compression_cache', True):
+        return None
+    return CompressionCache(os.path.join(CONF['cachedir'], 'blobcache'))
+
+
+def _log_compression_cache_stats(cache):
+    if cache is None:
+        return
+    num_entries = cache.num_hits + cache.num_misses
+    if num_entries:
+        logger.info("Re-used compressed data of %d out of %d entries from cache.", cache.num_hits, num_entries)
+
+
 class PYZ(Target):
     """
     Creates a zlib-based PYZ archive that contains byte-compiled pure Python modules.
@@ -59,6 +83,13 @@ def __init__(self, *tocs, **kwargs):
 
             name
                 A filename for the .pyz. Normally not needed, as the generated name will do fine.
+            compression_dictionary
+                If True, train a preset compression dictionary over the collected modules, and use it to compress
+                all entries. Improves compression ratio of small modules at the cost of longer build time.
+            layout_profile
+                Optional path to the access profile, recorded by running the frozen application with the
+                PYINSTALLER_ACCESS_PROFILE environment variable set. The modules are laid out in the archive in the
+                order in which the application first loaded them.
         """
         if kwargs.get("cipher"):
             from PyInstaller.exceptions import RemovedCipherFeatureError
@@ -76,6 +107,9 @@ def __init__(self, *tocs, **kwargs):
         if name is None:
             self.name = os.path.splitext(self.tocfilename)[0] + '.pyz'
 
+        self.compression_dictionary = kwargs.get('compression_dictionary', False)
+        self.layout_profile = kwargs.get('layout_profile', None)
+
         # PyInstaller bootstrapping modules.
         bootstrap_dependencies = get_bootstrap_modules()
 
@@ -130,6 +164,8 @@ def __init__(self, *tocs, **kwargs):
     _GUTS = (
         # input parameters
         ('name', _check_guts_eq),
+        ('compression_dictionary', _check_guts_eq),
+        ('layout_profile', _check_guts_eq),
         ('toc', _check_guts_toc),
         # no calculated/analysed values
     )
@@ -153,8 +189,21 @@ def assemble(self):
                     continue
             archive_toc.append(entry)
 
+        access_order = None
+        if self.layout_profile:
+            access_order = load_access_profile(self.layout_profile)['pyz']
+
         # Create the archive
-        ZlibArchiveWriter(self.name, archive_toc, code_dict=self.code_dict)
+        cache = _get_compression_cache()
+        ZlibArchiveWriter(
+            self.name,
+            archive_toc,
+            code_dict=self.code_dict,
+            compression_dictionary=self.compression_dictionary,
+            access_order=access_order,
+            cache=cache,
+        )
+        _log_compression_cache_stats(cache)
         logger.info("Building PYZ (ZlibArchive) %s completed successfully.", self.name)
 
 
@@ -185,6 +234,24 @@ class PKG(Target):
         'SYMLINK': 'n',
     }
 
+    # Data files that are always extracted eagerly, even if lazy extraction is enabled, because they are known to be
+    # accessed by native code, which bypasses the lazy-extraction hooks. The directories are matched against the first
+    # component of the destination name, and the patterns using `pathlib.PurePath.match`.
+    lazy_extraction_eager_dirs = (
+        '_tcl_data',  # Tcl and Tk script libraries are read by Tcl/Tk shared libraries.
+        '_tk_data',
+        'tcl8',
+        'PyQt5',  # Qt plugins, translations, and QML files are read by Qt shared libraries.
+        'PyQt6',
+        'PySide2',
+        'PySide6',
+    )
+    lazy_extraction_eager_patterns = (
+        'base_library.zip',  # Read by zipimport via `io.open_code`.
+        '*.pem',  # Certificate bundles are read by OpenSSL.
+        '*.crt',
+    )
+
     def __init__(
         self,
         toc,
@@ -197,7 +264,19 @@ def __init__(
         upx_exclude=None,
         target_arch=None,
         codesign_identity=None,
-        entitlements_file=None
+        entitlements_file=None,
+        compression_codecs=None,
+        archive_format_version=None,
+        lazy_extraction=False,
+        lazy_extraction_exclude=None,
+        layout_profile=None,
+        solid_block_size=None,
+        deduplicate_files=False,
+        checksums=False,
+        cold_entries=None,
+        cold_name=None,
+        filesystem_image=False,
+        frame_size=None,
     ):
         """
         toc
@@ -210,6 +289,62 @@ def __init__(
             Dictionary that specifies compression by typecode. For Example, PYZ is left uncompressed so that it
             can be accessed inside the PKG. The default uses sensible values. If zlib is not available, no
             compression is used.
+        compression_codecs
+            Optional dictionary that specifies the compression codec ('zlib', 'zstd', or 'lz4') by CArchive typecode,
+            for entries that are compressed according to `cdict`. For example, ``{'b': 'lz4', 'x': 'zstd'}``. The
+            default is to use 'zlib' for all compressed entries. The 'zstd' and 'lz4' codecs require the `zstandard`
+            and `lz4` packages at build time, and a bootloader built with corresponding library at run time.
+        archive_format_version
+            Optional CArchive format version (1 or 2). Version 2 uses 64-bit offsets and a TOC that the bootloader
+            can use directly from the memory-mapped executable; it requires a bootloader built from this version of
+            sources. By default, version 1 is used, unless the archive exceeds its 4 GB limit.
+        lazy_extraction
+            If True (or 'background'), DATA entries are stored with 'X' typecode, and are extracted by the bootloader
+            only when the program first accesses them (via `open`, `os.stat`, or by listing their directory), or by
+            the background extraction (see `EXE`), instead of during the unpacking of the onefile application. The
+            data files that are known to be accessed by native code are always extracted eagerly (see
+            `lazy_extraction_eager_dirs` and `lazy_extraction_eager_patterns`).
+        lazy_extraction_exclude
+            Optional list of additional patterns (matched against destination names using `pathlib.PurePath.match`)
+            of DATA entries that should be extracted eagerly when `lazy_extraction` is enabled.
+        layout_profile
+            Optional path to the access profile, recorded by running the frozen application with the
+            PYINSTALLER_ACCESS_PROFILE environment variable set. The entries' data is laid out in the archive in the
+            order in which the application first accessed it, and the bootloader requests the read-ahead of the
+            accessed part of the archive at startup.
+        solid_block_size
+            Optional target size (in bytes) of solid blocks, into which consecutive small compressed DATA entries are
+            compressed together. This improves the compression ratio for applications with many small data files,
+            and reduces the decompression overhead during unpacking of onefile applications. Requires a bootloader
+            built from this version of sources. By default, each entry is compressed on its own.
+        deduplicate_files
+            If True, the data of BINARY and DATA entries whose contents are identical to those of another entry is
+            stored only once; the duplicates are stored as alias entries, which the bootloader of onefile application
+            satisfies by cloning (reflinking or hard-linking) the first extracted copy, or, if that is not possible, by
+            copying it. Requires a bootloader built from this version of sources.
+        checksums
+            If True, the CRC-32 checksums of all entries are stored in the PKG, so that the bootloader can verify the
+            extracted data (see `verify_checksums` option of `EXE`). Requires a bootloader built from this version of
+            sources.
+        cold_entries
+            Optional list of patterns (matched against destination names using `pathlib.PurePath.match`) of
+            lazily-extracted DATA entries whose data is stored in a separate cold archive, written to `cold_name`,
+            instead of in this PKG. The PKG lists them without data, and the bootloader opens the cold archive only
+            when the first of them is extracted. Requires `lazy_extraction`, and a bootloader built from this version
+            of sources.
+        cold_name
+            The filename for the cold archive; required if `cold_entries` is specified.
+        filesystem_image
+            If True, the BINARY, DATA, ZIPFILE, and SYMLINK entries are stored in a single squashfs filesystem image,
+            which the bootloader of onefile application (on Linux) mounts on its temporary directory instead of
+            extracting the files. Requires `mksquashfs` at build time, and a bootloader built from this version of
+            sources.
+        frame_size
+            Optional frame size (in bytes). If specified, compressed DATA entries that are larger than the frame size
+            are split into independently compressed frames of the given size, which the bootloader decompresses in
+            parallel; a range of data of lazily-extracted files can also be read by decompressing only the frames
+            that cover it (see `sys._pyinstaller_read_range`). Requires a bootloader built from this version of
+            sources.
         exclude_binaries
             If True, EXTENSIONs and BINARYs will be left out of the PKG, and forwarded to its container (usually
             a COLLECT).
@@ -232,6 +367,18 @@ def __init__(
         self.target_arch = target_arch
         self.codesign_identity = codesign_identity
         self.entitlements_file = entitlements_file
+        self.compression_codecs = compression_codecs
+        self.archive_format_version = archive_format_version
+        self.lazy_extraction = lazy_extraction
+        self.lazy_extraction_exclude = lazy_extraction_exclude or []
+        self.layout_profile = layout_profile
+        self.solid_block_size = solid_block_size
+        self.deduplicate_files = deduplicate_files
+        self.checksums = checksums
+        self.cold_entries = cold_entries or []
+        self.cold_name = cold_name
+        self.filesystem_image = filesystem_image
+        self.frame_size = frame_size
 
         # This dict tells PyInstaller what items embedded in the executable should be compressed.
         if self.cdict is None:
@@ -263,9 +410,80 @@ def __init__(
         ('target_arch', _check_guts_eq),
         ('codesign_identity', _check_guts_eq),
         ('entitlements_file', _check_guts_eq),
+        ('compression_codecs', _check_guts_eq),
+        ('archive_format_version', _check_guts_eq),
+        ('lazy_extraction', _check_guts_eq),
+        ('lazy_extraction_exclude', _check_guts_eq),
+        ('layout_profile', _check_guts_eq),
+        ('solid_block_size', _check_guts_eq),
+        ('deduplicate_files', _check_guts_eq),
+        ('checksums', _check_guts_eq),
+        ('cold_entries', _check_guts_eq),
+        ('cold_name', _check_guts_eq),
+        ('filesystem_image', _check_guts_eq),
+        ('frame_size', _check_guts_eq),
         # no calculated/analysed values
     )
 
+    def _is_lazy_extraction_candidate(self, dest_name):
+        """
+        Check whether the DATA entry with given destination name can be extracted lazily.
+        """
+        dest_path = pathlib.PurePath(dest_name)
+        if dest_path.parts[0] in self.lazy_extraction_eager_dirs:
+            return False
+        for pattern in (*self.lazy_extraction_eager_patterns, *self.lazy_extraction_exclude):
+            if dest_path.match(pattern):
+                return False
+        return True
+
+    def _build_filesystem_image(self, archive_toc):
+        """
+        Stage the entries that would be extracted by the bootloader into a directory, and build a squashfs image of
+        it. Returns the archive TOC, in which the staged entries are replaced by the single filesystem image entry.
+        """
+        base_name = os.path.splitext(self.name)[0]
+        staging_dir = base_name + '_fsimage'
+        image_name = base_name + '.squashfs'
+        logger.info("Building filesystem image %s", os.path.basename(image_name))
+
+        if os.path.isdir(staging_dir):
+            shutil.rmtree(staging_dir)
+        os.makedirs(staging_dir)
+
+        remaining_toc = []
+        for entry in archive_toc:
+            dest_name, src_name, _, typecode = entry
+            if typecode == 'd':
+                raise ValueError(f"Filesystem image cannot be used with multipackage dependency {dest_name}!")
+            if typecode not in {'b', 'x', 'Z', 'n'}:
+                remaining_toc.append(entry)
+                continue
+            dest_path = os.path.join(staging_dir, dest_name)
+            os.makedirs(os.path.dirname(dest_path), exist_ok=True)
+            if typecode == 'n':
+                os.symlink(src_name, dest_path)
+                continue
+            shutil.copyfile(src_name, dest_path)
+            os.chmod(dest_path, 0o755 if typecode == 'b' else 0o644)
+
+        if os.path.exists(image_name):
+            os.remove(image_name)
+        try:
+            subprocess.run(
+                ['mksquashfs', staging_dir, image_name, '-noappend', '-all-root', '-quiet'],
+                check=True,
+                stdout=subprocess.DEVNULL,
+            )
+        except FileNotFoundError:
+            raise SystemExit("ERROR: mksquashfs is required to build the filesystem image, but it was not found!")
+        except subprocess.CalledProcessError as e:
+            raise SystemExit(f"ERROR: mksquashfs failed to build the filesystem image (exit code {e.returncode})!")
+
+        # The image is stored uncompressed, so that the bootloader can use it directly from the executable.
+        remaining_toc.append(('pyi-filesystem-image', image_name, False, 'F'))
+        return remaining_toc
+
     def assemble(self):
         logger.info("Building PKG (CArchive) %s", os.path.basename(self.name))
 
@@ -333,6 +551,9 @@ def assemble(self):
                         # DATA with executable bit set (e.g., shell script); turn into binary so that executable bit is
                         # restored on the extracted file.
                         carchive_typecode = 'b'
+                    elif typecode == 'DATA' and self.lazy_extraction and self._is_lazy_extraction_candidate(dest_name):
+                        # Data file that is extracted on demand (onefile only, as we are not excluding binaries).
+                        carchive_typecode = 'X'
                     else:
                         carchive_typecode = self.xformdict[typecode]
                     archive_toc.append((dest_name, src_name, self.cdict.get(typecode, False), carchive_typecode))
@@ -353,9 +574,54 @@ def assemble(self):
 
         # Sort content alphabetically by type and name to enable reproducible builds.
         archive_toc.sort(key=itemgetter(3, 0))
+        if self.filesystem_image:
+            archive_toc = self._build_filesystem_image(archive_toc)
         # Do *not* sort modules and scripts, as their order is important.
         # TODO: Think about having all modules first and then all scripts.
-        CArchiveWriter(self.name, bootstrap_toc + archive_toc, pylib_name=self.python_lib_name)
+        access_order = None
+        if self.layout_profile:
+            access_order = load_access_profile(self.layout_profile)['pkg']
+
+        cache = _get_compression_cache()
+
+        # Write the data of cold entries into the cold archive; the archive is written even if it ends up empty, as
+        # the executable refers to it.
+        cold_entries = set()
+        if self.cold_entries:
+            cold_toc = [
+                entry for entry in archive_toc if entry[3] == 'X' and
+                any(pathlib.PurePath(entry[0]).match(pattern) for pattern in self.cold_entries)
+            ]
+            logger.info(
+                "Building cold PKG (CArchive) %s with %d entries", os.path.basename(self.cold_name), len(cold_toc)
+            )
+            CArchiveWriter(
+                self.cold_name,
+                cold_toc,
+                pylib_name=self.python_lib_name,
+                codecs=self.compression_codecs,
+                format_version=self.archive_format_version,
+                cache=cache,
+                checksums=self.checksums,
+                frame_size=self.frame_size,
+            )
+            cold_entries = {dest_name for dest_name, *_ in cold_toc}
+
+        CArchiveWriter(
+            self.name,
+            bootstrap_toc + archive_toc,
+            pylib_name=self.python_lib_name,
+            codecs=self.compression_codecs,
+            format_version=self.archive_format_version,
+            access_order=access_order,
+            solid_block_size=self.solid_block_size,
+            deduplicate=self.deduplicate_files,
+            cache=cache,
+            checksums=self.checksums,
+            cold_entries=cold_entries,
+            frame_size=self.frame_size,
+        )
+        _log_compression_cache_stats(cache)
 
         logger.info("Building PKG (CArchive) %s completed successfully.", os.path.basename(self.name))
 
@@ -422,6 +688,106 @@ def __init__(self, *args, **kwargs):
             entitlements_file
                 macOS only. Optional path to entitlements file to use with code signing of collected binaries
                 (--entitlements option to codesign utility).
+            compression_codecs
+                Optional dictionary that specifies the compression codec ('zlib', 'zstd', or 'lz4') for compressed
+                entries in the embedded PKG archive, by CArchive typecode (e.g., ``{'b': 'lz4', 'x': 'zstd'}``). See
+                `PKG` for details.
+            archive_format_version
+                Optional format version (1 or 2) of the embedded PKG archive. See `PKG` for details.
+            lazy_extraction
+                Onefile mode only. If True, the data files are not extracted when the application is unpacked, but
+                on demand, when the program first accesses them from python code (by opening them, querying their
+                status, or listing their directory). Data files that are known to be accessed by native code (e.g.,
+                the Tcl/Tk script library) are always extracted eagerly. If set to 'background', the parent process
+                starts the program as soon as the binaries and eagerly-extracted data files are unpacked, and
+                extracts the remaining data files in a background thread while the program is starting up (the files
+                that the program accesses before that are extracted on demand). See `PKG` for details.
+            lazy_extraction_exclude
+                Onefile mode only. Optional list of additional patterns (e.g., ``['mypackage/data/*.bin']``) of data
+                files that should be extracted eagerly when `lazy_extraction` is enabled; for example, files that are
+                opened by native code of the collected extension modules.
+            cold_data
+                Onefile mode with `lazy_extraction` only. Optional list of patterns (e.g., ``['mypackage/models/*']``)
+                of lazily-extracted data files that are stored in a separate cold archive, which is placed next to the
+                executable (as ``<name>.cold.pkg``), instead of in the embedded PKG archive. This keeps the executable
+                small and quick to read at startup, while the rarely-used payloads cost nothing until the program
+                first accesses one of them, at which point the bootloader opens the cold archive. See `PKG` for
+                details.
+            filesystem_image
+                Linux onefile mode only. If True, the collected binaries and data files are stored in a squashfs
+                image, which the bootloader mounts (using `squashfuse`) on the application's temporary directory
+                instead of extracting the files; the startup then costs only the mount, the data is decompressed on
+                access, and the clean-up merely unmounts the image. If the image cannot be mounted, the bootloader
+                unpacks it using `unsquashfs`. Cannot be combined with splash screen, `lazy_extraction`,
+                `memfd_binaries`, or `extraction_cache`. Requires `mksquashfs` at build time.
+            extraction_cache
+                Onefile mode only. If True, the application is unpacked into a persistent per-user cache directory
+                (keyed by the digest of the embedded archive) instead of an ephemeral temporary directory, and the
+                unpacked contents are re-used on subsequent launches. Can be overridden at run-time via the
+                PYINSTALLER_EXTRACTION_CACHE environment variable.
+            memfd_binaries
+                Onefile mode on Linux only. If True, the binaries (shared libraries and extension modules) are
+                extracted into anonymous memory-backed files instead of the temporary directory, which then contains
+                only symbolic links to them (via /proc/self/fd). This avoids writing the largest part of the
+                application to disk, and allows running the application even if the temporary directory is on a
+                filesystem mounted with `noexec` option. Processes that are spawned by the application without
+                inheriting its open file descriptors (for example, `multiprocessing` workers with `spawn` start
+                method) cannot load the extracted binaries. Ignored if `extraction_cache` is enabled.
+            deferred_cleanup
+                Onefile mode only. If True, the temporary directory is not removed when the application exits;
+                instead, it is renamed (which is fast) and left for the next launch of the application, which removes
+                it in a background thread while the application runs. Ignored if `extraction_cache` is enabled.
+            shared_dependency_store
+                Multi-package (`MERGE`) builds only. If True, the dependencies that the program references from other
+                executables of the multi-package build are extracted only once into a shared, per-user store
+                (versioned by the digest of the referenced executable's archive), and hard-linked from there into the
+                program's temporary directory. Dependencies referenced from onedir executables are hard-linked
+                directly from their directory instead of being copied.
+            fork_server
+                Linux and other POSIX systems except macOS only. If enabled, the first launch of the program starts a
+                resident, per-user fork server in the background; subsequent launches of the same executable hand
+                their arguments, environment, working directory and standard streams to the server, which forks the
+                application process from its already-initialized python interpreter. The value is either True, or an
+                integer time (in seconds) after which an idle server exits; the default is 30 minutes. Can be
+                disabled at run-time by setting the PYINSTALLER_FORK_SERVER environment variable to 0.
+            fork_server_warm_modules
+                List of names of modules that the fork server imports before it starts accepting the launches, so
+                that they are already imported in the application process. Used only if `fork_server` is enabled.
+            layout_profile
+                Optional path to the access profile, recorded by running the frozen application with the
+                PYINSTALLER_ACCESS_PROFILE environment variable set. The entries of the embedded PKG archive are laid
+                out in the order of their first access. See `PKG` for details; the same profile can also be passed
+                to `PYZ`.
+            solid_block_size
+                Optional target size (in bytes) of solid blocks, into which consecutive small data files are
+                compressed together in the embedded PKG archive. See `PKG` for details.
+            frame_size
+                Optional frame size (in bytes) of large data files in the embedded PKG archive; the data files that are
+                larger than the frame size are compressed as independent frames, which the bootloader decompresses in
+                parallel, and of which it decompresses only the needed ones when a range of a lazily-extracted file's
+                data is read. See `PKG` for details.
+            deduplicate_files
+                If True, files with identical contents are stored only once in the embedded PKG archive, and the
+                duplicates are extracted as clones of the first copy. See `PKG` for details.
+            verify_checksums
+                If True, the CRC-32 checksums of all entries are stored in the embedded PKG archive, and the bootloader
+                verifies the data of each entry as it is extracted, failing with an error if it does not match. With
+                `extraction_cache` enabled, the files in an existing cache entry are validated (in parallel) before
+                they are re-used, and a damaged entry is extracted anew. Can be overridden at run-time by setting the
+                PYINSTALLER_VERIFY_CHECKSUMS environment variable (0 disables verification).
+            no_restart
+                Linux and other POSIX systems except macOS only. If True, the onedir application (and the parent
+                process of a onefile application with splash screen) does not restart itself to put the modified
+                `LD_LIBRARY_PATH` into effect; instead, the bootloader preloads the bundled shared libraries that are
+                referenced by the collected binaries, by their absolute path and in dependency order. The list of
+                these libraries is determined at build time (using `ldd`). `LD_LIBRARY_PATH` is still set for the
+                processes spawned by the application.
+            lean_bootloader
+                If True, a release (non-debug) executable uses the lean bootloader, which is built without splash
+                screen and multi-package (`MERGE`) support, and is specialized for the running python version. The
+                lean bootloaders are not built by default (see the ``--with-lean`` option of the bootloader's `waf`).
+                If no matching lean bootloader is available, or if the program uses splash screen or `MERGE`, the
+                regular bootloader is used instead.
             contents_directory
                 Onedir mode only. Specifies the name of the directory where all files par the executable will be placed.
                 Setting the name to '.' (or '' or None) re-enables old onedir layout without contents directory.
@@ -445,6 +811,18 @@ def __init__(self, *args, **kwargs):
         self.strip = kwargs.get('strip', False)
         self.upx_exclude = kwargs.get("upx_exclude", [])
         self.runtime_tmpdir = kwargs.get('runtime_tmpdir', None)
+        self.extraction_cache = kwargs.get('extraction_cache', False)
+        self.lazy_extraction = kwargs.get('lazy_extraction', False)
+        self.cold_data = kwargs.get('cold_data', None)
+        self.filesystem_image = kwargs.get('filesystem_image', False)
+        self.memfd_binaries = kwargs.get('memfd_binaries', False)
+        self.deferred_cleanup = kwargs.get('deferred_cleanup', False)
+        self.shared_dependency_store = kwargs.get('shared_dependency_store', False)
+        self.fork_server = kwargs.get('fork_server', False)
+        self.fork_server_warm_modules = kwargs.get('fork_server_warm_modules', [])
+        self.verify_checksums = kwargs.get('verify_checksums', False)
+        self.no_restart = kwargs.get('no_restart', False)
+        self.lean_bootloader = kwargs.get('lean_bootloader', False)
         self.contents_directory = kwargs.get("contents_directory", "_internal")
         # If ``append_pkg`` is false, the archive will not be appended to the exe, but copied beside it.
         self.append_pkg = kwargs.get('append_pkg', True)
@@ -536,6 +914,7 @@ def __init__(self, *args, **kwargs):
         # Create the CArchive PKG in WORKPATH. When instancing PKG(), set name so that guts check can test whether the
         # file already exists.
         self.pkgname = os.path.join(CONF['workpath'], base_name + '.pkg')
+        self.cold_pkgname = None
 
         self.toc = []
 
@@ -562,6 +941,74 @@ def __init__(self, *args, **kwargs):
         if self.runtime_tmpdir is not None:
             self.toc.append(("pyi-runtime-tmpdir " + self.runtime_tmpdir, "", "OPTION"))
 
+        if self.extraction_cache:
+            # no value; presence means "true"
+            self.toc.append(("pyi-extraction-cache", "", "OPTION"))
+
+        if self.lazy_extraction not in {False, None, True, 'background'}:
+            raise ValueError(
+                f"Invalid lazy_extraction value: {self.lazy_extraction!r}! Allowed values: False, True, 'background'"
+            )
+        if self.lazy_extraction == 'background':
+            # no value; presence means "true"
+            self.toc.append(("pyi-background-extraction", "", "OPTION"))
+
+        if self.cold_data:
+            if self.exclude_binaries or not self.lazy_extraction:
+                raise ValueError("The cold_data option requires onefile mode with lazy_extraction enabled!")
+            self.cold_pkgname = os.path.join(CONF['workpath'], base_name + '.cold.pkg')
+            self.toc.append((f"pyi-cold-archive {base_name}.cold.pkg", "", "OPTION"))
+
+        if self.filesystem_image:
+            if self.exclude_binaries or not is_linux:
+                raise ValueError("The filesystem_image option is supported only in onefile mode on Linux!")
+            if self.lazy_extraction or self.memfd_binaries or self.extraction_cache or \
+                    any(isinstance(arg, Splash) for arg in args):
+                raise ValueError(
+                    "The filesystem_image option cannot be combined with splash screen, lazy_extraction, "
+                    "memfd_binaries, or extraction_cache!"
+                )
+
+        if self.memfd_binaries:
+            # no value; presence means "true"
+            self.toc.append(("pyi-memfd-binaries", "", "OPTION"))
+
+        if self.deferred_cleanup:
+            # no value; presence means "true"
+            self.toc.append(("pyi-deferred-cleanup", "", "OPTION"))
+
+        if self.shared_dependency_store:
+            # no value; presence means "true"
+            self.toc.append(("pyi-shared-dependency-store", "", "OPTION"))
+
+        if self.fork_server:
+            # Optional value: the idle timeout, in seconds.
+            if self.fork_server is True:
+                self.toc.append(("pyi-fork-server", "", "OPTION"))
+            elif isinstance(self.fork_server, int) and self.fork_server > 0:
+                self.toc.append((f"pyi-fork-server {self.fork_server}", "", "OPTION"))
+            else:
+                raise ValueError(f"Invalid fork_server value: {self.fork_server!r}! Allowed values: False, True, int")
+            for module_name in self.fork_server_warm_modules:
+                self.toc.append((f"pyi-fork-server-warm-module {module_name}", "", "OPTION"))
+
+        if self.verify_checksums:
+            # no value; presence means "true"
+            self.toc.append(("pyi-verify-checksums", "", "OPTION"))
+
+        if self.no_restart and not (is_win or is_darwin or is_cygwin):
+            # no value; presence means "true"
+            self.toc.append(("pyi-no-restart", "", "OPTION"))
+            # In onefile mode, the parent process needs to preload the bundled dependencies of Tcl/Tk shared libraries
+            # for the splash screen; the list for onedir mode is written by COLLECT.
+            if not self.exclude_binaries:
+                for arg in args:
+                    if not isinstance(arg, Splash):
+                        continue
+                    splash_binaries = [entry for entry in self.toc if entry[0] in arg.splash_requirements]
+                    for dest_name in bindepend.get_preload_order(splash_binaries):
+                        self.toc.append((f"pyi-preload-library {dest_name}", "", "OPTION"))
+
         if self.bootloader_ignore_signals:
             # no value; presence means "true"
             self.toc.append(("pyi-bootloader-ignore-signals", "", "OPTION"))
@@ -664,7 +1111,19 @@ def __init__(self, *args, **kwargs):
             upx_exclude=self.upx_exclude,
             target_arch=self.target_arch,
             codesign_identity=self.codesign_identity,
-            entitlements_file=self.entitlements_file
+            entitlements_file=self.entitlements_file,
+            compression_codecs=kwargs.get('compression_codecs', None),
+            archive_format_version=kwargs.get('archive_format_version', None),
+            lazy_extraction=self.lazy_extraction,
+            lazy_extraction_exclude=kwargs.get('lazy_extraction_exclude', None),
+            layout_profile=kwargs.get('layout_profile', None),
+            solid_block_size=kwargs.get('solid_block_size', None),
+            deduplicate_files=kwargs.get('deduplicate_files', False),
+            checksums=self.verify_checksums,
+            cold_entries=self.cold_data,
+            cold_name=self.cold_pkgname,
+            filesystem_image=self.filesystem_image,
+            frame_size=kwargs.get('frame_size', None),
         )
         self.dependencies = self.pkg.dependencies
 
@@ -679,6 +1138,7 @@ def __init__(self, *args, **kwargs):
         ('name', _check_guts_eq),
         ('console', _check_guts_eq),
         ('debug', _check_guts_eq),
+        ('lean_bootloader', _check_guts_eq),
         ('exclude_binaries', _check_guts_eq),
         ('icon', _check_guts_eq),
         ('versrsrc', _check_guts_eq),
@@ -686,6 +1146,7 @@ def __init__(self, *args, **kwargs):
         ('uac_uiaccess', _check_guts_eq),
         ('manifest', _check_guts_eq),
         ('append_pkg', _check_guts_eq),
+        ('cold_pkgname', _check_guts_eq),
         ('argv_emulation', _check_guts_eq),
         ('target_arch', _check_guts_eq),
         ('codesign_identity', _check_guts_eq),
@@ -709,6 +1170,9 @@ def _check_guts(self, data, last_build):
         if not self.append_pkg and not os.path.exists(self.pkgname):
             logger.info("Rebuilding because %s missing", os.path.basename(self.pkgname))
             return True
+        if self.cold_pkgname and not os.path.exists(self._get_cold_archive_destination(self.name)):
+            logger.info("Rebuilding because %s missing", os.path.basename(self.cold_pkgname))
+            return True
 
         if Target._check_guts(self, data, last_build):
             return True
@@ -734,19 +1198,48 @@ def _makeabs(path):
         else:
             return os.path.join(CONF['specpath'], path)
 
+    def _get_cold_archive_destination(self, exe_name):
+        """
+        Return the path at which the cold archive is placed next to the given executable; the bootloader looks it up
+        in the executable's directory, under the name from the `pyi-cold-archive` OPTION entry.
+        """
+        return os.path.join(os.path.dirname(exe_name), os.path.basename(self.cold_pkgname))
+
     def _bootloader_file(self, exe, extension=None):
         """
-        Pick up the right bootloader file - debug, console, windowed.
+        Pick up the right bootloader file - debug, console, windowed, lean.
         """
         # Having console/windowed bootloader makes sense only on Windows and macOS.
         if is_win or is_darwin:
             if not self.console:
                 exe = exe + 'w'
-        # There are two types of bootloaders:
-        # run     - release, no verbose messages in console.
-        # run_d   - contains verbose messages in console.
+        # There are three types of bootloaders:
+        # run            - release, no verbose messages in console.
+        # run_d          - contains verbose messages in console.
+        # run_lean_pyXY  - release, without splash screen and multi-package support, and specialized for python X.Y.
+        #                  Optional; used only if requested via `lean_bootloader`.
         if self.debug:
+            if self.lean_bootloader:
+                logger.warning("Ignoring lean_bootloader, as there is no lean variant of the debug bootloader.")
             exe = exe + '_d'
+        elif self.lean_bootloader:
+            lean_exe = exe + '_lean_py%d%d' % sys.version_info[:2] + (extension or '')
+            lean_bootloader_file = os.path.join(HOMEPATH, 'PyInstaller', 'bootloader', PLATFORM, lean_exe)
+            if any(typecode in {'SPLASH', 'DEPENDENCY'} for _, _, typecode in self.toc):
+                logger.warning(
+                    "Ignoring lean_bootloader, as the lean bootloader supports neither splash screen nor MERGE."
+                )
+            elif not os.path.isfile(lean_bootloader_file):
+                logger.warning(
+                    "Ignoring lean_bootloader, as the lean bootloader %s is not available; build it with the "
+                    "--with-lean option of waf.", lean_bootloader_file
+                )
+            else:
+                logger.info(
+                    "Using lean bootloader %s (without splash screen and multi-package support, for python %d.%d "
+                    "only)", lean_bootloader_file, *sys.version_info[:2]
+                )
+                return lean_bootloader_file
         if extension:
             exe = exe + extension
         bootloader_file = os.path.join(HOMEPATH, 'PyInstaller', 'bootloader', PLATFORM, exe)
@@ -802,7 +1295,12 @@ def assemble(self):
             logger.info("Converting EXE to target arch (%s)", self.target_arch)
             osxutils.binary_to_target_arch(build_name, self.target_arch, display_name='Bootloader EXE')
 
-        # Step 2: append the PKG, if necessary
+        # Step 2: append the PKG, if necessary; the cold archive (if any) is always placed next to the executable.
+        if self.cold_pkgname:
+            cold_pkg_dst = self._get_cold_archive_destination(build_name)
+            logger.info("Copying cold PKG archive from %s to %s", self.cold_pkgname, cold_pkg_dst)
+            shutil.copyfile(self.cold_pkgname, cold_pkg_dst)
+
         if self.append_pkg:
             append_file = self.pkg.name  # Append PKG
             append_type = 'PKG archive'  # For debug messages
@@ -838,6 +1336,11 @@ def assemble(self):
             if p.returncode:
                 raise SystemError(f"objcopy Failure: {p.returncode} {p.stdout}")
 
+            # Append the locator footer after the (relocated) ELF section headers, at the very end of the file.
+            if self.append_pkg:
+                logger.info("Appending PKG locator to EXE")
+                append_carchive_locator(build_name)
+
         elif is_darwin:
             # macOS: remove signature, append data, and fix-up headers so that the appended data appears to be part of
             # the executable (which is required by strict validation during code-signing).
@@ -871,6 +1374,13 @@ def assemble(self):
             logger.info("Appending %s to EXE", append_type)
             self._retry_operation(self._append_data_to_exe, build_name, append_file)
 
+            # Append the locator footer. On macOS, this is not done, because the code signature must be placed at the
+            # end of the executable; the bootloader falls back to scanning for the cookie in that case (and also when
+            # the executable is signed after the build on other platforms).
+            if self.append_pkg:
+                logger.info("Appending PKG locator to EXE")
+                self._retry_operation(append_carchive_locator, build_name)
+
         # Step 3: post-processing
         if is_win:
             # Set checksum to appease antiviral software. Also set build timestamp to current time to increase entropy
@@ -1116,6 +1626,9 @@ def __init__(self, *args, **kwargs):
         else:
             raise ValueError("No EXE() instance was passed to COLLECT()")
 
+        # If any of the executables runs in no-restart mode, the bootloader needs the list of libraries to preload.
+        self.no_restart = any(isinstance(arg, EXE) and arg.no_restart for arg in args)
+
         self.toc = []
         for arg in args:
             # Valid arguments: EXE object and TOC-like iterables
@@ -1227,8 +1740,22 @@ def assemble(self):
                 or (typecode == 'DATA' and os.access(src_name, os.X_OK))
             ):
                 os.chmod(dest_path, 0o755)
+        if self.no_restart and not (is_win or is_darwin or is_cygwin):
+            self._write_preload_list()
         logger.info("Building COLLECT %s completed successfully.", self.tocbasename)
 
+    def _write_preload_list(self):
+        """
+        Write the list of bundled shared libraries that the bootloader preloads in no-restart mode (see the
+        `no_restart` option of `EXE`) into the contents directory; one destination name per line, in load order.
+        """
+        preload_order = bindepend.get_preload_order(self.toc)
+        logger.info("Writing list of %d libraries to preload in no-restart mode", len(preload_order))
+        preload_list_file = os.path.join(self.name, self.contents_directory or "", PRELOAD_LIST_FILENAME)
+        with open(preload_list_file, 'w', encoding='utf-8') as fp:
+            for dest_name in preload_order:
+                fp.write(dest_name + '\n')
+
 
 class MERGE:
     """
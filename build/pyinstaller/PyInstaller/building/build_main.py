@@ -1244,6 +1244,14 @@ def __add_options(parser):
         default=False,
         help="Clean PyInstaller cache and remove temporary files before building.",
     )
+    parser.add_argument(
+        '--no-compression-cache',
+        dest='compression_cache',
+        action='store_false',
+        default=True,
+        help="Do not re-use (or store) the compressed data of archive entries in the PyInstaller cache; every entry is "
+        "compressed anew.",
+    )
 
 
 def main(
@@ -1267,6 +1275,7 @@ def main(
         CONF.update(pyi_config)
 
     CONF['ui_admin'] = kw.get('ui_admin', False)
+    CONF['compression_cache'] = kw.get('compression_cache', True)
     CONF['ui_access'] = kw.get('ui_uiaccess', False)
 
     build(specfile, distpath, workpath, clean_build)
@@ -649,7 +649,9 @@ def __add_options(parser):
         "will ignore any temp-folder location defined by the run-time OS. The ``_MEIxxxxxx``-folder will be created "
         "here. Please use this option only if you know what you are doing. Note that on POSIX systems, PyInstaller's "
         "bootloader does NOT perform shell-style environment variable expansion on the given path string. Therefore, "
-        "using environment variables (e.g., ``~`` or ``$HOME``) in path will NOT work.",
+        "using environment variables (e.g., ``~`` or ``$HOME``) in path will NOT work. The special value ``auto`` "
+        "makes the bootloader on Linux prefer a RAM-backed location (``$XDG_RUNTIME_DIR`` or ``/dev/shm``) if the "
+        "unpacked application fits there, and use the standard temp-folder locations otherwise.",
     )
     g.add_argument(
         "--bootloader-ignore-signals",
@@ -97,6 +97,15 @@ def __init__(self, image_file, binaries, datas, **kwargs):
         :keyword text_default:
             The default text which will be displayed before the extraction starts. Default: ``"Initializing"``
         :type text_default: str
+        :keyword progress_bar_pos:
+            An optional four-integer tuple ``(x0, y0, x1, y1)`` that represents the bounding box of a progress bar on
+            the splash screen image, in the same coordinate system as ``text_pos``. This parameter also acts like a
+            switch for the progress bar feature. If omitted, no progress bar will be displayed on the splash screen.
+            The progress bar shows the progress of the extraction in onefile mode.
+        :type progress_bar_pos: Tuple[int, int, int, int]
+        :keyword progress_bar_color:
+            An optional color for the progress bar, in the same format as ``text_color``. Default: ``'black'``
+        :type progress_bar_color: str
         :keyword full_tk:
             By default Splash bundles only the necessary files for the splash screen (some tk components). This
             options enables adding full tk and making it a requirement, meaning all tk files will be unpacked before
@@ -123,6 +132,15 @@ def __init__(self, image_file, binaries, datas, **kwargs):
             applications) can cover the splash screen by user bringing them to front. This might be useful for
             frozen applications with long startup times. Default: ``True``
         :type always_on_top: bool
+        :keyword backend:
+            The implementation used to display the splash screen. With ``'tcltk'`` (the default), the splash screen
+            is created by a Tcl/Tk script; this requires the Tcl/Tk shared libraries and script library to be collected
+            and, in onefile mode, to be extracted before the splash screen can be shown. With ``'native'``, the image,
+            the text, and the progress bar are drawn by the bootloader using the platform's native window API (Win32
+            layered window on Windows, Xlib on other POSIX systems), which allows the splash screen to be shown almost
+            immediately. The native backend does not use a script; therefore, ``full_tk`` and ``minify_script`` have
+            no effect, and the text is limited to a single status line. Default: ``'tcltk'``
+        :type backend: str
         """
         from ..config import CONF
         Target.__init__(self)
@@ -132,16 +150,24 @@ def __init__(self, image_file, binaries, datas, **kwargs):
         if is_darwin:
             raise SystemExit("ERROR: Splash screen is not supported on macOS.")
 
-        # Ensure tkinter (and thus Tcl/Tk) is available.
-        if not tcltk_info.available:
-            raise SystemExit(
-                "ERROR: Your platform does not support the splash screen feature, since tkinter is not installed. "
-                "Please install tkinter and try again."
+        self.backend = kwargs.get("backend", "tcltk")
+        if self.backend not in self._BACKENDS:
+            raise ValueError(
+                "Invalid splash screen backend %r; supported backends are: %s" %
+                (self.backend, ", ".join(repr(backend) for backend in self._BACKENDS))
             )
 
-        # Check if the Tcl/Tk version is supported.
-        logger.info("Verifying Tcl/Tk compatibility with splash screen requirements")
-        self._check_tcl_tk_compatibility()
+        if self.backend == 'tcltk':
+            # Ensure tkinter (and thus Tcl/Tk) is available.
+            if not tcltk_info.available:
+                raise SystemExit(
+                    "ERROR: Your platform does not support the splash screen feature, since tkinter is not installed. "
+                    "Please install tkinter and try again."
+                )
+
+            # Check if the Tcl/Tk version is supported.
+            logger.info("Verifying Tcl/Tk compatibility with splash screen requirements")
+            self._check_tcl_tk_compatibility()
 
         # Make image path relative to .spec file
         if not os.path.isabs(image_file):
@@ -165,6 +191,12 @@ def __init__(self, image_file, binaries, datas, **kwargs):
         self.text_color = kwargs.get("text_color", "black")
         self.text_default = kwargs.get("text_default", "Initializing")
 
+        # progress bar options
+        self.progress_bar_pos = kwargs.get("progress_bar_pos", None)
+        self.progress_bar_color = kwargs.get("progress_bar_color", "black")
+        if self.progress_bar_pos is not None and len(self.progress_bar_pos) != 4:
+            raise ValueError("progress_bar_pos must be a tuple of four integers (x0, y0, x1, y1)")
+
         # always-on-top behavior
         self.always_on_top = kwargs.get("always_on_top", True)
 
@@ -175,6 +207,18 @@ def __init__(self, image_file, binaries, datas, **kwargs):
         if self.script_name is None:
             self.script_name = root + '_script.tcl'
 
+        # The native backend draws the splash screen in the bootloader, and does not require Tcl/Tk at all.
+        if self.backend == 'native':
+            self._tkinter_file = None
+            self.uses_tkinter = False
+            self.script = self.text_default if self.text_pos is not None else ''
+            self.tcl_lib = None
+            self.tk_lib = None
+            self.splash_requirements = set()
+            self.binaries = []
+            self.__postinit__()
+            return
+
         # Internal variables
         # Store path to _tkinter extension module, so that guts check can detect if the path changed for some reason.
         self._tkinter_file = tcltk_info.tkinter_extension_file
@@ -262,8 +306,11 @@ def _filter_requirement(filename):
 
         self.__postinit__()
 
+    _BACKENDS = ('tcltk', 'native')
+
     _GUTS = (
         # input parameters
+        ('backend', _check_guts_eq),
         ('image_file', _check_guts_eq),
         ('name', _check_guts_eq),
         ('script_name', _check_guts_eq),
@@ -272,6 +319,8 @@ def _filter_requirement(filename):
         ('text_font', _check_guts_eq),
         ('text_color', _check_guts_eq),
         ('text_default', _check_guts_eq),
+        ('progress_bar_pos', _check_guts_eq),
+        ('progress_bar_color', _check_guts_eq),
         ('always_on_top', _check_guts_eq),
         ('full_tk', _check_guts_eq),
         ('minify_script', _check_guts_eq),
@@ -376,6 +425,10 @@ def _resize_image(_image, _orig_size):
 
         image_file.close()
 
+        if self.backend == 'native':
+            self._assemble_native(image)
+            return
+
         SplashWriter(
             self.name,
             self.splash_requirements,
@@ -386,6 +439,42 @@ def _resize_image(_image, _orig_size):
             self.script
         )
 
+    def _assemble_native(self, image):
+        """
+        Write the splash resources for the native backend. The bootloader does not decode PNG images, so the image is
+        decoded here and stored as raw RGBA pixels; the text and progress bar options are stored in the header.
+        """
+        if not isinstance(image, bytes):
+            with open(image, 'rb') as image_fp:
+                image = image_fp.read()
+        width, height, pixels = _decode_png_rgba(image)
+
+        options = SplashWriter.NativeOptions(
+            image_width=width,
+            image_height=height,
+            always_on_top=self.always_on_top,
+        )
+        if self.text_pos is not None:
+            options.text_pos = tuple(self.text_pos)
+            # As with Tk, positive sizes are in points and negative sizes in pixels; the bootloader expects pixels.
+            options.text_size = -self.text_size if self.text_size < 0 else round(self.text_size * 96 / 72)
+            options.text_color = _parse_color(self.text_color)
+            options.text_font = '' if self.text_font == 'TkDefaultFont' else self.text_font
+        if self.progress_bar_pos is not None:
+            options.progress_bar_pos = tuple(self.progress_bar_pos)
+            options.progress_bar_color = _parse_color(self.progress_bar_color)
+
+        SplashWriter(
+            self.name,
+            self.splash_requirements,
+            '',
+            '',
+            '',
+            pixels,
+            self.script,
+            native_options=options,
+        )
+
     @staticmethod
     def _check_tcl_tk_compatibility():
         tcl_version = tcltk_info.tcl_version  # (major, minor) tuple
@@ -448,7 +537,22 @@ def generate_script(self):
                 'font_size': self.text_size,
                 'default_text': self.text_default,
             })
-        script = splash_templates.build_script(text_options=d, always_on_top=self.always_on_top)
+        progress_bar_options = None
+        if self.progress_bar_pos is not None:
+            logger.debug("Add progress bar support to splash screen")
+            x0, y0, x1, y1 = self.progress_bar_pos
+            progress_bar_options = {
+                'x0': x0,
+                'y0': y0,
+                'x1': x1,
+                'y1': y1,
+                'color': self.progress_bar_color,
+            }
+        script = splash_templates.build_script(
+            text_options=d,
+            always_on_top=self.always_on_top,
+            progress_bar_options=progress_bar_options,
+        )
 
         if self.minify_script:
             # Remove any documentation, empty lines and unnecessary spaces
@@ -474,3 +578,131 @@ def _uses_tkinter(tkinter_file, binaries):
             if pathlib.PurePath(src_name) == tkinter_file:
                 return True
         return False
+
+
+# Color names that are accepted by the native backend when PIL is not available; see `_parse_color`.
+_BASIC_COLORS = {
+    'black': (0, 0, 0),
+    'white': (255, 255, 255),
+    'red': (255, 0, 0),
+    'green': (0, 128, 0),
+    'blue': (0, 0, 255),
+    'yellow': (255, 255, 0),
+    'cyan': (0, 255, 255),
+    'magenta': (255, 0, 255),
+    'gray': (128, 128, 128),
+    'grey': (128, 128, 128),
+    'orange': (255, 165, 0),
+    'turquoise': (64, 224, 208),
+}
+
+
+def _parse_color(color):
+    """
+    Convert a color name or a HTML color code into a 0xRRGGBB integer, for use by the native splash screen backend.
+    """
+    if PILImage:
+        from PIL import ImageColor
+        try:
+            rgb = ImageColor.getrgb(color)[:3]
+        except ValueError as e:
+            raise ValueError("Unsupported splash screen color %r" % (color,)) from e
+    elif re.fullmatch(r'#[0-9a-fA-F]{6}', color):
+        rgb = (int(color[1:3], 16), int(color[3:5], 16), int(color[5:7], 16))
+    elif re.fullmatch(r'#[0-9a-fA-F]{3}', color):
+        rgb = tuple(int(digit * 2, 16) for digit in color[1:])
+    elif color.lower() in _BASIC_COLORS:
+        rgb = _BASIC_COLORS[color.lower()]
+    else:
+        raise ValueError(
+            "Unsupported splash screen color %r; use a HTML color code, or install the Pillow package to use other "
+            "color names." % (color,)
+        )
+    return (rgb[0] << 16) | (rgb[1] << 8) | rgb[2]
+
+
+def _decode_png_rgba(data):
+    """
+    Decode a PNG image, and return a tuple of its width, height, and its pixels as RGBA bytes (row by row, top to
+    bottom). This is used to prepare the image for the native splash screen backend, as the bootloader does not decode
+    PNG images itself. PIL is used if available; otherwise, only non-interlaced images with 8-bit samples are supported.
+    """
+    import zlib
+
+    if PILImage:
+        with PILImage.open(io.BytesIO(data)) as img:
+            img = img.convert('RGBA')
+            return img.width, img.height, img.tobytes()
+
+    if data[:8] != b'\x89PNG\r\n\x1a\n':
+        raise ValueError("Splash screen image is not a PNG file!")
+
+    pos = 8
+    idat = []
+    palette = b''
+    transparency = b''
+    while pos < len(data):
+        length, chunk_type = struct.unpack("!I4s", data[pos:pos + 8])
+        chunk = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if chunk_type == b'IHDR':
+            width, height, bit_depth, color_type, _, _, interlace = struct.unpack("!IIBBBBB", chunk)
+        elif chunk_type == b'PLTE':
+            palette = chunk
+        elif chunk_type == b'tRNS':
+            transparency = chunk
+        elif chunk_type == b'IDAT':
+            idat.append(chunk)
+        elif chunk_type == b'IEND':
+            break
+
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}.get(color_type)
+    if bit_depth != 8 or interlace != 0 or channels is None:
+        raise ValueError(
+            "The splash screen image uses a PNG format that cannot be decoded without PIL (bit depth %d, color type "
+            "%d, interlace %d)! Either install the Pillow package, or save the image as a non-interlaced 8-bit PNG." %
+            (bit_depth, color_type, interlace)
+        )
+
+    raw = zlib.decompress(b''.join(idat))
+    stride = width * channels
+    pixels = bytearray()
+    previous = bytearray(stride)
+    for y in range(height):
+        offset = y * (stride + 1)
+        filter_type = raw[offset]
+        row = bytearray(raw[offset + 1:offset + 1 + stride])
+        for x in range(stride):
+            left = row[x - channels] if x >= channels else 0
+            up = previous[x]
+            if filter_type == 1:
+                row[x] = (row[x] + left) & 0xFF
+            elif filter_type == 2:
+                row[x] = (row[x] + up) & 0xFF
+            elif filter_type == 3:
+                row[x] = (row[x] + ((left + up) >> 1)) & 0xFF
+            elif filter_type == 4:
+                up_left = previous[x - channels] if x >= channels else 0
+                p = left + up - up_left
+                pa, pb, pc = abs(p - left), abs(p - up), abs(p - up_left)
+                predictor = left if pa <= pb and pa <= pc else (up if pb <= pc else up_left)
+                row[x] = (row[x] + predictor) & 0xFF
+        previous = row
+
+        if color_type == 6:
+            pixels += row
+        elif color_type == 2:
+            for x in range(0, stride, 3):
+                pixels += row[x:x + 3] + b'\xff'
+        elif color_type == 0:
+            for value in row:
+                pixels += bytes((value, value, value, 255))
+        elif color_type == 4:
+            for x in range(0, stride, 2):
+                pixels += bytes((row[x], row[x], row[x], row[x + 1]))
+        else:  # color_type == 3
+            for index in row:
+                alpha = transparency[index] if index < len(transparency) else 255
+                pixels += palette[index * 3:index * 3 + 3] + bytes((alpha,))
+
+    return width, height, bytes(pixels)
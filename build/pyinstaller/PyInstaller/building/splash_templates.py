@@ -131,6 +131,27 @@
 set status_text "%(default_text)s"
 """
 
+splash_canvas_progress_bar = r"""
+# Create a progress bar on the canvas, which tracks the variable
+# status_progress. status_progress holds the progress of the
+# extraction in percent, and is updated via C.
+.root.canvas create rectangle \
+        %(x0)d %(y0)d %(x0)d %(y1)d \
+        -fill %(color)s \
+        -outline "" \
+        -tag progressbar
+
+proc canvas_progress_update {canvas tag x0 y0 x1 y1 _var - -}  {
+    upvar $_var var
+    $canvas coords $tag \
+        $x0 $y0 [expr {$x0 + ($x1 - $x0) * $var / 100}] $y1
+}
+trace variable status_progress w \
+    [list canvas_progress_update .root.canvas progressbar \
+        %(x0)d %(y0)d %(x1)d %(y1)d]
+set status_progress 0
+"""
+
 splash_canvas_default_font = r"""
 font create myFont {*}[font actual TkDefaultFont]
 font configure myFont -size %(font_size)d
@@ -201,7 +222,7 @@
 """
 
 
-def build_script(text_options=None, always_on_top=False):
+def build_script(text_options=None, always_on_top=False, progress_bar_options=None):
     """
     This function builds the tcl script for the splash screen.
     """
@@ -220,6 +241,9 @@ def build_script(text_options=None, always_on_top=False):
             script.append(splash_canvas_custom_font % text_options)
         script.append(splash_canvas_text % text_options)
 
+    if progress_bar_options:
+        script.append(splash_canvas_progress_bar % progress_bar_options)
+
     script.append(transparent_setup)
 
     script.append(pack_widgets)
@@ -844,3 +844,24 @@ def create_base_library_zip(filename, modules_toc, code_cache=None):
                 # Use a ZipInfo to set timestamp for deterministic build.
                 info = zipfile.ZipInfo(dest_name)
                 zf.writestr(info, fc.getvalue())
+
+
+def load_access_profile(filename):
+    """
+    Load the archive access profile that was recorded by running the frozen application with the
+    `PYINSTALLER_ACCESS_PROFILE` environment variable set, and return a dictionary with two lists of entry names,
+    `pkg` and `pyz`, for the PKG and PYZ archive, respectively. Each list contains only the first access to each entry,
+    and is ordered by the time of access. Unrecognized records are ignored.
+    """
+    profile = {'pkg': [], 'pyz': []}
+    seen = {'pkg': set(), 'pyz': set()}
+
+    with open(filename, 'r', encoding='utf-8', errors='surrogateescape') as fp:
+        for line in fp:
+            kind, _, name = line.rstrip('\r\n').partition(' ')
+            if kind not in profile or not name or name in seen[kind]:
+                continue
+            seen[kind].add(name)
+            profile[kind].append(name)
+
+    return profile
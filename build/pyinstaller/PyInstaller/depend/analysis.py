@@ -1020,6 +1020,7 @@ def get_bootstrap_modules():
     ]
     if is_win:
         loader_mods.append(('pyimod04_pywin32', os.path.join(loaderpath, 'pyimod04_pywin32.py'), 'PYMODULE'))
+    loader_mods.append(('pyimod05_lazy_extraction', os.path.join(loaderpath, 'pyimod05_lazy_extraction.py'), 'PYMODULE'))
     # The bootstrap script
     loader_mods.append(('pyiboot01_bootstrap', os.path.join(loaderpath, 'pyiboot01_bootstrap.py'), 'PYSOURCE'))
     return loader_mods
@@ -272,6 +272,55 @@ def binary_dependency_analysis(binaries, search_paths=None, symlink_suppression_
     return output_toc
 
 
+def get_preload_order(binaries):
+    """
+    Determine the shared libraries that the bootloader needs to preload (by their absolute path) when the top-level
+    application directory is not on the library search path of the dynamic linker (i.e., in the no-restart mode,
+    where `LD_LIBRARY_PATH` is not in effect for the application process itself).
+
+    These are the top-level shared libraries from the given TOC list that are referenced by any of the collected
+    binaries; once loaded, the dynamic linker resolves the subsequent references by matching their SONAME. Returns
+    the list of their destination names, ordered so that each library comes after its bundled dependencies; symbolic
+    links are resolved to the destination names of their targets.
+    """
+    # Top-level shared libraries and symbolic links; the latter are mapped to the destination name of their target.
+    top_level = {}
+    for dest_name, src_name, typecode in binaries:
+        if os.path.dirname(dest_name):
+            continue
+        if typecode == 'BINARY':
+            top_level[dest_name] = dest_name
+        elif typecode == 'SYMLINK':
+            top_level[dest_name] = os.path.normpath(src_name)
+
+    # Bundled dependencies of each binary. The output of `ldd` lists the transitive dependencies, which results in
+    # the same (valid) order.
+    dependencies = {}
+    for dest_name, src_name, typecode in binaries:
+        if typecode not in {'BINARY', 'EXTENSION'}:
+            continue
+        referenced_names = {os.path.basename(name) for name, _ in get_imports(src_name)}
+        dependencies[dest_name] = {top_level[name] for name in referenced_names if name in top_level} - {dest_name}
+
+    referenced = set().union(*dependencies.values())
+
+    preload_order = []
+    visited = set()
+
+    def _visit(name):
+        if name in visited:
+            return
+        visited.add(name)
+        for dependency in sorted(dependencies.get(name, ())):
+            _visit(dependency)
+        preload_order.append(name)
+
+    for name in sorted(referenced):
+        _visit(name)
+
+    return preload_order
+
+
 #- Low-level import analysis
 
 
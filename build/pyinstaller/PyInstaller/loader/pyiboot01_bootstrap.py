@@ -93,3 +93,9 @@
         continue
     if entry.endswith('.egg'):
         sys.path.append(entry)
+
+# Install the hooks for on-demand extraction of lazily-extracted data files (onefile only). Done after the above scan
+# of the top-level directory, so that the scan does not trigger extraction of all top-level data files.
+import pyimod05_lazy_extraction  # noqa: E402
+
+pyimod05_lazy_extraction.install()
@@ -36,6 +36,132 @@ class ArchiveReadError(RuntimeError):
     pass
 
 
+def build_pyz_prefix_tree(entries):
+    """
+    Compute the prefix tree (trie) of package/module hierarchy from the given iterable of PYZ entries' names and
+    typecodes. Packages are represented by dictionaries of their sub-packages and modules, and modules by empty
+    strings.
+    """
+    tree = dict()
+    for entry_name, typecode in entries:
+        name_components = entry_name.split('.')
+        current = tree
+        if typecode in {PYZ_ITEM_PKG, PYZ_ITEM_NSPKG}:
+            # Package; create new dictionary node for its modules
+            for name_component in name_components:
+                current = current.setdefault(name_component, {})
+        else:
+            # Module; create the leaf node (empty string)
+            for name_component in name_components[:-1]:
+                current = current.setdefault(name_component, {})
+            current[name_components[-1]] = ''
+    return tree
+
+
+class ZlibArchiveTOC:
+    """
+    Read-only, dict-like view of the TOC of PYZ archive (format version 2), which is searched in place instead of being
+    unmarshaled into a dictionary. This way, the cost of opening the archive does not depend on the number of entries.
+
+    The TOC consists of:
+     - header: number of entries, offset of the name table, offset and length of the prefix tree, and the length of
+       the archive's hot prefix; the offsets are relative to the start of TOC. The hot prefix is the leading part of
+       the archive that contains the entries that were accessed during the recorded run of the application (see the
+       `layout_profile` option of PYZ), or zero if the archive was not laid out according to an access profile.
+     - array of fixed-size records, sorted by entry names (UTF-8 encoded): offset and length of entry's name in name
+       table, entry's typecode, and offset and length of entry's data blob in the archive. Immediately follows the
+       header.
+     - name table; UTF-8 encoded entry names, without separators or terminators.
+     - marshaled prefix tree (see `PyInstaller.loader.pyimod02_importers.get_pyz_toc_tree`).
+    """
+    HEADER_FORMAT = '!IIIII'
+    HEADER_LENGTH = struct.calcsize(HEADER_FORMAT)
+
+    RECORD_FORMAT = '!IHBxII'
+    RECORD_LENGTH = struct.calcsize(RECORD_FORMAT)
+
+    def __init__(self, data):
+        self._data = data
+        self._count, self._names_offset, self._tree_offset, self._tree_length, self.hot_length = \
+            struct.unpack_from(self.HEADER_FORMAT, data, 0)
+
+    @classmethod
+    def parse_length(cls, header):
+        """
+        Compute the total length of TOC from its header.
+        """
+        _, _, tree_offset, tree_length, _ = struct.unpack_from(cls.HEADER_FORMAT, header, 0)
+        return tree_offset + tree_length
+
+    def _record(self, index):
+        return struct.unpack_from(self.RECORD_FORMAT, self._data, self.HEADER_LENGTH + index * self.RECORD_LENGTH)
+
+    def _name(self, name_offset, name_length):
+        start = self._names_offset + name_offset
+        return bytes(self._data[start:start + name_length])
+
+    def _find(self, name):
+        """
+        Binary-search the records for the entry with given name; return its record, or None if no such entry exists.
+        """
+        try:
+            key = name.encode('utf-8')
+        except (AttributeError, UnicodeEncodeError):
+            return None
+
+        low = 0
+        high = self._count
+        while low < high:
+            mid = (low + high) // 2
+            record = self._record(mid)
+            entry_name = self._name(record[0], record[1])
+            if entry_name < key:
+                low = mid + 1
+            elif entry_name > key:
+                high = mid
+            else:
+                return record
+        return None
+
+    def get(self, name, default=None):
+        record = self._find(name)
+        if record is None:
+            return default
+        return record[2:]
+
+    def __getitem__(self, name):
+        record = self._find(name)
+        if record is None:
+            raise KeyError(name)
+        return record[2:]
+
+    def __contains__(self, name):
+        return self._find(name) is not None
+
+    def __len__(self):
+        return self._count
+
+    def __iter__(self):
+        return self.keys()
+
+    def keys(self):
+        for index in range(self._count):
+            record = self._record(index)
+            yield self._name(record[0], record[1]).decode('utf-8')
+
+    def values(self):
+        for index in range(self._count):
+            yield self._record(index)[2:]
+
+    def items(self):
+        for index in range(self._count):
+            record = self._record(index)
+            yield self._name(record[0], record[1]).decode('utf-8'), record[2:]
+
+    def load_prefix_tree(self):
+        return marshal.loads(self._data[self._tree_offset:self._tree_offset + self._tree_length])
+
+
 class ZlibArchiveReader:
     """
     Reader for PyInstaller's PYZ (ZlibArchive) archive. The archive is used to store collected byte-compiled Python
@@ -43,9 +169,12 @@ class ZlibArchiveReader:
     """
     _PYZ_MAGIC_PATTERN = b'PYZ\0'
 
-    def __init__(self, filename, start_offset=None, check_pymagic=False):
+    def __init__(self, filename, start_offset=None, check_pymagic=False, data=None, code_loader=None):
         self._filename = filename
         self._start_offset = start_offset
+        self._data = None
+        self._code_loader = None
+        self._zdict = b''
 
         self.toc = {}
 
@@ -53,9 +182,24 @@ def __init__(self, filename, start_offset=None, check_pymagic=False):
         if start_offset is None:
             self._filename, self._start_offset = self._parse_offset_from_filename(filename)
 
+        # If archive's data is provided as a buffer (for example, a memoryview into the executable's memory mapping,
+        # provided by the bootloader), parse the archive and read the entries from it, instead of reading them from
+        # the file. The filename is still used in error messages.
+        #
+        # Additionally, a native code loader can be provided by the bootloader, which decompresses and unmarshals the
+        # module's code object directly from the mapping, in a single call: `code_loader(name, offset, length)`. The
+        # loader also takes the data of the entries that the bootloader decompressed in advance, in the background
+        # (see pyi_pyz_prefetch.c). The loader is used only together with the data buffer that it corresponds to.
+        if data is not None:
+            self._data = memoryview(data)
+            self._code_loader = code_loader
+            self._parse_header_and_toc(self._data, check_pymagic)
+            return
+
         # Parse header and load TOC. Standard header contains 12 bytes: PYZ magic pattern, python bytecode magic
-        # pattern, and offset to TOC (32-bit integer). It might be followed by additional fields, depending on
-        # implementation version.
+        # pattern, and offset to TOC (32-bit integer). It is followed by the archive format version (8-bit integer;
+        # archives written by older versions of PyInstaller have a zero there), and the length of preset compression
+        # dictionary (32-bit integer), which immediately follows the header.
         with open(self._filename, "rb") as fp:
             # Read PYZ magic pattern, located at the start of the file
             fp.seek(self._start_offset, os.SEEK_SET)
@@ -69,12 +213,57 @@ def __init__(self, filename, start_offset=None, check_pymagic=False):
             if check_pymagic and pymagic != PYTHON_MAGIC_NUMBER:
                 raise ArchiveReadError("Python magic pattern mismatch!")
 
-            # Read TOC offset
-            toc_offset, *_ = struct.unpack('!i', fp.read(4))
+            # Read TOC offset, format version, and compression dictionary
+            toc_offset, version, zdict_length = struct.unpack('!iBI', fp.read(9))
+            if version >= 2:
+                self._zdict = fp.read(zdict_length)
 
             # Load TOC
             fp.seek(self._start_offset + toc_offset, os.SEEK_SET)
-            self.toc = dict(marshal.load(fp))
+            if version >= 2:
+                # Read the fixed-size TOC header to obtain the TOC's length, then read the whole TOC at once. It will
+                # be searched in place.
+                toc_header = fp.read(ZlibArchiveTOC.HEADER_LENGTH)
+                toc_length = ZlibArchiveTOC.parse_length(toc_header)
+                self.toc = ZlibArchiveTOC(toc_header + fp.read(toc_length - len(toc_header)))
+            else:
+                self.toc = dict(marshal.load(fp))
+
+    def _parse_header_and_toc(self, data, check_pymagic):
+        """
+        Parse header and load TOC from the archive's data buffer; the buffer-based counterpart of the file-based
+        parsing in `__init__`.
+        """
+        magic_length = len(self._PYZ_MAGIC_PATTERN)
+        pymagic_length = len(PYTHON_MAGIC_NUMBER)
+
+        if data[:magic_length] != self._PYZ_MAGIC_PATTERN:
+            raise ArchiveReadError("PYZ magic pattern mismatch!")
+
+        pymagic = data[magic_length:magic_length + pymagic_length]
+        if check_pymagic and pymagic != PYTHON_MAGIC_NUMBER:
+            raise ArchiveReadError("Python magic pattern mismatch!")
+
+        toc_offset, version, zdict_length = struct.unpack_from('!iBI', data, magic_length + pymagic_length)
+
+        if version >= 2:
+            zdict_offset = magic_length + pymagic_length + 9
+            self._zdict = bytes(data[zdict_offset:zdict_offset + zdict_length])
+
+            # Search the TOC directly in the buffer, without copying it.
+            self.toc = ZlibArchiveTOC(data[toc_offset:])
+        else:
+            # marshal.loads() ignores any data that follows the marshaled object.
+            self.toc = dict(marshal.loads(data[toc_offset:]))
+
+    def load_prefix_tree(self):
+        """
+        Load the prefix tree (trie) of the archive's package/module hierarchy that was computed at build time. Returns
+        None if the archive does not contain one (i.e., if it was written in the old format).
+        """
+        if isinstance(self.toc, ZlibArchiveTOC):
+            return self.toc.load_prefix_tree()
+        return None
 
     @staticmethod
     def _parse_offset_from_filename(filename):
@@ -114,11 +303,40 @@ def extract(self, name, raw=False):
         if typecode == PYZ_ITEM_NSPKG:
             return None
 
-        # Read data blob
+        # Native fast path for code objects.
+        if self._code_loader is not None and typecode in (PYZ_ITEM_MODULE, PYZ_ITEM_PKG) and not raw:
+            try:
+                return self._code_loader(name, entry_offset, entry_length)
+            except EOFError as e:
+                raise ImportError(f"Failed to unmarshal PYZ entry {name!r}!") from e
+
+        # Read data blob; if archive's data buffer is available, slice it without copying.
+        if self._data is not None:
+            obj = self._data[entry_offset:entry_offset + entry_length]
+        else:
+            obj = self._read_blob(entry_offset, entry_length)
+
+        try:
+            if self._zdict:
+                decompressor = zlib.decompressobj(zdict=self._zdict)
+                obj = decompressor.decompress(obj) + decompressor.flush()
+            else:
+                obj = zlib.decompress(obj)
+            if typecode in (PYZ_ITEM_MODULE, PYZ_ITEM_PKG) and not raw:
+                obj = marshal.loads(obj)
+        except EOFError as e:
+            raise ImportError(f"Failed to unmarshal PYZ entry {name!r}!") from e
+
+        return obj
+
+    def _read_blob(self, entry_offset, entry_length):
+        """
+        Read the entry's data blob from the archive file.
+        """
         try:
             with open(self._filename, "rb") as fp:
                 fp.seek(self._start_offset + entry_offset)
-                obj = fp.read(entry_length)
+                return fp.read(entry_length)
         except FileNotFoundError:
             # We open the archive file each time we need to read from it, to avoid locking the file by keeping it open.
             # This allows executable to be deleted or moved (renamed) while it is running, which is useful in certain
@@ -129,12 +347,3 @@ def extract(self, name, raw=False):
                 f"ERROR: {self._filename} appears to have been moved or deleted since this application was launched. "
                 "Continouation from this state is impossible. Exiting now."
             )
-
-        try:
-            obj = zlib.decompress(obj)
-            if typecode in (PYZ_ITEM_MODULE, PYZ_ITEM_PKG) and not raw:
-                obj = marshal.loads(obj)
-        except EOFError as e:
-            raise ImportError(f"Failed to unmarshal PYZ entry {name!r}!") from e
-
-        return obj
@@ -54,6 +54,11 @@ def _decode_source(source_bytes):
 # Global instance of PYZ archive reader. Initialized by install().
 pyz_archive = None
 
+# If the `PYINSTALLER_ACCESS_PROFILE` environment variable is set, the names of PYZ entries are recorded into the
+# profile file (in which the bootloader records the access to PKG entries) as their code objects are loaded. For the
+# format of the file, see the bootloader's `pyi_access_profile.c`. Initialized by install().
+_access_profile = None
+
 # Some runtime hooks might need to traverse available frozen package/module hierarchy to simulate filesystem.
 # Such traversals can be efficiently implemented using a prefix tree (trie), whose computation we defer until first
 # access.
@@ -66,7 +71,12 @@ def get_pyz_toc_tree():
 
     with _pyz_tree_lock:
         if _pyz_tree is None:
-            _pyz_tree = _build_pyz_prefix_tree(pyz_archive)
+            # Archives in current format contain the prefix tree that was computed at build time.
+            _pyz_tree = pyz_archive.load_prefix_tree()
+        if _pyz_tree is None:
+            _pyz_tree = pyimod01_archive.build_pyz_prefix_tree(
+                (entry_name, entry_data[0]) for entry_name, entry_data in pyz_archive.toc.items()
+            )
         return _pyz_tree
 
 
@@ -103,25 +113,6 @@ def get_pyz_toc_tree():
         _TOP_LEVEL_DIRECTORY_PATHS.append(_RESOLVED_ALTERNATIVE_TOP_LEVEL_DIRECTORY)
 
 
-# Helper for computing PYZ prefix tree
-def _build_pyz_prefix_tree(pyz_archive):
-    tree = dict()
-    for entry_name, entry_data in pyz_archive.toc.items():
-        name_components = entry_name.split('.')
-        typecode = entry_data[0]
-        current = tree
-        if typecode in {pyimod01_archive.PYZ_ITEM_PKG, pyimod01_archive.PYZ_ITEM_NSPKG}:
-            # Package; create new dictionary node for its modules
-            for name_component in name_components:
-                current = current.setdefault(name_component, {})
-        else:
-            # Module; create the leaf node (empty string)
-            for name_component in name_components[:-1]:
-                current = current.setdefault(name_component, {})
-            current[name_components[-1]] = ''
-    return tree
-
-
 class PyiFrozenFinder:
     """
     PyInstaller's frozen path entry finder for specific search path.
@@ -500,6 +491,8 @@ def get_code(self, fullname):
 
         https://docs.python.org/3/library/importlib.html#importlib.abc.InspectLoader.get_code
         """
+        if _access_profile is not None:
+            _access_profile.write(f"pyz {self._pyz_entry_name}\n")
         return self._pyz_archive.extract(self._pyz_entry_name)
 
     @_check_name
@@ -645,13 +638,42 @@ def install():
     if not hasattr(sys, '_pyinstaller_pyz'):
         raise RuntimeError("Bootloader did not set sys._pyinstaller_pyz!")
 
+    #
+    # If the executable is memory-mapped, the bootloader additionally stores a read-only memoryview of the PYZ archive's
+    # data into _pyinstaller_pyz_data attribute. In that case, the entries are read directly from the mapping, without
+    # re-opening the executable for each import; otherwise, the reader falls back to reading from the file. Along with
+    # the data, the bootloader provides a native function in _pyinstaller_pyz_load_code attribute, which decompresses
+    # and unmarshals modules' code objects in a single call.
+    pyz_data = getattr(sys, '_pyinstaller_pyz_data', None)
+    pyz_code_loader = getattr(sys, '_pyinstaller_pyz_load_code', None)
+
     try:
-        pyz_archive = pyimod01_archive.ZlibArchiveReader(sys._pyinstaller_pyz, check_pymagic=True)
+        pyz_archive = pyimod01_archive.ZlibArchiveReader(
+            sys._pyinstaller_pyz,
+            check_pymagic=True,
+            data=pyz_data,
+            code_loader=pyz_code_loader,
+        )
     except Exception as e:
         raise RuntimeError("Failed to setup PYZ archive reader!") from e
 
     delattr(sys, '_pyinstaller_pyz')
 
+    # Open the access profile file, if recording is requested; the bootloader has already created it. Use line
+    # buffering, so that our records are interleaved with bootloader's in the order in which they were made.
+    global _access_profile
+
+    access_profile_filename = os.environ.get('PYINSTALLER_ACCESS_PROFILE')
+    if access_profile_filename:
+        try:
+            _access_profile = open(access_profile_filename, 'a', encoding='utf-8', buffering=1)
+        except OSError:
+            trace(f"PyInstaller: failed to open access profile file {access_profile_filename!r}!")
+    if pyz_data is not None:
+        delattr(sys, '_pyinstaller_pyz_data')
+    if pyz_code_loader is not None:
+        delattr(sys, '_pyinstaller_pyz_load_code')
+
     # On Windows, there is finder called `_frozen_importlib.WindowsRegistryFinder`, which looks for Python module
     # locations in Windows registry. The frozen application should not look for those, so remove this finder
     # from `sys.meta_path`.
@@ -0,0 +1,132 @@
+#-----------------------------------------------------------------------------
+# Copyright (c) 2005-2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License with exception
+# for distributing bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#-----------------------------------------------------------------------------
+"""
+Hooks for on-demand extraction of lazily-extracted data files in onefile applications.
+
+In onefile builds with lazy extraction enabled, the bootloader does not extract the data files when unpacking the
+application; it only creates the directory structure. The files are extracted by the bootloader's
+`sys._pyinstaller_lazy_extract` function the first time they are accessed. To this end, the hooks below wrap the
+file access functions (`open`, `os.stat`, `os.lstat`) so that the failed attempt at accessing a not-yet-extracted file
+under `sys._MEIPASS` is retried once the file is extracted, and the directory listing functions (`os.listdir`,
+`os.scandir`) so that the contents of a directory under `sys._MEIPASS` are extracted before it is listed for the first
+time. As `PyiFrozenLoader.get_data` and the `importlib.resources` support use `open`, they are covered as well.
+
+Files that are accessed by native code (for example, by a shared library) bypass these hooks; therefore, the data
+files that are known to be accessed in such way are always extracted eagerly (see `PKG` in `PyInstaller.building.api`).
+"""
+
+import sys
+
+
+def install():
+    """
+    Install the hooks.
+
+    This must be done from a function as opposed to at module-level, because when the module is imported/executed,
+    the import machinery is not completely set up yet.
+    """
+
+    import builtins
+    import io
+    import os
+
+    lazy_extract = getattr(sys, '_pyinstaller_lazy_extract', None)
+    if lazy_extract is None:
+        return  # No lazily-extracted data files.
+    delattr(sys, '_pyinstaller_lazy_extract')
+
+    # Prefixes of the top-level application directory; the real path is used to handle paths that were resolved
+    # through symbolic links.
+    top_level_dirs = {os.path.normcase(sys._MEIPASS), os.path.normcase(os.path.realpath(sys._MEIPASS))}
+
+    # Directories (relative names) that have already been extracted by the directory-listing hooks.
+    extracted_dirs = set()
+
+    def _relative_name(path, resolve):
+        # Return name of the given path relative to the top-level application directory, or None if the path is not
+        # located in that directory (or is not a path at all, e.g., a file descriptor). If `resolve` is set, the path
+        # is also checked with symbolic links in its parent directory path resolved; the file itself does not exist,
+        # and resolving only the parent also prevents `os.path.realpath` from recursing into our `os.lstat` hook.
+        if isinstance(path, int):
+            return None
+        try:
+            path = os.path.abspath(os.fsdecode(os.fspath(path)))
+        except TypeError:
+            return None
+        candidates = [path]
+        if resolve:
+            parent_dir, basename = os.path.split(path)
+            candidates.append(os.path.join(os.path.realpath(parent_dir), basename))
+        for candidate in candidates:
+            candidate_normcase = os.path.normcase(candidate)
+            for top_level_dir in top_level_dirs:
+                if candidate_normcase == top_level_dir:
+                    return ''
+                if candidate_normcase.startswith(top_level_dir + os.sep):
+                    return candidate[len(top_level_dir) + 1:]
+        return None
+
+    def _extract_file(path):
+        name = _relative_name(path, True)
+        if not name:
+            return False
+        return lazy_extract(name, False)
+
+    def _extract_dir(path):
+        name = _relative_name(path, False)
+        if name is None or name in extracted_dirs:
+            return
+        extracted_dirs.add(name)
+        lazy_extract(name, True)
+
+    _orig_open = builtins.open
+    _orig_stat = os.stat
+    _orig_lstat = os.lstat
+    _orig_listdir = os.listdir
+    _orig_scandir = os.scandir
+
+    def _pyi_open(file, *args, **kwargs):
+        try:
+            return _orig_open(file, *args, **kwargs)
+        except FileNotFoundError:
+            if not _extract_file(file):
+                raise
+        return _orig_open(file, *args, **kwargs)
+
+    def _pyi_stat(path, *args, **kwargs):
+        try:
+            return _orig_stat(path, *args, **kwargs)
+        except FileNotFoundError:
+            # Paths relative to `dir_fd` are not supported.
+            if kwargs.get('dir_fd') is not None or not _extract_file(path):
+                raise
+        return _orig_stat(path, *args, **kwargs)
+
+    def _pyi_lstat(path, *args, **kwargs):
+        try:
+            return _orig_lstat(path, *args, **kwargs)
+        except FileNotFoundError:
+            # Paths relative to `dir_fd` are not supported.
+            if kwargs.get('dir_fd') is not None or not _extract_file(path):
+                raise
+        return _orig_lstat(path, *args, **kwargs)
+
+    def _pyi_listdir(path='.'):
+        _extract_dir(path)
+        return _orig_listdir(path)
+
+    def _pyi_scandir(path='.'):
+        _extract_dir(path)
+        return _orig_scandir(path)
+
+    builtins.open = io.open = _pyi_open
+    os.stat = _pyi_stat
+    os.lstat = _pyi_lstat
+    os.listdir = _pyi_listdir
+    os.scandir = _pyi_scandir
@@ -0,0 +1,119 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Recording of archive access order.
+ *
+ * The profile is a text file with one record per line; each record
+ * consists of the archive kind (`pkg` or `pyz`), a space, and the name
+ * of the accessed entry. An entry may be recorded multiple times; only
+ * the first record is relevant. All processes of the application
+ * (onefile parent and child, and the python code running in the latter)
+ * append their records to the same file, and each record is written
+ * out immediately, so that the records from different writers appear
+ * in the order in which they were made.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>  /* free, atexit */
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_path.h"
+#include "pyi_utils.h"
+#include "pyi_thread.h"
+#include "pyi_access_profile.h"
+
+
+/* Recording state */
+static FILE *_pyi_access_profile_fp = NULL;
+
+#if PYI_HAVE_THREADS
+static pyi_mutex_t _pyi_access_profile_mutex;
+#endif
+
+
+static void
+_pyi_access_profile_close(void)
+{
+    if (_pyi_access_profile_fp != NULL) {
+        fclose(_pyi_access_profile_fp);
+        _pyi_access_profile_fp = NULL;
+    }
+}
+
+/*
+ * Enable recording if PYINSTALLER_ACCESS_PROFILE environment variable
+ * is set. The top-level process of the application (i.e., the one that
+ * was not started by the bootloader itself) creates a new profile file;
+ * other processes append their records to it.
+ */
+void
+pyi_access_profile_init(void)
+{
+    char *filename;
+    char *env_var_value;
+    FILE *fp;
+
+    filename = pyi_getenv("PYINSTALLER_ACCESS_PROFILE"); /* strdup'd copy or NULL */
+    if (filename == NULL) {
+        return;
+    }
+    if (filename[0] == 0) {
+        free(filename);
+        return;
+    }
+
+    env_var_value = pyi_getenv("_PYI_PARENT_PROCESS_LEVEL");
+    fp = pyi_path_fopen(filename, env_var_value == NULL ? "wb" : "ab");
+    free(env_var_value);
+
+    if (fp == NULL) {
+        PYI_WARNING("Failed to open access profile file %s!\n", filename);
+        free(filename);
+        return;
+    }
+    free(filename);
+
+#if PYI_HAVE_THREADS
+    if (pyi_mutex_init(&_pyi_access_profile_mutex) < 0) {
+        fclose(fp);
+        return;
+    }
+#endif
+
+    _pyi_access_profile_fp = fp;
+    atexit(_pyi_access_profile_close);
+}
+
+/*
+ * Record the access to data of the PKG archive entry with given name.
+ */
+void
+pyi_access_profile_record(const char *name)
+{
+    if (_pyi_access_profile_fp == NULL) {
+        return;
+    }
+
+#if PYI_HAVE_THREADS
+    pyi_mutex_lock(&_pyi_access_profile_mutex);
+#endif
+
+    fprintf(_pyi_access_profile_fp, "pkg %s\n", name);
+    fflush(_pyi_access_profile_fp);
+
+#if PYI_HAVE_THREADS
+    pyi_mutex_unlock(&_pyi_access_profile_mutex);
+#endif
+}
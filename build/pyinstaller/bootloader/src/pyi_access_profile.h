@@ -0,0 +1,36 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Recording of archive access order. When PYINSTALLER_ACCESS_PROFILE
+ * environment variable is set to a file path, the bootloader records
+ * the names of PKG archive entries in the order in which their data is
+ * accessed, and the frozen importer does the same for the PYZ archive
+ * entries. The resulting profile can be passed to the build (the
+ * `layout_profile` option of PYZ and EXE) to lay out the archives'
+ * entries in the order of their first access.
+ *
+ * When recording is not enabled, the recording function returns
+ * immediately, so the calls can be left in release builds.
+ */
+
+#ifndef PYI_ACCESS_PROFILE_H
+#define PYI_ACCESS_PROFILE_H
+
+#include "pyi_global.h"
+
+void pyi_access_profile_init(void);
+
+void pyi_access_profile_record(const char *name);
+
+#endif /* PYI_ACCESS_PROFILE_H */
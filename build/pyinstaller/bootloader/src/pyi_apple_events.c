@@ -24,6 +24,7 @@
 #if defined(__APPLE__) && defined(WINDOWED)
 
 #include <Carbon/Carbon.h>
+#include <unistd.h> /* getppid */
 
 #include "pyi_main.h"
 #include "pyi_utils.h"
@@ -63,6 +64,10 @@ struct APPLE_EVENT_HANDLER_CONTEXT
     unsigned int retry_count; /* Retry count for send attempts */
     AppleEvent pending_event; /* Copy of the event */
 
+    /* Flag indicating that the initial event delivered by LaunchServices
+     * at application launch (oapp, or odoc/GURL) has been received. */
+    Boolean launch_event_received;
+
     /* Event types used when registering events. The single entry should
      * be initialized to {kEventClassAppleEvent, kEventAppleEvent}
      * when handlers are being set up. */
@@ -378,6 +383,16 @@ convert_event_to_argv(const AppleEvent *theAppleEvent, const AEEventID evtID, st
 }
 
 
+/* Mark the initial launch event as received; see
+ * pyi_apple_process_launch_events(). */
+static void
+mark_launch_event_received(struct PYI_CONTEXT *pyi_ctx)
+{
+    if (pyi_ctx->ae_ctx != NULL) {
+        pyi_ctx->ae_ctx->launch_event_received = true;
+    }
+}
+
 /* 'oapp' event handler
  *
  * Nothing to do here, just make sure we report event as handled.
@@ -385,11 +400,12 @@ convert_event_to_argv(const AppleEvent *theAppleEvent, const AEEventID evtID, st
 static OSErr
 handle_oapp_event(const AppleEvent *theAppleEvent, AppleEvent *reply, SRefCon handlerRefCon)
 {
+    struct PYI_CONTEXT *pyi_ctx = (struct PYI_CONTEXT *)handlerRefCon;
     (void)theAppleEvent; /* unused */
     (void)reply; /* unused */
-    (void)handlerRefCon; /* unused */
 
     PYI_DEBUG("LOADER [AppleEvent]: %s called\n", __FUNCTION__);
+    mark_launch_event_received(pyi_ctx);
     return noErr;
 }
 
@@ -401,6 +417,7 @@ handle_odoc_event(const AppleEvent *theAppleEvent, AppleEvent *reply, SRefCon ha
     (void)reply; /* unused */
 
     PYI_DEBUG("LOADER [AppleEvent]: %s called\n", __FUNCTION__);
+    mark_launch_event_received(pyi_ctx);
 
     /* If child process is running, forward the event */
     if (pyi_ctx->child_pid != 0) {
@@ -425,6 +442,7 @@ handle_gurl_event(const AppleEvent *theAppleEvent, AppleEvent *reply, SRefCon ha
     (void)reply; /* unused */
 
     PYI_DEBUG("LOADER [AppleEvent]: %s called\n", __FUNCTION__);
+    mark_launch_event_received(pyi_ctx);
 
     /* If child process is running, forward the event */
     if (pyi_ctx->child_pid != 0) {
@@ -693,6 +711,42 @@ pyi_apple_uninstall_event_handlers(struct APPLE_EVENT_HANDLER_CONTEXT **ae_ctx_r
 }
 
 
+/* Wait for the next event (with the given timeout, in seconds), and
+ * dispatch it. Returns 0 if an event was processed, 1 on timeout, and
+ * -1 on error. */
+static int
+receive_and_dispatch_event(struct APPLE_EVENT_HANDLER_CONTEXT *ae_ctx, EventTimeout timeout)
+{
+    OSStatus status;
+    EventRef event_ref; /* Event that caused ReceiveNextEvent to return. */
+
+    PYI_DEBUG("LOADER [AppleEvent]: calling ReceiveNextEvent\n");
+    status = ReceiveNextEvent(1, ae_ctx->event_types, timeout, kEventRemoveFromQueue, &event_ref);
+
+    if (status == eventLoopTimedOutErr) {
+        PYI_DEBUG("LOADER [AppleEvent]: ReceiveNextEvent timed out\n");
+        return 1;
+    } else if (status != 0) {
+        PYI_DEBUG("LOADER [AppleEvent]: ReceiveNextEvent fetching events failed\n");
+        return -1;
+    }
+
+    /* We actually pulled an event off the queue, so process it.
+       We now 'own' the event_ref and must release it. */
+    PYI_DEBUG("LOADER [AppleEvent]: ReceiveNextEvent got an EVENT\n");
+
+    PYI_DEBUG("LOADER [AppleEvent]: dispatching event...\n");
+    status = SendEventToEventTarget(event_ref, GetEventDispatcherTarget());
+
+    ReleaseEvent(event_ref);
+    if (status != 0) {
+        PYI_DEBUG("LOADER [AppleEvent]: processing events failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
 /*
  * Apple event message pump; retrieves and processes Apple Events until
  * the specified timeout (in seconds) or an error is reached.
@@ -704,42 +758,70 @@ pyi_apple_process_events(struct APPLE_EVENT_HANDLER_CONTEXT *ae_ctx, float timeo
 
     /* Event pump: process events until timeout (in seconds) or error */
     for (;;) {
-        OSStatus status;
-        EventRef event_ref; /* Event that caused ReceiveNextEvent to return. */
-
         /* If we have a pending event to forward, stop any further processing. */
         if (pyi_apple_has_pending_event(ae_ctx)) {
             PYI_DEBUG("LOADER [AppleEvent]: breaking event loop due to pending event.\n");
             break;
         }
 
-        PYI_DEBUG("LOADER [AppleEvent]: calling ReceiveNextEvent\n");
-        status = ReceiveNextEvent(1, ae_ctx->event_types, timeout, kEventRemoveFromQueue, &event_ref);
+        if (receive_and_dispatch_event(ae_ctx, timeout) != 0) {
+            break;
+        }
+    }
+
+    PYI_DEBUG("LOADER [AppleEvent]: out of the event loop.\n");
+}
+
+/*
+ * Process the launch Apple Events (oapp, or odoc/GURL), returning as
+ * soon as they have been received, instead of always waiting for the
+ * full timeout.
+ */
+void
+pyi_apple_process_launch_events(struct APPLE_EVENT_HANDLER_CONTEXT *ae_ctx, float timeout)
+{
+    EventTime deadline;
+
+    PYI_DEBUG("LOADER [AppleEvent]: processing launch Apple Events...\n");
+    ae_ctx->launch_event_received = false;
+
+    /* Process the events that are already queued. */
+    pyi_apple_process_events(ae_ctx, 0.0);
+    if (ae_ctx->launch_event_received) {
+        PYI_DEBUG("LOADER [AppleEvent]: launch event already received.\n");
+        return;
+    }
+
+    /* Applications that are launched via LaunchServices (from Finder,
+     * Dock, or using the `open` command) are started by launchd, and
+     * always receive a launch event. If we were started by some other
+     * process (e.g., by running the program in the .app bundle directly
+     * from a terminal), there is no launch event to wait for. */
+    if (getppid() != 1) {
+        PYI_DEBUG("LOADER [AppleEvent]: not launched via LaunchServices; not waiting for launch event.\n");
+        return;
+    }
 
-        if (status == eventLoopTimedOutErr) {
-            PYI_DEBUG("LOADER [AppleEvent]: ReceiveNextEvent timed out\n");
+    /* Wait for the launch event; the timeout serves only as safety net. */
+    deadline = GetCurrentEventTime() + timeout;
+    while (!ae_ctx->launch_event_received && !pyi_apple_has_pending_event(ae_ctx)) {
+        EventTime remaining = deadline - GetCurrentEventTime();
+        if (remaining <= 0) {
+            PYI_DEBUG("LOADER [AppleEvent]: timed out while waiting for launch event.\n");
             break;
-        } else if (status != 0) {
-            PYI_DEBUG("LOADER [AppleEvent]: ReceiveNextEvent fetching events failed\n");
+        }
+        if (receive_and_dispatch_event(ae_ctx, remaining) < 0) {
             break;
-        } else {
-            /* We actually pulled an event off the queue, so process it.
-               We now 'own' the event_ref and must release it. */
-            PYI_DEBUG("LOADER [AppleEvent]: ReceiveNextEvent got an EVENT\n");
-
-            PYI_DEBUG("LOADER [AppleEvent]: dispatching event...\n");
-            status = SendEventToEventTarget(event_ref, GetEventDispatcherTarget());
-
-            ReleaseEvent(event_ref);
-            event_ref = NULL;
-            if (status != 0) {
-                PYI_DEBUG("LOADER [AppleEvent]: processing events failed\n");
-                break;
-            }
         }
     }
 
-    PYI_DEBUG("LOADER [AppleEvent]: out of the event loop.\n");
+    /* Process the events that might have been queued along with the
+     * launch event. */
+    if (ae_ctx->launch_event_received) {
+        pyi_apple_process_events(ae_ctx, 0.0);
+    }
+
+    PYI_DEBUG("LOADER [AppleEvent]: finished processing launch Apple Events.\n");
 }
 
 
@@ -44,6 +44,14 @@ void pyi_apple_uninstall_event_handlers(struct APPLE_EVENT_HANDLER_CONTEXT **ae_
  */
 void pyi_apple_process_events(struct APPLE_EVENT_HANDLER_CONTEXT *ae_ctx, float timeout);
 
+/*
+ * Process the Apple Events that are sent at application launch (oapp,
+ * or odoc/GURL if launched to open a file or URL). Returns as soon as
+ * the launch event has been processed, or if no launch event is to be
+ * expected; the timeout (in seconds) serves only as a safety net.
+ */
+void pyi_apple_process_launch_events(struct APPLE_EVENT_HANDLER_CONTEXT *ae_ctx, float timeout);
+
 /* Check if we have a pending event that we need to forward. */
 int pyi_apple_has_pending_event(const struct APPLE_EVENT_HANDLER_CONTEXT *ae_ctx);
 
@@ -16,16 +16,40 @@
  */
 
 #include <stdio.h>
-#include <stddef.h>  /* ptrdiff_t */
+#include <stddef.h>  /* ptrdiff_t, offsetof */
 #include <stdlib.h>  /* malloc */
 #include <string.h>  /* strncmp, strcpy, strcat */
+#include <limits.h>  /* UINT_MAX */
 #include <sys/stat.h>  /* fchmod */
 
+#ifdef _WIN32
+    #include <windows.h>
+    #include <io.h>  /* _get_osfhandle */
+#else
+    #include <sys/mman.h>  /* mmap, munmap, madvise */
+    #include <fcntl.h>  /* posix_fadvise, F_RDADVISE */
+    #include <errno.h>
+    #include <unistd.h>  /* sysconf, pread */
+#endif
+
 /* PyInstaller headers. */
 #include "zlib.h"
+#if defined(HAVE_ZSTD)
+    #include <zstd.h>
+#endif
+#if defined(HAVE_LZ4)
+    #include <lz4frame.h>
+#endif
+#if defined(HAVE_LIBDEFLATE)
+    #include <libdeflate.h>
+#endif
 #include "pyi_global.h"
 #include "pyi_path.h"
+#include "pyi_access_profile.h"
 #include "pyi_archive.h"
+#include "pyi_main.h"
+#include "pyi_stats.h"
+#include "pyi_thread.h"
 #include "pyi_utils.h"
 
 
@@ -35,69 +59,366 @@
 const struct TOC_ENTRY *
 pyi_archive_next_toc_entry(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry)
 {
-    return (const struct TOC_ENTRY *)((const char *)toc_entry + toc_entry->entry_length);
+    return toc_entry + 1;
+}
+
+/*
+ * Return pointer to the name of the TOC entry, stored in the string
+ * table that follows the TOC entries.
+ */
+const char *
+pyi_archive_get_entry_name(const struct TOC_ENTRY *toc_entry)
+{
+    return (const char *)toc_entry + toc_entry->name_offset;
+}
+
+/*
+ * Return the entries of the given group of the typed TOC index (see
+ * ARCHIVE_TOC_GROUP_* definitions), in TOC order. The number of entries
+ * is stored into `count`.
+ */
+const struct TOC_ENTRY *const *
+pyi_archive_get_toc_group(const struct ARCHIVE *archive, int group, size_t *count)
+{
+    *count = archive->toc_group_start[group + 1] - archive->toc_group_start[group];
+    return archive->toc_groups + archive->toc_group_start[group];
+}
+
+
+/*
+ * Extraction session; holds the resources that are needed for the
+ * extraction of entries, and that are re-used between the entries
+ * extracted within the same session: the zlib inflate state (reset
+ * between entries with inflateReset()), the I/O buffers, and the open
+ * handle of the archive file.
+ *
+ * All resources are allocated on demand, when an entry that needs them
+ * is extracted; for example, extracting an uncompressed entry from
+ * a memory-mapped archive requires none of them. A session can be used
+ * with different archives; the archive file handle is re-opened when
+ * the archive changes. A session must not be used by multiple threads
+ * at the same time.
+ */
+struct ARCHIVE_SESSION
+{
+    /* Size of each of the I/O buffers */
+    size_t buffer_size;
+
+    /* I/O buffers; NULL until first needed */
+    unsigned char *buffer_in;
+    unsigned char *buffer_out;
+
+    /* zlib inflate state; valid only if `zstream_initialized` is set */
+    z_stream zstream;
+    bool zstream_initialized;
+
+#if defined(HAVE_LIBDEFLATE)
+    /* libdeflate decompressor, used to decode zlib-compressed entries
+     * in one shot; NULL until first needed */
+    struct libdeflate_decompressor *deflate_decompressor;
+#endif
+
+    /* The most recently decompressed solid block, its TOC entry, and
+     * the archive it belongs to; NULL until first needed */
+    unsigned char *solid_block;
+    const struct TOC_ENTRY *solid_block_entry;
+    const struct ARCHIVE *solid_block_owner;
+
+    /* Running checksum of the data written by the current extraction
+     * into output file; updated only if `compute_checksum` is set */
+    uint32_t checksum;
+    bool compute_checksum;
+};
+
+static void
+_pyi_archive_session_init(struct ARCHIVE_SESSION *session, size_t buffer_size)
+{
+    memset(session, 0, sizeof(struct ARCHIVE_SESSION));
+    session->buffer_size = buffer_size ? buffer_size : PYI_ARCHIVE_SESSION_DEFAULT_BUFFER_SIZE;
+}
+
+static void
+_pyi_archive_session_cleanup(struct ARCHIVE_SESSION *session)
+{
+    if (session->zstream_initialized) {
+        inflateEnd(&session->zstream);
+        session->zstream_initialized = false;
+    }
+#if defined(HAVE_LIBDEFLATE)
+    if (session->deflate_decompressor) {
+        libdeflate_free_decompressor(session->deflate_decompressor);
+        session->deflate_decompressor = NULL;
+    }
+#endif
+    free(session->buffer_in);
+    session->buffer_in = NULL;
+    free(session->buffer_out);
+    session->buffer_out = NULL;
+    free(session->solid_block);
+    session->solid_block = NULL;
+    session->solid_block_entry = NULL;
+    session->solid_block_owner = NULL;
+}
+
+/*
+ * Create a new extraction session, with I/O buffers of the given size
+ * (0 selects the default size, PYI_ARCHIVE_SESSION_DEFAULT_BUFFER_SIZE).
+ * Returns NULL on failure.
+ */
+struct ARCHIVE_SESSION *
+pyi_archive_session_new(size_t buffer_size)
+{
+    struct ARCHIVE_SESSION *session;
+
+    session = (struct ARCHIVE_SESSION *)malloc(sizeof(struct ARCHIVE_SESSION));
+    if (session == NULL) {
+        PYI_PERROR("malloc", "Could not allocate memory for extraction session.\n");
+        return NULL;
+    }
+    _pyi_archive_session_init(session, buffer_size);
+
+    return session;
+}
+
+/*
+ * Free the extraction session and all its resources.
+ */
+void
+pyi_archive_session_free(struct ARCHIVE_SESSION **session_ref)
+{
+    struct ARCHIVE_SESSION *session = *session_ref;
+
+    *session_ref = NULL;
+
+    if (session == NULL) {
+        return;
+    }
+
+    _pyi_archive_session_cleanup(session);
+    free(session);
+}
+
+/*
+ * Return the session's input/output buffer, allocating it if necessary.
+ * Returns NULL on allocation failure; an error message is emitted, with
+ * entry name from the given TOC entry.
+ */
+static unsigned char *
+_pyi_archive_session_get_buffer(struct ARCHIVE_SESSION *session, unsigned char **buffer_ref, const struct TOC_ENTRY *toc_entry)
+{
+    if (*buffer_ref == NULL) {
+        *buffer_ref = (unsigned char *)malloc(session->buffer_size);
+        if (*buffer_ref == NULL) {
+            PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary buffer!\n", pyi_archive_get_entry_name(toc_entry));
+        }
+    }
+    return *buffer_ref;
+}
+
+/*
+ * Return the session's inflate state, ready for decompression of a new
+ * zlib stream. The state is initialized on first use, and reset on
+ * subsequent uses. Returns NULL on failure.
+ */
+static z_stream *
+_pyi_archive_session_get_zstream(struct ARCHIVE_SESSION *session, const struct TOC_ENTRY *toc_entry)
+{
+    z_stream *zstream = &session->zstream;
+    int rc;
+
+    if (session->zstream_initialized) {
+        rc = inflateReset(zstream);
+        if (rc == Z_OK) {
+            return zstream;
+        }
+        PYI_ERROR("Failed to extract %s: inflateReset() failed with return code %d!\n", pyi_archive_get_entry_name(toc_entry), rc);
+        return NULL;
+    }
+
+    zstream->zalloc = Z_NULL;
+    zstream->zfree = Z_NULL;
+    zstream->opaque = Z_NULL;
+    zstream->avail_in = 0;
+    zstream->next_in = Z_NULL;
+    rc = inflateInit(zstream);
+    if (rc != Z_OK) {
+        PYI_ERROR("Failed to extract %s: inflateInit() failed with return code %d!\n", pyi_archive_get_entry_name(toc_entry), rc);
+        return NULL;
+    }
+    session->zstream_initialized = true;
+
+    return zstream;
+}
+
+/*
+ * Read up to `length` bytes at the given offset within the archive
+ * file, using the archive's file handle. The read does not use (or
+ * modify) the shared file position, and is thus safe to be performed
+ * concurrently from multiple threads. Returns the number of read bytes,
+ * which is smaller than `length` only at the end of file, or -1 on
+ * error.
+ */
+static int64_t
+_pyi_archive_pread(const struct ARCHIVE *archive, uint64_t file_offset, void *buffer, size_t length)
+{
+    unsigned char *out_ptr = (unsigned char *)buffer;
+    size_t total_read = 0;
+
+    if (archive->file == NULL) {
+        return -1;
+    }
+
+    while (total_read < length) {
+        size_t chunk_size = length - total_read;
+#ifdef _WIN32
+        HANDLE file_handle = (HANDLE)_get_osfhandle(_fileno(archive->file));
+        OVERLAPPED overlapped;
+        DWORD bytes_read;
+
+        if (chunk_size > 0x40000000) {
+            chunk_size = 0x40000000;
+        }
+        memset(&overlapped, 0, sizeof(overlapped));
+        overlapped.Offset = (DWORD)(file_offset & 0xFFFFFFFF);
+        overlapped.OffsetHigh = (DWORD)(file_offset >> 32);
+        if (!ReadFile(file_handle, out_ptr, (DWORD)chunk_size, &bytes_read, &overlapped)) {
+            if (GetLastError() == ERROR_HANDLE_EOF) {
+                break;
+            }
+            return -1;
+        }
+#else
+        ssize_t bytes_read;
+
+        if (chunk_size > 0x40000000) {
+            chunk_size = 0x40000000;
+        }
+        bytes_read = pread(fileno(archive->file), out_ptr, chunk_size, (off_t)file_offset);
+        if (bytes_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+#endif
+        if (bytes_read == 0) {
+            break;
+        }
+        out_ptr += bytes_read;
+        total_read += (size_t)bytes_read;
+        file_offset += (uint64_t)bytes_read;
+    }
+
+    return (int64_t)total_read;
+}
+
+/*
+ * Read `length` bytes of the PKG archive, starting at the given offset
+ * relative to the start of the archive, into the provided buffer. The
+ * data is copied from the memory mapping, if available, and read from
+ * the archive file otherwise. This function does not modify the archive
+ * structure, and can be called concurrently from multiple threads.
+ * Returns 0 on success, and -1 on error (including short read), without
+ * emitting an error message.
+ */
+int
+pyi_archive_read_at(const struct ARCHIVE *archive, uint64_t offset, void *buffer, size_t length)
+{
+    if (offset > archive->pkg_length || length > archive->pkg_length - offset) {
+        return -1;
+    }
+
+    if (archive->pkg_data && offset <= archive->pkg_data_length && length <= archive->pkg_data_length - offset) {
+        memcpy(buffer, archive->pkg_data + offset, length);
+        return 0;
+    }
+
+    if (_pyi_archive_pread(archive, archive->pkg_offset + offset, buffer, length) != (int64_t)length) {
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * Update the CRC-32 checksum with the given data; unlike zlib's crc32(),
+ * this accepts data of any length.
+ */
+static uint32_t
+_pyi_archive_checksum_update(uint32_t checksum, const unsigned char *data, uint64_t length)
+{
+    while (length > 0) {
+        uInt chunk_size = (length < UINT_MAX) ? (uInt)length : UINT_MAX;
+        checksum = (uint32_t)crc32(checksum, data, chunk_size);
+        data += chunk_size;
+        length -= chunk_size;
+    }
+    return checksum;
 }
 
+/*
+ * Write the extracted data into the output file, and, if the session is
+ * verifying the extracted entry, add it to the session's checksum.
+ * Returns the number of written bytes, as fwrite().
+ */
+static size_t
+_pyi_archive_session_write(struct ARCHIVE_SESSION *session, const unsigned char *data, size_t length, FILE *out_fp)
+{
+    if (session->compute_checksum) {
+        session->checksum = _pyi_archive_checksum_update(session->checksum, data, length);
+    }
+    return fwrite(data, 1, length, out_fp);
+}
 
 /*
  * Helper for pyi_archive_extract/pyi_archive_extract2fs that extracts a
- * compressed file from the archive, and writes it into the provided
+ * zlib-compressed file from the archive, and writes it into the provided
  * file handle or data buffer. Exactly one of out_fp or out_ptr needs
  * to be valid.
  */
 static int
-_pyi_archive_extract_compressed(FILE *archive_fp, const struct TOC_ENTRY *toc_entry, FILE *out_fp, unsigned char *out_ptr)
+_pyi_archive_extract_compressed(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, FILE *out_fp, unsigned char *out_ptr)
 {
-    const size_t CHUNK_SIZE = 8192;
-    unsigned char *buffer_in = NULL;
-    unsigned char *buffer_out = NULL;
+    const size_t CHUNK_SIZE = session->buffer_size;
+    unsigned char *buffer_in;
+    unsigned char *buffer_out;
+    uint64_t read_offset;
     uint64_t remaining_size;
-    z_stream zstream;
+    z_stream *zstream;
     int rc = -1;
 
-    /* Allocate and initialize inflate state */
-    zstream.zalloc = Z_NULL;
-    zstream.zfree = Z_NULL;
-    zstream.opaque = Z_NULL;
-    zstream.avail_in = 0;
-    zstream.next_in = Z_NULL;
-    rc = inflateInit(&zstream);
-    if (rc != Z_OK) {
-        PYI_ERROR("Failed to extract %s: inflateInit() failed with return code %d!\n", toc_entry->name, rc);
+    /* Obtain (initialize or reset) inflate state and I/O buffers */
+    zstream = _pyi_archive_session_get_zstream(session, toc_entry);
+    if (zstream == NULL) {
         return -1;
     }
-
-    /* Allocate I/O buffers */
-    buffer_in = (unsigned char *)malloc(CHUNK_SIZE);
-    if (buffer_in == NULL) {
-        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary input buffer!\n", toc_entry->name);
-        goto cleanup;
-    }
-    buffer_out = (unsigned char *)malloc(CHUNK_SIZE);
-    if (buffer_out == NULL) {
-        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary output buffer!\n", toc_entry->name);
-        goto cleanup;
+    buffer_in = _pyi_archive_session_get_buffer(session, &session->buffer_in, toc_entry);
+    buffer_out = _pyi_archive_session_get_buffer(session, &session->buffer_out, toc_entry);
+    if (buffer_in == NULL || buffer_out == NULL) {
+        return -1;
     }
 
     /* Decompress until deflate stream ends or end of file is reached */
+    read_offset = toc_entry->offset;
     remaining_size = toc_entry->length;
     do {
         /* Read chunk to input buffer */
         size_t chunk_size = (CHUNK_SIZE < remaining_size) ? CHUNK_SIZE : (size_t)remaining_size;
-        if (fread(buffer_in, 1, chunk_size, archive_fp) != chunk_size || ferror(archive_fp)) {
-            rc = -1;
-            goto cleanup;
+        if (pyi_archive_read_at(archive, read_offset, buffer_in, chunk_size) < 0) {
+            PYI_ERROR("Failed to extract %s: failed to read data chunk!\n", pyi_archive_get_entry_name(toc_entry));
+            return -1;
         }
+        read_offset += chunk_size;
         remaining_size -= chunk_size;
 
         /* Run inflate() on input until output buffer is not full. */
-        zstream.avail_in = (uInt)chunk_size;
-        zstream.next_in = buffer_in;
+        zstream->avail_in = (uInt)chunk_size;
+        zstream->next_in = buffer_in;
         do {
             size_t out_len;
-            zstream.avail_out = (uInt)CHUNK_SIZE;
-            zstream.next_out = buffer_out;
-            rc = inflate(&zstream, Z_NO_FLUSH);
+            zstream->avail_out = (uInt)CHUNK_SIZE;
+            zstream->next_out = buffer_out;
+            rc = inflate(zstream, Z_NO_FLUSH);
             switch (rc) {
                 case Z_NEED_DICT:
                     rc = Z_DATA_ERROR; /* and fall through */
@@ -107,10 +428,10 @@ _pyi_archive_extract_compressed(FILE *archive_fp, const struct TOC_ENTRY *toc_en
                     goto decompress_end;
             }
             /* Copy the extracted data */
-            out_len = CHUNK_SIZE - zstream.avail_out;
+            out_len = CHUNK_SIZE - zstream->avail_out;
             if (out_fp) {
                 /* Write to output file */
-                if (fwrite(buffer_out, 1, out_len, out_fp) != out_len || ferror(out_fp)) {
+                if (_pyi_archive_session_write(session, buffer_out, out_len, out_fp) != out_len || ferror(out_fp)) {
                     rc = Z_ERRNO;
                     goto decompress_end;
                 }
@@ -119,7 +440,7 @@ _pyi_archive_extract_compressed(FILE *archive_fp, const struct TOC_ENTRY *toc_en
                 memcpy(out_ptr, buffer_out, out_len);
                 out_ptr += out_len;
             }
-        } while (zstream.avail_out == 0);
+        } while (zstream->avail_out == 0);
         /* Done when inflate() says it's done */
     } while (rc != Z_STREAM_END && remaining_size > 0);
 
@@ -127,15 +448,10 @@ _pyi_archive_extract_compressed(FILE *archive_fp, const struct TOC_ENTRY *toc_en
     if (rc == Z_STREAM_END) {
         rc = 0; /* Success */
     } else {
-        PYI_ERROR("Failed to extract %s: decompression resulted in return code %d!\n", toc_entry->name, rc);
+        PYI_ERROR("Failed to extract %s: decompression resulted in return code %d!\n", pyi_archive_get_entry_name(toc_entry), rc);
         rc = -1;
     }
 
-cleanup:
-    inflateEnd(&zstream);
-    free(buffer_in);
-    free(buffer_out);
-
     return rc;
 }
 
@@ -144,38 +460,36 @@ _pyi_archive_extract_compressed(FILE *archive_fp, const struct TOC_ENTRY *toc_en
  * from the archive into the provided file handle.
  */
 static int
-_pyi_archive_extract2fs_uncompressed(FILE *archive_fp, const struct TOC_ENTRY *toc_entry, FILE *out_fp)
+_pyi_archive_extract2fs_uncompressed(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, FILE *out_fp)
 {
-    const size_t CHUNK_SIZE = 8192;
+    const size_t CHUNK_SIZE = session->buffer_size;
     unsigned char *buffer;
+    uint64_t read_offset;
     uint64_t remaining_size;
-    int rc = 0;
 
-    /* Allocate temporary buffer for a single chunk */
-    buffer = (unsigned char *)malloc(CHUNK_SIZE);
+    /* Obtain temporary buffer for a single chunk */
+    buffer = _pyi_archive_session_get_buffer(session, &session->buffer_in, toc_entry);
     if (buffer == NULL) {
-        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary buffer!\n", toc_entry->name);
         return -1;
     }
 
     /* ... and copy it, chunk by chunk */
+    read_offset = toc_entry->offset;
     remaining_size = toc_entry->uncompressed_length;
     while (remaining_size > 0) {
         size_t chunk_size = (CHUNK_SIZE < remaining_size) ? CHUNK_SIZE : (size_t)remaining_size;
-        if (fread(buffer, chunk_size, 1, archive_fp) < 1) {
-            PYI_PERROR("fread", "Failed to extract %s: failed to read data chunk!\n", toc_entry->name);
-            rc = -1;
-            break;
+        if (pyi_archive_read_at(archive, read_offset, buffer, chunk_size) < 0) {
+            PYI_PERROR("pread", "Failed to extract %s: failed to read data chunk!\n", pyi_archive_get_entry_name(toc_entry));
+            return -1;
         }
-        if (fwrite(buffer, chunk_size, 1, out_fp) < 1) {
-            PYI_PERROR("fwrite", "Failed to extract %s: failed to write data chunk!\n", toc_entry->name);
-            rc = -1;
-            break;
+        if (_pyi_archive_session_write(session, buffer, chunk_size, out_fp) != chunk_size) {
+            PYI_PERROR("fwrite", "Failed to extract %s: failed to write data chunk!\n", pyi_archive_get_entry_name(toc_entry));
+            return -1;
         }
+        read_offset += chunk_size;
         remaining_size -= chunk_size;
     }
-    free(buffer);
-    return rc;
+    return 0;
 }
 
 /*
@@ -183,205 +497,2332 @@ _pyi_archive_extract2fs_uncompressed(FILE *archive_fp, const struct TOC_ENTRY *t
  * the archive into the provided (pre-allocated) buffer.
  */
 static int
-_pyi_archive_extract_uncompressed(FILE *archive_fp, const struct TOC_ENTRY *toc_entry, unsigned char *out_buf)
+_pyi_archive_extract_uncompressed(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, unsigned char *out_buf)
 {
-    const size_t CHUNK_SIZE = 8192;
-    unsigned char *buffer;
-    uint64_t remaining_size;
-
-    /* Read the file into buffer, chunk by chunk */
-    buffer = out_buf;
-    remaining_size = toc_entry->uncompressed_length;
-    while (remaining_size > 0) {
-        size_t chunk_size = (CHUNK_SIZE < remaining_size) ? CHUNK_SIZE : (size_t)remaining_size;
-        if (fread(buffer, chunk_size, 1, archive_fp) < 1) {
-            PYI_PERROR("fread", "Failed to extract %s: failed to read data chunk!\n", toc_entry->name);
-            return -1;
-        }
-        remaining_size -= chunk_size;
-        buffer += chunk_size;
+    if (pyi_archive_read_at(archive, toc_entry->offset, out_buf, (size_t)toc_entry->uncompressed_length) < 0) {
+        PYI_PERROR("pread", "Failed to extract %s: failed to read data!\n", pyi_archive_get_entry_name(toc_entry));
+        return -1;
     }
     return 0;
 }
 
 /*
- * Extract an archive entry into data buffer.
- * Returns pointer to the data (must be freed).
+ * Return pointer to entry's (raw, possibly compressed) data within the
+ * archive's memory mapping, or NULL if archive is not mapped (or if
+ * entry's data is not fully contained within the mapping, in which case
+ * the callers need to fall back to positional reads). The data remains
+ * valid until the archive is freed.
  */
-unsigned char *
-pyi_archive_extract(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry)
+const unsigned char *
+pyi_archive_get_mapped_data(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry)
 {
-    FILE *archive_fp = NULL;
-    unsigned char *data = NULL;
-    int rc = 0;
+    uint64_t data_length;
 
-    /* Open archive (source) file... */
-    archive_fp = pyi_path_fopen(archive->filename, "rb");
-    if (archive_fp == NULL) {
-        PYI_ERROR("Failed to extract %s: failed to open archive file!\n", toc_entry->name);
+    /* Members of solid blocks have no data blob of their own */
+    if (archive->pkg_data == NULL || toc_entry->compression_flag == ARCHIVE_COMPRESSION_SOLID) {
         return NULL;
     }
-    /* ... and seek to the beginning of entry's data */
-    if (pyi_fseek(archive_fp, archive->pkg_offset + toc_entry->offset, SEEK_SET) < 0) {
-        PYI_PERROR("fseek", "Failed to extract %s: failed to seek to the entry's data!\n", toc_entry->name);
-        goto cleanup;
-    }
-
-    /* Allocate the data buffer */
-    data = (unsigned char *)malloc(toc_entry->uncompressed_length);
-    if (data == NULL) {
-        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate data buffer (%u bytes)!\n", toc_entry->name, toc_entry->uncompressed_length);
-        goto cleanup;
-    }
 
-    /* Extract */
-    if (toc_entry->compression_flag == 1) {
-        rc = _pyi_archive_extract_compressed(archive_fp, toc_entry, NULL, data);
-    } else {
-        rc = _pyi_archive_extract_uncompressed(archive_fp, toc_entry, data);
-    }
-    if (rc != 0) {
-        free(data);
-        data = NULL;
+    data_length = toc_entry->compression_flag != ARCHIVE_COMPRESSION_NONE ? toc_entry->length : toc_entry->uncompressed_length;
+    if (toc_entry->offset > archive->pkg_data_length || data_length > archive->pkg_data_length - toc_entry->offset) {
+        return NULL;
     }
 
-cleanup:
-    fclose(archive_fp);
-
-    return data;
+    return archive->pkg_data + toc_entry->offset;
 }
 
 /*
- * Create/extract symbolic link from the archive.
+ * Helper for pyi_archive_extract/pyi_archive_extract2fs that extracts a
+ * zlib-compressed file from the archive's memory mapping (or from other
+ * in-memory buffer containing the entry's data), and writes it into
+ * the provided file handle or data buffer. Exactly one of out_fp or
+ * out_ptr needs to be valid. When extracting into data buffer, the
+ * data is decompressed directly into it.
  */
 static int
-_pyi_archive_create_symlink(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+_pyi_archive_extract_compressed_mapped(struct ARCHIVE_SESSION *session, const unsigned char *data, const struct TOC_ENTRY *toc_entry, FILE *out_fp, unsigned char *out_ptr)
 {
-    char *link_target = NULL;
+    const size_t CHUNK_SIZE = session->buffer_size;
+    unsigned char *buffer_out = NULL;
+    uint64_t in_remaining;
+    uint64_t out_remaining;
+    z_stream *zstream;
     int rc = -1;
 
-    /* Extract symlink target */
-    link_target = (char *)pyi_archive_extract(archive, toc_entry);
-    if (!link_target) {
-        goto cleanup;
+    /* Obtain (initialize or reset) inflate state */
+    zstream = _pyi_archive_session_get_zstream(session, toc_entry);
+    if (zstream == NULL) {
+        return -1;
     }
 
-    /* Create the symbolic link */
-    rc = pyi_path_mksymlink(link_target, output_filename);
+    /* Obtain output buffer, unless decompressing directly into the
+     * output data buffer */
+    if (out_ptr == NULL) {
+        buffer_out = _pyi_archive_session_get_buffer(session, &session->buffer_out, toc_entry);
+        if (buffer_out == NULL) {
+            return -1;
+        }
+    }
 
-cleanup:
-    free(link_target);
+    /* The whole compressed blob is available as input. However, as
+     * zlib's avail_in and avail_out fields are of uInt type, entries
+     * larger than 4 GB need to be fed to inflate() in multiple steps. */
+    in_remaining = toc_entry->length;
+    out_remaining = toc_entry->uncompressed_length;
+    zstream->avail_out = 0;
+    do {
+        size_t out_len;
+
+        if (zstream->avail_in == 0 && in_remaining > 0) {
+            uInt chunk_size = (in_remaining < UINT_MAX) ? (uInt)in_remaining : UINT_MAX;
+            zstream->next_in = (Bytef *)data;
+            zstream->avail_in = chunk_size;
+            data += chunk_size;
+            in_remaining -= chunk_size;
+        }
+
+        if (out_ptr) {
+            /* Decompress directly into output data buffer */
+            if (zstream->avail_out == 0) {
+                uInt chunk_size = (out_remaining < UINT_MAX) ? (uInt)out_remaining : UINT_MAX;
+                zstream->next_out = out_ptr;
+                zstream->avail_out = chunk_size;
+                out_ptr += chunk_size;
+                out_remaining -= chunk_size;
+            }
+            rc = inflate(zstream, Z_NO_FLUSH);
+        } else {
+            /* Decompress chunk by chunk, and write each chunk to output file */
+            zstream->avail_out = (uInt)CHUNK_SIZE;
+            zstream->next_out = buffer_out;
+            rc = inflate(zstream, Z_NO_FLUSH);
+            if (rc != Z_OK && rc != Z_STREAM_END) {
+                break;
+            }
+            out_len = CHUNK_SIZE - zstream->avail_out;
+            if (_pyi_archive_session_write(session, buffer_out, out_len, out_fp) != out_len || ferror(out_fp)) {
+                rc = Z_ERRNO;
+                break;
+            }
+        }
+    } while (rc == Z_OK);
+
+    if (rc == Z_STREAM_END) {
+        rc = 0; /* Success */
+    } else {
+        PYI_ERROR("Failed to extract %s: decompression resulted in return code %d!\n", pyi_archive_get_entry_name(toc_entry), rc);
+        rc = -1;
+    }
 
     return rc;
 }
 
+#if defined(HAVE_ZSTD)
+
 /*
- * Extract an archive entry into specified output file.
+ * Helper for _pyi_archive_extract_compressed_buffer that decompresses
+ * a Zstandard frame, and writes it into the provided file handle or
+ * data buffer.
  */
-int
-pyi_archive_extract2fs(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+static int
+_pyi_archive_extract_zstd(struct ARCHIVE_SESSION *session, const unsigned char *data, const struct TOC_ENTRY *toc_entry, FILE *out_fp, unsigned char *out_ptr)
 {
-    FILE *archive_fp = NULL;
-    FILE *out_fp = NULL;
-    int rc = 0;
+    const size_t CHUNK_SIZE = session->buffer_size;
+    ZSTD_DStream *dstream = NULL;
+    ZSTD_inBuffer in_buffer;
+    ZSTD_outBuffer out_buffer;
+    unsigned char *buffer_out = NULL;
+    size_t ret;
+    int rc = -1;
 
-    /* Handle symbolic links */
-    if (toc_entry->typecode == ARCHIVE_ITEM_SYMLINK) {
-        rc = _pyi_archive_create_symlink(archive, toc_entry, output_filename);
-        if (rc < 0) {
-            PYI_ERROR("Failed to create symbolic link %s!\n", toc_entry->name);
+    if (out_ptr) {
+        /* Decompress directly into output data buffer */
+        ret = ZSTD_decompress(out_ptr, toc_entry->uncompressed_length, data, toc_entry->length);
+        if (ZSTD_isError(ret) || ret != toc_entry->uncompressed_length) {
+            PYI_ERROR("Failed to extract %s: zstd decompression failed: %s\n", pyi_archive_get_entry_name(toc_entry), ZSTD_isError(ret) ? ZSTD_getErrorName(ret) : "size mismatch");
+            return -1;
         }
-        return rc;
+        return 0;
     }
 
-    /* Open target file */
-    out_fp = pyi_path_fopen(output_filename, "wb");
-    if (out_fp == NULL) {
-        PYI_PERROR("fopen", "Failed to extract %s: failed to open target file!\n", toc_entry->name);
+    /* Decompress chunk by chunk, and write each chunk to output file */
+    dstream = ZSTD_createDStream();
+    if (dstream == NULL) {
+        PYI_ERROR("Failed to extract %s: failed to create zstd decompression stream!\n", pyi_archive_get_entry_name(toc_entry));
         return -1;
     }
-
-    /* Open archive (source) file... */
-    archive_fp = pyi_path_fopen(archive->filename, "rb");
-    if (archive_fp == NULL) {
-        PYI_ERROR("Failed to extract %s: failed to open archive file!\n", toc_entry->name);
-        rc = -1;
+    buffer_out = _pyi_archive_session_get_buffer(session, &session->buffer_out, toc_entry);
+    if (buffer_out == NULL) {
         goto cleanup;
     }
-    /* ... and seek to the beginning of entry's data */
-    if (pyi_fseek(archive_fp, archive->pkg_offset + toc_entry->offset, SEEK_SET) < 0) {
-        PYI_PERROR("fseek", "Failed to extract %s: failed to seek to the entry's data!\n", toc_entry->name);
-        rc = -1;
+
+    ZSTD_initDStream(dstream);
+    in_buffer.src = data;
+    in_buffer.size = toc_entry->length;
+    in_buffer.pos = 0;
+    do {
+        out_buffer.dst = buffer_out;
+        out_buffer.size = CHUNK_SIZE;
+        out_buffer.pos = 0;
+        ret = ZSTD_decompressStream(dstream, &out_buffer, &in_buffer);
+        if (ZSTD_isError(ret)) {
+            PYI_ERROR("Failed to extract %s: zstd decompression failed: %s\n", pyi_archive_get_entry_name(toc_entry), ZSTD_getErrorName(ret));
+            goto cleanup;
+        }
+        if (_pyi_archive_session_write(session, buffer_out, out_buffer.pos, out_fp) != out_buffer.pos || ferror(out_fp)) {
+            PYI_PERROR("fwrite", "Failed to extract %s: failed to write data!\n", pyi_archive_get_entry_name(toc_entry));
+            goto cleanup;
+        }
+        /* ret == 0 signals that the frame has been fully decoded */
+    } while (ret != 0 && (in_buffer.pos < in_buffer.size || out_buffer.pos == out_buffer.size));
+
+    if (ret != 0) {
+        PYI_ERROR("Failed to extract %s: truncated zstd frame!\n", pyi_archive_get_entry_name(toc_entry));
         goto cleanup;
     }
 
-    /* Extract */
-    if (toc_entry->compression_flag == 1) {
-        rc = _pyi_archive_extract_compressed(archive_fp, toc_entry, out_fp, NULL);
-    } else {
-        rc = _pyi_archive_extract2fs_uncompressed(archive_fp, toc_entry, out_fp);
-    }
-#ifndef WIN32
-    if (toc_entry->typecode == ARCHIVE_ITEM_BINARY) {
-        fchmod(fileno(out_fp), S_IRUSR | S_IWUSR | S_IXUSR);
-    } else {
-        fchmod(fileno(out_fp), S_IRUSR | S_IWUSR);
+    rc = 0;
+
+cleanup:
+    ZSTD_freeDStream(dstream);
+
+    return rc;
+}
+
+#endif /* defined(HAVE_ZSTD) */
+
+#if defined(HAVE_LZ4)
+
+/*
+ * Helper for _pyi_archive_extract_compressed_buffer that decompresses
+ * an LZ4 frame, and writes it into the provided file handle or data
+ * buffer.
+ */
+static int
+_pyi_archive_extract_lz4(struct ARCHIVE_SESSION *session, const unsigned char *data, const struct TOC_ENTRY *toc_entry, FILE *out_fp, unsigned char *out_ptr)
+{
+    const size_t CHUNK_SIZE = session->buffer_size;
+    LZ4F_dctx *dctx = NULL;
+    LZ4F_errorCode_t err;
+    unsigned char *buffer_out = NULL;
+    const unsigned char *in_ptr = data;
+    size_t in_remaining = toc_entry->length;
+    size_t out_produced = 0;
+    size_t ret;
+    int rc = -1;
+
+    err = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+    if (LZ4F_isError(err)) {
+        PYI_ERROR("Failed to extract %s: failed to create lz4 decompression context: %s\n", pyi_archive_get_entry_name(toc_entry), LZ4F_getErrorName(err));
+        return -1;
+    }
+
+    if (out_fp) {
+        buffer_out = _pyi_archive_session_get_buffer(session, &session->buffer_out, toc_entry);
+        if (buffer_out == NULL) {
+            goto cleanup;
+        }
+    }
+
+    do {
+        size_t in_size = in_remaining;
+        size_t out_size;
+        unsigned char *dest;
+
+        /* When extracting into data buffer, decompress directly into it */
+        if (out_ptr) {
+            dest = out_ptr + out_produced;
+            out_size = toc_entry->uncompressed_length - out_produced;
+        } else {
+            dest = buffer_out;
+            out_size = CHUNK_SIZE;
+        }
+
+        ret = LZ4F_decompress(dctx, dest, &out_size, in_ptr, &in_size, NULL);
+        if (LZ4F_isError(ret)) {
+            PYI_ERROR("Failed to extract %s: lz4 decompression failed: %s\n", pyi_archive_get_entry_name(toc_entry), LZ4F_getErrorName(ret));
+            goto cleanup;
+        }
+        in_ptr += in_size;
+        in_remaining -= in_size;
+        out_produced += out_size;
+
+        if (out_fp && (_pyi_archive_session_write(session, buffer_out, out_size, out_fp) != out_size || ferror(out_fp))) {
+            PYI_PERROR("fwrite", "Failed to extract %s: failed to write data!\n", pyi_archive_get_entry_name(toc_entry));
+            goto cleanup;
+        }
+
+        /* Guard against lack of progress (e.g., truncated input) */
+        if (in_size == 0 && out_size == 0) {
+            break;
+        }
+        /* ret == 0 signals that the frame has been fully decoded */
+    } while (ret != 0);
+
+    if (ret != 0 || out_produced != toc_entry->uncompressed_length) {
+        PYI_ERROR("Failed to extract %s: truncated or corrupted lz4 frame!\n", pyi_archive_get_entry_name(toc_entry));
+        goto cleanup;
+    }
+
+    rc = 0;
+
+cleanup:
+    LZ4F_freeDecompressionContext(dctx);
+
+    return rc;
+}
+
+#endif /* defined(HAVE_LZ4) */
+
+#if defined(HAVE_LIBDEFLATE)
+
+/*
+ * Helper for _pyi_archive_extract_compressed_buffer that decodes a zlib
+ * stream in one shot, using libdeflate; its decoder refills the bit
+ * buffer a machine word at a time, copies matches in word-sized (or
+ * vector) chunks, and uses a vectorized Adler-32 implementation, which
+ * makes it considerably faster than zlib's inflate() on whole entries.
+ *
+ * When writing into output file, the entry is decoded into a temporary
+ * buffer first, provided that its size does not exceed the
+ * PYI_ARCHIVE_ONESHOT_MAX_LENGTH limit. Returns 1 if the entry is not
+ * eligible and needs to be decoded by zlib.
+ */
+static int
+_pyi_archive_extract_libdeflate(struct ARCHIVE_SESSION *session, const unsigned char *data, const struct TOC_ENTRY *toc_entry, FILE *out_fp, unsigned char *out_ptr)
+{
+    unsigned char *buffer_out = NULL;
+    enum libdeflate_result result;
+    int rc = -1;
+
+    if (out_ptr == NULL && toc_entry->uncompressed_length > PYI_ARCHIVE_ONESHOT_MAX_LENGTH) {
+        return 1;
+    }
+
+    if (session->deflate_decompressor == NULL) {
+        session->deflate_decompressor = libdeflate_alloc_decompressor();
+        if (session->deflate_decompressor == NULL) {
+            return 1;
+        }
+    }
+
+    if (out_ptr == NULL) {
+        /* Allocate at least one byte, so that empty entry is not mistaken for allocation failure */
+        buffer_out = (unsigned char *)malloc((size_t)toc_entry->uncompressed_length + 1);
+        if (buffer_out == NULL) {
+            return 1;
+        }
+    }
+
+    /* Passing NULL as the actual output size requires the output to
+     * fill the buffer exactly. */
+    result = libdeflate_zlib_decompress(
+        session->deflate_decompressor,
+        data,
+        (size_t)toc_entry->length,
+        out_ptr ? out_ptr : buffer_out,
+        (size_t)toc_entry->uncompressed_length,
+        NULL
+    );
+    if (result != LIBDEFLATE_SUCCESS) {
+        PYI_ERROR("Failed to extract %s: decompression resulted in return code %d!\n", pyi_archive_get_entry_name(toc_entry), (int)result);
+        goto cleanup;
+    }
+
+    if (out_fp && _pyi_archive_session_write(session, buffer_out, (size_t)toc_entry->uncompressed_length, out_fp) != toc_entry->uncompressed_length) {
+        PYI_PERROR("fwrite", "Failed to extract %s: failed to write data!\n", pyi_archive_get_entry_name(toc_entry));
+        goto cleanup;
+    }
+
+    rc = 0;
+
+cleanup:
+    free(buffer_out);
+
+    return rc;
+}
+
+#endif /* defined(HAVE_LIBDEFLATE) */
+
+/*
+ * Helper for pyi_archive_extract/pyi_archive_extract2fs that extracts
+ * a compressed file whose data is fully available in memory (either
+ * in archive's memory mapping, or in a temporary buffer), using the
+ * compression method specified by the entry's compression flag. Exactly
+ * one of out_fp or out_ptr needs to be valid.
+ */
+static int
+_pyi_archive_extract_compressed_buffer(struct ARCHIVE_SESSION *session, const unsigned char *data, const struct TOC_ENTRY *toc_entry, FILE *out_fp, unsigned char *out_ptr)
+{
+    switch (toc_entry->compression_flag) {
+        case ARCHIVE_COMPRESSION_ZLIB: {
+#if defined(HAVE_LIBDEFLATE)
+            int rc = _pyi_archive_extract_libdeflate(session, data, toc_entry, out_fp, out_ptr);
+            if (rc != 1) {
+                return rc;
+            }
+#endif
+            return _pyi_archive_extract_compressed_mapped(session, data, toc_entry, out_fp, out_ptr);
+        }
+#if defined(HAVE_ZSTD)
+        case ARCHIVE_COMPRESSION_ZSTD: {
+            return _pyi_archive_extract_zstd(session, data, toc_entry, out_fp, out_ptr);
+        }
+#endif
+#if defined(HAVE_LZ4)
+        case ARCHIVE_COMPRESSION_LZ4: {
+            return _pyi_archive_extract_lz4(session, data, toc_entry, out_fp, out_ptr);
+        }
+#endif
+        default: {
+            break;
+        }
+    }
+
+    PYI_ERROR("Failed to extract %s: unsupported compression method %d!\n", pyi_archive_get_entry_name(toc_entry), toc_entry->compression_flag);
+    return -1;
+}
+
+/*
+ * Helper for pyi_archive_extract/pyi_archive_extract2fs that extracts a
+ * compressed file from the archive file (i.e., when archive is not
+ * memory-mapped), using positional reads. zlib streams are decompressed in chunks (unless they
+ * can be decoded in one shot by libdeflate); for other compression
+ * methods, the compressed data is read into a temporary buffer first.
+ */
+static int
+_pyi_archive_extract_compressed_file(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, FILE *out_fp, unsigned char *out_ptr)
+{
+    unsigned char *buffer_in;
+    int rc;
+
+    if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_ZLIB) {
+#if defined(HAVE_LIBDEFLATE)
+        if (toc_entry->length > PYI_ARCHIVE_ONESHOT_MAX_LENGTH || (out_ptr == NULL && toc_entry->uncompressed_length > PYI_ARCHIVE_ONESHOT_MAX_LENGTH)) {
+            return _pyi_archive_extract_compressed(session, archive, toc_entry, out_fp, out_ptr);
+        }
+#else
+        return _pyi_archive_extract_compressed(session, archive, toc_entry, out_fp, out_ptr);
+#endif
+    }
+
+    buffer_in = (unsigned char *)malloc((size_t)toc_entry->length);
+    if (buffer_in == NULL) {
+        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate temporary input buffer!\n", pyi_archive_get_entry_name(toc_entry));
+        return -1;
+    }
+    if (pyi_archive_read_at(archive, toc_entry->offset, buffer_in, (size_t)toc_entry->length) < 0) {
+        PYI_PERROR("pread", "Failed to extract %s: failed to read data!\n", pyi_archive_get_entry_name(toc_entry));
+        free(buffer_in);
+        return -1;
+    }
+
+    rc = _pyi_archive_extract_compressed_buffer(session, buffer_in, toc_entry, out_fp, out_ptr);
+
+    free(buffer_in);
+
+    return rc;
+}
+
+/*
+ * Account the data of the given entry in the run-time statistics.
+ * Members of solid blocks are accounted through their block.
+ */
+void
+pyi_archive_account_entry(const struct TOC_ENTRY *toc_entry)
+{
+    if (toc_entry->compression_flag != ARCHIVE_COMPRESSION_NONE) {
+        pyi_stats_add(&global_pyi_ctx->stats.archive_bytes_read, toc_entry->length);
+        pyi_stats_add(&global_pyi_ctx->stats.bytes_inflated, toc_entry->uncompressed_length);
+    } else {
+        pyi_stats_add(&global_pyi_ctx->stats.archive_bytes_read, toc_entry->uncompressed_length);
+    }
+}
+
+/*
+ * Helpers for decoding multi-byte integers from (possibly unaligned)
+ * archive data with given byte order.
+ */
+static uint32_t
+_pyi_archive_read_be32(const unsigned char *data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+static uint32_t
+_pyi_archive_read_le32(const unsigned char *data)
+{
+    return ((uint32_t)data[3] << 24) | ((uint32_t)data[2] << 16) | ((uint32_t)data[1] << 8) | (uint32_t)data[0];
+}
+
+static uint64_t
+_pyi_archive_read_le64(const unsigned char *data)
+{
+    return ((uint64_t)_pyi_archive_read_le32(data + 4) << 32) | _pyi_archive_read_le32(data);
+}
+
+/*
+ * Frame index of a framed entry, decoded from the entry's data blob.
+ * `offsets` holds `num_frames + 1` offsets of the frames, relative to
+ * the start of the blob, in host byte order.
+ */
+struct _PYI_ARCHIVE_FRAME_INDEX
+{
+    uint64_t frame_size;
+    uint64_t num_frames;
+    unsigned char compression_flag;
+    uint64_t *offsets;
+};
+
+/*
+ * TOC entry describing a single frame of a framed entry, so that the
+ * frame can be decoded by the same helpers as regular compressed
+ * entries. The name of the framed entry is copied into the structure,
+ * where the entry's `name_offset` points to; the error messages about
+ * the frame therefore refer to the framed entry.
+ */
+struct _PYI_ARCHIVE_FRAME_ENTRY
+{
+    struct TOC_ENTRY toc_entry;
+    char name[PYI_PATH_MAX];
+};
+
+/*
+ * Read and validate the frame index of the given framed entry. The
+ * entry's data blob is read from `blob` (the entry's data within the
+ * archive's memory mapping), or, if it is NULL, from the archive file.
+ * On success, the index needs to be released by the caller, by freeing
+ * its `offsets` array. Returns 0 on success, and -1 on error.
+ */
+static int
+_pyi_archive_load_frame_index(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const unsigned char *blob, struct _PYI_ARCHIVE_FRAME_INDEX *index)
+{
+    unsigned char header[sizeof(struct ARCHIVE_FRAME_HEADER)];
+    unsigned char *raw_buffer = NULL;
+    const unsigned char *raw_offsets;
+    uint64_t index_length;
+    uint64_t i;
+
+    memset(index, 0, sizeof(struct _PYI_ARCHIVE_FRAME_INDEX));
+
+    if (toc_entry->length < sizeof(header)) {
+        goto invalid;
+    }
+    if (blob) {
+        memcpy(header, blob, sizeof(header));
+    } else if (pyi_archive_read_at(archive, toc_entry->offset, header, sizeof(header)) < 0) {
+        PYI_PERROR("pread", "Failed to extract %s: failed to read frame header!\n", pyi_archive_get_entry_name(toc_entry));
+        return -1;
+    }
+
+    index->frame_size = _pyi_archive_read_le32(header + offsetof(struct ARCHIVE_FRAME_HEADER, frame_size));
+    index->num_frames = _pyi_archive_read_le32(header + offsetof(struct ARCHIVE_FRAME_HEADER, num_frames));
+    index->compression_flag = header[offsetof(struct ARCHIVE_FRAME_HEADER, compression_flag)];
+
+    /* All frames but the last one are full */
+    if (index->frame_size == 0 || index->frame_size > ARCHIVE_FRAME_SIZE_MAX) {
+        goto invalid;
+    }
+    if (index->num_frames != toc_entry->uncompressed_length / index->frame_size + (toc_entry->uncompressed_length % index->frame_size != 0)) {
+        goto invalid;
+    }
+    if (index->compression_flag != ARCHIVE_COMPRESSION_ZLIB && index->compression_flag != ARCHIVE_COMPRESSION_ZSTD && index->compression_flag != ARCHIVE_COMPRESSION_LZ4) {
+        goto invalid;
+    }
+
+    index_length = (index->num_frames + 1) * sizeof(uint64_t);
+    if (index_length > toc_entry->length - sizeof(header) || index_length > (uint64_t)SIZE_MAX) {
+        goto invalid;
+    }
+
+    index->offsets = (uint64_t *)malloc((size_t)index_length);
+    if (index->offsets == NULL) {
+        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate frame index!\n", pyi_archive_get_entry_name(toc_entry));
+        return -1;
+    }
+
+    if (blob) {
+        raw_offsets = blob + sizeof(header);
+    } else {
+        raw_buffer = (unsigned char *)malloc((size_t)index_length);
+        if (raw_buffer == NULL) {
+            PYI_PERROR("malloc", "Failed to extract %s: failed to allocate frame index!\n", pyi_archive_get_entry_name(toc_entry));
+            goto error;
+        }
+        if (pyi_archive_read_at(archive, toc_entry->offset + sizeof(header), raw_buffer, (size_t)index_length) < 0) {
+            PYI_PERROR("pread", "Failed to extract %s: failed to read frame index!\n", pyi_archive_get_entry_name(toc_entry));
+            goto error;
+        }
+        raw_offsets = raw_buffer;
+    }
+
+    /* The frames follow the index, back-to-back, and end at the end of
+     * the blob */
+    for (i = 0; i <= index->num_frames; i++) {
+        index->offsets[i] = _pyi_archive_read_le64(raw_offsets + i * sizeof(uint64_t));
+        if (index->offsets[i] < (i ? index->offsets[i - 1] : sizeof(header) + index_length)) {
+            free(raw_buffer);
+            goto invalid;
+        }
+    }
+    free(raw_buffer);
+    if (index->offsets[index->num_frames] != toc_entry->length) {
+        goto invalid;
+    }
+
+    return 0;
+
+invalid:
+    PYI_ERROR("Failed to extract %s: invalid frame index!\n", pyi_archive_get_entry_name(toc_entry));
+    free(index->offsets);
+    index->offsets = NULL;
+    return -1;
+
+error:
+    free(raw_buffer);
+    free(index->offsets);
+    index->offsets = NULL;
+    return -1;
+}
+
+/*
+ * Frames of a framed entry that are decompressed into a contiguous
+ * output buffer, possibly by multiple threads; each of them claims the
+ * next frame to decompress, until all frames are claimed, or until one
+ * of them fails.
+ */
+struct _PYI_ARCHIVE_FRAME_JOB
+{
+    const struct ARCHIVE *archive;
+    const struct TOC_ENTRY *toc_entry;
+    const struct _PYI_ARCHIVE_FRAME_INDEX *index;
+    const unsigned char *blob;
+
+    /* Range of frames; the data of frame `first_frame` is decompressed
+     * at the start of `out_ptr`. */
+    uint64_t first_frame;
+    uint64_t end_frame;
+    unsigned char *out_ptr;
+
+    /* Guards `next_frame` and `failed`, if the job is run by multiple
+     * threads (`is_shared`). */
+#if PYI_HAVE_THREADS
+    pyi_mutex_t mutex;
+#endif
+    bool is_shared;
+    uint64_t next_frame;
+    bool failed;
+};
+
+/*
+ * Claim the next frame of the job. Returns false if there are no more
+ * frames to decompress.
+ */
+static bool
+_pyi_archive_frame_job_claim(struct _PYI_ARCHIVE_FRAME_JOB *job, bool failed, uint64_t *frame)
+{
+    bool claimed = false;
+
+#if PYI_HAVE_THREADS
+    if (job->is_shared) {
+        pyi_mutex_lock(&job->mutex);
+    }
+#endif
+    job->failed = job->failed || failed;
+    if (!job->failed && job->next_frame < job->end_frame) {
+        *frame = job->next_frame++;
+        claimed = true;
+    }
+#if PYI_HAVE_THREADS
+    if (job->is_shared) {
+        pyi_mutex_unlock(&job->mutex);
+    }
+#endif
+
+    return claimed;
+}
+
+/*
+ * Decompress the frames of the job, using the given extraction session,
+ * until there are no more frames to claim.
+ */
+static void
+_pyi_archive_frame_job_run(struct _PYI_ARCHIVE_FRAME_JOB *job, struct ARCHIVE_SESSION *session)
+{
+    const struct _PYI_ARCHIVE_FRAME_INDEX *index = job->index;
+    struct _PYI_ARCHIVE_FRAME_ENTRY frame_entry;
+    struct TOC_ENTRY *frame_toc_entry = &frame_entry.toc_entry;
+    uint64_t frame;
+    bool failed = false;
+
+    memset(frame_toc_entry, 0, sizeof(struct TOC_ENTRY));
+    snprintf(frame_entry.name, sizeof(frame_entry.name), "%s", pyi_archive_get_entry_name(job->toc_entry));
+    frame_toc_entry->name_offset = (uint32_t)offsetof(struct _PYI_ARCHIVE_FRAME_ENTRY, name);
+    frame_toc_entry->name_length = (uint32_t)strlen(frame_entry.name);
+    frame_toc_entry->compression_flag = index->compression_flag;
+    frame_toc_entry->typecode = job->toc_entry->typecode;
+
+    while (_pyi_archive_frame_job_claim(job, failed, &frame)) {
+        uint64_t data_offset = frame * index->frame_size;
+        unsigned char *out_ptr = job->out_ptr + (size_t)(data_offset - job->first_frame * index->frame_size);
+        int rc;
+
+        frame_toc_entry->offset = job->toc_entry->offset + index->offsets[frame];
+        frame_toc_entry->length = index->offsets[frame + 1] - index->offsets[frame];
+        frame_toc_entry->uncompressed_length = job->toc_entry->uncompressed_length - data_offset;
+        if (frame_toc_entry->uncompressed_length > index->frame_size) {
+            frame_toc_entry->uncompressed_length = index->frame_size;
+        }
+
+        if (job->blob) {
+            rc = _pyi_archive_extract_compressed_buffer(session, job->blob + index->offsets[frame], frame_toc_entry, NULL, out_ptr);
+        } else {
+            rc = _pyi_archive_extract_compressed_file(session, job->archive, frame_toc_entry, NULL, out_ptr);
+        }
+        failed = rc < 0;
+    }
+}
+
+#if PYI_HAVE_THREADS
+
+static PYI_THREAD_PROC_TYPE
+_pyi_archive_frame_worker(void *arg)
+{
+    struct _PYI_ARCHIVE_FRAME_JOB *job = (struct _PYI_ARCHIVE_FRAME_JOB *)arg;
+    struct ARCHIVE_SESSION session;
+
+    _pyi_archive_session_init(&session, 0);
+    _pyi_archive_frame_job_run(job, &session);
+    _pyi_archive_session_cleanup(&session);
+
+    PYI_THREAD_PROC_RETURN;
+}
+
+#endif /* PYI_HAVE_THREADS */
+
+/*
+ * Decompress the frames from `first_frame` until (but excluding)
+ * `end_frame` of the given framed entry into the output buffer. If
+ * the frames hold enough data, they are decompressed by multiple
+ * threads; the calling thread decompresses its share of the frames
+ * using the given session, and the worker threads use their own.
+ * Returns 0 on success, and -1 on error.
+ */
+static int
+_pyi_archive_decode_frames(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const struct _PYI_ARCHIVE_FRAME_INDEX *index, const unsigned char *blob, uint64_t first_frame, uint64_t end_frame, unsigned char *out_ptr)
+{
+    struct _PYI_ARCHIVE_FRAME_JOB job;
+#if PYI_HAVE_THREADS
+    pyi_thread_t threads[PYI_ARCHIVE_FRAME_MAX_THREADS - 1];
+    int num_threads = 0;
+    int i;
+#endif
+
+    memset(&job, 0, sizeof(job));
+    job.archive = archive;
+    job.toc_entry = toc_entry;
+    job.index = index;
+    job.blob = blob;
+    job.first_frame = first_frame;
+    job.end_frame = end_frame;
+    job.out_ptr = out_ptr;
+    job.next_frame = first_frame;
+
+#if PYI_HAVE_THREADS
+    if (end_frame - first_frame > 1 && (end_frame - first_frame) * index->frame_size >= PYI_ARCHIVE_FRAME_PARALLEL_MIN_LENGTH) {
+        uint64_t max_threads = pyi_thread_get_cpu_count();
+
+        if (max_threads > PYI_ARCHIVE_FRAME_MAX_THREADS) {
+            max_threads = PYI_ARCHIVE_FRAME_MAX_THREADS;
+        }
+        if (max_threads > end_frame - first_frame) {
+            max_threads = end_frame - first_frame;
+        }
+        if (max_threads > 1 && pyi_mutex_init(&job.mutex) == 0) {
+            job.is_shared = true;
+            for (num_threads = 0; num_threads < (int)max_threads - 1; num_threads++) {
+                if (pyi_thread_create(&threads[num_threads], _pyi_archive_frame_worker, &job) != 0) {
+                    break;
+                }
+            }
+        }
+    }
+#endif
+
+    _pyi_archive_frame_job_run(&job, session);
+
+#if PYI_HAVE_THREADS
+    for (i = 0; i < num_threads; i++) {
+        pyi_thread_join(threads[i]);
+    }
+    if (job.is_shared) {
+        pyi_mutex_destroy(&job.mutex);
+    }
+#endif
+
+    return job.failed ? -1 : 0;
+}
+
+/*
+ * Extract `length` bytes of the framed entry's uncompressed data, from
+ * the given offset onward, into the provided file handle or data
+ * buffer (exactly one of out_fp or out_ptr needs to be valid). Only
+ * the frames that cover the range are decompressed, in groups whose
+ * size is bounded by PYI_ARCHIVE_FRAME_BUFFER_MAX_LENGTH. When
+ * extracting into data buffer, the groups of frames that lie fully
+ * within the range are decompressed directly into it; otherwise, the
+ * frames are decompressed into a temporary buffer first. Returns 0 on
+ * success, and -1 on error.
+ */
+static int
+_pyi_archive_extract_framed(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, uint64_t offset, uint64_t length, FILE *out_fp, unsigned char *out_ptr)
+{
+    struct _PYI_ARCHIVE_FRAME_INDEX index;
+    const unsigned char *blob;
+    unsigned char *buffer = NULL;
+    uint64_t group_frames;
+    uint64_t frame;
+    uint64_t end_frame;
+    uint64_t end_offset = offset + length;
+    int rc = 0;
+
+    if (length == 0) {
+        return 0;
+    }
+
+    blob = pyi_archive_get_mapped_data(archive, toc_entry);
+    if (_pyi_archive_load_frame_index(archive, toc_entry, blob, &index) < 0) {
+        return -1;
+    }
+
+    group_frames = PYI_ARCHIVE_FRAME_BUFFER_MAX_LENGTH / index.frame_size;
+    if (group_frames == 0) {
+        group_frames = 1;
+    }
+
+    frame = offset / index.frame_size;
+    end_frame = (end_offset - 1) / index.frame_size + 1;
+    while (frame < end_frame && rc == 0) {
+        uint64_t group_end_frame = (end_frame - frame < group_frames) ? end_frame : frame + group_frames;
+        uint64_t group_offset = frame * index.frame_size;
+        uint64_t group_end_offset = group_end_frame * index.frame_size;
+        uint64_t copy_offset = (offset > group_offset) ? offset : group_offset;
+        size_t copy_length;
+
+        if (group_end_offset > toc_entry->uncompressed_length) {
+            group_end_offset = toc_entry->uncompressed_length;
+        }
+        copy_length = (size_t)(((end_offset < group_end_offset) ? end_offset : group_end_offset) - copy_offset);
+
+        if (out_ptr && copy_offset == group_offset && copy_length == group_end_offset - group_offset) {
+            /* Decompress directly into output data buffer */
+            rc = _pyi_archive_decode_frames(session, archive, toc_entry, &index, blob, frame, group_end_frame, out_ptr + (size_t)(group_offset - offset));
+        } else {
+            if (buffer == NULL) {
+                buffer = (unsigned char *)malloc((size_t)(group_frames * index.frame_size));
+                if (buffer == NULL) {
+                    PYI_PERROR("malloc", "Failed to extract %s: failed to allocate frame buffer!\n", pyi_archive_get_entry_name(toc_entry));
+                    rc = -1;
+                    break;
+                }
+            }
+            rc = _pyi_archive_decode_frames(session, archive, toc_entry, &index, blob, frame, group_end_frame, buffer);
+            if (rc < 0) {
+                break;
+            }
+            if (out_ptr) {
+                memcpy(out_ptr + (size_t)(copy_offset - offset), buffer + (size_t)(copy_offset - group_offset), copy_length);
+            } else if (_pyi_archive_session_write(session, buffer + (size_t)(copy_offset - group_offset), copy_length, out_fp) != copy_length || ferror(out_fp)) {
+                PYI_PERROR("fwrite", "Failed to extract %s: failed to write data!\n", pyi_archive_get_entry_name(toc_entry));
+                rc = -1;
+            }
+        }
+
+        frame = group_end_frame;
+    }
+
+    free(buffer);
+    free(index.offsets);
+
+    return rc;
+}
+
+/*
+ * Helper for pyi_archive_session_extract_into that extracts the entry's
+ * own data blob, i.e., without resolving solid block membership.
+ */
+static int
+_pyi_archive_session_extract_blob(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, unsigned char *buffer)
+{
+    const unsigned char *mapped_data;
+
+    pyi_archive_account_entry(toc_entry);
+
+    if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_FRAMED) {
+        return _pyi_archive_extract_framed(session, archive, toc_entry, 0, toc_entry->uncompressed_length, NULL, buffer);
+    }
+
+    /* If archive is memory-mapped, decode straight from the mapping */
+    mapped_data = pyi_archive_get_mapped_data(archive, toc_entry);
+    if (mapped_data) {
+        if (toc_entry->compression_flag != ARCHIVE_COMPRESSION_NONE) {
+            return _pyi_archive_extract_compressed_buffer(session, mapped_data, toc_entry, NULL, buffer);
+        }
+        memcpy(buffer, mapped_data, toc_entry->uncompressed_length);
+        return 0;
+    }
+
+    /* Otherwise, read the data from the archive file */
+    if (toc_entry->compression_flag != ARCHIVE_COMPRESSION_NONE) {
+        return _pyi_archive_extract_compressed_file(session, archive, toc_entry, NULL, buffer);
+    }
+    return _pyi_archive_extract_uncompressed(archive, toc_entry, buffer);
+}
+
+/*
+ * Return the decompressed data of the solid block that the given entry
+ * is a member of, after verifying that the member's data lies within
+ * the block. The block is decompressed only if it is not the session's
+ * current block. Returns NULL on failure, after emitting an error
+ * message.
+ */
+static const unsigned char *
+_pyi_archive_session_get_solid_block(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry)
+{
+    const struct TOC_ENTRY *const *block_entries;
+    const struct TOC_ENTRY *block_entry = NULL;
+    size_t num_blocks;
+    size_t i;
+
+    if (session->solid_block_owner == archive && session->solid_block_entry->offset == toc_entry->offset) {
+        block_entry = session->solid_block_entry;
+    } else {
+        block_entries = pyi_archive_get_toc_group(archive, ARCHIVE_TOC_GROUP_SOLID_BLOCKS, &num_blocks);
+        for (i = 0; i < num_blocks; i++) {
+            if (block_entries[i]->offset == toc_entry->offset) {
+                block_entry = block_entries[i];
+                break;
+            }
+        }
+        if (block_entry == NULL) {
+            PYI_ERROR("Failed to extract %s: solid block not found!\n", pyi_archive_get_entry_name(toc_entry));
+            return NULL;
+        }
+    }
+
+    if (toc_entry->length > block_entry->uncompressed_length || toc_entry->uncompressed_length > block_entry->uncompressed_length - toc_entry->length) {
+        PYI_ERROR("Failed to extract %s: entry's data exceeds its solid block!\n", pyi_archive_get_entry_name(toc_entry));
+        return NULL;
+    }
+
+    if (block_entry == session->solid_block_entry && session->solid_block_owner == archive) {
+        return session->solid_block;
+    }
+
+    /* Decompress the block, replacing the previous one */
+    free(session->solid_block);
+    session->solid_block_entry = NULL;
+    session->solid_block_owner = NULL;
+
+    if (block_entry->uncompressed_length > (uint64_t)SIZE_MAX) {
+        PYI_ERROR("Failed to extract %s: solid block is too large to be extracted into memory!\n", pyi_archive_get_entry_name(toc_entry));
+        return NULL;
+    }
+    /* Allocate at least one byte, so that empty block is not mistaken for allocation failure */
+    session->solid_block = (unsigned char *)malloc((size_t)block_entry->uncompressed_length + 1);
+    if (session->solid_block == NULL) {
+        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate solid block buffer!\n", pyi_archive_get_entry_name(toc_entry));
+        return NULL;
+    }
+    if (_pyi_archive_session_extract_blob(session, archive, block_entry, session->solid_block) < 0) {
+        free(session->solid_block);
+        session->solid_block = NULL;
+        return NULL;
+    }
+    session->solid_block_entry = block_entry;
+    session->solid_block_owner = archive;
+
+    return session->solid_block;
+}
+
+/*
+ * Extract an archive entry into the given caller-provided buffer, which
+ * must be at least `uncompressed_length` bytes large, using the given
+ * extraction session. Returns 0 on success, -1 on error.
+ */
+int
+pyi_archive_session_extract_into(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, unsigned char *buffer)
+{
+    const unsigned char *block_data;
+
+    pyi_access_profile_record(pyi_archive_get_entry_name(toc_entry));
+
+    if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_SOLID) {
+        block_data = _pyi_archive_session_get_solid_block(session, archive, toc_entry);
+        if (block_data == NULL) {
+            return -1;
+        }
+        memcpy(buffer, block_data + toc_entry->length, (size_t)toc_entry->uncompressed_length);
+    } else if (_pyi_archive_session_extract_blob(session, archive, toc_entry, buffer) < 0) {
+        return -1;
+    }
+
+    return pyi_archive_verify_data(archive, toc_entry, buffer);
+}
+
+/*
+ * Extract an archive entry into data buffer, using the given extraction
+ * session. Returns pointer to the data (must be freed).
+ */
+unsigned char *
+pyi_archive_session_extract(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry)
+{
+    unsigned char *data;
+
+    /* With 64-bit archive format, the entry might not fit into address
+     * space (on 32-bit platforms) */
+    if (toc_entry->uncompressed_length > (uint64_t)SIZE_MAX) {
+        PYI_ERROR("Failed to extract %s: entry is too large to be extracted into memory!\n", pyi_archive_get_entry_name(toc_entry));
+        return NULL;
+    }
+
+    /* Allocate the data buffer */
+    data = (unsigned char *)malloc((size_t)toc_entry->uncompressed_length);
+    if (data == NULL) {
+        PYI_PERROR("malloc", "Failed to extract %s: failed to allocate data buffer (%" PRIu64 " bytes)!\n", pyi_archive_get_entry_name(toc_entry), toc_entry->uncompressed_length);
+        return NULL;
+    }
+
+    if (pyi_archive_session_extract_into(session, archive, toc_entry, data) != 0) {
+        free(data);
+        data = NULL;
+    }
+
+    return data;
+}
+
+/*
+ * Extract an archive entry into data buffer.
+ * Returns pointer to the data (must be freed).
+ */
+unsigned char *
+pyi_archive_extract(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry)
+{
+    struct ARCHIVE_SESSION session;
+    unsigned char *data;
+
+    _pyi_archive_session_init(&session, 0);
+    data = pyi_archive_session_extract(&session, archive, toc_entry);
+    _pyi_archive_session_cleanup(&session);
+
+    return data;
+}
+
+/*
+ * Read `length` bytes of the entry's uncompressed data, starting at the
+ * given offset within the data, into the provided buffer, using the
+ * given extraction session. For framed entries, only the frames that
+ * cover the range are decompressed; for uncompressed entries and
+ * members of solid blocks, the data is read directly (from the solid
+ * block that is kept by the session). Entries compressed as a single
+ * stream are decompressed in full. As the checksums cover the entire
+ * data of entries, the data read is not verified. Returns 0 on
+ * success, and -1 on error.
+ */
+int
+pyi_archive_session_read_range(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, uint64_t offset, void *buffer, size_t length)
+{
+    const unsigned char *block_data;
+    unsigned char *data;
+
+    if (offset > toc_entry->uncompressed_length || length > toc_entry->uncompressed_length - offset) {
+        PYI_ERROR("Failed to read %s: requested range exceeds entry's data!\n", pyi_archive_get_entry_name(toc_entry));
+        return -1;
+    }
+
+    pyi_access_profile_record(pyi_archive_get_entry_name(toc_entry));
+
+    switch (toc_entry->compression_flag) {
+        case ARCHIVE_COMPRESSION_NONE: {
+            if (pyi_archive_read_at(archive, toc_entry->offset + offset, buffer, length) < 0) {
+                PYI_PERROR("pread", "Failed to read %s: failed to read data!\n", pyi_archive_get_entry_name(toc_entry));
+                return -1;
+            }
+            return 0;
+        }
+        case ARCHIVE_COMPRESSION_FRAMED: {
+            return _pyi_archive_extract_framed(session, archive, toc_entry, offset, length, NULL, (unsigned char *)buffer);
+        }
+        case ARCHIVE_COMPRESSION_SOLID: {
+            block_data = _pyi_archive_session_get_solid_block(session, archive, toc_entry);
+            if (block_data == NULL) {
+                return -1;
+            }
+            memcpy(buffer, block_data + toc_entry->length + offset, length);
+            return 0;
+        }
+        case ARCHIVE_COMPRESSION_COLD: {
+            PYI_ERROR("Failed to read %s: data is stored in the cold archive!\n", pyi_archive_get_entry_name(toc_entry));
+            return -1;
+        }
+        default: {
+            break;
+        }
+    }
+
+    data = pyi_archive_session_extract(session, archive, toc_entry);
+    if (data == NULL) {
+        return -1;
+    }
+    memcpy(buffer, data + offset, length);
+    free(data);
+
+    return 0;
+}
+
+/*
+ * Read a range of the entry's uncompressed data; see
+ * pyi_archive_session_read_range().
+ */
+int
+pyi_archive_read_range(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, uint64_t offset, void *buffer, size_t length)
+{
+    struct ARCHIVE_SESSION session;
+    int rc;
+
+    _pyi_archive_session_init(&session, 0);
+    rc = pyi_archive_session_read_range(&session, archive, toc_entry, offset, buffer, length);
+    _pyi_archive_session_cleanup(&session);
+
+    return rc;
+}
+
+/*
+ * Extract the given entries into a single buffer (arena), using one
+ * extraction session. The data blobs of the entries (such as bootstrap
+ * modules and entry-point scripts) are usually adjacent; if the archive
+ * is not memory-mapped, the range spanning them is therefore read with
+ * a single read (provided that it is at most PYI_ARCHIVE_BATCH_MAX_SPAN
+ * long, and mostly consists of the entries' data), and the entries are
+ * decoded from that buffer. Members of solid blocks, framed entries, and
+ * entries that are too far apart, are extracted individually.
+ *
+ * Returns 0 on success, -1 on error; on success, the batch needs to be
+ * released with pyi_archive_batch_free().
+ */
+int
+pyi_archive_extract_batch(const struct ARCHIVE *archive, const struct TOC_ENTRY *const *toc_entries, size_t count, struct ARCHIVE_BATCH *batch)
+{
+    struct ARCHIVE_SESSION session;
+    const struct TOC_ENTRY *toc_entry;
+    unsigned char *span = NULL;
+    uint64_t span_start = UINT64_MAX;
+    uint64_t span_end = 0;
+    uint64_t blobs_length = 0;
+    uint64_t arena_length = 0;
+    size_t i;
+    int rc = 0;
+
+    memset(batch, 0, sizeof(struct ARCHIVE_BATCH));
+
+    /* Compute the size of the arena, and the range of the archive that
+     * contains the entries' data blobs */
+    for (i = 0; i < count; i++) {
+        toc_entry = toc_entries[i];
+        if (toc_entry->uncompressed_length > (uint64_t)SIZE_MAX - arena_length) {
+            PYI_ERROR("Failed to extract %s: entry is too large to be extracted into memory!\n", pyi_archive_get_entry_name(toc_entry));
+            return -1;
+        }
+        arena_length += toc_entry->uncompressed_length;
+        if (toc_entry->compression_flag != ARCHIVE_COMPRESSION_SOLID && toc_entry->compression_flag != ARCHIVE_COMPRESSION_FRAMED) {
+            span_start = (toc_entry->offset < span_start) ? toc_entry->offset : span_start;
+            span_end = (toc_entry->offset + toc_entry->length > span_end) ? toc_entry->offset + toc_entry->length : span_end;
+            blobs_length += toc_entry->length;
+        }
+    }
+
+    /* Allocate the offsets and the arena (at least one byte, so that
+     * empty arena is not mistaken for allocation failure) */
+    batch->offsets = (size_t *)malloc((count ? count : 1) * sizeof(size_t));
+    batch->arena = (unsigned char *)malloc((size_t)arena_length + 1);
+    if (batch->offsets == NULL || batch->arena == NULL) {
+        PYI_PERROR("malloc", "Failed to allocate extraction buffer (%" PRIu64 " bytes)!\n", arena_length);
+        pyi_archive_batch_free(batch);
+        return -1;
+    }
+    batch->count = count;
+
+    _pyi_archive_session_init(&session, 0);
+
+    /* If archive is not memory-mapped, read the data blobs with a single
+     * read; on failure, fall back to extracting the entries individually */
+    if (archive->pkg_data == NULL && span_end > span_start && span_end - span_start <= PYI_ARCHIVE_BATCH_MAX_SPAN && span_end - span_start <= 2 * blobs_length) {
+        size_t span_length = (size_t)(span_end - span_start);
+
+        span = (unsigned char *)malloc(span_length);
+        if (span == NULL || pyi_archive_read_at(archive, span_start, span, span_length) < 0) {
+            PYI_DEBUG("LOADER: failed to read archive range for batch extraction; extracting entries individually.\n");
+            free(span);
+            span = NULL;
+        }
+    }
+
+    /* Extract the entries into the arena */
+    arena_length = 0;
+    for (i = 0; i < count && rc == 0; i++) {
+        unsigned char *out_ptr = batch->arena + arena_length;
+
+        toc_entry = toc_entries[i];
+        batch->offsets[i] = (size_t)arena_length;
+        arena_length += toc_entry->uncompressed_length;
+
+        if (span == NULL || toc_entry->compression_flag == ARCHIVE_COMPRESSION_SOLID || toc_entry->compression_flag == ARCHIVE_COMPRESSION_FRAMED) {
+            rc = pyi_archive_session_extract_into(&session, archive, toc_entry, out_ptr);
+            continue;
+        }
+
+        pyi_access_profile_record(pyi_archive_get_entry_name(toc_entry));
+        pyi_archive_account_entry(toc_entry);
+
+        if (toc_entry->compression_flag != ARCHIVE_COMPRESSION_NONE) {
+            rc = _pyi_archive_extract_compressed_buffer(&session, span + (toc_entry->offset - span_start), toc_entry, NULL, out_ptr);
+        } else {
+            memcpy(out_ptr, span + (toc_entry->offset - span_start), (size_t)toc_entry->uncompressed_length);
+        }
+        if (rc == 0) {
+            rc = pyi_archive_verify_data(archive, toc_entry, out_ptr);
+        }
+    }
+
+    _pyi_archive_session_cleanup(&session);
+    free(span);
+
+    if (rc < 0) {
+        pyi_archive_batch_free(batch);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Release the arena and offsets of the extracted batch.
+ */
+void
+pyi_archive_batch_free(struct ARCHIVE_BATCH *batch)
+{
+    free(batch->arena);
+    batch->arena = NULL;
+    free(batch->offsets);
+    batch->offsets = NULL;
+    batch->count = 0;
+}
+
+/*
+ * Helper for pyi_archive_extract2fs that copies an uncompressed entry
+ * from the archive file into the output file using kernel-side copy
+ * (Linux only), so that the data does not pass through user space.
+ * Returns false if this fast path is not applicable (the entry is
+ * compressed or small, or the kernel does not support the copy between
+ * given files), in which case the caller needs to extract the entry
+ * itself. Otherwise, returns true, and stores the result (0 on success,
+ * -1 on error) into `rc`.
+ */
+static bool
+_pyi_archive_extract2fs_kernel_copy(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, FILE *out_fp, int *rc)
+{
+#if defined(__linux__)
+    int copy_rc;
+
+    /* For small entries, the system call overhead outweighs the
+     * benefits of the copy within the kernel. The data that is copied
+     * within the kernel cannot be verified. */
+    if (toc_entry->compression_flag != ARCHIVE_COMPRESSION_NONE || toc_entry->uncompressed_length < PYI_ARCHIVE_KERNEL_COPY_THRESHOLD || session->compute_checksum) {
+        return false;
+    }
+
+    if (archive->file == NULL) {
+        return false;
+    }
+
+    /* The copy uses explicit source offset, and does not change the
+     * position of the (shared) archive file handle. */
+    fflush(out_fp);
+    copy_rc = pyi_utils_copy_file_range(fileno(archive->file), archive->pkg_offset + toc_entry->offset, fileno(out_fp), toc_entry->uncompressed_length);
+
+    if (copy_rc == 1) {
+        return false;
+    }
+    if (copy_rc < 0) {
+        PYI_PERROR("copy_file_range", "Failed to extract %s: failed to copy data!\n", pyi_archive_get_entry_name(toc_entry));
+    }
+    *rc = copy_rc;
+    return true;
+#else
+    (void)session;
+    (void)archive;
+    (void)toc_entry;
+    (void)out_fp;
+    (void)rc;
+    return false;
+#endif
+}
+
+/*
+ * Create/extract symbolic link from the archive.
+ */
+static int
+_pyi_archive_create_symlink(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+{
+    char *link_target = NULL;
+    int rc = -1;
+
+    /* Extract symlink target */
+    link_target = (char *)pyi_archive_session_extract(session, archive, toc_entry);
+    if (!link_target) {
+        goto cleanup;
+    }
+
+    /* Create the symbolic link */
+    rc = pyi_path_mksymlink(link_target, output_filename);
+
+cleanup:
+    free(link_target);
+
+    return rc;
+}
+
+/*
+ * Helper for pyi_archive_session_extract2fp that writes the entry's data
+ * into the output stream.
+ */
+static int
+_pyi_archive_session_write_entry(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, FILE *out_fp)
+{
+    const unsigned char *mapped_data;
+    int rc = 0;
+
+    /* Members of solid blocks are written out from the decompressed block */
+    if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_SOLID) {
+        const unsigned char *block_data = _pyi_archive_session_get_solid_block(session, archive, toc_entry);
+        if (block_data == NULL) {
+            return -1;
+        }
+        if (_pyi_archive_session_write(session, block_data + toc_entry->length, (size_t)toc_entry->uncompressed_length, out_fp) != toc_entry->uncompressed_length) {
+            PYI_PERROR("fwrite", "Failed to extract %s: failed to write data!\n", pyi_archive_get_entry_name(toc_entry));
+            return -1;
+        }
+        return 0;
+    }
+
+    pyi_archive_account_entry(toc_entry);
+
+    /* Frames of framed entries are decompressed in groups, possibly by
+     * multiple threads, and written out in order */
+    if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_FRAMED) {
+        return _pyi_archive_extract_framed(session, archive, toc_entry, 0, toc_entry->uncompressed_length, out_fp, NULL);
+    }
+
+    mapped_data = pyi_archive_get_mapped_data(archive, toc_entry);
+    if (_pyi_archive_extract2fs_kernel_copy(session, archive, toc_entry, out_fp, &rc)) {
+        /* Copied by kernel; rc contains the result */
+    } else if (mapped_data) {
+        /* If archive is memory-mapped, decode straight from the mapping */
+        if (toc_entry->compression_flag != ARCHIVE_COMPRESSION_NONE) {
+            rc = _pyi_archive_extract_compressed_buffer(session, mapped_data, toc_entry, out_fp, NULL);
+        } else if (_pyi_archive_session_write(session, mapped_data, (size_t)toc_entry->uncompressed_length, out_fp) != toc_entry->uncompressed_length) {
+            PYI_PERROR("fwrite", "Failed to extract %s: failed to write data!\n", pyi_archive_get_entry_name(toc_entry));
+            rc = -1;
+        }
+    } else if (toc_entry->compression_flag != ARCHIVE_COMPRESSION_NONE) {
+        /* Otherwise, read the data from the archive file */
+        rc = _pyi_archive_extract_compressed_file(session, archive, toc_entry, out_fp, NULL);
+    } else {
+        rc = _pyi_archive_extract2fs_uncompressed(session, archive, toc_entry, out_fp);
+    }
+
+    return rc;
+}
+
+/*
+ * Extract data of an archive entry into the given (open) output stream,
+ * using the given extraction session. Symbolic link entries are not
+ * supported by this function. If checksums are enabled for the archive,
+ * the written data is verified against the entry's checksum.
+ */
+int
+pyi_archive_session_extract2fp(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, FILE *out_fp)
+{
+    uint32_t expected_checksum = 0;
+    int rc;
+
+    pyi_access_profile_record(pyi_archive_get_entry_name(toc_entry));
+
+    session->compute_checksum = pyi_archive_get_entry_checksum(archive, toc_entry, &expected_checksum);
+    session->checksum = 0;
+
+    rc = _pyi_archive_session_write_entry(session, archive, toc_entry, out_fp);
+
+    if (rc == 0 && session->compute_checksum && session->checksum != expected_checksum) {
+        PYI_ERROR("Failed to extract %s: checksum mismatch!\n", pyi_archive_get_entry_name(toc_entry));
+        rc = -1;
+    }
+    session->compute_checksum = false;
+
+    return rc;
+}
+
+/*
+ * Extract an archive entry into specified output file, using the given
+ * extraction session.
+ */
+int
+pyi_archive_session_extract2fs(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+{
+    FILE *out_fp = NULL;
+    int rc = 0;
+
+    /* Handle symbolic links */
+    if (toc_entry->typecode == ARCHIVE_ITEM_SYMLINK) {
+        rc = _pyi_archive_create_symlink(session, archive, toc_entry, output_filename);
+        if (rc < 0) {
+            PYI_ERROR("Failed to create symbolic link %s!\n", pyi_archive_get_entry_name(toc_entry));
+        } else {
+            pyi_stats_add(&global_pyi_ctx->stats.files_created, 1);
+        }
+        return rc;
+    }
+
+    /* Open target file */
+    out_fp = pyi_path_fopen(output_filename, "wb");
+    if (out_fp == NULL) {
+        PYI_PERROR("fopen", "Failed to extract %s: failed to open target file!\n", pyi_archive_get_entry_name(toc_entry));
+        return -1;
+    }
+    pyi_stats_add(&global_pyi_ctx->stats.files_created, 1);
+
+    rc = pyi_archive_session_extract2fp(session, archive, toc_entry, out_fp);
+#ifndef WIN32
+    if (toc_entry->typecode == ARCHIVE_ITEM_BINARY) {
+        fchmod(fileno(out_fp), S_IRUSR | S_IWUSR | S_IXUSR);
+    } else {
+        fchmod(fileno(out_fp), S_IRUSR | S_IWUSR);
+    }
+#endif
+
+    fclose(out_fp);
+
+    return rc;
+}
+
+/*
+ * Extract an archive entry into specified output file.
+ */
+int
+pyi_archive_extract2fs(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+{
+    struct ARCHIVE_SESSION session;
+    int rc;
+
+    _pyi_archive_session_init(&session, 0);
+    rc = pyi_archive_session_extract2fs(&session, archive, toc_entry, output_filename);
+    _pyi_archive_session_cleanup(&session);
+
+    return rc;
+}
+
+
+/* Check if the host uses little-endian byte order - and can therefore
+ * use the version 2 TOC records as they are stored in the archive. */
+static bool
+_pyi_archive_host_is_little_endian(void)
+{
+    const uint16_t probe = 1;
+    return *(const unsigned char *)&probe == 1;
+}
+
+/*
+ * Read the cookie at the given position in the file, and decode it
+ * into the version 2 cookie structure, with fields in host byte order.
+ * Version 1 cookie is converted, and its `format_version` is set to 1.
+ * If `checksum` is not NULL, the CRC-32 of the raw cookie data is
+ * stored into it.
+ *
+ * Returns the size of the cookie in the file, or 0 on error.
+ */
+static size_t
+_pyi_archive_read_cookie(FILE *fp, uint64_t cookie_pos, struct ARCHIVE_COOKIE_V2 *cookie, uint32_t *checksum)
+{
+    unsigned char raw[sizeof(struct ARCHIVE_COOKIE_V2)];
+    size_t cookie_size = sizeof(struct ARCHIVE_COOKIE);
+
+    /* Read the version 1 cookie, which is shorter of the two */
+    if (pyi_fseek(fp, cookie_pos, SEEK_SET) < 0) {
+        return 0;
+    }
+    if (fread(raw, sizeof(struct ARCHIVE_COOKIE), 1, fp) < 1) {
+        return 0;
+    }
+
+    memcpy(cookie->magic, raw, sizeof(cookie->magic));
+
+    if (_pyi_archive_read_be32(raw + offsetof(struct ARCHIVE_COOKIE, pkg_length)) != ARCHIVE_COOKIE_V2_MARKER) {
+        /* Version 1 cookie */
+        cookie->marker = 0;
+        cookie->format_version = 1;
+        cookie->pkg_length = _pyi_archive_read_be32(raw + offsetof(struct ARCHIVE_COOKIE, pkg_length));
+        cookie->toc_offset = _pyi_archive_read_be32(raw + offsetof(struct ARCHIVE_COOKIE, toc_offset));
+        cookie->toc_length = _pyi_archive_read_be32(raw + offsetof(struct ARCHIVE_COOKIE, toc_length));
+        cookie->toc_count = 0; /* Not known until TOC is parsed */
+        cookie->python_version = _pyi_archive_read_be32(raw + offsetof(struct ARCHIVE_COOKIE, python_version));
+        cookie->reserved = 0;
+        memcpy(cookie->python_libname, raw + offsetof(struct ARCHIVE_COOKIE, python_libname), sizeof(cookie->python_libname));
+    } else {
+        /* Version 2 (or later) cookie; read the rest of it */
+        cookie_size = sizeof(struct ARCHIVE_COOKIE_V2);
+        if (fread(raw + sizeof(struct ARCHIVE_COOKIE), cookie_size - sizeof(struct ARCHIVE_COOKIE), 1, fp) < 1) {
+            return 0;
+        }
+        cookie->marker = ARCHIVE_COOKIE_V2_MARKER;
+        cookie->format_version = _pyi_archive_read_le32(raw + offsetof(struct ARCHIVE_COOKIE_V2, format_version));
+        cookie->pkg_length = _pyi_archive_read_le64(raw + offsetof(struct ARCHIVE_COOKIE_V2, pkg_length));
+        cookie->toc_offset = _pyi_archive_read_le64(raw + offsetof(struct ARCHIVE_COOKIE_V2, toc_offset));
+        cookie->toc_length = _pyi_archive_read_le64(raw + offsetof(struct ARCHIVE_COOKIE_V2, toc_length));
+        cookie->toc_count = _pyi_archive_read_le64(raw + offsetof(struct ARCHIVE_COOKIE_V2, toc_count));
+        cookie->python_version = _pyi_archive_read_le32(raw + offsetof(struct ARCHIVE_COOKIE_V2, python_version));
+        cookie->reserved = _pyi_archive_read_le32(raw + offsetof(struct ARCHIVE_COOKIE_V2, reserved));
+        memcpy(cookie->python_libname, raw + offsetof(struct ARCHIVE_COOKIE_V2, python_libname), sizeof(cookie->python_libname));
+    }
+
+    if (checksum) {
+        *checksum = crc32(0, (const Bytef *)raw, (uInt)cookie_size);
+    }
+
+    return cookie_size;
+}
+
+/*
+ * Read the locator footer from the end of the file, and validate both
+ * the footer and the cookie it points to.
+ *
+ * Returns offset of the cookie within the file if valid locator is
+ * found, 0 otherwise.
+ */
+static uint64_t
+_pyi_archive_read_pkg_locator(FILE *fp, const unsigned char *cookie_magic)
+{
+    struct ARCHIVE_LOCATOR locator;
+    struct ARCHIVE_COOKIE_V2 cookie;
+    uint32_t cookie_checksum;
+    unsigned char magic[8];
+    uint64_t file_size;
+    uint64_t cookie_offset;
+
+    /* Prepare MAGIC pattern of the locator */
+    memcpy(magic, MAGIC_BASE, sizeof(magic));
+    magic[3] += 0x0F; /* 0x00 -> 0x0F */
+
+    /* Read the locator from the end of file */
+    if (pyi_fseek(fp, 0, SEEK_END) < 0) {
+        return 0;
+    }
+    file_size = pyi_ftell(fp);
+    if (file_size < sizeof(struct ARCHIVE_LOCATOR) + sizeof(struct ARCHIVE_COOKIE)) {
+        return 0;
+    }
+    if (pyi_fseek(fp, file_size - sizeof(struct ARCHIVE_LOCATOR), SEEK_SET) < 0) {
+        return 0;
+    }
+    if (fread(&locator, sizeof(struct ARCHIVE_LOCATOR), 1, fp) < 1) {
+        return 0;
+    }
+
+    /* Validate the locator */
+    if (memcmp(locator.magic, magic, sizeof(magic)) != 0) {
+        PYI_DEBUG("LOADER: archive locator not found.\n");
+        return 0;
+    }
+    if (pyi_be32toh(locator.checksum) != crc32(0, (const Bytef *)&locator, offsetof(struct ARCHIVE_LOCATOR, checksum))) {
+        PYI_DEBUG("LOADER: archive locator has invalid checksum!\n");
+        return 0;
+    }
+
+    cookie_offset = ((uint64_t)pyi_be32toh(locator.cookie_offset_high) << 32) | pyi_be32toh(locator.cookie_offset_low);
+    if (cookie_offset > file_size - sizeof(struct ARCHIVE_LOCATOR) - sizeof(struct ARCHIVE_COOKIE)) {
+        PYI_DEBUG("LOADER: archive locator points outside of the file!\n");
+        return 0;
+    }
+
+    /* Validate the cookie that the locator points to */
+    if (_pyi_archive_read_cookie(fp, cookie_offset, &cookie, &cookie_checksum) == 0) {
+        return 0;
+    }
+    if (memcmp(cookie.magic, cookie_magic, sizeof(cookie.magic)) != 0 || pyi_be32toh(locator.cookie_checksum) != cookie_checksum) {
+        PYI_DEBUG("LOADER: archive locator does not point to a valid cookie!\n");
+        return 0;
+    }
+
+    return cookie_offset;
+}
+
+/*
+ * Format the identity of the open file into the given buffer: device
+ * and inode number, size, and modification time on POSIX systems, and
+ * volume serial number, file index, size, and last write time on
+ * Windows. Returns 0 on success, -1 on error.
+ */
+static int
+_pyi_archive_format_file_identity(FILE *fp, char *buffer, size_t buffer_size)
+{
+    int length;
+#ifdef _WIN32
+    BY_HANDLE_FILE_INFORMATION info;
+
+    if (!GetFileInformationByHandle((HANDLE)_get_osfhandle(_fileno(fp)), &info)) {
+        return -1;
+    }
+    length = snprintf(
+        buffer,
+        buffer_size,
+        "%lx:%lx%08lx:%lx%08lx:%lx%08lx",
+        (unsigned long)info.dwVolumeSerialNumber,
+        (unsigned long)info.nFileIndexHigh,
+        (unsigned long)info.nFileIndexLow,
+        (unsigned long)info.nFileSizeHigh,
+        (unsigned long)info.nFileSizeLow,
+        (unsigned long)info.ftLastWriteTime.dwHighDateTime,
+        (unsigned long)info.ftLastWriteTime.dwLowDateTime
+    );
+#else
+    struct stat statbuf;
+
+    if (fstat(fileno(fp), &statbuf) < 0) {
+        return -1;
+    }
+    length = snprintf(
+        buffer,
+        buffer_size,
+        "%" PRIx64 ":%" PRIx64 ":%" PRIx64 ":%" PRIx64,
+        (uint64_t)statbuf.st_dev,
+        (uint64_t)statbuf.st_ino,
+        (uint64_t)statbuf.st_size,
+        (uint64_t)statbuf.st_mtime
+    );
+#endif
+    if (length < 0 || (size_t)length >= buffer_size) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Look up the cookie using the archive hint, passed by the parent
+ * process that opened the same archive (see pyi_archive_format_hint()).
+ * The hint is used only if the identity of the open file matches the
+ * one stored in the hint, and the hint points to a cookie.
+ *
+ * Returns offset of the cookie within the file, or 0 if the hint is
+ * not applicable.
+ */
+static uint64_t
+_pyi_archive_read_pkg_hint(FILE *fp, const char *hint, const unsigned char *cookie_magic)
+{
+    struct ARCHIVE_COOKIE_V2 cookie;
+    char identity[PYI_ARCHIVE_HINT_MAX];
+    uint64_t cookie_offset;
+    char *endptr;
+
+    cookie_offset = strtoull(hint, &endptr, 16);
+    if (endptr == hint || *endptr != ':') {
+        return 0;
+    }
+    if (_pyi_archive_format_file_identity(fp, identity, sizeof(identity)) < 0 || strcmp(endptr + 1, identity) != 0) {
+        PYI_DEBUG("LOADER: archive hint does not match the archive file.\n");
+        return 0;
+    }
+
+    if (_pyi_archive_read_cookie(fp, cookie_offset, &cookie, NULL) == 0 || memcmp(cookie.magic, cookie_magic, sizeof(cookie.magic)) != 0) {
+        PYI_DEBUG("LOADER: archive hint does not point to a valid cookie!\n");
+        return 0;
+    }
+
+    return cookie_offset;
+}
+
+/*
+ * Find the embedded archive's COOKIE header; use the archive hint from
+ * the parent process or the locator footer, if available, and otherwise
+ * fall back to full back-to-front scan of the file to search for the
+ * cookie's MAGIC pattern.
+ *
+ * Returns offset within the file if cookie is found, 0 otherwise.
+ */
+static uint64_t
+_pyi_archive_find_pkg_cookie_offset(FILE *fp, const char *hint)
+{
+    uint64_t offset;
+
+    /* Prepare MAGIC pattern; we need to do this programmatically to
+     * prevent the pattern itself being stored in the code and matched
+     * when we scan the executable */
+    unsigned char magic[8];
+    memcpy(magic, MAGIC_BASE, sizeof(magic));
+    magic[3] += 0x0C; /* 0x00 -> 0x0C */
+
+    /* Try the hint first... */
+    if (hint != NULL) {
+        offset = _pyi_archive_read_pkg_hint(fp, hint, magic);
+        if (offset != 0) {
+            PYI_DEBUG("LOADER: cookie located via archive hint.\n");
+            return offset;
+        }
+    }
+
+    /* ... then the locator footer */
+    offset = _pyi_archive_read_pkg_locator(fp, magic);
+    if (offset != 0) {
+        PYI_DEBUG("LOADER: cookie located via archive locator.\n");
+        return offset;
+    }
+
+    /* Search using the helper */
+    return pyi_utils_find_magic_pattern(fp, magic, sizeof(magic));
+}
+
+/* Check if the TOC entry's typecode corresponds to an extractable file */
+static bool
+_pyi_archive_is_extractable(char typecode)
+{
+    switch (typecode) {
+        /* onefile mode */
+        case ARCHIVE_ITEM_BINARY:
+        case ARCHIVE_ITEM_DATA:
+        case ARCHIVE_ITEM_LAZY_DATA:
+        case ARCHIVE_ITEM_ZIPFILE:
+        case ARCHIVE_ITEM_SYMLINK:
+        case ARCHIVE_ITEM_ALIAS: {
+            return true;
+        }
+        /* MERGE mode */
+        case ARCHIVE_ITEM_DEPENDENCY: {
+            return true;
+        }
+        default: {
+            break;
+        }
+    }
+
+    return false;
+}
+
+
+/*
+ * Hash function for the TOC index (32-bit FNV-1a). On Windows and macOS,
+ * the name is case-folded (ASCII only, same as strcasecmp() in the
+ * C locale), so that case-insensitive lookups of extractable entries
+ * end up in the same probe sequence as case-sensitive ones.
+ */
+static uint32_t
+_pyi_archive_hash_name(const char *name)
+{
+    uint32_t hash = 0x811C9DC5U;
+
+    for (; *name; name++) {
+        unsigned char c = (unsigned char)*name;
+#if defined(_WIN32) || defined(__APPLE__)
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+#endif
+        hash = (hash ^ c) * 0x01000193U;
+    }
+
+    return hash;
+}
+
+/*
+ * Check if the name of the given TOC entry matches the given name.
+ */
+static bool
+_pyi_archive_entry_name_matches(const struct TOC_ENTRY *toc_entry, const char *name)
+{
+#if defined(_WIN32) || defined(__APPLE__)
+    /* On Windows and macOS, use case-insensitive comparison to
+     * simulate case-insensitive filesystem for extractable entries. */
+    if (_pyi_archive_is_extractable(toc_entry->typecode)) {
+        return strcasecmp(pyi_archive_get_entry_name(toc_entry), name) == 0;
+    }
+#endif
+    return strcmp(pyi_archive_get_entry_name(toc_entry), name) == 0;
+}
+
+/*
+ * Build the hash index of TOC entries. Entries are inserted in TOC
+ * order; with linear probing, this ensures that among the entries with
+ * matching names, the lookup finds the first one in TOC order (same as
+ * the linear search). Failure to allocate the index is not an error.
+ */
+static void
+_pyi_archive_build_toc_index(struct ARCHIVE *archive, uint32_t num_entries)
+{
+    const struct TOC_ENTRY *toc_entry;
+    uint32_t num_slots = 16;
+
+    /* Keep load factor at or below 0.5 */
+    while (num_slots < 2 * num_entries) {
+        num_slots <<= 1;
+    }
+
+    archive->toc_index = (uint32_t *)calloc(num_slots, sizeof(uint32_t));
+    if (archive->toc_index == NULL) {
+        PYI_DEBUG("LOADER: could not allocate TOC index; falling back to linear search.\n");
+        return;
+    }
+    archive->toc_index_mask = num_slots - 1;
+
+    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
+        uint32_t slot = _pyi_archive_hash_name(pyi_archive_get_entry_name(toc_entry)) & archive->toc_index_mask;
+        while (archive->toc_index[slot] != 0) {
+            slot = (slot + 1) & archive->toc_index_mask;
+        }
+        archive->toc_index[slot] = (uint32_t)((const char *)toc_entry - (const char *)archive->toc) + 1;
+    }
+}
+
+/*
+ * Return the group of the typed TOC index that the entry with given
+ * typecode belongs to, or -1 if the entry is not indexed. Lazily-extracted
+ * data entries are additionally listed in ARCHIVE_TOC_GROUP_LAZY_DATA.
+ */
+static int
+_pyi_archive_get_toc_group_for_typecode(char typecode)
+{
+    switch (typecode) {
+        case ARCHIVE_ITEM_RUNTIME_OPTION: {
+            return ARCHIVE_TOC_GROUP_OPTIONS;
+        }
+        case ARCHIVE_ITEM_PYMODULE:
+        case ARCHIVE_ITEM_PYPACKAGE: {
+            return ARCHIVE_TOC_GROUP_MODULES;
+        }
+        case ARCHIVE_ITEM_PYSOURCE: {
+            return ARCHIVE_TOC_GROUP_SCRIPTS;
+        }
+        case ARCHIVE_ITEM_PYZ: {
+            return ARCHIVE_TOC_GROUP_PYZ;
+        }
+        case ARCHIVE_ITEM_SOLID_BLOCK: {
+            return ARCHIVE_TOC_GROUP_SOLID_BLOCKS;
+        }
+        default: {
+            break;
+        }
+    }
+
+    if (_pyi_archive_is_extractable(typecode)) {
+        return ARCHIVE_TOC_GROUP_EXTRACTABLE;
+    }
+
+    return -1;
+}
+
+/*
+ * Build the typed TOC index, using a counting pass followed by a
+ * placement pass over the TOC. The counting pass also locates the
+ * SPLASH and filesystem image entries. Returns 0 on success, -1 on
+ * error.
+ */
+static int
+_pyi_archive_build_toc_groups(struct ARCHIVE *archive)
+{
+    uint32_t counts[ARCHIVE_TOC_GROUP_COUNT] = { 0 };
+    uint32_t positions[ARCHIVE_TOC_GROUP_COUNT];
+    const struct TOC_ENTRY *toc_entry;
+    int group;
+
+    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
+        /* SPLASH and filesystem image entries are not part of any
+         * group; just note their location */
+        if (toc_entry->typecode == ARCHIVE_ITEM_SPLASH) {
+            archive->toc_splash = toc_entry;
+        } else if (toc_entry->typecode == ARCHIVE_ITEM_FSIMAGE) {
+            archive->toc_fsimage = toc_entry;
+        }
+
+        group = _pyi_archive_get_toc_group_for_typecode(toc_entry->typecode);
+        if (group >= 0) {
+            counts[group]++;
+        }
+        if (toc_entry->typecode == ARCHIVE_ITEM_LAZY_DATA) {
+            counts[ARCHIVE_TOC_GROUP_LAZY_DATA]++;
+        }
+    }
+
+    archive->toc_group_start[0] = 0;
+    for (group = 0; group < ARCHIVE_TOC_GROUP_COUNT; group++) {
+        archive->toc_group_start[group + 1] = archive->toc_group_start[group] + counts[group];
+        positions[group] = archive->toc_group_start[group];
+    }
+
+    /* Allocate at least one element, so that the pointer is valid even
+     * if there are no indexed entries. */
+    archive->toc_groups = (const struct TOC_ENTRY **)malloc((archive->toc_group_start[ARCHIVE_TOC_GROUP_COUNT] + 1) * sizeof(const struct TOC_ENTRY *));
+    if (archive->toc_groups == NULL) {
+        PYI_PERROR("malloc", "Could not allocate memory for typed TOC index.\n");
+        return -1;
+    }
+
+    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
+        group = _pyi_archive_get_toc_group_for_typecode(toc_entry->typecode);
+        if (group >= 0) {
+            archive->toc_groups[positions[group]++] = toc_entry;
+        }
+        if (toc_entry->typecode == ARCHIVE_ITEM_LAZY_DATA) {
+            archive->toc_groups[positions[ARCHIVE_TOC_GROUP_LAZY_DATA]++] = toc_entry;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Create read-only memory mapping of the archive file, starting at the
+ * page-aligned offset preceding the start of PKG archive, and spanning
+ * until the end of file. On failure, the archive structure is left
+ * unchanged, and the extraction falls back to positional reads.
+ */
+static void
+_pyi_archive_map(struct ARCHIVE *archive, FILE *archive_fp)
+{
+    uint64_t map_offset;
+    uint64_t file_size;
+    void *mapped_base;
+
+#ifdef _WIN32
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+    LARGE_INTEGER size;
+    SYSTEM_INFO system_info;
+
+    file_handle = (HANDLE)_get_osfhandle(_fileno(archive_fp));
+    if (file_handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_handle, &size)) {
+        return;
+    }
+    file_size = (uint64_t)size.QuadPart;
+
+    /* Mapping offset must be multiple of allocation granularity */
+    GetSystemInfo(&system_info);
+    map_offset = archive->pkg_offset - (archive->pkg_offset % system_info.dwAllocationGranularity);
+    if (file_size <= map_offset || file_size - map_offset > (uint64_t)SIZE_MAX) {
+        return;
+    }
+
+    mapping_handle = CreateFileMappingW(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping_handle == NULL) {
+        PYI_DEBUG("LOADER: failed to create file mapping for archive; falling back to regular file I/O.\n");
+        return;
+    }
+    mapped_base = MapViewOfFile(
+        mapping_handle,
+        FILE_MAP_READ,
+        (DWORD)(map_offset >> 32),
+        (DWORD)(map_offset & 0xFFFFFFFF),
+        (SIZE_T)(file_size - map_offset)
+    );
+    /* The view keeps the mapping object alive */
+    CloseHandle(mapping_handle);
+    if (mapped_base == NULL) {
+        PYI_DEBUG("LOADER: failed to map view of archive file; falling back to regular file I/O.\n");
+        return;
+    }
+#else
+    struct stat statbuf;
+    long page_size;
+
+    if (fstat(fileno(archive_fp), &statbuf) < 0) {
+        return;
+    }
+    file_size = (uint64_t)statbuf.st_size;
+
+    /* Mapping offset must be multiple of page size */
+    page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0) {
+        return;
+    }
+    map_offset = archive->pkg_offset - (archive->pkg_offset % (uint64_t)page_size);
+    if (file_size <= map_offset || file_size - map_offset > (uint64_t)SIZE_MAX) {
+        return;
+    }
+
+    /* The mapping remains valid after the file descriptor is closed */
+    mapped_base = mmap(NULL, (size_t)(file_size - map_offset), PROT_READ, MAP_PRIVATE, fileno(archive_fp), (off_t)map_offset);
+    if (mapped_base == MAP_FAILED) {
+        PYI_DEBUG("LOADER: failed to map archive file; falling back to regular file I/O.\n");
+        return;
+    }
+#endif
+
+    archive->mapped_base = mapped_base;
+    archive->mapped_length = (size_t)(file_size - map_offset);
+    archive->pkg_data = (const unsigned char *)mapped_base + (archive->pkg_offset - map_offset);
+    archive->pkg_data_length = file_size - archive->pkg_offset;
+
+    PYI_DEBUG("LOADER: archive mapped into memory (%" PRIu64 " bytes).\n", (uint64_t)archive->mapped_length);
+}
+
+/*
+ * Remove the memory mapping of the archive file, if available.
+ */
+static void
+_pyi_archive_unmap(struct ARCHIVE *archive)
+{
+    if (archive->mapped_base == NULL) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(archive->mapped_base);
+#else
+    munmap(archive->mapped_base, archive->mapped_length);
+#endif
+
+    archive->mapped_base = NULL;
+    archive->mapped_length = 0;
+    archive->pkg_data = NULL;
+    archive->pkg_data_length = 0;
+}
+
+#ifdef _WIN32
+
+/* PrefetchVirtualMemory() is available only on Windows 8 and later;
+ * look it up at run-time, and declare its argument type ourselves, as
+ * the SDK declares it only when targeting Windows 8. */
+struct _PYI_MEMORY_RANGE_ENTRY
+{
+    PVOID VirtualAddress;
+    SIZE_T NumberOfBytes;
+};
+
+typedef BOOL (WINAPI *_PYI_PREFETCH_VIRTUAL_MEMORY)(HANDLE, ULONG_PTR, struct _PYI_MEMORY_RANGE_ENTRY *, ULONG);
+
+#endif /* ifdef _WIN32 */
+
+/*
+ * Request asynchronous read-ahead of `length` bytes of the PKG archive,
+ * starting at `offset` (relative to the start of the archive). If the
+ * archive is memory-mapped, the corresponding pages of the mapping are
+ * prefetched; otherwise, the operating system is advised that the file
+ * range will be needed soon. This is only a hint; failures are silently
+ * ignored.
+ */
+void
+pyi_archive_readahead(const struct ARCHIVE *archive, uint64_t offset, uint64_t length)
+{
+#ifdef _WIN32
+    _PYI_PREFETCH_VIRTUAL_MEMORY prefetch_func;
+    struct _PYI_MEMORY_RANGE_ENTRY range;
+
+    if (archive->pkg_data == NULL || offset >= archive->pkg_data_length) {
+        return;
+    }
+    if (length > archive->pkg_data_length - offset) {
+        length = archive->pkg_data_length - offset;
+    }
+
+    prefetch_func = (_PYI_PREFETCH_VIRTUAL_MEMORY)(void *)GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "PrefetchVirtualMemory");
+    if (prefetch_func == NULL) {
+        return;
+    }
+
+    range.VirtualAddress = (PVOID)(archive->pkg_data + offset);
+    range.NumberOfBytes = (SIZE_T)length;
+    if (prefetch_func(GetCurrentProcess(), 1, &range, 0)) {
+        PYI_DEBUG("LOADER: requested read-ahead of %" PRIu64 " bytes of archive at offset %" PRIu64 ".\n", length, offset);
+    }
+#else
+    if (archive->pkg_data != NULL) {
+#if defined(MADV_WILLNEED)
+        /* The start of the range must be page-aligned; extend it down
+         * to the preceding page boundary (the mapping's base is
+         * page-aligned). */
+        const unsigned char *mapped_base = (const unsigned char *)archive->mapped_base;
+        long page_size = sysconf(_SC_PAGESIZE);
+        size_t range_offset;
+        size_t start;
+
+        if (offset >= archive->pkg_data_length) {
+            return;
+        }
+        if (length > archive->pkg_data_length - offset) {
+            length = archive->pkg_data_length - offset;
+        }
+        if (page_size <= 0) {
+            return;
+        }
+
+        range_offset = (size_t)(archive->pkg_data - mapped_base) + (size_t)offset;
+        start = range_offset - range_offset % (size_t)page_size;
+        if (madvise((void *)(mapped_base + start), range_offset - start + (size_t)length, MADV_WILLNEED) == 0) {
+            PYI_DEBUG("LOADER: requested read-ahead of %" PRIu64 " bytes of archive at offset %" PRIu64 ".\n", length, offset);
+        }
+#endif
+    } else {
+#if defined(POSIX_FADV_WILLNEED) || defined(F_RDADVISE)
+        /* Advice applies to the file rather than to the descriptor, so
+         * the file can be closed right away. */
+        FILE *fp;
+        int rc;
+
+        if (offset >= archive->pkg_length) {
+            return;
+        }
+        if (length > archive->pkg_length - offset) {
+            length = archive->pkg_length - offset;
+        }
+
+        fp = pyi_path_fopen(archive->filename, "rb");
+        if (fp == NULL) {
+            return;
+        }
+#if defined(POSIX_FADV_WILLNEED)
+        rc = posix_fadvise(fileno(fp), (off_t)(archive->pkg_offset + offset), (off_t)length, POSIX_FADV_WILLNEED);
+#else
+        /* macOS; the advisory count is limited to int range. */
+        {
+            struct radvisory advisory;
+            advisory.ra_offset = (off_t)(archive->pkg_offset + offset);
+            advisory.ra_count = length > INT_MAX ? INT_MAX : (int)length;
+            rc = fcntl(fileno(fp), F_RDADVISE, &advisory);
+        }
+#endif
+        if (rc == 0) {
+            PYI_DEBUG("LOADER: requested read-ahead of %" PRIu64 " bytes of archive at offset %" PRIu64 ".\n", length, offset);
+        }
+        fclose(fp);
+#endif
+    }
+#endif
+}
+
+/*
+ * Obtain pointer to raw TOC data, located at the given offset within
+ * the PKG archive. If archive is memory-mapped, pointer into the mapping
+ * is returned; otherwise, the data is read into a newly-allocated buffer,
+ * which is also stored into `buffer`, and must be freed by the caller.
+ *
+ * Returns NULL on error.
+ */
+static const unsigned char *
+_pyi_archive_get_toc_data(const struct ARCHIVE *archive, FILE *archive_fp, uint64_t toc_offset, uint64_t toc_length, unsigned char **buffer)
+{
+    *buffer = NULL;
+
+    if (archive->pkg_data) {
+        return archive->pkg_data + toc_offset;
     }
-#endif
 
-cleanup:
-    /* Might be NULL if we jumped here due to fopen() failure */
-    if (archive_fp) {
-        fclose(archive_fp);
+    *buffer = (unsigned char *)malloc((size_t)toc_length);
+    if (*buffer == NULL) {
+        PYI_PERROR("malloc", "Could not allocate buffer for TOC!\n");
+        return NULL;
+    }
+    if (pyi_fseek(archive_fp, archive->pkg_offset + toc_offset, SEEK_SET) < 0 || fread(*buffer, (size_t)toc_length, 1, archive_fp) < 1) {
+        PYI_PERROR("fread", "Could not read full TOC!\n");
+        free(*buffer);
+        *buffer = NULL;
+        return NULL;
     }
-    fclose(out_fp);
 
-    return rc;
+    return *buffer;
 }
 
-
 /*
- * Perform full back-to-front scan of the file to search for the
- * MAGIC pattern of the embedded archive's COOKIE header.
+ * Load version 1 TOC, which consists of variable-length entries with
+ * big-endian fields and inline names. The entries are converted into
+ * a buffer with array of native TOC entries, followed by the string
+ * table, same as in version 2 TOC.
  *
- * Returns offset within the file if MAGIC pattern is found, 0 otherwise.
+ * Returns 0 on success, -1 on error.
  */
-static uint64_t
-_pyi_archive_find_pkg_cookie_offset(FILE *fp)
+static int
+_pyi_archive_load_toc_v1(struct ARCHIVE *archive, FILE *archive_fp, const struct ARCHIVE_COOKIE_V2 *cookie)
 {
-    /* Prepare MAGIC pattern; we need to do this programmatically to
-     * prevent the pattern itself being stored in the code and matched
-     * when we scan the executable */
-    unsigned char magic[8];
-    memcpy(magic, MAGIC_BASE, sizeof(magic));
-    magic[3] += 0x0C; /* 0x00 -> 0x0C */
+    const size_t HEADER_LENGTH = offsetof(struct TOC_ENTRY_V1, name);
+    const unsigned char *data;
+    unsigned char *data_buffer = NULL;
+    struct TOC_ENTRY *toc;
+    struct TOC_ENTRY *toc_entry;
+    char *name_ptr;
+    uint64_t pos;
+    uint32_t entry_length;
+    uint64_t num_entries = 0;
+    uint64_t strings_length = 0;
+    uint64_t buffer_length;
+    int rc = -1;
 
-    /* Search using the helper */
-    return pyi_utils_find_magic_pattern(fp, magic, sizeof(magic));
+    data = _pyi_archive_get_toc_data(archive, archive_fp, cookie->toc_offset, cookie->toc_length, &data_buffer);
+    if (data == NULL) {
+        return -1;
+    }
+
+    /* First pass: validate the entries, and count them as well as the
+     * total length of their names */
+    for (pos = 0; pos < cookie->toc_length; pos += entry_length) {
+        const char *name;
+        const char *name_end;
+
+        if (cookie->toc_length - pos < HEADER_LENGTH) {
+            goto malformed;
+        }
+        entry_length = _pyi_archive_read_be32(data + pos);
+        if (entry_length <= HEADER_LENGTH || entry_length > cookie->toc_length - pos) {
+            goto malformed;
+        }
+        name = (const char *)data + pos + HEADER_LENGTH;
+        name_end = (const char *)memchr(name, 0, entry_length - HEADER_LENGTH);
+        if (name_end == NULL) {
+            goto malformed;
+        }
+
+        num_entries++;
+        strings_length += (uint64_t)(name_end - name) + 1;
+    }
+
+    /* Entry and name offsets are stored as 32-bit values */
+    buffer_length = num_entries * sizeof(struct TOC_ENTRY) + strings_length;
+    if (buffer_length > UINT32_MAX) {
+        PYI_ERROR("Archive TOC is too large!\n");
+        goto cleanup;
+    }
+
+    toc = (struct TOC_ENTRY *)calloc(1, (size_t)buffer_length);
+    if (toc == NULL) {
+        PYI_PERROR("calloc", "Could not allocate buffer for TOC!\n");
+        goto cleanup;
+    }
+
+    /* Second pass: convert the entries */
+    toc_entry = toc;
+    name_ptr = (char *)(toc + num_entries);
+    for (pos = 0; pos < cookie->toc_length; pos += entry_length, toc_entry++) {
+        const unsigned char *raw_entry = data + pos;
+        size_t name_length = strlen((const char *)raw_entry + HEADER_LENGTH);
+
+        entry_length = _pyi_archive_read_be32(raw_entry + offsetof(struct TOC_ENTRY_V1, entry_length));
+        toc_entry->offset = _pyi_archive_read_be32(raw_entry + offsetof(struct TOC_ENTRY_V1, offset));
+        toc_entry->length = _pyi_archive_read_be32(raw_entry + offsetof(struct TOC_ENTRY_V1, length));
+        toc_entry->uncompressed_length = _pyi_archive_read_be32(raw_entry + offsetof(struct TOC_ENTRY_V1, uncompressed_length));
+        toc_entry->compression_flag = raw_entry[offsetof(struct TOC_ENTRY_V1, compression_flag)];
+        toc_entry->typecode = (char)raw_entry[offsetof(struct TOC_ENTRY_V1, typecode)];
+        toc_entry->name_offset = (uint32_t)(name_ptr - (const char *)toc_entry);
+        toc_entry->name_length = (uint32_t)name_length;
+
+        memcpy(name_ptr, raw_entry + HEADER_LENGTH, name_length + 1);
+        name_ptr += name_length + 1;
+    }
+
+    archive->toc_buffer = toc;
+    archive->toc = toc;
+    archive->toc_end = toc + num_entries;
+
+    rc = 0;
+    goto cleanup;
+
+malformed:
+    PYI_ERROR("Malformed archive TOC entry at offset %" PRIu64 "!\n", pos);
+
+cleanup:
+    free(data_buffer);
+
+    return rc;
 }
 
-/* Check if the TOC entry's typecode corresponds to an extractable file */
-static bool
-_pyi_archive_is_extractable(char typecode)
+/*
+ * Load version 2 TOC, which consists of fixed-size little-endian
+ * records, followed by the string table. On little-endian hosts, the
+ * TOC is used in-place from the memory mapping, if the mapping is
+ * available and the records are suitably aligned. Otherwise, the TOC
+ * is copied into a buffer (and on big-endian hosts, its records are
+ * converted to host byte order).
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static int
+_pyi_archive_load_toc_v2(struct ARCHIVE *archive, FILE *archive_fp, const struct ARCHIVE_COOKIE_V2 *cookie)
 {
-    switch (typecode) {
-        /* onefile mode */
-        case ARCHIVE_ITEM_BINARY:
-        case ARCHIVE_ITEM_DATA:
-        case ARCHIVE_ITEM_ZIPFILE:
-        case ARCHIVE_ITEM_SYMLINK: {
-            return true;
+    const unsigned char *data;
+    unsigned char *buffer;
+    const struct TOC_ENTRY *toc_entry;
+    uint64_t records_length;
+    uint64_t i;
+
+    /* Entry and name offsets are stored as 32-bit values */
+    if (cookie->toc_length > UINT32_MAX) {
+        PYI_ERROR("Archive TOC is too large!\n");
+        return -1;
+    }
+    if (cookie->toc_count > cookie->toc_length / sizeof(struct TOC_ENTRY)) {
+        PYI_ERROR("Malformed archive TOC: invalid number of entries!\n");
+        return -1;
+    }
+    records_length = cookie->toc_count * sizeof(struct TOC_ENTRY);
+
+    data = _pyi_archive_get_toc_data(archive, archive_fp, cookie->toc_offset, cookie->toc_length, &buffer);
+    if (data == NULL) {
+        return -1;
+    }
+
+    if (buffer == NULL) {
+        if (_pyi_archive_host_is_little_endian() && ((uintptr_t)data % sizeof(uint64_t)) == 0) {
+            PYI_DEBUG("LOADER: using TOC in-place from the archive's memory mapping.\n");
+        } else {
+            /* Copy from the mapping */
+            buffer = (unsigned char *)malloc((size_t)cookie->toc_length);
+            if (buffer == NULL) {
+                PYI_PERROR("malloc", "Could not allocate buffer for TOC!\n");
+                return -1;
+            }
+            memcpy(buffer, data, (size_t)cookie->toc_length);
         }
-        /* MERGE mode */
-        case ARCHIVE_ITEM_DEPENDENCY: {
-            return true;
+    }
+
+    if (buffer) {
+        /* Convert the records to host byte order */
+        if (!_pyi_archive_host_is_little_endian()) {
+            struct TOC_ENTRY *record = (struct TOC_ENTRY *)buffer;
+            for (i = 0; i < cookie->toc_count; i++, record++) {
+                const unsigned char *raw_entry = (const unsigned char *)record;
+                struct TOC_ENTRY decoded = *record;
+
+                decoded.offset = _pyi_archive_read_le64(raw_entry + offsetof(struct TOC_ENTRY, offset));
+                decoded.length = _pyi_archive_read_le64(raw_entry + offsetof(struct TOC_ENTRY, length));
+                decoded.uncompressed_length = _pyi_archive_read_le64(raw_entry + offsetof(struct TOC_ENTRY, uncompressed_length));
+                decoded.name_offset = _pyi_archive_read_le32(raw_entry + offsetof(struct TOC_ENTRY, name_offset));
+                decoded.name_length = _pyi_archive_read_le32(raw_entry + offsetof(struct TOC_ENTRY, name_length));
+
+                *record = decoded;
+            }
         }
-        default: {
-            break;
+        archive->toc_buffer = buffer;
+        data = buffer;
+    }
+
+    archive->toc = (const struct TOC_ENTRY *)data;
+    archive->toc_end = archive->toc + cookie->toc_count;
+
+    /* Validate that names are located within the string table, and that
+     * they are properly terminated. */
+    for (toc_entry = archive->toc, i = 0; i < cookie->toc_count; toc_entry++, i++) {
+        uint64_t name_pos = i * sizeof(struct TOC_ENTRY) + toc_entry->name_offset;
+        if (name_pos < records_length || name_pos >= cookie->toc_length ||
+            toc_entry->name_length >= cookie->toc_length - name_pos ||
+            pyi_archive_get_entry_name(toc_entry)[toc_entry->name_length] != 0) {
+            PYI_ERROR("Malformed archive TOC: entry #%" PRIu64 " has invalid name!\n", i);
+            return -1;
         }
     }
 
-    return false;
+    return 0;
 }
 
 /*
@@ -389,12 +2830,24 @@ _pyi_archive_is_extractable(char typecode)
  */
 struct ARCHIVE *
 pyi_archive_open(const char *filename)
+{
+    return pyi_archive_open_with_hint(filename, NULL);
+}
+
+/*
+ * Open the archive, using the (optional) hint that was obtained from
+ * the same archive by pyi_archive_format_hint(), typically in a parent
+ * process. A hint that does not match the archive file is ignored.
+ */
+struct ARCHIVE *
+pyi_archive_open_with_hint(const char *filename, const char *hint)
 {
     FILE *archive_fp = NULL;
     uint64_t cookie_pos = 0;
-    struct ARCHIVE_COOKIE archive_cookie;
+    size_t cookie_size;
+    struct ARCHIVE_COOKIE_V2 archive_cookie;
     struct ARCHIVE *archive = NULL;
-    struct TOC_ENTRY *toc_entry;
+    int rc;
 
     PYI_DEBUG("LOADER: attempting to open archive %s\n", filename);
 
@@ -406,20 +2859,30 @@ pyi_archive_open(const char *filename)
     }
 
     /* Search for the embedded archive's cookie */
-    cookie_pos = _pyi_archive_find_pkg_cookie_offset(archive_fp);
+    cookie_pos = _pyi_archive_find_pkg_cookie_offset(archive_fp, hint);
     if (cookie_pos == 0) {
         PYI_DEBUG("LOADER: cannot find cookie!\n");
         goto cleanup;
     }
     PYI_DEBUG("LOADER: cookie found at offset 0x%" PRIX64 "\n", cookie_pos);
 
-    /* Read the cookie */
-    if (pyi_fseek(archive_fp, cookie_pos, SEEK_SET) < 0) {
-        PYI_PERROR("fseek", "Failed to seek to cookie position!\n");
+    /* Read the cookie (of either format version) */
+    cookie_size = _pyi_archive_read_cookie(archive_fp, cookie_pos, &archive_cookie, NULL);
+    if (cookie_size == 0) {
+        PYI_PERROR("fread", "Failed to read cookie!\n");
         goto cleanup;
     }
-    if (fread(&archive_cookie, sizeof(struct ARCHIVE_COOKIE), 1, archive_fp) < 1) {
-        PYI_PERROR("fread", "Failed to read cookie!\n");
+    if (archive_cookie.format_version != 1 && archive_cookie.format_version != 2) {
+        PYI_ERROR("Unsupported archive format version %u!\n", archive_cookie.format_version);
+        goto cleanup;
+    }
+    PYI_DEBUG("LOADER: archive format version %u.\n", archive_cookie.format_version);
+
+    /* Validate the archive and TOC extents */
+    if (archive_cookie.pkg_length < cookie_size || archive_cookie.pkg_length > cookie_pos + cookie_size ||
+        archive_cookie.toc_offset > archive_cookie.pkg_length - cookie_size ||
+        archive_cookie.toc_length > archive_cookie.pkg_length - cookie_size - archive_cookie.toc_offset) {
+        PYI_ERROR("Malformed archive cookie!\n");
         goto cleanup;
     }
 
@@ -434,11 +2897,18 @@ pyi_archive_open(const char *filename)
      * bootloader, the string is guaranteed to be within PYI_PATH_MAX limit */
     snprintf(archive->filename, PYI_PATH_MAX, "%s", filename);
 
-    /* Fix endianness of cookie fields */
-    archive_cookie.pkg_length = pyi_be32toh(archive_cookie.pkg_length);
-    archive_cookie.toc_offset = pyi_be32toh(archive_cookie.toc_offset);
-    archive_cookie.toc_length = pyi_be32toh(archive_cookie.toc_length);
-    archive_cookie.python_version = pyi_be32toh(archive_cookie.python_version);
+    /* Keep the archive file open for positional reads of entries' data
+     * that are not available from the memory mapping. The handle is not
+     * inherited by child processes. */
+    archive->file = archive_fp;
+    archive_fp = NULL;
+#ifdef _WIN32
+    SetHandleInformation((HANDLE)_get_osfhandle(_fileno(archive->file)), HANDLE_FLAG_INHERIT, 0);
+#else
+    fcntl(fileno(archive->file), F_SETFD, FD_CLOEXEC);
+#endif
+
+    archive->format_version = (int)archive_cookie.format_version;
 
     /* Copy python version and python shared library name from cookie */
     archive->python_version = archive_cookie.python_version;
@@ -446,56 +2916,66 @@ pyi_archive_open(const char *filename)
 
     /* From the cookie position and declared archive size, calculate
      * the archive start position */
-    archive->pkg_offset = cookie_pos + sizeof(struct ARCHIVE_COOKIE) - archive_cookie.pkg_length;
+    archive->pkg_offset = cookie_pos + cookie_size - archive_cookie.pkg_length;
+    archive->pkg_length = archive_cookie.pkg_length;
+    archive->cookie_offset = cookie_pos;
 
-    /* Read the table of contents (TOC) */
-    pyi_fseek(archive_fp, archive->pkg_offset + archive_cookie.toc_offset, SEEK_SET);
-    archive->toc = (struct TOC_ENTRY *)malloc(archive_cookie.toc_length);
+    /* Map the archive into memory, so that the TOC can be read (or used
+     * in-place) and the entries can be extracted without re-opening the
+     * file for each of them. */
+    _pyi_archive_map(archive, archive->file);
 
-    if (archive->toc == NULL) {
-        PYI_PERROR("malloc", "Could not allocate buffer for TOC!\n");
-        goto cleanup;
+    /* Read the table of contents (TOC) */
+    if (archive->format_version == 1) {
+        rc = _pyi_archive_load_toc_v1(archive, archive->file, &archive_cookie);
+    } else {
+        rc = _pyi_archive_load_toc_v2(archive, archive->file, &archive_cookie);
     }
-
-    if (fread(archive->toc, archive_cookie.toc_length, 1, archive_fp) < 1) {
-        PYI_PERROR("fread", "Could not read full TOC!\n");
+    if (rc < 0) {
+        pyi_archive_free(&archive);
         goto cleanup;
     }
-    archive->toc_end = (const struct TOC_ENTRY *)(((const char *)archive->toc) + archive_cookie.toc_length);
 
-    /* Check input file is still ok (should be). */
-    if (ferror(archive_fp)) {
-        PYI_ERROR("Error on file.\n");
+    /* Build typed TOC index; extractable entries imply onefile semantics */
+    if (_pyi_archive_build_toc_groups(archive) < 0) {
+        pyi_archive_free(&archive);
         goto cleanup;
     }
+    archive->contains_extractable_entries = archive->toc_group_start[ARCHIVE_TOC_GROUP_EXTRACTABLE + 1] > archive->toc_group_start[ARCHIVE_TOC_GROUP_EXTRACTABLE] ||
+        archive->toc_fsimage != NULL;
 
-    /* Fix the endianness of the fields in the TOC entries. At the same
-     * time, check for extractable entries that imply onefile semantics. */
-    toc_entry = archive->toc;
-    while (toc_entry < archive->toc_end) {
-        /* Fixup the current TOC entry */
-        toc_entry->entry_length = pyi_be32toh(toc_entry->entry_length);
-        toc_entry->offset = pyi_be32toh(toc_entry->offset);
-        toc_entry->length = pyi_be32toh(toc_entry->length);
-        toc_entry->uncompressed_length = pyi_be32toh(toc_entry->uncompressed_length);
+    /* Build hash index for look-up of entries by name */
+    _pyi_archive_build_toc_index(archive, (uint32_t)(archive->toc_end - archive->toc));
 
-        /* Check if entry is extractable */
-        archive->contains_extractable_entries |= _pyi_archive_is_extractable(toc_entry->typecode);
+cleanup:
+    if (archive_fp) {
+        fclose(archive_fp);
+    }
 
-        /* Check if this is SPLASH entry */
-        if (toc_entry->typecode == ARCHIVE_ITEM_SPLASH) {
-            archive->toc_splash = toc_entry;
-        }
+    return archive;
+}
 
-        /* Jump to next entry; with the current entry fixed up, we can
-         * use non-const equivalent of pyi_archive_next_toc_entry() */
-        toc_entry = (struct TOC_ENTRY *)((const char *)toc_entry + toc_entry->entry_length);
-    }
 
-cleanup:
-    fclose(archive_fp);
+/*
+ * Format the hint that allows the archive to be re-opened without
+ * searching for its cookie (see pyi_archive_open_with_hint()): the
+ * offset of the cookie, followed by the identity of the archive file.
+ * Returns 0 on success, -1 on error.
+ */
+int
+pyi_archive_format_hint(const struct ARCHIVE *archive, char *hint, size_t hint_size)
+{
+    char identity[PYI_ARCHIVE_HINT_MAX];
+    int length;
 
-    return archive;
+    if (archive->file == NULL || _pyi_archive_format_file_identity(archive->file, identity, sizeof(identity)) < 0) {
+        return -1;
+    }
+    length = snprintf(hint, hint_size, "%" PRIx64 ":%s", archive->cookie_offset, identity);
+    if (length < 0 || (size_t)length >= hint_size) {
+        return -1;
+    }
+    return 0;
 }
 
 
@@ -515,14 +2995,259 @@ pyi_archive_free(struct ARCHIVE **archive_ref)
         return;
     }
 
-    /* Free the TOC buffer */
-    free(archive->toc);
+    /* Unmap and close the archive file */
+    _pyi_archive_unmap(archive);
+    if (archive->file) {
+        fclose(archive->file);
+    }
+
+    /* Free the checksums, and the TOC buffer and its index */
+    free(archive->checksums);
+    free(archive->toc_groups);
+    free(archive->toc_index);
+    free(archive->toc_buffer);
 
     /* Free the structure itself */
     free(archive);
 }
 
 
+/*
+ * Compute a 64-bit digest of the whole PKG archive (entries' data, TOC,
+ * and cookie). The digest is not cryptographically secure; it is meant
+ * to be used as a content-derived identifier of the archive, for
+ * example, as key for the persistent extraction cache. The digest is
+ * computed only once; subsequent calls return the stored value.
+ *
+ * The data is processed in 64-bit words, using FNV-1a style mixing;
+ * trailing bytes are processed individually.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static uint64_t
+_pyi_archive_digest_update(uint64_t digest, const unsigned char *data, size_t length)
+{
+    const uint64_t FNV_PRIME = 0x100000001B3ULL;
+    uint64_t word;
+
+    while (length >= sizeof(word)) {
+        memcpy(&word, data, sizeof(word));
+        digest = (digest ^ word) * FNV_PRIME;
+        digest ^= digest >> 29;
+        data += sizeof(word);
+        length -= sizeof(word);
+    }
+    while (length > 0) {
+        digest = (digest ^ *data) * FNV_PRIME;
+        data++;
+        length--;
+    }
+
+    return digest;
+}
+
+int
+pyi_archive_compute_digest(struct ARCHIVE *archive, uint64_t *digest)
+{
+    const size_t CHUNK_SIZE = 65536;
+    const uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+    unsigned char *buffer;
+    uint64_t file_offset;
+    int64_t chunk_size;
+
+    if (archive->has_digest) {
+        *digest = archive->digest;
+        return 0;
+    }
+
+    *digest = FNV_OFFSET_BASIS;
+
+    /* If archive is memory-mapped, process it directly */
+    if (archive->pkg_data) {
+        *digest = _pyi_archive_digest_update(*digest, archive->pkg_data, (size_t)archive->pkg_data_length);
+        archive->digest = *digest;
+        archive->has_digest = true;
+        return 0;
+    }
+
+    /* Otherwise, read the archive chunk by chunk, from the start of the
+     * PKG archive until the end of file. */
+    buffer = (unsigned char *)malloc(CHUNK_SIZE);
+    if (buffer == NULL) {
+        PYI_PERROR("malloc", "Failed to compute archive digest: failed to allocate temporary buffer!\n");
+        return -1;
+    }
+
+    file_offset = archive->pkg_offset;
+    while ((chunk_size = _pyi_archive_pread(archive, file_offset, buffer, CHUNK_SIZE)) > 0) {
+        *digest = _pyi_archive_digest_update(*digest, buffer, (size_t)chunk_size);
+        file_offset += (uint64_t)chunk_size;
+    }
+
+    free(buffer);
+
+    if (chunk_size < 0) {
+        PYI_PERROR("pread", "Failed to compute archive digest: failed to read data!\n");
+        return -1;
+    }
+
+    archive->digest = *digest;
+    archive->has_digest = true;
+    return 0;
+}
+
+
+/*
+ * Load the checksum table of the archive, which enables verification of
+ * the extracted data. Returns 0 on success, and -1 if the archive has no
+ * (valid) checksum table.
+ */
+int
+pyi_archive_enable_checksums(struct ARCHIVE *archive)
+{
+    const struct TOC_ENTRY *last_entry;
+    unsigned char *data;
+    uint32_t num_entries;
+    uint32_t i;
+
+    if (archive->checksums) {
+        return 0;
+    }
+
+    /* The checksum table is the last entry, and covers all entries */
+    num_entries = (uint32_t)(archive->toc_end - archive->toc);
+    if (num_entries == 0) {
+        return -1;
+    }
+    last_entry = archive->toc_end - 1;
+    if (last_entry->typecode != ARCHIVE_ITEM_CHECKSUMS) {
+        return -1;
+    }
+    if (last_entry->compression_flag != ARCHIVE_COMPRESSION_NONE || last_entry->uncompressed_length != (uint64_t)num_entries * sizeof(uint32_t)) {
+        PYI_WARNING("LOADER: checksum table of the archive is malformed!\n");
+        return -1;
+    }
+
+    /* The checksums are not enabled yet, so the table itself is not
+     * verified during its extraction */
+    data = pyi_archive_extract(archive, last_entry);
+    if (data == NULL) {
+        return -1;
+    }
+    for (i = 0; i < num_entries; i++) {
+        ((uint32_t *)data)[i] = _pyi_archive_read_le32(data + i * sizeof(uint32_t));
+    }
+
+    archive->checksums = (uint32_t *)data;
+    archive->num_checksums = num_entries;
+
+    return 0;
+}
+
+/*
+ * Look up the checksum of the given entry's data. Returns false if the
+ * checksums are not enabled for the archive, or if the entry has no
+ * data of its own.
+ */
+bool
+pyi_archive_get_entry_checksum(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, uint32_t *checksum)
+{
+    uint32_t index;
+
+    if (archive->checksums == NULL) {
+        return false;
+    }
+    if (toc_entry->typecode == ARCHIVE_ITEM_SOLID_BLOCK || toc_entry->typecode == ARCHIVE_ITEM_CHECKSUMS) {
+        return false;
+    }
+    /* The data of cold entries is verified against the checksum table
+     * of the cold archive. */
+    if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_COLD) {
+        return false;
+    }
+
+    /* Version 1 TOC entries are converted into fixed-size records, so
+     * the entry's index can be computed from its position. */
+    index = (uint32_t)(toc_entry - archive->toc);
+    if (index >= archive->num_checksums) {
+        return false;
+    }
+
+    *checksum = archive->checksums[index];
+    return true;
+}
+
+/*
+ * Verify the extracted data of the given entry against its checksum.
+ * Returns 0 if the data matches (or if there is no checksum to compare
+ * against), and -1 on mismatch, after emitting an error message.
+ */
+int
+pyi_archive_verify_data(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const unsigned char *data)
+{
+    uint32_t expected_checksum;
+
+    if (!pyi_archive_get_entry_checksum(archive, toc_entry, &expected_checksum)) {
+        return 0;
+    }
+    if (_pyi_archive_checksum_update(0, data, toc_entry->uncompressed_length) != expected_checksum) {
+        PYI_ERROR("Failed to extract %s: checksum mismatch!\n", pyi_archive_get_entry_name(toc_entry));
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Verify that the given file (for example, a previously extracted file
+ * in the extraction cache) holds the data of the given entry. Returns 0
+ * if the file's size and checksum match (or if there is no checksum to
+ * compare against), and -1 otherwise. Does not emit error messages.
+ */
+int
+pyi_archive_verify_file(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *filename)
+{
+    const size_t CHUNK_SIZE = PYI_ARCHIVE_SESSION_DEFAULT_BUFFER_SIZE;
+    uint32_t expected_checksum;
+    uint32_t checksum = 0;
+    uint64_t file_length = 0;
+    unsigned char *buffer;
+    size_t chunk_size;
+    FILE *fp;
+    int rc = 0;
+
+    if (!pyi_archive_get_entry_checksum(archive, toc_entry, &expected_checksum)) {
+        return 0;
+    }
+
+    fp = pyi_path_fopen(filename, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+    buffer = (unsigned char *)malloc(CHUNK_SIZE);
+    if (buffer == NULL) {
+        fclose(fp);
+        return -1;
+    }
+
+    while ((chunk_size = fread(buffer, 1, CHUNK_SIZE, fp)) > 0) {
+        checksum = _pyi_archive_checksum_update(checksum, buffer, chunk_size);
+        file_length += chunk_size;
+        if (file_length > toc_entry->uncompressed_length) {
+            break;
+        }
+    }
+    if (ferror(fp) || file_length != toc_entry->uncompressed_length || checksum != expected_checksum) {
+        rc = -1;
+    }
+
+    free(buffer);
+    fclose(fp);
+
+    return rc;
+}
+
+
 /*
  * Find a TOC entry by its name and return it.
  */
@@ -530,25 +3255,26 @@ const struct TOC_ENTRY *
 pyi_archive_find_entry_by_name(const struct ARCHIVE *archive, const char *name)
 {
     const struct TOC_ENTRY *toc_entry;
+    uint32_t slot;
 
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-#if defined(_WIN32) || defined(__APPLE__)
-        /* On Windows and macOS, use case-insensitive comparison to
-         * simulate case-insensitive filesystem for extractable entries. */
-        if (_pyi_archive_is_extractable(toc_entry->typecode)) {
-            if (strcasecmp(toc_entry->name, name) == 0) {
-                return toc_entry;
-            }
-        } else {
-            if (strcmp(toc_entry->name, name) == 0) {
+    /* Fall back to linear search if index is unavailable */
+    if (archive->toc_index == NULL) {
+        for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
+            if (_pyi_archive_entry_name_matches(toc_entry, name)) {
                 return toc_entry;
             }
         }
-#else
-        if (strcmp(toc_entry->name, name) == 0) {
+        return NULL;
+    }
+
+    /* Walk the probe sequence until an empty slot is encountered */
+    slot = _pyi_archive_hash_name(name) & archive->toc_index_mask;
+    while (archive->toc_index[slot] != 0) {
+        toc_entry = (const struct TOC_ENTRY *)((const char *)archive->toc + archive->toc_index[slot] - 1);
+        if (_pyi_archive_entry_name_matches(toc_entry, name)) {
             return toc_entry;
         }
-#endif
+        slot = (slot + 1) & archive->toc_index_mask;
     }
 
     return NULL;
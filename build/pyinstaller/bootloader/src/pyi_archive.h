@@ -31,23 +31,171 @@
 #define ARCHIVE_ITEM_PYMODULE         'm'  /* Python module */
 #define ARCHIVE_ITEM_PYSOURCE         's'  /* Python script (v3) */
 #define ARCHIVE_ITEM_DATA             'x'  /* data */
+#define ARCHIVE_ITEM_LAZY_DATA        'X'  /* data, extracted on demand */
 #define ARCHIVE_ITEM_RUNTIME_OPTION   'o'  /* runtime option */
 #define ARCHIVE_ITEM_SPLASH           'l'  /* splash resources */
 #define ARCHIVE_ITEM_SYMLINK          'n'  /* symbolic link */
+#define ARCHIVE_ITEM_SOLID_BLOCK      'k'  /* solid block - compressed data of multiple small data entries */
+#define ARCHIVE_ITEM_ALIAS            'D'  /* alias - duplicate of a binary or data entry (see below) */
+#define ARCHIVE_ITEM_CHECKSUMS        'c'  /* checksum table - CRC-32 of entries' data (see below) */
+#define ARCHIVE_ITEM_FSIMAGE          'F'  /* read-only filesystem image of onefile application (see pyi_fsimage.c) */
 
-/* Entry in PKG/CArchive TOC */
+/* Compression methods of CArchive items (values of compression_flag).
+ * Decoding of ZSTD and LZ4 entries requires the bootloader to be built
+ * with corresponding library (see --with-zstd and --with-lz4 options
+ * of waf configure). */
+#define ARCHIVE_COMPRESSION_NONE      0  /* uncompressed */
+#define ARCHIVE_COMPRESSION_ZLIB      1  /* zlib stream */
+#define ARCHIVE_COMPRESSION_ZSTD      2  /* Zstandard frame */
+#define ARCHIVE_COMPRESSION_LZ4       3  /* LZ4 frame */
+#define ARCHIVE_COMPRESSION_SOLID     4  /* member of a solid block (see below) */
+#define ARCHIVE_COMPRESSION_COLD      5  /* data stored in the cold archive (see below) */
+#define ARCHIVE_COMPRESSION_FRAMED    6  /* sequence of independently compressed frames (see below) */
+
+/* Members of a solid block (entries with ARCHIVE_COMPRESSION_SOLID)
+ * have no data blob of their own; their `offset` field holds the data
+ * offset of the block's ARCHIVE_ITEM_SOLID_BLOCK entry, and their
+ * `length` field holds the offset of their data within the decompressed
+ * block. An extraction session keeps the most recently decompressed
+ * block, so that consecutive members are extracted with a single
+ * decompression of their block. */
+
+/* Entries with ARCHIVE_COMPRESSION_COLD are lazily-extracted data
+ * entries whose data is stored in a separate, side-loaded archive (the
+ * cold archive, named by the `pyi-cold-archive` run-time option). They
+ * have no data blob of their own; their `offset` and `length` fields
+ * are zero, and the cold archive contains a lazily-extracted data entry
+ * with the same name that holds the actual data. Their data can only
+ * be extracted via the lazy extraction (see pyi_launch.c). */
+
+/* The data blob of framed entries (ARCHIVE_COMPRESSION_FRAMED) starts
+ * with the frame header (struct ARCHIVE_FRAME_HEADER), followed by the
+ * frame index, i.e., `num_frames + 1` little-endian 64-bit offsets of
+ * the frames relative to the start of the blob (the last of which is
+ * the length of the blob), and by the frames themselves. Each frame is
+ * an independent zlib stream (or Zstandard or LZ4 frame, as specified
+ * by the header's compression flag) that holds `frame_size` bytes of
+ * the entry's uncompressed data; only the last frame may be shorter.
+ * A range of the entry's data can therefore be read by decompressing
+ * only the frames that cover it (see pyi_archive_read_range()), and the
+ * frames of a large entry are decompressed by multiple threads. */
+
+/* Alias entries (ARCHIVE_ITEM_ALIAS) are binary or data entries whose
+ * contents are identical to those of another (canonical) extractable
+ * entry; they share the data fields (offset, lengths and compression
+ * flag) of the canonical entry, so their data can be extracted in the
+ * same way as that of any other entry. The canonical entry has the same
+ * data offset and length fields, and is not an alias itself. During
+ * extraction of onefile application, the alias files are created by
+ * cloning the extracted file of the canonical entry. (The lower-case
+ * 'a' typecode is not used for aliases, because it is already emitted
+ * for nested PKG entries.) */
+
+/* The optional checksum table (ARCHIVE_ITEM_CHECKSUMS) is the last
+ * entry of the TOC; its uncompressed data holds a little-endian 32-bit
+ * CRC-32 checksum of the uncompressed data of each TOC entry, in the
+ * TOC order. Entries without data of their own (solid blocks, runtime
+ * options, dependencies, and the table itself) have zero checksum; the
+ * alias entries and members of solid blocks have the checksum of their
+ * own (uncompressed) data. */
+
+/* Groups of the typed TOC index; each group lists the entries of the
+ * corresponding type(s), in TOC order. Lazily-extracted data entries
+ * appear in both the extractable and the lazy data group. */
+#define ARCHIVE_TOC_GROUP_OPTIONS     0  /* 'o' - runtime options */
+#define ARCHIVE_TOC_GROUP_MODULES     1  /* 'm', 'M' - bootstrap modules */
+#define ARCHIVE_TOC_GROUP_SCRIPTS     2  /* 's' - scripts */
+#define ARCHIVE_TOC_GROUP_PYZ         3  /* 'z' - PYZ archives */
+#define ARCHIVE_TOC_GROUP_EXTRACTABLE 4  /* 'b', 'x', 'X', 'Z', 'n', 'D', 'd' - onefile and MERGE entries */
+#define ARCHIVE_TOC_GROUP_LAZY_DATA   5  /* 'X' - lazily-extracted data */
+#define ARCHIVE_TOC_GROUP_SOLID_BLOCKS 6  /* 'k' - solid blocks */
+#define ARCHIVE_TOC_GROUP_COUNT       7
+
+/* Minimal size of uncompressed entry for which the extraction uses
+ * kernel-side copy from the archive file (where available). */
+#define PYI_ARCHIVE_KERNEL_COPY_THRESHOLD (64 * 1024)
+
+/* Default size of the I/O buffers of an extraction session. */
+#define PYI_ARCHIVE_SESSION_DEFAULT_BUFFER_SIZE (64 * 1024)
+
+/* Maximum length of the archive hint (see pyi_archive_format_hint()),
+ * including the terminating NULL character. */
+#define PYI_ARCHIVE_HINT_MAX 128
+
+/* Maximal uncompressed size of zlib-compressed entry that is decoded
+ * in one shot by libdeflate when it is written into a file (or read
+ * from a file), using a temporary buffer. Larger entries are streamed
+ * through zlib. Entries extracted into a memory buffer are always
+ * decoded in one shot. */
+#define PYI_ARCHIVE_ONESHOT_MAX_LENGTH (64 * 1024 * 1024)
+
+/* Maximal number of threads that decompress the frames of a framed
+ * entry, and the minimal length of the uncompressed data for which
+ * the frames are decompressed in parallel. */
+#define PYI_ARCHIVE_FRAME_MAX_THREADS 8
+#define PYI_ARCHIVE_FRAME_PARALLEL_MIN_LENGTH (4 * 1024 * 1024)
+
+/* Maximal length of the temporary buffer into which the frames of a
+ * framed entry are decompressed when the entry is written into a file,
+ * or when only a part of the frames' data is read. */
+#define PYI_ARCHIVE_FRAME_BUFFER_MAX_LENGTH (32 * 1024 * 1024)
+
+/* Maximal length of the archive range that pyi_archive_extract_batch()
+ * reads with a single read, when the archive is not memory-mapped. */
+#define PYI_ARCHIVE_BATCH_MAX_SPAN (16 * 1024 * 1024)
+
+/* Entry in PKG/CArchive TOC. This is the native layout of the TOC
+ * records of archive format version 2, which store the fields in
+ * little-endian byte order. On little-endian hosts, the version 2 TOC
+ * is therefore used in-place, directly from the archive's memory
+ * mapping (provided that it is suitably aligned). Version 1 TOCs and
+ * version 2 TOCs on big-endian hosts are converted into this layout
+ * when the archive is opened.
+ *
+ * The records are followed by a string table that holds entries'
+ * names as NUL-terminated strings. To keep the records position
+ * independent, the location of entry's name is stored relative to the
+ * record itself; use pyi_archive_get_entry_name() to obtain it. */
 struct TOC_ENTRY
+{
+    uint64_t offset; /* position of entry's data blob, relative to the start of PKG archive */
+    uint64_t length; /* length of compressed data blob */
+    uint64_t uncompressed_length; /* length of uncompressed data blob */
+    uint32_t name_offset; /* position of entry's name, relative to the start of this record */
+    uint32_t name_length; /* length of entry's name, excluding the terminating NUL */
+    unsigned char compression_flag; /* compression method - see ARCHIVE_COMPRESSION_* definitions */
+    char typecode; /* type code - see ARCHIVE_ITEM_* definitions */
+    unsigned char reserved[6]; /* padding to multiple of 8 bytes; must be zero */
+};
+
+/* Header of the data blob of framed entries, as stored in the archive.
+ * The fields are stored in little-endian order. */
+struct ARCHIVE_FRAME_HEADER
+{
+    uint32_t frame_size; /* uncompressed length of each frame, except for the last one */
+    uint32_t num_frames; /* number of frames */
+    unsigned char compression_flag; /* compression method of the frames - see ARCHIVE_COMPRESSION_* definitions */
+    unsigned char reserved[7]; /* must be zero */
+};
+
+/* Maximal frame size of framed entries that the bootloader accepts. */
+#define ARCHIVE_FRAME_SIZE_MAX (64 * 1024 * 1024)
+
+/* Entry in version 1 PKG/CArchive TOC, as stored in the archive. The
+ * fields are stored in big-endian order. */
+struct TOC_ENTRY_V1
 {
     uint32_t entry_length; /* length of this TOC entry, including full length of the name field */
     uint32_t offset; /* position of entry's data blob, relative to the start of PKG archive */
     uint32_t length; /* length of compressed data blob */
     uint32_t uncompressed_length; /* length of uncompressed data blob */
-    unsigned char compression_flag; /* compression flag (1 = compressed, 0 = uncompressed) */
+    unsigned char compression_flag; /* compression method - see ARCHIVE_COMPRESSION_* definitions */
     char typecode; /* type code - see ARCHIVE_ITEM_* definitions */
     char name[1];  /* entry name; padded to multiple of 16 */
 };
 
-/* The PKG/CArchive cookie, from the end of the archive. */
+/* The PKG/CArchive cookie, from the end of the archive (format
+ * version 1). The fields are stored in big-endian order. */
 struct ARCHIVE_COOKIE
 {
     char magic[8]; /* 'MEI\014\013\012\013\016' */
@@ -58,16 +206,86 @@ struct ARCHIVE_COOKIE
     char python_libname[64]; /* Name of the of Python shared library (e.g., "python3.10.dll"). */
 };
 
-/* The archive structure */
+/* Value of the field following the cookie's MAGIC pattern that denotes
+ * cookie of format version 2 or later; in version 1 cookie, the field
+ * holds the archive length, which can never take this value. */
+#define ARCHIVE_COOKIE_V2_MARKER 0xFFFFFFFFU
+
+/* The PKG/CArchive cookie, from the end of the archive (format
+ * version 2). The fields are stored in little-endian order, except
+ * for the marker. The TOC (records followed by the string table) spans
+ * `toc_length` bytes, starting at 8-byte aligned `toc_offset`. */
+struct ARCHIVE_COOKIE_V2
+{
+    char magic[8]; /* 'MEI\014\013\012\013\016' */
+    uint32_t marker; /* ARCHIVE_COOKIE_V2_MARKER */
+    uint32_t format_version; /* archive format version (2) */
+    uint64_t pkg_length; /* length of the entire PKG archive */
+    uint64_t toc_offset; /* position of TOC relative to start of PKG archive */
+    uint64_t toc_length; /* length of TOC data, including the string table */
+    uint64_t toc_count; /* number of TOC records */
+    uint32_t python_version; /* integer representing python version */
+    uint32_t reserved; /* must be zero */
+    char python_libname[64]; /* Name of the of Python shared library (e.g., "python3.10.dll"). */
+};
+
+/* The locator footer, optionally appended at the very end of the
+ * executable. Allows the cookie to be located with a single read,
+ * without scanning the file for the cookie's MAGIC pattern. The
+ * fields are stored in big-endian order. */
+struct ARCHIVE_LOCATOR
+{
+    char magic[8]; /* 'MEI\017\013\012\013\016' */
+    uint32_t cookie_offset_high; /* high 32 bits of the cookie's position in the file */
+    uint32_t cookie_offset_low; /* low 32 bits of the cookie's position in the file */
+    uint32_t cookie_checksum; /* CRC-32 of the cookie (of either format version) */
+    uint32_t checksum; /* CRC-32 of the preceding fields of the locator */
+};
+
+/* Entries extracted by pyi_archive_extract_batch(); the uncompressed
+ * data of the entries is stored back-to-back in a single buffer (the
+ * arena), and the data of the i-th entry starts at `offsets[i]`. The
+ * whole batch is released at once by pyi_archive_batch_free(). */
+struct ARCHIVE_BATCH
+{
+    unsigned char *arena;
+    size_t *offsets;
+    size_t count;
+};
+
+/* The archive structure. Once pyi_archive_open() returns, the structure
+ * (including the TOC and its indices) is not modified by any of the
+ * functions that take a `const struct ARCHIVE *`, so the archive can be
+ * shared by multiple threads that extract entries concurrently, as long
+ * as each thread uses its own extraction session (ARCHIVE_SESSION) for
+ * the decompression state and buffers. The functions that take a
+ * non-const pointer (pyi_archive_compute_digest(), for example) need
+ * to be called before the archive is shared. */
 struct ARCHIVE
 {
     /* Full path to archive file. */
     char filename[PYI_PATH_MAX];
 
+    /* The archive file, kept open for the lifetime of the structure.
+     * Its (shared) stdio file position is not used after the archive is
+     * opened; the data of entries that are not available from the
+     * memory mapping is read with explicit offsets (positional reads,
+     * see pyi_archive_read_at()). */
+    FILE *file;
+
     uint64_t pkg_offset; /* Offset of the PKG archive in the file */
+    uint64_t pkg_length; /* Length of the PKG archive */
+    uint64_t cookie_offset; /* Offset of the cookie in the file */
+
+    const struct TOC_ENTRY *toc; /* Array of TOC entries */
+    const struct TOC_ENTRY *toc_end; /* The address at which the TOC entries end */
+
+    /* Buffer holding the converted (or copied) TOC entries and string
+     * table; NULL if TOC is used in-place from the memory mapping. */
+    void *toc_buffer;
 
-    struct TOC_ENTRY *toc; /* Buffer containing all TOC entries */
-    const struct TOC_ENTRY *toc_end; /* The address at which the TOC buffer ends */
+    /* Archive format version (1 or 2) */
+    int format_version;
 
     /* Flag indicating that the archive contains extractable files,
      * and thus has onefile semantics */
@@ -76,6 +294,52 @@ struct ARCHIVE
     /* Pointer to SPLASH TOC entry, if available */
     const struct TOC_ENTRY *toc_splash;
 
+    /* Pointer to filesystem image TOC entry, if available; an archive
+     * with filesystem image also has onefile semantics. */
+    const struct TOC_ENTRY *toc_fsimage;
+
+    /* Open-addressing (linear probing) hash index of TOC entries by
+     * name, used by pyi_archive_find_entry_by_name(). Each slot holds
+     * the offset of the entry within the TOC buffer plus one (zero
+     * denotes an empty slot). The number of slots is a power of two;
+     * `toc_index_mask` is the number of slots minus one. If the index
+     * could not be allocated, `toc_index` is NULL and the lookup falls
+     * back to linear search. */
+    uint32_t *toc_index;
+    uint32_t toc_index_mask;
+
+    /* Typed TOC index, built once when the archive is opened, so that
+     * the consumers of particular entry types do not need to walk the
+     * whole TOC. The groups (see ARCHIVE_TOC_GROUP_* definitions) are
+     * stored back-to-back in `toc_groups`; group `i` spans the elements
+     * from `toc_group_start[i]` to `toc_group_start[i + 1]`. Use
+     * pyi_archive_get_toc_group() to access them. */
+    const struct TOC_ENTRY **toc_groups;
+    uint32_t toc_group_start[ARCHIVE_TOC_GROUP_COUNT + 1];
+
+    /* Read-only memory mapping of the archive file, spanning from the
+     * (page-aligned) offset preceding the start of PKG archive until the
+     * end of file. If mapping is not available (or failed), `pkg_data`
+     * is NULL and the entries are read using positional reads instead. */
+    void *mapped_base;
+    size_t mapped_length;
+
+    /* Pointer to start of PKG archive within the mapping, and the number
+     * of bytes that are available from that location onward. */
+    const unsigned char *pkg_data;
+    uint64_t pkg_data_length;
+
+    /* Digest of the PKG archive, stored by the first call to
+     * pyi_archive_compute_digest(); valid only if `has_digest` is set. */
+    uint64_t digest;
+    bool has_digest;
+
+    /* Checksums of TOC entries, loaded from the checksum table by
+     * pyi_archive_enable_checksums(), in host byte order and TOC order.
+     * If NULL, the extracted data is not verified. */
+    uint32_t *checksums;
+    uint32_t num_checksums;
+
     /* Python version: major * 100 + minor, e.g., 310 for python 3.10 */
     int python_version;
 
@@ -86,13 +350,48 @@ struct ARCHIVE
 
 /* The API */
 struct ARCHIVE *pyi_archive_open(const char *filename);
+struct ARCHIVE *pyi_archive_open_with_hint(const char *filename, const char *hint);
+int pyi_archive_format_hint(const struct ARCHIVE *archive, char *hint, size_t hint_size);
 void pyi_archive_free(struct ARCHIVE **archive_ref);
 
 const struct TOC_ENTRY *pyi_archive_next_toc_entry(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry);
+const char *pyi_archive_get_entry_name(const struct TOC_ENTRY *toc_entry);
+const struct TOC_ENTRY *const *pyi_archive_get_toc_group(const struct ARCHIVE *archive, int group, size_t *count);
 
 unsigned char *pyi_archive_extract(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry);
 int pyi_archive_extract2fs(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename);
 
+int pyi_archive_extract_batch(const struct ARCHIVE *archive, const struct TOC_ENTRY *const *toc_entries, size_t count, struct ARCHIVE_BATCH *batch);
+void pyi_archive_batch_free(struct ARCHIVE_BATCH *batch);
+
+/* Extraction session; re-uses the decompression state, I/O buffers,
+ * and the open archive file handle across extraction of multiple
+ * entries (from one or more archives). The session is opaque, and must
+ * not be shared between threads. pyi_archive_extract() and
+ * pyi_archive_extract2fs() use a temporary session for each call. */
+struct ARCHIVE_SESSION;
+
+struct ARCHIVE_SESSION *pyi_archive_session_new(size_t buffer_size);
+void pyi_archive_session_free(struct ARCHIVE_SESSION **session_ref);
+
+unsigned char *pyi_archive_session_extract(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry);
+int pyi_archive_session_extract_into(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, unsigned char *buffer);
+int pyi_archive_session_extract2fs(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename);
+int pyi_archive_session_extract2fp(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, FILE *out_fp);
+int pyi_archive_session_read_range(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, uint64_t offset, void *buffer, size_t length);
+int pyi_archive_read_range(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, uint64_t offset, void *buffer, size_t length);
+const unsigned char *pyi_archive_get_mapped_data(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry);
+int pyi_archive_read_at(const struct ARCHIVE *archive, uint64_t offset, void *buffer, size_t length);
+void pyi_archive_account_entry(const struct TOC_ENTRY *toc_entry);
+void pyi_archive_readahead(const struct ARCHIVE *archive, uint64_t offset, uint64_t length);
+
 const struct TOC_ENTRY *pyi_archive_find_entry_by_name(const struct ARCHIVE *archive, const char *name);
 
+int pyi_archive_compute_digest(struct ARCHIVE *archive, uint64_t *digest);
+
+int pyi_archive_enable_checksums(struct ARCHIVE *archive);
+bool pyi_archive_get_entry_checksum(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, uint32_t *checksum);
+int pyi_archive_verify_data(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const unsigned char *data);
+int pyi_archive_verify_file(const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *filename);
+
 #endif /* PYI_ARCHIVE_H */
@@ -0,0 +1,145 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Bump-pointer arena for transient allocations made during startup.
+ *
+ * Many of the allocations made during the bootloader's startup are
+ * small and short-lived, and all of them become unused at the same
+ * point: the copies of environment variable values that are checked
+ * in pyi_main(), and the parsed run-time options, which are needed
+ * only until the python interpreter is initialized (or, in the onefile
+ * parent process, until the files are extracted). Such allocations are
+ * made from the arena in PYI_CONTEXT, which carves them out of larger
+ * chunks by advancing a pointer, and releases all of them at once.
+ * This avoids individual malloc()/free() calls (and the corresponding
+ * bookkeeping in error paths), and the heap fragmentation in the
+ * long-lived onefile parent process.
+ *
+ * The memory returned by the arena is zero-initialized, and aligned
+ * for any of the types used by the bootloader.
+ */
+
+#include <stdlib.h> /* calloc, free */
+#include <string.h> /* memcpy, strlen */
+
+#include "pyi_arena.h"
+
+
+/* Alignment of allocations */
+#define _PYI_ARENA_ALIGNMENT (2 * sizeof(void *))
+#define _PYI_ARENA_ALIGN(size) (((size) + _PYI_ARENA_ALIGNMENT - 1) & ~(_PYI_ARENA_ALIGNMENT - 1))
+
+struct PYI_ARENA_CHUNK
+{
+    struct PYI_ARENA_CHUNK *next;
+    size_t size; /* Size of the data area */
+    size_t used; /* Used part of the data area */
+};
+
+/* Offset of the data area from the start of the chunk */
+#define _PYI_ARENA_CHUNK_HEADER_SIZE _PYI_ARENA_ALIGN(sizeof(struct PYI_ARENA_CHUNK))
+
+
+void *
+pyi_arena_alloc(struct PYI_ARENA *arena, size_t size)
+{
+    struct PYI_ARENA_CHUNK *chunk = arena->chunks;
+    void *ptr;
+
+    size = _PYI_ARENA_ALIGN(size ? size : 1);
+
+    /* Allocate a new chunk, if the current one has insufficient space.
+     * Allocations that exceed the regular chunk size obtain a chunk of
+     * their own, which is put behind the current chunk, so that the
+     * remaining space in the latter can still be used. */
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        struct PYI_ARENA_CHUNK *new_chunk;
+        size_t chunk_size = size > PYI_ARENA_CHUNK_SIZE ? size : PYI_ARENA_CHUNK_SIZE;
+
+        new_chunk = (struct PYI_ARENA_CHUNK *)calloc(1, _PYI_ARENA_CHUNK_HEADER_SIZE + chunk_size);
+        if (new_chunk == NULL) {
+            return NULL;
+        }
+        new_chunk->size = chunk_size;
+
+        if (chunk != NULL && size > PYI_ARENA_CHUNK_SIZE) {
+            new_chunk->next = chunk->next;
+            chunk->next = new_chunk;
+        } else {
+            new_chunk->next = chunk;
+            arena->chunks = new_chunk;
+        }
+        chunk = new_chunk;
+    }
+
+    ptr = (unsigned char *)chunk + _PYI_ARENA_CHUNK_HEADER_SIZE + chunk->used;
+    chunk->used += size;
+
+    arena->num_allocations++;
+    arena->allocated_size += size;
+
+    return ptr;
+}
+
+char *
+pyi_arena_strdup(struct PYI_ARENA *arena, const char *str)
+{
+    size_t size = strlen(str) + 1;
+    char *copy = pyi_arena_alloc(arena, size);
+
+    if (copy != NULL) {
+        memcpy(copy, str, size);
+    }
+    return copy;
+}
+
+wchar_t *
+pyi_arena_wcsdup(struct PYI_ARENA *arena, const wchar_t *str)
+{
+    size_t size = (wcslen(str) + 1) * sizeof(wchar_t);
+    wchar_t *copy = pyi_arena_alloc(arena, size);
+
+    if (copy != NULL) {
+        memcpy(copy, str, size);
+    }
+    return copy;
+}
+
+/* Release all allocations made from the arena; the arena remains
+ * usable afterwards. */
+void
+pyi_arena_release(struct PYI_ARENA *arena)
+{
+    struct PYI_ARENA_CHUNK *chunk = arena->chunks;
+
+    if (chunk == NULL) {
+        return;
+    }
+
+    PYI_DEBUG(
+        "LOADER: releasing startup arena: %lu allocations, %lu bytes.\n",
+        (unsigned long)arena->num_allocations,
+        (unsigned long)arena->allocated_size
+    );
+
+    while (chunk != NULL) {
+        struct PYI_ARENA_CHUNK *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena->chunks = NULL;
+    arena->num_allocations = 0;
+    arena->allocated_size = 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Bump-pointer arena for transient allocations made during startup.
+ */
+
+#ifndef PYI_ARENA_H
+#define PYI_ARENA_H
+
+#include <stddef.h> /* size_t */
+#include <wchar.h> /* wchar_t */
+
+#include "pyi_global.h"
+
+struct PYI_ARENA_CHUNK;
+
+/* The arena; a zero-initialized structure is a valid, empty arena.
+ * Not thread-safe; meant to be used from the main thread only. */
+struct PYI_ARENA
+{
+    /* Chunks of memory that allocations are carved from; the current
+     * chunk is the first in the list. */
+    struct PYI_ARENA_CHUNK *chunks;
+
+    /* Number of allocations and their total size since the last
+     * release; for debug output. */
+    size_t num_allocations;
+    size_t allocated_size;
+};
+
+/* Size of a regular chunk; larger allocations are given a chunk of
+ * their own. */
+#define PYI_ARENA_CHUNK_SIZE (16 * 1024)
+
+void *pyi_arena_alloc(struct PYI_ARENA *arena, size_t size);
+char *pyi_arena_strdup(struct PYI_ARENA *arena, const char *str);
+wchar_t *pyi_arena_wcsdup(struct PYI_ARENA *arena, const wchar_t *str);
+
+void pyi_arena_release(struct PYI_ARENA *arena);
+
+#endif /* PYI_ARENA_H */
@@ -0,0 +1,988 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Persistent extraction cache for onefile applications.
+ *
+ * When enabled, the onefile parent process does not unpack the
+ * application into an ephemeral temporary directory, but into a per-user
+ * cache directory, whose name is derived from the executable's name and
+ * the digest of its PKG archive:
+ *
+ *   <cache root>/<executable name>-<16 hex digits of PKG digest>
+ *
+ * If such directory already exists, the extraction is skipped entirely,
+ * and the directory is used as the application's top-level directory
+ * (cache hit). Otherwise, the application is unpacked into a staging
+ * directory next to it; once the extraction is complete, and before the
+ * child process is started, the staging directory is renamed into its
+ * final location in a single (atomic) operation, so a partially-populated
+ * cache entry is never visible to other instances, and the child process
+ * (as well as the instances launched while it runs) uses the final
+ * location. If the Tcl/Tk splash screen is shown, the staging directory
+ * holds its shared libraries and scripts, so the rename is deferred until
+ * the application exits. If renaming fails (for example, because another
+ * instance of the program populated the cache first), the staging
+ * directory is removed in the same way as an ephemeral temporary
+ * directory once the application exits.
+ *
+ * The cache root directory is:
+ *  - Windows: %LOCALAPPDATA%\pyinstaller
+ *  - macOS: ~/Library/Caches/pyinstaller
+ *  - other POSIX: $XDG_CACHE_HOME/pyinstaller or ~/.cache/pyinstaller
+ *
+ * Whenever a cache entry is used or created, other entries of the same
+ * program (i.e., of its other versions) that have not been used for
+ * PYI_CACHE_EVICTION_AGE seconds are evicted.
+ *
+ * The "shared" sub-directory of the cache root holds the shared
+ * dependency store of multi-package (MERGE) builds; see
+ * pyi_cache_extract_shared_dependency(). Its entries are named and
+ * evicted in the same way, but belong to the referenced programs, and
+ * contain only the dependencies that other programs referenced.
+ *
+ * If checksum verification is enabled (`pyi-verify-checksums` run-time
+ * option), the files of an existing cache entry are validated against
+ * the checksums from the archive before the entry is used; a damaged
+ * entry is removed, and the application is extracted anew.
+ */
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <process.h> /* _getpid */
+#else
+    #include <dirent.h>
+    #include <errno.h>
+    #include <sys/stat.h>
+    #include <sys/time.h> /* utimes */
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_archive.h"
+#include "pyi_cache.h"
+#include "pyi_launch.h"  /* PYI_LAUNCH_MAX_EXTRACTION_THREADS */
+#include "pyi_main.h"
+#include "pyi_path.h"
+#include "pyi_thread.h"
+#include "pyi_utils.h"
+
+
+/* Suffix of staging directories, which is appended to the path of the
+ * final cache entry directory. */
+#define _PYI_CACHE_STAGING_SUFFIX "-staging-"
+
+/* Number of hexadecimal digits in the digest part of cache entry name. */
+#define _PYI_CACHE_DIGEST_LENGTH 16
+
+
+/**********************************************************************\
+ *                        Cache entry naming                          *
+\**********************************************************************/
+/*
+ * Compute the name of the cache entry for the given archive, i.e.,
+ * <program name>-<digest>, where the program name is the base name of
+ * the given file. On Windows, the .exe suffix is stripped from the
+ * program name; the .pkg suffix of side-loaded archives is stripped on
+ * all platforms.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static int
+_pyi_cache_format_entry_name(struct ARCHIVE *archive, const char *filename, char *entry_name)
+{
+    const char *program_name;
+    size_t program_name_len;
+    uint64_t digest;
+
+    if (pyi_archive_compute_digest(archive, &digest) < 0) {
+        return -1;
+    }
+
+    program_name = strrchr(filename, PYI_SEP);
+    program_name = program_name ? program_name + 1 : filename;
+    program_name_len = strlen(program_name);
+
+#ifdef _WIN32
+    if (program_name_len > 4 && _stricmp(program_name + program_name_len - 4, ".exe") == 0) {
+        program_name_len -= 4;
+    }
+#endif
+    if (program_name_len > 4 && strcmp(program_name + program_name_len - 4, ".pkg") == 0) {
+        program_name_len -= 4;
+    }
+
+    if (snprintf(entry_name, PYI_PATH_MAX, "%.*s-%016llx", (int)program_name_len, program_name, (unsigned long long)digest) >= PYI_PATH_MAX) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Check if the given directory name belongs to a cache entry (or its
+ * staging directory) of the program with given name prefix (i.e.,
+ * executable name with trailing dash).
+ */
+static bool
+_pyi_cache_is_program_entry(const char *name, const char *prefix, size_t prefix_len)
+{
+    size_t i;
+
+    if (strncmp(name, prefix, prefix_len) != 0) {
+        return false;
+    }
+    name += prefix_len;
+
+    for (i = 0; i < _PYI_CACHE_DIGEST_LENGTH; i++) {
+        char c = name[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            return false;
+        }
+    }
+    name += _PYI_CACHE_DIGEST_LENGTH;
+
+    return name[0] == 0 || strncmp(name, _PYI_CACHE_STAGING_SUFFIX, strlen(_PYI_CACHE_STAGING_SUFFIX)) == 0;
+}
+
+
+#ifdef _WIN32
+
+/**********************************************************************\
+ *                    Platform-specific helpers (Windows)             *
+\**********************************************************************/
+/*
+ * Create the directory with security attributes from the context
+ * structure; it is not an error if the directory already exists.
+ */
+static int
+_pyi_cache_mkdir(const struct PYI_CONTEXT *pyi_ctx, const char *path)
+{
+    wchar_t path_w[PYI_PATH_MAX];
+
+    if (pyi_win32_utf8_to_wcs(path, path_w, PYI_PATH_MAX) == NULL) {
+        return -1;
+    }
+    if (CreateDirectoryW(path_w, pyi_ctx->security_attr) == 0 && GetLastError() != ERROR_ALREADY_EXISTS) {
+        PYI_WINERROR_W(L"CreateDirectoryW", L"Failed to create extraction cache directory!\n");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Resolve the cache root directory, and create it if necessary.
+ */
+static int
+_pyi_cache_get_root_directory(const struct PYI_CONTEXT *pyi_ctx, char *root_dir)
+{
+    char *local_app_data;
+
+    local_app_data = pyi_getenv("LOCALAPPDATA");
+    if (local_app_data == NULL || local_app_data[0] == 0) {
+        PYI_DEBUG("LOADER: cache: LOCALAPPDATA is not set!\n");
+        free(local_app_data);
+        return -1;
+    }
+    if (pyi_path_join(root_dir, local_app_data, "pyinstaller") == NULL) {
+        free(local_app_data);
+        return -1;
+    }
+    free(local_app_data);
+
+    return _pyi_cache_mkdir(pyi_ctx, root_dir);
+}
+
+/*
+ * Check if given path points to a valid cache entry directory (i.e.,
+ * a directory that is not a reparse point).
+ */
+static bool
+_pyi_cache_is_valid_entry(const char *path)
+{
+    wchar_t path_w[PYI_PATH_MAX];
+    DWORD attributes;
+
+    if (pyi_win32_utf8_to_wcs(path, path_w, PYI_PATH_MAX) == NULL) {
+        return false;
+    }
+
+    attributes = GetFileAttributesW(path_w);
+    if (attributes == INVALID_FILE_ATTRIBUTES) {
+        return false;
+    }
+
+    return (attributes & FILE_ATTRIBUTE_DIRECTORY) && !(attributes & FILE_ATTRIBUTE_REPARSE_POINT);
+}
+
+/*
+ * Update the modification time of the cache entry directory, which is
+ * used to determine its last use during eviction.
+ */
+static void
+_pyi_cache_touch(const char *path)
+{
+    wchar_t path_w[PYI_PATH_MAX];
+    HANDLE handle;
+    FILETIME now;
+
+    if (pyi_win32_utf8_to_wcs(path, path_w, PYI_PATH_MAX) == NULL) {
+        return;
+    }
+
+    handle = CreateFileW(path_w, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(handle, NULL, NULL, &now);
+    CloseHandle(handle);
+}
+
+/*
+ * Create staging directory for the given cache entry path.
+ */
+static int
+_pyi_cache_create_staging_directory(const struct PYI_CONTEXT *pyi_ctx, const char *entry_dir, char *staging_dir)
+{
+    wchar_t staging_dir_w[PYI_PATH_MAX];
+    int i;
+
+    /* Similarly to `pyi_create_temporary_application_directory`, try
+     * several times to avoid race conditions. */
+    for (i = 0; i < 5; i++) {
+        if (snprintf(staging_dir, PYI_PATH_MAX, "%s" _PYI_CACHE_STAGING_SUFFIX "%d-%d", entry_dir, _getpid(), i) >= PYI_PATH_MAX) {
+            return -1;
+        }
+        if (pyi_win32_utf8_to_wcs(staging_dir, staging_dir_w, PYI_PATH_MAX) == NULL) {
+            return -1;
+        }
+        if (CreateDirectoryW(staging_dir_w, pyi_ctx->security_attr) != 0) {
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Rename the staging directory into final cache entry directory. Fails
+ * if the target directory already exists.
+ */
+static int
+_pyi_cache_rename(const char *src, const char *dest)
+{
+    wchar_t src_w[PYI_PATH_MAX];
+    wchar_t dest_w[PYI_PATH_MAX];
+
+    if (pyi_win32_utf8_to_wcs(src, src_w, PYI_PATH_MAX) == NULL) {
+        return -1;
+    }
+    if (pyi_win32_utf8_to_wcs(dest, dest_w, PYI_PATH_MAX) == NULL) {
+        return -1;
+    }
+
+    return MoveFileExW(src_w, dest_w, 0) ? 0 : -1;
+}
+
+static int
+_pyi_cache_get_process_id(void)
+{
+    return _getpid();
+}
+
+static void
+_pyi_cache_remove_file(const char *path)
+{
+    wchar_t path_w[PYI_PATH_MAX];
+
+    if (pyi_win32_utf8_to_wcs(path, path_w, PYI_PATH_MAX) != NULL) {
+        _wremove(path_w);
+    }
+}
+
+/*
+ * Evict stale entries belonging to the same program from the cache
+ * root directory.
+ */
+static void
+_pyi_cache_evict_stale_entries(const char *root_dir, const char *current_entry, const char *prefix, size_t prefix_len)
+{
+    wchar_t pattern_w[PYI_PATH_MAX];
+    char pattern[PYI_PATH_MAX];
+    WIN32_FIND_DATAW find_data;
+    HANDLE handle;
+    ULARGE_INTEGER now;
+    ULARGE_INTEGER mtime;
+    FILETIME now_ft;
+
+    if (snprintf(pattern, PYI_PATH_MAX, "%s\\%s*", root_dir, prefix) >= PYI_PATH_MAX) {
+        return;
+    }
+    if (pyi_win32_utf8_to_wcs(pattern, pattern_w, PYI_PATH_MAX) == NULL) {
+        return;
+    }
+
+    GetSystemTimeAsFileTime(&now_ft);
+    now.LowPart = now_ft.dwLowDateTime;
+    now.HighPart = now_ft.dwHighDateTime;
+
+    handle = FindFirstFileW(pattern_w, &find_data);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    do {
+        char name[PYI_PATH_MAX];
+        char path[PYI_PATH_MAX];
+
+        if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            continue;
+        }
+        if (pyi_win32_wcs_to_utf8(find_data.cFileName, name, PYI_PATH_MAX) == NULL) {
+            continue;
+        }
+        if (strcmp(name, current_entry) == 0 || !_pyi_cache_is_program_entry(name, prefix, prefix_len)) {
+            continue;
+        }
+
+        /* FILETIME is in 100-nanosecond units */
+        mtime.LowPart = find_data.ftLastWriteTime.dwLowDateTime;
+        mtime.HighPart = find_data.ftLastWriteTime.dwHighDateTime;
+        if (now.QuadPart < mtime.QuadPart || (now.QuadPart - mtime.QuadPart) / 10000000ULL < PYI_CACHE_EVICTION_AGE) {
+            continue;
+        }
+
+        if (pyi_path_join(path, root_dir, name) == NULL) {
+            continue;
+        }
+        PYI_DEBUG("LOADER: cache: evicting stale entry: %s\n", path);
+        pyi_recursive_rmdir(path);
+    } while (FindNextFileW(handle, &find_data));
+
+    FindClose(handle);
+}
+
+#else /* ifdef _WIN32 */
+
+/**********************************************************************\
+ *                    Platform-specific helpers (POSIX)               *
+\**********************************************************************/
+/*
+ * Create the directory with permissions restricted to the user; it is
+ * not an error if the directory already exists.
+ */
+static int
+_pyi_cache_mkdir(const struct PYI_CONTEXT *pyi_ctx, const char *path)
+{
+    (void)pyi_ctx;
+
+    if (mkdir(path, 0700) < 0 && errno != EEXIST) {
+        PYI_PERROR("mkdir", "Failed to create extraction cache directory %s!\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Resolve the cache root directory, and create it if necessary.
+ */
+static int
+_pyi_cache_get_root_directory(const struct PYI_CONTEXT *pyi_ctx, char *root_dir)
+{
+    char base_dir[PYI_PATH_MAX];
+    char *env_var_value;
+    struct stat stat_buf;
+
+    /* Honor XDG_CACHE_HOME, if set to an absolute path. */
+    env_var_value = NULL;
+#if !defined(__APPLE__)
+    env_var_value = pyi_getenv("XDG_CACHE_HOME");
+    if (env_var_value && env_var_value[0] != PYI_SEP) {
+        free(env_var_value);
+        env_var_value = NULL;
+    }
+#endif
+
+    if (env_var_value) {
+        int ret = snprintf(base_dir, PYI_PATH_MAX, "%s", env_var_value);
+        free(env_var_value);
+        if (ret >= PYI_PATH_MAX) {
+            return -1;
+        }
+    } else {
+        env_var_value = pyi_getenv("HOME");
+        if (env_var_value == NULL || env_var_value[0] != PYI_SEP) {
+            PYI_DEBUG("LOADER: cache: HOME is not set!\n");
+            free(env_var_value);
+            return -1;
+        }
+#if defined(__APPLE__)
+        if (pyi_path_join(base_dir, env_var_value, "Library/Caches") == NULL) {
+#else
+        if (pyi_path_join(base_dir, env_var_value, ".cache") == NULL) {
+#endif
+            free(env_var_value);
+            return -1;
+        }
+        free(env_var_value);
+    }
+
+    if (_pyi_cache_mkdir(pyi_ctx, base_dir) < 0) {
+        return -1;
+    }
+    if (pyi_path_join(root_dir, base_dir, "pyinstaller") == NULL) {
+        return -1;
+    }
+    if (_pyi_cache_mkdir(pyi_ctx, root_dir) < 0) {
+        return -1;
+    }
+
+    /* Refuse to use cache root that is not a directory owned by us,
+     * or is writable by other users. */
+    if (lstat(root_dir, &stat_buf) < 0) {
+        return -1;
+    }
+    if (!S_ISDIR(stat_buf.st_mode) || stat_buf.st_uid != geteuid() || (stat_buf.st_mode & (S_IWGRP | S_IWOTH))) {
+        PYI_DEBUG("LOADER: cache: refusing to use insecure cache directory %s!\n", root_dir);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Check if given path points to a valid cache entry directory (i.e.,
+ * a directory (not a symbolic link) that is owned by us and is not
+ * accessible by other users).
+ */
+static bool
+_pyi_cache_is_valid_entry(const char *path)
+{
+    struct stat stat_buf;
+
+    if (lstat(path, &stat_buf) < 0) {
+        return false;
+    }
+
+    return S_ISDIR(stat_buf.st_mode) && stat_buf.st_uid == geteuid() && (stat_buf.st_mode & (S_IRWXG | S_IRWXO)) == 0;
+}
+
+/*
+ * Update the modification time of the cache entry directory, which is
+ * used to determine its last use during eviction.
+ */
+static void
+_pyi_cache_touch(const char *path)
+{
+    utimes(path, NULL); /* Ignore errors */
+}
+
+/*
+ * Create staging directory for the given cache entry path.
+ */
+static int
+_pyi_cache_create_staging_directory(const struct PYI_CONTEXT *pyi_ctx, const char *entry_dir, char *staging_dir)
+{
+    (void)pyi_ctx;
+
+    if (snprintf(staging_dir, PYI_PATH_MAX, "%s" _PYI_CACHE_STAGING_SUFFIX "XXXXXX", entry_dir) >= PYI_PATH_MAX) {
+        return -1;
+    }
+    if (mkdtemp(staging_dir) == NULL) {
+        PYI_PERROR("mkdtemp", "Failed to create extraction cache staging directory!\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Rename the staging directory into final cache entry directory. Fails
+ * if the target directory already exists and is not empty.
+ */
+static int
+_pyi_cache_rename(const char *src, const char *dest)
+{
+    return rename(src, dest);
+}
+
+static int
+_pyi_cache_get_process_id(void)
+{
+    return (int)getpid();
+}
+
+static void
+_pyi_cache_remove_file(const char *path)
+{
+    unlink(path); /* Ignore errors */
+}
+
+/*
+ * Evict stale entries belonging to the same program from the cache
+ * root directory.
+ */
+static void
+_pyi_cache_evict_stale_entries(const char *root_dir, const char *current_entry, const char *prefix, size_t prefix_len)
+{
+    DIR *dir;
+    struct dirent *entry;
+    time_t now = time(NULL);
+
+    dir = opendir(root_dir);
+    if (dir == NULL) {
+        return;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        char path[PYI_PATH_MAX];
+        struct stat stat_buf;
+
+        if (strcmp(entry->d_name, current_entry) == 0 || !_pyi_cache_is_program_entry(entry->d_name, prefix, prefix_len)) {
+            continue;
+        }
+        if (pyi_path_join(path, root_dir, entry->d_name) == NULL) {
+            continue;
+        }
+        if (lstat(path, &stat_buf) < 0 || !S_ISDIR(stat_buf.st_mode)) {
+            continue;
+        }
+        if (now - stat_buf.st_mtime < PYI_CACHE_EVICTION_AGE) {
+            continue;
+        }
+
+        PYI_DEBUG("LOADER: cache: evicting stale entry: %s\n", path);
+        pyi_recursive_rmdir(path);
+    }
+
+    closedir(dir);
+}
+
+#endif /* ifdef _WIN32 */
+
+
+/**********************************************************************\
+ *                           Cache eviction                           *
+\**********************************************************************/
+/*
+ * Evict stale entries of the current program, based on the path to
+ * the current cache entry stored in the context structure.
+ */
+static void
+_pyi_cache_evict(const struct PYI_CONTEXT *pyi_ctx)
+{
+    char root_dir[PYI_PATH_MAX];
+    char prefix[PYI_PATH_MAX];
+    const char *current_entry;
+    size_t prefix_len;
+
+    current_entry = strrchr(pyi_ctx->extraction_cache_dir, PYI_SEP);
+    if (current_entry == NULL) {
+        return;
+    }
+    current_entry++;
+
+    /* Program prefix is the entry name without the digest. */
+    prefix_len = strlen(current_entry) - _PYI_CACHE_DIGEST_LENGTH;
+    snprintf(prefix, PYI_PATH_MAX, "%.*s", (int)prefix_len, current_entry);
+
+    if (!pyi_path_dirname(root_dir, pyi_ctx->extraction_cache_dir)) {
+        return;
+    }
+
+    _pyi_cache_evict_stale_entries(root_dir, current_entry, prefix, prefix_len);
+}
+
+
+/**********************************************************************\
+ *                       Cache entry validation                       *
+\**********************************************************************/
+/*
+ * State of the validation of a cache entry's files; the extractable
+ * entries are claimed one by one by the validating threads (including
+ * the calling thread) via the shared `next_entry` counter.
+ */
+struct _PYI_CACHE_VALIDATION
+{
+    const struct ARCHIVE *archive;
+    const char *entry_dir;
+
+    const struct TOC_ENTRY *const *toc_entries;
+    size_t num_entries;
+
+#if PYI_HAVE_THREADS
+    /* Mutex protecting the fields below */
+    pyi_mutex_t mutex;
+#endif
+
+    size_t next_entry;
+    bool failed;
+};
+
+/*
+ * Validate the file of the given entry within the cache entry
+ * directory. Returns 0 if the file is intact, -1 otherwise.
+ */
+static int
+_pyi_cache_validate_file(const struct _PYI_CACHE_VALIDATION *validation, const struct TOC_ENTRY *toc_entry)
+{
+    char filename[PYI_PATH_MAX];
+
+    switch (toc_entry->typecode) {
+        case ARCHIVE_ITEM_BINARY:
+        case ARCHIVE_ITEM_DATA:
+        case ARCHIVE_ITEM_LAZY_DATA:
+        case ARCHIVE_ITEM_ZIPFILE:
+        case ARCHIVE_ITEM_ALIAS:
+            break;
+        default:
+            /* Symbolic links and dependencies (whose data comes from
+             * other archives) are not validated. */
+            return 0;
+    }
+
+    if (snprintf(filename, PYI_PATH_MAX, "%s%c%s", validation->entry_dir, PYI_SEP, pyi_archive_get_entry_name(toc_entry)) >= PYI_PATH_MAX) {
+        return -1;
+    }
+
+    /* Lazily-extracted files are present only if they were accessed
+     * by a previous run of the application. */
+    if (toc_entry->typecode == ARCHIVE_ITEM_LAZY_DATA && pyi_path_exists(filename) != 1) {
+        return 0;
+    }
+
+    if (pyi_archive_verify_file(validation->archive, toc_entry, filename) < 0) {
+        PYI_DEBUG("LOADER: cache: file %s is missing or damaged!\n", filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Claim and validate the entries until all are processed, or until
+ * one of them fails validation.
+ */
+static void
+_pyi_cache_validate_entries(struct _PYI_CACHE_VALIDATION *validation)
+{
+    size_t index;
+    bool failed;
+
+    for (;;) {
+#if PYI_HAVE_THREADS
+        pyi_mutex_lock(&validation->mutex);
+#endif
+        index = validation->next_entry++;
+        failed = validation->failed;
+#if PYI_HAVE_THREADS
+        pyi_mutex_unlock(&validation->mutex);
+#endif
+        if (failed || index >= validation->num_entries) {
+            return;
+        }
+
+        if (_pyi_cache_validate_file(validation, validation->toc_entries[index]) < 0) {
+#if PYI_HAVE_THREADS
+            pyi_mutex_lock(&validation->mutex);
+#endif
+            validation->failed = true;
+#if PYI_HAVE_THREADS
+            pyi_mutex_unlock(&validation->mutex);
+#endif
+            return;
+        }
+    }
+}
+
+#if PYI_HAVE_THREADS
+static PYI_THREAD_PROC_TYPE
+_pyi_cache_validation_worker(void *arg)
+{
+    _pyi_cache_validate_entries((struct _PYI_CACHE_VALIDATION *)arg);
+    PYI_THREAD_PROC_RETURN;
+}
+#endif
+
+/*
+ * Validate the files of the given cache entry directory against the
+ * checksums from the archive, using up to `extraction_threads` threads.
+ * Returns 0 if all files are intact, -1 otherwise.
+ */
+static int
+_pyi_cache_validate_entry(const struct PYI_CONTEXT *pyi_ctx, const char *entry_dir)
+{
+    struct _PYI_CACHE_VALIDATION validation;
+#if PYI_HAVE_THREADS
+    pyi_thread_t threads[PYI_LAUNCH_MAX_EXTRACTION_THREADS];
+    int num_threads = 0;
+    int i;
+#endif
+
+    memset(&validation, 0, sizeof(validation));
+    validation.archive = pyi_ctx->archive;
+    validation.entry_dir = entry_dir;
+    validation.toc_entries = pyi_archive_get_toc_group(pyi_ctx->archive, ARCHIVE_TOC_GROUP_EXTRACTABLE, &validation.num_entries);
+
+#if PYI_HAVE_THREADS
+    if (pyi_mutex_init(&validation.mutex) < 0) {
+        return -1;
+    }
+
+    /* The calling thread validates the entries as well; if we fail
+     * to start a thread, continue with the ones that we already have. */
+    while (num_threads < pyi_ctx->extraction_threads - 1 && (size_t)num_threads + 1 < validation.num_entries) {
+        if (pyi_thread_create(&threads[num_threads], _pyi_cache_validation_worker, &validation) < 0) {
+            break;
+        }
+        num_threads++;
+    }
+#endif
+
+    _pyi_cache_validate_entries(&validation);
+
+#if PYI_HAVE_THREADS
+    for (i = 0; i < num_threads; i++) {
+        pyi_thread_join(threads[i]);
+    }
+    pyi_mutex_destroy(&validation.mutex);
+#endif
+
+    return validation.failed ? -1 : 0;
+}
+
+/*
+ * Remove the damaged cache entry directory. The directory is first
+ * renamed aside (under a staging-like name, so that it is evicted
+ * eventually if its removal fails), so that the removal does not race
+ * with other instances that might re-populate the cache entry.
+ */
+static int
+_pyi_cache_discard_entry(const char *entry_dir)
+{
+    char discarded_dir[PYI_PATH_MAX];
+
+    if (snprintf(discarded_dir, PYI_PATH_MAX, "%s" _PYI_CACHE_STAGING_SUFFIX "damaged-%d", entry_dir, _pyi_cache_get_process_id()) >= PYI_PATH_MAX) {
+        return -1;
+    }
+    if (_pyi_cache_rename(entry_dir, discarded_dir) < 0) {
+        PYI_DEBUG("LOADER: cache: failed to rename damaged entry %s!\n", entry_dir);
+        return -1;
+    }
+    pyi_recursive_rmdir(discarded_dir);
+
+    return 0;
+}
+
+
+/**********************************************************************\
+ *                          Public interface                          *
+\**********************************************************************/
+/*
+ * Resolve the application's cache entry directory. If it exists, use
+ * it as application's top-level directory (cache hit); otherwise,
+ * create a staging directory and use it as application's top-level
+ * directory (cache miss). The resulting state is stored in
+ * `pyi_ctx->extraction_cache_state`, path to cache entry directory in
+ * `pyi_ctx->extraction_cache_dir`, and path to top-level directory in
+ * `pyi_ctx->application_home_dir`.
+ *
+ * Returns 0 on success, -1 on error; in the latter case, the caller
+ * should fall back to using an ephemeral temporary directory.
+ */
+int
+pyi_cache_create_application_directory(struct PYI_CONTEXT *pyi_ctx)
+{
+    char root_dir[PYI_PATH_MAX];
+    char entry_name[PYI_PATH_MAX];
+
+    pyi_ctx->extraction_cache_state = PYI_EXTRACTION_CACHE_NONE;
+
+    if (_pyi_cache_get_root_directory(pyi_ctx, root_dir) < 0) {
+        return -1;
+    }
+    if (_pyi_cache_format_entry_name(pyi_ctx->archive, pyi_ctx->executable_filename, entry_name) < 0) {
+        return -1;
+    }
+    if (pyi_path_join(pyi_ctx->extraction_cache_dir, root_dir, entry_name) == NULL) {
+        return -1;
+    }
+
+    /* If checksums are enabled, validate the existing entry, and remove
+     * it if it is damaged. */
+    if (pyi_ctx->verify_checksums && _pyi_cache_is_valid_entry(pyi_ctx->extraction_cache_dir) && _pyi_cache_validate_entry(pyi_ctx, pyi_ctx->extraction_cache_dir) < 0) {
+        PYI_WARNING("LOADER: cached application directory %s is damaged; extracting the application anew.\n", pyi_ctx->extraction_cache_dir);
+        if (_pyi_cache_discard_entry(pyi_ctx->extraction_cache_dir) < 0) {
+            return -1;
+        }
+    }
+
+    if (_pyi_cache_is_valid_entry(pyi_ctx->extraction_cache_dir)) {
+        PYI_DEBUG("LOADER: cache: using cached application directory: %s\n", pyi_ctx->extraction_cache_dir);
+        snprintf(pyi_ctx->application_home_dir, PYI_PATH_MAX, "%s", pyi_ctx->extraction_cache_dir);
+        pyi_ctx->extraction_cache_state = PYI_EXTRACTION_CACHE_HIT;
+
+        _pyi_cache_touch(pyi_ctx->extraction_cache_dir);
+        _pyi_cache_evict(pyi_ctx);
+
+        return 0;
+    }
+
+    if (_pyi_cache_create_staging_directory(pyi_ctx, pyi_ctx->extraction_cache_dir, pyi_ctx->application_home_dir) < 0) {
+        return -1;
+    }
+
+    PYI_DEBUG("LOADER: cache: created staging directory: %s\n", pyi_ctx->application_home_dir);
+    pyi_ctx->extraction_cache_state = PYI_EXTRACTION_CACHE_MISS;
+
+    return 0;
+}
+
+/*
+ * Promote the fully-populated staging directory into the cache entry
+ * directory. Called by onefile parent process once the extraction is
+ * complete, or, if that was not possible, after the child process exits.
+ * On success, the cache entry directory becomes the application's
+ * top-level directory (`pyi_ctx->application_home_dir`), and the state
+ * is changed to cache hit.
+ *
+ * Returns 0 on success, -1 on error; in the latter case, the staging
+ * directory remains the application's top-level directory, and the
+ * caller should eventually remove it.
+ */
+int
+pyi_cache_commit_application_directory(struct PYI_CONTEXT *pyi_ctx)
+{
+    if (_pyi_cache_rename(pyi_ctx->application_home_dir, pyi_ctx->extraction_cache_dir) < 0) {
+        PYI_DEBUG("LOADER: cache: failed to rename %s to %s!\n", pyi_ctx->application_home_dir, pyi_ctx->extraction_cache_dir);
+        return -1;
+    }
+
+    PYI_DEBUG("LOADER: cache: stored application directory: %s\n", pyi_ctx->extraction_cache_dir);
+    snprintf(pyi_ctx->application_home_dir, PYI_PATH_MAX, "%s", pyi_ctx->extraction_cache_dir);
+    pyi_ctx->extraction_cache_state = PYI_EXTRACTION_CACHE_HIT;
+    _pyi_cache_evict(pyi_ctx);
+
+    return 0;
+}
+
+/*
+ * Materialize the given dependency entry from the referenced archive of
+ * a multi-package build in the shared dependency store, and clone it
+ * (hard link, reflink, or copy, whichever is available) into the given
+ * output filename. The dependency is stored as
+ *
+ *   <cache root>/shared/<program name>-<digest>/<entry name>
+ *
+ * where program name and digest belong to the referenced archive. If
+ * the dependency is already present in the store, it is not extracted
+ * again. The dependency is extracted into a temporary file next to its
+ * final location, and renamed into it, so a partially-written file is
+ * never visible to other programs that use the store.
+ *
+ * Returns 0 on success, -1 on error; in the latter case, the caller
+ * should extract the dependency directly into the output filename.
+ */
+int
+pyi_cache_extract_shared_dependency(
+    struct PYI_CONTEXT *pyi_ctx,
+    struct ARCHIVE_SESSION *session,
+    struct ARCHIVE *archive,
+    const struct TOC_ENTRY *toc_entry,
+    const char *output_filename
+)
+{
+    char root_dir[PYI_PATH_MAX];
+    char store_dir[PYI_PATH_MAX];
+    char entry_name[PYI_PATH_MAX];
+    char entry_dir[PYI_PATH_MAX];
+    char store_filename[PYI_PATH_MAX];
+    char temp_filename[PYI_PATH_MAX];
+    const char *dependency_name = pyi_archive_get_entry_name(toc_entry);
+
+    if (_pyi_cache_get_root_directory(pyi_ctx, root_dir) < 0) {
+        return -1;
+    }
+    if (pyi_path_join(store_dir, root_dir, PYI_CACHE_SHARED_STORE_NAME) == NULL) {
+        return -1;
+    }
+    if (_pyi_cache_mkdir(pyi_ctx, store_dir) < 0) {
+        return -1;
+    }
+    if (_pyi_cache_format_entry_name(archive, archive->filename, entry_name) < 0) {
+        return -1;
+    }
+    if (pyi_path_join(entry_dir, store_dir, entry_name) == NULL) {
+        return -1;
+    }
+
+    /* Create the store entry for this version of the referenced archive;
+     * when a new version appears, evict the stale entries of the previous
+     * versions. */
+    if (!_pyi_cache_is_valid_entry(entry_dir)) {
+        size_t prefix_len = strlen(entry_name) - _PYI_CACHE_DIGEST_LENGTH;
+        char prefix[PYI_PATH_MAX];
+
+        if (_pyi_cache_mkdir(pyi_ctx, entry_dir) < 0 || !_pyi_cache_is_valid_entry(entry_dir)) {
+            return -1;
+        }
+        PYI_DEBUG("LOADER: cache: created shared dependency store entry: %s\n", entry_dir);
+
+        snprintf(prefix, PYI_PATH_MAX, "%.*s", (int)prefix_len, entry_name);
+        _pyi_cache_evict_stale_entries(store_dir, entry_name, prefix, prefix_len);
+    } else {
+        _pyi_cache_touch(entry_dir);
+    }
+
+    if (pyi_path_join(store_filename, entry_dir, dependency_name) == NULL) {
+        return -1;
+    }
+
+    if (pyi_path_exists(store_filename) != true) {
+        if (pyi_create_parent_directory_tree(pyi_ctx, NULL, entry_dir, dependency_name) < 0) {
+            return -1;
+        }
+        if (snprintf(temp_filename, PYI_PATH_MAX, "%s.tmp-%d", store_filename, _pyi_cache_get_process_id()) >= PYI_PATH_MAX) {
+            return -1;
+        }
+        if (pyi_archive_session_extract2fs(session, archive, toc_entry, temp_filename) < 0) {
+            _pyi_cache_remove_file(temp_filename);
+            return -1;
+        }
+        /* If renaming fails, another program might have stored the same
+         * dependency in the meantime; use that one, if available. */
+        if (_pyi_cache_rename(temp_filename, store_filename) < 0) {
+            _pyi_cache_remove_file(temp_filename);
+            if (pyi_path_exists(store_filename) != true) {
+                return -1;
+            }
+        }
+        PYI_DEBUG("LOADER: cache: stored shared dependency: %s\n", store_filename);
+    }
+
+    if (pyi_clone_file(store_filename, output_filename) < 0) {
+        PYI_DEBUG("LOADER: cache: failed to clone shared dependency %s into %s!\n", store_filename, output_filename);
+        return -1;
+    }
+    pyi_stats_add(&pyi_ctx->stats.files_created, 1);
+
+    PYI_DEBUG("LOADER: cache: using shared dependency: %s\n", store_filename);
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Persistent extraction cache for onefile applications.
+ */
+
+#ifndef PYI_CACHE_H
+#define PYI_CACHE_H
+
+#include "pyi_global.h"
+
+struct PYI_CONTEXT;
+struct ARCHIVE;
+struct ARCHIVE_SESSION;
+struct TOC_ENTRY;
+
+/* Cache entries (and left-over staging directories) belonging to the
+ * same application that have not been used for this long (in seconds)
+ * are evicted from the cache. */
+#define PYI_CACHE_EVICTION_AGE (7 * 24 * 60 * 60)
+
+/* Name of the sub-directory of the cache root that holds the shared
+ * dependency store of multi-package builds. */
+#define PYI_CACHE_SHARED_STORE_NAME "shared"
+
+int pyi_cache_create_application_directory(struct PYI_CONTEXT *pyi_ctx);
+int pyi_cache_commit_application_directory(struct PYI_CONTEXT *pyi_ctx);
+
+int pyi_cache_extract_shared_dependency(
+    struct PYI_CONTEXT *pyi_ctx,
+    struct ARCHIVE_SESSION *session,
+    struct ARCHIVE *archive,
+    const struct TOC_ENTRY *toc_entry,
+    const char *output_filename
+);
+
+#endif /* PYI_CACHE_H */
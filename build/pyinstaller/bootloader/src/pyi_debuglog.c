@@ -0,0 +1,1092 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Buffered debug log.
+ *
+ * Recording a message does not format it; the format string is parsed
+ * only to fetch the arguments from the va_list, and the arguments are
+ * stored in a fixed-size binary record, together with a pointer to the
+ * format string (which is a string literal), a timestamp, and a global
+ * sequence number. String arguments are copied into the record, as they
+ * might not outlive the call. The messages are formatted only when the
+ * records are flushed, by replaying the format string with the stored
+ * arguments.
+ *
+ * Each thread records into its own ring buffer, which is allocated on
+ * the thread's first message, and is registered in a lock-free list;
+ * recording therefore needs neither locks nor system calls. The ring
+ * buffers are never released, as the records of threads that have
+ * already finished need to be flushed as well. The flush merges the
+ * records of all threads in the order of their sequence numbers. It
+ * can run while other threads are still recording (for example, in
+ * the atexit handler or before an error message); records that were
+ * overwritten by their owner while being read are discarded.
+ */
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <process.h> /* _getpid */
+#else
+    #include <unistd.h> /* getpid, write */
+    #include <signal.h> /* sigaction, raise */
+#endif
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h> /* calloc, free, atexit */
+#include <string.h>
+#include <stddef.h> /* ptrdiff_t */
+#include <wchar.h>
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_debuglog.h"
+#include "pyi_thread.h"
+#include "pyi_trace.h"
+#include "pyi_utils.h"
+
+
+#if defined(LAUNCH_DEBUG)
+
+/* Thread-local storage class specifier */
+#if defined(_MSC_VER)
+    #define _PYI_DEBUGLOG_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+    #define _PYI_DEBUGLOG_THREAD_LOCAL __thread
+#endif
+
+/* Maximal length of formatted message */
+#define _PYI_DEBUGLOG_MESSAGE_LEN 4096
+
+/* Maximal length of the flags, field width, and precision of a
+ * conversion specification */
+#define _PYI_DEBUGLOG_SPEC_LEN 32
+
+/* Special values of string arguments' offsets */
+#define _PYI_DEBUGLOG_STRING_NULL ((unsigned long long)-1)
+#define _PYI_DEBUGLOG_STRING_TRUNCATED ((unsigned long long)-2)
+
+
+/* Captured argument */
+union _PYI_DEBUGLOG_ARG
+{
+    long long i; /* signed integers, characters, field widths and precisions */
+    unsigned long long u; /* unsigned integers; offsets of strings within the record */
+    double d;
+    const void *p;
+};
+
+struct _PYI_DEBUGLOG_RECORD_HEADER
+{
+    uint64_t sequence;
+    uint64_t timestamp; /* microseconds */
+    const char *fmt;
+    unsigned int num_args;
+    union _PYI_DEBUGLOG_ARG args[PYI_DEBUGLOG_MAX_ARGS];
+};
+
+/* Record in the ring buffer */
+struct _PYI_DEBUGLOG_RECORD
+{
+    struct _PYI_DEBUGLOG_RECORD_HEADER header;
+    char strings[PYI_DEBUGLOG_RECORD_SIZE - sizeof(struct _PYI_DEBUGLOG_RECORD_HEADER)]; /* copies of string arguments */
+};
+
+/* Per-thread ring buffer */
+struct _PYI_DEBUGLOG_RING
+{
+    struct _PYI_DEBUGLOG_RING *next;
+    unsigned int index; /* ordinal number of the thread, in order of the first message */
+    uint64_t head; /* number of recorded messages; written only by the owner thread */
+    uint64_t tail; /* number of flushed (or lost) messages; accessed only by the flush */
+    struct _PYI_DEBUGLOG_RECORD records[PYI_DEBUGLOG_RING_CAPACITY];
+
+    /* Copy of the oldest unflushed record, if `has_front` is set; used
+     * only by the flush, which runs from crash handlers, and therefore
+     * must not allocate memory. */
+    struct _PYI_DEBUGLOG_RECORD front;
+    bool has_front;
+};
+
+/* Type of conversion */
+enum _PYI_DEBUGLOG_TYPE
+{
+    _PYI_DEBUGLOG_TYPE_SIGNED,
+    _PYI_DEBUGLOG_TYPE_UNSIGNED,
+    _PYI_DEBUGLOG_TYPE_CHAR,
+    _PYI_DEBUGLOG_TYPE_DOUBLE,
+    _PYI_DEBUGLOG_TYPE_STRING,
+    _PYI_DEBUGLOG_TYPE_WSTRING,
+    _PYI_DEBUGLOG_TYPE_POINTER
+};
+
+/* Length modifier */
+enum _PYI_DEBUGLOG_LENGTH
+{
+    _PYI_DEBUGLOG_LENGTH_NONE,
+    _PYI_DEBUGLOG_LENGTH_HH,
+    _PYI_DEBUGLOG_LENGTH_H,
+    _PYI_DEBUGLOG_LENGTH_L,
+    _PYI_DEBUGLOG_LENGTH_LL,
+    _PYI_DEBUGLOG_LENGTH_J,
+    _PYI_DEBUGLOG_LENGTH_Z,
+    _PYI_DEBUGLOG_LENGTH_T,
+    _PYI_DEBUGLOG_LENGTH_LONG_DOUBLE,
+    _PYI_DEBUGLOG_LENGTH_I64, /* MSVC extensions */
+    _PYI_DEBUGLOG_LENGTH_I32,
+    _PYI_DEBUGLOG_LENGTH_I
+};
+
+/* Parsed conversion specification */
+struct _PYI_DEBUGLOG_SPEC
+{
+    const char *flags; /* flags, field width and precision... */
+    const char *flags_end; /* ...up to the length modifier */
+    const char *end; /* past the conversion character */
+    int width_star;
+    int precision_star;
+    int precision; /* literal precision; -1 if not given */
+    enum _PYI_DEBUGLOG_LENGTH length;
+    enum _PYI_DEBUGLOG_TYPE type;
+    char conversion;
+};
+
+
+static bool _pyi_debuglog_enabled = false;
+
+static struct _PYI_DEBUGLOG_RING *_pyi_debuglog_rings = NULL;
+static unsigned int _pyi_debuglog_num_rings = 0;
+static uint64_t _pyi_debuglog_sequence = 0;
+static unsigned int _pyi_debuglog_flushing = 0;
+
+#if defined(_PYI_DEBUGLOG_THREAD_LOCAL)
+static _PYI_DEBUGLOG_THREAD_LOCAL struct _PYI_DEBUGLOG_RING *_pyi_debuglog_thread_ring = NULL;
+static _PYI_DEBUGLOG_THREAD_LOCAL bool _pyi_debuglog_thread_unbuffered = false;
+#endif
+
+
+/*
+ * Atomic operations. The ring's head is published with release
+ * ordering after the record is written, and is read with acquire
+ * ordering by the flush.
+ */
+static uint64_t
+_pyi_debuglog_atomic_load(uint64_t *value)
+{
+#if defined(_WIN32)
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64 *)value, 0, 0);
+#elif defined(__GNUC__) || defined(__clang__)
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#else
+    return *(volatile uint64_t *)value;
+#endif
+}
+
+static void
+_pyi_debuglog_atomic_store(uint64_t *value, uint64_t new_value)
+{
+#if defined(_WIN32)
+    InterlockedExchange64((volatile LONG64 *)value, (LONG64)new_value);
+#elif defined(__GNUC__) || defined(__clang__)
+    __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+#else
+    *(volatile uint64_t *)value = new_value;
+#endif
+}
+
+static uint64_t
+_pyi_debuglog_atomic_increment(uint64_t *value)
+{
+#if defined(_WIN32)
+    return (uint64_t)InterlockedExchangeAdd64((volatile LONG64 *)value, 1);
+#elif defined(__GNUC__) || defined(__clang__)
+    return __atomic_fetch_add(value, 1, __ATOMIC_RELAXED);
+#else
+    return (*value)++;
+#endif
+}
+
+static unsigned int
+_pyi_debuglog_atomic_increment_uint(unsigned int *value)
+{
+#if defined(_WIN32)
+    return (unsigned int)InterlockedExchangeAdd((volatile LONG *)value, 1);
+#elif defined(__GNUC__) || defined(__clang__)
+    return __atomic_fetch_add(value, 1, __ATOMIC_RELAXED);
+#else
+    return (*value)++;
+#endif
+}
+
+/* Set the value to 1, if it is 0; returns true on success. */
+static bool
+_pyi_debuglog_atomic_acquire_flag(unsigned int *value)
+{
+#if defined(_WIN32)
+    return InterlockedCompareExchange((volatile LONG *)value, 1, 0) == 0;
+#elif defined(__GNUC__) || defined(__clang__)
+    unsigned int expected = 0;
+    return __atomic_compare_exchange_n(value, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+#else
+    if (*value) {
+        return false;
+    }
+    *value = 1;
+    return true;
+#endif
+}
+
+static void
+_pyi_debuglog_atomic_release_flag(unsigned int *value)
+{
+#if defined(_WIN32)
+    InterlockedExchange((volatile LONG *)value, 0);
+#elif defined(__GNUC__) || defined(__clang__)
+    __atomic_store_n(value, 0, __ATOMIC_RELEASE);
+#else
+    *value = 0;
+#endif
+}
+
+/* Push the ring onto the list of rings. */
+static void
+_pyi_debuglog_atomic_push_ring(struct _PYI_DEBUGLOG_RING *ring)
+{
+#if defined(_WIN32)
+    do {
+        ring->next = (struct _PYI_DEBUGLOG_RING *)InterlockedCompareExchangePointer((PVOID volatile *)&_pyi_debuglog_rings, NULL, NULL);
+    } while (InterlockedCompareExchangePointer((PVOID volatile *)&_pyi_debuglog_rings, ring, ring->next) != ring->next);
+#elif defined(__GNUC__) || defined(__clang__)
+    ring->next = __atomic_load_n(&_pyi_debuglog_rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&_pyi_debuglog_rings, &ring->next, ring, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+#else
+    ring->next = _pyi_debuglog_rings;
+    _pyi_debuglog_rings = ring;
+#endif
+}
+
+static struct _PYI_DEBUGLOG_RING *
+_pyi_debuglog_atomic_load_rings(void)
+{
+#if defined(_WIN32)
+    return (struct _PYI_DEBUGLOG_RING *)InterlockedCompareExchangePointer((PVOID volatile *)&_pyi_debuglog_rings, NULL, NULL);
+#elif defined(__GNUC__) || defined(__clang__)
+    return __atomic_load_n(&_pyi_debuglog_rings, __ATOMIC_ACQUIRE);
+#else
+    return _pyi_debuglog_rings;
+#endif
+}
+
+
+/*
+ * Parse the conversion specification that starts at `p` (which points
+ * at the `%` character of a conversion other than `%%`). Returns 0 on
+ * success, and -1 if the conversion is not supported.
+ */
+static int
+_pyi_debuglog_parse_spec(const char *p, struct _PYI_DEBUGLOG_SPEC *spec)
+{
+    memset(spec, 0, sizeof(struct _PYI_DEBUGLOG_SPEC));
+    spec->precision = -1;
+
+    p++;
+    spec->flags = p;
+
+    /* Flags */
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+        p++;
+    }
+    /* Field width */
+    if (*p == '*') {
+        spec->width_star = 1;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    /* Precision */
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->precision_star = 1;
+            p++;
+        } else {
+            spec->precision = 0;
+            while (*p >= '0' && *p <= '9') {
+                spec->precision = spec->precision * 10 + (*p - '0');
+                p++;
+            }
+        }
+    }
+    spec->flags_end = p;
+    if (spec->flags_end - spec->flags > _PYI_DEBUGLOG_SPEC_LEN) {
+        return -1;
+    }
+
+    /* Length modifier */
+    switch (*p) {
+        case 'h': {
+            p++;
+            spec->length = _PYI_DEBUGLOG_LENGTH_H;
+            if (*p == 'h') {
+                p++;
+                spec->length = _PYI_DEBUGLOG_LENGTH_HH;
+            }
+            break;
+        }
+        case 'l': {
+            p++;
+            spec->length = _PYI_DEBUGLOG_LENGTH_L;
+            if (*p == 'l') {
+                p++;
+                spec->length = _PYI_DEBUGLOG_LENGTH_LL;
+            }
+            break;
+        }
+        case 'q': {
+            p++;
+            spec->length = _PYI_DEBUGLOG_LENGTH_LL;
+            break;
+        }
+        case 'j': {
+            p++;
+            spec->length = _PYI_DEBUGLOG_LENGTH_J;
+            break;
+        }
+        case 'z': {
+            p++;
+            spec->length = _PYI_DEBUGLOG_LENGTH_Z;
+            break;
+        }
+        case 't': {
+            p++;
+            spec->length = _PYI_DEBUGLOG_LENGTH_T;
+            break;
+        }
+        case 'L': {
+            p++;
+            spec->length = _PYI_DEBUGLOG_LENGTH_LONG_DOUBLE;
+            break;
+        }
+        case 'I': {
+            p++;
+            if (p[0] == '6' && p[1] == '4') {
+                p += 2;
+                spec->length = _PYI_DEBUGLOG_LENGTH_I64;
+            } else if (p[0] == '3' && p[1] == '2') {
+                p += 2;
+                spec->length = _PYI_DEBUGLOG_LENGTH_I32;
+            } else {
+                spec->length = _PYI_DEBUGLOG_LENGTH_I;
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    /* Conversion */
+    spec->conversion = *p;
+    switch (*p) {
+        case 'd':
+        case 'i': {
+            spec->type = _PYI_DEBUGLOG_TYPE_SIGNED;
+            break;
+        }
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X': {
+            spec->type = _PYI_DEBUGLOG_TYPE_UNSIGNED;
+            break;
+        }
+        case 'c': {
+            if (spec->length != _PYI_DEBUGLOG_LENGTH_NONE) {
+                return -1; /* wide character */
+            }
+            spec->type = _PYI_DEBUGLOG_TYPE_CHAR;
+            break;
+        }
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A': {
+            spec->type = _PYI_DEBUGLOG_TYPE_DOUBLE;
+            break;
+        }
+        case 's': {
+            spec->type = (spec->length == _PYI_DEBUGLOG_LENGTH_L) ? _PYI_DEBUGLOG_TYPE_WSTRING : _PYI_DEBUGLOG_TYPE_STRING;
+            break;
+        }
+        case 'S': {
+            spec->type = _PYI_DEBUGLOG_TYPE_WSTRING;
+            break;
+        }
+        case 'p': {
+            spec->type = _PYI_DEBUGLOG_TYPE_POINTER;
+            break;
+        }
+        default: {
+            return -1; /* %n, or unknown conversion */
+        }
+    }
+    spec->end = p + 1;
+
+    return 0;
+}
+
+/*
+ * Copy the string argument into the record's string storage; if it
+ * does not fit, it is truncated, and ends with an ellipsis. Returns the
+ * offset of the copy within the storage (or one of the special values).
+ */
+static unsigned long long
+_pyi_debuglog_copy_string(struct _PYI_DEBUGLOG_RECORD *record, size_t *strings_length, const char *str, int precision)
+{
+    char *dest = record->strings + *strings_length;
+    size_t available = sizeof(record->strings) - *strings_length;
+    size_t offset = *strings_length;
+    size_t i = 0;
+
+    if (str == NULL) {
+        return _PYI_DEBUGLOG_STRING_NULL;
+    }
+    if (available < 4) {
+        return _PYI_DEBUGLOG_STRING_TRUNCATED;
+    }
+
+    while (str[i] && (precision < 0 || i < (size_t)precision)) {
+        if (i == available - 1) {
+            memcpy(dest + available - 4, "...", 4);
+            *strings_length += available;
+            return offset;
+        }
+        dest[i] = str[i];
+        i++;
+    }
+    dest[i] = 0;
+    *strings_length += i + 1;
+
+    return offset;
+}
+
+/*
+ * Convert the wide-char string argument into the record's string
+ * storage, in the same way as the conversion would. Returns the offset
+ * of the copy within the storage (or one of the special values), or -1
+ * if the string could not be converted.
+ */
+static int
+_pyi_debuglog_copy_wstring(struct _PYI_DEBUGLOG_RECORD *record, size_t *strings_length, const wchar_t *str, int precision, unsigned long long *offset)
+{
+    char *dest = record->strings + *strings_length;
+    size_t available = sizeof(record->strings) - *strings_length;
+    int ret;
+
+    if (str == NULL) {
+        *offset = _PYI_DEBUGLOG_STRING_NULL;
+        return 0;
+    }
+    if (available < 4) {
+        *offset = _PYI_DEBUGLOG_STRING_TRUNCATED;
+        return 0;
+    }
+
+    if (precision < 0) {
+        ret = snprintf(dest, available, "%ls", str);
+    } else {
+        ret = snprintf(dest, available, "%.*ls", precision, str);
+    }
+    if (ret < 0) {
+        return -1;
+    }
+
+    *offset = *strings_length;
+    if ((size_t)ret >= available) {
+        memcpy(dest + available - 4, "...", 4);
+        *strings_length += available;
+    } else {
+        *strings_length += (size_t)ret + 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Fetch the arguments from the va_list, according to the format string.
+ * Returns 0 on success, and -1 if the message cannot be recorded (has
+ * too many arguments, or unsupported conversions).
+ */
+static int
+_pyi_debuglog_capture(struct _PYI_DEBUGLOG_RECORD *record, const char *fmt, va_list args)
+{
+    union _PYI_DEBUGLOG_ARG *arg = record->header.args;
+    size_t strings_length = 0;
+    unsigned int num_args = 0;
+    const char *p = fmt;
+
+    while ((p = strchr(p, '%')) != NULL) {
+        struct _PYI_DEBUGLOG_SPEC spec;
+        int precision;
+
+        if (p[1] == '%') {
+            p += 2;
+            continue;
+        }
+        if (_pyi_debuglog_parse_spec(p, &spec) < 0) {
+            return -1;
+        }
+        if (num_args + spec.width_star + spec.precision_star + 1 > PYI_DEBUGLOG_MAX_ARGS) {
+            return -1;
+        }
+
+        if (spec.width_star) {
+            arg[num_args++].i = va_arg(args, int);
+        }
+        precision = spec.precision;
+        if (spec.precision_star) {
+            precision = va_arg(args, int);
+            arg[num_args++].i = precision;
+        }
+
+        switch (spec.type) {
+            case _PYI_DEBUGLOG_TYPE_SIGNED: {
+                long long value;
+                switch (spec.length) {
+                    case _PYI_DEBUGLOG_LENGTH_HH: value = (signed char)va_arg(args, int); break;
+                    case _PYI_DEBUGLOG_LENGTH_H: value = (short)va_arg(args, int); break;
+                    case _PYI_DEBUGLOG_LENGTH_L: value = va_arg(args, long); break;
+                    case _PYI_DEBUGLOG_LENGTH_LL: value = va_arg(args, long long); break;
+                    case _PYI_DEBUGLOG_LENGTH_J: value = va_arg(args, intmax_t); break;
+                    case _PYI_DEBUGLOG_LENGTH_Z: value = va_arg(args, ptrdiff_t); break;
+                    case _PYI_DEBUGLOG_LENGTH_T: value = va_arg(args, ptrdiff_t); break;
+                    case _PYI_DEBUGLOG_LENGTH_I64: value = va_arg(args, long long); break;
+                    case _PYI_DEBUGLOG_LENGTH_I: value = va_arg(args, intptr_t); break;
+                    default: value = va_arg(args, int); break;
+                }
+                arg[num_args++].i = value;
+                break;
+            }
+            case _PYI_DEBUGLOG_TYPE_UNSIGNED: {
+                unsigned long long value;
+                switch (spec.length) {
+                    case _PYI_DEBUGLOG_LENGTH_HH: value = (unsigned char)va_arg(args, unsigned int); break;
+                    case _PYI_DEBUGLOG_LENGTH_H: value = (unsigned short)va_arg(args, unsigned int); break;
+                    case _PYI_DEBUGLOG_LENGTH_L: value = va_arg(args, unsigned long); break;
+                    case _PYI_DEBUGLOG_LENGTH_LL: value = va_arg(args, unsigned long long); break;
+                    case _PYI_DEBUGLOG_LENGTH_J: value = va_arg(args, uintmax_t); break;
+                    case _PYI_DEBUGLOG_LENGTH_Z: value = va_arg(args, size_t); break;
+                    case _PYI_DEBUGLOG_LENGTH_T: value = (size_t)va_arg(args, ptrdiff_t); break;
+                    case _PYI_DEBUGLOG_LENGTH_I64: value = va_arg(args, unsigned long long); break;
+                    case _PYI_DEBUGLOG_LENGTH_I: value = va_arg(args, uintptr_t); break;
+                    default: value = va_arg(args, unsigned int); break;
+                }
+                arg[num_args++].u = value;
+                break;
+            }
+            case _PYI_DEBUGLOG_TYPE_CHAR: {
+                arg[num_args++].i = va_arg(args, int);
+                break;
+            }
+            case _PYI_DEBUGLOG_TYPE_DOUBLE: {
+                if (spec.length == _PYI_DEBUGLOG_LENGTH_LONG_DOUBLE) {
+                    arg[num_args++].d = (double)va_arg(args, long double);
+                } else {
+                    arg[num_args++].d = va_arg(args, double);
+                }
+                break;
+            }
+            case _PYI_DEBUGLOG_TYPE_STRING: {
+                arg[num_args++].u = _pyi_debuglog_copy_string(record, &strings_length, va_arg(args, const char *), precision);
+                break;
+            }
+            case _PYI_DEBUGLOG_TYPE_WSTRING: {
+                if (_pyi_debuglog_copy_wstring(record, &strings_length, va_arg(args, const wchar_t *), precision, &arg[num_args].u) < 0) {
+                    return -1;
+                }
+                num_args++;
+                break;
+            }
+            case _PYI_DEBUGLOG_TYPE_POINTER: {
+                arg[num_args++].p = va_arg(args, const void *);
+                break;
+            }
+        }
+
+        p = spec.end;
+    }
+
+    record->header.fmt = fmt;
+    record->header.num_args = num_args;
+
+    return 0;
+}
+
+/*
+ * Format the recorded message into the buffer, by replaying the format
+ * string with the stored arguments. Each conversion is formatted on its
+ * own; the integer conversions use the `ll` length modifier, as the
+ * arguments were widened to (unsigned) long long when recorded.
+ */
+static void
+_pyi_debuglog_format(const struct _PYI_DEBUGLOG_RECORD *record, char *buffer, size_t buffer_size)
+{
+    const union _PYI_DEBUGLOG_ARG *arg = record->header.args;
+    const char *p = record->header.fmt;
+    size_t length = 0;
+
+    while (*p && length < buffer_size - 1) {
+        struct _PYI_DEBUGLOG_SPEC spec;
+        char spec_buffer[2 * _PYI_DEBUGLOG_SPEC_LEN + 8];
+        size_t spec_length = 0;
+        const char *q;
+        int ret = 0;
+
+        if (*p != '%') {
+            buffer[length++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            buffer[length++] = '%';
+            p += 2;
+            continue;
+        }
+        _pyi_debuglog_parse_spec(p, &spec); /* cannot fail, as it succeeded when recorded */
+
+        /* Flags, field width and precision; replace the `*` with the
+         * stored values. Negative precision is treated as if it were
+         * omitted. */
+        spec_buffer[spec_length++] = '%';
+        for (q = spec.flags; q < spec.flags_end; q++) {
+            if (*q == '*') {
+                spec_length += snprintf(spec_buffer + spec_length, sizeof(spec_buffer) - spec_length, "%d", (int)(arg++)->i);
+            } else if (*q == '.' && spec.precision_star && arg->i < 0) {
+                arg++;
+                break;
+            } else {
+                spec_buffer[spec_length++] = *q;
+            }
+        }
+
+        switch (spec.type) {
+            case _PYI_DEBUGLOG_TYPE_SIGNED: {
+                spec_buffer[spec_length++] = 'l';
+                spec_buffer[spec_length++] = 'l';
+                spec_buffer[spec_length++] = spec.conversion;
+                spec_buffer[spec_length] = 0;
+                ret = snprintf(buffer + length, buffer_size - length, spec_buffer, (arg++)->i);
+                break;
+            }
+            case _PYI_DEBUGLOG_TYPE_UNSIGNED: {
+                spec_buffer[spec_length++] = 'l';
+                spec_buffer[spec_length++] = 'l';
+                spec_buffer[spec_length++] = spec.conversion;
+                spec_buffer[spec_length] = 0;
+                ret = snprintf(buffer + length, buffer_size - length, spec_buffer, (arg++)->u);
+                break;
+            }
+            case _PYI_DEBUGLOG_TYPE_CHAR: {
+                spec_buffer[spec_length++] = 'c';
+                spec_buffer[spec_length] = 0;
+                ret = snprintf(buffer + length, buffer_size - length, spec_buffer, (int)(arg++)->i);
+                break;
+            }
+            case _PYI_DEBUGLOG_TYPE_DOUBLE: {
+                spec_buffer[spec_length++] = spec.conversion;
+                spec_buffer[spec_length] = 0;
+                ret = snprintf(buffer + length, buffer_size - length, spec_buffer, (arg++)->d);
+                break;
+            }
+            case _PYI_DEBUGLOG_TYPE_STRING:
+            case _PYI_DEBUGLOG_TYPE_WSTRING: {
+                unsigned long long offset = (arg++)->u;
+                const char *str;
+                if (offset == _PYI_DEBUGLOG_STRING_NULL) {
+                    str = "(null)";
+                } else if (offset == _PYI_DEBUGLOG_STRING_TRUNCATED) {
+                    str = "...";
+                } else {
+                    str = record->strings + offset;
+                }
+                spec_buffer[spec_length++] = 's';
+                spec_buffer[spec_length] = 0;
+                ret = snprintf(buffer + length, buffer_size - length, spec_buffer, str);
+                break;
+            }
+            case _PYI_DEBUGLOG_TYPE_POINTER: {
+                spec_buffer[spec_length++] = 'p';
+                spec_buffer[spec_length] = 0;
+                ret = snprintf(buffer + length, buffer_size - length, spec_buffer, (arg++)->p);
+                break;
+            }
+        }
+
+        if (ret > 0) {
+            length += (size_t)ret;
+            if (length > buffer_size - 1) {
+                length = buffer_size - 1;
+            }
+        }
+        p = spec.end;
+    }
+
+    buffer[length] = 0;
+}
+
+
+/*
+ * Return the ring buffer of the calling thread, allocating it on the
+ * first call. Returns NULL if the thread has no ring buffer (the limit
+ * on number of ring buffers has been reached, or allocation failed).
+ */
+static struct _PYI_DEBUGLOG_RING *
+_pyi_debuglog_get_thread_ring(void)
+{
+#if defined(_PYI_DEBUGLOG_THREAD_LOCAL)
+    struct _PYI_DEBUGLOG_RING *ring = _pyi_debuglog_thread_ring;
+    unsigned int index;
+
+    if (ring != NULL || _pyi_debuglog_thread_unbuffered) {
+        return ring;
+    }
+
+    index = _pyi_debuglog_atomic_increment_uint(&_pyi_debuglog_num_rings);
+    if (index >= PYI_DEBUGLOG_MAX_RINGS) {
+        _pyi_debuglog_thread_unbuffered = true;
+        return NULL;
+    }
+
+    /* The records are written as they are used, so the untouched part
+     * of the allocation does not need to be backed by memory. */
+    ring = (struct _PYI_DEBUGLOG_RING *)calloc(1, sizeof(struct _PYI_DEBUGLOG_RING));
+    if (ring == NULL) {
+        _pyi_debuglog_thread_unbuffered = true;
+        return NULL;
+    }
+    ring->index = index;
+
+    _pyi_debuglog_atomic_push_ring(ring);
+    _pyi_debuglog_thread_ring = ring;
+
+    return ring;
+#else
+    return NULL;
+#endif
+}
+
+/*
+ * Record the debug message into the calling thread's ring buffer.
+ * Returns 0 if the message was recorded, and -1 if it needs to be
+ * written out right away (buffering is not enabled, or the message
+ * cannot be recorded).
+ */
+int
+pyi_debuglog_record(const char *fmt, va_list args)
+{
+    struct _PYI_DEBUGLOG_RING *ring;
+    struct _PYI_DEBUGLOG_RECORD *record;
+    uint64_t head;
+
+    if (!_pyi_debuglog_enabled) {
+        return -1;
+    }
+
+    ring = _pyi_debuglog_get_thread_ring();
+    if (ring == NULL) {
+        return -1;
+    }
+
+    head = ring->head;
+    record = &ring->records[head % PYI_DEBUGLOG_RING_CAPACITY];
+    if (_pyi_debuglog_capture(record, fmt, args) < 0) {
+        return -1;
+    }
+    record->header.timestamp = pyi_trace_get_timestamp();
+    record->header.sequence = _pyi_debuglog_atomic_increment(&_pyi_debuglog_sequence);
+
+    _pyi_debuglog_atomic_store(&ring->head, head + 1);
+
+    return 0;
+}
+
+
+/*
+ * Copy the oldest unflushed record of the ring into `record`, skipping
+ * the records that have been overwritten. Returns false if the ring has
+ * no unflushed records.
+ */
+static bool
+_pyi_debuglog_peek_ring(struct _PYI_DEBUGLOG_RING *ring, struct _PYI_DEBUGLOG_RECORD *record, uint64_t *num_lost)
+{
+    for (;;) {
+        uint64_t head = _pyi_debuglog_atomic_load(&ring->head);
+
+        if (ring->tail == head) {
+            return false;
+        }
+        if (head - ring->tail > PYI_DEBUGLOG_RING_CAPACITY - 1) {
+            /* The record might be overwritten by the next message */
+            *num_lost += head - ring->tail - (PYI_DEBUGLOG_RING_CAPACITY - 1);
+            ring->tail = head - (PYI_DEBUGLOG_RING_CAPACITY - 1);
+            continue;
+        }
+
+        memcpy(record, &ring->records[ring->tail % PYI_DEBUGLOG_RING_CAPACITY], sizeof(struct _PYI_DEBUGLOG_RECORD));
+
+        /* Discard the copy if the owner thread has overwritten the
+         * record in the meantime. */
+        head = _pyi_debuglog_atomic_load(&ring->head);
+        if (head - ring->tail > PYI_DEBUGLOG_RING_CAPACITY - 1) {
+            continue;
+        }
+        return true;
+    }
+}
+
+/*
+ * Write out the formatted message. In the crash handler, the message
+ * is written directly to stderr, bypassing stdio, whose locks might be
+ * held by the crashed thread.
+ */
+static void
+_pyi_debuglog_output(const char *message, bool from_crash_handler)
+{
+#if !defined(_WIN32)
+    if (from_crash_handler) {
+        size_t length = strlen(message);
+        while (length > 0) {
+            ssize_t written = write(STDERR_FILENO, message, length);
+            if (written <= 0) {
+                break;
+            }
+            message += written;
+            length -= (size_t)written;
+        }
+        return;
+    }
+#else
+    (void)from_crash_handler;
+#endif
+    pyi_debug_output_message(message);
+}
+
+/*
+ * Implementation of pyi_debuglog_flush(); does not allocate memory, so
+ * that it can be used from the crash handlers.
+ */
+static void
+_pyi_debuglog_flush(bool from_crash_handler)
+{
+    struct _PYI_DEBUGLOG_RING *rings;
+    struct _PYI_DEBUGLOG_RING *ring;
+    char message[_PYI_DEBUGLOG_MESSAGE_LEN];
+    int prefix_length;
+    uint64_t num_lost = 0;
+    int saved_errno;
+    int pid;
+
+    if (!_pyi_debuglog_enabled) {
+        return;
+    }
+    saved_errno = errno; /* Preserve errno for callers that report errors */
+    /* Flush is not re-entrant (e.g., a crash during the flush) */
+    if (!_pyi_debuglog_atomic_acquire_flag(&_pyi_debuglog_flushing)) {
+        errno = saved_errno;
+        return;
+    }
+
+#if defined(_WIN32)
+    pid = _getpid();
+#else
+    pid = getpid();
+#endif
+
+    /* The rings are pushed to the front of the list, so the part of the
+     * list that is loaded here does not change during the flush. */
+    rings = _pyi_debuglog_atomic_load_rings();
+
+    for (;;) {
+        struct _PYI_DEBUGLOG_RING *next_ring = NULL;
+
+        for (ring = rings; ring; ring = ring->next) {
+            if (!ring->has_front) {
+                ring->has_front = _pyi_debuglog_peek_ring(ring, &ring->front, &num_lost);
+            }
+            if (ring->has_front && (next_ring == NULL || ring->front.header.sequence < next_ring->front.header.sequence)) {
+                next_ring = ring;
+            }
+        }
+        if (next_ring == NULL) {
+            break;
+        }
+
+        prefix_length = snprintf(
+            message,
+            sizeof(message),
+            "[PYI-%d:DEBUG] [%llu.%06u T%u] ",
+            pid,
+            (unsigned long long)(next_ring->front.header.timestamp / 1000000),
+            (unsigned int)(next_ring->front.header.timestamp % 1000000),
+            next_ring->index
+        );
+        _pyi_debuglog_format(&next_ring->front, message + prefix_length, sizeof(message) - prefix_length);
+        _pyi_debuglog_output(message, from_crash_handler);
+
+        next_ring->has_front = false;
+        next_ring->tail++;
+    }
+
+    if (num_lost) {
+        snprintf(message, sizeof(message), "[PYI-%d:DEBUG] %llu debug message(s) were lost due to full log buffer!\n", pid, (unsigned long long)num_lost);
+        _pyi_debuglog_output(message, from_crash_handler);
+    }
+
+    _pyi_debuglog_atomic_release_flag(&_pyi_debuglog_flushing);
+    errno = saved_errno;
+}
+
+/*
+ * Format the recorded messages of all threads, in the order in which
+ * they were recorded, and write them out. The messages are prefixed
+ * with their timestamp (in seconds, on the same clock as the startup
+ * trace) and the ordinal number of their thread. Called at exit, before
+ * the process restarts itself, re-raises its child's signal, or crashes,
+ * and before error and warning messages are written out.
+ */
+void
+pyi_debuglog_flush(void)
+{
+    _pyi_debuglog_flush(false);
+}
+
+
+#if defined(_WIN32)
+
+static LONG WINAPI
+_pyi_debuglog_exception_filter(EXCEPTION_POINTERS *exception_info)
+{
+    (void)exception_info;
+    _pyi_debuglog_flush(true);
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+
+#else
+
+/* Signals that terminate the process due to a crash */
+static const int _pyi_debuglog_crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+
+static void
+_pyi_debuglog_crash_handler(int signum)
+{
+    /* The flush neither allocates memory nor uses stdio for output, so
+     * a crash within malloc() or stdio (or an abort due to corrupted
+     * heap) does not deadlock it. The formatting of messages is not
+     * strictly async-signal-safe; but the process is about to terminate,
+     * and the messages are needed the most in this case. */
+    _pyi_debuglog_flush(true);
+
+    /* The handler was reset to the default, which terminates the process
+     * once the handler returns. */
+    raise(signum);
+}
+
+#if defined(HAVE_PTHREAD_H)
+/* The child process of fork() inherits the records of its parent; they
+ * are flushed by the parent, so discard them in the child. */
+static void
+_pyi_debuglog_atfork_child(void)
+{
+    struct _PYI_DEBUGLOG_RING *ring;
+    for (ring = _pyi_debuglog_rings; ring; ring = ring->next) {
+        ring->tail = ring->head;
+        ring->has_front = false;
+    }
+    _pyi_debuglog_flushing = 0;
+}
+#endif
+
+#endif /* defined(_WIN32) */
+
+
+/*
+ * Enable the buffered debug log if PYINSTALLER_DEBUG_LOG_BUFFER
+ * environment variable is set to a value different from 0. Install
+ * the handlers that flush the log at exit and on crash.
+ */
+void
+pyi_debuglog_init(void)
+{
+#if !defined(_PYI_DEBUGLOG_THREAD_LOCAL)
+    /* Requires thread-local storage */
+#else
+    char *env_var_value;
+    bool enabled;
+
+    env_var_value = pyi_getenv("PYINSTALLER_DEBUG_LOG_BUFFER"); /* strdup'd copy or NULL */
+    enabled = env_var_value && env_var_value[0] && strcmp(env_var_value, "0") != 0;
+    free(env_var_value);
+    if (!enabled || _pyi_debuglog_enabled) {
+        return;
+    }
+
+#if defined(_WIN32)
+    SetUnhandledExceptionFilter(_pyi_debuglog_exception_filter);
+#else
+    {
+        struct sigaction action;
+        size_t i;
+
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = _pyi_debuglog_crash_handler;
+        action.sa_flags = SA_RESETHAND;
+        sigemptyset(&action.sa_mask);
+
+        for (i = 0; i < sizeof(_pyi_debuglog_crash_signals) / sizeof(_pyi_debuglog_crash_signals[0]); i++) {
+            struct sigaction old_action;
+            /* Do not replace the handlers installed by someone else */
+            if (sigaction(_pyi_debuglog_crash_signals[i], NULL, &old_action) == 0 && old_action.sa_handler == SIG_DFL) {
+                sigaction(_pyi_debuglog_crash_signals[i], &action, NULL);
+            }
+        }
+    }
+    #if defined(HAVE_PTHREAD_H)
+    pthread_atfork(NULL, NULL, _pyi_debuglog_atfork_child);
+    #endif
+#endif
+
+    atexit(pyi_debuglog_flush);
+
+    _pyi_debuglog_enabled = true;
+#endif
+}
+
+#else /* defined(LAUNCH_DEBUG) */
+
+void
+pyi_debuglog_init(void)
+{
+}
+
+void
+pyi_debuglog_flush(void)
+{
+}
+
+#endif /* defined(LAUNCH_DEBUG) */
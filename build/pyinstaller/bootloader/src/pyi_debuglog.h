@@ -0,0 +1,65 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Buffered debug log of debug-enabled bootloaders. When the
+ * PYINSTALLER_DEBUG_LOG_BUFFER environment variable is set (to a value
+ * different from 0), PYI_DEBUG messages are not formatted and written
+ * out right away; instead, their format string and arguments are
+ * recorded into a per-thread ring buffer, and the messages are
+ * formatted and written to stderr when the process exits (or before it
+ * restarts itself, re-raises its child's signal, or crashes). This
+ * keeps the timing of debug bootloaders close to that of the release
+ * ones.
+ */
+
+#ifndef PYI_DEBUGLOG_H
+#define PYI_DEBUGLOG_H
+
+#include <stdarg.h>
+
+#include "pyi_global.h"
+
+/* Size of a single record in the ring buffer, in bytes. The record
+ * holds the captured arguments and copies of the string arguments;
+ * the latter are truncated if they do not fit. */
+#define PYI_DEBUGLOG_RECORD_SIZE 512
+
+/* Maximal number of arguments (including the `*` field widths and
+ * precisions) of a recorded message; messages with more arguments are
+ * written out right away. */
+#define PYI_DEBUGLOG_MAX_ARGS 8
+
+/* Number of records in the ring buffer of each thread; when the buffer
+ * is full, the oldest records are overwritten. */
+#define PYI_DEBUGLOG_RING_CAPACITY 8192
+
+/* Maximal number of threads that can have a ring buffer; messages from
+ * additional threads are written out right away. */
+#define PYI_DEBUGLOG_MAX_RINGS 64
+
+/* In release builds, these are no-ops. */
+void pyi_debuglog_init(void);
+void pyi_debuglog_flush(void);
+
+#if defined(LAUNCH_DEBUG)
+
+int pyi_debuglog_record(const char *fmt, va_list args);
+
+/* Write out a formatted debug message; implemented by the platform's
+ * debug and error message functions. */
+void pyi_debug_output_message(const char *message);
+
+#endif /* defined(LAUNCH_DEBUG) */
+
+#endif /* PYI_DEBUGLOG_H */
@@ -11,10 +11,12 @@
  * ****************************************************************************
  */
 
+#include <stdio.h> /* snprintf */
 #include <stdlib.h> /* calloc */
 
 #include "pyi_global.h"
 #include "pyi_dylib_python.h"
+#include "pyi_thread.h"
 #include "pyi_utils.h"
 
 
@@ -151,11 +153,20 @@ static int _pyi_dylib_python_import_symbols(struct DYLIB_PYTHON *dylib)
     _IMPORT_FUNCTION(Py_IsInitialized)
     _IMPORT_FUNCTION(Py_PreInitialize) /* Used in both PEP 587 and PEP 741 codepath */
 
+#if defined(PYI_TARGET_PYTHON_VERSION)
+    /* Bootloader specialized for a single python version; the choice
+     * of initialization API is made at compile time. */
+    dylib->has_pep741 = PYI_DYLIB_PYTHON_HAS_PEP741(dylib);
+    if (dylib->has_pep741) {
+        _IMPORT_FUNCTION(PyInitConfig_Create)
+    }
+#else
     /* Try binding PyInitConfig_Create() to determine availability of
      * PEP-741 API (python >= 3.14.0a2). */
     PYI_EXT_FUNC_BIND(dylib->handle, PyInitConfig_Create, dylib->PyInitConfig_Create);
     dylib->has_pep741 = dylib->PyInitConfig_Create != NULL;
-    if (dylib->has_pep741) {
+#endif
+    if (PYI_DYLIB_PYTHON_HAS_PEP741(dylib)) {
         /* PEP-741 functions are available - bind the required ones */
         /*_IMPORT_FUNCTION(PyInitConfig_Create)*/ /* Already bound */
         _IMPORT_FUNCTION(PyInitConfig_Free)
@@ -179,8 +190,19 @@ static int _pyi_dylib_python_import_symbols(struct DYLIB_PYTHON *dylib)
         _IMPORT_FUNCTION(Py_ExitStatusException)
     }
 
+    _IMPORT_FUNCTION(PyArg_ParseTuple)
+
+    _IMPORT_FUNCTION(PyBool_FromLong)
+
+    _IMPORT_FUNCTION(PyBytes_AsString)
+    _IMPORT_FUNCTION(PyBytes_FromStringAndSize)
+
+    _IMPORT_FUNCTION(PyCFunction_NewEx)
+
     _IMPORT_FUNCTION(PyErr_Clear)
     _IMPORT_FUNCTION(PyErr_Fetch)
+    _IMPORT_FUNCTION(PyErr_Format)
+    _IMPORT_FUNCTION(PyErr_NoMemory)
     _IMPORT_FUNCTION(PyErr_NormalizeException)
     _IMPORT_FUNCTION(PyErr_Occurred)
     _IMPORT_FUNCTION(PyErr_Print)
@@ -198,8 +220,16 @@ static int _pyi_dylib_python_import_symbols(struct DYLIB_PYTHON *dylib)
 
     _IMPORT_FUNCTION(PyMem_RawFree)
 
+    _IMPORT_FUNCTION(PyMemoryView_FromMemory)
+
     _IMPORT_FUNCTION(PyModule_GetDict)
 
+#if !defined(_WIN32)
+    _IMPORT_FUNCTION(PyOS_AfterFork_Child)
+    _IMPORT_FUNCTION(PyOS_AfterFork_Parent)
+    _IMPORT_FUNCTION(PyOS_BeforeFork)
+#endif
+
     _IMPORT_FUNCTION(PyObject_CallFunction)
     _IMPORT_FUNCTION(PyObject_CallFunctionObjArgs)
     _IMPORT_FUNCTION(PyObject_GetAttrString)
@@ -225,6 +255,30 @@ static int _pyi_dylib_python_import_symbols(struct DYLIB_PYTHON *dylib)
 
 #undef _IMPORT_FUNCTION
 
+    /* Bind the exception type objects; these are exported as data, so
+     * we obtain the address of the variable that holds the pointer. */
+#ifdef _WIN32
+    #define _IMPORT_DATA(name) \
+        dylib->name = (PyObject **)(void *)GetProcAddress(dylib->handle, #name); \
+        if (!dylib->name) { \
+            PYI_WINERROR_W(L"GetProcAddress", L"Failed to import symbol %hs from Python DLL.\n", #name); \
+            return -1; \
+        }
+#else
+    #define _IMPORT_DATA(name) \
+        dylib->name = (PyObject **)dlsym(dylib->handle, #name); \
+        if (!dylib->name) { \
+            PYI_ERROR("Failed to import symbol %s from Python shared library: %s\n", #name, dlerror()); \
+            return -1; \
+        }
+#endif
+
+    _IMPORT_DATA(PyExc_ImportError)
+    _IMPORT_DATA(PyExc_KeyError)
+    _IMPORT_DATA(PyExc_OSError)
+
+#undef _IMPORT_DATA
+
     return 0;
 }
 
@@ -235,6 +289,19 @@ struct DYLIB_PYTHON *pyi_dylib_python_load(const char *root_directory, const cha
     struct DYLIB_PYTHON *dylib;
     int ret;
 
+#if defined(PYI_TARGET_PYTHON_VERSION)
+    /* Bootloader variant specialized for a single python version cannot
+     * run programs that were frozen with a different python version. */
+    if (python_version != PYI_TARGET_PYTHON_VERSION) {
+        PYI_ERROR(
+            "This bootloader supports only Python %d.%d, but the program was frozen with Python %d.%d!\n",
+            PYI_TARGET_PYTHON_VERSION / 100, PYI_TARGET_PYTHON_VERSION % 100,
+            python_version / 100, python_version % 100
+        );
+        return NULL;
+    }
+#endif
+
     /* Allocate structure */
     dylib = (struct DYLIB_PYTHON *)calloc(1, sizeof(struct DYLIB_PYTHON));
     if (dylib == NULL) {
@@ -266,6 +333,88 @@ struct DYLIB_PYTHON *pyi_dylib_python_load(const char *root_directory, const cha
     return dylib;
 }
 
+/* Background loading */
+struct DYLIB_PYTHON_LOADER
+{
+    /* Copies of the arguments for pyi_dylib_python_load() */
+    char root_directory[PYI_PATH_MAX];
+    char python_libname[PYI_PATH_MAX];
+    int python_version;
+
+    /* Result of pyi_dylib_python_load(); valid after the thread has
+     * been joined. */
+    struct DYLIB_PYTHON *dylib;
+
+#if PYI_HAVE_THREADS
+    pyi_thread_t thread;
+    unsigned char thread_started;
+#endif
+};
+
+#if PYI_HAVE_THREADS
+
+static PYI_THREAD_PROC_TYPE
+_pyi_dylib_python_loader_thread(void *arg)
+{
+    struct DYLIB_PYTHON_LOADER *loader = (struct DYLIB_PYTHON_LOADER *)arg;
+
+    loader->dylib = pyi_dylib_python_load(loader->root_directory, loader->python_libname, loader->python_version);
+
+    PYI_THREAD_PROC_RETURN;
+}
+
+#endif
+
+struct DYLIB_PYTHON_LOADER *pyi_dylib_python_load_start(const char *root_directory, const char *python_libname, int python_version)
+{
+    struct DYLIB_PYTHON_LOADER *loader;
+
+    loader = (struct DYLIB_PYTHON_LOADER *)calloc(1, sizeof(struct DYLIB_PYTHON_LOADER));
+    if (loader == NULL) {
+        PYI_PERROR("calloc", "Could not allocate memory for DYLIB_PYTHON_LOADER structure.\n");
+        return NULL;
+    }
+
+    snprintf(loader->root_directory, PYI_PATH_MAX, "%s", root_directory);
+    snprintf(loader->python_libname, PYI_PATH_MAX, "%s", python_libname);
+    loader->python_version = python_version;
+
+#if PYI_HAVE_THREADS
+    if (pyi_thread_create(&loader->thread, _pyi_dylib_python_loader_thread, loader) == 0) {
+        PYI_DEBUG("DYLIB: loading Python shared library in background thread...\n");
+        loader->thread_started = 1;
+        return loader;
+    }
+    PYI_DEBUG("DYLIB: failed to start background thread; loading Python shared library in main thread...\n");
+#endif
+
+    loader->dylib = pyi_dylib_python_load(loader->root_directory, loader->python_libname, loader->python_version);
+    return loader;
+}
+
+struct DYLIB_PYTHON *pyi_dylib_python_load_finish(struct DYLIB_PYTHON_LOADER **loader_ref)
+{
+    struct DYLIB_PYTHON_LOADER *loader = *loader_ref;
+    struct DYLIB_PYTHON *dylib;
+
+    *loader_ref = NULL;
+
+    if (loader == NULL) {
+        return NULL;
+    }
+
+#if PYI_HAVE_THREADS
+    if (loader->thread_started) {
+        pyi_thread_join(loader->thread);
+    }
+#endif
+
+    dylib = loader->dylib;
+    free(loader);
+
+    return dylib;
+}
+
 void pyi_dylib_python_cleanup(struct DYLIB_PYTHON **dylib_ref)
 {
     struct DYLIB_PYTHON *dylib = *dylib_ref;
@@ -67,6 +67,9 @@ typedef struct _PyCompilerFlags PyCompilerFlags;
  */
 typedef size_t Py_ssize_t;
 
+/* Flag for PyMemoryView_FromMemory(); see include/pybuffer.h */
+#define PyBUF_READ 0x100
+
 
 /* Definitions of configuration structure layouts. These are not opaque,
  * because we need to allocate them, and manipulate with their fields.
@@ -142,6 +145,22 @@ typedef struct _PyConfig PyConfig;
 typedef struct _PyInitConfig PyInitConfig;
 
 
+/* Definition of built-in function (method) that is implemented by the
+ * bootloader itself; see include/methodobject.h. The layout is part of
+ * the stable ABI.
+ */
+typedef PyObject *(*PyCFunction)(PyObject *, PyObject *);
+
+typedef struct {
+    const char *ml_name;
+    PyCFunction ml_meth;
+    int ml_flags;
+    const char *ml_doc;
+} PyMethodDef;
+
+#define METH_VARARGS 0x0001
+
+
 /*
  * Python shared library and bound functions imported from it.
  */
@@ -172,9 +191,24 @@ PYI_EXT_FUNC_PROTO(int, PyInitConfig_SetStr, (PyInitConfig *, const char *, cons
 PYI_EXT_FUNC_PROTO(int, PyInitConfig_SetStrList, (PyInitConfig *, const char *, size_t, char * const *))
 PYI_EXT_FUNC_PROTO(int, PyInitConfig_GetError, (PyInitConfig *, const char **))
 
+/* PyArg_ */
+PYI_EXT_FUNC_PROTO(int, PyArg_ParseTuple, (PyObject *, const char *, ...))
+
+/* PyBool_ */
+PYI_EXT_FUNC_PROTO(PyObject *, PyBool_FromLong, (long))
+
+/* PyBytes_ */
+PYI_EXT_FUNC_PROTO(char *, PyBytes_AsString, (PyObject *))
+PYI_EXT_FUNC_PROTO(PyObject *, PyBytes_FromStringAndSize, (const char *, Py_ssize_t))
+
+/* PyCFunction_ */
+PYI_EXT_FUNC_PROTO(PyObject *, PyCFunction_NewEx, (PyMethodDef *, PyObject *, PyObject *))
+
 /* PyErr_ */
 PYI_EXT_FUNC_PROTO(void, PyErr_Clear, (void))
 PYI_EXT_FUNC_PROTO(void, PyErr_Fetch, (PyObject **, PyObject **, PyObject **))
+PYI_EXT_FUNC_PROTO(PyObject *, PyErr_Format, (PyObject *, const char *, ...))
+PYI_EXT_FUNC_PROTO(PyObject *, PyErr_NoMemory, (void))
 PYI_EXT_FUNC_PROTO(void, PyErr_NormalizeException, (PyObject **, PyObject **, PyObject **))
 PYI_EXT_FUNC_PROTO(PyObject *, PyErr_Occurred, (void))
 PYI_EXT_FUNC_PROTO(void, PyErr_Print, (void))
@@ -197,9 +231,17 @@ PYI_EXT_FUNC_PROTO(PyObject *, PyMarshal_ReadObjectFromString, (const char *, Py
 /* PyMem_ */
 PYI_EXT_FUNC_PROTO(void, PyMem_RawFree, (void *))
 
+/* PyMemoryView_ */
+PYI_EXT_FUNC_PROTO(PyObject *, PyMemoryView_FromMemory, (char *, Py_ssize_t, int))
+
 /* PyModule_ */
 PYI_EXT_FUNC_PROTO(PyObject *, PyModule_GetDict, (PyObject *))
 
+/* PyOS_ (POSIX only; used by the fork server) */
+PYI_EXT_FUNC_PROTO(void, PyOS_AfterFork_Child, (void))
+PYI_EXT_FUNC_PROTO(void, PyOS_AfterFork_Parent, (void))
+PYI_EXT_FUNC_PROTO(void, PyOS_BeforeFork, (void))
+
 /* PyObject_ */
 PYI_EXT_FUNC_PROTO(PyObject *, PyObject_CallFunction, (PyObject *, char *, ...))
 PYI_EXT_FUNC_PROTO(PyObject *, PyObject_CallFunctionObjArgs, (PyObject *, ...))
@@ -265,8 +307,19 @@ struct DYLIB_PYTHON
     PYI_EXT_FUNC_ENTRY(PyInitConfig_SetStrList)
     PYI_EXT_FUNC_ENTRY(PyInitConfig_GetError)
 
+    PYI_EXT_FUNC_ENTRY(PyArg_ParseTuple)
+
+    PYI_EXT_FUNC_ENTRY(PyBool_FromLong)
+
+    PYI_EXT_FUNC_ENTRY(PyBytes_AsString)
+    PYI_EXT_FUNC_ENTRY(PyBytes_FromStringAndSize)
+
+    PYI_EXT_FUNC_ENTRY(PyCFunction_NewEx)
+
     PYI_EXT_FUNC_ENTRY(PyErr_Clear)
     PYI_EXT_FUNC_ENTRY(PyErr_Fetch)
+    PYI_EXT_FUNC_ENTRY(PyErr_Format)
+    PYI_EXT_FUNC_ENTRY(PyErr_NoMemory)
     PYI_EXT_FUNC_ENTRY(PyErr_NormalizeException)
     PYI_EXT_FUNC_ENTRY(PyErr_Occurred)
     PYI_EXT_FUNC_ENTRY(PyErr_Print)
@@ -284,8 +337,14 @@ struct DYLIB_PYTHON
 
     PYI_EXT_FUNC_ENTRY(PyMem_RawFree)
 
+    PYI_EXT_FUNC_ENTRY(PyMemoryView_FromMemory)
+
     PYI_EXT_FUNC_ENTRY(PyModule_GetDict)
 
+    PYI_EXT_FUNC_ENTRY(PyOS_AfterFork_Child)
+    PYI_EXT_FUNC_ENTRY(PyOS_AfterFork_Parent)
+    PYI_EXT_FUNC_ENTRY(PyOS_BeforeFork)
+
     PYI_EXT_FUNC_ENTRY(PyObject_CallFunction)
     PYI_EXT_FUNC_ENTRY(PyObject_CallFunctionObjArgs)
     PYI_EXT_FUNC_ENTRY(PyObject_GetAttrString)
@@ -308,9 +367,34 @@ struct DYLIB_PYTHON
     PYI_EXT_FUNC_ENTRY(PyUnicode_FromString)
     PYI_EXT_FUNC_ENTRY(PyUnicode_Join)
     PYI_EXT_FUNC_ENTRY(PyUnicode_Replace)
+
+    /* Pointers to imported data (exception type objects) */
+    PyObject **PyExc_ImportError;
+    PyObject **PyExc_KeyError;
+    PyObject **PyExc_OSError;
 };
 
 struct DYLIB_PYTHON *pyi_dylib_python_load(const char *root_directory, const char *python_libname, int python_version);
 void pyi_dylib_python_cleanup(struct DYLIB_PYTHON **dylib_ref);
 
+/* Loading of python shared library (and binding of its symbols) in a
+ * background thread, in parallel with the rest of bootloader setup. If
+ * threads are unavailable, the library is loaded by the start function.
+ * The finish function waits for the load to complete, frees the loader
+ * state, and returns the result of pyi_dylib_python_load(). */
+struct DYLIB_PYTHON_LOADER;
+
+struct DYLIB_PYTHON_LOADER *pyi_dylib_python_load_start(const char *root_directory, const char *python_libname, int python_version);
+struct DYLIB_PYTHON *pyi_dylib_python_load_finish(struct DYLIB_PYTHON_LOADER **loader_ref);
+
+/* Query availability of PEP-741 API. In bootloader variants that are
+ * specialized for a single python version (PYI_TARGET_PYTHON_VERSION),
+ * this is a compile-time constant, which allows compiler to drop the
+ * code path for the unused initialization API. */
+#if defined(PYI_TARGET_PYTHON_VERSION)
+    #define PYI_DYLIB_PYTHON_HAS_PEP741(dylib) (PYI_TARGET_PYTHON_VERSION >= 314)
+#else
+    #define PYI_DYLIB_PYTHON_HAS_PEP741(dylib) ((dylib)->has_pep741)
+#endif
+
 #endif /* PYI_DYLIB_PYTHON_H */
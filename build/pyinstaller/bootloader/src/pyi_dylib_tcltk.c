@@ -11,6 +11,10 @@
  * ****************************************************************************
  */
 
+/* Tcl/Tk is used only by the splash screen; not available in bootloader
+ * variants that were built without splash screen support. */
+#if !defined(PYI_WITHOUT_SPLASH)
+
 #include <stdlib.h> /* calloc */
 
 #include "pyi_global.h"
@@ -135,6 +139,9 @@ static int _pyi_dylib_tcltk_import_tcl_symbols(struct DYLIB_TCLTK *dylib)
     _IMPORT_FUNCTION(Tcl_ThreadQueueEvent)
     _IMPORT_FUNCTION(Tcl_ThreadAlert)
 
+    _IMPORT_FUNCTION(Tcl_CreateTimerHandler)
+    _IMPORT_FUNCTION(Tcl_DeleteTimerHandler)
+
     _IMPORT_FUNCTION(Tcl_GetVar2)
     _IMPORT_FUNCTION(Tcl_SetVar2)
     _IMPORT_FUNCTION(Tcl_CreateObjCommand)
@@ -268,3 +275,5 @@ void pyi_dylib_tcltk_cleanup(struct DYLIB_TCLTK **dylib_ref)
     /* Free the allocated structure */
     free(dylib);
 }
+
+#endif /* !defined(PYI_WITHOUT_SPLASH) */
@@ -44,12 +44,14 @@ typedef struct Tcl_Obj_ Tcl_Obj;
 typedef struct Tcl_Condition_ *Tcl_Condition;
 typedef struct Tcl_Mutex_ *Tcl_Mutex;
 typedef struct Tcl_Time_ Tcl_Time;
+typedef struct Tcl_TimerToken_ *Tcl_TimerToken;
 typedef void *ClientData;
 
 /* Function prototypes */
 typedef int (Tcl_ObjCmdProc)(ClientData, Tcl_Interp *, int, Tcl_Obj *const[]);
 typedef int (Tcl_CmdDeleteProc)(ClientData);
 typedef int (Tcl_EventProc)(Tcl_Event *, int);
+typedef void (Tcl_TimerProc)(ClientData);
 
 #ifdef _WIN32
     typedef unsigned (__stdcall Tcl_ThreadCreateProc)(ClientData clientData);
@@ -104,6 +106,10 @@ PYI_EXT_FUNC_PROTO(void, Tcl_ConditionWait, (Tcl_Condition *, Tcl_Mutex *, const
 PYI_EXT_FUNC_PROTO(void, Tcl_ThreadQueueEvent, (Tcl_ThreadId, Tcl_Event *, Tcl_QueuePosition))
 PYI_EXT_FUNC_PROTO(void, Tcl_ThreadAlert, (Tcl_ThreadId threadId))
 
+/* Timers */
+PYI_EXT_FUNC_PROTO(Tcl_TimerToken, Tcl_CreateTimerHandler, (int, Tcl_TimerProc *, ClientData))
+PYI_EXT_FUNC_PROTO(void, Tcl_DeleteTimerHandler, (Tcl_TimerToken))
+
 /* Tcl interpreter manipulation */
 PYI_EXT_FUNC_PROTO(const char*, Tcl_GetVar2, (Tcl_Interp *, const char *, const char *, int))
 PYI_EXT_FUNC_PROTO(const char*, Tcl_SetVar2, (Tcl_Interp *, const char *, const char *, const char *, int))
@@ -153,6 +159,9 @@ struct DYLIB_TCLTK
     PYI_EXT_FUNC_ENTRY(Tcl_ThreadQueueEvent)
     PYI_EXT_FUNC_ENTRY(Tcl_ThreadAlert)
 
+    PYI_EXT_FUNC_ENTRY(Tcl_CreateTimerHandler)
+    PYI_EXT_FUNC_ENTRY(Tcl_DeleteTimerHandler)
+
     PYI_EXT_FUNC_ENTRY(Tcl_GetVar2)
     PYI_EXT_FUNC_ENTRY(Tcl_SetVar2)
     PYI_EXT_FUNC_ENTRY(Tcl_CreateObjCommand)
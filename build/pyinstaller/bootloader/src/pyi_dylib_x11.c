@@ -0,0 +1,156 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Functions to load Xlib shared library and bind the functions used by
+ * the native splash screen backend.
+ */
+
+/* Xlib is used only on POSIX systems other than macOS, and only if its
+ * headers were available at build time. */
+#if defined(HAVE_X11_XLIB_H) && !defined(_WIN32) && !defined(__APPLE__) && !defined(PYI_WITHOUT_SPLASH)
+
+#include <stdlib.h> /* calloc */
+
+#include "pyi_global.h"
+#include "pyi_dylib_x11.h"
+
+
+/* Candidate names of the Xlib shared library, in order of preference */
+static const char *_pyi_dylib_x11_names[] = {
+    "libX11.so.6",
+    "libX11.so",
+    NULL
+};
+
+
+static int _pyi_dylib_x11_load_library(struct DYLIB_X11 *dylib)
+{
+    const char **name;
+
+    for (name = _pyi_dylib_x11_names; *name != NULL; name++) {
+        PYI_DEBUG("DYLIB: loading Xlib shared library: %s\n", *name);
+        dylib->handle = dlopen(*name, RTLD_NOW | RTLD_LOCAL);
+        if (dylib->handle != NULL) {
+            return 0;
+        }
+        PYI_DEBUG("DYLIB: failed to load Xlib shared library '%s': %s\n", *name, dlerror());
+    }
+
+    return -1;
+}
+
+/* Import symbols from the loaded shared library */
+static int _pyi_dylib_x11_import_symbols(struct DYLIB_X11 *dylib)
+{
+    /* Extend PYI_EXT_FUNC_BIND() with error handling. Unlike with other
+     * shared libraries, the failure is reported only in debug messages,
+     * because the splash screen is optional. */
+    #define _IMPORT_FUNCTION(name) \
+        PYI_EXT_FUNC_BIND(dylib->handle, name, dylib->name); \
+        if (!dylib->name) { \
+            PYI_DEBUG("DYLIB: failed to import symbol %s from Xlib shared library: %s\n", #name, dlerror()); \
+            return -1; \
+        }
+
+    _IMPORT_FUNCTION(XOpenDisplay)
+    _IMPORT_FUNCTION(XCloseDisplay)
+    _IMPORT_FUNCTION(XDefaultScreen)
+    _IMPORT_FUNCTION(XRootWindow)
+    _IMPORT_FUNCTION(XDisplayWidth)
+    _IMPORT_FUNCTION(XDisplayHeight)
+    _IMPORT_FUNCTION(XDefaultVisual)
+    _IMPORT_FUNCTION(XDefaultDepth)
+    _IMPORT_FUNCTION(XConnectionNumber)
+
+    _IMPORT_FUNCTION(XCreateSimpleWindow)
+    _IMPORT_FUNCTION(XDestroyWindow)
+    _IMPORT_FUNCTION(XSelectInput)
+    _IMPORT_FUNCTION(XMapRaised)
+    _IMPORT_FUNCTION(XInternAtom)
+    _IMPORT_FUNCTION(XChangeProperty)
+    _IMPORT_FUNCTION(XSetWMNormalHints)
+
+    _IMPORT_FUNCTION(XCreateGC)
+    _IMPORT_FUNCTION(XFreeGC)
+    _IMPORT_FUNCTION(XSetForeground)
+    _IMPORT_FUNCTION(XLoadQueryFont)
+    _IMPORT_FUNCTION(XFreeFont)
+    _IMPORT_FUNCTION(XSetFont)
+    _IMPORT_FUNCTION(XDrawString)
+    _IMPORT_FUNCTION(XCreateImage)
+    _IMPORT_FUNCTION(XPutImage)
+
+    _IMPORT_FUNCTION(XFlush)
+    _IMPORT_FUNCTION(XPending)
+    _IMPORT_FUNCTION(XNextEvent)
+
+#undef _IMPORT_FUNCTION
+
+    return 0;
+}
+
+
+/* The API functions */
+struct DYLIB_X11 *pyi_dylib_x11_load()
+{
+    struct DYLIB_X11 *dylib;
+
+    /* Allocate structure */
+    dylib = (struct DYLIB_X11 *)calloc(1, sizeof(struct DYLIB_X11));
+    if (dylib == NULL) {
+        PYI_PERROR("calloc", "Could not allocate memory for DYLIB_X11 structure.\n");
+        return NULL;
+    }
+
+    /* Load shared library */
+    if (_pyi_dylib_x11_load_library(dylib) != 0) {
+        goto cleanup;
+    }
+
+    /* Import functions/symbols */
+    if (_pyi_dylib_x11_import_symbols(dylib) != 0) {
+        goto cleanup;
+    }
+    PYI_DEBUG("DYLIB: imported symbols from Xlib shared library.\n");
+
+    return dylib;
+
+cleanup:
+    pyi_dylib_x11_cleanup(&dylib);
+    return dylib;
+}
+
+void pyi_dylib_x11_cleanup(struct DYLIB_X11 **dylib_ref)
+{
+    struct DYLIB_X11 *dylib = *dylib_ref;
+
+    *dylib_ref = NULL;
+
+    if (dylib == NULL) {
+        return;
+    }
+
+    if (dylib->handle != NULL) {
+        PYI_DEBUG("DYLIB: unloading Xlib shared library...\n");
+        if (dlclose(dylib->handle) < 0) {
+            PYI_DEBUG("DYLIB: failed to unload Xlib shared library!\n");
+        } else {
+            PYI_DEBUG("DYLIB: unloaded Xlib shared library.\n");
+        }
+    }
+
+    free(dylib);
+}
+
+#endif /* defined(HAVE_X11_XLIB_H) && !defined(_WIN32) && !defined(__APPLE__) && !defined(PYI_WITHOUT_SPLASH) */
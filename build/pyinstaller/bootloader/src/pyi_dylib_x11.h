@@ -0,0 +1,114 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Functions to load Xlib shared library and bind the functions used by
+ * the native splash screen backend. The library is loaded at run-time,
+ * so that the bootloader does not depend on it.
+ */
+
+#ifndef PYI_DYLIB_X11_H
+#define PYI_DYLIB_X11_H
+
+#include "pyi_global.h"
+
+/* The Xlib headers are used only for type definitions; the functions
+ * themselves are bound from the shared library. */
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+
+/*
+ * Xlib shared library and bound functions imported from it.
+ */
+
+/* Display and screen */
+PYI_EXT_FUNC_PROTO(Display *, XOpenDisplay, (const char *))
+PYI_EXT_FUNC_PROTO(int, XCloseDisplay, (Display *))
+PYI_EXT_FUNC_PROTO(int, XDefaultScreen, (Display *))
+PYI_EXT_FUNC_PROTO(Window, XRootWindow, (Display *, int))
+PYI_EXT_FUNC_PROTO(int, XDisplayWidth, (Display *, int))
+PYI_EXT_FUNC_PROTO(int, XDisplayHeight, (Display *, int))
+PYI_EXT_FUNC_PROTO(Visual *, XDefaultVisual, (Display *, int))
+PYI_EXT_FUNC_PROTO(int, XDefaultDepth, (Display *, int))
+PYI_EXT_FUNC_PROTO(int, XConnectionNumber, (Display *))
+
+/* Windows and properties */
+PYI_EXT_FUNC_PROTO(Window, XCreateSimpleWindow, (Display *, Window, int, int, unsigned int, unsigned int, unsigned int, unsigned long, unsigned long))
+PYI_EXT_FUNC_PROTO(int, XDestroyWindow, (Display *, Window))
+PYI_EXT_FUNC_PROTO(int, XSelectInput, (Display *, Window, long))
+PYI_EXT_FUNC_PROTO(int, XMapRaised, (Display *, Window))
+PYI_EXT_FUNC_PROTO(Atom, XInternAtom, (Display *, const char *, Bool))
+PYI_EXT_FUNC_PROTO(int, XChangeProperty, (Display *, Window, Atom, Atom, int, int, const unsigned char *, int))
+PYI_EXT_FUNC_PROTO(void, XSetWMNormalHints, (Display *, Window, XSizeHints *))
+
+/* Drawing */
+PYI_EXT_FUNC_PROTO(GC, XCreateGC, (Display *, Drawable, unsigned long, XGCValues *))
+PYI_EXT_FUNC_PROTO(int, XFreeGC, (Display *, GC))
+PYI_EXT_FUNC_PROTO(int, XSetForeground, (Display *, GC, unsigned long))
+PYI_EXT_FUNC_PROTO(XFontStruct *, XLoadQueryFont, (Display *, const char *))
+PYI_EXT_FUNC_PROTO(int, XFreeFont, (Display *, XFontStruct *))
+PYI_EXT_FUNC_PROTO(int, XSetFont, (Display *, GC, Font))
+PYI_EXT_FUNC_PROTO(int, XDrawString, (Display *, Drawable, GC, int, int, const char *, int))
+PYI_EXT_FUNC_PROTO(XImage *, XCreateImage, (Display *, Visual *, unsigned int, int, int, char *, unsigned int, unsigned int, int, int))
+PYI_EXT_FUNC_PROTO(int, XPutImage, (Display *, Drawable, GC, XImage *, int, int, int, int, unsigned int, unsigned int))
+
+/* Events */
+PYI_EXT_FUNC_PROTO(int, XFlush, (Display *))
+PYI_EXT_FUNC_PROTO(int, XPending, (Display *))
+PYI_EXT_FUNC_PROTO(int, XNextEvent, (Display *, XEvent *))
+
+/* The actual function-pointer structure */
+struct DYLIB_X11
+{
+    /* Shared library handle */
+    pyi_dylib_t handle;
+
+    /* Function pointers for imported functions */
+    PYI_EXT_FUNC_ENTRY(XOpenDisplay)
+    PYI_EXT_FUNC_ENTRY(XCloseDisplay)
+    PYI_EXT_FUNC_ENTRY(XDefaultScreen)
+    PYI_EXT_FUNC_ENTRY(XRootWindow)
+    PYI_EXT_FUNC_ENTRY(XDisplayWidth)
+    PYI_EXT_FUNC_ENTRY(XDisplayHeight)
+    PYI_EXT_FUNC_ENTRY(XDefaultVisual)
+    PYI_EXT_FUNC_ENTRY(XDefaultDepth)
+    PYI_EXT_FUNC_ENTRY(XConnectionNumber)
+
+    PYI_EXT_FUNC_ENTRY(XCreateSimpleWindow)
+    PYI_EXT_FUNC_ENTRY(XDestroyWindow)
+    PYI_EXT_FUNC_ENTRY(XSelectInput)
+    PYI_EXT_FUNC_ENTRY(XMapRaised)
+    PYI_EXT_FUNC_ENTRY(XInternAtom)
+    PYI_EXT_FUNC_ENTRY(XChangeProperty)
+    PYI_EXT_FUNC_ENTRY(XSetWMNormalHints)
+
+    PYI_EXT_FUNC_ENTRY(XCreateGC)
+    PYI_EXT_FUNC_ENTRY(XFreeGC)
+    PYI_EXT_FUNC_ENTRY(XSetForeground)
+    PYI_EXT_FUNC_ENTRY(XLoadQueryFont)
+    PYI_EXT_FUNC_ENTRY(XFreeFont)
+    PYI_EXT_FUNC_ENTRY(XSetFont)
+    PYI_EXT_FUNC_ENTRY(XDrawString)
+    PYI_EXT_FUNC_ENTRY(XCreateImage)
+    PYI_EXT_FUNC_ENTRY(XPutImage)
+
+    PYI_EXT_FUNC_ENTRY(XFlush)
+    PYI_EXT_FUNC_ENTRY(XPending)
+    PYI_EXT_FUNC_ENTRY(XNextEvent)
+};
+
+struct DYLIB_X11 *pyi_dylib_x11_load();
+void pyi_dylib_x11_cleanup(struct DYLIB_X11 **dylib_ref);
+
+#endif /* PYI_DYLIB_X11_H */
@@ -0,0 +1,49 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Asynchronous extraction of archive entries into files; implemented
+ * via io_uring on Linux (pyi_extractor_posix.c) and via overlapped I/O
+ * on Windows (pyi_extractor_win32.c). On other platforms, and if the
+ * platform facilities are not available at run-time, the extractor
+ * cannot be created, and the regular extraction path has to be used.
+ */
+
+#ifndef PYI_EXTRACTOR_H
+#define PYI_EXTRACTOR_H
+
+#include "pyi_global.h"
+
+struct ARCHIVE;
+struct ARCHIVE_SESSION;
+struct TOC_ENTRY;
+
+/* Number of entries that can be in flight at the same time; each of them
+ * holds one extraction buffer. */
+#define PYI_EXTRACTOR_NUM_SLOTS 16
+
+/* Size of the extraction buffers; larger entries are not extracted
+ * asynchronously (unless they are stored uncompressed in memory-mapped archive,
+ * in which case they are written straight from the mapping). */
+#define PYI_EXTRACTOR_BUFFER_SIZE (256 * 1024)
+
+/* The extractor is opaque, and must not be shared between threads. */
+struct PYI_EXTRACTOR;
+
+struct PYI_EXTRACTOR *pyi_extractor_new(void);
+int pyi_extractor_free(struct PYI_EXTRACTOR **extractor_ref);
+
+int pyi_extractor_submit(struct PYI_EXTRACTOR *extractor, struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename);
+int pyi_extractor_flush(struct PYI_EXTRACTOR *extractor);
+
+#endif /* PYI_EXTRACTOR_H */
@@ -0,0 +1,635 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Asynchronous extraction of archive entries; io_uring-based implementation
+ * for Linux. On other POSIX platforms, the extractor is not available.
+ *
+ * The regular extraction path (pyi_archive_session_extract2fs) performs
+ * a series of blocking system calls for each entry: it opens the output
+ * file, writes the decompressed data in chunks, changes its permissions,
+ * and closes it. With many small files, the extracting thread spends
+ * most of its time waiting on these calls instead of decompressing.
+ *
+ * The extractor submits the creation of output file (IORING_OP_OPENAT),
+ * writing of its data (IORING_OP_WRITE) and closing of the file
+ * (IORING_OP_CLOSE) into an io_uring submission queue, and returns right
+ * after the entry is decompressed into one of its fixed set of buffers;
+ * the operations for up to PYI_EXTRACTOR_NUM_SLOTS entries are in flight at
+ * the same time, and are advanced as their completions are reaped. The
+ * output files are created with their final permissions, which takes
+ * place of the separate fchmod() call. Entries that are stored
+ * uncompressed in a memory-mapped archive are written straight from the
+ * mapping, regardless of their size.
+ *
+ * The ring is set up via raw system calls, so liburing is not required.
+ * If the kernel does not support io_uring, or the required operations
+ * (Linux 5.6 and later), or if io_uring is disabled (for example, via
+ * the kernel.io_uring_disabled sysctl or by seccomp filter of container
+ * runtime), pyi_extractor_new() returns NULL, and the callers use
+ * the regular extraction path.
+ */
+
+/* Having a header included outside of the ifdef block prevents the compilation
+ * unit from becoming empty, which is disallowed by pedantic ISO C. */
+#include "pyi_global.h"
+
+#ifndef _WIN32
+
+#if defined(HAVE_IO_URING)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#endif
+
+/* PyInstaller headers. */
+#include "pyi_access_profile.h"
+#include "pyi_archive.h"
+#include "pyi_extractor.h"
+#include "pyi_main.h"
+#include "pyi_stats.h"
+
+
+#if defined(HAVE_IO_URING)
+
+/* Maximum size of a single write request; larger data is written
+ * with multiple requests. */
+#define _PYI_URING_MAX_WRITE_SIZE (1024 * 1024 * 1024)
+
+enum _PYI_URING_SLOT_STATE
+{
+    _PYI_URING_SLOT_FREE = 0,
+    _PYI_URING_SLOT_OPENING,
+    _PYI_URING_SLOT_WRITING,
+    _PYI_URING_SLOT_CLOSING
+};
+
+struct _PYI_URING_SLOT
+{
+    enum _PYI_URING_SLOT_STATE state;
+    const struct TOC_ENTRY *toc_entry;
+
+    /* The path needs to remain valid until the open request is
+     * processed by the kernel. */
+    char output_filename[PYI_PATH_MAX];
+
+    /* Extraction buffer (PYI_EXTRACTOR_BUFFER_SIZE bytes); allocated when
+     * the slot is first used. */
+    unsigned char *buffer;
+
+    /* Data to write (either the buffer, or archive's memory mapping) */
+    const unsigned char *data;
+    uint64_t length;
+    uint64_t written;
+
+    int fd;
+};
+
+struct PYI_EXTRACTOR
+{
+    int ring_fd;
+
+    /* Memory mappings of the rings and the submission queue entries */
+    void *ring_ptr;
+    size_t ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    /* Submission queue */
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned num_unsubmitted;
+
+    /* Completion queue */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    struct _PYI_URING_SLOT slots[PYI_EXTRACTOR_NUM_SLOTS];
+    int num_busy;
+
+    /* Set if any of the requests failed since the last flush. */
+    bool failed;
+};
+
+
+/**********************************************************************\
+ *                          Ring management                           *
+\**********************************************************************/
+static int
+_pyi_uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int
+_pyi_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int
+_pyi_uring_register(int ring_fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+/* Check that the kernel supports the operations that we need. */
+static bool
+_pyi_uring_probe_operations(int ring_fd)
+{
+    static const int required_ops[] = { IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE };
+    struct io_uring_probe *probe;
+    size_t probe_size;
+    size_t i;
+    bool supported = true;
+
+    probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    probe = (struct io_uring_probe *)calloc(1, probe_size);
+    if (probe == NULL) {
+        return false;
+    }
+
+    if (_pyi_uring_register(ring_fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+        free(probe);
+        return false;
+    }
+
+    for (i = 0; i < sizeof(required_ops) / sizeof(required_ops[0]); i++) {
+        if (required_ops[i] > probe->last_op || !(probe->ops[required_ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+            supported = false;
+            break;
+        }
+    }
+
+    free(probe);
+    return supported;
+}
+
+static int
+_pyi_uring_map_rings(struct PYI_EXTRACTOR *extractor, const struct io_uring_params *params)
+{
+    unsigned char *ring_ptr;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    unsigned *sq_array;
+    unsigned i;
+
+    /* The submission and completion rings share a single mapping; this
+     * is supported by all kernels that support the operations we need
+     * (IORING_FEAT_SINGLE_MMAP, Linux 5.4). */
+    if (!(params->features & IORING_FEAT_SINGLE_MMAP)) {
+        return -1;
+    }
+
+    sq_ring_size = params->sq_off.array + params->sq_entries * sizeof(unsigned);
+    cq_ring_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+    extractor->ring_size = sq_ring_size > cq_ring_size ? sq_ring_size : cq_ring_size;
+
+    ring_ptr = (unsigned char *)mmap(NULL, extractor->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, extractor->ring_fd, IORING_OFF_SQ_RING);
+    if (ring_ptr == MAP_FAILED) {
+        return -1;
+    }
+    extractor->ring_ptr = ring_ptr;
+
+    extractor->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+    extractor->sqes = (struct io_uring_sqe *)mmap(NULL, extractor->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, extractor->ring_fd, IORING_OFF_SQES);
+    if (extractor->sqes == MAP_FAILED) {
+        extractor->sqes = NULL;
+        return -1;
+    }
+
+    extractor->sq_head = (unsigned *)(ring_ptr + params->sq_off.head);
+    extractor->sq_tail = (unsigned *)(ring_ptr + params->sq_off.tail);
+    extractor->sq_mask = *(unsigned *)(ring_ptr + params->sq_off.ring_mask);
+
+    extractor->cq_head = (unsigned *)(ring_ptr + params->cq_off.head);
+    extractor->cq_tail = (unsigned *)(ring_ptr + params->cq_off.tail);
+    extractor->cq_mask = *(unsigned *)(ring_ptr + params->cq_off.ring_mask);
+    extractor->cqes = (struct io_uring_cqe *)(ring_ptr + params->cq_off.cqes);
+
+    /* Submission queue entries are always used in order, so the index
+     * array is set up once, as identity mapping. */
+    sq_array = (unsigned *)(ring_ptr + params->sq_off.array);
+    for (i = 0; i < params->sq_entries; i++) {
+        sq_array[i] = i;
+    }
+
+    return 0;
+}
+
+/*
+ * Obtain the next submission queue entry. Each slot has at most one
+ * request in flight, and the submission queue has at least as many
+ * entries as there are slots, so the queue never overflows.
+ */
+static struct io_uring_sqe *
+_pyi_uring_get_sqe(struct PYI_EXTRACTOR *extractor, int slot_index)
+{
+    unsigned tail = *extractor->sq_tail;
+    struct io_uring_sqe *sqe = &extractor->sqes[tail & extractor->sq_mask];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = (uint64_t)slot_index;
+
+    return sqe;
+}
+
+/* Make the prepared submission queue entry visible to the kernel. */
+static void
+_pyi_uring_commit_sqe(struct PYI_EXTRACTOR *extractor)
+{
+    __atomic_store_n(extractor->sq_tail, *extractor->sq_tail + 1, __ATOMIC_RELEASE);
+    extractor->num_unsubmitted++;
+}
+
+/*
+ * Submit the pending requests, and optionally wait for at least one
+ * completion.
+ */
+static int
+_pyi_uring_submit_and_wait(struct PYI_EXTRACTOR *extractor, bool wait)
+{
+    int ret;
+
+    if (extractor->num_unsubmitted == 0 && !wait) {
+        return 0;
+    }
+
+    do {
+        ret = _pyi_uring_enter(extractor->ring_fd, extractor->num_unsubmitted, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0) {
+        PYI_PERROR("io_uring_enter", "Failed to submit extraction requests!\n");
+        return -1;
+    }
+
+    extractor->num_unsubmitted -= (unsigned)ret;
+    return 0;
+}
+
+
+/**********************************************************************\
+ *                         Request handling                           *
+\**********************************************************************/
+static void
+_pyi_uring_prepare_write(struct PYI_EXTRACTOR *extractor, int slot_index)
+{
+    struct _PYI_URING_SLOT *slot = &extractor->slots[slot_index];
+    struct io_uring_sqe *sqe = _pyi_uring_get_sqe(extractor, slot_index);
+    uint64_t remaining = slot->length - slot->written;
+
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = slot->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(slot->data + slot->written);
+    sqe->len = remaining > _PYI_URING_MAX_WRITE_SIZE ? _PYI_URING_MAX_WRITE_SIZE : (unsigned)remaining;
+    sqe->off = slot->written;
+
+    slot->state = _PYI_URING_SLOT_WRITING;
+    _pyi_uring_commit_sqe(extractor);
+}
+
+static void
+_pyi_uring_prepare_close(struct PYI_EXTRACTOR *extractor, int slot_index)
+{
+    struct _PYI_URING_SLOT *slot = &extractor->slots[slot_index];
+    struct io_uring_sqe *sqe = _pyi_uring_get_sqe(extractor, slot_index);
+
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = slot->fd;
+
+    slot->state = _PYI_URING_SLOT_CLOSING;
+    _pyi_uring_commit_sqe(extractor);
+}
+
+/* Report the failed request, and mark the extractor as failed. */
+static void
+_pyi_uring_report_error(struct PYI_EXTRACTOR *extractor, const struct _PYI_URING_SLOT *slot, const char *funcname, const char *message, int result)
+{
+    errno = -result;
+    PYI_PERROR(funcname, "Failed to extract %s: %s\n", pyi_archive_get_entry_name(slot->toc_entry), message);
+    extractor->failed = true;
+}
+
+/*
+ * Advance the state of the slot whose request has completed.
+ */
+static void
+_pyi_uring_process_completion(struct PYI_EXTRACTOR *extractor, int slot_index, int result)
+{
+    struct _PYI_URING_SLOT *slot = &extractor->slots[slot_index];
+
+    switch (slot->state) {
+        case _PYI_URING_SLOT_OPENING: {
+            if (result < 0) {
+                _pyi_uring_report_error(extractor, slot, "openat", "failed to open target file!", result);
+                break;
+            }
+            slot->fd = result;
+            if (slot->length > 0) {
+                _pyi_uring_prepare_write(extractor, slot_index);
+            } else {
+                _pyi_uring_prepare_close(extractor, slot_index);
+            }
+            return;
+        }
+        case _PYI_URING_SLOT_WRITING: {
+            if (result <= 0) {
+                /* A write that makes no progress is reported as if
+                 * the file system was full. */
+                _pyi_uring_report_error(extractor, slot, "write", "failed to write data!", result < 0 ? result : -ENOSPC);
+                _pyi_uring_prepare_close(extractor, slot_index);
+                return;
+            }
+            slot->written += (uint64_t)result;
+            if (slot->written < slot->length) {
+                _pyi_uring_prepare_write(extractor, slot_index);
+            } else {
+                _pyi_uring_prepare_close(extractor, slot_index);
+            }
+            return;
+        }
+        case _PYI_URING_SLOT_CLOSING: {
+            if (result < 0) {
+                _pyi_uring_report_error(extractor, slot, "close", "failed to close target file!", result);
+            }
+            break;
+        }
+        default: {
+            return;
+        }
+    }
+
+    /* The entry is done (either finished or failed) */
+    slot->state = _PYI_URING_SLOT_FREE;
+    extractor->num_busy--;
+}
+
+/*
+ * Process all available completions; if `wait` is set, wait for at
+ * least one completion first. Follow-up requests are queued, and
+ * submitted with the next call.
+ */
+static int
+_pyi_uring_reap(struct PYI_EXTRACTOR *extractor, bool wait)
+{
+    unsigned head;
+    unsigned tail;
+
+    if (_pyi_uring_submit_and_wait(extractor, wait) < 0) {
+        return -1;
+    }
+
+    head = *extractor->cq_head;
+    tail = __atomic_load_n(extractor->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        const struct io_uring_cqe *cqe = &extractor->cqes[head & extractor->cq_mask];
+        _pyi_uring_process_completion(extractor, (int)cqe->user_data, cqe->res);
+        head++;
+    }
+    __atomic_store_n(extractor->cq_head, head, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+
+/**********************************************************************\
+ *                          Public interface                          *
+\**********************************************************************/
+/*
+ * Create the io_uring extractor. Returns NULL if io_uring (or any of
+ * the required operations) is not available.
+ */
+struct PYI_EXTRACTOR *
+pyi_extractor_new(void)
+{
+    struct PYI_EXTRACTOR *extractor;
+    struct io_uring_params params;
+
+    extractor = (struct PYI_EXTRACTOR *)calloc(1, sizeof(struct PYI_EXTRACTOR));
+    if (extractor == NULL) {
+        return NULL;
+    }
+
+    memset(&params, 0, sizeof(params));
+    extractor->ring_fd = _pyi_uring_setup(PYI_EXTRACTOR_NUM_SLOTS, &params);
+    if (extractor->ring_fd < 0) {
+        PYI_DEBUG("LOADER: io_uring is not available (errno %d); using regular extraction.\n", errno);
+        free(extractor);
+        return NULL;
+    }
+
+    if (!_pyi_uring_probe_operations(extractor->ring_fd) || _pyi_uring_map_rings(extractor, &params) < 0) {
+        PYI_DEBUG("LOADER: io_uring does not support required operations; using regular extraction.\n");
+        pyi_extractor_free(&extractor);
+        return NULL;
+    }
+
+    PYI_DEBUG("LOADER: using io_uring for extraction.\n");
+    return extractor;
+}
+
+/*
+ * Wait for all in-flight requests to finish, and free the extractor.
+ * Returns 0 if all entries were successfully extracted, -1 otherwise.
+ */
+int
+pyi_extractor_free(struct PYI_EXTRACTOR **extractor_ref)
+{
+    struct PYI_EXTRACTOR *extractor = *extractor_ref;
+    int rc = 0;
+    int i;
+
+    *extractor_ref = NULL;
+
+    if (extractor == NULL) {
+        return 0;
+    }
+
+    if (extractor->sqes != NULL) {
+        rc = pyi_extractor_flush(extractor);
+        munmap(extractor->sqes, extractor->sqes_size);
+    }
+    if (extractor->ring_ptr != NULL) {
+        munmap(extractor->ring_ptr, extractor->ring_size);
+    }
+    close(extractor->ring_fd);
+
+    for (i = 0; i < PYI_EXTRACTOR_NUM_SLOTS; i++) {
+        free(extractor->slots[i].buffer);
+    }
+    free(extractor);
+
+    return rc;
+}
+
+/*
+ * Submit extraction of the given entry into the specified output file.
+ * The entry is decompressed right away, and the file operations are
+ * performed asynchronously; their errors are reported by a subsequent
+ * call to pyi_extractor_flush().
+ *
+ * Returns 0 if the entry was submitted, 1 if the entry is not eligible
+ * (symbolic links and large entries) and needs to be extracted by the
+ * caller, and -1 on error.
+ */
+int
+pyi_extractor_submit(struct PYI_EXTRACTOR *extractor, struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+{
+    struct _PYI_URING_SLOT *slot;
+    struct io_uring_sqe *sqe;
+    const unsigned char *mapped_data = NULL;
+    int slot_index;
+
+    if (toc_entry->typecode == ARCHIVE_ITEM_SYMLINK) {
+        return 1;
+    }
+    if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_NONE) {
+        mapped_data = pyi_archive_get_mapped_data(archive, toc_entry);
+    }
+    if (mapped_data == NULL && toc_entry->uncompressed_length > PYI_EXTRACTOR_BUFFER_SIZE) {
+        return 1;
+    }
+
+    /* Obtain a free slot; if all are busy, wait for completions. */
+    while (extractor->num_busy == PYI_EXTRACTOR_NUM_SLOTS) {
+        if (_pyi_uring_reap(extractor, true) < 0) {
+            return -1;
+        }
+    }
+    for (slot_index = 0; slot_index < PYI_EXTRACTOR_NUM_SLOTS - 1; slot_index++) {
+        if (extractor->slots[slot_index].state == _PYI_URING_SLOT_FREE) {
+            break;
+        }
+    }
+    slot = &extractor->slots[slot_index];
+
+    /* Decompress the data into the slot's buffer */
+    if (mapped_data) {
+        pyi_access_profile_record(pyi_archive_get_entry_name(toc_entry));
+        pyi_archive_account_entry(toc_entry);
+        if (pyi_archive_verify_data(archive, toc_entry, mapped_data) < 0) {
+            return -1;
+        }
+        slot->data = mapped_data;
+    } else {
+        if (slot->buffer == NULL) {
+            slot->buffer = (unsigned char *)malloc(PYI_EXTRACTOR_BUFFER_SIZE);
+            if (slot->buffer == NULL) {
+                PYI_PERROR("malloc", "Failed to extract %s: failed to allocate extraction buffer!\n", pyi_archive_get_entry_name(toc_entry));
+                return -1;
+            }
+        }
+        if (pyi_archive_session_extract_into(session, archive, toc_entry, slot->buffer) < 0) {
+            return -1;
+        }
+        slot->data = slot->buffer;
+    }
+    slot->length = toc_entry->uncompressed_length;
+    slot->written = 0;
+    slot->toc_entry = toc_entry;
+    slot->fd = -1;
+    snprintf(slot->output_filename, PYI_PATH_MAX, "%s", output_filename);
+
+    /* Create the output file with its final permissions. */
+    sqe = _pyi_uring_get_sqe(extractor, slot_index);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)slot->output_filename;
+    sqe->len = toc_entry->typecode == ARCHIVE_ITEM_BINARY ? (S_IRUSR | S_IWUSR | S_IXUSR) : (S_IRUSR | S_IWUSR);
+    sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+
+    slot->state = _PYI_URING_SLOT_OPENING;
+    extractor->num_busy++;
+    pyi_stats_add(&global_pyi_ctx->stats.files_created, 1);
+    _pyi_uring_commit_sqe(extractor);
+
+    /* Submit the request (together with any follow-up requests that are
+     * queued), and advance the entries whose requests have completed in
+     * the meantime, without waiting. */
+    return _pyi_uring_reap(extractor, false);
+}
+
+/*
+ * Wait for all in-flight requests to finish. Returns 0 if all entries
+ * submitted since the last flush were successfully extracted, -1
+ * otherwise.
+ */
+int
+pyi_extractor_flush(struct PYI_EXTRACTOR *extractor)
+{
+    int rc;
+
+    while (extractor->num_busy > 0) {
+        if (_pyi_uring_reap(extractor, true) < 0) {
+            /* Cannot wait for the remaining requests; consider the
+             * corresponding entries lost. */
+            extractor->failed = true;
+            break;
+        }
+    }
+
+    rc = extractor->failed ? -1 : 0;
+    extractor->failed = false;
+
+    return rc;
+}
+
+#else /* defined(HAVE_IO_URING) */
+
+struct PYI_EXTRACTOR *
+pyi_extractor_new(void)
+{
+    return NULL;
+}
+
+int
+pyi_extractor_free(struct PYI_EXTRACTOR **extractor_ref)
+{
+    *extractor_ref = NULL;
+    return 0;
+}
+
+int
+pyi_extractor_submit(struct PYI_EXTRACTOR *extractor, struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+{
+    (void)extractor;
+    (void)session;
+    (void)archive;
+    (void)toc_entry;
+    (void)output_filename;
+    return 1;
+}
+
+int
+pyi_extractor_flush(struct PYI_EXTRACTOR *extractor)
+{
+    (void)extractor;
+    return 0;
+}
+
+#endif /* defined(HAVE_IO_URING) */
+
+#endif /* ifndef _WIN32 */
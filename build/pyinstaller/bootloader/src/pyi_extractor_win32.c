@@ -0,0 +1,530 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Asynchronous extraction of archive entries; overlapped I/O based
+ * implementation for Windows.
+ *
+ * The regular extraction path (pyi_archive_session_extract2fs) goes
+ * through pyi_path_fopen() and stdio, and blocks on every step; most
+ * notably on closing the file, because the on-access scanning of
+ * anti-virus software (e.g., Windows Defender) typically takes place
+ * when a newly-written file is closed.
+ *
+ * The extractor decompresses the entry into one of its fixed set of
+ * buffers, creates the output file with CreateFileW() (one of the few
+ * operations that cannot be performed asynchronously), preallocates its
+ * disk space with SetFileInformationByHandle(FileAllocationInfo), and
+ * issues an overlapped write; the writes of up to PYI_EXTRACTOR_NUM_SLOTS
+ * entries are in flight at the same time, and their completions are
+ * reaped via an I/O completion port. The handles of fully-written files
+ * are passed to a helper thread, which closes them in batches, so that
+ * the extracting thread does not wait for the scans. (NTFS completes
+ * the writes that extend the file synchronously, so for most entries,
+ * the gains come from the preallocation and the deferred closing.)
+ *
+ * Entries that are stored uncompressed in a memory-mapped archive are
+ * written straight from the mapping, regardless of their size.
+ */
+
+/* Having a header included outside of the ifdef block prevents the compilation
+ * unit from becoming empty, which is disallowed by pedantic ISO C. */
+#include "pyi_global.h"
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* PyInstaller headers. */
+#include "pyi_access_profile.h"
+#include "pyi_archive.h"
+#include "pyi_extractor.h"
+#include "pyi_main.h"
+#include "pyi_stats.h"
+#include "pyi_thread.h"
+#include "pyi_utils.h"
+
+
+/* Maximum size of a single write request; larger data is written
+ * with multiple requests. */
+#define _PYI_EXTRACTOR_MAX_WRITE_SIZE (1024 * 1024 * 1024)
+
+/* Maximum number of handles that are waiting to be closed. */
+#define _PYI_EXTRACTOR_CLOSE_QUEUE_SIZE 64
+
+struct _PYI_EXTRACTOR_SLOT
+{
+    /* Must be the first field; the completion packets carry the pointer
+     * to it. */
+    OVERLAPPED overlapped;
+
+    bool busy;
+    const struct TOC_ENTRY *toc_entry;
+    HANDLE handle;
+
+    /* Extraction buffer (PYI_EXTRACTOR_BUFFER_SIZE bytes); allocated
+     * when the slot is first used. */
+    unsigned char *buffer;
+
+    /* Data to write (either the buffer, or archive's memory mapping) */
+    const unsigned char *data;
+    uint64_t length;
+    uint64_t written;
+};
+
+struct PYI_EXTRACTOR
+{
+    HANDLE completion_port;
+
+    struct _PYI_EXTRACTOR_SLOT slots[PYI_EXTRACTOR_NUM_SLOTS];
+    int num_busy;
+
+    /* Set if any of the entries failed since the last flush. */
+    bool failed;
+
+    /* Helper thread that closes the handles of written files. */
+    pyi_thread_t close_thread;
+
+    /* Mutex protecting all fields below */
+    pyi_mutex_t close_mutex;
+
+    /* Signalled when a handle is added to the queue, or on shutdown */
+    pyi_cond_t close_available;
+    /* Signalled when handles are removed from the queue or closed */
+    pyi_cond_t close_done;
+
+    HANDLE close_queue[_PYI_EXTRACTOR_CLOSE_QUEUE_SIZE];
+    int close_count;
+
+    /* Number of handles that are currently being closed */
+    int closing_count;
+
+    bool close_failed;
+    bool close_shutdown;
+};
+
+
+/**********************************************************************\
+ *                         Closing of handles                         *
+\**********************************************************************/
+static PYI_THREAD_PROC_TYPE
+_pyi_extractor_close_worker(void *arg)
+{
+    struct PYI_EXTRACTOR *extractor = (struct PYI_EXTRACTOR *)arg;
+    HANDLE handles[_PYI_EXTRACTOR_CLOSE_QUEUE_SIZE];
+    bool failed;
+    int count;
+    int i;
+
+    pyi_mutex_lock(&extractor->close_mutex);
+    while (1) {
+        while (extractor->close_count == 0 && !extractor->close_shutdown) {
+            pyi_cond_wait(&extractor->close_available, &extractor->close_mutex);
+        }
+        if (extractor->close_count == 0) {
+            break; /* Shutdown, and no more handles */
+        }
+
+        /* Take the whole batch of queued handles */
+        count = extractor->close_count;
+        memcpy(handles, extractor->close_queue, count * sizeof(HANDLE));
+        extractor->close_count = 0;
+        extractor->closing_count = count;
+        pyi_cond_broadcast(&extractor->close_done);
+        pyi_mutex_unlock(&extractor->close_mutex);
+
+        failed = false;
+        for (i = 0; i < count; i++) {
+            if (!CloseHandle(handles[i])) {
+                PYI_WINERROR_W(L"CloseHandle", L"Failed to close extracted file!\n");
+                failed = true;
+            }
+        }
+
+        pyi_mutex_lock(&extractor->close_mutex);
+        extractor->closing_count = 0;
+        if (failed) {
+            extractor->close_failed = true;
+        }
+        pyi_cond_broadcast(&extractor->close_done);
+    }
+    pyi_mutex_unlock(&extractor->close_mutex);
+
+    PYI_THREAD_PROC_RETURN;
+}
+
+/* Queue the handle for closing; blocks while the queue is full. */
+static void
+_pyi_extractor_queue_close(struct PYI_EXTRACTOR *extractor, HANDLE handle)
+{
+    pyi_mutex_lock(&extractor->close_mutex);
+    while (extractor->close_count == _PYI_EXTRACTOR_CLOSE_QUEUE_SIZE) {
+        pyi_cond_wait(&extractor->close_done, &extractor->close_mutex);
+    }
+    extractor->close_queue[extractor->close_count++] = handle;
+    pyi_cond_signal(&extractor->close_available);
+    pyi_mutex_unlock(&extractor->close_mutex);
+}
+
+/* Wait until all queued handles are closed. Returns 0 on success, -1 if
+ * closing of any of them failed. */
+static int
+_pyi_extractor_wait_for_close(struct PYI_EXTRACTOR *extractor)
+{
+    int rc;
+
+    pyi_mutex_lock(&extractor->close_mutex);
+    while (extractor->close_count > 0 || extractor->closing_count > 0) {
+        pyi_cond_wait(&extractor->close_done, &extractor->close_mutex);
+    }
+    rc = extractor->close_failed ? -1 : 0;
+    extractor->close_failed = false;
+    pyi_mutex_unlock(&extractor->close_mutex);
+
+    return rc;
+}
+
+
+/**********************************************************************\
+ *                            Writing data                            *
+\**********************************************************************/
+/* The entry is done (either finished or failed); pass its handle to
+ * the helper thread, and release the slot. */
+static void
+_pyi_extractor_finish_slot(struct PYI_EXTRACTOR *extractor, struct _PYI_EXTRACTOR_SLOT *slot)
+{
+    _pyi_extractor_queue_close(extractor, slot->handle);
+    slot->handle = INVALID_HANDLE_VALUE;
+    slot->busy = false;
+    extractor->num_busy--;
+}
+
+/*
+ * Issue writes for the remaining data of the slot's entry, until a
+ * write is pending or all data is written. Writes that complete
+ * synchronously do not queue completion packets (see the use of
+ * FILE_SKIP_COMPLETION_PORT_ON_SUCCESS below), and are processed
+ * right away.
+ */
+static void
+_pyi_extractor_write(struct PYI_EXTRACTOR *extractor, struct _PYI_EXTRACTOR_SLOT *slot)
+{
+    DWORD chunk_size;
+    DWORD bytes_written;
+
+    while (slot->written < slot->length) {
+        uint64_t remaining = slot->length - slot->written;
+        chunk_size = remaining > _PYI_EXTRACTOR_MAX_WRITE_SIZE ? _PYI_EXTRACTOR_MAX_WRITE_SIZE : (DWORD)remaining;
+
+        memset(&slot->overlapped, 0, sizeof(slot->overlapped));
+        slot->overlapped.Offset = (DWORD)(slot->written & 0xFFFFFFFF);
+        slot->overlapped.OffsetHigh = (DWORD)(slot->written >> 32);
+
+        if (!WriteFile(slot->handle, slot->data + slot->written, chunk_size, NULL, &slot->overlapped)) {
+            if (GetLastError() == ERROR_IO_PENDING) {
+                return; /* Completion is reaped later */
+            }
+            PYI_WINERROR_W(L"WriteFile", L"Failed to extract %hs: failed to write data!\n", pyi_archive_get_entry_name(slot->toc_entry));
+            extractor->failed = true;
+            break;
+        }
+
+        /* Completed synchronously */
+        if (!GetOverlappedResult(slot->handle, &slot->overlapped, &bytes_written, FALSE) || bytes_written == 0) {
+            PYI_WINERROR_W(L"WriteFile", L"Failed to extract %hs: failed to write data!\n", pyi_archive_get_entry_name(slot->toc_entry));
+            extractor->failed = true;
+            break;
+        }
+        slot->written += bytes_written;
+    }
+
+    _pyi_extractor_finish_slot(extractor, slot);
+}
+
+/*
+ * Wait for completion of at least one pending write, and process all
+ * retrieved completions. Returns 0 on success, -1 if waiting failed.
+ */
+static int
+_pyi_extractor_reap(struct PYI_EXTRACTOR *extractor)
+{
+    OVERLAPPED_ENTRY entries[PYI_EXTRACTOR_NUM_SLOTS];
+    ULONG num_entries;
+    ULONG i;
+
+    if (!GetQueuedCompletionStatusEx(extractor->completion_port, entries, PYI_EXTRACTOR_NUM_SLOTS, &num_entries, INFINITE, FALSE)) {
+        PYI_WINERROR_W(L"GetQueuedCompletionStatusEx", L"Failed to wait for extraction requests!\n");
+        return -1;
+    }
+
+    for (i = 0; i < num_entries; i++) {
+        struct _PYI_EXTRACTOR_SLOT *slot = (struct _PYI_EXTRACTOR_SLOT *)entries[i].lpOverlapped;
+        DWORD bytes_written;
+
+        if (!GetOverlappedResult(slot->handle, &slot->overlapped, &bytes_written, FALSE) || bytes_written == 0) {
+            PYI_WINERROR_W(L"WriteFile", L"Failed to extract %hs: failed to write data!\n", pyi_archive_get_entry_name(slot->toc_entry));
+            extractor->failed = true;
+            _pyi_extractor_finish_slot(extractor, slot);
+            continue;
+        }
+
+        slot->written += bytes_written;
+        _pyi_extractor_write(extractor, slot);
+    }
+
+    return 0;
+}
+
+
+/**********************************************************************\
+ *                          Public interface                          *
+\**********************************************************************/
+/*
+ * Create the extractor. Returns NULL if it could not be created.
+ */
+struct PYI_EXTRACTOR *
+pyi_extractor_new(void)
+{
+    struct PYI_EXTRACTOR *extractor;
+    int i;
+
+    extractor = (struct PYI_EXTRACTOR *)calloc(1, sizeof(struct PYI_EXTRACTOR));
+    if (extractor == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < PYI_EXTRACTOR_NUM_SLOTS; i++) {
+        extractor->slots[i].handle = INVALID_HANDLE_VALUE;
+    }
+
+    extractor->completion_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (extractor->completion_port == NULL) {
+        PYI_DEBUG("LOADER: could not create I/O completion port; using regular extraction.\n");
+        free(extractor);
+        return NULL;
+    }
+
+    if (pyi_mutex_init(&extractor->close_mutex) < 0) {
+        CloseHandle(extractor->completion_port);
+        free(extractor);
+        return NULL;
+    }
+    pyi_cond_init(&extractor->close_available);
+    pyi_cond_init(&extractor->close_done);
+
+    if (pyi_thread_create(&extractor->close_thread, _pyi_extractor_close_worker, extractor) < 0) {
+        pyi_cond_destroy(&extractor->close_done);
+        pyi_cond_destroy(&extractor->close_available);
+        pyi_mutex_destroy(&extractor->close_mutex);
+        CloseHandle(extractor->completion_port);
+        free(extractor);
+        return NULL;
+    }
+
+    PYI_DEBUG("LOADER: using overlapped I/O for extraction.\n");
+    return extractor;
+}
+
+/*
+ * Wait for all in-flight writes to finish and the files to be closed,
+ * and free the extractor. Returns 0 if all entries were successfully
+ * extracted, -1 otherwise.
+ */
+int
+pyi_extractor_free(struct PYI_EXTRACTOR **extractor_ref)
+{
+    struct PYI_EXTRACTOR *extractor = *extractor_ref;
+    int rc;
+    int i;
+
+    *extractor_ref = NULL;
+
+    if (extractor == NULL) {
+        return 0;
+    }
+
+    rc = pyi_extractor_flush(extractor);
+
+    /* Stop the helper thread */
+    pyi_mutex_lock(&extractor->close_mutex);
+    extractor->close_shutdown = true;
+    pyi_cond_broadcast(&extractor->close_available);
+    pyi_mutex_unlock(&extractor->close_mutex);
+    pyi_thread_join(extractor->close_thread);
+
+    pyi_cond_destroy(&extractor->close_done);
+    pyi_cond_destroy(&extractor->close_available);
+    pyi_mutex_destroy(&extractor->close_mutex);
+
+    CloseHandle(extractor->completion_port);
+
+    for (i = 0; i < PYI_EXTRACTOR_NUM_SLOTS; i++) {
+        free(extractor->slots[i].buffer);
+    }
+    free(extractor);
+
+    return rc;
+}
+
+/*
+ * Submit extraction of the given entry into the specified output file.
+ * The entry is decompressed and its file is created right away, while
+ * writing and closing of the file are performed asynchronously; their
+ * errors are reported by a subsequent call to pyi_extractor_flush().
+ *
+ * Returns 0 if the entry was submitted, 1 if the entry is not eligible
+ * (symbolic links and large entries) and needs to be extracted by the
+ * caller, and -1 on error.
+ */
+int
+pyi_extractor_submit(struct PYI_EXTRACTOR *extractor, struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+{
+    struct _PYI_EXTRACTOR_SLOT *slot;
+    const unsigned char *mapped_data = NULL;
+    wchar_t output_filename_w[PYI_PATH_MAX];
+    FILE_ALLOCATION_INFO allocation_info;
+    HANDLE handle;
+    int slot_index;
+
+    if (toc_entry->typecode == ARCHIVE_ITEM_SYMLINK) {
+        return 1;
+    }
+    if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_NONE) {
+        mapped_data = pyi_archive_get_mapped_data(archive, toc_entry);
+    }
+    if (mapped_data == NULL && toc_entry->uncompressed_length > PYI_EXTRACTOR_BUFFER_SIZE) {
+        return 1;
+    }
+
+    if (pyi_win32_utf8_to_wcs(output_filename, output_filename_w, PYI_PATH_MAX) == NULL) {
+        PYI_ERROR("Failed to extract %s: failed to convert target file name to wide-char!\n", pyi_archive_get_entry_name(toc_entry));
+        return -1;
+    }
+
+    /* Obtain a free slot; if all are busy, wait for completions. */
+    while (extractor->num_busy == PYI_EXTRACTOR_NUM_SLOTS) {
+        if (_pyi_extractor_reap(extractor) < 0) {
+            return -1;
+        }
+    }
+    for (slot_index = 0; slot_index < PYI_EXTRACTOR_NUM_SLOTS - 1; slot_index++) {
+        if (!extractor->slots[slot_index].busy) {
+            break;
+        }
+    }
+    slot = &extractor->slots[slot_index];
+
+    /* Decompress the data into the slot's buffer */
+    if (mapped_data) {
+        pyi_access_profile_record(pyi_archive_get_entry_name(toc_entry));
+        pyi_archive_account_entry(toc_entry);
+        if (pyi_archive_verify_data(archive, toc_entry, mapped_data) < 0) {
+            return -1;
+        }
+        slot->data = mapped_data;
+    } else {
+        if (slot->buffer == NULL) {
+            slot->buffer = (unsigned char *)malloc(PYI_EXTRACTOR_BUFFER_SIZE);
+            if (slot->buffer == NULL) {
+                PYI_PERROR("malloc", "Failed to extract %s: failed to allocate extraction buffer!\n", pyi_archive_get_entry_name(toc_entry));
+                return -1;
+            }
+        }
+        if (pyi_archive_session_extract_into(session, archive, toc_entry, slot->buffer) < 0) {
+            return -1;
+        }
+        slot->data = slot->buffer;
+    }
+
+    /* Create the output file */
+    handle = CreateFileW(
+        output_filename_w,
+        GENERIC_WRITE,
+        0, /* dwShareMode */
+        NULL, /* lpSecurityAttributes */
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN | FILE_FLAG_OVERLAPPED,
+        NULL /* hTemplateFile */
+    );
+    if (handle == INVALID_HANDLE_VALUE) {
+        PYI_WINERROR_W(L"CreateFileW", L"Failed to extract %hs: failed to open target file!\n", pyi_archive_get_entry_name(toc_entry));
+        return -1;
+    }
+    pyi_stats_add(&global_pyi_ctx->stats.files_created, 1);
+
+    /* Preallocate the disk space, to avoid growing the file with each
+     * write; failure is not an error. */
+    if (toc_entry->uncompressed_length > 0) {
+        allocation_info.AllocationSize.QuadPart = (LONGLONG)toc_entry->uncompressed_length;
+        SetFileInformationByHandle(handle, FileAllocationInfo, &allocation_info, sizeof(allocation_info));
+    }
+
+    /* Associate the file with the completion port; writes that complete
+     * synchronously are processed by the caller of WriteFile(), and do
+     * not need to go through the port. */
+    if (CreateIoCompletionPort(handle, extractor->completion_port, 0, 0) == NULL) {
+        PYI_WINERROR_W(L"CreateIoCompletionPort", L"Failed to extract %hs: failed to associate target file with completion port!\n", pyi_archive_get_entry_name(toc_entry));
+        CloseHandle(handle);
+        return -1;
+    }
+    if (!SetFileCompletionNotificationModes(handle, FILE_SKIP_COMPLETION_PORT_ON_SUCCESS)) {
+        /* Without it, the synchronously-completed writes would be
+         * processed twice; let the caller extract the entry. */
+        CloseHandle(handle);
+        return 1;
+    }
+
+    slot->busy = true;
+    slot->toc_entry = toc_entry;
+    slot->handle = handle;
+    slot->length = toc_entry->uncompressed_length;
+    slot->written = 0;
+    extractor->num_busy++;
+
+    _pyi_extractor_write(extractor, slot);
+
+    return 0;
+}
+
+/*
+ * Wait for all in-flight writes to finish, and the files to be closed.
+ * Returns 0 if all entries submitted since the last flush were
+ * successfully extracted, -1 otherwise.
+ */
+int
+pyi_extractor_flush(struct PYI_EXTRACTOR *extractor)
+{
+    int rc;
+
+    while (extractor->num_busy > 0) {
+        if (_pyi_extractor_reap(extractor) < 0) {
+            /* Cannot wait for the remaining writes; consider the
+             * corresponding entries lost. */
+            extractor->failed = true;
+            break;
+        }
+    }
+
+    rc = extractor->failed ? -1 : 0;
+    extractor->failed = false;
+
+    if (_pyi_extractor_wait_for_close(extractor) < 0) {
+        rc = -1;
+    }
+
+    return rc;
+}
+
+#endif /* _WIN32 */
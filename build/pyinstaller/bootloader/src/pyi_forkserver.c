@@ -0,0 +1,1194 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Resident fork server for repeated launches of the same program.
+ *
+ * When enabled via the `pyi-fork-server` run-time option, the entry-point
+ * process of the program (the client) first tries to connect to the fork
+ * server of its executable, via a Unix domain socket in a per-user
+ * directory:
+ *
+ *   $XDG_RUNTIME_DIR/pyinstaller/<program name>-<digest>.sock, or
+ *   /tmp/pyinstaller-<uid>/<program name>-<digest>.sock
+ *
+ * where the digest covers the contents of the PKG archive and the path
+ * to the executable. If connected, the client sends its arguments,
+ * environment and working directory to the server, along with its
+ * standard file descriptors (via SCM_RIGHTS), and waits for the exit
+ * status of the application, forwarding the received signals to it.
+ * If no server is running, the client starts one in the background, and
+ * proceeds with the regular launch.
+ *
+ * The server is the same executable, started with _PYI_FORK_SERVER_SOCKET
+ * environment variable. It goes through the regular start-up, but once
+ * the python interpreter is initialized, the bootstrap script has been
+ * run, and the warm modules (`pyi-fork-server-warm-module` run-time
+ * options) have been imported, it listens on the socket instead of
+ * running the program's scripts. For each connection, it forks a handler
+ * process, which forks the application process and reports its PID and
+ * exit status to the client. The application process takes over the
+ * client's arguments, environment, working directory and standard file
+ * descriptors, and returns into the regular code-path, which runs the
+ * run-time hooks and the program's scripts.
+ *
+ * The application process keeps the server's values of the bootloader's
+ * internal environment variables (_PYI_*) and of the library search path.
+ * It is not attached to the client's controlling terminal, and the state
+ * that was set up during the start-up of the server (python interpreter
+ * configuration, already imported modules) is shared by all launches.
+ *
+ * An idle server exits after the time (in seconds) given by the option's
+ * value. As the socket name depends on the archive digest, a rebuilt
+ * program never connects to the server of its previous version.
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE /* struct ucred */
+#endif
+
+#ifndef _WIN32
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <limits.h> /* INT_MAX */
+    #include <poll.h>
+    #include <signal.h>
+    #include <sys/file.h> /* flock */
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/time.h> /* struct timeval */
+    #include <sys/types.h>
+    #include <sys/un.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_archive.h"
+#include "pyi_dylib_python.h"
+#include "pyi_forkserver.h"
+#include "pyi_main.h"
+#include "pyi_pyz_prefetch.h"
+#include "pyi_utils.h"
+
+
+#if defined(PYI_FORKSERVER_AVAILABLE)
+
+extern char **environ;
+
+/* Name of the environment variable that passes the socket path to the
+ * fork server that is being started. */
+#define _PYI_FORKSERVER_ENV_VAR "_PYI_FORK_SERVER_SOCKET"
+
+/* Magic value at the start of the request header ("PYFS"). */
+#define _PYI_FORKSERVER_MAGIC 0x50594653
+
+/* Maximal length of the request payload. */
+#define _PYI_FORKSERVER_MAX_PAYLOAD_LENGTH (4 * 1024 * 1024)
+
+/* Time (in seconds) that the client waits for the server to start the
+ * application, and that the handler waits for the client's request. */
+#define _PYI_FORKSERVER_REQUEST_TIMEOUT 10
+
+#if defined(MSG_NOSIGNAL)
+    #define _PYI_FORKSERVER_SEND_FLAGS MSG_NOSIGNAL
+#else
+    #define _PYI_FORKSERVER_SEND_FLAGS 0
+#endif
+
+/* Header of the request that the client sends to the server; followed
+ * by the payload, which consists of NUL-terminated strings: the working
+ * directory, `argc` arguments, and `envc` environment entries. */
+struct _PYI_FORKSERVER_REQUEST_HEADER
+{
+    uint32_t magic;
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t payload_length;
+};
+
+/* Signals that the client forwards to the application process. */
+static const int _pyi_forkserver_forwarded_signals[] = {
+    SIGHUP,
+    SIGINT,
+    SIGQUIT,
+    SIGTERM,
+    SIGUSR1,
+    SIGUSR2,
+};
+
+#define _PYI_FORKSERVER_NUM_FORWARDED_SIGNALS \
+    (sizeof(_pyi_forkserver_forwarded_signals) / sizeof(_pyi_forkserver_forwarded_signals[0]))
+
+/* PID of the application process, for the client's signal handler. */
+static volatile pid_t _pyi_forkserver_application_pid = 0;
+
+
+/**********************************************************************\
+ *                          Helper functions                          *
+\**********************************************************************/
+/*
+ * Compute the path to the server's socket, creating the per-user
+ * directory, if necessary. Returns 0 on success, -1 on error (including
+ * the case when the directory is accessible to other users).
+ */
+static int
+_pyi_forkserver_format_socket_path(struct PYI_CONTEXT *pyi_ctx, char *socket_path, size_t size)
+{
+    char directory[PYI_PATH_MAX];
+    const char *runtime_dir;
+    const char *program_name;
+    const unsigned char *p;
+    uint64_t digest;
+    struct stat statbuf;
+
+    if (pyi_archive_compute_digest(pyi_ctx->archive, &digest) < 0) {
+        return -1;
+    }
+
+    /* Mix in the path to the executable, so that copies of the program
+     * in different locations (e.g., of a onedir application) use their
+     * own servers. */
+    for (p = (const unsigned char *)pyi_ctx->executable_filename; *p; p++) {
+        digest = (digest ^ *p) * 0x100000001B3ULL;
+    }
+
+    runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && runtime_dir[0] == PYI_SEP) {
+        if (snprintf(directory, PYI_PATH_MAX, "%s/pyinstaller", runtime_dir) >= PYI_PATH_MAX) {
+            return -1;
+        }
+    } else {
+        snprintf(directory, PYI_PATH_MAX, "/tmp/pyinstaller-%lu", (unsigned long)getuid());
+    }
+
+    if (mkdir(directory, 0700) < 0 && errno != EEXIST) {
+        PYI_DEBUG("LOADER: fork server: failed to create directory %s (errno %d)!\n", directory, errno);
+        return -1;
+    }
+
+    /* The directory must be owned by us, and inaccessible to others. */
+    if (lstat(directory, &statbuf) < 0 || !S_ISDIR(statbuf.st_mode) || statbuf.st_uid != getuid() || (statbuf.st_mode & 077) != 0) {
+        PYI_DEBUG("LOADER: fork server: directory %s has unsafe ownership or permissions!\n", directory);
+        return -1;
+    }
+
+    /* The length of socket path is limited by the size of sun_path, so
+     * the program name is truncated. */
+    program_name = strrchr(pyi_ctx->executable_filename, PYI_SEP);
+    program_name = program_name ? program_name + 1 : pyi_ctx->executable_filename;
+    if ((size_t)snprintf(socket_path, size, "%s/%.32s-%016llx.sock", directory, program_name, (unsigned long long)digest) >= size) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+_pyi_forkserver_write_all(int fd, const void *data, size_t length)
+{
+    const char *ptr = (const char *)data;
+    ssize_t count;
+
+    while (length > 0) {
+        count = send(fd, ptr, length, _PYI_FORKSERVER_SEND_FLAGS);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        ptr += count;
+        length -= (size_t)count;
+    }
+
+    return 0;
+}
+
+static int
+_pyi_forkserver_read_all(int fd, void *data, size_t length)
+{
+    char *ptr = (char *)data;
+    ssize_t count;
+
+    while (length > 0) {
+        count = recv(fd, ptr, length, 0);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (count == 0) {
+            return -1; /* Connection closed */
+        }
+        ptr += count;
+        length -= (size_t)count;
+    }
+
+    return 0;
+}
+
+/* Set the receive timeout on the socket; zero disables the timeout. */
+static void
+_pyi_forkserver_set_receive_timeout(int fd, int seconds)
+{
+    struct timeval timeout;
+
+    timeout.tv_sec = seconds;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+
+/**********************************************************************\
+ *                               Client                               *
+\**********************************************************************/
+/*
+ * Serialize the working directory, arguments, and environment of this
+ * process into the request payload. Returns the malloc'ed payload, or
+ * NULL on error.
+ */
+static char *
+_pyi_forkserver_build_payload(const struct PYI_CONTEXT *pyi_ctx, struct _PYI_FORKSERVER_REQUEST_HEADER *header)
+{
+    char cwd[PYI_PATH_MAX];
+    char *payload;
+    char *ptr;
+    size_t length;
+    size_t envc = 0;
+    char **env;
+    int i;
+
+    if (getcwd(cwd, PYI_PATH_MAX) == NULL) {
+        return NULL;
+    }
+
+    length = strlen(cwd) + 1;
+    for (i = 0; i < pyi_ctx->argc; i++) {
+        length += strlen(pyi_ctx->argv[i]) + 1;
+    }
+    for (env = environ; *env; env++) {
+        length += strlen(*env) + 1;
+        envc++;
+    }
+    if (length > _PYI_FORKSERVER_MAX_PAYLOAD_LENGTH) {
+        return NULL;
+    }
+
+    payload = (char *)malloc(length);
+    if (payload == NULL) {
+        return NULL;
+    }
+
+    ptr = payload;
+    ptr += snprintf(ptr, length, "%s", cwd) + 1;
+    for (i = 0; i < pyi_ctx->argc; i++) {
+        ptr += snprintf(ptr, length - (ptr - payload), "%s", pyi_ctx->argv[i]) + 1;
+    }
+    for (env = environ; *env; env++) {
+        ptr += snprintf(ptr, length - (ptr - payload), "%s", *env) + 1;
+    }
+
+    header->magic = _PYI_FORKSERVER_MAGIC;
+    header->argc = (uint32_t)pyi_ctx->argc;
+    header->envc = (uint32_t)envc;
+    header->payload_length = (uint32_t)length;
+
+    return payload;
+}
+
+/*
+ * Send the request header along with our standard file descriptors,
+ * followed by the payload.
+ */
+static int
+_pyi_forkserver_send_request(int fd, const struct _PYI_FORKSERVER_REQUEST_HEADER *header, const char *payload)
+{
+    const int std_fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(std_fds))];
+    } control;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    ssize_t count;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+
+    iov.iov_base = (void *)header;
+    iov.iov_len = sizeof(*header);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(std_fds));
+    memcpy(CMSG_DATA(cmsg), std_fds, sizeof(std_fds));
+
+    do {
+        count = sendmsg(fd, &msg, _PYI_FORKSERVER_SEND_FLAGS);
+    } while (count < 0 && errno == EINTR);
+    if (count != (ssize_t)sizeof(*header)) {
+        return -1;
+    }
+
+    return _pyi_forkserver_write_all(fd, payload, header->payload_length);
+}
+
+static void
+_pyi_forkserver_forward_signal(int signum)
+{
+    int original_errno = errno;
+    pid_t pid = _pyi_forkserver_application_pid;
+
+    /* Avoid signalling the whole process group with PID 0. */
+    if (pid > 0) {
+        kill(pid, signum);
+    }
+
+    errno = original_errno;
+}
+
+/*
+ * Try delegating the launch to the running server. Returns 0 if the
+ * application was run by the server (with its exit code stored in
+ * `exit_code`), 1 if there is no server to connect to, and -1 if the
+ * server could not be used for other reasons.
+ */
+static int
+_pyi_forkserver_delegate(const struct PYI_CONTEXT *pyi_ctx, const char *socket_path, int *exit_code)
+{
+    struct _PYI_FORKSERVER_REQUEST_HEADER header;
+    struct sockaddr_un addr;
+    struct sigaction action;
+    char *payload;
+    int32_t value;
+    int status;
+    size_t i;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        PYI_DEBUG("LOADER: fork server: no server is listening on %s.\n", socket_path);
+        close(fd);
+        return 1;
+    }
+
+    payload = _pyi_forkserver_build_payload(pyi_ctx, &header);
+    if (payload == NULL) {
+        PYI_DEBUG("LOADER: fork server: failed to serialize the request!\n");
+        close(fd);
+        return -1;
+    }
+
+    /* Send the request, and wait for the PID of the application process. */
+    _pyi_forkserver_set_receive_timeout(fd, _PYI_FORKSERVER_REQUEST_TIMEOUT);
+    if (_pyi_forkserver_send_request(fd, &header, payload) < 0 || _pyi_forkserver_read_all(fd, &value, sizeof(value)) < 0) {
+        PYI_DEBUG("LOADER: fork server: server did not accept the request (errno %d)!\n", errno);
+        free(payload);
+        close(fd);
+        return -1;
+    }
+    free(payload);
+
+    PYI_DEBUG("LOADER: fork server: application is running in process with PID %d.\n", (int)value);
+    _pyi_forkserver_application_pid = (pid_t)value;
+
+    /* Forward signals to the application process. */
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = _pyi_forkserver_forward_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    for (i = 0; i < _PYI_FORKSERVER_NUM_FORWARDED_SIGNALS; i++) {
+        sigaction(_pyi_forkserver_forwarded_signals[i], &action, NULL);
+    }
+
+    /* Wait for the exit status of the application process. */
+    _pyi_forkserver_set_receive_timeout(fd, 0);
+    if (_pyi_forkserver_read_all(fd, &value, sizeof(value)) < 0) {
+        PYI_ERROR("Lost connection to the fork server while the application was running!\n");
+        close(fd);
+        *exit_code = 1;
+        return 0;
+    }
+    close(fd);
+
+    for (i = 0; i < _PYI_FORKSERVER_NUM_FORWARDED_SIGNALS; i++) {
+        signal(_pyi_forkserver_forwarded_signals[i], SIG_DFL);
+    }
+
+    status = (int)value;
+    if (WIFSIGNALED(status)) {
+        /* Re-raise the application's signal, in the same way as the
+         * parent process of onefile application does. */
+        PYI_DEBUG("LOADER: fork server: re-raising application signal %d\n", WTERMSIG(status));
+        signal(WTERMSIG(status), SIG_DFL);
+        raise(WTERMSIG(status));
+        *exit_code = 128 + WTERMSIG(status);
+    } else {
+        *exit_code = WEXITSTATUS(status);
+    }
+    PYI_DEBUG("LOADER: fork server: application exited with code %d.\n", *exit_code);
+
+    return 0;
+}
+
+/*
+ * Start the server in the background, as a new top-level process of the
+ * program, detached from our session.
+ */
+static void
+_pyi_forkserver_start_server(const struct PYI_CONTEXT *pyi_ctx, const char *socket_path)
+{
+    pid_t pid;
+    int status;
+
+    pid = fork();
+    if (pid < 0) {
+        return;
+    }
+
+    if (pid == 0) {
+        char *server_argv[2];
+        char *const *exec_argv = server_argv;
+        const char *exec_filename = pyi_ctx->executable_filename;
+        int null_fd;
+
+        /* Detach from the session, and fork again, so that the server
+         * is not a child of this process. */
+        if (setsid() < 0) {
+            _exit(1);
+        }
+        pid = fork();
+        if (pid != 0) {
+            _exit(pid < 0 ? 1 : 0);
+        }
+
+        null_fd = open("/dev/null", O_RDWR);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDIN_FILENO);
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+            if (null_fd > STDERR_FILENO) {
+                close(null_fd);
+            }
+        }
+
+        /* Start as a new top-level process of the program; the splash
+         * screen (if any) is not shown by the server. */
+        pyi_unsetenv("_PYI_PARENT_PROCESS_LEVEL");
+        pyi_setenv("PYINSTALLER_SUPPRESS_SPLASH_SCREEN", "1");
+        pyi_setenv(_PYI_FORKSERVER_ENV_VAR, socket_path);
+
+        server_argv[0] = pyi_ctx->argv[0];
+        server_argv[1] = NULL;
+        if (pyi_ctx->dynamic_loader_filename[0] != 0) {
+            exec_filename = pyi_ctx->dynamic_loader_filename;
+            exec_argv = pyi_prepend_dynamic_loader_to_argv(1, server_argv, (char *)pyi_ctx->dynamic_loader_filename);
+            if (exec_argv == NULL) {
+                _exit(1);
+            }
+        }
+        execv(exec_filename, exec_argv);
+        _exit(1);
+    }
+
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    PYI_DEBUG("LOADER: fork server: started the server in the background.\n");
+}
+
+
+/**********************************************************************\
+ *                               Server                               *
+\**********************************************************************/
+/* Check that the connected client belongs to the same user. */
+static int
+_pyi_forkserver_check_peer(int fd)
+{
+#if defined(__linux__) && defined(SO_PEERCRED)
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) < 0) {
+        return -1;
+    }
+    return credentials.uid == getuid() ? 0 : -1;
+#elif defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__) || defined(__DragonFly__)
+    uid_t uid;
+    gid_t gid;
+
+    if (getpeereid(fd, &uid, &gid) < 0) {
+        return -1;
+    }
+    return uid == getuid() ? 0 : -1;
+#else
+    /* Rely on the permissions of the socket's directory. */
+    (void)fd;
+    return 0;
+#endif
+}
+
+/*
+ * Receive the request header and client's standard file descriptors,
+ * followed by the payload, which is validated. Returns 0 on success,
+ * -1 on error.
+ */
+static int
+_pyi_forkserver_receive_request(int fd, struct _PYI_FORKSERVER_REQUEST_HEADER *header, int *std_fds, char **payload_ref)
+{
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(3 * sizeof(int))];
+    } control;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    ssize_t count;
+    char *payload;
+    uint32_t num_strings;
+    uint32_t i;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = header;
+    iov.iov_len = sizeof(*header);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    do {
+        count = recvmsg(fd, &msg, 0);
+    } while (count < 0 && errno == EINTR);
+    if (count != (ssize_t)sizeof(*header)) {
+        return -1;
+    }
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+        return -1;
+    }
+    memcpy(std_fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+
+    if (header->magic != _PYI_FORKSERVER_MAGIC || header->argc == 0 || header->payload_length == 0 || header->payload_length > _PYI_FORKSERVER_MAX_PAYLOAD_LENGTH) {
+        return -1;
+    }
+
+    payload = (char *)malloc(header->payload_length);
+    if (payload == NULL) {
+        return -1;
+    }
+    if (_pyi_forkserver_read_all(fd, payload, header->payload_length) < 0) {
+        free(payload);
+        return -1;
+    }
+
+    /* The payload must consist of exactly the announced number of
+     * NUL-terminated strings. */
+    num_strings = 0;
+    for (i = 0; i < header->payload_length; i++) {
+        if (payload[i] == 0) {
+            num_strings++;
+        }
+    }
+    if (payload[header->payload_length - 1] != 0 || num_strings != 1 + header->argc + header->envc) {
+        free(payload);
+        return -1;
+    }
+
+    *payload_ref = payload;
+    return 0;
+}
+
+/*
+ * Check if the environment entry belongs to the variables that the
+ * application process keeps from the server's environment.
+ */
+static bool
+_pyi_forkserver_is_server_variable(const char *entry)
+{
+    static const char *names[] = {
+        "LD_LIBRARY_PATH=",
+        "LD_LIBRARY_PATH_ORIG=",
+        "LIBPATH=",
+        "LIBPATH_ORIG=",
+    };
+    size_t i;
+
+    if (strncmp(entry, "_PYI_", 5) == 0) {
+        return true;
+    }
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strncmp(entry, names[i], strlen(names[i])) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Set the os.environ item from an environment entry (NAME=VALUE); the
+ * entry is modified in-place. */
+static int
+_pyi_forkserver_set_environ_item(const struct DYLIB_PYTHON *dylib_python, PyObject *setitem, char *entry)
+{
+    PyObject *name;
+    PyObject *value;
+    PyObject *result = NULL;
+    char *separator;
+
+    separator = strchr(entry, '=');
+    if (separator == NULL || separator == entry) {
+        return 0; /* Ignore malformed entries */
+    }
+    *separator = 0;
+
+    name = dylib_python->PyUnicode_DecodeFSDefault(entry);
+    value = dylib_python->PyUnicode_DecodeFSDefault(separator + 1);
+    if (name && value) {
+        result = dylib_python->PyObject_CallFunctionObjArgs(setitem, name, value, NULL);
+    }
+    if (name) {
+        dylib_python->Py_DecRef(name);
+    }
+    if (value) {
+        dylib_python->Py_DecRef(value);
+    }
+    if (result == NULL) {
+        return -1;
+    }
+    dylib_python->Py_DecRef(result);
+
+    return 0;
+}
+
+/*
+ * Replace the environment (os.environ, which also updates the process
+ * environment) with the client's environment, keeping the server's
+ * values of the variables managed by the bootloader.
+ */
+static int
+_pyi_forkserver_apply_environment(const struct DYLIB_PYTHON *dylib_python, char **entries, uint32_t num_entries)
+{
+    PyObject *os_module = NULL;
+    PyObject *os_environ = NULL;
+    PyObject *setitem = NULL;
+    PyObject *result;
+    char **server_entries;
+    size_t num_server_entries = 0;
+    char **env;
+    size_t i;
+    int rc = -1;
+
+    /* Copy the server's values before os.environ is cleared. */
+    for (env = environ; *env; env++) {
+        num_server_entries++;
+    }
+    server_entries = (char **)calloc(num_server_entries + 1, sizeof(char *));
+    if (server_entries == NULL) {
+        return -1;
+    }
+    num_server_entries = 0;
+    for (env = environ; *env; env++) {
+        if (_pyi_forkserver_is_server_variable(*env)) {
+            server_entries[num_server_entries] = strdup(*env);
+            if (server_entries[num_server_entries] == NULL) {
+                goto cleanup;
+            }
+            num_server_entries++;
+        }
+    }
+
+    os_module = dylib_python->PyImport_ImportModule("os");
+    if (os_module == NULL) {
+        goto cleanup;
+    }
+    os_environ = dylib_python->PyObject_GetAttrString(os_module, "environ");
+    if (os_environ == NULL) {
+        goto cleanup;
+    }
+
+    setitem = dylib_python->PyObject_GetAttrString(os_environ, "clear");
+    if (setitem == NULL) {
+        goto cleanup;
+    }
+    result = dylib_python->PyObject_CallFunctionObjArgs(setitem, NULL);
+    dylib_python->Py_DecRef(setitem);
+    setitem = NULL;
+    if (result == NULL) {
+        goto cleanup;
+    }
+    dylib_python->Py_DecRef(result);
+
+    setitem = dylib_python->PyObject_GetAttrString(os_environ, "__setitem__");
+    if (setitem == NULL) {
+        goto cleanup;
+    }
+    for (i = 0; i < num_entries; i++) {
+        if (_pyi_forkserver_is_server_variable(entries[i])) {
+            continue;
+        }
+        if (_pyi_forkserver_set_environ_item(dylib_python, setitem, entries[i]) < 0) {
+            goto cleanup;
+        }
+    }
+    for (i = 0; i < num_server_entries; i++) {
+        if (_pyi_forkserver_set_environ_item(dylib_python, setitem, server_entries[i]) < 0) {
+            goto cleanup;
+        }
+    }
+
+    rc = 0;
+
+cleanup:
+    if (setitem) {
+        dylib_python->Py_DecRef(setitem);
+    }
+    if (os_environ) {
+        dylib_python->Py_DecRef(os_environ);
+    }
+    if (os_module) {
+        dylib_python->Py_DecRef(os_module);
+    }
+    for (i = 0; i < num_server_entries; i++) {
+        free(server_entries[i]);
+    }
+    free(server_entries);
+
+    return rc;
+}
+
+/* Replace the contents of sys.argv with the client's arguments. */
+static int
+_pyi_forkserver_apply_arguments(const struct DYLIB_PYTHON *dylib_python, char **arguments, uint32_t num_arguments)
+{
+    PyObject *sys_argv;
+    PyObject *clear;
+    PyObject *result;
+    PyObject *item;
+    uint32_t i;
+
+    sys_argv = dylib_python->PySys_GetObject("argv"); /* Borrowed reference */
+    if (sys_argv == NULL) {
+        return -1;
+    }
+
+    clear = dylib_python->PyObject_GetAttrString(sys_argv, "clear");
+    if (clear == NULL) {
+        return -1;
+    }
+    result = dylib_python->PyObject_CallFunctionObjArgs(clear, NULL);
+    dylib_python->Py_DecRef(clear);
+    if (result == NULL) {
+        return -1;
+    }
+    dylib_python->Py_DecRef(result);
+
+    for (i = 0; i < num_arguments; i++) {
+        item = dylib_python->PyUnicode_DecodeFSDefault(arguments[i]);
+        if (item == NULL) {
+            return -1;
+        }
+        if (dylib_python->PyList_Append(sys_argv, item) < 0) {
+            dylib_python->Py_DecRef(item);
+            return -1;
+        }
+        dylib_python->Py_DecRef(item);
+    }
+
+    return 0;
+}
+
+/*
+ * In the application process, take over the client's standard file
+ * descriptors, working directory, arguments and environment.
+ */
+static int
+_pyi_forkserver_apply_request(struct PYI_CONTEXT *pyi_ctx, const struct _PYI_FORKSERVER_REQUEST_HEADER *header, const int *std_fds, char *payload)
+{
+    const struct DYLIB_PYTHON *dylib_python = pyi_ctx->dylib_python;
+    char **strings;
+    char *ptr;
+    uint32_t num_strings = 1 + header->argc + header->envc;
+    uint32_t i;
+    int fd;
+
+    dylib_python->PyOS_AfterFork_Child();
+
+    for (fd = 0; fd < 3; fd++) {
+        if (std_fds[fd] != fd) {
+            dup2(std_fds[fd], fd);
+            close(std_fds[fd]);
+        }
+    }
+
+    /* Split the payload into strings; the array is kept for the
+     * lifetime of the process, as it becomes pyi_ctx->argv. */
+    strings = (char **)calloc(num_strings + 1, sizeof(char *));
+    if (strings == NULL) {
+        return -1;
+    }
+    ptr = payload;
+    for (i = 0; i < num_strings; i++) {
+        strings[i] = ptr;
+        ptr += strlen(ptr) + 1;
+    }
+
+    if (chdir(strings[0]) < 0) {
+        PYI_WARNING("Fork server: failed to change working directory to %s!\n", strings[0]);
+    }
+
+    /* NULL-terminate the arguments (overwriting the pointer to the first
+     * environment entry, which is kept in `ptr`). */
+    ptr = strings[1 + header->argc];
+    strings[1 + header->argc] = NULL;
+    pyi_ctx->argc = (int)header->argc;
+    pyi_ctx->argv = strings + 1;
+    if (_pyi_forkserver_apply_arguments(dylib_python, strings + 1, header->argc) < 0) {
+        PYI_ERROR("Fork server: failed to set sys.argv!\n");
+        dylib_python->PyErr_Print();
+        return -1;
+    }
+    strings[1 + header->argc] = ptr;
+
+    if (_pyi_forkserver_apply_environment(dylib_python, strings + 1 + header->argc, header->envc) < 0) {
+        PYI_ERROR("Fork server: failed to set environment!\n");
+        dylib_python->PyErr_Print();
+        return -1;
+    }
+    strings[1 + header->argc] = NULL;
+
+    /* The server's standard streams were not connected to a terminal;
+     * re-apply the line buffering of interactive streams. */
+    dylib_python->PyRun_SimpleStringFlags(
+        "import sys as _pyi_sys\n"
+        "for _pyi_stream in (_pyi_sys.stdout, _pyi_sys.stderr):\n"
+        "    try:\n"
+        "        _pyi_stream.reconfigure(line_buffering=_pyi_stream.isatty())\n"
+        "    except Exception:\n"
+        "        pass\n"
+        "del _pyi_sys, _pyi_stream\n",
+        NULL
+    );
+
+    return 0;
+}
+
+/*
+ * Handle the connection in the handler process: receive the request,
+ * fork the application process, and report its PID and exit status to
+ * the client. Returns 1 in the application process, 0 in the handler
+ * process once the application has exited, and -1 on error.
+ */
+static int
+_pyi_forkserver_handle_connection(struct PYI_CONTEXT *pyi_ctx, int conn_fd)
+{
+    struct _PYI_FORKSERVER_REQUEST_HEADER header;
+    int std_fds[3];
+    char *payload;
+    int32_t value;
+    int status;
+    pid_t pid;
+    int fd;
+
+    /* The server ignores SIGCHLD to have the handler processes reaped
+     * automatically; we need to wait for the application process. */
+    signal(SIGCHLD, SIG_DFL);
+
+    if (_pyi_forkserver_check_peer(conn_fd) < 0) {
+        return -1;
+    }
+
+    _pyi_forkserver_set_receive_timeout(conn_fd, _PYI_FORKSERVER_REQUEST_TIMEOUT);
+    if (_pyi_forkserver_receive_request(conn_fd, &header, std_fds, &payload) < 0) {
+        return -1;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+    if (pid == 0) {
+        close(conn_fd);
+        if (_pyi_forkserver_apply_request(pyi_ctx, &header, std_fds, payload) < 0) {
+            return -1;
+        }
+        return 1;
+    }
+
+    for (fd = 0; fd < 3; fd++) {
+        close(std_fds[fd]);
+    }
+    free(payload);
+
+    value = (int32_t)pid;
+    _pyi_forkserver_write_all(conn_fd, &value, sizeof(value));
+
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            status = 1 << 8; /* Exit code 1 */
+            break;
+        }
+    }
+
+    value = (int32_t)status;
+    _pyi_forkserver_write_all(conn_fd, &value, sizeof(value));
+    close(conn_fd);
+
+    return 0;
+}
+
+/* Import the modules listed in `pyi-fork-server-warm-module` options. */
+static void
+_pyi_forkserver_import_warm_modules(const struct PYI_CONTEXT *pyi_ctx)
+{
+    const struct DYLIB_PYTHON *dylib_python = pyi_ctx->dylib_python;
+    const struct TOC_ENTRY *const *toc_entries;
+    const char *entry_name;
+    PyObject *module;
+    size_t num_entries;
+    size_t i;
+
+    toc_entries = pyi_archive_get_toc_group(pyi_ctx->archive, ARCHIVE_TOC_GROUP_OPTIONS, &num_entries);
+    for (i = 0; i < num_entries; i++) {
+        entry_name = pyi_archive_get_entry_name(toc_entries[i]);
+        if (strncmp(entry_name, "pyi-fork-server-warm-module", 27) != 0) {
+            continue;
+        }
+
+        PYI_DEBUG("LOADER: fork server: importing warm module %s\n", entry_name + 28);
+        module = dylib_python->PyImport_ImportModule(entry_name + 28);
+        if (module == NULL) {
+            PYI_DEBUG("LOADER: fork server: failed to import warm module %s!\n", entry_name + 28);
+            dylib_python->PyErr_Clear();
+            continue;
+        }
+        dylib_python->Py_DecRef(module);
+    }
+}
+
+
+/**********************************************************************\
+ *                                API                                 *
+\**********************************************************************/
+/*
+ * Set up the fork server functionality; called once the process level
+ * is known. In the entry-point process, try to delegate the launch to the
+ * running server, or start the server if it is not running. In the main
+ * process of the server, store the socket path for pyi_forkserver_serve().
+ *
+ * Returns 0 if the launch was delegated to the server (and the exit code
+ * of the application is stored in `exit_code`), and -1 if the launch
+ * should proceed as usual.
+ */
+int
+pyi_forkserver_setup(struct PYI_CONTEXT *pyi_ctx, int *exit_code)
+{
+    char socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    char *env_var_value;
+    int rc;
+
+    /* Are we (a process of) the server that is being started? */
+    env_var_value = pyi_getenv(_PYI_FORKSERVER_ENV_VAR);
+    if (env_var_value) {
+        if (pyi_ctx->process_level == PYI_PROCESS_LEVEL_MAIN) {
+            PYI_DEBUG("LOADER: fork server: this is the main process of the server (socket: %s).\n", env_var_value);
+            snprintf(pyi_ctx->fork_server_socket, PYI_PATH_MAX, "%s", env_var_value);
+            pyi_unsetenv(_PYI_FORKSERVER_ENV_VAR);
+        }
+        free(env_var_value);
+        return -1;
+    }
+
+    /* Only the entry-point process delegates the launch. */
+    if (pyi_ctx->parent_process_level != PYI_PROCESS_LEVEL_UNKNOWN) {
+        return -1;
+    }
+
+    if (_pyi_forkserver_format_socket_path(pyi_ctx, socket_path, sizeof(socket_path)) < 0) {
+        PYI_DEBUG("LOADER: fork server: could not determine the socket path.\n");
+        return -1;
+    }
+
+    rc = _pyi_forkserver_delegate(pyi_ctx, socket_path, exit_code);
+    if (rc == 0) {
+        return 0;
+    }
+    if (rc > 0) {
+        _pyi_forkserver_start_server(pyi_ctx, socket_path);
+    }
+
+    return -1;
+}
+
+/*
+ * Run the server loop in the main process of the server; called once the
+ * bootstrap script has been run. Returns 1 in the forked application
+ * process, which should proceed with running the program's scripts, 0
+ * once the server exits, and -1 on error.
+ */
+int
+pyi_forkserver_serve(struct PYI_CONTEXT *pyi_ctx)
+{
+    const struct DYLIB_PYTHON *dylib_python = pyi_ctx->dylib_python;
+    char lock_path[PYI_PATH_MAX];
+    struct sockaddr_un addr;
+    struct pollfd poll_fd;
+    int timeout;
+    int lock_fd;
+    int listen_fd = -1;
+    int conn_fd;
+    int rc = -1;
+    pid_t pid;
+
+    _pyi_forkserver_import_warm_modules(pyi_ctx);
+
+    /* The prefetch thread would not survive fork(). */
+    pyi_pyz_prefetch_stop(pyi_ctx);
+
+    /* Only one server may listen on the socket; the lock is held for
+     * the lifetime of the server. */
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", pyi_ctx->fork_server_socket) >= (int)sizeof(addr.sun_path)) {
+        return -1;
+    }
+    if (snprintf(lock_path, PYI_PATH_MAX, "%s.lock", addr.sun_path) >= PYI_PATH_MAX) {
+        return -1;
+    }
+    lock_fd = open(lock_path, O_RDWR | O_CREAT, 0600);
+    if (lock_fd < 0) {
+        PYI_DEBUG("LOADER: fork server: failed to open lock file %s (errno %d)!\n", lock_path, errno);
+        return -1;
+    }
+    fcntl(lock_fd, F_SETFD, FD_CLOEXEC);
+    if (flock(lock_fd, LOCK_EX | LOCK_NB) < 0) {
+        PYI_DEBUG("LOADER: fork server: another server is already running.\n");
+        close(lock_fd);
+        return 0;
+    }
+
+    /* Remove the stale socket of a previous server, if any. */
+    unlink(pyi_ctx->fork_server_socket);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        goto cleanup;
+    }
+    fcntl(listen_fd, F_SETFD, FD_CLOEXEC);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+        PYI_DEBUG("LOADER: fork server: failed to listen on %s (errno %d)!\n", pyi_ctx->fork_server_socket, errno);
+        goto cleanup;
+    }
+
+    /* Have the exited handler processes reaped automatically. */
+    signal(SIGCHLD, SIG_IGN);
+
+    timeout = pyi_ctx->fork_server_idle_timeout < INT_MAX / 1000 ? (int)pyi_ctx->fork_server_idle_timeout * 1000 : INT_MAX;
+    PYI_DEBUG("LOADER: fork server: listening on %s (idle timeout: %d ms)...\n", pyi_ctx->fork_server_socket, timeout);
+
+    while (1) {
+        poll_fd.fd = listen_fd;
+        poll_fd.events = POLLIN;
+        poll_fd.revents = 0;
+
+        rc = poll(&poll_fd, 1, timeout);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            rc = -1;
+            break;
+        }
+        if (rc == 0) {
+            PYI_DEBUG("LOADER: fork server: idle timeout expired.\n");
+            break;
+        }
+
+        conn_fd = accept(listen_fd, NULL, NULL);
+        if (conn_fd < 0) {
+            continue;
+        }
+
+        dylib_python->PyOS_BeforeFork();
+        pid = fork();
+        if (pid == 0) {
+            /* Handler process; the python interpreter is left alone
+             * (without PyOS_AfterFork_Child()), as it is used only in
+             * the application process that is forked from here. */
+            close(listen_fd);
+            close(lock_fd);
+            rc = _pyi_forkserver_handle_connection(pyi_ctx, conn_fd);
+            if (rc == 1) {
+                return 1; /* Application process */
+            }
+            _exit(rc == 0 ? 0 : 1);
+        }
+        dylib_python->PyOS_AfterFork_Parent();
+        close(conn_fd);
+    }
+
+    /* Idle timeout or error; use the return code of the loop, with the
+     * idle timeout mapped to 0. */
+    rc = rc < 0 ? -1 : 0;
+
+cleanup:
+    signal(SIGCHLD, SIG_DFL);
+    unlink(pyi_ctx->fork_server_socket);
+    if (listen_fd >= 0) {
+        close(listen_fd);
+    }
+    close(lock_fd);
+
+    return rc;
+}
+
+#else
+
+/* Stubs for platforms without fork server support. */
+int
+pyi_forkserver_setup(struct PYI_CONTEXT *pyi_ctx, int *exit_code)
+{
+    (void)pyi_ctx;
+    (void)exit_code;
+    return -1;
+}
+
+int
+pyi_forkserver_serve(struct PYI_CONTEXT *pyi_ctx)
+{
+    (void)pyi_ctx;
+    return -1;
+}
+
+#endif /* defined(PYI_FORKSERVER_AVAILABLE) */
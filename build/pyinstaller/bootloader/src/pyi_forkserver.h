@@ -0,0 +1,38 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Resident fork server for repeated launches of the same program.
+ */
+
+#ifndef PYI_FORKSERVER_H
+#define PYI_FORKSERVER_H
+
+#include "pyi_global.h"
+
+struct PYI_CONTEXT;
+
+/* The fork server requires fork() without exec() in a process with
+ * initialized python interpreter; this is unavailable on Windows, and
+ * unsafe on macOS (Objective-C run-time and system frameworks). */
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__CYGWIN__)
+    #define PYI_FORKSERVER_AVAILABLE 1
+#endif
+
+/* Default time (in seconds) after which an idle fork server exits. */
+#define PYI_FORKSERVER_DEFAULT_IDLE_TIMEOUT (30 * 60)
+
+int pyi_forkserver_setup(struct PYI_CONTEXT *pyi_ctx, int *exit_code);
+int pyi_forkserver_serve(struct PYI_CONTEXT *pyi_ctx);
+
+#endif /* PYI_FORKSERVER_H */
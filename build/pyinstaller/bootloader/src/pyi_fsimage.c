@@ -0,0 +1,228 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Embedded read-only filesystem image of onefile applications (Linux).
+ *
+ * Instead of individual extractable entries, the PKG archive of a onefile
+ * application can contain a single squashfs image (ARCHIVE_ITEM_FSIMAGE
+ * entry) that holds the whole application directory tree. The image is
+ * stored uncompressed in the archive (the image compresses its data
+ * blocks on its own), so it can be used directly from the executable,
+ * at the image's offset.
+ *
+ * The onefile parent process mounts the image on the application's
+ * temporary directory using squashfuse, which is an unprivileged FUSE
+ * file system; the kernel's squashfs and EROFS drivers cannot be mounted
+ * from an unprivileged user namespace, and would not be visible to
+ * processes outside of it. The cost of the startup is then the cost of
+ * the mount, instead of decompressing and writing the whole tree; the
+ * data is decompressed on access, and the clean-up unmounts the image
+ * instead of recursively removing the directory.
+ *
+ * If the image cannot be mounted (squashfuse is not installed, or FUSE
+ * is not available), the image is unpacked into the temporary directory
+ * using unsquashfs, after which the application directory is handled
+ * in the same way as that of a regular onefile application.
+ */
+
+#if defined(__linux__)
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <inttypes.h>
+    #include <spawn.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+    extern char **environ;
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+/* PyInstaller headers. */
+#include "pyi_fsimage.h"
+#include "pyi_global.h"
+#include "pyi_archive.h"
+#include "pyi_main.h"
+#include "pyi_trace.h"
+
+
+#if defined(__linux__)
+
+/*
+ * Run the given program (looked up in PATH) with the given arguments,
+ * and wait for it to exit. In release builds, its output is discarded,
+ * as failures are handled by falling back to the next method. Returns
+ * 0 if the program exited successfully, and -1 otherwise.
+ */
+static int
+_pyi_fsimage_run(char *const argv[])
+{
+    posix_spawn_file_actions_t file_actions;
+    pid_t pid;
+    int status;
+    int rc;
+
+    rc = posix_spawn_file_actions_init(&file_actions);
+    if (rc != 0) {
+        PYI_DEBUG("LOADER: fsimage: posix_spawn_file_actions_init failed: %s\n", strerror(rc));
+        return -1;
+    }
+#if !defined(LAUNCH_DEBUG)
+    posix_spawn_file_actions_addopen(&file_actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&file_actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+#endif
+
+    rc = posix_spawnp(&pid, argv[0], &file_actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&file_actions);
+    if (rc != 0) {
+        PYI_DEBUG("LOADER: fsimage: could not run %s: %s\n", argv[0], strerror(rc));
+        return -1;
+    }
+
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            PYI_DEBUG("LOADER: fsimage: failed to wait for %s: %s\n", argv[0], strerror(errno));
+            return -1;
+        }
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        PYI_DEBUG("LOADER: fsimage: %s failed (status %d)!\n", argv[0], status);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Make the filesystem image from the archive available in the
+ * application's top-level directory (which must exist, and be empty);
+ * either by mounting it, or, if that is not possible, by unpacking it.
+ * Returns 0 on success, and -1 on error.
+ */
+int
+pyi_fsimage_setup(struct PYI_CONTEXT *pyi_ctx)
+{
+    const struct ARCHIVE *archive = pyi_ctx->archive;
+    const struct TOC_ENTRY *toc_entry = archive->toc_fsimage;
+    char offset_option[64];
+    char offset_value[32];
+    int rc;
+
+    if (toc_entry->compression_flag != ARCHIVE_COMPRESSION_NONE) {
+        PYI_ERROR("Filesystem image must be stored uncompressed!\n");
+        return -1;
+    }
+
+    /* Offset of the image within the archive file */
+    snprintf(offset_value, sizeof(offset_value), "%" PRIu64, archive->pkg_offset + toc_entry->offset);
+    snprintf(offset_option, sizeof(offset_option), "offset=%s", offset_value);
+
+    /* squashfuse daemonizes once the image is mounted. */
+    {
+        char *argv[] = {
+            "squashfuse",
+            "-o",
+            offset_option,
+            pyi_ctx->archive_filename,
+            pyi_ctx->application_home_dir,
+            NULL
+        };
+
+        PYI_DEBUG("LOADER: fsimage: mounting filesystem image (offset %s) on %s...\n", offset_value, pyi_ctx->application_home_dir);
+        pyi_trace_begin("fsimage_mount", NULL);
+        rc = _pyi_fsimage_run(argv);
+        pyi_trace_end("fsimage_mount");
+        if (rc == 0) {
+            pyi_ctx->fsimage_state = PYI_FSIMAGE_MOUNTED;
+            return 0;
+        }
+    }
+
+    /* Fall back to unpacking the image; the directory already exists,
+     * hence the -f (force) flag. */
+    {
+        char *argv[] = {
+            "unsquashfs",
+            "-no-progress",
+            "-f",
+            "-o",
+            offset_value,
+            "-d",
+            pyi_ctx->application_home_dir,
+            pyi_ctx->archive_filename,
+            NULL
+        };
+
+        PYI_DEBUG("LOADER: fsimage: failed to mount filesystem image; unpacking it instead...\n");
+        pyi_trace_begin("fsimage_unpack", NULL);
+        rc = _pyi_fsimage_run(argv);
+        pyi_trace_end("fsimage_unpack");
+        if (rc == 0) {
+            pyi_ctx->fsimage_state = PYI_FSIMAGE_UNPACKED;
+            return 0;
+        }
+    }
+
+    PYI_ERROR("Failed to mount or unpack the embedded filesystem image; squashfuse (or unsquashfs) is required to run this program.\n");
+    return -1;
+}
+
+/*
+ * Unmount the filesystem image, if it was mounted. The lazy unmount
+ * detaches the file system even if some of its files are still in use
+ * (for example, by processes that the program left running), and lets
+ * the top-level directory be removed right away. Returns 0 on success,
+ * and -1 on error.
+ */
+int
+pyi_fsimage_cleanup(struct PYI_CONTEXT *pyi_ctx)
+{
+    if (pyi_ctx->fsimage_state != PYI_FSIMAGE_MOUNTED) {
+        return 0;
+    }
+
+    {
+        char *argv3[] = { "fusermount3", "-u", "-z", pyi_ctx->application_home_dir, NULL };
+        char *argv2[] = { "fusermount", "-u", "-z", pyi_ctx->application_home_dir, NULL };
+
+        PYI_DEBUG("LOADER: fsimage: unmounting filesystem image from %s...\n", pyi_ctx->application_home_dir);
+        if (_pyi_fsimage_run(argv3) < 0 && _pyi_fsimage_run(argv2) < 0) {
+            PYI_WARNING("Failed to unmount the filesystem image from %s!\n", pyi_ctx->application_home_dir);
+            return -1;
+        }
+    }
+
+    pyi_ctx->fsimage_state = PYI_FSIMAGE_NONE;
+    return 0;
+}
+
+#else /* defined(__linux__) */
+
+int
+pyi_fsimage_setup(struct PYI_CONTEXT *pyi_ctx)
+{
+    (void)pyi_ctx;
+    PYI_ERROR("Embedded filesystem images are supported only on Linux!\n");
+    return -1;
+}
+
+int
+pyi_fsimage_cleanup(struct PYI_CONTEXT *pyi_ctx)
+{
+    (void)pyi_ctx;
+    return 0;
+}
+
+#endif /* defined(__linux__) */
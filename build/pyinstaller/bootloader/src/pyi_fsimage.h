@@ -0,0 +1,28 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Embedded read-only filesystem image of onefile applications.
+ */
+
+#ifndef PYI_FSIMAGE_H
+#define PYI_FSIMAGE_H
+
+#include "pyi_global.h"
+
+struct PYI_CONTEXT;
+
+int pyi_fsimage_setup(struct PYI_CONTEXT *pyi_ctx);
+int pyi_fsimage_cleanup(struct PYI_CONTEXT *pyi_ctx);
+
+#endif /* PYI_FSIMAGE_H */
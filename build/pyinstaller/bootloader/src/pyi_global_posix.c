@@ -34,6 +34,7 @@
 #endif
 
 /* PyInstaller headers. */
+#include "pyi_debuglog.h"
 #include "pyi_utils.h"
 
 
@@ -54,6 +55,19 @@
 #define PYI_MESSAGE_LEN 4096
 
 
+/* Write a formatted message to stderr (and to syslog). */
+static void
+_pyi_output_message(const char *message_buffer)
+{
+    /* Write to stderr */
+    fprintf(stderr, "%s", message_buffer);
+
+    /* Write to syslog */
+#if defined(__APPLE__) && defined(WINDOWED)
+    syslog(LOG_NOTICE, "%s", message_buffer);
+#endif
+}
+
 /* Print a formatted debug/warning/error message to stderr. */
 static void
 _pyi_debug_printf(const char *severity, const char *fmt, va_list args)
@@ -63,6 +77,10 @@ _pyi_debug_printf(const char *severity, const char *fmt, va_list args)
     int buflen = PYI_MESSAGE_LEN;
     int ret;
 
+    /* Write out the buffered debug messages first, so that they are
+     * not displayed after the messages that they preceded. */
+    pyi_debuglog_flush();
+
     /* Prefix: [PYI-{PID}:{SEVERITY}]. */
     ret = snprintf(msg_ptr, buflen, "[PYI-%d:%s] ", getpid(), severity);
     if (ret >= 0) {
@@ -76,13 +94,7 @@ _pyi_debug_printf(const char *severity, const char *fmt, va_list args)
     /* Formatted message */
     vsnprintf(msg_ptr, buflen, fmt, args);
 
-    /* Write to stderr */
-    fprintf(stderr, "%s", message_buffer);
-
-    /* Write to syslog */
-#if defined(__APPLE__) && defined(WINDOWED)
-    syslog(LOG_NOTICE, "%s", message_buffer);
-#endif
+    _pyi_output_message(message_buffer);
 }
 
 
@@ -92,11 +104,27 @@ _pyi_debug_printf(const char *severity, const char *fmt, va_list args)
 void pyi_debug_message(const char *fmt, ...)
 {
     va_list args;
+    int rc;
+
+    /* Record the message into the buffered debug log, if enabled */
+    va_start(args, fmt);
+    rc = pyi_debuglog_record(fmt, args);
+    va_end(args);
+    if (rc == 0) {
+        return;
+    }
+
     va_start(args, fmt);
     _pyi_debug_printf("DEBUG", fmt, args);
     va_end(args);
 }
 
+/* Used by the buffered debug log. */
+void pyi_debug_output_message(const char *message)
+{
+    _pyi_output_message(message);
+}
+
 #endif /* defined(LAUNCH_DEBUG) */
 
 /* Used by PYI_WARNING macro. */
@@ -131,6 +159,8 @@ pyi_perror_message(const char *funcname, int error_code, const char *fmt, ...)
 
     va_list args;
 
+    pyi_debuglog_flush();
+
     /* Prefix: [PYI-{PID}:{SEVERITY}]. */
     ret = snprintf(msg_ptr, buflen, "[PYI-%d:ERROR] ", getpid());
     if (ret >= 0) {
@@ -157,13 +187,7 @@ pyi_perror_message(const char *funcname, int error_code, const char *fmt, ...)
     /* Function name and error message (perror equivalent) */
     snprintf(msg_ptr, buflen, "%s: %s\n", funcname, strerror(error_code));
 
-    /* Write to stderr */
-    fprintf(stderr, "%s", message_buffer);
-
-    /* Write to syslog */
-#if defined(__APPLE__) && defined(WINDOWED)
-    syslog(LOG_NOTICE, "%s", message_buffer);
-#endif
+    _pyi_output_message(message_buffer);
 }
 
 
@@ -31,6 +31,7 @@
 #include <io.h>
 
 /* PyInstaller headers. */
+#include "pyi_debuglog.h"
 #include "pyi_utils.h"
 
 
@@ -58,6 +59,10 @@ _pyi_format_message_utf8(char *message_buffer, const char *severity, const char
     int prefix_len = 0;
     int ret;
 
+    /* Write out the buffered debug messages first, so that they are
+     * not displayed after the messages that they preceded. */
+    pyi_debuglog_flush();
+
     /* Prefix: [PYI-{PID}:{SEVERITY}]. */
     ret = snprintf(msg_ptr, buflen, "[PYI-%d:%s] ", _getpid(), severity);
     if (ret >= 0) {
@@ -83,6 +88,10 @@ _pyi_format_message_w(wchar_t *message_buffer, const wchar_t *severity, const wc
     int prefix_len = 0;
     int ret;
 
+    /* Write out the buffered debug messages first, so that they are
+     * not displayed after the messages that they preceded. */
+    pyi_debuglog_flush();
+
     /* Prefix: [PYI-{PID}:{SEVERITY}]. */
     ret = _snwprintf(msg_ptr, buflen, L"[PYI-%d:%ls] ", _getpid(), severity);
     if (ret >= 0) {
@@ -108,6 +117,10 @@ _pyi_format_perror_message_utf8(char *message_buffer, const char *funcname, int
     int prefix_len = 0;
     int ret;
 
+    /* Write out the buffered debug messages first, so that they are
+     * not displayed after the messages that they preceded. */
+    pyi_debuglog_flush();
+
     /* Prefix: [PYI-{PID}:{SEVERITY}]. */
     ret = snprintf(msg_ptr, buflen, "[PYI-%d:ERROR] ", _getpid());
     if (ret >= 0) {
@@ -143,6 +156,10 @@ _pyi_format_perror_message_w(wchar_t *message_buffer, const wchar_t *funcname, i
     int prefix_len = 0;
     int ret;
 
+    /* Write out the buffered debug messages first, so that they are
+     * not displayed after the messages that they preceded. */
+    pyi_debuglog_flush();
+
     /* Prefix: [PYI-{PID}:{SEVERITY}]. */
     ret = _snwprintf(msg_ptr, buflen, L"[PYI-%d:ERROR] ", _getpid());
     if (ret >= 0) {
@@ -178,6 +195,10 @@ _pyi_format_winerror_message_w(wchar_t *message_buffer, const wchar_t *funcname,
     int prefix_len = 0;
     int ret;
 
+    /* Write out the buffered debug messages first, so that they are
+     * not displayed after the messages that they preceded. */
+    pyi_debuglog_flush();
+
     /* Prefix: [PYI-{PID}:{SEVERITY}]. */
     ret = _snwprintf(msg_ptr, buflen, L"[PYI-%d:ERROR] ", _getpid());
     if (ret >= 0) {
@@ -283,15 +304,9 @@ _pyi_output_message_utf8(const char *message_buffer_utf8, int prefix_length, con
 #if defined(LAUNCH_DEBUG)
 
 void
-pyi_debug_message(const char *fmt, ...)
+pyi_debug_output_message(const char *message_buffer_utf8)
 {
-    char message_buffer_utf8[PYI_MESSAGE_LEN];
     wchar_t message_buffer[PYI_MESSAGE_LEN];
-    va_list args;
-
-    va_start(args, fmt);
-    _pyi_format_message_utf8(message_buffer_utf8, "DEBUG", fmt, args);
-    va_end(args);
 
     /* Convert UTF-8 message to wide-char */
     if (pyi_win32_utf8_to_wcs(message_buffer_utf8, message_buffer, PYI_MESSAGE_LEN)) {
@@ -304,6 +319,28 @@ pyi_debug_message(const char *fmt, ...)
     }
 }
 
+void
+pyi_debug_message(const char *fmt, ...)
+{
+    char message_buffer_utf8[PYI_MESSAGE_LEN];
+    va_list args;
+    int rc;
+
+    /* Record the message into the buffered debug log, if enabled */
+    va_start(args, fmt);
+    rc = pyi_debuglog_record(fmt, args);
+    va_end(args);
+    if (rc == 0) {
+        return;
+    }
+
+    va_start(args, fmt);
+    _pyi_format_message_utf8(message_buffer_utf8, "DEBUG", fmt, args);
+    va_end(args);
+
+    pyi_debug_output_message(message_buffer_utf8);
+}
+
 #endif
 
 void
@@ -502,6 +539,15 @@ void pyi_debug_message(const char *fmt, ...)
 {
     char message_buffer[PYI_MESSAGE_LEN];
     va_list args;
+    int rc;
+
+    /* Record the message into the buffered debug log, if enabled */
+    va_start(args, fmt);
+    rc = pyi_debuglog_record(fmt, args);
+    va_end(args);
+    if (rc == 0) {
+        return;
+    }
 
     va_start(args, fmt);
     _pyi_format_message_utf8(message_buffer, "DEBUG", fmt, args);
@@ -510,6 +556,12 @@ void pyi_debug_message(const char *fmt, ...)
     _pyi_output_message_utf8(message_buffer);
 }
 
+/* Used by the buffered debug log. */
+void pyi_debug_output_message(const char *message)
+{
+    _pyi_output_message_utf8(message);
+}
+
 #endif /* defined(LAUNCH_DEBUG) */
 
 /* Used by PYI_WARNING macro. */
@@ -17,9 +17,13 @@
 
 #ifdef _WIN32
     #include <windows.h>
+    #include <process.h>  /* _getpid */
 #else
-    #include <stdlib.h>   /* malloc */
+    #include <unistd.h>   /* getpid */
+    #include <sys/resource.h> /* getrlimit */
 #endif
+#include <stdio.h>    /* rename, remove */
+#include <stdlib.h>   /* malloc, calloc */
 #include <string.h>   /* memset */
 #include <stddef.h>   /* ptrdiff_t */
 
@@ -31,135 +35,1368 @@
 #include "pyi_main.h"
 #include "pyi_utils.h"
 #include "pyi_splash.h"
+#include "pyi_stats.h"
 #include "pyi_dylib_python.h"
 #include "pyi_python.h"
+#include "pyi_pyconfig.h"
+#include "pyi_pyz_prefetch.h"
 #include "pyi_exception_dialog.h"
 #include "pyi_multipkg.h"
+#include "pyi_thread.h"
+#include "pyi_trace.h"
+#include "pyi_extractor.h"
+#include "pyi_forkserver.h"
+
+
+/*
+ * Parallel extraction worker pool.
+ *
+ * The main thread walks the TOC, performs all checks and creates the
+ * parent directory structure, and then submits the decode+write jobs
+ * into a bounded queue that is serviced by the pool of worker threads.
+ * Jobs that need to observe strict ordering (i.e., symbolic links,
+ * which may point to files and directories created by the preceding
+ * entries) act as barriers; the main thread waits for all pending jobs
+ * to finish, and then processes them itself. MERGE dependencies are
+ * also processed by the main thread, because the multi-package archive
+ * pool is not thread-safe.
+ */
+#if PYI_HAVE_THREADS
+
+/* Number of job slots in the bounded job queue. */
+#define _PYI_EXTRACT_QUEUE_SIZE 64
+
+struct _PYI_EXTRACT_JOB
+{
+    const struct TOC_ENTRY *toc_entry;
+    char output_filename[PYI_PATH_MAX];
+};
+
+struct _PYI_EXTRACT_POOL
+{
+    const struct ARCHIVE *archive;
+
+    pyi_thread_t threads[PYI_LAUNCH_MAX_EXTRACTION_THREADS];
+    int num_threads;
+
+    /* Mutex protecting all fields below */
+    pyi_mutex_t mutex;
+
+    /* Signalled when a job is added to the queue, or on shutdown */
+    pyi_cond_t job_available;
+    /* Signalled when a job is removed from the queue or completed */
+    pyi_cond_t job_done;
+
+    /* Circular job queue */
+    struct _PYI_EXTRACT_JOB *queue;
+    int queue_head;
+    int queue_count;
+
+    /* Number of jobs that are currently being processed by workers */
+    int busy_count;
+
+    /* Flag indicating that one of the jobs failed */
+    bool failed;
+    /* Flag indicating that the workers should exit */
+    bool shutdown;
+};
+
+static PYI_THREAD_PROC_TYPE
+_pyi_launch_extract_worker(void *arg)
+{
+    struct _PYI_EXTRACT_POOL *pool = (struct _PYI_EXTRACT_POOL *)arg;
+    const struct TOC_ENTRY *toc_entry;
+    char output_filename[PYI_PATH_MAX];
+    struct ARCHIVE_SESSION *session;
+    struct PYI_EXTRACTOR *extractor = NULL;
+    int num_async_jobs = 0;
+    bool submitted;
+    int rc;
+
+    /* Each worker uses its own extraction session; if it cannot be
+     * allocated, each entry is extracted with a temporary one. */
+    session = pyi_archive_session_new(0);
+
+    /* If available, the file operations are performed asynchronously
+     * (via io_uring on Linux, and overlapped I/O on Windows); see
+     * pyi_extractor_posix.c and pyi_extractor_win32.c. */
+    if (session) {
+        extractor = pyi_extractor_new();
+    }
+
+    pyi_mutex_lock(&pool->mutex);
+    while (1) {
+        /* Before going idle, wait for the jobs whose file operations are
+         * still in flight; the jobs count as busy until then, so that
+         * the barriers wait for them as well. */
+        if (pool->queue_count == 0 && num_async_jobs > 0) {
+            pyi_mutex_unlock(&pool->mutex);
+            rc = pyi_extractor_flush(extractor);
+            pyi_mutex_lock(&pool->mutex);
+            pool->busy_count -= num_async_jobs;
+            num_async_jobs = 0;
+            if (rc != 0) {
+                pool->failed = true;
+            }
+            pyi_cond_broadcast(&pool->job_done);
+            continue;
+        }
+
+        /* Wait for a job (or shutdown signal) */
+        while (pool->queue_count == 0 && !pool->shutdown) {
+            pyi_cond_wait(&pool->job_available, &pool->mutex);
+        }
+        if (pool->queue_count == 0) {
+            break; /* Shutdown, and no more jobs */
+        }
+
+        /* Pop the job from the queue */
+        toc_entry = pool->queue[pool->queue_head].toc_entry;
+        memcpy(output_filename, pool->queue[pool->queue_head].output_filename, PYI_PATH_MAX);
+        pool->queue_head = (pool->queue_head + 1) % _PYI_EXTRACT_QUEUE_SIZE;
+        pool->queue_count--;
+
+        /* If one of previous jobs failed, discard the remaining ones */
+        if (pool->failed) {
+            pyi_cond_broadcast(&pool->job_done);
+            continue;
+        }
+
+        pool->busy_count++;
+        pyi_mutex_unlock(&pool->mutex);
+
+        /* Extract */
+        pyi_trace_begin("extract", pyi_archive_get_entry_name(toc_entry));
+        rc = 1;
+        if (extractor) {
+            rc = pyi_extractor_submit(extractor, session, pool->archive, toc_entry, output_filename);
+        }
+        submitted = rc == 0;
+        if (rc == 1) {
+            if (session) {
+                rc = pyi_archive_session_extract2fs(session, pool->archive, toc_entry, output_filename);
+            } else {
+                rc = pyi_archive_extract2fs(pool->archive, toc_entry, output_filename);
+            }
+        }
+        pyi_trace_end("extract");
+        if (rc != 0) {
+            PYI_ERROR("Failed to extract entry: %s.\n", pyi_archive_get_entry_name(toc_entry));
+        }
+
+        pyi_mutex_lock(&pool->mutex);
+        /* Asynchronously extracted jobs are completed by the flush above */
+        if (submitted) {
+            num_async_jobs++;
+        } else {
+            pool->busy_count--;
+        }
+        if (rc != 0) {
+            pool->failed = true;
+        }
+        pyi_cond_broadcast(&pool->job_done);
+    }
+    pyi_mutex_unlock(&pool->mutex);
+
+    pyi_extractor_free(&extractor);
+    pyi_archive_session_free(&session);
+
+    PYI_THREAD_PROC_RETURN;
+}
+
+/*
+ * Wait for all submitted jobs to finish. Returns 0 if all jobs
+ * succeeded, -1 if any of them failed.
+ */
+static int
+_pyi_launch_extract_pool_drain(struct _PYI_EXTRACT_POOL *pool)
+{
+    int rc;
+
+    pyi_mutex_lock(&pool->mutex);
+    while (pool->queue_count > 0 || pool->busy_count > 0) {
+        pyi_cond_wait(&pool->job_done, &pool->mutex);
+    }
+    rc = pool->failed ? -1 : 0;
+    pyi_mutex_unlock(&pool->mutex);
+
+    return rc;
+}
+
+/*
+ * Submit an extraction job into the queue. Blocks while the queue is
+ * full. Returns -1 if any of previously submitted jobs failed (in
+ * which case the job is not submitted), 0 otherwise.
+ */
+static int
+_pyi_launch_extract_pool_submit(struct _PYI_EXTRACT_POOL *pool, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+{
+    struct _PYI_EXTRACT_JOB *job;
+
+    pyi_mutex_lock(&pool->mutex);
+    while (pool->queue_count == _PYI_EXTRACT_QUEUE_SIZE && !pool->failed) {
+        pyi_cond_wait(&pool->job_done, &pool->mutex);
+    }
+    if (pool->failed) {
+        pyi_mutex_unlock(&pool->mutex);
+        return -1;
+    }
+
+    job = &pool->queue[(pool->queue_head + pool->queue_count) % _PYI_EXTRACT_QUEUE_SIZE];
+    job->toc_entry = toc_entry;
+    snprintf(job->output_filename, PYI_PATH_MAX, "%s", output_filename);
+    pool->queue_count++;
+
+    pyi_cond_signal(&pool->job_available);
+    pyi_mutex_unlock(&pool->mutex);
+
+    return 0;
+}
+
+/*
+ * Stop the worker threads and free the pool. Pending jobs are processed
+ * before the workers exit. Returns 0 if all jobs succeeded, -1 otherwise.
+ */
+static int
+_pyi_launch_extract_pool_free(struct _PYI_EXTRACT_POOL **pool_ref)
+{
+    struct _PYI_EXTRACT_POOL *pool = *pool_ref;
+    int index;
+    int rc = 0;
+
+    *pool_ref = NULL;
+
+    if (pool == NULL) {
+        return 0;
+    }
+
+    /* Signal shutdown to workers, and join them */
+    pyi_mutex_lock(&pool->mutex);
+    pool->shutdown = true;
+    pyi_cond_broadcast(&pool->job_available);
+    pyi_mutex_unlock(&pool->mutex);
+
+    for (index = 0; index < pool->num_threads; index++) {
+        pyi_thread_join(pool->threads[index]);
+    }
+    rc = pool->failed ? -1 : 0;
+
+    pyi_cond_destroy(&pool->job_done);
+    pyi_cond_destroy(&pool->job_available);
+    pyi_mutex_destroy(&pool->mutex);
+
+    free(pool->queue);
+    free(pool);
+
+    return rc;
+}
+
+/*
+ * Create the extraction pool with specified number of worker threads.
+ * Returns NULL on failure, in which case the caller should fall back
+ * to serial extraction.
+ */
+static struct _PYI_EXTRACT_POOL *
+_pyi_launch_extract_pool_new(const struct ARCHIVE *archive, int num_threads)
+{
+    struct _PYI_EXTRACT_POOL *pool;
+
+    pool = (struct _PYI_EXTRACT_POOL *)calloc(1, sizeof(struct _PYI_EXTRACT_POOL));
+    if (pool == NULL) {
+        PYI_PERROR("calloc", "Could not allocate memory for extraction pool.\n");
+        return NULL;
+    }
+
+    pool->queue = (struct _PYI_EXTRACT_JOB *)malloc(_PYI_EXTRACT_QUEUE_SIZE * sizeof(struct _PYI_EXTRACT_JOB));
+    if (pool->queue == NULL) {
+        PYI_PERROR("malloc", "Could not allocate memory for extraction job queue.\n");
+        free(pool);
+        return NULL;
+    }
+
+    pool->archive = archive;
+
+    if (pyi_mutex_init(&pool->mutex) < 0) {
+        free(pool->queue);
+        free(pool);
+        return NULL;
+    }
+    pyi_cond_init(&pool->job_available);
+    pyi_cond_init(&pool->job_done);
+
+    /* Start worker threads; if we fail to start a thread, continue
+     * with the ones that we already have. */
+    for (pool->num_threads = 0; pool->num_threads < num_threads; pool->num_threads++) {
+        if (pyi_thread_create(&pool->threads[pool->num_threads], _pyi_launch_extract_worker, pool) < 0) {
+            break;
+        }
+    }
+    if (pool->num_threads == 0) {
+        _pyi_launch_extract_pool_free(&pool);
+        return NULL;
+    }
+
+    PYI_DEBUG("LOADER: started %d extraction worker thread(s).\n", pool->num_threads);
+
+    return pool;
+}
+
+#endif /* PYI_HAVE_THREADS */
+
+
+/*
+ * Extraction of binaries into memory-backed files (Linux only).
+ *
+ * If enabled via `pyi-memfd-binaries` run-time option, the binaries
+ * (type 'b') are extracted into anonymous memory-backed files created
+ * with memfd_create(), instead of being written to the application's
+ * temporary directory. In their place, symbolic links to corresponding
+ * /proc/self/fd/N paths are created, so that the binaries can still be
+ * found (by python's import system, by the dynamic linker's $ORIGIN
+ * based search, and by dlopen() of python shared library) at their
+ * usual locations. The file descriptors are inherited by the child
+ * process, where they retain their numbers, and thus the links remain
+ * valid there. Because the data never reaches the filesystem, this
+ * also works if the temporary directory is on a `noexec` mount.
+ *
+ * Processes that are spawned from the application with inherited file
+ * descriptors closed (e.g., multiprocessing workers using `spawn` start
+ * method) cannot load the binaries from the application's directory
+ * anymore; therefore, the mode is opt-in. It is not used together with
+ * the persistent extraction cache, which must outlive the process.
+ */
+#if defined(__linux__)
+
+/* Determine how many binaries can be extracted into memory-backed
+ * files; 0 if the mode is disabled or not available. */
+static int
+_pyi_launch_memfd_budget(const struct PYI_CONTEXT *pyi_ctx)
+{
+    struct rlimit limit;
+    int budget = PYI_LAUNCH_MEMFD_MAX_BINARIES;
+
+    if (!pyi_ctx->memfd_binaries || pyi_ctx->use_extraction_cache) {
+        return 0;
+    }
+
+    /* The /proc/self/fd paths require procfs */
+    if (access("/proc/self/fd", X_OK) != 0) {
+        PYI_DEBUG("LOADER: /proc/self/fd is not available; binaries are extracted to filesystem.\n");
+        return 0;
+    }
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur / 4 < (rlim_t)budget) {
+        budget = (int)(limit.rlim_cur / 4);
+    }
+
+    return budget;
+}
+
+/*
+ * Extract the binary into a memory-backed file, and create symbolic link
+ * to it at the given output filename. Returns 0 on success, 1 if the
+ * memory-backed file could not be created (in which case the caller
+ * should extract the binary to the filesystem), and -1 on error.
+ */
+static int
+_pyi_launch_extract_to_memfd(struct ARCHIVE_SESSION *session, const struct ARCHIVE *archive, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+{
+    const char *entry_name = pyi_archive_get_entry_name(toc_entry);
+    const char *basename;
+    char link_target[64];
+    FILE *out_fp;
+    int fd;
+    int out_fd;
+    int rc;
+
+    /* The name is used only for debugging purposes (it is shown in
+     * /proc/self/maps and /proc/self/fd listings) */
+    basename = strrchr(entry_name, PYI_SEP);
+    basename = basename ? basename + 1 : entry_name;
+
+    fd = pyi_utils_create_memfd(basename);
+    if (fd < 0) {
+        PYI_DEBUG("LOADER: could not create memory-backed file for %s; extracting it to filesystem.\n", entry_name);
+        return 1;
+    }
+
+    /* Write via a duplicate of the descriptor, which is closed together
+     * with the stream */
+    out_fd = dup(fd);
+    out_fp = out_fd >= 0 ? fdopen(out_fd, "wb") : NULL;
+    if (out_fp == NULL) {
+        PYI_PERROR("fdopen", "Failed to extract %s: failed to open memory-backed file!\n", entry_name);
+        if (out_fd >= 0) {
+            close(out_fd);
+        }
+        close(fd);
+        return -1;
+    }
+    rc = pyi_archive_session_extract2fp(session, archive, toc_entry, out_fp);
+    if (fclose(out_fp) != 0) {
+        rc = -1;
+    }
+    if (rc < 0) {
+        close(fd);
+        return -1;
+    }
+    pyi_utils_seal_memfd(fd);
+
+    /* Create the symbolic link; the descriptor remains open for the
+     * lifetime of the process (and its child) */
+    snprintf(link_target, sizeof(link_target), "/proc/self/fd/%d", fd);
+    if (pyi_path_mksymlink(link_target, output_filename) < 0) {
+        PYI_PERROR("symlink", "Failed to extract %s: failed to create symbolic link to memory-backed file!\n", entry_name);
+        close(fd);
+        return -1;
+    }
+    pyi_stats_add(&global_pyi_ctx->stats.files_created, 1);
+
+    PYI_DEBUG("LOADER: extracted %s into memory-backed file (fd %d).\n", entry_name, fd);
+    return 0;
+}
+
+#endif /* defined(__linux__) */
+
+
+/*
+ * Find the canonical entry of the given alias entry: the extractable
+ * binary or data entry with the same data fields. Returns NULL if no
+ * such entry exists.
+ */
+static const struct TOC_ENTRY *
+_pyi_launch_find_alias_canonical_entry(const struct TOC_ENTRY *const *toc_entries, size_t num_entries, const struct TOC_ENTRY *alias_entry)
+{
+    size_t i;
+
+    for (i = 0; i < num_entries; i++) {
+        const struct TOC_ENTRY *toc_entry = toc_entries[i];
+
+        if (toc_entry->typecode != ARCHIVE_ITEM_BINARY && toc_entry->typecode != ARCHIVE_ITEM_DATA) {
+            continue;
+        }
+        if (toc_entry->offset == alias_entry->offset && toc_entry->length == alias_entry->length && toc_entry->compression_flag == alias_entry->compression_flag) {
+            return toc_entry;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Create the files of alias entries (see ARCHIVE_ITEM_ALIAS) by cloning
+ * the extracted files of their canonical entries. Called after all other
+ * entries have been extracted (and their files written). If the canonical
+ * entry cannot be found, or its file cannot be cloned, the alias entry's
+ * (shared) data is extracted from the archive.
+ */
+static int
+_pyi_launch_extract_aliases(struct PYI_CONTEXT *pyi_ctx, struct ARCHIVE_SESSION *session, struct PYI_DIRECTORY_CACHE *directory_cache, const struct TOC_ENTRY *const *toc_entries, size_t num_entries)
+{
+    const struct TOC_ENTRY *toc_entry;
+    const struct TOC_ENTRY *canonical_entry;
+    const char *entry_filename;
+    char output_filename[PYI_PATH_MAX];
+    char canonical_filename[PYI_PATH_MAX];
+    size_t i;
+
+    for (i = 0; i < num_entries; i++) {
+        toc_entry = toc_entries[i];
+        if (toc_entry->typecode != ARCHIVE_ITEM_ALIAS) {
+            continue;
+        }
+        entry_filename = pyi_archive_get_entry_name(toc_entry);
+
+        if (snprintf(output_filename, PYI_PATH_MAX, "%s%c%s", pyi_ctx->application_home_dir, PYI_SEP, entry_filename) >= PYI_PATH_MAX) {
+            PYI_ERROR("Extraction path length exceeds maximum path length!\n");
+            return -1;
+        }
+
+        /* Check if file already exists (it should not) */
+        if (pyi_path_exists(output_filename) == 1) {
+            if (pyi_ctx->splash && pyi_splash_is_splash_requirement(pyi_ctx->splash, entry_filename) == 1) {
+                continue;
+            } else if (pyi_ctx->strict_unpack_mode) {
+                PYI_ERROR("File already exists but should not: %s\n", output_filename);
+                return -1;
+            } else {
+                PYI_WARNING("File already exists but should not: %s\n", output_filename);
+            }
+        }
+
+        if (pyi_create_parent_directory_tree(pyi_ctx, directory_cache, pyi_ctx->application_home_dir, entry_filename) < 0) {
+            PYI_ERROR("Failed to create parent directory structure.\n");
+            return -1;
+        }
+
+        pyi_trace_begin("extract", entry_filename);
+
+        canonical_entry = _pyi_launch_find_alias_canonical_entry(toc_entries, num_entries, toc_entry);
+        if (canonical_entry != NULL &&
+            snprintf(canonical_filename, PYI_PATH_MAX, "%s%c%s", pyi_ctx->application_home_dir, PYI_SEP, pyi_archive_get_entry_name(canonical_entry)) < PYI_PATH_MAX &&
+            pyi_clone_file(canonical_filename, output_filename) == 0) {
+            PYI_DEBUG("LOADER: created %s as a clone of %s.\n", entry_filename, pyi_archive_get_entry_name(canonical_entry));
+            pyi_stats_add(&global_pyi_ctx->stats.files_created, 1);
+        } else if (pyi_archive_session_extract2fs(session, pyi_ctx->archive, toc_entry, output_filename) < 0) {
+            pyi_trace_end("extract");
+            PYI_ERROR("Failed to extract entry: %s.\n", entry_filename);
+            return -1;
+        }
+
+        pyi_trace_end("extract");
+    }
+
+    return 0;
+}
 
 
 /*
  * Extract all binaries (type 'b') and all data files (type 'x') to the filesystem
  * and checks for dependencies (type 'd'). If dependencies are found, extract them.
  *
- * 'Multipackage' feature includes dependencies. Dependencies are files in other
- * .exe files. Having files in other executables allows share binary files among
- * executables and thus reduce the final size of the executable.
+ * 'Multipackage' feature includes dependencies. Dependencies are files in other
+ * .exe files. Having files in other executables allows share binary files among
+ * executables and thus reduce the final size of the executable.
+ *
+ * If 'splash screen' feature is enabled, the text on splash screen will be updated
+ * during the extraction with the name of currently processed TOC entry, and the
+ * progress with the amount of data processed so far (based on the uncompressed
+ * lengths of entries, as recorded in the TOC).
+ *
+ * If multiple extraction threads are enabled, the decompression and writing of
+ * regular files is off-loaded to worker pool (see above). The function returns
+ * only after all workers have finished.
+ *
+ * Alias entries (type 'D') are created after all other entries have been
+ * extracted, by cloning the files of their canonical entries.
+ */
+int
+pyi_launch_extract_files_from_archive(struct PYI_CONTEXT *pyi_ctx)
+{
+    const struct ARCHIVE *archive = pyi_ctx->archive;
+    const struct TOC_ENTRY *const *toc_entries;
+    const struct TOC_ENTRY *toc_entry;
+    size_t num_entries;
+    size_t i;
+    ptrdiff_t index;
+    int retcode = 0;
+    char output_filename[PYI_PATH_MAX];
+
+    struct ARCHIVE *multipkg_archive_pool[PYI_MULTIPKG_ARCHIVE_POOL_SIZE];
+    char multipkg_ref[PYI_PATH_MAX];
+    char multipkg_name[PYI_PATH_MAX];
+
+    const char *entry_filename;
+
+    /* Whether there are alias entries to create after the extraction
+     * of regular entries. */
+    bool has_aliases = false;
+
+    /* Splash screen progress: the total and processed uncompressed length
+     * of the extractable entries. */
+    uint64_t progress_total = 0;
+    uint64_t progress_done = 0;
+
+    /* Directories created so far; if we fail to allocate the cache,
+     * the directories are created without it. */
+    struct PYI_DIRECTORY_CACHE *directory_cache;
+
+    /* Extraction session for the entries extracted by this thread */
+    struct ARCHIVE_SESSION *session;
+
+#if defined(__linux__)
+    /* Number of binaries that can still be extracted into memory-backed
+     * files (see above). */
+    int memfd_budget = _pyi_launch_memfd_budget(pyi_ctx);
+#endif
+
+#if PYI_HAVE_THREADS
+    struct _PYI_EXTRACT_POOL *extract_pool = NULL;
+#endif
+
+    /* Asynchronous extractor for the entries extracted by this thread,
+     * if they are not off-loaded to the worker pool. */
+    struct PYI_EXTRACTOR *extractor = NULL;
+
+    /* Start of the extraction phase, for run-time statistics */
+    uint64_t phase_start_time;
+
+    pyi_trace_begin("pyi_launch_extract_files_from_archive", NULL);
+    phase_start_time = pyi_stats_phase_begin();
+
+    directory_cache = pyi_directory_cache_new();
+
+    session = pyi_archive_session_new(0);
+    if (session == NULL) {
+        pyi_directory_cache_free(&directory_cache);
+        pyi_stats_phase_end(pyi_ctx, PYI_STATS_PHASE_EXTRACTION, phase_start_time);
+        pyi_trace_end("pyi_launch_extract_files_from_archive");
+        return -1;
+    }
+
+#if PYI_HAVE_THREADS
+    /* In strict unpack mode, extract serially, so that the detection
+     * of duplicated entries remains deterministic. */
+    if (pyi_ctx->extraction_threads > 1 && !pyi_ctx->strict_unpack_mode) {
+        extract_pool = _pyi_launch_extract_pool_new(archive, pyi_ctx->extraction_threads);
+    }
+#endif
+
+    /* Same as with the worker pool, strict unpack mode requires the
+     * files to be created synchronously. */
+    if (!pyi_ctx->strict_unpack_mode
+#if PYI_HAVE_THREADS
+        && extract_pool == NULL
+#endif
+    ) {
+        extractor = pyi_extractor_new();
+    }
+
+    /* Clear the archive pool array. */
+    memset(multipkg_archive_pool, 0, sizeof(multipkg_archive_pool));
+
+    toc_entries = pyi_archive_get_toc_group(archive, ARCHIVE_TOC_GROUP_EXTRACTABLE, &num_entries);
+
+    if (pyi_ctx->splash != NULL) {
+        for (i = 0; i < num_entries; i++) {
+            /* Lazily-extracted entries are not extracted here */
+            if (toc_entries[i]->typecode != ARCHIVE_ITEM_LAZY_DATA) {
+                progress_total += toc_entries[i]->uncompressed_length;
+            }
+        }
+        pyi_splash_update_progress(pyi_ctx->splash, 0, progress_total);
+    }
+
+    for (i = 0; i < num_entries; i++) {
+        toc_entry = toc_entries[i];
+        pyi_stats_add(&pyi_ctx->stats.toc_entries_processed, 1);
+
+        /* Determine the output filename; all entries in this group are
+         * extractable, except for lazily-extracted ones, which are
+         * handled separately. */
+        switch (toc_entry->typecode) {
+            /* Onefile mode */
+            case ARCHIVE_ITEM_BINARY:
+            case ARCHIVE_ITEM_DATA:
+            case ARCHIVE_ITEM_ZIPFILE:
+            case ARCHIVE_ITEM_SYMLINK: {
+                /* Entry name is the output filename */
+                entry_filename = pyi_archive_get_entry_name(toc_entry);
+                break;
+            }
+            /* Onefile mode, duplicate of another entry; created once all
+             * other entries are extracted (see below). */
+            case ARCHIVE_ITEM_ALIAS: {
+                has_aliases = true;
+                continue;
+            }
+            /* Onefile mode, lazily-extracted data file; only create its
+             * parent directory structure here, so that the directory
+             * layout is complete. The file itself is extracted when
+             * it is first accessed (see pyi_launch_extract_lazy_entry). */
+            case ARCHIVE_ITEM_LAZY_DATA: {
+                if (pyi_create_parent_directory_tree(pyi_ctx, directory_cache, pyi_ctx->application_home_dir, pyi_archive_get_entry_name(toc_entry)) == 0) {
+                    continue;
+                }
+                PYI_ERROR("Failed to create parent directory structure.\n");
+                retcode = -1;
+                break;
+            }
+            /* MERGE multi-package */
+            case ARCHIVE_ITEM_DEPENDENCY: {
+                /* Entry name is multi-package reference; split it */
+                if (pyi_multipkg_split_dependency_string(multipkg_ref, multipkg_name, pyi_archive_get_entry_name(toc_entry)) == -1) {
+                    retcode = -1;
+                }
+                entry_filename = multipkg_name;
+                break;
+            }
+            /* Not extractable; skip */
+            default: {
+                continue;
+            }
+        }
+
+        /* Break on errors in the above switch */
+        if (retcode != 0) {
+            break;
+        }
+
+        /* Update splash screen (display name of the currently-processed
+         * entry, and the amount of data processed before it). These only
+         * update the splash screen's status slot, which is cheap. */
+        if (pyi_ctx->splash != NULL) {
+            pyi_splash_update_text(pyi_ctx->splash, entry_filename);
+            pyi_splash_update_progress(pyi_ctx->splash, progress_done, progress_total);
+            progress_done += toc_entry->uncompressed_length;
+        }
+
+        /* Construct output filename */
+        if (snprintf(output_filename, PYI_PATH_MAX, "%s%c%s", pyi_ctx->application_home_dir, PYI_SEP, entry_filename) >= PYI_PATH_MAX) {
+            PYI_ERROR("Extraction path length exceeds maximum path length!\n");
+            retcode = -1;
+            break;
+        }
+
+#if PYI_HAVE_THREADS
+        /* Symbolic links act as barriers; all preceding entries need to
+         * be fully extracted before the link is created, and before its
+         * existence is checked for. */
+        if (extract_pool && toc_entry->typecode == ARCHIVE_ITEM_SYMLINK) {
+            if (_pyi_launch_extract_pool_drain(extract_pool) < 0) {
+                retcode = -1;
+                break;
+            }
+        }
+#endif
+        if (extractor && toc_entry->typecode == ARCHIVE_ITEM_SYMLINK) {
+            if (pyi_extractor_flush(extractor) < 0) {
+                retcode = -1;
+                break;
+            }
+        }
+
+        /* Check if file already exists (it should not) */
+        if (pyi_path_exists(output_filename) == 1) {
+            /* Check if file was a splash screen requirement */
+            if (pyi_ctx->splash && pyi_splash_is_splash_requirement(pyi_ctx->splash, entry_filename) == 1) {
+                /* This is splash requirement, so it is expected to exist.
+                 * Also, the file should be in use right now, so avoid
+                 * overwriting it. */
+                continue;
+            } else if (pyi_ctx->strict_unpack_mode) {
+                PYI_ERROR("File already exists but should not: %s\n", output_filename);
+                retcode = -1;
+                break;
+            } else {
+                PYI_WARNING("File already exists but should not: %s\n", output_filename);
+            }
+        }
+
+        /* Create parent directory tree */
+        if (pyi_create_parent_directory_tree(pyi_ctx, directory_cache, pyi_ctx->application_home_dir, entry_filename) < 0) {
+            PYI_ERROR("Failed to create parent directory structure.\n");
+            retcode = -1;
+            break;
+        }
+
+        /* Extract */
+        pyi_trace_begin("extract", pyi_archive_get_entry_name(toc_entry));
+#if defined(__linux__)
+        if (memfd_budget > 0 && toc_entry->typecode == ARCHIVE_ITEM_BINARY) {
+            retcode = _pyi_launch_extract_to_memfd(session, archive, toc_entry, output_filename);
+            if (retcode == 0) {
+                memfd_budget--;
+                pyi_trace_end("extract");
+                continue;
+            }
+            if (retcode < 0) {
+                pyi_trace_end("extract");
+                PYI_ERROR("Failed to extract entry: %s.\n", pyi_archive_get_entry_name(toc_entry));
+                break;
+            }
+            /* Not available; fall back to extraction to filesystem */
+            memfd_budget = 0;
+            retcode = 0;
+        }
+#endif
+        if (toc_entry->typecode == ARCHIVE_ITEM_DEPENDENCY) {
+            retcode = pyi_multipkg_extract_dependency(
+                pyi_ctx,
+                session,
+                multipkg_archive_pool,
+                multipkg_ref,
+                multipkg_name,
+                output_filename
+            );
+#if PYI_HAVE_THREADS
+        } else if (extract_pool && toc_entry->typecode != ARCHIVE_ITEM_SYMLINK && toc_entry->compression_flag != ARCHIVE_COMPRESSION_SOLID) {
+            /* Off-load to worker pool; the errors are reported by workers.
+             * Members of solid blocks are extracted by this thread, whose
+             * session decompresses each block only once. */
+            if (_pyi_launch_extract_pool_submit(extract_pool, toc_entry, output_filename) < 0) {
+                pyi_trace_end("extract");
+                retcode = -1;
+                break;
+            }
+#endif
+        } else {
+            retcode = 1;
+            if (extractor) {
+                retcode = pyi_extractor_submit(extractor, session, archive, toc_entry, output_filename);
+            }
+            if (retcode == 1) {
+                retcode = pyi_archive_session_extract2fs(session, archive, toc_entry, output_filename);
+            }
+        }
+        pyi_trace_end("extract");
+
+        /* If extraction failed, there is no need to continue. */
+        if (retcode != 0) {
+            PYI_ERROR("Failed to extract entry: %s.\n", pyi_archive_get_entry_name(toc_entry));
+            break;
+        }
+    }
+
+#if PYI_HAVE_THREADS
+    /* Wait for the workers to finish the remaining jobs */
+    if (_pyi_launch_extract_pool_free(&extract_pool) < 0) {
+        retcode = -1;
+    }
+#endif
+
+    /* Wait for the in-flight file operations to finish */
+    if (pyi_extractor_free(&extractor) < 0) {
+        retcode = -1;
+    }
+
+    /* Create the alias entries' files, now that the files of their
+     * canonical entries are complete. */
+    if (retcode == 0 && has_aliases) {
+        retcode = _pyi_launch_extract_aliases(pyi_ctx, session, directory_cache, toc_entries, num_entries);
+    }
+
+    /* Free memory allocated for archive pool. */
+    for (index = 0; multipkg_archive_pool[index] != NULL; index++) {
+        pyi_archive_free(&multipkg_archive_pool[index]);
+    }
+
+    if (pyi_ctx->splash != NULL && retcode == 0) {
+        pyi_splash_update_progress(pyi_ctx->splash, progress_total, progress_total);
+    }
+
+    pyi_archive_session_free(&session);
+    pyi_directory_cache_free(&directory_cache);
+
+    pyi_stats_phase_end(pyi_ctx, PYI_STATS_PHASE_EXTRACTION, phase_start_time);
+    pyi_trace_end("pyi_launch_extract_files_from_archive");
+
+    return retcode;
+}
+
+
+/*
+ * Cold archive (tiered archive).
+ *
+ * The data of lazily-extracted data files can be split off the main
+ * (embedded) archive into a separate PKG archive, the cold archive,
+ * which is placed next to the executable, and named by the
+ * `pyi-cold-archive` run-time option. This keeps the main archive
+ * small, so that it can be read in one go during the startup, while
+ * the large, rarely-used payloads cost nothing until they are used.
+ * The main archive still lists the cold entries (with the
+ * ARCHIVE_COMPRESSION_COLD flag and without data), so the directory
+ * structure and the lazy extraction look-ups need only the main
+ * archive. The cold archive is opened (and memory-mapped) only when
+ * the first of its entries is extracted, either on demand, or by the
+ * background extraction.
+ */
+struct PYI_COLD_ARCHIVE
+{
+    /* Full path to the cold archive file. */
+    char filename[PYI_PATH_MAX];
+
+    /* The opened archive; NULL until opened, or if opening failed. */
+    struct ARCHIVE *archive;
+
+    /* Set once the archive was opened (or attempted to be opened), so
+     * that a missing archive is reported only once. */
+    bool open_attempted;
+
+#if PYI_HAVE_THREADS
+    /* Mutex protecting the above fields; the entries are extracted
+     * from python threads, and from the background extraction thread. */
+    pyi_mutex_t mutex;
+#endif
+};
+
+/*
+ * Set up the cold archive state; the archive is looked up in the
+ * directory that contains the main archive.
+ */
+int
+pyi_launch_setup_cold_archive(struct PYI_CONTEXT *pyi_ctx)
+{
+    struct PYI_COLD_ARCHIVE *state;
+    char archive_dir[PYI_PATH_MAX];
+
+    state = (struct PYI_COLD_ARCHIVE *)calloc(1, sizeof(struct PYI_COLD_ARCHIVE));
+    if (state == NULL) {
+        PYI_PERROR("calloc", "Could not allocate memory for cold archive state.\n");
+        return -1;
+    }
+
+    if (!pyi_path_dirname(archive_dir, pyi_ctx->archive_filename) ||
+        pyi_path_join(state->filename, archive_dir, pyi_ctx->cold_archive_name) == NULL) {
+        PYI_ERROR("Path of cold archive exceeds maximum path length!\n");
+        free(state);
+        return -1;
+    }
+
+#if PYI_HAVE_THREADS
+    if (pyi_mutex_init(&state->mutex) < 0) {
+        free(state);
+        return -1;
+    }
+#endif
+
+    PYI_DEBUG("LOADER: cold archive file: %s\n", state->filename);
+    pyi_ctx->cold_archive = state;
+
+    return 0;
+}
+
+/*
+ * Close the cold archive (if it was opened), and free its state.
+ */
+void
+pyi_launch_cleanup_cold_archive(struct PYI_CONTEXT *pyi_ctx)
+{
+    struct PYI_COLD_ARCHIVE *state = pyi_ctx->cold_archive;
+
+    if (state == NULL) {
+        return;
+    }
+
+    pyi_archive_free(&state->archive);
+#if PYI_HAVE_THREADS
+    pyi_mutex_destroy(&state->mutex);
+#endif
+    free(state);
+
+    pyi_ctx->cold_archive = NULL;
+}
+
+/*
+ * Return the cold archive, opening it on the first call. Returns NULL
+ * if the program has no cold archive, or if it could not be opened.
+ */
+static const struct ARCHIVE *
+_pyi_launch_get_cold_archive(const struct PYI_CONTEXT *pyi_ctx)
+{
+    struct PYI_COLD_ARCHIVE *state = pyi_ctx->cold_archive;
+    const struct ARCHIVE *archive;
+
+    if (state == NULL) {
+        PYI_ERROR("Archive contains cold entries, but does not specify the cold archive!\n");
+        return NULL;
+    }
+
+#if PYI_HAVE_THREADS
+    pyi_mutex_lock(&state->mutex);
+#endif
+    if (!state->open_attempted) {
+        state->open_attempted = true;
+
+        PYI_DEBUG("LOADER: opening cold archive: %s\n", state->filename);
+        pyi_trace_begin("open_cold_archive", NULL);
+        state->archive = pyi_archive_open(state->filename);
+        pyi_trace_end("open_cold_archive");
+
+        if (state->archive == NULL) {
+            PYI_ERROR("Could not open the cold archive: %s\n", state->filename);
+        } else if (pyi_ctx->verify_checksums && pyi_archive_enable_checksums(state->archive) < 0) {
+            PYI_WARNING("LOADER: cold archive has no checksum table; extracted data will not be verified.\n");
+        }
+    }
+    archive = state->archive;
+#if PYI_HAVE_THREADS
+    pyi_mutex_unlock(&state->mutex);
+#endif
+
+    return archive;
+}
+
+/*
+ * Extract the given lazily-extracted data entry into the application's
+ * top-level directory. The entry is first extracted into a temporary
+ * file, which is then renamed into its final location, so that other
+ * threads or processes never observe a partially-written file. If the
+ * file was concurrently extracted by someone else, the temporary file
+ * is discarded.
+ */
+static int
+_pyi_launch_extract_lazy_entry(const struct PYI_CONTEXT *pyi_ctx, struct ARCHIVE_SESSION *session, const struct TOC_ENTRY *toc_entry, const char *output_filename)
+{
+    char temp_filename[PYI_PATH_MAX];
+    int rc;
+#ifdef _WIN32
+    wchar_t temp_filename_w[PYI_PATH_MAX];
+    wchar_t output_filename_w[PYI_PATH_MAX];
+    unsigned long pid = (unsigned long)_getpid();
+#else
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    const struct ARCHIVE *archive = pyi_ctx->archive;
+
+    /* The data of cold entries is stored in the cold archive, under
+     * the same name. */
+    if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_COLD) {
+        const char *name = pyi_archive_get_entry_name(toc_entry);
+
+        archive = _pyi_launch_get_cold_archive(pyi_ctx);
+        if (archive == NULL) {
+            return -1;
+        }
+        toc_entry = pyi_archive_find_entry_by_name(archive, name);
+        if (toc_entry == NULL || toc_entry->typecode != ARCHIVE_ITEM_LAZY_DATA || toc_entry->compression_flag == ARCHIVE_COMPRESSION_COLD) {
+            PYI_ERROR("Entry %s not found in the cold archive!\n", name);
+            return -1;
+        }
+    }
+
+    /* The address of a local variable makes the name unique among the
+     * threads of the process, and process ID among the processes. */
+    if (snprintf(temp_filename, PYI_PATH_MAX, "%s.pyi-%lu-%p", output_filename, pid, (void *)&rc) >= PYI_PATH_MAX) {
+        PYI_ERROR("Extraction path length exceeds maximum path length!\n");
+        return -1;
+    }
+
+    pyi_trace_begin("extract_lazy", pyi_archive_get_entry_name(toc_entry));
+    if (session) {
+        rc = pyi_archive_session_extract2fs(session, archive, toc_entry, temp_filename);
+    } else {
+        rc = pyi_archive_extract2fs(archive, toc_entry, temp_filename);
+    }
+    pyi_trace_end("extract_lazy");
+    if (rc < 0) {
+        remove(temp_filename);
+        return -1;
+    }
+
+#ifdef _WIN32
+    if (pyi_win32_utf8_to_wcs(temp_filename, temp_filename_w, PYI_PATH_MAX) == NULL ||
+        pyi_win32_utf8_to_wcs(output_filename, output_filename_w, PYI_PATH_MAX) == NULL) {
+        remove(temp_filename);
+        return -1;
+    }
+    if (!MoveFileExW(temp_filename_w, output_filename_w, 0)) {
+        DWORD error_code = GetLastError();
+        /* Extracted concurrently by another thread or process. */
+        if (error_code == ERROR_ALREADY_EXISTS || error_code == ERROR_FILE_EXISTS) {
+            DeleteFileW(temp_filename_w);
+            return 0;
+        }
+        PYI_WINERROR_W(L"MoveFileExW", L"Failed to move lazily-extracted file into place.\n");
+        DeleteFileW(temp_filename_w);
+        return -1;
+    }
+#else
+    /* On POSIX, rename() atomically replaces the file that might have
+     * been concurrently extracted by another thread or process; both
+     * have the same contents. */
+    if (rename(temp_filename, output_filename) < 0) {
+        PYI_PERROR("rename", "Failed to move lazily-extracted file into place.\n");
+        remove(temp_filename);
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+/*
+ * Ensure that the given lazily-extracted data entry is extracted.
+ * Returns 1 if the file was extracted or already exists, and -1 on
+ * error.
+ */
+static int
+_pyi_launch_ensure_lazy_entry(const struct PYI_CONTEXT *pyi_ctx, struct ARCHIVE_SESSION *session, const struct TOC_ENTRY *toc_entry)
+{
+    const char *name = pyi_archive_get_entry_name(toc_entry);
+    char output_filename[PYI_PATH_MAX];
+
+    if (snprintf(output_filename, PYI_PATH_MAX, "%s%c%s", pyi_ctx->application_home_dir, PYI_SEP, name) >= PYI_PATH_MAX) {
+        PYI_ERROR("Extraction path length exceeds maximum path length!\n");
+        return -1;
+    }
+
+    if (pyi_path_exists(output_filename) == 1) {
+        return 1;
+    }
+
+    PYI_DEBUG("LOADER: extracting lazily-extracted data file: %s\n", name);
+    if (_pyi_launch_extract_lazy_entry(pyi_ctx, session, toc_entry, output_filename) < 0) {
+        PYI_WARNING("Failed to extract lazily-extracted data file: %s\n", name);
+        return -1;
+    }
+
+    return 1;
+}
+
+/*
+ * Ensure that the lazily-extracted data entry ('X') with the given name
+ * (relative to the application's top-level directory) is extracted.
+ *
+ * Returns 1 if the file was extracted or already exists, 0 if the
+ * archive contains no lazily-extracted entry with such name, and -1 on
+ * error.
+ */
+int
+pyi_launch_extract_lazy_entry(const struct PYI_CONTEXT *pyi_ctx, const char *name)
+{
+    const struct TOC_ENTRY *toc_entry;
+
+    toc_entry = pyi_archive_find_entry_by_name(pyi_ctx->archive, name);
+    if (toc_entry == NULL || toc_entry->typecode != ARCHIVE_ITEM_LAZY_DATA) {
+        return 0;
+    }
+
+    return _pyi_launch_ensure_lazy_entry(pyi_ctx, NULL, toc_entry);
+}
+
+/*
+ * Read `length` bytes of the data of the lazily-extracted data entry
+ * ('X') with the given name (relative to the application's top-level
+ * directory), starting at the given offset, into the provided buffer,
+ * without extracting the file. The data of cold entries is read from
+ * the cold archive. For framed entries, only the frames that cover the
+ * range are decompressed (see pyi_archive_session_read_range()).
  *
- * If 'splash screen' feature is enabled, the text on splash screen will be updated
- * during the extraction with the name of currently processed TOC entry.
+ * Returns 1 if the data was read, 0 if the archive contains no
+ * lazily-extracted entry with such name, and -1 on error.
  */
 int
-pyi_launch_extract_files_from_archive(struct PYI_CONTEXT *pyi_ctx)
+pyi_launch_read_lazy_entry_range(const struct PYI_CONTEXT *pyi_ctx, const char *name, uint64_t offset, void *buffer, size_t length)
 {
     const struct ARCHIVE *archive = pyi_ctx->archive;
     const struct TOC_ENTRY *toc_entry;
-    ptrdiff_t index;
-    int retcode = 0;
-    char output_filename[PYI_PATH_MAX];
 
-    struct ARCHIVE *multipkg_archive_pool[PYI_MULTIPKG_ARCHIVE_POOL_SIZE];
-    char multipkg_ref[PYI_PATH_MAX];
-    char multipkg_name[PYI_PATH_MAX];
+    toc_entry = pyi_archive_find_entry_by_name(archive, name);
+    if (toc_entry == NULL || toc_entry->typecode != ARCHIVE_ITEM_LAZY_DATA) {
+        return 0;
+    }
 
-    const char *entry_filename;
+    if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_COLD) {
+        archive = _pyi_launch_get_cold_archive(pyi_ctx);
+        if (archive == NULL) {
+            return -1;
+        }
+        toc_entry = pyi_archive_find_entry_by_name(archive, name);
+        if (toc_entry == NULL || toc_entry->typecode != ARCHIVE_ITEM_LAZY_DATA || toc_entry->compression_flag == ARCHIVE_COMPRESSION_COLD) {
+            PYI_ERROR("Entry %s not found in the cold archive!\n", name);
+            return -1;
+        }
+    }
 
-    /* Clear the archive pool array. */
-    memset(multipkg_archive_pool, 0, sizeof(multipkg_archive_pool));
+    pyi_trace_begin("read_lazy_range", name);
+    if (pyi_archive_read_range(archive, toc_entry, offset, buffer, length) < 0) {
+        pyi_trace_end("read_lazy_range");
+        return -1;
+    }
+    pyi_trace_end("read_lazy_range");
 
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-        /* Check if entry is extractable */
-        switch (toc_entry->typecode) {
-            /* Onefile mode */
-            case ARCHIVE_ITEM_BINARY:
-            case ARCHIVE_ITEM_DATA:
-            case ARCHIVE_ITEM_ZIPFILE:
-            case ARCHIVE_ITEM_SYMLINK: {
-                /* toc_entry->name is the output filename */
-                entry_filename = toc_entry->name;
-                break;
-            }
-            /* MERGE multi-package */
-            case ARCHIVE_ITEM_DEPENDENCY: {
-                /* toc_entry->name is multi-package reference; split it */
-                if (pyi_multipkg_split_dependency_string(multipkg_ref, multipkg_name, toc_entry->name) == -1) {
-                    retcode = -1;
-                }
-                entry_filename = multipkg_name;
-                break;
-            }
-            /* Not extractable; skip */
-            default: {
-                continue;
-            }
-        }
+    return 1;
+}
 
-        /* Break on errors in the above switch */
-        if (retcode != 0) {
-            break;
-        }
+/*
+ * Extract all lazily-extracted data entries that are placed directly
+ * in the given directory (relative to the application's top-level
+ * directory; empty string denotes the top-level directory itself).
+ * Used to ensure that listing the directory yields complete results.
+ *
+ * Returns the number of entries in the directory that are now available
+ * (including the ones that were already extracted), or -1 on error.
+ */
+int
+pyi_launch_extract_lazy_directory(const struct PYI_CONTEXT *pyi_ctx, const char *name)
+{
+    const struct ARCHIVE *archive = pyi_ctx->archive;
+    const struct TOC_ENTRY *const *toc_entries;
+    const struct TOC_ENTRY *toc_entry;
+    size_t num_entries;
+    size_t i;
+    size_t name_len = strlen(name);
+    struct ARCHIVE_SESSION *session;
+    int count = 0;
 
-        /* Update splash screen (display name of the currently-processed entry) */
-        if (pyi_ctx->splash != NULL) {
-            pyi_splash_update_text(pyi_ctx->splash, entry_filename);
-        }
+    /* Ignore trailing separator */
+    if (name_len > 0 && name[name_len - 1] == PYI_SEP) {
+        name_len--;
+    }
 
-        /* Construct output filename */
-        if (snprintf(output_filename, PYI_PATH_MAX, "%s%c%s", pyi_ctx->application_home_dir, PYI_SEP, entry_filename) >= PYI_PATH_MAX) {
-            PYI_ERROR("Extraction path length exceeds maximum path length!\n");
-            retcode = -1;
-            break;
-        }
+    /* Shared by all entries in the directory; if it cannot be allocated,
+     * each entry is extracted with a temporary one. */
+    session = pyi_archive_session_new(0);
 
-        /* Check if file already exists (it should not) */
-        if (pyi_path_exists(output_filename) == 1) {
-            /* Check if file was a splash screen requirement */
-            if (pyi_ctx->splash && pyi_splash_is_splash_requirement(pyi_ctx->splash, entry_filename) == 1) {
-                /* This is splash requirement, so it is expected to exist.
-                 * Also, the file should be in use right now, so avoid
-                 * overwriting it. */
+    toc_entries = pyi_archive_get_toc_group(archive, ARCHIVE_TOC_GROUP_LAZY_DATA, &num_entries);
+    for (i = 0; i < num_entries; i++) {
+        const char *entry_name;
+        const char *basename;
+
+        toc_entry = toc_entries[i];
+
+        /* Match the directory prefix */
+        entry_name = pyi_archive_get_entry_name(toc_entry);
+        if (name_len > 0) {
+            if (strncmp(entry_name, name, name_len) != 0 || entry_name[name_len] != PYI_SEP) {
                 continue;
-            } else if (pyi_ctx->strict_unpack_mode) {
-                PYI_ERROR("File already exists but should not: %s\n", output_filename);
-                retcode = -1;
-                break;
-            } else {
-                PYI_WARNING("File already exists but should not: %s\n", output_filename);
             }
+            basename = entry_name + name_len + 1;
+        } else {
+            basename = entry_name;
         }
 
-        /* Create parent directory tree */
-        if (pyi_create_parent_directory_tree(pyi_ctx, pyi_ctx->application_home_dir, entry_filename) < 0) {
-            PYI_ERROR("Failed to create parent directory structure.\n");
-            retcode = -1;
-            break;
+        /* Only direct children; sub-directories are processed when they
+         * are listed themselves. */
+        if (strchr(basename, PYI_SEP) != NULL) {
+            continue;
         }
 
-        /* Extract */
-        if (toc_entry->typecode == ARCHIVE_ITEM_DEPENDENCY) {
-            retcode = pyi_multipkg_extract_dependency(
-                pyi_ctx,
-                multipkg_archive_pool,
-                multipkg_ref,
-                multipkg_name,
-                output_filename
-            );
-        } else {
-            retcode = pyi_archive_extract2fs(archive, toc_entry, output_filename);
+        if (_pyi_launch_ensure_lazy_entry(pyi_ctx, session, toc_entry) < 0) {
+            count = -1;
+            break;
         }
+        count++;
+    }
 
-        /* If extraction failed, there is no need to continue. */
-        if (retcode != 0) {
-            PYI_ERROR("Failed to extract entry: %s.\n", toc_entry->name);
+    pyi_archive_session_free(&session);
+
+    return count;
+}
+
+
+/*
+ * Background extraction of lazily-extracted data files (onefile mode).
+ *
+ * If enabled, the onefile parent process extracts the lazily-extracted
+ * data files in a background thread while the child process starts
+ * up and runs the program, so that the extraction of data files
+ * overlaps with the interpreter initialization and the imports. The
+ * files that are required before the child is started (binaries,
+ * symbolic links, and data files that are read by native code) are
+ * extracted up-front by pyi_launch_extract_files_from_archive(). If the
+ * program accesses a data file that has not been extracted yet, the
+ * child extracts it on demand (with same atomic temporary-file-and-
+ * rename approach), so it never needs to wait for the parent.
+ */
+#if PYI_HAVE_THREADS
+
+struct PYI_BACKGROUND_EXTRACTION
+{
+    const struct PYI_CONTEXT *pyi_ctx;
+    pyi_thread_t thread;
+
+    /* Mutex protecting the flag below */
+    pyi_mutex_t mutex;
+    /* Flag indicating that the extraction should be stopped */
+    bool cancelled;
+};
+
+static PYI_THREAD_PROC_TYPE
+_pyi_launch_background_extraction_worker(void *arg)
+{
+    struct PYI_BACKGROUND_EXTRACTION *state = (struct PYI_BACKGROUND_EXTRACTION *)arg;
+    const struct ARCHIVE *archive = state->pyi_ctx->archive;
+    const struct TOC_ENTRY *const *toc_entries;
+    size_t num_entries;
+    size_t i;
+    struct ARCHIVE_SESSION *session;
+    bool cancelled = false;
+
+    pyi_trace_begin("background_extraction", NULL);
+
+    session = pyi_archive_session_new(0);
+
+    toc_entries = pyi_archive_get_toc_group(archive, ARCHIVE_TOC_GROUP_LAZY_DATA, &num_entries);
+    for (i = 0; i < num_entries; i++) {
+        pyi_mutex_lock(&state->mutex);
+        cancelled = state->cancelled;
+        pyi_mutex_unlock(&state->mutex);
+        if (cancelled) {
             break;
         }
+
+        /* Errors are not fatal; the child process attempts to extract
+         * the file again when it is accessed. */
+        _pyi_launch_ensure_lazy_entry(state->pyi_ctx, session, toc_entries[i]);
     }
 
-    /* Free memory allocated for archive pool. */
-    for (index = 0; multipkg_archive_pool[index] != NULL; index++) {
-        pyi_archive_free(&multipkg_archive_pool[index]);
+    pyi_archive_session_free(&session);
+
+    pyi_trace_end("background_extraction");
+
+    PYI_DEBUG("LOADER: background extraction %s.\n", cancelled ? "cancelled" : "complete");
+
+    PYI_THREAD_PROC_RETURN;
+}
+
+#endif /* PYI_HAVE_THREADS */
+
+/*
+ * Start background extraction of lazily-extracted data files, if the
+ * archive contains any. If threads are not available, the files are
+ * extracted on demand by the child process.
+ */
+int
+pyi_launch_start_background_extraction(struct PYI_CONTEXT *pyi_ctx)
+{
+#if PYI_HAVE_THREADS
+    const struct ARCHIVE *archive = pyi_ctx->archive;
+    size_t num_entries;
+    struct PYI_BACKGROUND_EXTRACTION *state;
+
+    pyi_archive_get_toc_group(archive, ARCHIVE_TOC_GROUP_LAZY_DATA, &num_entries);
+    if (num_entries == 0) {
+        return 0; /* Nothing to do */
     }
 
-    return retcode;
+    state = (struct PYI_BACKGROUND_EXTRACTION *)calloc(1, sizeof(struct PYI_BACKGROUND_EXTRACTION));
+    if (state == NULL) {
+        PYI_PERROR("calloc", "Could not allocate memory for background extraction state.\n");
+        return -1;
+    }
+    state->pyi_ctx = pyi_ctx;
+
+    if (pyi_mutex_init(&state->mutex) < 0) {
+        free(state);
+        return -1;
+    }
+
+    if (pyi_thread_create(&state->thread, _pyi_launch_background_extraction_worker, state) < 0) {
+        PYI_WARNING("Failed to start background extraction thread!\n");
+        pyi_mutex_destroy(&state->mutex);
+        free(state);
+        return -1;
+    }
+
+    PYI_DEBUG("LOADER: started background extraction of lazily-extracted data files...\n");
+    pyi_ctx->background_extraction_state = state;
+#else
+    (void)pyi_ctx;
+#endif
+
+    return 0;
+}
+
+/*
+ * Stop the background extraction (if it is still running), and wait
+ * for the background thread to finish. Must be called before the
+ * application's top-level directory is removed or moved into the
+ * extraction cache.
+ */
+void
+pyi_launch_stop_background_extraction(struct PYI_CONTEXT *pyi_ctx)
+{
+#if PYI_HAVE_THREADS
+    struct PYI_BACKGROUND_EXTRACTION *state = pyi_ctx->background_extraction_state;
+
+    if (state == NULL) {
+        return;
+    }
+    pyi_ctx->background_extraction_state = NULL;
+
+    pyi_mutex_lock(&state->mutex);
+    state->cancelled = true;
+    pyi_mutex_unlock(&state->mutex);
+
+    pyi_thread_join(state->thread);
+
+    pyi_mutex_destroy(&state->mutex);
+    free(state);
+#else
+    (void)pyi_ctx;
+#endif
 }
 
 
@@ -272,17 +1509,21 @@ _pyi_extract_exception_traceback(
 #endif /* if defined(WINDOWED) */
 
 /*
- * Run scripts
+ * Run scripts, starting with the script at index `first_script`, and
+ * ending before the script at index `end_script`.
  * Return non zero on failure
  */
 static int
-_pyi_launch_run_scripts(const struct PYI_CONTEXT *pyi_ctx)
+_pyi_launch_run_scripts(const struct PYI_CONTEXT *pyi_ctx, size_t first_script, size_t end_script)
 {
     const struct ARCHIVE *archive = pyi_ctx->archive;
     const struct DYLIB_PYTHON *dylib_python = pyi_ctx->dylib_python;
-    unsigned char *data;
     char buf[PYI_PATH_MAX];
+    const struct TOC_ENTRY *const *toc_entries;
     const struct TOC_ENTRY *toc_entry;
+    struct ARCHIVE_BATCH batch;
+    size_t num_entries;
+    size_t i;
     PyObject *__main__;
     PyObject *__file__;
     PyObject *main_dict;
@@ -302,37 +1543,46 @@ _pyi_launch_run_scripts(const struct PYI_CONTEXT *pyi_ctx)
         return -1;
     }
 
-    /* Iterate through toc looking for scripts (type 's') */
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-        if (toc_entry->typecode != ARCHIVE_ITEM_PYSOURCE) {
-            continue;
-        }
+    /* Iterate through scripts (type 's') */
+    toc_entries = pyi_archive_get_toc_group(archive, ARCHIVE_TOC_GROUP_SCRIPTS, &num_entries);
+    if (end_script > num_entries) {
+        end_script = num_entries;
+    }
+    if (first_script >= end_script) {
+        return 0;
+    }
 
-        /* Get data out of the archive.  */
-        data = pyi_archive_extract(archive, toc_entry);
-        if (data == NULL) {
-            PYI_ERROR("Failed to extract script from archive!\n");
-            return -1;
-        }
+    /* Get data of all scripts out of the archive at once; the batch is
+     * released once the last script's code object is unmarshalled. */
+    if (pyi_archive_extract_batch(archive, toc_entries + first_script, end_script - first_script, &batch) < 0) {
+        PYI_ERROR("Failed to extract script from archive!\n");
+        return -1;
+    }
+
+    for (i = first_script; i < end_script; i++) {
+        toc_entry = toc_entries[i];
 
         /* Set the __file__ attribute within the __main__ module, for
          * full compatibility with normal execution. */
-        if (snprintf(buf, PYI_PATH_MAX, "%s%c%s.py", pyi_ctx->application_home_dir, PYI_SEP, toc_entry->name) >= PYI_PATH_MAX) {
+        if (snprintf(buf, PYI_PATH_MAX, "%s%c%s.py", pyi_ctx->application_home_dir, PYI_SEP, pyi_archive_get_entry_name(toc_entry)) >= PYI_PATH_MAX) {
             PYI_ERROR("Absolute path to script exceeds PYI_PATH_MAX\n");
+            pyi_archive_batch_free(&batch);
             return -1;
         }
 
-        PYI_DEBUG("LOADER: running %s.py\n", toc_entry->name);
+        PYI_DEBUG("LOADER: running %s.py\n", pyi_archive_get_entry_name(toc_entry));
 
         __file__ = dylib_python->PyUnicode_FromString(buf);
         dylib_python->PyObject_SetAttrString(__main__, "__file__", __file__);
         dylib_python->Py_DecRef(__file__);
 
         /* Unmarshall code object */
-        code = dylib_python->PyMarshal_ReadObjectFromString((const char *)data, toc_entry->uncompressed_length);
-        free(data);
+        code = dylib_python->PyMarshal_ReadObjectFromString((const char *)batch.arena + batch.offsets[i - first_script], toc_entry->uncompressed_length);
+        if (i + 1 == end_script || !code) {
+            pyi_archive_batch_free(&batch);
+        }
         if (!code) {
-            PYI_ERROR("Failed to unmarshal code object for %s\n", toc_entry->name);
+            PYI_ERROR("Failed to unmarshal code object for %s\n", pyi_archive_get_entry_name(toc_entry));
             dylib_python->PyErr_Print();
             return -1;
         }
@@ -343,7 +1593,9 @@ _pyi_launch_run_scripts(const struct PYI_CONTEXT *pyi_ctx)
         dylib_python->PyObject_SetAttrString(__main__, "_pyi_main_co", code);
 
         /* Run it */
+        pyi_trace_begin("run_script", pyi_archive_get_entry_name(toc_entry));
         retval = dylib_python->PyEval_EvalCode(code, main_dict, main_dict);
+        pyi_trace_end("run_script");
 
         /* If retval is NULL, an error occurred. Otherwise, it is a Python object.
          * (Since we evaluate module-level code, which is not allowed to return an
@@ -391,16 +1643,16 @@ _pyi_launch_run_scripts(const struct PYI_CONTEXT *pyi_ctx)
             /* Non-windowed mode; PyErr_print() above dumps the
              * traceback, so the only thing we need to do here
              * is provide a summary */
-            PYI_ERROR("Failed to execute script '%s' due to unhandled exception!\n", toc_entry->name);
+            PYI_ERROR("Failed to execute script '%s' due to unhandled exception!\n", pyi_archive_get_entry_name(toc_entry));
 #else /* !defined(WINDOWED) */
 #if defined(_WIN32)
             /* Windows; use custom dialog */
-            pyi_unhandled_exception_dialog(toc_entry->name, msg_exc, msg_tb);
+            pyi_unhandled_exception_dialog(pyi_archive_get_entry_name(toc_entry), msg_exc, msg_tb);
 #elif defined(__APPLE__)
             /* macOS .app bundle; use PYI_ERROR(), which
              * prints to stderr (invisible) as well as sends
              * the message to syslog */
-            PYI_ERROR("Failed to execute script '%s' due to unhandled exception: %s\n", toc_entry->name, msg_exc);
+            PYI_ERROR("Failed to execute script '%s' due to unhandled exception: %s\n", pyi_archive_get_entry_name(toc_entry), msg_exc);
             PYI_ERROR("Traceback:\n%s\n", msg_tb);
 #endif /* defined(_WIN32) */
 
@@ -411,6 +1663,7 @@ _pyi_launch_run_scripts(const struct PYI_CONTEXT *pyi_ctx)
 
             /* Be consistent with python interpreter, which returns
              * 1 if it exits due to unhandled exception. */
+            pyi_archive_batch_free(&batch);
             return 1;
         }
     }
@@ -428,34 +1681,127 @@ int
 pyi_launch_execute(struct PYI_CONTEXT *pyi_ctx)
 {
     int rc = 0;
+    uint64_t phase_start_time;
+    struct PyiRuntimeOptions *runtime_options;
+    unsigned char use_pep741;
+
+    /* Start decompressing the hot PYZ entries in the background, while
+     * the python shared library is loaded and the interpreter is
+     * initialized. */
+    pyi_pyz_prefetch_start(pyi_ctx);
+
+    /* Start loading Python shared library in the background, unless
+     * this was already done by pyi_main(). */
+    if (pyi_ctx->dylib_python_loader == NULL) {
+        pyi_ctx->dylib_python_loader = pyi_dylib_python_load_start(
+            pyi_ctx->application_home_dir,
+            pyi_ctx->archive->python_libname,
+            pyi_ctx->archive->python_version
+        );
+        if (pyi_ctx->dylib_python_loader == NULL) {
+            return -1;
+        }
+    }
+
+    /* Read run-time options while the library is being loaded. The form
+     * of pass-through flags depends on the availability of PEP 741 API,
+     * which is predicted from the python version; in the unlikely case
+     * of misprediction (early python 3.14 pre-releases), the options are
+     * read again once the library is loaded. */
+    use_pep741 = pyi_ctx->archive->python_version >= 314;
+    runtime_options = pyi_runtime_options_read(pyi_ctx, use_pep741, &pyi_ctx->startup_arena);
+    if (runtime_options == NULL) {
+        PYI_ERROR("Failed to parse run-time options!\n");
+        return -1;
+    }
 
-    /* Load Python shared library and import symbols from it. */
-    pyi_ctx->dylib_python = pyi_dylib_python_load(
-        pyi_ctx->application_home_dir,
-        pyi_ctx->archive->python_libname,
-        pyi_ctx->archive->python_version
-    );
+    /* Wait for Python shared library to be loaded and its symbols to be
+     * imported. The phase measures only the time spent waiting. */
+    pyi_trace_begin("pyi_dylib_python_load", NULL);
+    phase_start_time = pyi_stats_phase_begin();
+    pyi_ctx->dylib_python = pyi_dylib_python_load_finish(&pyi_ctx->dylib_python_loader);
+    pyi_stats_phase_end(pyi_ctx, PYI_STATS_PHASE_PYTHON_LOAD, phase_start_time);
+    pyi_trace_end("pyi_dylib_python_load");
     if (pyi_ctx->dylib_python == NULL) {
         return -1;
     }
 
+    if (PYI_DYLIB_PYTHON_HAS_PEP741(pyi_ctx->dylib_python) != use_pep741) {
+        runtime_options = pyi_runtime_options_read(
+            pyi_ctx,
+            PYI_DYLIB_PYTHON_HAS_PEP741(pyi_ctx->dylib_python),
+            &pyi_ctx->startup_arena
+        );
+        if (runtime_options == NULL) {
+            PYI_ERROR("Failed to parse run-time options!\n");
+            return -1;
+        }
+    }
+
     /* Start Python interpreter. */
-    if (pyi_python_start_interpreter(pyi_ctx)) {
+    pyi_trace_begin("pyi_python_start_interpreter", NULL);
+    phase_start_time = pyi_stats_phase_begin();
+    rc = pyi_python_start_interpreter(pyi_ctx, runtime_options);
+    pyi_stats_phase_end(pyi_ctx, PYI_STATS_PHASE_PYTHON_INIT, phase_start_time);
+    pyi_trace_end("pyi_python_start_interpreter");
+
+    /* The run-time options (and the copies of environment variables
+     * made during the start-up) are not needed anymore. */
+    pyi_arena_release(&pyi_ctx->startup_arena);
+    if (rc) {
         return -1;
     }
 
     /* Import core pyinstaller modules from the executable - bootstrap */
-    if (pyi_python_import_modules(pyi_ctx)) {
+    pyi_trace_begin("pyi_python_import_modules", NULL);
+    rc = pyi_python_import_modules(pyi_ctx);
+    pyi_trace_end("pyi_python_import_modules");
+    if (rc) {
         return -1;
     }
 
     /* Install PYZ archive */
-    if (pyi_python_install_pyz(pyi_ctx)) {
+    pyi_trace_begin("pyi_python_install_pyz", NULL);
+    rc = pyi_python_install_pyz(pyi_ctx);
+    pyi_trace_end("pyi_python_install_pyz");
+    if (rc) {
+        return -1;
+    }
+
+    /* Install lazy extraction of data files (onefile mode) */
+    rc = pyi_python_install_lazy_extraction(pyi_ctx);
+    if (rc) {
         return -1;
     }
 
-    /* Run scripts */
-    rc = _pyi_launch_run_scripts(pyi_ctx);
+    /* In the main process of the fork server, run only the bootstrap
+     * script(s), and serve the launch requests; the forked application
+     * processes return here and run the remaining scripts. */
+    if (pyi_ctx->fork_server_socket[0] != 0) {
+        const struct TOC_ENTRY *const *toc_entries;
+        size_t num_entries;
+        size_t num_bootstrap_scripts = 0;
+
+        toc_entries = pyi_archive_get_toc_group(pyi_ctx->archive, ARCHIVE_TOC_GROUP_SCRIPTS, &num_entries);
+        while (num_bootstrap_scripts < num_entries && strncmp(pyi_archive_get_entry_name(toc_entries[num_bootstrap_scripts]), "pyiboot", 7) == 0) {
+            num_bootstrap_scripts++;
+        }
+
+        rc = _pyi_launch_run_scripts(pyi_ctx, 0, num_bootstrap_scripts);
+        if (rc) {
+            return -1;
+        }
+
+        rc = pyi_forkserver_serve(pyi_ctx);
+        if (rc != 1) {
+            return rc;
+        }
+
+        rc = _pyi_launch_run_scripts(pyi_ctx, num_bootstrap_scripts, num_entries);
+    } else {
+        /* Run scripts */
+        rc = _pyi_launch_run_scripts(pyi_ctx, 0, SIZE_MAX);
+    }
 
     if (rc == 0) {
         PYI_DEBUG("LOADER: OK.\n");
@@ -469,9 +1815,24 @@ pyi_launch_execute(struct PYI_CONTEXT *pyi_ctx)
 void
 pyi_launch_finalize(struct PYI_CONTEXT *pyi_ctx)
 {
+    /* Stop the PYZ prefetch (if still running) and free its data */
+    pyi_pyz_prefetch_stop(pyi_ctx);
+
     /* CLean up the python interpreter */
     pyi_python_finalize(pyi_ctx);
 
-    /* Unload python shared library */
+    /* Unload python shared library; if the execution failed before the
+     * background loading finished, wait for it first. */
+    if (pyi_ctx->dylib_python_loader != NULL) {
+        struct DYLIB_PYTHON *dylib_python = pyi_dylib_python_load_finish(&pyi_ctx->dylib_python_loader);
+        pyi_dylib_python_cleanup(&dylib_python);
+    }
     pyi_dylib_python_cleanup(&pyi_ctx->dylib_python);
+
+    /* Close the cold archive, if it was opened */
+    pyi_launch_cleanup_cold_archive(pyi_ctx);
+
+    /* Release the start-up arena, in case the execution failed before
+     * the interpreter was started. */
+    pyi_arena_release(&pyi_ctx->startup_arena);
 }
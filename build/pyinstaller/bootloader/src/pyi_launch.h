@@ -17,13 +17,50 @@
 #ifndef PYI_LAUNCH_H
 #define PYI_LAUNCH_H
 
+#include "pyi_global.h"
+#include <inttypes.h>  /* uint64_t */
+
 struct PYI_CONTEXT;
 
+/* Maximum number of worker threads used for extraction of onefile
+ * contents. */
+#define PYI_LAUNCH_MAX_EXTRACTION_THREADS 8
+
+/* Maximum number of binaries that are extracted into memory-backed
+ * files (see `pyi-memfd-binaries` run-time option); each of them keeps
+ * a file descriptor open for the lifetime of the application. Further
+ * binaries are extracted to the filesystem. The limit is additionally
+ * capped to a quarter of the soft limit on open file descriptors. */
+#define PYI_LAUNCH_MEMFD_MAX_BINARIES 256
+
 /*
  * Extract files from embedded archive (onefile mode).
  */
 int pyi_launch_extract_files_from_archive(struct PYI_CONTEXT *pyi_ctx);
 
+/*
+ * Extract lazily-extracted data files (onefile mode), either a single
+ * file or all files in the given directory, or read a range of the
+ * file's data without extracting it. Names are relative to the
+ * application's top-level directory.
+ */
+int pyi_launch_extract_lazy_entry(const struct PYI_CONTEXT *pyi_ctx, const char *name);
+int pyi_launch_extract_lazy_directory(const struct PYI_CONTEXT *pyi_ctx, const char *name);
+int pyi_launch_read_lazy_entry_range(const struct PYI_CONTEXT *pyi_ctx, const char *name, uint64_t offset, void *buffer, size_t length);
+
+/*
+ * Cold archive, which holds the data of some of the lazily-extracted
+ * data files, and is opened on demand (onefile mode).
+ */
+int pyi_launch_setup_cold_archive(struct PYI_CONTEXT *pyi_ctx);
+void pyi_launch_cleanup_cold_archive(struct PYI_CONTEXT *pyi_ctx);
+
+/*
+ * Background extraction of lazily-extracted data files (onefile mode).
+ */
+int pyi_launch_start_background_extraction(struct PYI_CONTEXT *pyi_ctx);
+void pyi_launch_stop_background_extraction(struct PYI_CONTEXT *pyi_ctx);
+
 /*
  * Wrapped platform specific initialization before loading Python and executing
  * all scripts in the archive.
@@ -50,10 +50,19 @@
 #include "pyi_global.h"  /* PYI_PATH_MAX */
 #include "pyi_path.h"
 #include "pyi_archive.h"
+#include "pyi_cache.h"
+#include "pyi_debuglog.h"
+#include "pyi_dylib_python.h"
+#include "pyi_forkserver.h"
+#include "pyi_fsimage.h"
 #include "pyi_utils.h"
 #include "pyi_launch.h"
 #include "pyi_splash.h"
+#include "pyi_trace.h"
+#include "pyi_access_profile.h"
 #include "pyi_apple_events.h"
+#include "pyi_thread.h"
+#include "pyi_trash.h"
 
 
 /* Global PYI_CONTEXT structure used for bookkeeping of state variables.
@@ -91,7 +100,11 @@ static int _pyi_main_onedir_or_onefile_child(struct PYI_CONTEXT *pyi_ctx);
 static int _pyi_main_onefile_parent(struct PYI_CONTEXT *pyi_ctx);
 
 static int _pyi_main_resolve_executable(struct PYI_CONTEXT *pyi_context);
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__CYGWIN__)
+static void _pyi_main_preload_bundled_libraries(const struct PYI_CONTEXT *pyi_ctx);
+#endif
 static int _pyi_main_resolve_pkg_archive(struct PYI_CONTEXT *pyi_context);
+static void _pyi_main_readahead_pkg_archive(const struct PYI_CONTEXT *pyi_ctx);
 
 
 int
@@ -99,6 +112,7 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
 {
     char *env_var_value;
     bool reset_environment;
+    uint64_t phase_start_time;
 
 #ifdef _WIN32
     /* On Windows, both Visual C runtime and MinGW seem to buffer stderr
@@ -108,6 +122,15 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
     setbuf(stderr, (char *)NULL);
 #endif  /* _WIN32 */
 
+    /* Enable buffered debug log, if requested (debug builds only). */
+    pyi_debuglog_init();
+
+    /* Enable startup tracing, if requested. */
+    pyi_trace_init();
+
+    /* Enable recording of archive access order, if requested. */
+    pyi_access_profile_init();
+
     PYI_DEBUG("PyInstaller Bootloader 6.x\n");
 
     /* In debug builds, dump the command-line arguments. */
@@ -122,9 +145,13 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
     PYI_DEBUG("LOADER: executable file: %s\n", pyi_ctx->executable_filename);
 
     /* Resolve main PKG archive - embedded or side-loaded. */
+    pyi_trace_begin("_pyi_main_resolve_pkg_archive", NULL);
+    phase_start_time = pyi_stats_phase_begin();
     if (_pyi_main_resolve_pkg_archive(pyi_ctx) < 0) {
         return -1;
     }
+    pyi_stats_phase_end(pyi_ctx, PYI_STATS_PHASE_ARCHIVE_OPEN, phase_start_time);
+    pyi_trace_end("_pyi_main_resolve_pkg_archive");
     PYI_DEBUG("LOADER: archive file: %s\n", pyi_ctx->archive_filename);
 
     /* We can now access PKG archive via pyi_ctx->archive; for example,
@@ -137,15 +164,24 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
 
     /* Check if splash screen is available. */
     pyi_ctx->has_splash = pyi_ctx->archive->toc_splash != NULL;
+#if defined(PYI_WITHOUT_SPLASH)
+    /* Splash screen support is compiled out of this bootloader variant;
+     * treat the splash screen as suppressed, so that the pyi_splash
+     * module is informed about it. */
+    if (pyi_ctx->has_splash) {
+        PYI_WARNING("Splash screen is not supported by this bootloader variant!\n");
+        pyi_ctx->suppress_splash = true;
+    }
+#else
     if (pyi_ctx->has_splash) {
         /* Check if user requested splash screen to be suppressed by setting
          * the PYINSTALLER_SUPPRESS_SPLASH_SCREEN environment variable to 1. */
-        env_var_value = pyi_getenv("PYINSTALLER_SUPPRESS_SPLASH_SCREEN");
+        env_var_value = pyi_arena_getenv(&pyi_ctx->startup_arena, "PYINSTALLER_SUPPRESS_SPLASH_SCREEN");
         if (env_var_value) {
             pyi_ctx->suppress_splash = strcmp(env_var_value, "1") == 0;
         }
-        free(env_var_value);
     }
+#endif
 
     /* Check if user explicitly requested environment reset via the
      * PYINSTALLER_RESET_ENVIRONMENT environment variable. In this case,
@@ -153,7 +189,7 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
      * a (new) top-level process. */
     reset_environment = false;
 
-    env_var_value = pyi_getenv("PYINSTALLER_RESET_ENVIRONMENT");
+    env_var_value = pyi_arena_getenv(&pyi_ctx->startup_arena, "PYINSTALLER_RESET_ENVIRONMENT");
     if (env_var_value) {
         /* Only valid value is 1; anything else is ignored */
         if (strcmp(env_var_value, "1") == 0) {
@@ -165,7 +201,6 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
          * processes of this process. */
         pyi_unsetenv("PYINSTALLER_RESET_ENVIRONMENT");
     }
-    free(env_var_value);
 
     /* Check if existing PyInstaller run-time environment exists, and
      * determine whether we should inherit it or not. This is done by
@@ -182,7 +217,7 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
      *    should reset the environment. */
     if (!reset_environment) {
         reset_environment = true;
-        env_var_value = pyi_getenv("_PYI_ARCHIVE_FILE");
+        env_var_value = pyi_arena_getenv(&pyi_ctx->startup_arena, "_PYI_ARCHIVE_FILE");
         if (env_var_value) {
             PYI_DEBUG("LOADER: _PYI_ARCHIVE_FILE already defined: %s\n", env_var_value);
             if (strcmp(pyi_ctx->archive_filename, env_var_value) == 0) {
@@ -194,7 +229,6 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
         } else {
             PYI_DEBUG("LOADER: _PYI_ARCHIVE_FILE not defined...\n");
         }
-        free(env_var_value);
     }
 
     /* Perform the actual environment reset, if necessary */
@@ -209,17 +243,25 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
 
         pyi_unsetenv("_PYI_SPLASH_IPC");
 
+        pyi_unsetenv("_PYI_PARENT_STATS");
+
+        pyi_unsetenv("_PYI_ARCHIVE_HINT");
+
 #if defined(__linux__)
         pyi_unsetenv("_PYI_LINUX_PROCESS_NAME"); /* Linux only */
 #endif
     }
 
+    /* Read all applicable run-time options from the PKG archive; the
+     * no-restart option affects the inference of process level below. */
+    _pyi_main_read_runtime_options(pyi_ctx);
+
     /* Use _PYI_PARENT_PROCESS_LEVEL environment variable to infer the
      * level (type) of this process:
      *  - parent (launcher) process
      *  - main (application) process
      *  - subprocess spawned from main application process. */
-    env_var_value = pyi_getenv("_PYI_PARENT_PROCESS_LEVEL");
+    env_var_value = pyi_arena_getenv(&pyi_ctx->startup_arena, "_PYI_PARENT_PROCESS_LEVEL");
     if (!env_var_value || !env_var_value[0]) {
         pyi_ctx->parent_process_level = PYI_PROCESS_LEVEL_UNKNOWN;
     } else {
@@ -233,7 +275,6 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
             return -1;
         }
     }
-    free(env_var_value);
 
     PYI_DEBUG("LOADER: parent process level = %d\n", pyi_ctx->parent_process_level);
     switch (pyi_ctx->parent_process_level) {
@@ -249,7 +290,9 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
              * search path changes to take effect. This is always needed
              * for onedir applications, but also for onefile applications
              * that have splash screen (to ensure proper discovery of
-             * bundled dependencies of Tcl/Tk).
+             * bundled dependencies of Tcl/Tk). In no-restart mode, the
+             * restart is replaced by preloading the bundled shared
+             * libraries by their absolute path.
              *
              * On Cygwin, the process restart is not necessary because the
              * library search path is controlled by `SetDllDirectoryW()`,
@@ -263,9 +306,9 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
 #else
                 /* Other POSIX systems; if splash screen is available
                  * (and not suppressed), mark as the parent process that
-                 * needs to restart itself. Otherwise, mark as the regular
-                 * parent process. */
-                if (pyi_ctx->has_splash && !pyi_ctx->suppress_splash) {
+                 * needs to restart itself, unless no-restart mode is
+                 * enabled. Otherwise, mark as the regular parent process. */
+                if (pyi_ctx->has_splash && !pyi_ctx->suppress_splash && !pyi_ctx->no_restart) {
                     pyi_ctx->process_level = PYI_PROCESS_LEVEL_PARENT_NEEDS_RESTART;
                 } else {
                     pyi_ctx->process_level = PYI_PROCESS_LEVEL_PARENT;
@@ -278,8 +321,13 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
                 pyi_ctx->process_level = PYI_PROCESS_LEVEL_MAIN;
 #else
                 /* Other POSIX systems - mark as the parent/launcher
-                 * that needs to restart itself. */
-                pyi_ctx->process_level = PYI_PROCESS_LEVEL_PARENT_NEEDS_RESTART;
+                 * that needs to restart itself, or in no-restart mode,
+                 * as the main process. */
+                if (pyi_ctx->no_restart) {
+                    pyi_ctx->process_level = PYI_PROCESS_LEVEL_MAIN;
+                } else {
+                    pyi_ctx->process_level = PYI_PROCESS_LEVEL_PARENT_NEEDS_RESTART;
+                }
 #endif
             }
             break;
@@ -317,6 +365,12 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
 
     PYI_DEBUG("LOADER: process level = %d\n", pyi_ctx->process_level);
 
+    /* In the main process of a onefile application, collect the
+     * run-time statistics of the parent process. */
+    if (pyi_ctx->parent_process_level == PYI_PROCESS_LEVEL_PARENT) {
+        pyi_stats_import_from_parent(pyi_ctx);
+    }
+
     /* Store our process level in _PYI_PARENT_PROCESS_LEVEL for potential
      * child processes. If we are already in a spawned child sub-process,
      * leave the environment variable unchanged, as we do not keep track
@@ -330,8 +384,17 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
         }
     }
 
-    /* Read all applicable run-time options from the PKG archive */
-    _pyi_main_read_runtime_options(pyi_ctx);
+    /* Pass the location of the archive's cookie (along with the archive
+     * file's identity) to child processes that use the same executable
+     * - the onefile child process, the process after restart, and the
+     * sub-processes spawned via sys.executable (e.g., multiprocessing
+     * workers) - so that they can skip the search for the cookie. */
+    if (pyi_ctx->process_level < PYI_PROCESS_LEVEL_SUBPROCESS) {
+        char archive_hint[PYI_ARCHIVE_HINT_MAX];
+        if (pyi_archive_format_hint(pyi_ctx->archive, archive_hint, sizeof(archive_hint)) == 0) {
+            pyi_setenv("_PYI_ARCHIVE_HINT", archive_hint);
+        }
+    }
 
     /* Early console hiding/minimization (Windows-only) */
 #if defined(_WIN32) && !defined(WINDOWED)
@@ -344,11 +407,69 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
 
     /* Read the setting for strict unpack mode from corresponding
      * environment variable. */
-    env_var_value = pyi_getenv("PYINSTALLER_STRICT_UNPACK_MODE"); /* strdup'd copy or NULL */
+    env_var_value = pyi_arena_getenv(&pyi_ctx->startup_arena, "PYINSTALLER_STRICT_UNPACK_MODE"); /* arena copy or NULL */
     if (env_var_value) {
         pyi_ctx->strict_unpack_mode = strcmp(env_var_value, "0") != 0;
     }
-    free(env_var_value);
+
+    /* Read the number of extraction worker threads from corresponding
+     * environment variable; if not set, use the number of available
+     * processors. The value is clamped to the supported range. */
+    env_var_value = pyi_arena_getenv(&pyi_ctx->startup_arena, "PYINSTALLER_EXTRACTION_THREADS"); /* arena copy or NULL */
+    if (env_var_value) {
+        pyi_ctx->extraction_threads = atoi(env_var_value);
+    } else {
+        pyi_ctx->extraction_threads = pyi_thread_get_cpu_count();
+    }
+    if (pyi_ctx->extraction_threads < 1) {
+        pyi_ctx->extraction_threads = 1;
+    } else if (pyi_ctx->extraction_threads > PYI_LAUNCH_MAX_EXTRACTION_THREADS) {
+        pyi_ctx->extraction_threads = PYI_LAUNCH_MAX_EXTRACTION_THREADS;
+    }
+
+    /* Allow the environment variable to override the extraction cache
+     * setting from the run-time options. */
+    env_var_value = pyi_arena_getenv(&pyi_ctx->startup_arena, "PYINSTALLER_EXTRACTION_CACHE"); /* arena copy or NULL */
+    if (env_var_value) {
+        pyi_ctx->use_extraction_cache = strcmp(env_var_value, "0") != 0;
+    }
+
+    /* Allow the environment variable to disable the fork server. */
+    env_var_value = pyi_arena_getenv(&pyi_ctx->startup_arena, "PYINSTALLER_FORK_SERVER"); /* arena copy or NULL */
+    if (env_var_value) {
+        if (strcmp(env_var_value, "0") == 0) {
+            pyi_ctx->fork_server = 0;
+        }
+    }
+
+    /* Allow the environment variable to override the checksum
+     * verification setting from the run-time options. */
+    env_var_value = pyi_arena_getenv(&pyi_ctx->startup_arena, "PYINSTALLER_VERIFY_CHECKSUMS"); /* arena copy or NULL */
+    if (env_var_value) {
+        pyi_ctx->verify_checksums = strcmp(env_var_value, "0") != 0;
+    }
+    if (pyi_ctx->verify_checksums && pyi_archive_enable_checksums(pyi_ctx->archive) < 0) {
+        PYI_WARNING("LOADER: archive has no checksum table; extracted data will not be verified.\n");
+        pyi_ctx->verify_checksums = 0;
+    }
+
+    /* The embedded filesystem image replaces the extraction of onefile
+     * contents; the extraction-related options do not apply to it. */
+    if (pyi_ctx->archive->toc_fsimage != NULL) {
+        pyi_ctx->use_extraction_cache = 0;
+        pyi_ctx->memfd_binaries = 0;
+        pyi_ctx->deferred_cleanup = 0;
+    }
+
+    /* Request the read-ahead of the parts of the PKG archive that this
+     * process needs. */
+    _pyi_main_readahead_pkg_archive(pyi_ctx);
+
+    /* Set up the cold archive, if the program has one; the archive
+     * itself is opened only when its contents are first needed. */
+    if (pyi_ctx->cold_archive_name != NULL && pyi_launch_setup_cold_archive(pyi_ctx) < 0) {
+        return -1;
+    }
 
     /* On Linux, pass the process name from the (original) parent process
      * to child process(es) via environment variable. In onefile mode,
@@ -368,15 +489,24 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
         }
     } else {
         /* Restore the name from environment variable. */
-        env_var_value = pyi_getenv("_PYI_LINUX_PROCESS_NAME");
+        env_var_value = pyi_arena_getenv(&pyi_ctx->startup_arena, "_PYI_LINUX_PROCESS_NAME");
         if (env_var_value) {
             PYI_DEBUG("LOADER: restoring process name: %s\n", env_var_value);
             prctl(PR_SET_NAME, env_var_value, 0, 0); /* Ignore failures */
         }
-        free(env_var_value);
     }
 #endif  /* defined(__linux__) */
 
+    /* With the fork server enabled, the entry-point process tries to
+     * delegate the launch to the running server (or starts it). */
+    if (pyi_ctx->fork_server) {
+        int exit_code;
+
+        if (pyi_forkserver_setup(pyi_ctx, &exit_code) == 0) {
+            return exit_code;
+        }
+    }
+
     /* Infer the process type (onefile parent, onefile child, onedir),
      * and based on that, determine the application's top-level directory. */
     if (pyi_ctx->is_onefile) {
@@ -420,16 +550,31 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
             }
 #endif
 
+            /* If extraction cache is enabled, look up the application
+             * directory in the cache, or create a staging directory for
+             * it. If that fails, fall back to temporary directory. */
+            if (pyi_ctx->use_extraction_cache) {
+                PYI_DEBUG("LOADER: setting up application directory in extraction cache...\n");
+                if (pyi_cache_create_application_directory(pyi_ctx) < 0) {
+                    PYI_DEBUG("LOADER: failed to set up extraction cache; falling back to temporary directory.\n");
+                } else if (pyi_setenv("_PYI_EXTRACTION_CACHE_DIR", pyi_ctx->extraction_cache_dir) < 0) {
+                    PYI_ERROR("Failed to set extraction cache directory via environment variable!\n");
+                    return -1;
+                }
+            }
+
             /* Create temporary directory; the path is stored to
              * `pyi_ctx->application_home_dir`. */
-            PYI_DEBUG("LOADER: creating temporary directory (runtime_tmpdir=%s)...\n", pyi_ctx->runtime_tmpdir);
+            if (pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_NONE) {
+                PYI_DEBUG("LOADER: creating temporary directory (runtime_tmpdir=%s)...\n", pyi_ctx->runtime_tmpdir);
 
-            if (pyi_create_temporary_application_directory(pyi_ctx) < 0) {
-                PYI_ERROR("Could not create temporary directory!\n");
-                return -1;
-            }
+                if (pyi_create_temporary_application_directory(pyi_ctx) < 0) {
+                    PYI_ERROR("Could not create temporary directory!\n");
+                    return -1;
+                }
 
-            PYI_DEBUG("LOADER: created temporary directory: %s\n", pyi_ctx->application_home_dir);
+                PYI_DEBUG("LOADER: created temporary directory: %s\n", pyi_ctx->application_home_dir);
+            }
 
             /* Pass the path to temporary directory to the child process
              * via corresponding environment variable. */
@@ -442,7 +587,7 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
             /* The ephemeral application top-level directory should already
              * exist, and the path to it should be available in the
              * _PYI_APPLICATION_HOME_DIR environment variable. */
-            env_var_value = pyi_getenv("_PYI_APPLICATION_HOME_DIR");
+            env_var_value = pyi_arena_getenv(&pyi_ctx->startup_arena, "_PYI_APPLICATION_HOME_DIR");
             if (!env_var_value || !env_var_value[0]) {
                 PYI_ERROR("_PYI_APPLICATION_HOME_DIR environment variable is not defined!\n");
                 return -1;
@@ -451,11 +596,25 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
             /* Copy the application's top-level directory from environment */
             if (snprintf(pyi_ctx->application_home_dir, PYI_PATH_MAX, "%s", env_var_value) >= PYI_PATH_MAX) {
                 PYI_ERROR("Path exceeds PYI_PATH_MAX limit.\n");
-                free(env_var_value);
                 return -1;
             }
 
-            free(env_var_value);
+
+            /* In the parent process after restart, restore the state of
+             * the extraction cache; if the inherited directory is the
+             * cache entry directory itself, we have a cache hit, otherwise
+             * the inherited directory is the staging directory. */
+            if (pyi_ctx->process_level == PYI_PROCESS_LEVEL_PARENT) {
+                env_var_value = pyi_arena_getenv(&pyi_ctx->startup_arena, "_PYI_EXTRACTION_CACHE_DIR");
+                if (env_var_value && env_var_value[0]) {
+                    snprintf(pyi_ctx->extraction_cache_dir, PYI_PATH_MAX, "%s", env_var_value);
+                    if (strcmp(pyi_ctx->extraction_cache_dir, pyi_ctx->application_home_dir) == 0) {
+                        pyi_ctx->extraction_cache_state = PYI_EXTRACTION_CACHE_HIT;
+                    } else {
+                        pyi_ctx->extraction_cache_state = PYI_EXTRACTION_CACHE_MISS;
+                    }
+                }
+            }
         }
     } else {
         char executable_dir[PYI_PATH_MAX];
@@ -633,6 +792,7 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
          *  - parent process of onefile application with splash screen
          *    before restart
          *  - parent process of onefile application without splash screen
+         *  - main process of onedir application in no-restart mode
          * These cases can all be inferred from current process level and
          * the parent process level. */
         modify_ld_library_path = (
@@ -641,7 +801,10 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
              * before restart. */
             pyi_ctx->process_level == PYI_PROCESS_LEVEL_PARENT_NEEDS_RESTART ||
             /* Parent process of onefile application without splash screen. */
-            (pyi_ctx->process_level == PYI_PROCESS_LEVEL_PARENT && pyi_ctx->parent_process_level != PYI_PROCESS_LEVEL_PARENT_NEEDS_RESTART)
+            (pyi_ctx->process_level == PYI_PROCESS_LEVEL_PARENT && pyi_ctx->parent_process_level != PYI_PROCESS_LEVEL_PARENT_NEEDS_RESTART) ||
+            /* Main process of onedir application in no-restart mode;
+             * the modification applies only to its child processes. */
+            (!pyi_ctx->is_onefile && pyi_ctx->process_level == PYI_PROCESS_LEVEL_MAIN && pyi_ctx->parent_process_level == PYI_PROCESS_LEVEL_UNKNOWN)
         );
 
         /* Whether we need to restart the process can be directly inferred
@@ -658,6 +821,12 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
         if (needs_restart) {
             PYI_DEBUG("LOADER: process needs to restart itself to apply modifications to library search path.\n");
 
+            /* Write out the trace events; the process image (along
+             * with the atexit handler) is replaced by execvp(). */
+            pyi_trace_set_process_name(pyi_ctx->is_onefile ? "onefile parent (before restart)" : "onedir (before restart)");
+            pyi_trace_flush();
+            pyi_debuglog_flush();
+
             /* Restart the process, by calling execvp() without fork(). */
             /* NOTE: the codepath that ended up here does not perform any
              * argument modification, so we always use pyi_ctx->argv (as
@@ -685,19 +854,47 @@ pyi_main(struct PYI_CONTEXT *pyi_ctx)
 
             /* Unreachable */
         }
+
+        /* In no-restart mode, the main process of onedir application
+         * preloads the bundled shared libraries instead. In onefile mode,
+         * this is done by the parent process when setting up the splash
+         * screen, after the libraries are extracted. */
+        if (pyi_ctx->no_restart && !pyi_ctx->is_onefile && pyi_ctx->process_level == PYI_PROCESS_LEVEL_MAIN && pyi_ctx->parent_process_level == PYI_PROCESS_LEVEL_UNKNOWN) {
+            _pyi_main_preload_bundled_libraries(pyi_ctx);
+        }
     }
 #endif
 
+    /* In the processes that run the python interpreter (onedir process
+     * and onefile child process), start loading the python shared
+     * library in the background, so that it overlaps with the remaining
+     * setup (splash screen, argument processing, run-time options). The
+     * library search path is already in effect at this point. If this
+     * fails, pyi_launch_execute() retries. */
+    if (!(pyi_ctx->is_onefile && pyi_ctx->process_level == PYI_PROCESS_LEVEL_PARENT)) {
+        pyi_ctx->dylib_python_loader = pyi_dylib_python_load_start(
+            pyi_ctx->application_home_dir,
+            pyi_ctx->archive->python_libname,
+            pyi_ctx->archive->python_version
+        );
+    }
+
     /* Setup splash screen, if applicable */
+    pyi_trace_begin("_pyi_main_setup_splash_screen", NULL);
+    phase_start_time = pyi_stats_phase_begin();
     _pyi_main_setup_splash_screen(pyi_ctx);
+    pyi_stats_phase_end(pyi_ctx, PYI_STATS_PHASE_SPLASH_SETUP, phase_start_time);
+    pyi_trace_end("_pyi_main_setup_splash_screen");
 
     /* Split execution between onefile parent process vs. onefile child
      * process / onedir process. */
     if (pyi_ctx->is_onefile && pyi_ctx->process_level == PYI_PROCESS_LEVEL_PARENT) {
         /* Onefile parent */
+        pyi_trace_set_process_name("onefile parent");
         return _pyi_main_onefile_parent(pyi_ctx);
     } else {
         /* Onedir or onefile child */
+        pyi_trace_set_process_name(pyi_ctx->is_onefile ? "onefile child" : "onedir");
         return _pyi_main_onedir_or_onefile_child(pyi_ctx);
     }
 }
@@ -723,12 +920,14 @@ static void
 _pyi_main_read_runtime_options(struct PYI_CONTEXT *pyi_ctx)
 {
     const struct ARCHIVE *archive = pyi_ctx->archive;
-    const struct TOC_ENTRY *toc_entry;
+    const struct TOC_ENTRY *const *toc_entries;
+    size_t num_entries;
+    size_t i;
+    const char *entry_name;
 
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-        if (toc_entry->typecode != ARCHIVE_ITEM_RUNTIME_OPTION) {
-            continue;
-        }
+    toc_entries = pyi_archive_get_toc_group(archive, ARCHIVE_TOC_GROUP_OPTIONS, &num_entries);
+    for (i = 0; i < num_entries; i++) {
+        entry_name = pyi_archive_get_entry_name(toc_entries[i]);
 
         /* NOTE: option names are constants, so we use hard-coded
          * lengths as well to avoid invoking strlen() on each
@@ -744,8 +943,8 @@ _pyi_main_read_runtime_options(struct PYI_CONTEXT *pyi_ctx)
          * - Py_GIL_DISABLED
          *
          * Might be specified multiple times, for each such flag. */
-        if (strncmp(toc_entry->name, "pyi-python-flag", 15) == 0) {
-            const char *flag_name = toc_entry->name + 16;
+        if (strncmp(entry_name, "pyi-python-flag", 15) == 0) {
+            const char *flag_name = entry_name + 16;
             if (strncmp(flag_name, "Py_GIL_DISABLED", 15) == 0) {
                 pyi_ctx->nogil_enabled = 1;
             }
@@ -755,22 +954,128 @@ _pyi_main_read_runtime_options(struct PYI_CONTEXT *pyi_ctx)
         /* pyi-runtime-tmpdir <value>
          *
          * Run-time temporary directory override for onefile programs. */
-        if (strncmp(toc_entry->name, "pyi-runtime-tmpdir", 18) == 0) {
-            pyi_ctx->runtime_tmpdir = toc_entry->name + 19;
+        if (strncmp(entry_name, "pyi-runtime-tmpdir", 18) == 0) {
+            if (strcmp(entry_name + 19, "auto") == 0) {
+                pyi_ctx->runtime_tmpdir_auto = 1;
+            } else {
+                pyi_ctx->runtime_tmpdir = entry_name + 19;
+            }
         }
 
         /* pyi-contents-directory <value>
          *
          * Contents sub-directory in onedir programs. */
-        if (strncmp(toc_entry->name, "pyi-contents-directory", 22) == 0) {
-            pyi_ctx->contents_subdirectory = toc_entry->name + 23;
+        if (strncmp(entry_name, "pyi-contents-directory", 22) == 0) {
+            pyi_ctx->contents_subdirectory = entry_name + 23;
+        }
+
+        /* pyi-cold-archive <name>
+         *
+         * Name of the cold archive that holds the data of some of the
+         * lazily-extracted data files in onefile programs. */
+        if (strncmp(entry_name, "pyi-cold-archive", 16) == 0) {
+            pyi_ctx->cold_archive_name = entry_name + 17;
+            continue;
+        }
+
+        /* pyi-extraction-cache
+         *
+         * Use persistent extraction cache in onefile programs. */
+        if (strncmp(entry_name, "pyi-extraction-cache", 20) == 0) {
+            pyi_ctx->use_extraction_cache = 1;
+            continue;
+        }
+
+        /* pyi-background-extraction
+         *
+         * Extract lazily-extracted data files in the background in
+         * onefile programs. */
+        if (strncmp(entry_name, "pyi-background-extraction", 25) == 0) {
+            pyi_ctx->background_extraction = 1;
+            continue;
+        }
+
+        /* pyi-memfd-binaries
+         *
+         * Extract binaries into memory-backed files in onefile programs
+         * (Linux only). */
+        if (strncmp(entry_name, "pyi-memfd-binaries", 18) == 0) {
+            pyi_ctx->memfd_binaries = 1;
+            continue;
+        }
+
+        /* pyi-deferred-cleanup
+         *
+         * Move the temporary directory of onefile programs aside instead
+         * of removing it, and have it removed by the next launch. */
+        if (strncmp(entry_name, "pyi-deferred-cleanup", 20) == 0) {
+            pyi_ctx->deferred_cleanup = 1;
+            continue;
+        }
+
+        /* pyi-shared-dependency-store
+         *
+         * Extract dependencies referenced from other programs of a
+         * multi-package build into the shared store, and clone them
+         * from there. */
+        if (strncmp(entry_name, "pyi-shared-dependency-store", 27) == 0) {
+            pyi_ctx->shared_dependency_store = 1;
+            continue;
+        }
+
+        /* pyi-verify-checksums
+         *
+         * Verify the extracted data against the checksums from the
+         * archive's checksum table. */
+        if (strncmp(entry_name, "pyi-verify-checksums", 20) == 0) {
+            pyi_ctx->verify_checksums = 1;
+            continue;
+        }
+
+        /* pyi-no-restart
+         *
+         * Preload the bundled shared libraries instead of restarting
+         * the process to apply the library search path modification. */
+        if (strncmp(entry_name, "pyi-no-restart", 14) == 0) {
+            pyi_ctx->no_restart = 1;
+            continue;
+        }
+
+        /* pyi-preload-library <name>
+         *
+         * Bundled shared library to preload in no-restart mode (onefile
+         * only); processed by _pyi_main_preload_bundled_libraries(). */
+        if (strncmp(entry_name, "pyi-preload-library", 19) == 0) {
+            continue;
+        }
+
+        /* pyi-fork-server-warm-module <name>
+         *
+         * Module imported by the fork server before it starts listening;
+         * processed by pyi_forkserver_serve(). */
+        if (strncmp(entry_name, "pyi-fork-server-warm-module", 27) == 0) {
+            continue;
+        }
+
+        /* pyi-fork-server [<idle timeout>]
+         *
+         * Delegate the launches to the resident fork server, which exits
+         * after being idle for the given time (in seconds). */
+        if (strncmp(entry_name, "pyi-fork-server", 15) == 0) {
+            pyi_ctx->fork_server = 1;
+            if (entry_name[15] == ' ' && entry_name[16] != 0) {
+                pyi_ctx->fork_server_idle_timeout = (unsigned int)strtoul(entry_name + 16, NULL, 10);
+            } else {
+                pyi_ctx->fork_server_idle_timeout = PYI_FORKSERVER_DEFAULT_IDLE_TIMEOUT;
+            }
+            continue;
         }
 
         /* pyi-macos-argv-emulation
          *
          * Argv emulation for macOS .app bundles. */
 #if defined(__APPLE__) && defined(WINDOWED)
-        if (strncmp(toc_entry->name, "pyi-macos-argv-emulation", 24) == 0) {
+        if (strncmp(entry_name, "pyi-macos-argv-emulation", 24) == 0) {
             pyi_ctx->macos_argv_emulation = 1;
             continue;
         }
@@ -781,8 +1086,8 @@ _pyi_main_read_runtime_options(struct PYI_CONTEXT *pyi_ctx)
          * Console hiding/minimization option for Windows console-enabled
          * builds. */
 #if defined(_WIN32) && !defined(WINDOWED)
-        if (strncmp(toc_entry->name, "pyi-hide-console", 16) == 0) {
-            const char *option_value = toc_entry->name + 17;
+        if (strncmp(entry_name, "pyi-hide-console", 16) == 0) {
+            const char *option_value = entry_name + 17;
             if (strcmp(option_value, HIDE_CONSOLE_OPTION_HIDE_EARLY) == 0) {
                 pyi_ctx->hide_console = PYI_HIDE_CONSOLE_HIDE_EARLY;
             } else if (strcmp(option_value, HIDE_CONSOLE_OPTION_MINIMIZE_EARLY) == 0) {
@@ -805,17 +1110,27 @@ _pyi_main_read_runtime_options(struct PYI_CONTEXT *pyi_ctx)
          * Windows noconsole builds, syslog message in macOS .app
          * bundles) */
 #if defined(WINDOWED)
-        if (strncmp(toc_entry->name, "pyi-disable-windowed-traceback", 30) == 0) {
+        if (strncmp(entry_name, "pyi-disable-windowed-traceback", 30) == 0) {
             pyi_ctx->disable_windowed_traceback = 1;
             continue;
         }
 #endif
 
+        /* pyi-hot-prefix-length <value>
+         *
+         * Length of the leading part of the PKG archive that contains
+         * the entries accessed during the startup, as recorded in the
+         * access profile that the archive was built with. */
+        if (strncmp(entry_name, "pyi-hot-prefix-length", 21) == 0) {
+            pyi_ctx->hot_prefix_length = strtoull(entry_name + 22, NULL, 10);
+            continue;
+        }
+
         /* pyi-bootloader-ignore-signals
          *
          * Ignore signals in onefile parent process (POSIX only) */
 #if !defined(_WIN32)
-        if (strncmp(toc_entry->name, "pyi-bootloader-ignore-signals", 29) == 0) {
+        if (strncmp(entry_name, "pyi-bootloader-ignore-signals", 29) == 0) {
             pyi_ctx->ignore_signals = 1;
             continue;
         }
@@ -827,6 +1142,59 @@ _pyi_main_read_runtime_options(struct PYI_CONTEXT *pyi_ctx)
 /**********************************************************************\
  *                        Splash screen setup                         *
 \**********************************************************************/
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__CYGWIN__)
+
+/* Preload the bundled shared libraries by their absolute path, in the
+ * order determined at build time (each library after its bundled
+ * dependencies), so that the dynamic linker resolves the references to
+ * them by their SONAME even though `LD_LIBRARY_PATH` is not in effect
+ * for this process. In onedir mode, the libraries are listed in the
+ * PYI_PRELOAD_LIST_FILENAME file in the application's top-level
+ * directory; in onefile mode, by `pyi-preload-library` run-time options.
+ * Libraries that fail to load are skipped. */
+static void
+_pyi_main_preload_bundled_libraries(const struct PYI_CONTEXT *pyi_ctx)
+{
+    char list_filename[PYI_PATH_MAX];
+    char line[PYI_PATH_MAX];
+    FILE *fp;
+
+    if (pyi_ctx->is_onefile) {
+        const struct TOC_ENTRY *const *toc_entries;
+        size_t num_entries;
+        size_t i;
+
+        toc_entries = pyi_archive_get_toc_group(pyi_ctx->archive, ARCHIVE_TOC_GROUP_OPTIONS, &num_entries);
+        for (i = 0; i < num_entries; i++) {
+            const char *entry_name = pyi_archive_get_entry_name(toc_entries[i]);
+            if (strncmp(entry_name, "pyi-preload-library ", 20) == 0) {
+                pyi_utils_preload_library(pyi_ctx->application_home_dir, entry_name + 20);
+            }
+        }
+        return;
+    }
+
+    if (pyi_path_join(list_filename, pyi_ctx->application_home_dir, PYI_PRELOAD_LIST_FILENAME) == NULL) {
+        PYI_WARNING("LOADER: path of the list of libraries to preload is too long!\n");
+        return;
+    }
+    fp = pyi_path_fopen(list_filename, "r");
+    if (fp == NULL) {
+        PYI_WARNING("LOADER: failed to open the list of libraries to preload: %s\n", list_filename);
+        return;
+    }
+    PYI_DEBUG("LOADER: preloading bundled shared libraries listed in %s\n", list_filename);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] != 0) {
+            pyi_utils_preload_library(pyi_ctx->application_home_dir, line);
+        }
+    }
+    fclose(fp);
+}
+
+#endif
+
 static void
 _pyi_main_setup_splash_screen(struct PYI_CONTEXT *pyi_ctx)
 {
@@ -879,7 +1247,7 @@ _pyi_main_setup_splash_screen(struct PYI_CONTEXT *pyi_ctx)
 
     /* In onefile mode, we need to extract dependencies (shared
      * libraries, .tcl files, etc.) from PKG archive. */
-    if (pyi_ctx->is_onefile) {
+    if (pyi_ctx->is_onefile && pyi_ctx->extraction_cache_state != PYI_EXTRACTION_CACHE_HIT) {
         PYI_DEBUG("LOADER: extracting splash screen dependencies...\n");
         if (pyi_splash_extract(pyi_ctx->splash, pyi_ctx) != 0) {
             PYI_WARNING("Failed to unpack splash screen dependencies from PKG archive!\n");
@@ -887,6 +1255,15 @@ _pyi_main_setup_splash_screen(struct PYI_CONTEXT *pyi_ctx)
         }
     }
 
+    /* In no-restart mode, preload the bundled dependencies of Tcl/Tk
+     * shared libraries (onefile parent process only; in onedir mode,
+     * the bundled libraries have already been preloaded). */
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__CYGWIN__)
+    if (pyi_ctx->is_onefile && pyi_ctx->no_restart) {
+        _pyi_main_preload_bundled_libraries(pyi_ctx);
+    }
+#endif
+
     /* Load Tcl/Tk shared libraries */
     if (pyi_splash_load_shared_libraries(pyi_ctx->splash) != 0) {
         PYI_WARNING("Failed to load Tcl/Tk shared libraries for splash screen!\n");
@@ -899,6 +1276,13 @@ _pyi_main_setup_splash_screen(struct PYI_CONTEXT *pyi_ctx)
         goto cleanup;
     }
 
+    /* The running splash screen keeps its own copy of the image; in
+     * onedir mode, there are no requirements to extract either, so the
+     * resources can be released right away. */
+    if (!pyi_ctx->is_onefile) {
+        pyi_splash_release_resources(pyi_ctx->splash);
+    }
+
     /* Done! */
     return;
 
@@ -941,7 +1325,7 @@ _pyi_main_onedir_or_onefile_child(struct PYI_CONTEXT *pyi_ctx)
             }
             /* Process Apple events; this updates argc_pyi/argv_pyi
              * accordingly */
-            pyi_apple_process_events(pyi_ctx->ae_ctx, 0.25);  /* short_timeout (250 ms) */
+            pyi_apple_process_launch_events(pyi_ctx->ae_ctx, 0.25);  /* safety-net timeout (250 ms) */
             /* Uninstall event handlers */
             pyi_apple_uninstall_event_handlers(&pyi_ctx->ae_ctx);
             /* The processing of Apple events swallows up the initial
@@ -1006,16 +1390,67 @@ _pyi_main_onedir_or_onefile_child(struct PYI_CONTEXT *pyi_ctx)
 /**********************************************************************\
  *                      Onefile parent codepath                       *
 \**********************************************************************/
+/* Reduce the memory footprint of onefile parent process, which has
+ * nothing to do while the child process is running, apart from
+ * (optionally) displaying the splash screen and extracting the data
+ * files in the background:
+ *  - the archive (TOC, its indices, and the memory mapping) is freed,
+ *    unless the background extraction is running; the cleanup needs
+ *    only the paths that are stored in PYI_CONTEXT.
+ *  - the splash screen resources that were read from the archive are
+ *    freed; the running splash screen keeps its own copy of the image.
+ *  - the start-up arena (copies of environment variables) is released.
+ *  - the freed heap memory is returned to the operating system.
+ */
+static void
+_pyi_main_onefile_parent_release_memory(struct PYI_CONTEXT *pyi_ctx)
+{
+#if defined(LAUNCH_DEBUG)
+    uint64_t resident_memory = pyi_utils_get_resident_memory();
+#endif
+
+    if (pyi_ctx->background_extraction_state == NULL) {
+        pyi_archive_free(&pyi_ctx->archive);
+    }
+
+    pyi_splash_release_resources(pyi_ctx->splash);
+
+    pyi_arena_release(&pyi_ctx->startup_arena);
+
+    pyi_utils_trim_memory();
+
+#if defined(LAUNCH_DEBUG)
+    PYI_DEBUG(
+        "LOADER: resident memory of parent process: %llu kB before and %llu kB after releasing unused memory.\n",
+        (unsigned long long)(resident_memory / 1024),
+        (unsigned long long)(pyi_utils_get_resident_memory() / 1024)
+    );
+#endif
+}
+
 static int
 _pyi_main_onefile_parent(struct PYI_CONTEXT *pyi_ctx)
 {
     int ret;
 
-    /* Extract files to temporary directory */
-    PYI_DEBUG("LOADER: extracting files to temporary directory...\n");
-    if (pyi_launch_extract_files_from_archive(pyi_ctx) < 0) {
-        PYI_DEBUG("LOADER: failed to extract files!\n");
-        return -1;
+    /* Extract files to temporary directory, unless they are already
+     * available in the extraction cache. */
+    if (pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_HIT) {
+        PYI_DEBUG("LOADER: using files from extraction cache...\n");
+    } else if (pyi_ctx->archive->toc_fsimage != NULL) {
+        PYI_DEBUG("LOADER: setting up embedded filesystem image...\n");
+        if (pyi_fsimage_setup(pyi_ctx) < 0) {
+            /* Do not leave the (empty or partially unpacked) temporary
+             * directory behind. */
+            pyi_main_onefile_parent_cleanup(pyi_ctx);
+            return -1;
+        }
+    } else {
+        PYI_DEBUG("LOADER: extracting files to temporary directory...\n");
+        if (pyi_launch_extract_files_from_archive(pyi_ctx) < 0) {
+            PYI_DEBUG("LOADER: failed to extract files!\n");
+            return -1;
+        }
     }
 
     /* At this point, extraction to temporary directory is complete,
@@ -1025,6 +1460,26 @@ _pyi_main_onefile_parent(struct PYI_CONTEXT *pyi_ctx)
     pyi_win32_free_security_descriptor(&pyi_ctx->security_attr);
 #endif
 
+    /* In the case of extraction cache miss, move the populated staging
+     * directory into the cache before the child process is started, so
+     * that the child process runs from the final location, and that
+     * other instances of the program that are launched while this one
+     * is running already find the cache entry. If the splash screen
+     * uses the Tcl/Tk backend, it keeps the Tcl/Tk shared libraries
+     * (which cannot be moved on Windows) and its script library in the
+     * staging directory; in that case, the directory is moved after the
+     * child process exits. If moving fails, the child process runs from
+     * the staging directory, and the move is retried during cleanup. */
+    if (pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_MISS &&
+        !(pyi_ctx->splash != NULL && pyi_ctx->splash->backend == PYI_SPLASH_BACKEND_TCLTK) &&
+        pyi_cache_commit_application_directory(pyi_ctx) == 0) {
+        PYI_DEBUG("LOADER: setting _PYI_APPLICATION_HOME_DIR to %s\n", pyi_ctx->application_home_dir);
+        if (pyi_setenv("_PYI_APPLICATION_HOME_DIR", pyi_ctx->application_home_dir) < 0) {
+            PYI_ERROR("Failed to set application home directory via environment variable!\n");
+            return -1;
+        }
+    }
+
     /* Late console hiding/minimization */
 #if defined(_WIN32) && !defined(WINDOWED)
     if (pyi_ctx->hide_console == PYI_HIDE_CONSOLE_HIDE_LATE) {
@@ -1073,9 +1528,31 @@ _pyi_main_onefile_parent(struct PYI_CONTEXT *pyi_ctx)
     }
 #endif
 
+    /* Start background extraction of lazily-extracted data files; this
+     * overlaps their extraction with the start-up of the child process.
+     * Failure to start it is not fatal, as the child process extracts
+     * the files on demand. */
+    if (pyi_ctx->background_extraction) {
+        pyi_launch_start_background_extraction(pyi_ctx);
+    }
+
+    /* Release the memory that is not needed while waiting for the
+     * child process. */
+    _pyi_main_onefile_parent_release_memory(pyi_ctx);
+
+    /* Start removing the temporary directories that previous launches
+     * deferred for removal; the removal runs in the background while
+     * the child process runs. */
+    if (pyi_ctx->deferred_cleanup && pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_NONE) {
+        pyi_trash_start_sweep(pyi_ctx);
+    }
+
     /* Start the child process that will execute user's program. */
     PYI_DEBUG("LOADER: starting the child process...\n");
+    pyi_stats_export_to_child(pyi_ctx);
+    pyi_trace_begin("pyi_utils_create_child", NULL);
     ret = pyi_utils_create_child(pyi_ctx);
+    pyi_trace_end("pyi_utils_create_child");
 
     PYI_DEBUG("LOADER: child process exited (return code: %d)\n", ret);
 
@@ -1087,14 +1564,18 @@ _pyi_main_onefile_parent(struct PYI_CONTEXT *pyi_ctx)
      *
      * If cleanup failed (and this is considered error; see the
      * implementation), modify the exit code. */
+    pyi_trace_begin("pyi_main_onefile_parent_cleanup", NULL);
     if (pyi_main_onefile_parent_cleanup(pyi_ctx) < 0) {
         ret = -1;
     }
+    pyi_trace_end("pyi_main_onefile_parent_cleanup");
 
     /* Re-raise child's signal, if necessary (POSIX only) */
 #ifndef _WIN32
     if (pyi_ctx->child_signalled) {
         PYI_DEBUG("LOADER: re-raising child signal %d\n", pyi_ctx->child_signal);
+        pyi_trace_flush(); /* The signal might terminate the process */
+        pyi_debuglog_flush();
         raise(pyi_ctx->child_signal);
     }
 #endif
@@ -1110,12 +1591,52 @@ int pyi_main_onefile_parent_cleanup(struct PYI_CONTEXT *pyi_ctx)
     int cleanup_status;
     int ret = 0;
 
+    /* Stop the background extraction before the application directory
+     * is removed or moved into the extraction cache. */
+    pyi_launch_stop_background_extraction(pyi_ctx);
+    pyi_launch_cleanup_cold_archive(pyi_ctx);
+
+    /* Stop the removal of previously deferred temporary directories;
+     * whatever it did not get to is left for the next launch. */
+    pyi_trash_stop_sweep(pyi_ctx);
+
     /* Finalize splash screen before temp directory gets wiped, since the splash
      * screen might hold handles to shared libraries inside the temp dir. Those
      * wouldn't be removed, leaving the temp folder behind. */
     pyi_splash_finalize(pyi_ctx->splash);
     pyi_splash_context_free(&pyi_ctx->splash);
 
+    /* Unmount the filesystem image, so that the (then empty) temporary
+     * directory can be removed below. If that fails, the directory is
+     * left in place, as it cannot be removed while mounted. */
+    if (pyi_fsimage_cleanup(pyi_ctx) < 0) {
+        pyi_archive_free(&pyi_ctx->archive);
+        return pyi_ctx->strict_unpack_mode ? -1 : 0;
+    }
+
+    /* If extraction cache is used, keep the application directory; in
+     * the case of cache miss (i.e., the staging directory could not be
+     * moved into the cache before the child process was started), move
+     * the staging directory into the cache now. If the latter fails
+     * (e.g., because another instance of the program has already
+     * populated the cache), remove the staging directory in the same
+     * way as temporary directory. */
+    if (pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_HIT ||
+        (pyi_ctx->extraction_cache_state == PYI_EXTRACTION_CACHE_MISS && pyi_cache_commit_application_directory(pyi_ctx) == 0)) {
+        PYI_DEBUG("LOADER: keeping application directory in extraction cache: %s\n", pyi_ctx->extraction_cache_dir);
+        pyi_archive_free(&pyi_ctx->archive);
+        return 0;
+    }
+
+    /* With deferred clean-up, move the temporary directory aside, so
+     * that the next launch removes it. If that fails, remove it in the
+     * usual way. */
+    if (pyi_ctx->deferred_cleanup && pyi_trash_move_application_directory(pyi_ctx) == 0) {
+        PYI_DEBUG("LOADER: deferred removal of temporary directory: %s\n", pyi_ctx->application_home_dir);
+        pyi_archive_free(&pyi_ctx->archive);
+        return 0;
+    }
+
     /* Remove the application's temporary directory */
     PYI_DEBUG("LOADER: removing temporary directory: %s\n", pyi_ctx->application_home_dir);
     cleanup_status = pyi_recursive_rmdir(pyi_ctx->application_home_dir);
@@ -1418,14 +1939,81 @@ _pyi_allow_pkg_sideload(const char *executable)
     return 0;
 }
 
+/*
+ * Request the read-ahead of the parts of the PKG archive that this
+ * process is going to read, so that the operating system can stream
+ * them in large sequential reads while the bootloader is still setting
+ * up, instead of faulting in the pages on demand during extraction and
+ * module import. Called once the run-time options are read and the
+ * process level is known.
+ *
+ * Only the onefile parent process that is about to extract the whole
+ * archive reads ahead all of it; when it uses the extraction cache,
+ * lazy extraction, or the filesystem image, most of the archive is
+ * likely never read, so reading it ahead would just waste I/O and page
+ * cache (which, with large data files, can amount to gigabytes in each
+ * spawned sub-process). All other processes read ahead only the hot
+ * prefix of the archive, if it was laid out according to an access
+ * profile, or otherwise the bootstrap modules, scripts, and PYZ
+ * archives.
+ */
+static void
+_pyi_main_readahead_pkg_archive(const struct PYI_CONTEXT *pyi_ctx)
+{
+    const struct ARCHIVE *archive = pyi_ctx->archive;
+    const struct TOC_ENTRY *const *toc_entries;
+    size_t num_entries;
+    uint64_t start = UINT64_MAX;
+    uint64_t end = 0;
+    size_t i;
+    int group;
+
+    if (pyi_ctx->is_onefile && pyi_ctx->process_level == PYI_PROCESS_LEVEL_PARENT) {
+        pyi_archive_get_toc_group(archive, ARCHIVE_TOC_GROUP_LAZY_DATA, &num_entries);
+        if (!pyi_ctx->use_extraction_cache && num_entries == 0 && archive->toc_fsimage == NULL) {
+            pyi_archive_readahead(archive, 0, archive->pkg_length);
+            return;
+        }
+    }
+
+    if (pyi_ctx->hot_prefix_length > 0) {
+        pyi_archive_readahead(archive, 0, pyi_ctx->hot_prefix_length);
+        return;
+    }
+
+    /* The bootstrap modules, scripts, and PYZ archives are written
+     * next to each other, so they are read ahead as a single range. */
+    for (group = ARCHIVE_TOC_GROUP_MODULES; group <= ARCHIVE_TOC_GROUP_PYZ; group++) {
+        toc_entries = pyi_archive_get_toc_group(archive, group, &num_entries);
+        for (i = 0; i < num_entries; i++) {
+            if (toc_entries[i]->offset < start) {
+                start = toc_entries[i]->offset;
+            }
+            if (toc_entries[i]->offset + toc_entries[i]->length > end) {
+                end = toc_entries[i]->offset + toc_entries[i]->length;
+            }
+        }
+    }
+    if (start < end) {
+        pyi_archive_readahead(archive, start, end - start);
+    }
+}
+
 static int
 _pyi_main_resolve_pkg_archive(struct PYI_CONTEXT *pyi_ctx)
 {
+    const char *archive_hint;
     int status;
 
+    /* If we were spawned by a process of the same program, it passed us
+     * the location of the archive's cookie, so that we do not need to
+     * search for it. The hint is validated against the identity of the
+     * archive file, so a stale or foreign hint is simply ignored. */
+    archive_hint = pyi_arena_getenv(&pyi_ctx->startup_arena, "_PYI_ARCHIVE_HINT");
+
     /* Try opening embedded archive first */
     PYI_DEBUG("LOADER: trying to load executable-embedded archive...\n");
-    pyi_ctx->archive = pyi_archive_open(pyi_ctx->executable_filename);
+    pyi_ctx->archive = pyi_archive_open_with_hint(pyi_ctx->executable_filename, archive_hint);
     if (pyi_ctx->archive != NULL) {
         /* Copy executable filename to archive filename; we know it does not exceed PYI_PATH_MAX */
         snprintf(pyi_ctx->archive_filename, PYI_PATH_MAX, "%s", pyi_ctx->executable_filename);
@@ -1459,7 +2047,7 @@ _pyi_main_resolve_pkg_archive(struct PYI_CONTEXT *pyi_ctx)
 
     PYI_DEBUG("LOADER: trying to load external PKG archive (%s)...\n", pyi_ctx->archive_filename);
 
-    pyi_ctx->archive = pyi_archive_open(pyi_ctx->archive_filename);
+    pyi_ctx->archive = pyi_archive_open_with_hint(pyi_ctx->archive_filename, archive_hint);
     if (pyi_ctx->archive == NULL) {
         PYI_ERROR(
             "Could not side-load PyInstaller's PKG archive from external file (%s)\n",
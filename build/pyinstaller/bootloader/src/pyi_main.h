@@ -15,6 +15,8 @@
 #define PYI_MAIN_H
 
 #include "pyi_global.h"
+#include "pyi_arena.h"
+#include "pyi_stats.h"
 
 #ifndef _WIN32
     #include <sys/types.h> /* pid_t */
@@ -24,6 +26,10 @@
 struct ARCHIVE;
 struct SPLASH_CONTEXT;
 struct DYLIB_PYTHON;
+struct DYLIB_PYTHON_LOADER;
+struct PYI_BACKGROUND_EXTRACTION;
+struct PYI_PYZ_PREFETCH;
+struct PYI_COLD_ARCHIVE;
 
 #if defined(__APPLE__) && defined(WINDOWED)
 struct APPLE_EVENT_HANDLER_CONTEXT;
@@ -52,6 +58,44 @@ enum PYI_HIDE_CONSOLE
 #endif
 
 
+/* Name of the file in the application's top-level directory that lists
+ * the bundled shared libraries to preload in no-restart mode (onedir
+ * only; in onefile mode, they are listed by `pyi-preload-library`
+ * run-time options). One name per line, in load order. */
+#define PYI_PRELOAD_LIST_FILENAME "pyi-preload-libraries.txt"
+
+
+/* Extraction cache states (onefile parent process only) */
+enum PYI_EXTRACTION_CACHE_STATE
+{
+    /* Extraction cache is not used; the application is unpacked into
+     * an ephemeral temporary directory. */
+    PYI_EXTRACTION_CACHE_NONE = 0,
+    /* Application directory was found in the extraction cache; the
+     * extraction is skipped. */
+    PYI_EXTRACTION_CACHE_HIT = 1,
+    /* Application directory was not found in the extraction cache;
+     * the application is unpacked into a staging directory, which is
+     * moved into the cache after the application exits. */
+    PYI_EXTRACTION_CACHE_MISS = 2
+};
+
+
+/* Filesystem image states (onefile parent process only) */
+enum PYI_FSIMAGE_STATE
+{
+    /* The archive contains no filesystem image, or it was not set up
+     * (yet). */
+    PYI_FSIMAGE_NONE = 0,
+    /* The image is mounted on the application's top-level directory
+     * (via squashfuse), and needs to be unmounted during clean-up. */
+    PYI_FSIMAGE_MOUNTED = 1,
+    /* The image could not be mounted, and was unpacked into the
+     * application's top-level directory (via unsquashfs) instead. */
+    PYI_FSIMAGE_UNPACKED = 2
+};
+
+
 /* Process levels */
 enum PYI_PROCESS_LEVEL
 {
@@ -182,6 +226,18 @@ struct PYI_CONTEXT
      * to imported functions. */
     struct DYLIB_PYTHON *dylib_python;
 
+    /* State of the background loading of python shared library, which
+     * is started as soon as the application's top-level directory is
+     * known, and finished (joined) before the interpreter is configured;
+     * NULL if not started (or already finished). */
+    struct DYLIB_PYTHON_LOADER *dylib_python_loader;
+
+    /* Arena for transient startup allocations (copies of environment
+     * variable values, parsed run-time options); released once the
+     * python interpreter is initialized, or in the onefile parent
+     * process, once the files are extracted. See pyi_arena.c. */
+    struct PYI_ARENA startup_arena;
+
     /* Strict unpack mode for onefile builds. This flag is dynamically
      * controlled by `PYINSTALLER_STRICT_UNPACK_MODE` environment variable
      * (enabled by a value different from 0). If enabled, extraction of
@@ -192,6 +248,107 @@ struct PYI_CONTEXT
      * PyInstaller's CI. */
     unsigned char strict_unpack_mode;
 
+    /* Number of worker threads used for extraction of onefile builds.
+     * This is dynamically controlled by `PYINSTALLER_EXTRACTION_THREADS`
+     * environment variable; if not set, it defaults to the number of
+     * available processors (capped to PYI_LAUNCH_MAX_EXTRACTION_THREADS).
+     * A value of 1 (or 0) disables parallel extraction. */
+    int extraction_threads;
+
+    /* Persistent extraction cache for onefile builds. Enabled via the
+     * `pyi-extraction-cache` run-time option, and can be overridden by
+     * `PYINSTALLER_EXTRACTION_CACHE` environment variable (0 disables,
+     * any other value enables). See pyi_cache.c for details. */
+    unsigned char use_extraction_cache;
+
+    /* Background extraction of lazily-extracted data files in onefile
+     * builds; enabled via the `pyi-background-extraction` run-time
+     * option. The parent process extracts the files in a background
+     * thread while the child process runs. */
+    unsigned char background_extraction;
+
+    /* Extraction of binaries into memory-backed files in onefile builds
+     * (Linux only); enabled via the `pyi-memfd-binaries` run-time option.
+     * The binaries are loaded via /proc/self/fd/N paths, to which the
+     * symbolic links in the application's temporary directory point.
+     * See pyi_launch.c for details. */
+    unsigned char memfd_binaries;
+
+    /* State of the background extraction; NULL if not running. See
+     * pyi_launch.c for details. */
+    struct PYI_BACKGROUND_EXTRACTION *background_extraction_state;
+
+    /* Deferred clean-up of the temporary directory in onefile builds;
+     * enabled via the `pyi-deferred-cleanup` run-time option. Instead of
+     * being removed, the directory is moved aside and removed by the next
+     * launch of the program. See pyi_trash.c for details. */
+    unsigned char deferred_cleanup;
+
+    /* State of the background removal of previously deferred temporary
+     * directories; NULL if not running. */
+    struct PYI_TRASH_SWEEP *trash_sweep_state;
+
+    /* Shared dependency store for multi-package builds; enabled via the
+     * `pyi-shared-dependency-store` run-time option. The dependencies
+     * referenced from other programs' archives are extracted once into
+     * a per-user store, and cloned (hard-linked) into the application's
+     * directory. See pyi_cache.c for details. */
+    unsigned char shared_dependency_store;
+
+    /* Resident fork server; enabled via the `pyi-fork-server` run-time
+     * option. Later launches of the program are delegated to the server,
+     * which forks the application process from an already-initialized
+     * python interpreter. See pyi_forkserver.c for details. */
+    unsigned char fork_server;
+
+    /* Time (in seconds) after which an idle fork server exits. */
+    unsigned int fork_server_idle_timeout;
+
+    /* Path to the socket that the fork server listens on; set only in
+     * the main process of the fork server. */
+    char fork_server_socket[PYI_PATH_MAX];
+
+    /* Verification of extracted data against the checksums stored in
+     * the archive; enabled via the `pyi-verify-checksums` run-time
+     * option. With extraction cache, the files of an existing cache
+     * entry are also validated before being re-used. */
+    unsigned char verify_checksums;
+
+    /* No-restart mode; enabled via the `pyi-no-restart` run-time option
+     * (Linux and other POSIX systems except macOS and Cygwin). Instead
+     * of restarting itself to put the modified `LD_LIBRARY_PATH` into
+     * effect, the onedir process (or the onefile parent process with
+     * splash screen) preloads the bundled shared libraries by their
+     * absolute path. */
+    unsigned char no_restart;
+
+    /* Length of the leading part of the PKG archive that contains the
+     * entries accessed during the startup; read from the
+     * `pyi-hot-prefix-length` run-time option. Zero if the archive was not laid out according to an
+     * access profile. */
+    uint64_t hot_prefix_length;
+
+    /* State of the background prefetch of the PYZ archive's hot entries;
+     * NULL if not running. See pyi_pyz_prefetch.c for details. */
+    struct PYI_PYZ_PREFETCH *pyz_prefetch_state;
+
+    /* State of the cold archive, which is opened when the first of its
+     * entries is extracted; NULL if the program has no cold archive.
+     * See pyi_launch.c for details. */
+    struct PYI_COLD_ARCHIVE *cold_archive;
+
+    /* State of the extraction cache; see PYI_EXTRACTION_CACHE_STATE. */
+    unsigned char extraction_cache_state;
+
+    /* State of the embedded filesystem image; see PYI_FSIMAGE_STATE
+     * and pyi_fsimage.c. */
+    unsigned char fsimage_state;
+
+    /* Path to application's directory in the extraction cache. In the
+     * case of cache miss, `application_home_dir` points to the staging
+     * directory, which is renamed into this path during cleanup. */
+    char extraction_cache_dir[PYI_PATH_MAX];
+
 #if !defined(_WIN32)
     /* Path to the dynamic linker/loader; if executable is launched
      * via explicitly specified dynamic linker/loader (for example,
@@ -272,12 +429,27 @@ struct PYI_CONTEXT
      * the `archive` structure! */
     const char *runtime_tmpdir;
 
+    /* Set if runtime_tmpdir option was set to `auto`, in which case
+     * `runtime_tmpdir` is left unset. On Linux, the temporary directory
+     * is then created on a RAM-backed file system ($XDG_RUNTIME_DIR or
+     * /dev/shm) if the application fits there (see pyi_utils_posix.c);
+     * otherwise, and on other platforms, the standard locations are used. */
+    unsigned char runtime_tmpdir_auto;
+
     /* Contents sub-directory in onedir builds.
      *
      * NOTE: if non-NULL, the pointer points at the TOC buffer entry in
      * the `archive` structure! */
     const char *contents_subdirectory;
 
+    /* Name of the cold archive (a side-loaded PKG archive next to the
+     * executable, holding the data of lazily-extracted entries that are
+     * not stored in the main archive); NULL if the program has none.
+     *
+     * NOTE: if non-NULL, the pointer points at the TOC buffer entry in
+     * the `archive` structure! */
+    const char *cold_archive_name;
+
     /* Console hiding/minimization options for Windows console builds. */
 #if defined(_WIN32) && !defined(WINDOWED)
     unsigned char hide_console;
@@ -319,6 +491,9 @@ struct PYI_CONTEXT
      * field. */
     unsigned char nogil_enabled;
 
+    /* Run-time statistics, published as sys._pyi_stats. */
+    struct PYI_STATS stats;
+
     /**
      * Apple Events handling in macOS .app bundles
      */
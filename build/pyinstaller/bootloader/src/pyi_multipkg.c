@@ -21,9 +21,11 @@
 #include "pyi_multipkg.h"
 #include "pyi_main.h"
 #include "pyi_archive.h"
+#include "pyi_cache.h"
 #include "pyi_path.h"
 #include "pyi_utils.h"
 
+#if !defined(PYI_WITHOUT_MULTIPKG)
 
 /* Constructs the file path from given components and checks that the path exists.
  * Returns true (1) if it exists, false (0) otherwise. Returns -1 on error. */
@@ -118,6 +120,7 @@ _get_archive(struct PYI_CONTEXT *pyi_ctx, struct ARCHIVE **archive_pool, const c
 int
 pyi_multipkg_extract_dependency(
     struct PYI_CONTEXT *pyi_ctx,
+    struct ARCHIVE_SESSION *session,
     struct ARCHIVE **archive_pool,
     const char *other_executable,
     const char *dependency_name,
@@ -184,10 +187,18 @@ pyi_multipkg_extract_dependency(
     }
     if (ret == true) {
         PYI_DEBUG("LOADER: file %s found on filesystem (%s), assuming onedir reference.\n", dependency_name, full_srcpath);
-        if (pyi_copy_file(full_srcpath, output_filename) == -1) {
+        /* With shared dependency store enabled, the other program's
+         * directory serves as the store; try to link the file. */
+        if (pyi_ctx->shared_dependency_store) {
+            ret = pyi_clone_file(full_srcpath, output_filename);
+        } else {
+            ret = pyi_copy_file(full_srcpath, output_filename);
+        }
+        if (ret == -1) {
             PYI_ERROR("Failed to copy file %s from %s!\n", dependency_name, full_srcpath);
             return -1;
         }
+        pyi_stats_add(&global_pyi_ctx->stats.files_created, 1);
     } else {
         struct ARCHIVE *other_archive = NULL;
         char other_archive_path[PYI_PATH_MAX];
@@ -221,8 +232,15 @@ pyi_multipkg_extract_dependency(
             return -1; /* Entry not found */
         }
 
+        /* With shared dependency store enabled, materialize the dependency
+         * in the store (if necessary) and clone it from there. On failure,
+         * fall back to extracting it directly. */
+        if (pyi_ctx->shared_dependency_store && pyi_cache_extract_shared_dependency(pyi_ctx, session, other_archive, toc_entry, output_filename) == 0) {
+            return 0;
+        }
+
         /* Extract */
-        if (pyi_archive_extract2fs(other_archive, toc_entry, output_filename) < 0) {
+        if (pyi_archive_session_extract2fs(session, other_archive, toc_entry, output_filename) < 0) {
             PYI_ERROR("Failed to extract %s from referenced dependency archive %s.\n", dependency_name, other_archive_path);
             return -1;
         }
@@ -230,3 +248,31 @@ pyi_multipkg_extract_dependency(
 
     return 0;
 }
+
+#else /* !defined(PYI_WITHOUT_MULTIPKG) */
+
+/* Multi-package support is compiled out of this bootloader variant
+ * (see the lean variants in wscript). PyInstaller does not select such
+ * variant for programs with MERGE dependencies, so this is reached only
+ * if the bootloader was selected manually. */
+int
+pyi_multipkg_split_dependency_string(char *path, char *filename, const char *dependency_string)
+{
+    PYI_ERROR("Dependency %s cannot be resolved: multi-package support is not available in this bootloader variant!\n", dependency_string);
+    return -1;
+}
+
+int
+pyi_multipkg_extract_dependency(
+    struct PYI_CONTEXT *pyi_ctx,
+    struct ARCHIVE_SESSION *session,
+    struct ARCHIVE **archive_pool,
+    const char *other_executable,
+    const char *dependency_name,
+    const char *output_filename
+)
+{
+    return -1;
+}
+
+#endif /* !defined(PYI_WITHOUT_MULTIPKG) */
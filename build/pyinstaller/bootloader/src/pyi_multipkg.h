@@ -19,12 +19,13 @@
 
 struct PYI_CONTEXT;
 struct ARCHIVE;
+struct ARCHIVE_SESSION;
 
 /* Maximum number of allowed archives in multi-package archive pool. */
 #define PYI_MULTIPKG_ARCHIVE_POOL_SIZE 20
 
 int pyi_multipkg_split_dependency_string(char *path, char *filename, const char *dependency_string);
-int pyi_multipkg_extract_dependency(struct PYI_CONTEXT *pyi_ctx, struct ARCHIVE **archive_pool, const char *other_executable, const char *dependency_name, const char *output_filename);
+int pyi_multipkg_extract_dependency(struct PYI_CONTEXT *pyi_ctx, struct ARCHIVE_SESSION *session, struct ARCHIVE **archive_pool, const char *other_executable, const char *dependency_name, const char *output_filename);
 
 #endif /* PYI_MULTIPKG_H */
 
@@ -25,77 +25,11 @@
 #include "pyi_utils.h"
 
 
-/* wcsdup() is unavailable on some (older) platforms, such as Solaris 10. */
-#ifndef HAVE_WCSDUP
-
-static wchar_t *
-wcsdup(const wchar_t *s)
-{
-    size_t len = wcslen(s) + 1;
-    wchar_t *new_s = malloc(len * sizeof(wchar_t));
-    if (new_s) {
-        wcscpy(new_s, s);
-    }
-    return new_s;
-}
-
-#endif
-
-
-/*
- * Clean up and free the PyiRuntimeOptions structure created by
- * pyi_config_parse_runtime_options(). No-op if passed a NULL pointer.
- */
-void
-pyi_runtime_options_free(struct PyiRuntimeOptions *options)
-{
-    int i;
-
-    if (options == NULL) {
-        return;
-    }
-
-    /* Free the wflags array */
-    if (options->num_wflags) {
-        if (options->wflags) {
-            for (i = 0; i < options->num_wflags; i++) {
-                free(options->wflags[i]);
-            }
-        }
-        if (options->wflags_w) {
-            for (i = 0; i < options->num_wflags; i++) {
-                free(options->wflags_w[i]);
-            }
-        }
-    }
-    free(options->wflags);
-    free(options->wflags_w);
-
-    /* Free the Xflags array */
-    if (options->num_xflags) {
-        if (options->xflags) {
-            for (i = 0; i < options->num_xflags; i++) {
-                free(options->xflags[i]);
-            }
-        }
-        if (options->xflags_w) {
-            for (i = 0; i < options->num_xflags; i++) {
-                free(options->xflags_w[i]);
-            }
-        }
-    }
-    free(options->xflags);
-    free(options->xflags_w);
-
-    /* Free options structure itself */
-    free(options);
-}
-
 /*
  * Helper to copy X/W flag for pass-through.
  */
 static int
-_pyi_copy_xwflag(const char *flag, wchar_t **pdest_buf)
+_pyi_copy_xwflag(struct PYI_ARENA *arena, const char *flag, wchar_t **pdest_buf)
 {
     wchar_t flag_w[PYI_PATH_MAX + 1];
 
@@ -106,7 +40,7 @@ _pyi_copy_xwflag(const char *flag, wchar_t **pdest_buf)
     }
 
     /* Copy */
-    *pdest_buf = wcsdup(flag_w);
+    *pdest_buf = pyi_arena_wcsdup(arena, flag_w);
     if (*pdest_buf == NULL) {
         return -1;
     }
@@ -168,123 +102,99 @@ _pyi_match_and_parse_xflag(const char *flag, const char *name, int *dest_var)
 
 /*
  * Allocate the PyiRuntimeOptions structure and populate it based on
- * options found in the PKG archive.
+ * options found in the PKG archive. The `use_pep741` flag selects the
+ * form of pass-through flags for the initialization API that will be
+ * used; the options can thus be read before the python shared library
+ * is loaded. The structure and its contents are allocated from the
+ * given arena, and are freed when the arena is released.
  */
 struct PyiRuntimeOptions *
-pyi_runtime_options_read(const struct PYI_CONTEXT *pyi_ctx)
+pyi_runtime_options_read(const struct PYI_CONTEXT *pyi_ctx, unsigned char use_pep741, struct PYI_ARENA *arena)
 {
     struct PyiRuntimeOptions *options;
     const struct ARCHIVE *archive = pyi_ctx->archive;
-    const struct TOC_ENTRY *toc_entry;
-    int num_wflags = 0;
-    int num_xflags = 0;
+    const struct TOC_ENTRY *const *toc_entries;
+    size_t num_entries;
+    size_t i;
+    const char *entry_name;
     int failed = 0;
 
-    const unsigned char use_pep741 = pyi_ctx->dylib_python->has_pep741;
-
     /* Allocate the structure */
-    options = calloc(1, sizeof(struct PyiRuntimeOptions));
+    options = pyi_arena_alloc(arena, sizeof(struct PyiRuntimeOptions));
     if (options == NULL) {
         return options;
     }
 
     options->utf8_mode = -1; /* default: auto-select based on locale */
 
+    toc_entries = pyi_archive_get_toc_group(archive, ARCHIVE_TOC_GROUP_OPTIONS, &num_entries);
+
+    /* Allocate arrays for W and X flags that are collected for
+     * pass-through; the number of OPTION entries serves as the upper
+     * bound for their count, so that the options can be parsed in a
+     * single pass.
+     *
+     * For PEP 741 codepath, we collect into narrow-char string arrays
+     * (options->wflags and options->xflags). For older PEP 587 codepath,
+     * we convert and collect into wide-char string arrays (options->wflags_w
+     * and options->xflags_w). This minimizes the amount of conversions
+     * and simplifies the configuration code (which can just pass string
+     * arrays to corresponding functions).
+     *
+     * The arena returns a valid (non-NULL) address even for zero-size
+     * allocations, so NULL always indicates allocation failure. */
+    if (use_pep741) {
+        options->wflags = pyi_arena_alloc(arena, num_entries * sizeof(char *));
+        options->xflags = pyi_arena_alloc(arena, num_entries * sizeof(char *));
+        if (options->wflags == NULL || options->xflags == NULL) {
+            failed = 1;
+            goto end;
+        }
+    } else {
+        options->wflags_w = pyi_arena_alloc(arena, num_entries * sizeof(wchar_t *));
+        options->xflags_w = pyi_arena_alloc(arena, num_entries * sizeof(wchar_t *));
+        if (options->wflags_w == NULL || options->xflags_w == NULL) {
+            failed = 1;
+            goto end;
+        }
+    }
+
     /* Parse run-time options from PKG archive */
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
+    for (i = 0; i < num_entries; i++) {
         const char *value_str;
 
-        /* We are only interested in OPTION entries */
-        if (toc_entry->typecode != ARCHIVE_ITEM_RUNTIME_OPTION) {
-            continue;
-        }
+        entry_name = pyi_archive_get_entry_name(toc_entries[i]);
 
         /* Skip bootloader options; these start with "pyi-" */
-        if (strncmp(toc_entry->name, "pyi-", 4) == 0) {
+        if (strncmp(entry_name, "pyi-", 4) == 0) {
             continue;
         }
 
         /* Verbose flag: v, verbose */
-        if (strcmp(toc_entry->name, "v") == 0 || strcmp(toc_entry->name, "verbose") == 0) {
+        if (strcmp(entry_name, "v") == 0 || strcmp(entry_name, "verbose") == 0) {
             options->verbose++;
             continue;
         }
 
         /* Unbuffered flag: u, unbuffered */
-        if (strcmp(toc_entry->name, "u") == 0 || strcmp(toc_entry->name, "unbuffered") == 0) {
+        if (strcmp(entry_name, "u") == 0 || strcmp(entry_name, "unbuffered") == 0) {
             options->unbuffered = 1;
             continue;
         }
 
         /* Optimize flag: O, optimize */
-        if (strcmp(toc_entry->name, "O") == 0 || strcmp(toc_entry->name, "optimize") == 0) {
+        if (strcmp(entry_name, "O") == 0 || strcmp(entry_name, "optimize") == 0) {
             options->optimize++;
             continue;
         }
 
         /* W flag: W <warning_rule> */
-        if (strncmp(toc_entry->name, "W ", 2) == 0) {
-            num_wflags++;
-            continue;
-        }
-
-        /* X flag: X <key=value> */
-        if (strncmp(toc_entry->name, "X ", 2) == 0) {
-            num_xflags++;
-            continue;
-        }
-
-        /* Hash seed flag: hash_seed=value */
-        value_str = _pyi_match_key_value_flag(toc_entry->name, "hash_seed");
-        if (value_str && value_str[0]) {
-            options->use_hash_seed = 1;
-            options->hash_seed = strtoul(value_str, NULL, 10);
-        }
-    }
-
-    /* Collect Wflags and Xflags for pass-through */
-
-    /* For PEP 741 codepath, we collect into narrow-char string arrays
-     * (options->wflags and options->xflags). For older PEP 587 codepath,
-     * we convert and collect into wide-char string arrays (options->wflags_w
-     * and options->xflags_w). This minimizes the amount of conversions
-     * and simplifies the configuration code (which can just pass string
-     * arrays to corresponding functions). */
-
-    /* Allocate - calloc should be safe to call with num = 0.
-     * On most platforms, when called with num = 0, calloc returns a
-     * non-NULL address that should be safe to free. On AIX, though,
-     * it returns NULL (unless _LINUX_SOURCE_COMPAT is defined, but we
-     * cannot have that defined together with _ALL_SOURCE). */
-    if (use_pep741) {
-        options->wflags = calloc(num_wflags, sizeof(char *));
-        options->xflags = calloc(num_xflags, sizeof(char *));
-        if ((num_wflags && options->wflags == NULL) || (num_xflags && options->xflags == NULL)) {
-            failed = 1;
-            goto end;
-        }
-    } else {
-        options->wflags_w = calloc(num_wflags, sizeof(wchar_t *));
-        options->xflags_w = calloc(num_xflags, sizeof(wchar_t *));
-        if ((num_wflags && options->wflags_w == NULL) || (num_xflags && options->xflags_w == NULL)) {
-            failed = 1;
-            goto end;
-        }
-    }
-
-    /* Collect */
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-        /* We are only interested in OPTION entries */
-        if (toc_entry->typecode != ARCHIVE_ITEM_RUNTIME_OPTION) {
-            continue;
-        }
-
-        if (strncmp(toc_entry->name, "W ", 2) == 0) {
+        if (strncmp(entry_name, "W ", 2) == 0) {
             /* Copy for pass-through */
-            const char *flag = &toc_entry->name[2]; /* Skip first two characters */
+            const char *flag = entry_name + 2; /* Skip first two characters */
             if (use_pep741) {
                 /* Copy into narrow-char string array for PEP 741 codepath */
-                char *flag_dup = strdup(flag);
+                char *flag_dup = pyi_arena_strdup(arena, flag);
                 if (flag_dup == NULL) {
                     failed = 1;
                     goto end;
@@ -292,26 +202,30 @@ pyi_runtime_options_read(const struct PYI_CONTEXT *pyi_ctx)
                 options->wflags[options->num_wflags] = flag_dup;
             } else {
                 /* Convert and copy into wide-char string array for PEP 587 codepath */
-                if (_pyi_copy_xwflag(flag, &options->wflags_w[options->num_wflags]) < 0) {
+                if (_pyi_copy_xwflag(arena, flag, &options->wflags_w[options->num_wflags]) < 0) {
                     failed = 1;
                     goto end;
                 }
             }
             options->num_wflags++;
-        } else if (strncmp(toc_entry->name, "X ", 2) == 0) {
+            continue;
+        }
+
+        /* X flag: X <key=value> */
+        if (strncmp(entry_name, "X ", 2) == 0) {
             /* Copy for pass-through */
-            const char *flag = &toc_entry->name[2]; /* Skip first two characters */
+            const char *flag = entry_name + 2; /* Skip first two characters */
             if (use_pep741) {
                 /* Copy into narrow-char string array for PEP 741 codepath */
-                char *flag_dup = strdup(flag);
+                char *flag_dup = pyi_arena_strdup(arena, flag);
                 if (flag_dup == NULL) {
                     failed = 1;
                     goto end;
                 }
-                options->xflags[options->num_wflags] = flag_dup;
+                options->xflags[options->num_xflags] = flag_dup;
             } else {
                 /* Convert and copy into wide-char string array for PEP 587 codepath */
-                if (_pyi_copy_xwflag(flag, &options->xflags_w[options->num_xflags]) < 0) {
+                if (_pyi_copy_xwflag(arena, flag, &options->xflags_w[options->num_xflags]) < 0) {
                     failed = 1;
                     goto end;
                 }
@@ -321,13 +235,20 @@ pyi_runtime_options_read(const struct PYI_CONTEXT *pyi_ctx)
             /* Try matching the utf8 and dev X-flag */
             _pyi_match_and_parse_xflag(flag, "utf8", &options->utf8_mode);
             _pyi_match_and_parse_xflag(flag, "dev", &options->dev_mode);
+            continue;
+        }
+
+        /* Hash seed flag: hash_seed=value */
+        value_str = _pyi_match_key_value_flag(entry_name, "hash_seed");
+        if (value_str && value_str[0]) {
+            options->use_hash_seed = 1;
+            options->hash_seed = strtoul(value_str, NULL, 10);
         }
     }
 
 end:
     /* Clean-up on error */
     if (failed) {
-        pyi_runtime_options_free(options);
         options = NULL;
     }
 
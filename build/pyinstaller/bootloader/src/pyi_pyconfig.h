@@ -24,6 +24,7 @@
 #include "pyi_dylib_python.h"
 
 struct PYI_CONTEXT;
+struct PYI_ARENA;
 
 
 /* Collect run-time options from PKG */
@@ -51,8 +52,7 @@ struct PyiRuntimeOptions
     wchar_t **xflags_w;
 };
 
-struct PyiRuntimeOptions *pyi_runtime_options_read(const struct PYI_CONTEXT *pyi_ctx);
-void pyi_runtime_options_free(struct PyiRuntimeOptions *options);
+struct PyiRuntimeOptions *pyi_runtime_options_read(const struct PYI_CONTEXT *pyi_ctx, unsigned char use_pep741, struct PYI_ARENA *arena);
 
 int pyi_pyconfig_preinit_python(const struct PyiRuntimeOptions *runtime_options, const struct PYI_CONTEXT *pyi_ctx);
 
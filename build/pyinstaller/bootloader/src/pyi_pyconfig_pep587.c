@@ -46,6 +46,7 @@
  * set using PyConfig_SetString. On other systems, PyConfig_SetBytesString
  * is used, which internally calls Py_DecodeLocale.
  */
+#if !defined(PYI_TARGET_PYTHON_VERSION) || PYI_TARGET_PYTHON_VERSION < 314
 static int
 _pyi_pyconfig_set_string(PyConfig *config, wchar_t **dest_field, const char *str, const struct DYLIB_PYTHON *dylib_python)
 {
@@ -65,11 +66,45 @@ _pyi_pyconfig_set_string(PyConfig *config, wchar_t **dest_field, const char *str
 
     return dylib_python->PyStatus_Exception(status) ? -1 : 0;
 }
+#endif
 
 
 /* Helper for creating ID from python version and flags value */
 #define _MAKE_VERSION_ID(version, flags) (version << 1 | flags)
 
+/* The list of supported python versions and build flags, expanded via
+ * the _IMPL_CASE() macro that is defined in each function. Bootloader
+ * variants that are specialized for a single python version (see
+ * PYI_TARGET_PYTHON_VERSION) include only the structure layouts for
+ * that version. */
+#if !defined(PYI_TARGET_PYTHON_VERSION)
+    #define _IMPL_ALL_CASES() \
+        _IMPL_CASE(308, 0, PyConfig_v38) \
+        _IMPL_CASE(309, 0, PyConfig_v39) \
+        _IMPL_CASE(310, 0, PyConfig_v310) \
+        _IMPL_CASE(311, 0, PyConfig_v311) \
+        _IMPL_CASE(312, 0, PyConfig_v312) \
+        _IMPL_CASE(313, 0, PyConfig_v313) \
+        _IMPL_CASE(313, 1, PyConfig_v313_GIL_DISABLED)
+#elif PYI_TARGET_PYTHON_VERSION == 308
+    #define _IMPL_ALL_CASES() _IMPL_CASE(308, 0, PyConfig_v38)
+#elif PYI_TARGET_PYTHON_VERSION == 309
+    #define _IMPL_ALL_CASES() _IMPL_CASE(309, 0, PyConfig_v39)
+#elif PYI_TARGET_PYTHON_VERSION == 310
+    #define _IMPL_ALL_CASES() _IMPL_CASE(310, 0, PyConfig_v310)
+#elif PYI_TARGET_PYTHON_VERSION == 311
+    #define _IMPL_ALL_CASES() _IMPL_CASE(311, 0, PyConfig_v311)
+#elif PYI_TARGET_PYTHON_VERSION == 312
+    #define _IMPL_ALL_CASES() _IMPL_CASE(312, 0, PyConfig_v312)
+#elif PYI_TARGET_PYTHON_VERSION == 313
+    #define _IMPL_ALL_CASES() \
+        _IMPL_CASE(313, 0, PyConfig_v313) \
+        _IMPL_CASE(313, 1, PyConfig_v313_GIL_DISABLED)
+#else
+    /* python >= 3.14 uses PEP 741 API; PEP 587 codepath is unused. */
+    #define _IMPL_ALL_CASES()
+#endif
+
 /*
  * Allocate the PyConfig structure, based on the python version and
  * build flags.
@@ -88,13 +123,7 @@ pyi_pyconfig_pep587_create(const struct PYI_CONTEXT *pyi_ctx)
     /* Macro end */
 
     switch (version_id) {
-        _IMPL_CASE(308, 0, PyConfig_v38)
-        _IMPL_CASE(309, 0, PyConfig_v39)
-        _IMPL_CASE(310, 0, PyConfig_v310)
-        _IMPL_CASE(311, 0, PyConfig_v311)
-        _IMPL_CASE(312, 0, PyConfig_v312)
-        _IMPL_CASE(313, 0, PyConfig_v313)
-        _IMPL_CASE(313, 1, PyConfig_v313_GIL_DISABLED)
+        _IMPL_ALL_CASES()
         default: {
             break;
         }
@@ -146,13 +175,7 @@ pyi_pyconfig_pep587_set_program_name(PyConfig *config, const struct PYI_CONTEXT
     /* Macro end */
 
     switch (version_id) {
-        _IMPL_CASE(308, 0, PyConfig_v38)
-        _IMPL_CASE(309, 0, PyConfig_v39)
-        _IMPL_CASE(310, 0, PyConfig_v310)
-        _IMPL_CASE(311, 0, PyConfig_v311)
-        _IMPL_CASE(312, 0, PyConfig_v312)
-        _IMPL_CASE(313, 0, PyConfig_v313)
-        _IMPL_CASE(313, 1, PyConfig_v313_GIL_DISABLED)
+        _IMPL_ALL_CASES()
         default: {
             break;
         }
@@ -181,13 +204,7 @@ pyi_pyconfig_pep587_set_python_home(PyConfig *config, const struct PYI_CONTEXT *
     /* Macro end */
 
     switch (version_id) {
-        _IMPL_CASE(308, 0, PyConfig_v38)
-        _IMPL_CASE(309, 0, PyConfig_v39)
-        _IMPL_CASE(310, 0, PyConfig_v310)
-        _IMPL_CASE(311, 0, PyConfig_v311)
-        _IMPL_CASE(312, 0, PyConfig_v312)
-        _IMPL_CASE(313, 0, PyConfig_v313)
-        _IMPL_CASE(313, 1, PyConfig_v313_GIL_DISABLED)
+        _IMPL_ALL_CASES()
         default: {
             break;
         }
@@ -225,13 +242,7 @@ _pyi_pyconfig_set_module_search_paths(PyConfig *config, const struct PYI_CONTEXT
     /* Macro end */
 
     switch (version_id) {
-        _IMPL_CASE(308, 0, PyConfig_v38)
-        _IMPL_CASE(309, 0, PyConfig_v39)
-        _IMPL_CASE(310, 0, PyConfig_v310)
-        _IMPL_CASE(311, 0, PyConfig_v311)
-        _IMPL_CASE(312, 0, PyConfig_v312)
-        _IMPL_CASE(313, 0, PyConfig_v313)
-        _IMPL_CASE(313, 1, PyConfig_v313_GIL_DISABLED)
+        _IMPL_ALL_CASES()
         default: {
             break;
         }
@@ -334,13 +345,7 @@ _pyi_pyconfig_set_argv(PyConfig *config, const struct PYI_CONTEXT *pyi_ctx, int
     /* Macro end */
 
     switch (version_id) {
-        _IMPL_CASE(308, 0, PyConfig_v38)
-        _IMPL_CASE(309, 0, PyConfig_v39)
-        _IMPL_CASE(310, 0, PyConfig_v310)
-        _IMPL_CASE(311, 0, PyConfig_v311)
-        _IMPL_CASE(312, 0, PyConfig_v312)
-        _IMPL_CASE(313, 0, PyConfig_v313)
-        _IMPL_CASE(313, 1, PyConfig_v313_GIL_DISABLED)
+        _IMPL_ALL_CASES()
         default: {
             break;
         }
@@ -490,13 +495,7 @@ pyi_pyconfig_pep587_set_runtime_options(PyConfig *config, const struct PYI_CONTE
     /* Macro end */
 
     switch (version_id) {
-        _IMPL_CASE(308, 0, PyConfig_v38)
-        _IMPL_CASE(309, 0, PyConfig_v39)
-        _IMPL_CASE(310, 0, PyConfig_v310)
-        _IMPL_CASE(311, 0, PyConfig_v311)
-        _IMPL_CASE(312, 0, PyConfig_v312)
-        _IMPL_CASE(313, 0, PyConfig_v313)
-        _IMPL_CASE(313, 1, PyConfig_v313_GIL_DISABLED)
+        _IMPL_ALL_CASES()
         default: {
             break;
         }
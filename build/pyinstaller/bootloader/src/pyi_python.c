@@ -18,37 +18,35 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h> /* free() */
+#include <limits.h> /* UINT_MAX */
 
 /* PyInstaller headers. */
 #include "pyi_python.h"
 #include "pyi_global.h"
+#include "pyi_access_profile.h"
 #include "pyi_path.h"
 #include "pyi_archive.h"
+#include "pyi_launch.h"
 #include "pyi_main.h"
 #include "pyi_utils.h"
 #include "pyi_dylib_python.h"
 #include "pyi_pyconfig.h"
+#include "pyi_pyz_prefetch.h"
+#include "pyi_stats.h"
+#include "zlib.h"
 
 
 /*
  * Initialize and start python interpreter.
  */
 int
-pyi_python_start_interpreter(const struct PYI_CONTEXT *pyi_ctx)
+pyi_python_start_interpreter(const struct PYI_CONTEXT *pyi_ctx, const struct PyiRuntimeOptions *runtime_options)
 {
     const struct DYLIB_PYTHON *dylib_python = pyi_ctx->dylib_python;
-    struct PyiRuntimeOptions *runtime_options = NULL;
     PyConfig *config_pep587 = NULL; /* Config structure used in PEP 587 codepath */
     PyInitConfig *config_pep741 = NULL; /* Config structure used in PEP 741 codepath */
     int ret = -1;
 
-    /* Read run-time options */
-    runtime_options = pyi_runtime_options_read(pyi_ctx);
-    if (runtime_options == NULL) {
-        PYI_ERROR("Failed to parse run-time options!\n");
-        goto end;
-    }
-
     /* Pre-initialize python. This ensures that PEP 540 UTF-8 mode is enabled
      * if necessary. */
     PYI_DEBUG("LOADER: pre-initializing embedded python interpreter...\n");
@@ -58,7 +56,7 @@ pyi_python_start_interpreter(const struct PYI_CONTEXT *pyi_ctx)
     }
 
     /* Set up python configuration. */
-    if (dylib_python->has_pep741) {
+    if (PYI_DYLIB_PYTHON_HAS_PEP741(dylib_python)) {
         /* PEP 741 codepath */
         PYI_DEBUG("LOADER: using PEP-741 API...\n");
 
@@ -169,7 +167,7 @@ pyi_python_start_interpreter(const struct PYI_CONTEXT *pyi_ctx)
         fflush(stderr);
     }
 
-    if (dylib_python->has_pep741) {
+    if (PYI_DYLIB_PYTHON_HAS_PEP741(dylib_python)) {
         /* PEP 741 codepath */
         ret = dylib_python->Py_InitializeFromInitConfig(config_pep741);
         if (ret < 0) {
@@ -205,14 +203,13 @@ pyi_python_start_interpreter(const struct PYI_CONTEXT *pyi_ctx)
     }
 
 end:
-    if (dylib_python->has_pep741) {
+    if (PYI_DYLIB_PYTHON_HAS_PEP741(dylib_python)) {
         /* PEP 741 codepath */
         dylib_python->PyInitConfig_Free(config_pep741);
     } else {
         /* PEP 587 codepath */
         pyi_pyconfig_pep587_free(config_pep587, pyi_ctx);
     }
-    pyi_runtime_options_free(runtime_options);
     return ret;
 }
 
@@ -224,8 +221,11 @@ pyi_python_import_modules(const struct PYI_CONTEXT *pyi_ctx)
 {
     const struct DYLIB_PYTHON *dylib_python = pyi_ctx->dylib_python;
     const struct ARCHIVE *archive = pyi_ctx->archive;
+    const struct TOC_ENTRY *const *toc_entries;
     const struct TOC_ENTRY *toc_entry;
-    unsigned char *data;
+    struct ARCHIVE_BATCH batch;
+    size_t num_entries;
+    size_t i;
     PyObject *co;
     PyObject *mod;
     PyObject *meipass_obj;
@@ -245,30 +245,38 @@ pyi_python_import_modules(const struct PYI_CONTEXT *pyi_ctx)
 
     dylib_python->PySys_SetObject("_MEIPASS", meipass_obj);
 
+    /* Publish the run-time statistics of the bootloader; failure is
+     * not fatal. */
+    PYI_DEBUG("LOADER: setting sys._pyi_stats\n");
+    pyi_stats_publish(pyi_ctx);
+
     PYI_DEBUG("LOADER: importing modules from PKG/CArchive\n");
 
-    /* Iterate through toc looking for module entries (type 'm')
-     * this is normally just bootstrap stuff (archive and iu) */
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-        if (toc_entry->typecode != ARCHIVE_ITEM_PYMODULE && toc_entry->typecode != ARCHIVE_ITEM_PYPACKAGE) {
-            continue;
-        }
+    /* Iterate through module entries (type 'm' and 'M'); this is
+     * normally just bootstrap stuff (archive and iu) */
+    toc_entries = pyi_archive_get_toc_group(archive, ARCHIVE_TOC_GROUP_MODULES, &num_entries);
+
+    /* Extract all modules at once; the batch is released after the
+     * last module is imported. */
+    if (pyi_archive_extract_batch(archive, toc_entries, num_entries, &batch) < 0) {
+        PYI_ERROR("Failed to extract bootstrap modules from archive!\n");
+        return -1;
+    }
 
-        data = pyi_archive_extract(archive, toc_entry);
-        PYI_DEBUG("LOADER: extracted %s\n", toc_entry->name);
+    for (i = 0; i < num_entries; i++) {
+        toc_entry = toc_entries[i];
 
         /* Unmarshal the stored code object */
-        co = dylib_python->PyMarshal_ReadObjectFromString((const char *)data, toc_entry->uncompressed_length);
-        free(data);
+        co = dylib_python->PyMarshal_ReadObjectFromString((const char *)batch.arena + batch.offsets[i], toc_entry->uncompressed_length);
 
         if (co == NULL) {
-            PYI_ERROR("Failed to unmarshal code object for module %s!\n", toc_entry->name);
+            PYI_ERROR("Failed to unmarshal code object for module %s!\n", pyi_archive_get_entry_name(toc_entry));
             mod = NULL;
         } else {
-            PYI_DEBUG("LOADER: running unmarshalled code object for module %s...\n", toc_entry->name);
-            mod = dylib_python->PyImport_ExecCodeModule(toc_entry->name, co);
+            PYI_DEBUG("LOADER: running unmarshalled code object for module %s...\n", pyi_archive_get_entry_name(toc_entry));
+            mod = dylib_python->PyImport_ExecCodeModule(pyi_archive_get_entry_name(toc_entry), co);
             if (mod == NULL) {
-                PYI_ERROR("Module object for %s is NULL!\n", toc_entry->name);
+                PYI_ERROR("Module object for %s is NULL!\n", pyi_archive_get_entry_name(toc_entry));
             }
         }
 
@@ -279,13 +287,150 @@ pyi_python_import_modules(const struct PYI_CONTEXT *pyi_ctx)
 
         /* Exit on error */
         if (mod == NULL) {
+            pyi_archive_batch_free(&batch);
             return -1;
         }
     }
 
+    pyi_archive_batch_free(&batch);
+
     return 0;
 }
 
+/* Data of the memory-mapped PYZ archive, used by the native PYZ code
+ * loader; set up by pyi_python_install_pyz(). */
+static const unsigned char *_pyi_python_pyz_data = NULL;
+static uint64_t _pyi_python_pyz_data_length = 0;
+
+/* Preset compression dictionary of the PYZ archive (format version 2),
+ * which immediately follows the archive's header. NULL if the archive
+ * does not use one. */
+static const unsigned char *_pyi_python_pyz_zdict = NULL;
+static uInt _pyi_python_pyz_zdict_length = 0;
+
+/*
+ * Native PYZ code loader, exposed to python as a built-in function
+ * _pyinstaller_pyz_load_code(name, offset, length). Inflates the PYZ
+ * entry's data blob directly from the memory-mapped archive, and
+ * unmarshals the code object from the decompressed data, without
+ * creating intermediate bytes objects. If the entry was decompressed by
+ * the background prefetch (see pyi_pyz_prefetch.c), its data is only
+ * unmarshalled. The name is used only in error messages. Raises
+ * ImportError if the data cannot be decompressed.
+ */
+static PyObject *
+_pyi_python_pyz_load_code(PyObject *self, PyObject *args)
+{
+    const struct DYLIB_PYTHON *dylib_python = global_pyi_ctx->dylib_python;
+    const char *name;
+    unsigned long long offset;
+    unsigned long long length;
+    z_stream zstream;
+    unsigned char *buffer = NULL;
+    size_t buffer_size;
+    PyObject *code = NULL;
+    int rc;
+
+    if (!dylib_python->PyArg_ParseTuple(args, "sKK", &name, &offset, &length)) {
+        return NULL;
+    }
+
+    if (offset > _pyi_python_pyz_data_length || length > _pyi_python_pyz_data_length - offset || length > UINT_MAX) {
+        dylib_python->PyErr_Format(*dylib_python->PyExc_ImportError, "Invalid data location for PYZ entry %s!", name);
+        return NULL;
+    }
+
+    buffer = pyi_pyz_prefetch_take(global_pyi_ctx->pyz_prefetch_state, offset, length, &buffer_size);
+    if (buffer != NULL) {
+        code = dylib_python->PyMarshal_ReadObjectFromString((const char *)buffer, (Py_ssize_t)buffer_size);
+        free(buffer);
+        return code;
+    }
+
+    /* The length of uncompressed data is not stored in PYZ TOC; start
+     * with an estimate, and grow the buffer as necessary. */
+    buffer_size = (size_t)length * 4;
+    if (buffer_size < 4096) {
+        buffer_size = 4096;
+    }
+    buffer = (unsigned char *)malloc(buffer_size);
+    if (buffer == NULL) {
+        return dylib_python->PyErr_NoMemory();
+    }
+
+    memset(&zstream, 0, sizeof(zstream));
+    zstream.next_in = (unsigned char *)(_pyi_python_pyz_data + offset);
+    zstream.avail_in = (uInt)length;
+
+    if (inflateInit(&zstream) != Z_OK) {
+        free(buffer);
+        dylib_python->PyErr_Format(*dylib_python->PyExc_ImportError, "Failed to initialize decompression of PYZ entry %s!", name);
+        return NULL;
+    }
+
+    for (;;) {
+        size_t remaining = buffer_size - (size_t)zstream.total_out;
+
+        zstream.next_out = buffer + zstream.total_out;
+        zstream.avail_out = remaining > UINT_MAX ? UINT_MAX : (uInt)remaining;
+
+        rc = inflate(&zstream, Z_NO_FLUSH);
+        if (rc == Z_STREAM_END) {
+            break;
+        }
+        if (rc == Z_NEED_DICT && _pyi_python_pyz_zdict != NULL) {
+            /* The entry was compressed with the archive's preset
+             * dictionary; inflateSetDictionary() verifies that the
+             * dictionary's checksum matches. */
+            if (inflateSetDictionary(&zstream, _pyi_python_pyz_zdict, _pyi_python_pyz_zdict_length) != Z_OK) {
+                dylib_python->PyErr_Format(*dylib_python->PyExc_ImportError, "Failed to set compression dictionary for PYZ entry %s!", name);
+                goto cleanup;
+            }
+            continue;
+        }
+        if (rc != Z_OK && rc != Z_BUF_ERROR) {
+            dylib_python->PyErr_Format(*dylib_python->PyExc_ImportError, "Failed to decompress PYZ entry %s!", name);
+            goto cleanup;
+        }
+        if (zstream.avail_out != 0) {
+            /* Output space is available, but no progress can be made;
+             * the input data is truncated. */
+            dylib_python->PyErr_Format(*dylib_python->PyExc_ImportError, "Failed to decompress PYZ entry %s: truncated data!", name);
+            goto cleanup;
+        }
+
+        /* Output buffer is full; grow it */
+        if (buffer_size > SIZE_MAX / 2) {
+            dylib_python->PyErr_NoMemory();
+            goto cleanup;
+        } else {
+            unsigned char *new_buffer = (unsigned char *)realloc(buffer, buffer_size * 2);
+            if (new_buffer == NULL) {
+                dylib_python->PyErr_NoMemory();
+                goto cleanup;
+            }
+            buffer = new_buffer;
+            buffer_size *= 2;
+        }
+    }
+
+    /* Unmarshal the code object; sets python exception on failure. */
+    code = dylib_python->PyMarshal_ReadObjectFromString((const char *)buffer, (Py_ssize_t)zstream.total_out);
+
+cleanup:
+    inflateEnd(&zstream);
+    free(buffer);
+
+    return code;
+}
+
+static PyMethodDef _pyi_python_pyz_load_code_def = {
+    "_pyinstaller_pyz_load_code",
+    _pyi_python_pyz_load_code,
+    METH_VARARGS,
+    NULL
+};
+
 /*
  * Store path and offset to PYZ archive into sys._pyinstaller_pyz
  * attribute, so that our bootstrap python script can set up PYZ
@@ -296,25 +441,28 @@ pyi_python_install_pyz(const struct PYI_CONTEXT *pyi_ctx)
 {
     const struct DYLIB_PYTHON *dylib_python = pyi_ctx->dylib_python;
     const struct ARCHIVE *archive = pyi_ctx->archive;
+    const struct TOC_ENTRY *const *toc_entries;
     const struct TOC_ENTRY *toc_entry;
+    size_t num_entries;
     PyObject *archive_filename_obj;
     PyObject *pyz_path_obj;
     unsigned long long pyz_offset;
+    const unsigned char *pyz_data;
+    PyObject *pyz_data_obj;
+    PyObject *pyz_loader_obj;
     int rc;
     const char *attr_name = "_pyinstaller_pyz";
+    const char *data_attr_name = "_pyinstaller_pyz_data";
 
     PYI_DEBUG("LOADER: looking for PYZ archive TOC entry...\n");
 
-    /* Iterate through TOC and look for PYZ entry (type 'z') */
-    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
-        if (toc_entry->typecode == ARCHIVE_ITEM_PYZ) {
-            break;
-        }
-    }
-    if (toc_entry >= archive->toc_end) {
+    /* Look up the (first) PYZ entry (type 'z') */
+    toc_entries = pyi_archive_get_toc_group(archive, ARCHIVE_TOC_GROUP_PYZ, &num_entries);
+    if (num_entries == 0) {
         PYI_ERROR("PYZ archive entry not found in the TOC!\n");
         return -1;
     }
+    toc_entry = toc_entries[0];
 
     /* Store archive filename as Python string. */
 #ifdef _WIN32
@@ -349,6 +497,211 @@ pyi_python_install_pyz(const struct PYI_CONTEXT *pyi_ctx)
     }
 
     PYI_DEBUG("LOADER: path to PYZ archive stored into sys.%s...\n", attr_name);
+
+    /* If the PYZ archive is available in the PKG archive's memory
+     * mapping, expose its data to the PYZ reader as read-only memoryview,
+     * so that the reader can unmarshal the modules directly from the
+     * mapping instead of re-opening the archive file for each import.
+     * The mapping remains valid until the archive is freed, which
+     * happens only after the interpreter is finalized. */
+    pyi_access_profile_record(pyi_archive_get_entry_name(toc_entry));
+
+    pyz_data = pyi_archive_get_mapped_data(archive, toc_entry);
+    if (pyz_data && toc_entry->compression_flag == ARCHIVE_COMPRESSION_NONE && toc_entry->uncompressed_length <= (uint64_t)(SIZE_MAX / 2)) {
+        pyz_data_obj = dylib_python->PyMemoryView_FromMemory((char *)pyz_data, (Py_ssize_t)toc_entry->uncompressed_length, PyBUF_READ);
+        if (pyz_data_obj == NULL) {
+            /* Not fatal; the reader falls back to reading from file. */
+            dylib_python->PyErr_Clear();
+            return 0;
+        }
+
+        rc = dylib_python->PySys_SetObject(data_attr_name, pyz_data_obj);
+        dylib_python->Py_DecRef(pyz_data_obj);
+        if (rc != 0) {
+            dylib_python->PyErr_Clear();
+            return 0;
+        }
+
+        PYI_DEBUG("LOADER: memory-mapped PYZ archive data stored into sys.%s...\n", data_attr_name);
+
+        /* Expose the native code loader, which reads from the same
+         * memory-mapped data. */
+        _pyi_python_pyz_data = pyz_data;
+        _pyi_python_pyz_data_length = toc_entry->uncompressed_length;
+
+        if (_pyi_python_pyz_data_length >= PYZ_HEADER_LENGTH && pyz_data[PYZ_HEADER_VERSION_OFFSET] >= 2) {
+            const unsigned char *field = pyz_data + PYZ_HEADER_ZDICT_LENGTH_OFFSET;
+            uint32_t zdict_length = ((uint32_t)field[0] << 24) | ((uint32_t)field[1] << 16) | ((uint32_t)field[2] << 8) | (uint32_t)field[3];
+
+            if (zdict_length > 0 && zdict_length <= _pyi_python_pyz_data_length - PYZ_HEADER_LENGTH) {
+                _pyi_python_pyz_zdict = pyz_data + PYZ_HEADER_LENGTH;
+                _pyi_python_pyz_zdict_length = (uInt)zdict_length;
+                PYI_DEBUG("LOADER: PYZ archive uses preset compression dictionary (%u bytes).\n", (unsigned int)zdict_length);
+            }
+        }
+
+        pyz_loader_obj = dylib_python->PyCFunction_NewEx(&_pyi_python_pyz_load_code_def, NULL, NULL);
+        if (pyz_loader_obj == NULL) {
+            dylib_python->PyErr_Clear();
+            return 0;
+        }
+
+        rc = dylib_python->PySys_SetObject(_pyi_python_pyz_load_code_def.ml_name, pyz_loader_obj);
+        dylib_python->Py_DecRef(pyz_loader_obj);
+        if (rc != 0) {
+            dylib_python->PyErr_Clear();
+            return 0;
+        }
+
+        PYI_DEBUG("LOADER: native PYZ code loader stored into sys.%s...\n", _pyi_python_pyz_load_code_def.ml_name);
+    }
+
+    return 0;
+}
+
+/*
+ * Lazy extraction of onefile data files, exposed to python as a
+ * built-in function _pyinstaller_lazy_extract(name, is_dir). The name
+ * is relative to the application's top-level directory. If `is_dir` is
+ * false, extracts the lazily-extracted data file with given name; if it
+ * is true, extracts all lazily-extracted data files in the directory
+ * with given name. Returns True if any file was (or already is)
+ * extracted, and False otherwise. Extraction errors are reported as
+ * warnings by the bootloader, and result in False being returned; the
+ * caller then sees the original "file not found" error.
+ */
+static PyObject *
+_pyi_python_lazy_extract(PyObject *self, PyObject *args)
+{
+    const struct DYLIB_PYTHON *dylib_python = global_pyi_ctx->dylib_python;
+    const char *name;
+    int is_dir;
+    int rc;
+
+    if (!dylib_python->PyArg_ParseTuple(args, "si", &name, &is_dir)) {
+        return NULL;
+    }
+
+    if (is_dir) {
+        rc = pyi_launch_extract_lazy_directory(global_pyi_ctx, name);
+    } else {
+        rc = pyi_launch_extract_lazy_entry(global_pyi_ctx, name);
+    }
+
+    return dylib_python->PyBool_FromLong(rc > 0);
+}
+
+static PyMethodDef _pyi_python_lazy_extract_def = {
+    "_pyinstaller_lazy_extract",
+    _pyi_python_lazy_extract,
+    METH_VARARGS,
+    NULL
+};
+
+/*
+ * Reading of a range of lazily-extracted data file's data, without
+ * extracting the file, exposed to python as a built-in function
+ * _pyinstaller_read_range(name, offset, length). The name is relative
+ * to the application's top-level directory. Returns the data as bytes
+ * object; raises KeyError if there is no lazily-extracted data file
+ * with given name, and OSError if the data could not be read (for
+ * example, if the range exceeds the file's data).
+ */
+static PyObject *
+_pyi_python_read_range(PyObject *self, PyObject *args)
+{
+    const struct DYLIB_PYTHON *dylib_python = global_pyi_ctx->dylib_python;
+    const char *name;
+    unsigned long long offset;
+    unsigned long long length;
+    PyObject *data_obj;
+    int rc;
+
+    if (!dylib_python->PyArg_ParseTuple(args, "sKK", &name, &offset, &length)) {
+        return NULL;
+    }
+    if (length > (unsigned long long)(SIZE_MAX / 2)) {
+        return dylib_python->PyErr_NoMemory();
+    }
+
+    data_obj = dylib_python->PyBytes_FromStringAndSize(NULL, (Py_ssize_t)length);
+    if (data_obj == NULL) {
+        return NULL;
+    }
+
+    rc = pyi_launch_read_lazy_entry_range(global_pyi_ctx, name, offset, dylib_python->PyBytes_AsString(data_obj), (size_t)length);
+    if (rc == 0) {
+        dylib_python->Py_DecRef(data_obj);
+        return dylib_python->PyErr_Format(*dylib_python->PyExc_KeyError, "No lazily-extracted data file named %s!", name);
+    }
+    if (rc < 0) {
+        dylib_python->Py_DecRef(data_obj);
+        return dylib_python->PyErr_Format(*dylib_python->PyExc_OSError, "Failed to read data of %s!", name);
+    }
+
+    return data_obj;
+}
+
+static PyMethodDef _pyi_python_read_range_def = {
+    "_pyinstaller_read_range",
+    _pyi_python_read_range,
+    METH_VARARGS,
+    NULL
+};
+
+/*
+ * If the archive contains lazily-extracted data files, store the lazy
+ * extraction function into sys._pyinstaller_lazy_extract, so that our
+ * bootstrap python script can install the hooks that extract the files
+ * on first access, and the range reading function into
+ * sys._pyinstaller_read_range.
+ */
+int
+pyi_python_install_lazy_extraction(const struct PYI_CONTEXT *pyi_ctx)
+{
+    const struct DYLIB_PYTHON *dylib_python = pyi_ctx->dylib_python;
+    const struct ARCHIVE *archive = pyi_ctx->archive;
+    size_t num_entries;
+    PyObject *func_obj;
+    int rc;
+
+    pyi_archive_get_toc_group(archive, ARCHIVE_TOC_GROUP_LAZY_DATA, &num_entries);
+    if (num_entries == 0) {
+        return 0; /* Nothing to do */
+    }
+
+    func_obj = dylib_python->PyCFunction_NewEx(&_pyi_python_lazy_extract_def, NULL, NULL);
+    if (func_obj == NULL) {
+        PYI_ERROR("Failed to create lazy extraction function!\n");
+        return -1;
+    }
+
+    rc = dylib_python->PySys_SetObject(_pyi_python_lazy_extract_def.ml_name, func_obj);
+    dylib_python->Py_DecRef(func_obj);
+    if (rc != 0) {
+        PYI_ERROR("Failed to store lazy extraction function into sys.%s!\n", _pyi_python_lazy_extract_def.ml_name);
+        return -1;
+    }
+
+    PYI_DEBUG("LOADER: lazy extraction function stored into sys.%s...\n", _pyi_python_lazy_extract_def.ml_name);
+
+    /* The range reader; unlike the lazy extraction function, it is left
+     * in place for the application code. */
+    func_obj = dylib_python->PyCFunction_NewEx(&_pyi_python_read_range_def, NULL, NULL);
+    if (func_obj == NULL) {
+        PYI_ERROR("Failed to create range reading function!\n");
+        return -1;
+    }
+
+    rc = dylib_python->PySys_SetObject(_pyi_python_read_range_def.ml_name, func_obj);
+    dylib_python->Py_DecRef(func_obj);
+    if (rc != 0) {
+        PYI_ERROR("Failed to store range reading function into sys.%s!\n", _pyi_python_read_range_def.ml_name);
+        return -1;
+    }
+
+    PYI_DEBUG("LOADER: range reading function stored into sys.%s...\n", _pyi_python_read_range_def.ml_name);
+
     return 0;
 }
 
@@ -19,10 +19,12 @@
 #define PYI_PYTHON_H
 
 struct PYI_CONTEXT;
+struct PyiRuntimeOptions;
 
-int pyi_python_start_interpreter(const struct PYI_CONTEXT *pyi_ctx);
+int pyi_python_start_interpreter(const struct PYI_CONTEXT *pyi_ctx, const struct PyiRuntimeOptions *runtime_options);
 int pyi_python_import_modules(const struct PYI_CONTEXT *pyi_ctx);
 int pyi_python_install_pyz(const struct PYI_CONTEXT *pyi_ctx);
+int pyi_python_install_lazy_extraction(const struct PYI_CONTEXT *pyi_ctx);
 int pyi_python_run_scripts(const struct PYI_CONTEXT *pyi_ctx);
 
 void pyi_python_finalize(const struct PYI_CONTEXT *pyi_ctx);
@@ -0,0 +1,465 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Background prefetch of the PYZ archive's hot entries.
+ *
+ * While the main thread loads the python shared library and initializes
+ * the interpreter, a background thread decompresses the entries in the
+ * PYZ archive's hot prefix - the modules that were imported during the
+ * recorded run of the application (see the `layout_profile` option of
+ * PYZ) - into memory, in the order of their recorded access. The native
+ * PYZ code loader (see pyi_python.c) takes the decompressed data from
+ * here, and only unmarshals it.
+ *
+ * The prefetch requires the PYZ archive to be available in the PKG
+ * archive's memory mapping, to be laid out according to an access
+ * profile, and more than one CPU core; otherwise, it is not started.
+ * The entries that the prefetch did not get to (yet) are decompressed
+ * by the loader itself; if the loader requests an entry while it is
+ * being decompressed, the loader waits for it.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h> /* UINT_MAX */
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_archive.h"
+#include "pyi_main.h"
+#include "pyi_pyz_prefetch.h"
+#include "pyi_thread.h"
+#include "zlib.h"
+
+
+#if PYI_HAVE_THREADS
+
+/* States of prefetched entries. */
+enum PYI_PYZ_PREFETCH_ENTRY_STATE
+{
+    PYI_PYZ_PREFETCH_PENDING = 0, /* Not processed yet */
+    PYI_PYZ_PREFETCH_BUSY, /* Being decompressed by the prefetch thread */
+    PYI_PYZ_PREFETCH_READY, /* Decompressed data is available */
+    PYI_PYZ_PREFETCH_CONSUMED /* Taken by the loader (or skipped) */
+};
+
+struct PYI_PYZ_PREFETCH_ENTRY
+{
+    uint64_t offset;
+    uint64_t length;
+
+    unsigned char state;
+    unsigned char *buffer;
+    size_t size;
+};
+
+struct PYI_PYZ_PREFETCH
+{
+    /* Data of the memory-mapped PYZ archive. */
+    const unsigned char *pyz_data;
+    uint64_t pyz_length;
+
+    /* Preset compression dictionary; NULL if not used. */
+    const unsigned char *zdict;
+    uInt zdict_length;
+
+    /* Entries in the hot prefix, sorted by data offset (i.e., in the
+     * order of their recorded access). The array itself is not modified
+     * after the prefetch is started. */
+    struct PYI_PYZ_PREFETCH_ENTRY *entries;
+    size_t num_entries;
+
+    pyi_thread_t thread;
+
+    /* Protects the state, buffer and size of entries, and the
+     * `cancelled` flag; `cond` is signalled when a busy entry becomes
+     * ready. */
+    pyi_mutex_t mutex;
+    pyi_cond_t cond;
+    bool cancelled;
+};
+
+
+/*
+ * Read a big-endian 32-bit integer.
+ */
+static uint32_t
+_pyi_pyz_read_u32(const unsigned char *data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+/*
+ * Decompress the entry's data. The length of decompressed data is not
+ * stored in PYZ TOC; start with an estimate, and grow the buffer as
+ * necessary. Returns the buffer, or NULL on error.
+ */
+static unsigned char *
+_pyi_pyz_prefetch_inflate(const struct PYI_PYZ_PREFETCH *prefetch, const struct PYI_PYZ_PREFETCH_ENTRY *entry, size_t *size)
+{
+    z_stream zstream;
+    unsigned char *buffer;
+    size_t buffer_size;
+    int rc;
+
+    buffer_size = (size_t)entry->length * 4;
+    if (buffer_size < 4096) {
+        buffer_size = 4096;
+    }
+    buffer = (unsigned char *)malloc(buffer_size);
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    memset(&zstream, 0, sizeof(zstream));
+    zstream.next_in = (unsigned char *)(prefetch->pyz_data + entry->offset);
+    zstream.avail_in = (uInt)entry->length;
+
+    if (inflateInit(&zstream) != Z_OK) {
+        free(buffer);
+        return NULL;
+    }
+
+    for (;;) {
+        size_t remaining = buffer_size - (size_t)zstream.total_out;
+
+        zstream.next_out = buffer + zstream.total_out;
+        zstream.avail_out = remaining > UINT_MAX ? UINT_MAX : (uInt)remaining;
+
+        rc = inflate(&zstream, Z_NO_FLUSH);
+        if (rc == Z_STREAM_END) {
+            break;
+        }
+        if (rc == Z_NEED_DICT && prefetch->zdict != NULL) {
+            if (inflateSetDictionary(&zstream, prefetch->zdict, prefetch->zdict_length) != Z_OK) {
+                goto error;
+            }
+            continue;
+        }
+        if ((rc != Z_OK && rc != Z_BUF_ERROR) || zstream.avail_out != 0) {
+            goto error;
+        }
+
+        /* Output buffer is full; grow it */
+        if (buffer_size > SIZE_MAX / 2) {
+            goto error;
+        } else {
+            unsigned char *new_buffer = (unsigned char *)realloc(buffer, buffer_size * 2);
+            if (new_buffer == NULL) {
+                goto error;
+            }
+            buffer = new_buffer;
+            buffer_size *= 2;
+        }
+    }
+
+    *size = (size_t)zstream.total_out;
+    inflateEnd(&zstream);
+    return buffer;
+
+error:
+    inflateEnd(&zstream);
+    free(buffer);
+    return NULL;
+}
+
+static PYI_THREAD_PROC_TYPE
+_pyi_pyz_prefetch_worker(void *arg)
+{
+    struct PYI_PYZ_PREFETCH *prefetch = (struct PYI_PYZ_PREFETCH *)arg;
+    size_t total_size = 0;
+    size_t i;
+
+    for (i = 0; i < prefetch->num_entries && total_size < PYI_PYZ_PREFETCH_MAX_SIZE; i++) {
+        struct PYI_PYZ_PREFETCH_ENTRY *entry = &prefetch->entries[i];
+        unsigned char *buffer;
+        size_t size = 0;
+
+        pyi_mutex_lock(&prefetch->mutex);
+        if (prefetch->cancelled) {
+            pyi_mutex_unlock(&prefetch->mutex);
+            break;
+        }
+        if (entry->state != PYI_PYZ_PREFETCH_PENDING) {
+            pyi_mutex_unlock(&prefetch->mutex);
+            continue;
+        }
+        entry->state = PYI_PYZ_PREFETCH_BUSY;
+        pyi_mutex_unlock(&prefetch->mutex);
+
+        buffer = _pyi_pyz_prefetch_inflate(prefetch, entry, &size);
+
+        /* On failure, the entry is marked as ready without data, so that
+         * the loader decompresses it on its own (and reports the error). */
+        pyi_mutex_lock(&prefetch->mutex);
+        entry->buffer = buffer;
+        entry->size = size;
+        entry->state = PYI_PYZ_PREFETCH_READY;
+        pyi_cond_broadcast(&prefetch->cond);
+        pyi_mutex_unlock(&prefetch->mutex);
+
+        total_size += size;
+    }
+
+    PYI_DEBUG("LOADER: PYZ prefetch: decompressed %zu bytes of %zu hot entries.\n", total_size, i);
+
+    PYI_THREAD_PROC_RETURN;
+}
+
+static int
+_pyi_pyz_prefetch_compare_entries(const void *a, const void *b)
+{
+    const struct PYI_PYZ_PREFETCH_ENTRY *entry_a = (const struct PYI_PYZ_PREFETCH_ENTRY *)a;
+    const struct PYI_PYZ_PREFETCH_ENTRY *entry_b = (const struct PYI_PYZ_PREFETCH_ENTRY *)b;
+
+    if (entry_a->offset < entry_b->offset) {
+        return -1;
+    }
+    return entry_a->offset > entry_b->offset;
+}
+
+/*
+ * Collect the code entries whose data lies within the hot prefix of the
+ * PYZ archive, by walking the records of its TOC (format version 2).
+ * Returns 0 on success, and 1 if the archive has no hot prefix or is in
+ * an unsupported format.
+ */
+static int
+_pyi_pyz_prefetch_collect_entries(struct PYI_PYZ_PREFETCH *prefetch)
+{
+    const unsigned char *pyz_data = prefetch->pyz_data;
+    uint64_t pyz_length = prefetch->pyz_length;
+    const unsigned char *toc;
+    uint32_t toc_offset;
+    uint32_t num_records;
+    uint32_t hot_length;
+    uint32_t zdict_length;
+    uint32_t i;
+
+    if (pyz_length < PYZ_HEADER_LENGTH || memcmp(pyz_data, "PYZ\0", 4) != 0 || pyz_data[PYZ_HEADER_VERSION_OFFSET] < 2) {
+        return 1;
+    }
+
+    zdict_length = _pyi_pyz_read_u32(pyz_data + PYZ_HEADER_ZDICT_LENGTH_OFFSET);
+    if (zdict_length > pyz_length - PYZ_HEADER_LENGTH) {
+        return 1;
+    }
+    if (zdict_length > 0) {
+        prefetch->zdict = pyz_data + PYZ_HEADER_LENGTH;
+        prefetch->zdict_length = (uInt)zdict_length;
+    }
+
+    toc_offset = _pyi_pyz_read_u32(pyz_data + PYZ_HEADER_TOC_OFFSET_OFFSET);
+    if (toc_offset > pyz_length || pyz_length - toc_offset < PYZ_TOC_HEADER_LENGTH) {
+        return 1;
+    }
+    toc = pyz_data + toc_offset;
+
+    hot_length = _pyi_pyz_read_u32(toc + PYZ_TOC_HEADER_HOT_LENGTH_OFFSET);
+    if (hot_length == 0) {
+        return 1;
+    }
+
+    num_records = _pyi_pyz_read_u32(toc);
+    if (num_records > (pyz_length - toc_offset - PYZ_TOC_HEADER_LENGTH) / PYZ_TOC_RECORD_LENGTH) {
+        return 1;
+    }
+
+    prefetch->entries = (struct PYI_PYZ_PREFETCH_ENTRY *)calloc(num_records ? num_records : 1, sizeof(struct PYI_PYZ_PREFETCH_ENTRY));
+    if (prefetch->entries == NULL) {
+        return 1;
+    }
+
+    for (i = 0; i < num_records; i++) {
+        const unsigned char *record = toc + PYZ_TOC_HEADER_LENGTH + (size_t)i * PYZ_TOC_RECORD_LENGTH;
+        unsigned char typecode = record[PYZ_TOC_RECORD_TYPECODE_OFFSET];
+        uint32_t data_offset = _pyi_pyz_read_u32(record + PYZ_TOC_RECORD_DATA_OFFSET_OFFSET);
+        uint32_t data_length = _pyi_pyz_read_u32(record + PYZ_TOC_RECORD_DATA_LENGTH_OFFSET);
+
+        if (typecode != PYZ_ITEM_MODULE && typecode != PYZ_ITEM_PKG) {
+            continue;
+        }
+        if (data_length == 0 || data_offset > hot_length || data_length > hot_length - data_offset) {
+            continue;
+        }
+
+        prefetch->entries[prefetch->num_entries].offset = data_offset;
+        prefetch->entries[prefetch->num_entries].length = data_length;
+        prefetch->num_entries++;
+    }
+
+    if (prefetch->num_entries == 0) {
+        return 1;
+    }
+
+    qsort(prefetch->entries, prefetch->num_entries, sizeof(struct PYI_PYZ_PREFETCH_ENTRY), _pyi_pyz_prefetch_compare_entries);
+
+    return 0;
+}
+
+static void
+_pyi_pyz_prefetch_free(struct PYI_PYZ_PREFETCH *prefetch)
+{
+    size_t i;
+
+    if (prefetch->entries != NULL) {
+        for (i = 0; i < prefetch->num_entries; i++) {
+            free(prefetch->entries[i].buffer);
+        }
+        free(prefetch->entries);
+    }
+    free(prefetch);
+}
+
+#endif /* PYI_HAVE_THREADS */
+
+
+/*
+ * Start the background prefetch of the PYZ archive's hot entries, if
+ * applicable. Failure to start the prefetch is not an error.
+ */
+void
+pyi_pyz_prefetch_start(struct PYI_CONTEXT *pyi_ctx)
+{
+#if PYI_HAVE_THREADS
+    const struct ARCHIVE *archive = pyi_ctx->archive;
+    const struct TOC_ENTRY *const *toc_entries;
+    const struct TOC_ENTRY *toc_entry;
+    size_t num_entries;
+    struct PYI_PYZ_PREFETCH *prefetch;
+
+    /* The prefetch thread would compete with the main thread for the
+     * only CPU core. */
+    if (pyi_thread_get_cpu_count() < 2) {
+        return;
+    }
+
+    toc_entries = pyi_archive_get_toc_group(archive, ARCHIVE_TOC_GROUP_PYZ, &num_entries);
+    if (num_entries == 0) {
+        return;
+    }
+    toc_entry = toc_entries[0];
+    if (toc_entry->compression_flag != ARCHIVE_COMPRESSION_NONE) {
+        return;
+    }
+
+    prefetch = (struct PYI_PYZ_PREFETCH *)calloc(1, sizeof(struct PYI_PYZ_PREFETCH));
+    if (prefetch == NULL) {
+        return;
+    }
+
+    prefetch->pyz_data = pyi_archive_get_mapped_data(archive, toc_entry);
+    prefetch->pyz_length = toc_entry->uncompressed_length;
+    if (prefetch->pyz_data == NULL || _pyi_pyz_prefetch_collect_entries(prefetch) != 0) {
+        _pyi_pyz_prefetch_free(prefetch);
+        return;
+    }
+
+    if (pyi_mutex_init(&prefetch->mutex) < 0) {
+        _pyi_pyz_prefetch_free(prefetch);
+        return;
+    }
+    if (pyi_cond_init(&prefetch->cond) < 0) {
+        pyi_mutex_destroy(&prefetch->mutex);
+        _pyi_pyz_prefetch_free(prefetch);
+        return;
+    }
+    if (pyi_thread_create(&prefetch->thread, _pyi_pyz_prefetch_worker, prefetch) < 0) {
+        pyi_cond_destroy(&prefetch->cond);
+        pyi_mutex_destroy(&prefetch->mutex);
+        _pyi_pyz_prefetch_free(prefetch);
+        return;
+    }
+
+    PYI_DEBUG("LOADER: PYZ prefetch: started background decompression of %zu hot entries.\n", prefetch->num_entries);
+    pyi_ctx->pyz_prefetch_state = prefetch;
+#else
+    (void)pyi_ctx;
+#endif
+}
+
+/*
+ * Stop the background prefetch, wait for its thread to finish, and free
+ * the data that was not taken by the loader.
+ */
+void
+pyi_pyz_prefetch_stop(struct PYI_CONTEXT *pyi_ctx)
+{
+#if PYI_HAVE_THREADS
+    struct PYI_PYZ_PREFETCH *prefetch = pyi_ctx->pyz_prefetch_state;
+
+    if (prefetch == NULL) {
+        return;
+    }
+    pyi_ctx->pyz_prefetch_state = NULL;
+
+    pyi_mutex_lock(&prefetch->mutex);
+    prefetch->cancelled = true;
+    pyi_mutex_unlock(&prefetch->mutex);
+
+    pyi_thread_join(prefetch->thread);
+    pyi_cond_destroy(&prefetch->cond);
+    pyi_mutex_destroy(&prefetch->mutex);
+    _pyi_pyz_prefetch_free(prefetch);
+#else
+    (void)pyi_ctx;
+#endif
+}
+
+/*
+ * Take the prefetched, decompressed data of the PYZ entry with given
+ * data offset and length. If the entry is being decompressed, waits for
+ * it. Returns a buffer that the caller must free, or NULL if the data
+ * is not available (in which case the caller should decompress the
+ * entry itself). Each entry's data can be taken only once.
+ */
+unsigned char *
+pyi_pyz_prefetch_take(struct PYI_PYZ_PREFETCH *prefetch, uint64_t offset, uint64_t length, size_t *size)
+{
+#if PYI_HAVE_THREADS
+    struct PYI_PYZ_PREFETCH_ENTRY key;
+    struct PYI_PYZ_PREFETCH_ENTRY *entry;
+    unsigned char *buffer = NULL;
+
+    if (prefetch == NULL) {
+        return NULL;
+    }
+
+    key.offset = offset;
+    entry = (struct PYI_PYZ_PREFETCH_ENTRY *)bsearch(&key, prefetch->entries, prefetch->num_entries, sizeof(struct PYI_PYZ_PREFETCH_ENTRY), _pyi_pyz_prefetch_compare_entries);
+    if (entry == NULL || entry->length != length) {
+        return NULL;
+    }
+
+    pyi_mutex_lock(&prefetch->mutex);
+    while (entry->state == PYI_PYZ_PREFETCH_BUSY) {
+        pyi_cond_wait(&prefetch->cond, &prefetch->mutex);
+    }
+    if (entry->state == PYI_PYZ_PREFETCH_READY) {
+        buffer = entry->buffer;
+        *size = entry->size;
+        entry->buffer = NULL;
+    }
+    entry->state = PYI_PYZ_PREFETCH_CONSUMED;
+    pyi_mutex_unlock(&prefetch->mutex);
+
+    return buffer;
+#else
+    (void)prefetch;
+    (void)offset;
+    (void)length;
+    (void)size;
+    return NULL;
+#endif
+}
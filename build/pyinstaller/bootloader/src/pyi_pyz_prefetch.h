@@ -0,0 +1,56 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Background prefetch of the PYZ archive's hot entries.
+ */
+
+#ifndef PYI_PYZ_PREFETCH_H
+#define PYI_PYZ_PREFETCH_H
+
+#include <stddef.h> /* size_t */
+
+#include "pyi_global.h"
+
+struct PYI_CONTEXT;
+struct PYI_PYZ_PREFETCH;
+
+/* Layout of the PYZ archive header; see ZlibArchiveWriter. */
+#define PYZ_HEADER_LENGTH 17
+#define PYZ_HEADER_TOC_OFFSET_OFFSET 8
+#define PYZ_HEADER_VERSION_OFFSET 12
+#define PYZ_HEADER_ZDICT_LENGTH_OFFSET 13
+
+/* Layout of the PYZ archive TOC (format version 2); see ZlibArchiveTOC. */
+#define PYZ_TOC_HEADER_LENGTH 20
+#define PYZ_TOC_HEADER_HOT_LENGTH_OFFSET 16
+#define PYZ_TOC_RECORD_LENGTH 16
+#define PYZ_TOC_RECORD_TYPECODE_OFFSET 6
+#define PYZ_TOC_RECORD_DATA_OFFSET_OFFSET 8
+#define PYZ_TOC_RECORD_DATA_LENGTH_OFFSET 12
+
+/* Typecodes of PYZ entries that hold code objects. */
+#define PYZ_ITEM_MODULE 0
+#define PYZ_ITEM_PKG 1
+
+/* Maximal total size of decompressed data that the prefetch keeps in
+ * memory; once reached, the remaining entries are left to be
+ * decompressed on import. */
+#define PYI_PYZ_PREFETCH_MAX_SIZE (32 * 1024 * 1024)
+
+void pyi_pyz_prefetch_start(struct PYI_CONTEXT *pyi_ctx);
+void pyi_pyz_prefetch_stop(struct PYI_CONTEXT *pyi_ctx);
+
+unsigned char *pyi_pyz_prefetch_take(struct PYI_PYZ_PREFETCH *prefetch, uint64_t offset, uint64_t length, size_t *size);
+
+#endif /* PYI_PYZ_PREFETCH_H */
@@ -27,6 +27,9 @@
 #include "pyi_utils.h"
 #include "pyi_path.h"
 #include "pyi_splash.h"
+#include "pyi_splash_native.h"
+
+#if !defined(PYI_WITHOUT_SPLASH)
 
 /**
  * Splash Screen Feature
@@ -60,6 +63,12 @@
  * flag, which is it by default on Windows and macOS. Many Linux distributions also come
  * with threaded Tcl installation, although it is not guaranteed. PyInstaller checks at
  * build time if Tcl is threaded and raises an error if it is not.
+ *
+ * Alternatively, the splash screen can be displayed by the native backend
+ * (see pyi_splash_native.c), which draws the image, status text and progress
+ * bar using the platform's window API, and does not require Tcl/Tk at all.
+ * The backend is selected at build time and is recorded in the splash
+ * resources header; the functions in this file dispatch to it.
  */
 
 
@@ -71,16 +80,74 @@ struct Splash_Event;
 /*
  * Initialize the splash screen context by reading its data and defining
  * the necessary paths and resources.
+ *
+ * The script, image and requirements fields of the context point into
+ * the splash resources entry's data: directly into the archive's memory
+ * mapping if the entry is stored uncompressed, or into the single buffer
+ * with the entry's decompressed data otherwise. Either way, the data is
+ * not copied into separate buffers.
  */
 int
 pyi_splash_setup(struct SPLASH_CONTEXT *splash, const struct PYI_CONTEXT *pyi_ctx)
 {
-    struct SPLASH_DATA_HEADER *data_header;
+    const struct TOC_ENTRY *toc_entry = pyi_ctx->archive->toc_splash;
+    struct SPLASH_DATA_HEADER header;
+    struct SPLASH_DATA_HEADER *data_header = &header;
+    const unsigned char *data;
+    uint64_t data_length = toc_entry->uncompressed_length;
+    uint32_t script_offset;
+    uint32_t image_offset;
+    uint32_t requirements_offset;
+
+    /* Read splash resources entry from the archive, unless it can be
+     * used directly from the archive's memory mapping. */
+    data = NULL;
+    if (toc_entry->compression_flag == ARCHIVE_COMPRESSION_NONE) {
+        data = pyi_archive_get_mapped_data(pyi_ctx->archive, toc_entry);
+    }
+    if (data == NULL) {
+        splash->resources = pyi_archive_extract(pyi_ctx->archive, toc_entry);
+        if (splash->resources == NULL) {
+            return -1; /* Failed to read splash resources */
+        }
+        data = splash->resources;
+    }
 
-    /* Read splash resources entry from the archive */
-    data_header = (struct SPLASH_DATA_HEADER *)pyi_archive_extract(pyi_ctx->archive, pyi_ctx->archive->toc_splash);
-    if (data_header == NULL) {
-        return -1; /* Failed to read splash resources */
+    /* The data in the memory mapping is not necessarily aligned, so copy
+     * the fixed-size header into a local structure. */
+    if (data_length < sizeof(header)) {
+        PYI_WARNING("SPLASH: splash resources are truncated!\n");
+        return -1;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    /* Backend and its options */
+    splash->backend = (int)pyi_be32toh(data_header->backend);
+    splash->flags = pyi_be32toh(data_header->flags);
+
+    if (splash->backend == PYI_SPLASH_BACKEND_NATIVE) {
+        splash->image_width = (int)pyi_be32toh(data_header->image_width);
+        splash->image_height = (int)pyi_be32toh(data_header->image_height);
+        memcpy(splash->text_font, data_header->text_font, sizeof(splash->text_font));
+        splash->text_pos_x = (int32_t)pyi_be32toh(data_header->text_pos_x);
+        splash->text_pos_y = (int32_t)pyi_be32toh(data_header->text_pos_y);
+        splash->text_size = (int32_t)pyi_be32toh(data_header->text_size);
+        splash->text_color = pyi_be32toh(data_header->text_color);
+        splash->progress_bar_x0 = (int32_t)pyi_be32toh(data_header->progress_bar_x0);
+        splash->progress_bar_y0 = (int32_t)pyi_be32toh(data_header->progress_bar_y0);
+        splash->progress_bar_x1 = (int32_t)pyi_be32toh(data_header->progress_bar_x1);
+        splash->progress_bar_y1 = (int32_t)pyi_be32toh(data_header->progress_bar_y1);
+        splash->progress_bar_color = pyi_be32toh(data_header->progress_bar_color);
+
+        /* Validate the image dimensions against the size of the pixel data. */
+        if (splash->image_width <= 0 || splash->image_height <= 0 ||
+            (uint64_t)splash->image_width * (uint64_t)splash->image_height * 4 != pyi_be32toh(data_header->image_len)) {
+            PYI_WARNING("SPLASH: invalid image dimensions for native splash screen!\n");
+            return -1;
+        }
+    } else if (splash->backend != PYI_SPLASH_BACKEND_TCLTK) {
+        PYI_WARNING("SPLASH: unsupported splash screen backend: %d\n", splash->backend);
+        return -1;
     }
 
     /* In onedir mode, Tcl/Tk dependencies (shared libraries, .tcl files)
@@ -96,61 +163,41 @@ pyi_splash_setup(struct SPLASH_CONTEXT *splash, const struct PYI_CONTEXT *pyi_ct
     /* Tcl shared library */
     if (pyi_path_join(splash->tcl_libpath, pyi_ctx->application_home_dir, data_header->tcl_libname) == NULL) {
         PYI_WARNING("SPLASH: length of Tcl shared library path exceeds maximum path length!\n");
-        free(data_header);
         return -1;
     }
 
     /* Tk shared library */
     if (pyi_path_join(splash->tk_libpath, pyi_ctx->application_home_dir, data_header->tk_libname) == NULL) {
         PYI_WARNING("SPLASH: length of Tk shared library path exceeds maximum path length!\n");
-        free(data_header);
         return -1;
     }
 
     /* Tk modules directory */
     if (pyi_path_join(splash->tk_lib, pyi_ctx->application_home_dir, data_header->tk_lib) == NULL) {
         PYI_WARNING("SPLASH: length of Tk shared library path exceeds maximum path length!\n");
-        free(data_header);
         return -1;
     }
 
-    /* Copy the script into a buffer owned by SPLASH_STATUS */
-    splash->script_len = pyi_be32toh(data_header->script_len);
-    splash->script = (char *)calloc(1, splash->script_len + 1);
+    /* Point the script, image and requirements fields into the data */
+    splash->script_len = (int)pyi_be32toh(data_header->script_len);
+    script_offset = pyi_be32toh(data_header->script_offset);
 
-    /* Copy the image into a buffer owned by SPLASH_STATUS */
-    splash->image_len = pyi_be32toh(data_header->image_len);
-    splash->image = (char *)malloc(splash->image_len);
+    splash->image_len = (int)pyi_be32toh(data_header->image_len);
+    image_offset = pyi_be32toh(data_header->image_offset);
 
-    /* Copy the requirements array into a buffer owned by SPLASH_STATUS */
-    splash->requirements_len = pyi_be32toh(data_header->requirements_len);
-    splash->requirements = (char *)malloc(splash->requirements_len);
+    splash->requirements_len = (int)pyi_be32toh(data_header->requirements_len);
+    requirements_offset = pyi_be32toh(data_header->requirements_offset);
 
-    if (splash->script == NULL || splash->image == NULL || splash->requirements == NULL) {
-        PYI_ERROR("Could not allocate memory for splash screen resources.\n");
-        free(data_header);
+    if (splash->script_len < 0 || script_offset > data_length || (uint64_t)splash->script_len > data_length - script_offset ||
+        splash->image_len < 0 || image_offset > data_length || (uint64_t)splash->image_len > data_length - image_offset ||
+        splash->requirements_len < 0 || requirements_offset > data_length || (uint64_t)splash->requirements_len > data_length - requirements_offset) {
+        PYI_WARNING("SPLASH: invalid layout of splash resources!\n");
         return -1;
     }
 
-    /* Copy the data into their respective fields */
-    memcpy(
-        splash->script,
-        ((char *)data_header) + pyi_be32toh(data_header->script_offset),
-        splash->script_len
-    );
-    memcpy(
-        splash->image,
-        ((char *)data_header) + pyi_be32toh(data_header->image_offset),
-        splash->image_len
-    );
-    memcpy(
-        splash->requirements,
-        ((char *)data_header) + pyi_be32toh(data_header->requirements_offset),
-        splash->requirements_len
-    );
-
-    /* Free raw header data */
-    free(data_header);
+    splash->script = (const char *)data + script_offset;
+    splash->image = data + image_offset;
+    splash->requirements = (const char *)data + requirements_offset;
 
     return 0;
 }
@@ -181,6 +228,11 @@ pyi_splash_start(struct SPLASH_CONTEXT *splash, const char *executable)
 {
     const struct DYLIB_TCLTK *dylib_tcltk = splash->dylib_tcltk;
 
+    /* The native backend runs its own thread. */
+    if (splash->backend == PYI_SPLASH_BACKEND_NATIVE) {
+        return pyi_splash_native_start(splash);
+    }
+
     /* Make sure shared libraries have been loaded and their symbols
      * bound. */
     if (!dylib_tcltk) {
@@ -262,13 +314,20 @@ pyi_splash_extract(struct SPLASH_CONTEXT *splash, const struct PYI_CONTEXT *pyi_
     const struct TOC_ENTRY *toc_entry;
     const char *requirement_filename = NULL;
     char output_filename[PYI_PATH_MAX];
+    struct ARCHIVE_SESSION *session;
     size_t pos;
+    int rc = 0;
 
     /* No-op in onedir mode */
     if (!pyi_ctx->is_onefile) {
         return 0;
     }
 
+    session = pyi_archive_session_new(0);
+    if (session == NULL) {
+        return -1;
+    }
+
     /* Iterate over the requirements array */
     for (pos = 0; pos < (size_t)splash->requirements_len; pos += strlen(requirement_filename) + 1) {
         /* Read filename from requirements array */
@@ -278,39 +337,46 @@ pyi_splash_extract(struct SPLASH_CONTEXT *splash, const struct PYI_CONTEXT *pyi_
         toc_entry = pyi_archive_find_entry_by_name(archive, requirement_filename);
         if (toc_entry == NULL) {
             PYI_ERROR("SPLASH: could not find requirement %s in archive.\n", requirement_filename);
-            return -1;
+            rc = -1;
+            break;
         }
 
         /* Construct output filename */
         if (snprintf(output_filename, PYI_PATH_MAX, "%s%c%s", pyi_ctx->application_home_dir, PYI_SEP, requirement_filename) >= PYI_PATH_MAX) {
             PYI_ERROR("SPLASH: extraction path length exceeds maximum path length!\n");
-            return -1;
+            rc = -1;
+            break;
         }
 
         /* Check if file already exists (it should not) */
         if (pyi_path_exists(output_filename) == 1) {
             if (pyi_ctx->strict_unpack_mode) {
                 PYI_ERROR("SPLASH: file already exists but should not: %s\n", output_filename);
-                return -1;
+                rc = -1;
+                break;
             } else {
                 PYI_WARNING("SPLASH: file already exists but should not: %s\n", output_filename);
             }
         }
 
         /* Create parent directory tree */
-        if (pyi_create_parent_directory_tree(pyi_ctx, pyi_ctx->application_home_dir, requirement_filename) < 0) {
+        if (pyi_create_parent_directory_tree(pyi_ctx, NULL, pyi_ctx->application_home_dir, requirement_filename) < 0) {
             PYI_ERROR("SPLASH: failed to create parent directory structure.\n");
-            return -1;
+            rc = -1;
+            break;
         }
 
         /* Extract file into the splash dependencies directory */
-        if (pyi_archive_extract2fs(archive, toc_entry, output_filename)) {
-            PYI_ERROR("SPLASH: could not extract requirement %s.\n", toc_entry->name);
-            return -2;
+        if (pyi_archive_session_extract2fs(session, archive, toc_entry, output_filename)) {
+            PYI_ERROR("SPLASH: could not extract requirement %s.\n", pyi_archive_get_entry_name(toc_entry));
+            rc = -2;
+            break;
         }
     }
 
-    return 0;
+    pyi_archive_session_free(&session);
+
+    return rc;
 }
 
 /* Check if the given TOC entry is a splash dependency. Used by
@@ -345,11 +411,44 @@ pyi_splash_is_splash_requirement(struct SPLASH_CONTEXT *splash, const char *name
     return 0;
 }
 
+/*
+ * Free the splash screen resources read from the archive (the Tcl script,
+ * the image, and the list of requirements). These are needed only until
+ * the splash screen is started and the application is unpacked; the
+ * onefile parent process releases them before it starts waiting for the
+ * child process, and onedir process right after the splash screen is
+ * started. No-op if splash screen is not used.
+ */
+void
+pyi_splash_release_resources(struct SPLASH_CONTEXT *splash)
+{
+    if (splash == NULL) {
+        return;
+    }
+
+    splash->script = NULL;
+    splash->script_len = 0;
+
+    splash->image = NULL;
+    splash->image_len = 0;
+
+    splash->requirements = NULL;
+    splash->requirements_len = 0;
+
+    free(splash->resources);
+    splash->resources = NULL;
+}
+
 
 /* Load Tcl/Tk shared libraries and bind required symbols (functions). */
 int
 pyi_splash_load_shared_libraries(struct SPLASH_CONTEXT *splash)
 {
+    /* The native backend does not use Tcl/Tk. */
+    if (splash->backend == PYI_SPLASH_BACKEND_NATIVE) {
+        return 0;
+    }
+
     PYI_DEBUG("SPLASH: loading Tcl library from: %s\n", splash->tcl_libpath);
     PYI_DEBUG("SPLASH: loading Tk library from: %s\n", splash->tk_libpath);
 
@@ -375,6 +474,11 @@ pyi_splash_finalize(struct SPLASH_CONTEXT *splash)
         return 0;
     }
 
+    if (splash->backend == PYI_SPLASH_BACKEND_NATIVE) {
+        pyi_splash_native_finalize(splash);
+        return 0;
+    }
+
     /* If we failed to fully attach Tcl/Tk libraries (either because one
      * of the libraries failed to load, or because we failed to load one
      * of the symbols from the libraries), there is nothing left to do. */
@@ -427,6 +531,7 @@ pyi_splash_finalize(struct SPLASH_CONTEXT *splash)
     dylib_tcltk->Tcl_MutexFinalize(&splash->call_mutex);
     dylib_tcltk->Tcl_MutexFinalize(&splash->start_mutex);
     dylib_tcltk->Tcl_MutexFinalize(&splash->exit_mutex);
+    dylib_tcltk->Tcl_MutexFinalize(&splash->status_mutex);
 
     /* This function should only be called after python has been
      * destroyed with Py_Finalize. Tcl/Tk/tkinter do **not** support
@@ -481,9 +586,7 @@ pyi_splash_context_free(struct SPLASH_CONTEXT **splash_ref)
         return;
     }
 
-    free(splash->script);
-    free(splash->image);
-    free(splash->requirements);
+    free(splash->resources);
 
     free(splash);
 }
@@ -583,27 +686,64 @@ _splash_event_proc(Tcl_Event *ev, int flags)
 }
 
 /*
- * To update the splash screen text with the given text, we schedule a
- * Splash_Event into the Tcl interpreter's event queue.
+ * Apply the pending status text and progress from the status slot to
+ * the Tcl interpreter, and re-arm the timer. The splash screen script
+ * observes the "status_text" variable, which holds the text displayed
+ * on the splash screen, and the "status_progress" variable, which holds
+ * the extraction progress in percent (0 to 100).
  *
- * This function will update the variable "status_text", which updates the label
- * on the splash screen. We schedule this function in async mode, meaning
- * the main (bootloader) thread does not wait for this function to finish
- * its execution.
+ * The values are copied out of the slot while holding status_mutex, but
+ * the Tcl variables are set (and thus the traces in the script, which
+ * redraw the splash screen, are run) after the mutex is released, so
+ * that the bootloader's main thread is never blocked by Tk.
  *
  * Note: this function is executed inside the Tcl interpreter thread.
  */
-static int
-_pyi_splash_text_update(struct SPLASH_CONTEXT *splash, const void *user_data)
+static void
+_pyi_splash_status_poll(ClientData client_data)
 {
-    const char *text = (const char *)user_data;
-    splash->dylib_tcltk->Tcl_SetVar2(splash->interp, "status_text", NULL, text, TCL_GLOBAL_ONLY);
-    return 0;
+    struct SPLASH_CONTEXT *splash = (struct SPLASH_CONTEXT *)client_data;
+    const struct DYLIB_TCLTK *dylib_tcltk = splash->dylib_tcltk;
+    char text[PYI_PATH_MAX];
+    bool text_dirty;
+    bool progress_dirty;
+    uint64_t bytes_done;
+    uint64_t bytes_total;
+
+    dylib_tcltk->Tcl_MutexLock(&splash->status_mutex);
+    text_dirty = splash->status_text_dirty;
+    if (text_dirty) {
+        memcpy(text, splash->status_text, sizeof(text));
+        splash->status_text_dirty = false;
+    }
+    progress_dirty = splash->status_progress_dirty;
+    bytes_done = splash->status_bytes_done;
+    bytes_total = splash->status_bytes_total;
+    splash->status_progress_dirty = false;
+    dylib_tcltk->Tcl_MutexUnlock(&splash->status_mutex);
+
+    if (text_dirty) {
+        dylib_tcltk->Tcl_SetVar2(splash->interp, "status_text", NULL, text, TCL_GLOBAL_ONLY);
+    }
+
+    if (progress_dirty) {
+        char progress[8];
+        unsigned int percent = 100;
+        if (bytes_total > 0 && bytes_done < bytes_total) {
+            percent = (unsigned int)(bytes_done * 100 / bytes_total);
+        }
+        snprintf(progress, sizeof(progress), "%u", percent);
+        dylib_tcltk->Tcl_SetVar2(splash->interp, "status_progress", NULL, progress, TCL_GLOBAL_ONLY);
+    }
+
+    splash->status_timer = dylib_tcltk->Tcl_CreateTimerHandler(PYI_SPLASH_STATUS_POLL_INTERVAL, _pyi_splash_status_poll, splash);
 }
 
 /*
  * To update the text on the splash screen, we provide this function,
- * which enqueues an event for the Tcl interpreter thread to service.
+ * which stores the text into the status slot; the Tcl interpreter
+ * thread picks up the latest text at its next poll, so the text may
+ * be updated at arbitrary rate without flooding the Tcl event queue.
  *
  * This function is called from bootloader's main thread, namely from
  * the pyi_launch_extract_files_from_archive while it extracts files
@@ -612,9 +752,42 @@ _pyi_splash_text_update(struct SPLASH_CONTEXT *splash, const void *user_data)
 int
 pyi_splash_update_text(struct SPLASH_CONTEXT *splash, const char *text)
 {
-    /* We enqueue the _pyi_splash_text_update function into the Tcl
-     * interpreter event queue in async mode, ignoring the return value. */
-    return pyi_splash_send(splash, true, text, _pyi_splash_text_update);
+    const struct DYLIB_TCLTK *dylib_tcltk = splash->dylib_tcltk;
+
+    if (splash->backend == PYI_SPLASH_BACKEND_NATIVE) {
+        pyi_splash_native_update_text(splash, text);
+        return 0;
+    }
+
+    dylib_tcltk->Tcl_MutexLock(&splash->status_mutex);
+    snprintf(splash->status_text, sizeof(splash->status_text), "%s", text);
+    splash->status_text_dirty = true;
+    dylib_tcltk->Tcl_MutexUnlock(&splash->status_mutex);
+
+    return 0;
+}
+
+/*
+ * Update the extraction progress shown on the splash screen. The
+ * progress is given as the number of processed bytes and the total
+ * number of bytes to process, and is coalesced in the same way as
+ * the status text (see pyi_splash_update_text).
+ */
+void
+pyi_splash_update_progress(struct SPLASH_CONTEXT *splash, uint64_t bytes_done, uint64_t bytes_total)
+{
+    const struct DYLIB_TCLTK *dylib_tcltk = splash->dylib_tcltk;
+
+    if (splash->backend == PYI_SPLASH_BACKEND_NATIVE) {
+        pyi_splash_native_update_progress(splash, bytes_done, bytes_total);
+        return;
+    }
+
+    dylib_tcltk->Tcl_MutexLock(&splash->status_mutex);
+    splash->status_bytes_done = bytes_done;
+    splash->status_bytes_total = bytes_total;
+    splash->status_progress_dirty = true;
+    dylib_tcltk->Tcl_MutexUnlock(&splash->status_mutex);
 }
 
 /*
@@ -918,10 +1091,6 @@ _splash_init(ClientData client_data)
     image_data_obj = dylib_tcltk->Tcl_NewByteArrayObj(splash->image, splash->image_len);
     dylib_tcltk->Tcl_SetVar2Ex(splash->interp, "_image_data", NULL, image_data_obj, TCL_GLOBAL_ONLY);
 
-    /* Tcl/Tk creates a copy of the image, so we can free our buffer */
-    free(splash->image);
-    splash->image = NULL;
-
     err = dylib_tcltk->Tcl_EvalEx(splash->interp, splash->script, splash->script_len, TCL_GLOBAL_ONLY);
 
     if (err) {
@@ -934,6 +1103,10 @@ _splash_init(ClientData client_data)
     dylib_tcltk->Tcl_ConditionNotify(&splash->start_cond);
     dylib_tcltk->Tcl_MutexUnlock(&splash->start_mutex);
 
+    /* Start polling the status slot; this applies any status that has
+     * been stored before the script was evaluated, too. */
+    _pyi_splash_status_poll(splash);
+
     /* Main loop.
      * we exit this loop from within tcl. */
     while (dylib_tcltk->Tk_GetNumMainWindows() > 0 && !splash->exit_main_loop) {
@@ -951,6 +1124,12 @@ _splash_init(ClientData client_data)
 
     PYI_DEBUG("SPLASH: starting clean-up in splash screen thread...\n");
 
+    /* Stop polling the status slot. */
+    if (splash->status_timer != NULL) {
+        dylib_tcltk->Tcl_DeleteTimerHandler(splash->status_timer);
+        splash->status_timer = NULL;
+    }
+
     /* Delete the Tcl interpreter. */
     dylib_tcltk->Tcl_DeleteInterp(splash->interp);
     splash->interp = NULL;
@@ -977,3 +1156,81 @@ _splash_init(ClientData client_data)
 
     TCL_THREAD_CREATE_RETURN;
 }
+
+#else /* !defined(PYI_WITHOUT_SPLASH) */
+
+/* Splash screen support is compiled out of this bootloader variant
+ * (see the lean variants in wscript); provide no-op implementations of
+ * the functions used by the rest of the bootloader. The splash screen
+ * is suppressed in pyi_main(), so a context is never created. */
+int
+pyi_splash_setup(struct SPLASH_CONTEXT *splash, const struct PYI_CONTEXT *pyi_ctx)
+{
+    return -1;
+}
+
+int
+pyi_splash_start(struct SPLASH_CONTEXT *splash, const char *executable)
+{
+    return -1;
+}
+
+int
+pyi_splash_extract(struct SPLASH_CONTEXT *splash, const struct PYI_CONTEXT *pyi_ctx)
+{
+    return -1;
+}
+
+int
+pyi_splash_is_splash_requirement(struct SPLASH_CONTEXT *splash, const char *name)
+{
+    return 0;
+}
+
+void
+pyi_splash_release_resources(struct SPLASH_CONTEXT *splash)
+{
+}
+
+int
+pyi_splash_load_shared_libraries(struct SPLASH_CONTEXT *splash)
+{
+    return -1;
+}
+
+int
+pyi_splash_finalize(struct SPLASH_CONTEXT *splash)
+{
+    return 0;
+}
+
+struct SPLASH_CONTEXT *
+pyi_splash_context_new()
+{
+    return NULL;
+}
+
+void
+pyi_splash_context_free(struct SPLASH_CONTEXT **splash_ref)
+{
+    *splash_ref = NULL;
+}
+
+int
+pyi_splash_update_text(struct SPLASH_CONTEXT *splash, const char *text)
+{
+    return 0;
+}
+
+void
+pyi_splash_update_progress(struct SPLASH_CONTEXT *splash, uint64_t bytes_done, uint64_t bytes_total)
+{
+}
+
+int
+pyi_splash_send(struct SPLASH_CONTEXT *splash, bool async, const void *user_data, pyi_splash_event_proc proc)
+{
+    return -1;
+}
+
+#endif /* !defined(PYI_WITHOUT_SPLASH) */
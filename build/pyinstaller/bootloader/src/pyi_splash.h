@@ -48,12 +48,58 @@ struct SPLASH_DATA_HEADER
     uint32_t requirements_len;
     uint32_t requirements_offset;
 
+    /* Backend used to display the splash screen (PYI_SPLASH_BACKEND_*),
+     * and PYI_SPLASH_FLAG_* flags. */
+    uint32_t backend;
+    uint32_t flags;
+
+    /*
+     * The following fields are used only by the native backend. In that
+     * case, the Tcl/Tk fields above are empty, the requirements array
+     * is empty, the image is stored as raw RGBA pixels (row by row, top
+     * to bottom), and the script holds the initial status text.
+     */
+    uint32_t image_width;
+    uint32_t image_height;
+
+    /* Status text; the position is that of the lower left corner of the
+     * text, and the size is in pixels. The color is stored as 0xRRGGBB.
+     * An empty font name selects the default font. */
+    char text_font[32];
+    int32_t text_pos_x;
+    int32_t text_pos_y;
+    int32_t text_size;
+    uint32_t text_color;
+
+    /* Bounding box and color of the progress bar */
+    int32_t progress_bar_x0;
+    int32_t progress_bar_y0;
+    int32_t progress_bar_x1;
+    int32_t progress_bar_y1;
+    uint32_t progress_bar_color;
+
     /*
      * Followed by a chunk of data, including the splash screen
      * script, the image, and the required files array.
      */
 };
 
+/* Splash screen backends */
+#define PYI_SPLASH_BACKEND_TCLTK 0
+#define PYI_SPLASH_BACKEND_NATIVE 1
+
+/* Splash screen flags */
+#define PYI_SPLASH_FLAG_ALWAYS_ON_TOP 0x01
+#define PYI_SPLASH_FLAG_TEXT 0x02
+#define PYI_SPLASH_FLAG_PROGRESS_BAR 0x04
+
+/* Interval (in milliseconds) at which the splash screen thread polls
+ * the status slot and applies the pending status text and progress
+ * updates to the Tcl interpreter; about 30 frames per second. */
+#define PYI_SPLASH_STATUS_POLL_INTERVAL 33
+
+struct SPLASH_NATIVE;
+
 /* Runtime context for the splash screen */
 struct SPLASH_CONTEXT
 {
@@ -71,6 +117,22 @@ struct SPLASH_CONTEXT
     Tcl_Mutex exit_mutex;
     bool exit_main_loop;
 
+    /* Status slot, written by the bootloader's main thread and polled
+     * by the Tcl interpreter thread every PYI_SPLASH_STATUS_POLL_INTERVAL
+     * milliseconds. Only the latest status is kept, so that frequent
+     * updates (e.g., one per extracted file) are coalesced instead of
+     * each being posted into the Tcl event queue. Access is guarded by
+     * status_mutex. */
+    Tcl_Mutex status_mutex;
+    char status_text[PYI_PATH_MAX];
+    bool status_text_dirty;
+    uint64_t status_bytes_done;
+    uint64_t status_bytes_total;
+    bool status_progress_dirty;
+
+    /* Timer that polls the status slot; owned by the Tcl thread. */
+    Tcl_TimerToken status_timer;
+
     /* The Tcl interpreter in which the splash screen will run. Runs
      * in a secondary thread, as we cannot block the program's primary
      * thread (which in onedir mode needs to run user's python program
@@ -95,28 +157,53 @@ struct SPLASH_CONTEXT
     char tk_libpath[PYI_PATH_MAX];
     char tk_lib[PYI_PATH_MAX];
 
+    /* Decompressed data of the splash resources entry, which the script,
+     * image and requirements fields point into; NULL if the entry is
+     * used directly from the archive's memory mapping. */
+    unsigned char *resources;
+
     /* The Tcl script that creates splash screen and the IPC mechanism
-     * to communicate with python code. */
-    char *script;
+     * to communicate with python code. Not NUL-terminated. */
+    const char *script;
     int script_len;
 
-    /* Image to be show on the splash screen.
-     * The image data pointer will eventually be NULL, because it is only
-     * kept until the Tcl interpreter is fully set up, at which point it
-     * copies the image data into its own data buffer. */
-    void *image;
+    /* Image to be show on the splash screen. Tcl/Tk (or the native
+     * backend) creates its own copy of the image data. */
+    const void *image;
     int image_len;
 
     /* To start Tcl/Tk, its files need to be present on the filesystem.
      * These fields describe an array of NULL-terminated strings, that
      * contain filenames of files that need to be extracted from
      * PKG/CArchive in onefile mode before splash screen can be started. */
-    char *requirements;
+    const char *requirements;
     int requirements_len;
 
     /* Structure that encapsulates loaded Tcl and Tk shared library and
      * pointers to imported functions. */
     struct DYLIB_TCLTK *dylib_tcltk;
+
+    /* Backend used to display the splash screen (PYI_SPLASH_BACKEND_*),
+     * and PYI_SPLASH_FLAG_* flags. */
+    int backend;
+    uint32_t flags;
+
+    /* Options of the native backend; see SPLASH_DATA_HEADER. */
+    int image_width;
+    int image_height;
+    char text_font[32];
+    int text_pos_x;
+    int text_pos_y;
+    int text_size;
+    uint32_t text_color;
+    int progress_bar_x0;
+    int progress_bar_y0;
+    int progress_bar_x1;
+    int progress_bar_y1;
+    uint32_t progress_bar_color;
+
+    /* Run-time state of the native backend; see pyi_splash_native.c */
+    struct SPLASH_NATIVE *native;
 };
 
 typedef int (pyi_splash_event_proc)(struct SPLASH_CONTEXT *, const void *);
@@ -136,6 +223,7 @@ int pyi_splash_start(struct SPLASH_CONTEXT *splash, const char *executable);
 /* Archive helper functions */
 int pyi_splash_extract(struct SPLASH_CONTEXT *splash, const struct PYI_CONTEXT *pyi_ctx);
 int pyi_splash_is_splash_requirement(struct SPLASH_CONTEXT *splash, const char *name);
+void pyi_splash_release_resources(struct SPLASH_CONTEXT *splash);
 
 int pyi_splash_send(
     struct SPLASH_CONTEXT *splash,
@@ -144,6 +232,7 @@ int pyi_splash_send(
     pyi_splash_event_proc proc
 );
 int pyi_splash_update_text(struct SPLASH_CONTEXT *splash, const char *toc_entry_name);
+void pyi_splash_update_progress(struct SPLASH_CONTEXT *splash, uint64_t bytes_done, uint64_t bytes_total);
 
 /* Memory allocation functions */
 struct SPLASH_CONTEXT *pyi_splash_context_new();
@@ -0,0 +1,1314 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Native splash screen backend.
+ *
+ * Instead of running a Tcl/Tk script, this backend draws the splash
+ * screen using the platform's window API: a layered window with
+ * per-pixel alpha on Windows, and a plain Xlib window on other POSIX
+ * systems (where Xlib is loaded at run-time; on Wayland, this requires
+ * XWayland). As it does not need to extract and load Tcl/Tk, the splash
+ * screen is shown almost immediately after the program is started.
+ *
+ * The splash screen consists of the image, which is stored in the
+ * splash resources as raw RGBA pixels, an optional single-line status
+ * text, and an optional progress bar. Both are updated from the status
+ * slot, which is written by the bootloader's main thread and polled
+ * by the splash screen thread every PYI_SPLASH_STATUS_POLL_INTERVAL
+ * milliseconds, the same as in the Tcl/Tk backend.
+ *
+ * To remain compatible with the `pyi_splash` module, the backend
+ * implements the server side of its IPC protocol: it listens on a
+ * local TCP socket (whose port is published via `_PYI_SPLASH_IPC`
+ * environment variable), and accepts `update_text(...)` commands
+ * terminated by carriage return. The splash screen is closed when the
+ * connection is closed or the End-of-Transmission character is received.
+ *
+ * On macOS, UI operations are allowed only in the main thread of the
+ * process, so the splash screen is not supported there (the same as
+ * with the Tcl/Tk backend).
+ */
+
+#ifdef _WIN32
+    #include <windows.h> /* also includes winsock.h */
+#else
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <sys/select.h>
+    #include <sys/time.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* PyInstaller headers */
+#include "pyi_global.h"
+#include "pyi_splash.h"
+#include "pyi_splash_native.h"
+#include "pyi_thread.h"
+#include "pyi_utils.h"
+
+#if !defined(_WIN32) && !defined(__APPLE__) && defined(HAVE_X11_XLIB_H) && !defined(PYI_WITHOUT_SPLASH)
+    #define PYI_SPLASH_NATIVE_X11
+    #include <X11/Xatom.h>
+    #include "pyi_dylib_x11.h"
+#endif
+
+#if PYI_HAVE_THREADS && (defined(_WIN32) || defined(PYI_SPLASH_NATIVE_X11)) && !defined(PYI_WITHOUT_SPLASH)
+    #define PYI_SPLASH_NATIVE_AVAILABLE
+#endif
+
+
+#if defined(PYI_SPLASH_NATIVE_AVAILABLE)
+
+#if defined(_WIN32)
+typedef SOCKET pyi_socket_t;
+    #define PYI_INVALID_SOCKET INVALID_SOCKET
+    #define pyi_socket_close closesocket
+
+/* Window message that is posted for socket events (WSAAsyncSelect). */
+    #define _PYI_SPLASH_NATIVE_WM_SOCKET (WM_APP + 1)
+
+/* ID of the timer that polls the status slot. */
+    #define _PYI_SPLASH_NATIVE_TIMER_ID 1
+
+static const wchar_t *_pyi_splash_native_class_name = L"PyInstallerSplashScreen";
+#else
+typedef int pyi_socket_t;
+    #define PYI_INVALID_SOCKET (-1)
+    #define pyi_socket_close close
+#endif
+
+/* End-of-Transmission character, sent by `pyi_splash` module to close
+ * the splash screen. */
+#define _PYI_SPLASH_NATIVE_CLOSE_CHARACTER '\x04'
+
+/* A connection from `pyi_splash` module */
+struct SPLASH_NATIVE_CLIENT
+{
+    pyi_socket_t socket;
+
+    /* Partially received command; if length equals the size of the
+     * buffer, the command is too long and is discarded. */
+    char buffer[PYI_PATH_MAX];
+    size_t length;
+};
+
+/* Run-time state of the native backend */
+struct SPLASH_NATIVE
+{
+    /* The splash screen thread; the mutex and condition guard the
+     * fields shared with the main thread (start-up state, exit request,
+     * and status slot). */
+    pyi_thread_t thread;
+    bool thread_started;
+    pyi_mutex_t mutex;
+    pyi_cond_t cond;
+
+    /* Start-up state, set by the splash screen thread: 0 while starting,
+     * 1 once the splash screen is shown, -1 if it failed to start. */
+    int state;
+
+    /* Set by the main thread to close the splash screen. */
+    bool exit_requested;
+
+    /* Status slot; the latest status text and progress. */
+    char status_text[PYI_PATH_MAX];
+    uint64_t bytes_done;
+    uint64_t bytes_total;
+    bool status_dirty;
+
+    /* Status that is currently displayed; owned by the splash screen
+     * thread. The progress is in percent. */
+    char text[PYI_PATH_MAX];
+    int progress;
+
+    /* The image, as premultiplied 0xAARRGGBB pixels. */
+    uint32_t *image;
+    int width;
+    int height;
+
+    /* IPC server socket and connections */
+    pyi_socket_t ipc_socket;
+    struct SPLASH_NATIVE_CLIENT clients[PYI_SPLASH_NATIVE_MAX_CLIENTS];
+
+#if defined(_WIN32)
+    bool wsa_initialized;
+
+    HWND hwnd;
+
+    /* The frame that is displayed in the layered window */
+    HDC frame_dc;
+    HBITMAP frame_bitmap;
+    HGDIOBJ frame_old_bitmap;
+    uint32_t *frame;
+
+    /* Mask into which the text is drawn (white on black), and which is
+     * then used to blend the text into the frame. GDI does not preserve
+     * alpha channel, so the text cannot be drawn into frame directly. */
+    HDC mask_dc;
+    HBITMAP mask_bitmap;
+    HGDIOBJ mask_old_bitmap;
+    uint32_t *mask;
+    HFONT font;
+    HGDIOBJ mask_old_font;
+#else
+    struct DYLIB_X11 *dylib_x11;
+    Display *display;
+    Window window;
+    GC gc;
+    XFontStruct *font;
+    XImage *ximage;
+    uint32_t *frame;
+#endif
+};
+
+
+/**********************************************************************\
+ *                          Common helpers                            *
+\**********************************************************************/
+
+/* Set the start-up state, and notify the main thread. */
+static void
+_pyi_splash_native_set_state(struct SPLASH_NATIVE *native, int state)
+{
+    pyi_mutex_lock(&native->mutex);
+    native->state = state;
+    pyi_cond_broadcast(&native->cond);
+    pyi_mutex_unlock(&native->mutex);
+}
+
+/* Check whether the main thread requested the splash screen to close. */
+static bool
+_pyi_splash_native_exit_requested(struct SPLASH_NATIVE *native)
+{
+    bool exit_requested;
+
+    pyi_mutex_lock(&native->mutex);
+    exit_requested = native->exit_requested;
+    pyi_mutex_unlock(&native->mutex);
+
+    return exit_requested;
+}
+
+/* Store the status text into the status slot. */
+static void
+_pyi_splash_native_set_text(struct SPLASH_NATIVE *native, const char *text, size_t length)
+{
+    if (length >= sizeof(native->status_text)) {
+        length = sizeof(native->status_text) - 1;
+    }
+
+    pyi_mutex_lock(&native->mutex);
+    memcpy(native->status_text, text, length);
+    native->status_text[length] = '\0';
+    native->status_dirty = true;
+    pyi_mutex_unlock(&native->mutex);
+}
+
+/*
+ * Copy the pending status from the status slot into the displayed
+ * status. Returns true if the displayed status has changed and the
+ * splash screen needs to be redrawn.
+ */
+static bool
+_pyi_splash_native_poll_status(struct SPLASH_NATIVE *native)
+{
+    bool changed = false;
+    int progress;
+
+    pyi_mutex_lock(&native->mutex);
+    if (native->status_dirty) {
+        if (strcmp(native->text, native->status_text) != 0) {
+            memcpy(native->text, native->status_text, sizeof(native->text));
+            changed = true;
+        }
+
+        progress = 100;
+        if (native->bytes_total > 0 && native->bytes_done < native->bytes_total) {
+            progress = (int)(native->bytes_done * 100 / native->bytes_total);
+        }
+        if (native->bytes_total == 0 && native->bytes_done == 0) {
+            progress = 0;
+        }
+        if (progress != native->progress) {
+            native->progress = progress;
+            changed = true;
+        }
+
+        native->status_dirty = false;
+    }
+    pyi_mutex_unlock(&native->mutex);
+
+    return changed;
+}
+
+/*
+ * Convert the RGBA image from the splash resources into premultiplied
+ * 0xAARRGGBB pixels, which is the format used by both Win32 layered
+ * windows and (when composed over black) X11 TrueColor visuals.
+ */
+static int
+_pyi_splash_native_prepare_image(const struct SPLASH_CONTEXT *splash, struct SPLASH_NATIVE *native)
+{
+    const unsigned char *src = (const unsigned char *)splash->image;
+    size_t count = (size_t)splash->image_width * (size_t)splash->image_height;
+    size_t i;
+
+    native->image = (uint32_t *)malloc(count * sizeof(uint32_t));
+    if (native->image == NULL) {
+        PYI_ERROR("SPLASH: could not allocate memory for splash screen image.\n");
+        return -1;
+    }
+    native->width = splash->image_width;
+    native->height = splash->image_height;
+
+    for (i = 0; i < count; i++, src += 4) {
+        uint32_t alpha = src[3];
+        uint32_t red = (src[0] * alpha + 127) / 255;
+        uint32_t green = (src[1] * alpha + 127) / 255;
+        uint32_t blue = (src[2] * alpha + 127) / 255;
+        native->image[i] = (alpha << 24) | (red << 16) | (green << 8) | blue;
+    }
+
+    return 0;
+}
+
+/* Compose the image and the progress bar into the given frame buffer. */
+static void
+_pyi_splash_native_compose(const struct SPLASH_CONTEXT *splash, const struct SPLASH_NATIVE *native, uint32_t *frame)
+{
+    memcpy(frame, native->image, (size_t)native->width * (size_t)native->height * sizeof(uint32_t));
+
+    if ((splash->flags & PYI_SPLASH_FLAG_PROGRESS_BAR) && native->progress > 0) {
+        uint32_t color = 0xFF000000 | (splash->progress_bar_color & 0x00FFFFFF);
+        int x0 = splash->progress_bar_x0;
+        int y0 = splash->progress_bar_y0;
+        int x1 = x0 + (splash->progress_bar_x1 - splash->progress_bar_x0) * native->progress / 100;
+        int y1 = splash->progress_bar_y1;
+        int x;
+        int y;
+
+        /* Clip to the image */
+        x0 = x0 < 0 ? 0 : x0;
+        y0 = y0 < 0 ? 0 : y0;
+        x1 = x1 > native->width ? native->width : x1;
+        y1 = y1 > native->height ? native->height : y1;
+
+        for (y = y0; y < y1; y++) {
+            for (x = x0; x < x1; x++) {
+                frame[(size_t)y * native->width + x] = color;
+            }
+        }
+    }
+}
+
+
+/**********************************************************************\
+ *                           IPC server                               *
+\**********************************************************************/
+
+/* Open the IPC server socket on a local, operating-system assigned
+ * port, and return the port number. */
+static int
+_pyi_splash_native_ipc_open(struct SPLASH_NATIVE *native)
+{
+    struct sockaddr_in address;
+#if defined(_WIN32)
+    int address_length = sizeof(address);
+#else
+    socklen_t address_length = sizeof(address);
+#endif
+
+    native->ipc_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (native->ipc_socket == PYI_INVALID_SOCKET) {
+        PYI_DEBUG("SPLASH: failed to create IPC socket.\n");
+        return -1;
+    }
+
+    /* Do not leak the socket into the child process (onefile). */
+#if defined(_WIN32)
+    SetHandleInformation((HANDLE)native->ipc_socket, HANDLE_FLAG_INHERIT, 0);
+#else
+    fcntl(native->ipc_socket, F_SETFD, FD_CLOEXEC);
+    fcntl(native->ipc_socket, F_SETFL, fcntl(native->ipc_socket, F_GETFL) | O_NONBLOCK);
+#endif
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    if (bind(native->ipc_socket, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(native->ipc_socket, PYI_SPLASH_NATIVE_MAX_CLIENTS) != 0 ||
+        getsockname(native->ipc_socket, (struct sockaddr *)&address, &address_length) != 0) {
+        PYI_DEBUG("SPLASH: failed to set up IPC socket.\n");
+        return -1;
+    }
+
+    return ntohs(address.sin_port);
+}
+
+/* Accept a connection on the IPC server socket. Returns pointer to the
+ * client or NULL if no connection could be accepted. */
+static struct SPLASH_NATIVE_CLIENT *
+_pyi_splash_native_ipc_accept(struct SPLASH_NATIVE *native)
+{
+    struct SPLASH_NATIVE_CLIENT *client = NULL;
+    pyi_socket_t client_socket;
+    int i;
+
+    client_socket = accept(native->ipc_socket, NULL, NULL);
+    if (client_socket == PYI_INVALID_SOCKET) {
+        return NULL;
+    }
+
+    for (i = 0; i < PYI_SPLASH_NATIVE_MAX_CLIENTS; i++) {
+        if (native->clients[i].socket == PYI_INVALID_SOCKET) {
+            client = &native->clients[i];
+            break;
+        }
+    }
+    if (client == NULL) {
+        PYI_DEBUG("SPLASH: too many IPC connections; rejecting a connection.\n");
+        pyi_socket_close(client_socket);
+        return NULL;
+    }
+
+#if defined(_WIN32)
+    SetHandleInformation((HANDLE)client_socket, HANDLE_FLAG_INHERIT, 0);
+#else
+    fcntl(client_socket, F_SETFD, FD_CLOEXEC);
+#endif
+
+    client->socket = client_socket;
+    client->length = 0;
+
+    PYI_DEBUG("SPLASH: accepted IPC connection.\n");
+    return client;
+}
+
+/* Process a command received from the client. */
+static void
+_pyi_splash_native_ipc_command(struct SPLASH_NATIVE *native, const char *command, size_t length)
+{
+    static const char update_text[] = "update_text(";
+    const size_t prefix_length = sizeof(update_text) - 1;
+
+    if (length > prefix_length && strncmp(command, update_text, prefix_length) == 0 && command[length - 1] == ')') {
+        _pyi_splash_native_set_text(native, command + prefix_length, length - prefix_length - 1);
+    }
+}
+
+/*
+ * Receive and process data from the client. Returns -1 if the splash
+ * screen should be closed (the connection was closed, an error has
+ * occurred, or the close character was received), and 0 otherwise.
+ */
+static int
+_pyi_splash_native_ipc_receive(struct SPLASH_NATIVE *native, struct SPLASH_NATIVE_CLIENT *client)
+{
+    char data[512];
+    int count;
+    int i;
+
+    count = (int)recv(client->socket, data, sizeof(data), 0);
+    if (count == 0) {
+        PYI_DEBUG("SPLASH: IPC connection was closed.\n");
+        return -1;
+    }
+    if (count < 0) {
+#if defined(_WIN32)
+        if (WSAGetLastError() == WSAEWOULDBLOCK) {
+            return 0;
+        }
+#else
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+#endif
+        PYI_DEBUG("SPLASH: failed to receive data from IPC connection.\n");
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        char c = data[i];
+
+        if (c == _PYI_SPLASH_NATIVE_CLOSE_CHARACTER) {
+            PYI_DEBUG("SPLASH: received request to close the splash screen.\n");
+            return -1;
+        } else if (c == '\r' || c == '\n') {
+            if (client->length < sizeof(client->buffer)) {
+                _pyi_splash_native_ipc_command(native, client->buffer, client->length);
+            }
+            client->length = 0;
+        } else if (client->length < sizeof(client->buffer) - 1) {
+            client->buffer[client->length++] = c;
+        } else {
+            /* Command is too long; discard it. */
+            client->length = sizeof(client->buffer);
+        }
+    }
+
+    return 0;
+}
+
+/* Close the IPC server socket and all connections. */
+static void
+_pyi_splash_native_ipc_close(struct SPLASH_NATIVE *native)
+{
+    int i;
+
+    for (i = 0; i < PYI_SPLASH_NATIVE_MAX_CLIENTS; i++) {
+        if (native->clients[i].socket != PYI_INVALID_SOCKET) {
+            pyi_socket_close(native->clients[i].socket);
+            native->clients[i].socket = PYI_INVALID_SOCKET;
+        }
+    }
+
+    if (native->ipc_socket != PYI_INVALID_SOCKET) {
+        pyi_socket_close(native->ipc_socket);
+        native->ipc_socket = PYI_INVALID_SOCKET;
+    }
+}
+
+
+#if defined(_WIN32)
+
+/**********************************************************************\
+ *                     Windows: layered window                         *
+\**********************************************************************/
+
+/* Blend the text from the mask into the frame, within the given
+ * rectangle. The mask holds the coverage of the text (drawn in white
+ * on black), and the text color is opaque. */
+static void
+_pyi_splash_native_blend_text(const struct SPLASH_CONTEXT *splash, struct SPLASH_NATIVE *native, const RECT *rect)
+{
+    uint32_t color = splash->text_color & 0x00FFFFFF;
+    uint32_t text_channels[4];
+    int x;
+    int y;
+
+    text_channels[0] = 0xFF;
+    text_channels[1] = (color >> 16) & 0xFF;
+    text_channels[2] = (color >> 8) & 0xFF;
+    text_channels[3] = color & 0xFF;
+
+    for (y = rect->top; y < rect->bottom; y++) {
+        for (x = rect->left; x < rect->right; x++) {
+            size_t index = (size_t)y * native->width + x;
+            uint32_t coverage = native->mask[index] & 0xFF;
+            uint32_t pixel = native->frame[index];
+            uint32_t result = 0;
+            int channel;
+
+            if (coverage == 0) {
+                continue;
+            }
+
+            for (channel = 0; channel < 4; channel++) {
+                int shift = 24 - channel * 8;
+                uint32_t value = (pixel >> shift) & 0xFF;
+                value = (text_channels[channel] * coverage + value * (255 - coverage) + 127) / 255;
+                result |= value << shift;
+            }
+            native->frame[index] = result;
+        }
+    }
+}
+
+/* Draw the splash screen into the layered window. */
+static void
+_pyi_splash_native_draw(const struct SPLASH_CONTEXT *splash, struct SPLASH_NATIVE *native)
+{
+    BLENDFUNCTION blend = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+    POINT source_position = { 0, 0 };
+    SIZE size = { native->width, native->height };
+
+    _pyi_splash_native_compose(splash, native, native->frame);
+
+    if ((splash->flags & PYI_SPLASH_FLAG_TEXT) && native->text[0] != '\0' && native->mask_dc != NULL) {
+        wchar_t text[PYI_PATH_MAX];
+        SIZE text_size;
+        RECT rect;
+        int length;
+
+        if (pyi_win32_utf8_to_wcs(native->text, text, PYI_PATH_MAX) != NULL) {
+            length = (int)wcslen(text);
+            GetTextExtentPoint32W(native->mask_dc, text, length, &text_size);
+
+            /* Text position is that of the lower left corner of the text */
+            rect.left = splash->text_pos_x < 0 ? 0 : splash->text_pos_x;
+            rect.top = splash->text_pos_y - text_size.cy < 0 ? 0 : splash->text_pos_y - text_size.cy;
+            rect.right = splash->text_pos_x + text_size.cx > native->width ? native->width : splash->text_pos_x + text_size.cx;
+            rect.bottom = splash->text_pos_y > native->height ? native->height : splash->text_pos_y;
+
+            if (rect.left < rect.right && rect.top < rect.bottom) {
+                memset(native->mask, 0, (size_t)native->width * native->height * sizeof(uint32_t));
+                TextOutW(native->mask_dc, splash->text_pos_x, splash->text_pos_y, text, length);
+                GdiFlush();
+                _pyi_splash_native_blend_text(splash, native, &rect);
+            }
+        }
+    }
+
+    UpdateLayeredWindow(native->hwnd, NULL, NULL, &size, native->frame_dc, &source_position, 0, &blend, ULW_ALPHA);
+}
+
+/* Window procedure of the splash screen window */
+static LRESULT CALLBACK
+_pyi_splash_native_wndproc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam)
+{
+    struct SPLASH_CONTEXT *splash = (struct SPLASH_CONTEXT *)GetWindowLongPtrW(hwnd, GWLP_USERDATA);
+    struct SPLASH_NATIVE *native;
+
+    if (splash == NULL) {
+        return DefWindowProcW(hwnd, message, wparam, lparam);
+    }
+    native = splash->native;
+
+    switch (message) {
+        case WM_TIMER: {
+            if (_pyi_splash_native_exit_requested(native)) {
+                DestroyWindow(hwnd);
+            } else if (_pyi_splash_native_poll_status(native)) {
+                _pyi_splash_native_draw(splash, native);
+            }
+            return 0;
+        }
+        case _PYI_SPLASH_NATIVE_WM_SOCKET: {
+            SOCKET event_socket = (SOCKET)wparam;
+            int event = WSAGETSELECTEVENT(lparam);
+            struct SPLASH_NATIVE_CLIENT *client = NULL;
+            int i;
+
+            if (event == FD_ACCEPT) {
+                client = _pyi_splash_native_ipc_accept(native);
+                if (client != NULL) {
+                    WSAAsyncSelect(client->socket, hwnd, _PYI_SPLASH_NATIVE_WM_SOCKET, FD_READ | FD_CLOSE);
+                }
+                return 0;
+            }
+
+            for (i = 0; i < PYI_SPLASH_NATIVE_MAX_CLIENTS; i++) {
+                if (native->clients[i].socket == event_socket) {
+                    client = &native->clients[i];
+                    break;
+                }
+            }
+            if (client == NULL) {
+                return 0;
+            }
+
+            /* Process the remaining data also when the connection is
+             * being closed; the close itself is then reported by recv(). */
+            if (_pyi_splash_native_ipc_receive(native, client) < 0 || event == FD_CLOSE) {
+                DestroyWindow(hwnd);
+            }
+            return 0;
+        }
+        case WM_CLOSE: {
+            DestroyWindow(hwnd);
+            return 0;
+        }
+        case WM_DESTROY: {
+            KillTimer(hwnd, _PYI_SPLASH_NATIVE_TIMER_ID);
+            pyi_mutex_lock(&native->mutex);
+            native->hwnd = NULL;
+            pyi_mutex_unlock(&native->mutex);
+            PostQuitMessage(0);
+            return 0;
+        }
+        default: {
+            break;
+        }
+    }
+
+    return DefWindowProcW(hwnd, message, wparam, lparam);
+}
+
+/* Create a 32-bit top-down DIB section and a memory DC for it. */
+static int
+_pyi_splash_native_create_dib(int width, int height, HDC *dc, HBITMAP *bitmap, HGDIOBJ *old_bitmap, uint32_t **pixels)
+{
+    BITMAPINFO bitmap_info;
+    HDC screen_dc;
+
+    memset(&bitmap_info, 0, sizeof(bitmap_info));
+    bitmap_info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bitmap_info.bmiHeader.biWidth = width;
+    bitmap_info.bmiHeader.biHeight = -height; /* top-down */
+    bitmap_info.bmiHeader.biPlanes = 1;
+    bitmap_info.bmiHeader.biBitCount = 32;
+    bitmap_info.bmiHeader.biCompression = BI_RGB;
+
+    screen_dc = GetDC(NULL);
+    *dc = CreateCompatibleDC(screen_dc);
+    *bitmap = CreateDIBSection(screen_dc, &bitmap_info, DIB_RGB_COLORS, (void **)pixels, NULL, 0);
+    ReleaseDC(NULL, screen_dc);
+
+    if (*dc == NULL || *bitmap == NULL) {
+        PYI_WINERROR_W(L"CreateDIBSection", L"Failed to create bitmap for splash screen.\n");
+        return -1;
+    }
+    *old_bitmap = SelectObject(*dc, *bitmap);
+
+    return 0;
+}
+
+/* Create the splash screen window. */
+static int
+_pyi_splash_native_window_create(struct SPLASH_CONTEXT *splash, struct SPLASH_NATIVE *native)
+{
+    HINSTANCE instance = GetModuleHandleW(NULL);
+    WNDCLASSEXW window_class;
+    DWORD ex_style;
+    HWND hwnd;
+    int x;
+    int y;
+
+    memset(&window_class, 0, sizeof(window_class));
+    window_class.cbSize = sizeof(window_class);
+    window_class.lpfnWndProc = _pyi_splash_native_wndproc;
+    window_class.hInstance = instance;
+    window_class.hCursor = LoadCursor(NULL, IDC_APPSTARTING);
+    window_class.lpszClassName = _pyi_splash_native_class_name;
+    if (RegisterClassExW(&window_class) == 0 && GetLastError() != ERROR_CLASS_ALREADY_EXISTS) {
+        PYI_WINERROR_W(L"RegisterClassExW", L"Failed to register splash screen window class.\n");
+        return -1;
+    }
+
+    /* Frame and text mask */
+    if (_pyi_splash_native_create_dib(native->width, native->height, &native->frame_dc, &native->frame_bitmap, &native->frame_old_bitmap, &native->frame) < 0) {
+        return -1;
+    }
+    if (splash->flags & PYI_SPLASH_FLAG_TEXT) {
+        wchar_t font_name[32] = L"Segoe UI";
+
+        if (_pyi_splash_native_create_dib(native->width, native->height, &native->mask_dc, &native->mask_bitmap, &native->mask_old_bitmap, &native->mask) < 0) {
+            return -1;
+        }
+        if (splash->text_font[0] != '\0') {
+            pyi_win32_utf8_to_wcs(splash->text_font, font_name, 32);
+        }
+        native->font = CreateFontW(
+            -splash->text_size, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE,
+            DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
+            ANTIALIASED_QUALITY, DEFAULT_PITCH | FF_DONTCARE, font_name
+        );
+        if (native->font != NULL) {
+            native->mask_old_font = SelectObject(native->mask_dc, native->font);
+        }
+        SetTextColor(native->mask_dc, RGB(255, 255, 255));
+        SetBkMode(native->mask_dc, TRANSPARENT);
+        SetTextAlign(native->mask_dc, TA_LEFT | TA_BOTTOM);
+    }
+
+    /* Center the window on the primary monitor */
+    x = (GetSystemMetrics(SM_CXSCREEN) - native->width) / 2;
+    y = (GetSystemMetrics(SM_CYSCREEN) - native->height) / 2;
+
+    ex_style = WS_EX_LAYERED | WS_EX_TOOLWINDOW;
+    if (splash->flags & PYI_SPLASH_FLAG_ALWAYS_ON_TOP) {
+        ex_style |= WS_EX_TOPMOST;
+    }
+
+    hwnd = CreateWindowExW(
+        ex_style, _pyi_splash_native_class_name, L"", WS_POPUP,
+        x, y, native->width, native->height,
+        NULL, NULL, instance, NULL
+    );
+    if (hwnd == NULL) {
+        PYI_WINERROR_W(L"CreateWindowExW", L"Failed to create splash screen window.\n");
+        return -1;
+    }
+    SetWindowLongPtrW(hwnd, GWLP_USERDATA, (LONG_PTR)splash);
+
+    pyi_mutex_lock(&native->mutex);
+    native->hwnd = hwnd;
+    pyi_mutex_unlock(&native->mutex);
+
+    /* Service the IPC socket and poll the status slot from the message loop */
+    WSAAsyncSelect(native->ipc_socket, hwnd, _PYI_SPLASH_NATIVE_WM_SOCKET, FD_ACCEPT);
+    SetTimer(hwnd, _PYI_SPLASH_NATIVE_TIMER_ID, PYI_SPLASH_STATUS_POLL_INTERVAL, NULL);
+
+    /* Draw the initial frame and show the window */
+    _pyi_splash_native_poll_status(native);
+    _pyi_splash_native_draw(splash, native);
+    ShowWindow(hwnd, SW_SHOWNOACTIVATE);
+
+    return 0;
+}
+
+/* Run the message loop until the window is destroyed. */
+static void
+_pyi_splash_native_window_run(struct SPLASH_CONTEXT *splash, struct SPLASH_NATIVE *native)
+{
+    MSG message;
+
+    while (GetMessageW(&message, NULL, 0, 0) > 0) {
+        TranslateMessage(&message);
+        DispatchMessageW(&message);
+    }
+}
+
+/* Destroy the window and free the associated resources. */
+static void
+_pyi_splash_native_window_destroy(struct SPLASH_NATIVE *native)
+{
+    HWND hwnd;
+
+    pyi_mutex_lock(&native->mutex);
+    hwnd = native->hwnd;
+    pyi_mutex_unlock(&native->mutex);
+    if (hwnd != NULL) {
+        DestroyWindow(hwnd);
+    }
+
+    if (native->mask_dc != NULL) {
+        if (native->font != NULL) {
+            SelectObject(native->mask_dc, native->mask_old_font);
+            DeleteObject(native->font);
+        }
+        if (native->mask_bitmap != NULL) {
+            SelectObject(native->mask_dc, native->mask_old_bitmap);
+            DeleteObject(native->mask_bitmap);
+        }
+        DeleteDC(native->mask_dc);
+    }
+    if (native->frame_dc != NULL) {
+        if (native->frame_bitmap != NULL) {
+            SelectObject(native->frame_dc, native->frame_old_bitmap);
+            DeleteObject(native->frame_bitmap);
+        }
+        DeleteDC(native->frame_dc);
+    }
+
+    UnregisterClassW(_pyi_splash_native_class_name, GetModuleHandleW(NULL));
+}
+
+#else /* defined(_WIN32) */
+
+/**********************************************************************\
+ *                           POSIX: Xlib                              *
+\**********************************************************************/
+
+/* Load a font with the given family and pixel size, falling back to
+ * any font of that size, and to the "fixed" font. */
+static XFontStruct *
+_pyi_splash_native_load_font(const struct SPLASH_CONTEXT *splash, struct SPLASH_NATIVE *native)
+{
+    const struct DYLIB_X11 *x11 = native->dylib_x11;
+    char pattern[128];
+    XFontStruct *font;
+
+    snprintf(
+        pattern, sizeof(pattern), "-*-%s-medium-r-normal--%d-*-*-*-*-*-iso8859-1",
+        splash->text_font[0] != '\0' ? splash->text_font : "helvetica",
+        splash->text_size
+    );
+    font = x11->XLoadQueryFont(native->display, pattern);
+    if (font != NULL) {
+        return font;
+    }
+
+    snprintf(pattern, sizeof(pattern), "-*-*-medium-r-normal--%d-*-*-*-*-*-iso8859-1", splash->text_size);
+    font = x11->XLoadQueryFont(native->display, pattern);
+    if (font != NULL) {
+        return font;
+    }
+
+    return x11->XLoadQueryFont(native->display, "fixed");
+}
+
+/* Draw the splash screen into the window. */
+static void
+_pyi_splash_native_draw(const struct SPLASH_CONTEXT *splash, struct SPLASH_NATIVE *native)
+{
+    const struct DYLIB_X11 *x11 = native->dylib_x11;
+
+    _pyi_splash_native_compose(splash, native, native->frame);
+    x11->XPutImage(native->display, native->window, native->gc, native->ximage, 0, 0, 0, 0, native->width, native->height);
+
+    if ((splash->flags & PYI_SPLASH_FLAG_TEXT) && native->text[0] != '\0' && native->font != NULL) {
+        char text[PYI_PATH_MAX];
+        const unsigned char *src;
+        int length = 0;
+
+        /* Core X fonts are used with ISO 8859-1 encoding; replace the
+         * non-ASCII characters from the UTF-8 text. */
+        for (src = (const unsigned char *)native->text; *src != '\0'; src++) {
+            if (*src < 0x80) {
+                text[length++] = (char)*src;
+            } else if (*src >= 0xC0) {
+                text[length++] = '?';
+            }
+        }
+
+        /* Text position is that of the lower left corner of the text */
+        x11->XDrawString(
+            native->display, native->window, native->gc,
+            splash->text_pos_x, splash->text_pos_y - native->font->descent,
+            text, length
+        );
+    }
+
+    x11->XFlush(native->display);
+}
+
+/* Set a property of Atom type on the window. */
+static void
+_pyi_splash_native_set_atom_property(struct SPLASH_NATIVE *native, const char *property, const char *value)
+{
+    const struct DYLIB_X11 *x11 = native->dylib_x11;
+    Atom property_atom = x11->XInternAtom(native->display, property, False);
+    Atom value_atom = x11->XInternAtom(native->display, value, False);
+
+    x11->XChangeProperty(native->display, native->window, property_atom, XA_ATOM, 32, PropModeReplace, (const unsigned char *)&value_atom, 1);
+}
+
+/* Create the splash screen window. */
+static int
+_pyi_splash_native_window_create(struct SPLASH_CONTEXT *splash, struct SPLASH_NATIVE *native)
+{
+    const struct DYLIB_X11 *x11;
+    const uint32_t byte_order_probe = 1;
+    XSizeHints size_hints;
+    Visual *visual;
+    int screen;
+    int depth;
+    int x;
+    int y;
+
+    native->dylib_x11 = pyi_dylib_x11_load();
+    if (native->dylib_x11 == NULL) {
+        PYI_DEBUG("SPLASH: failed to load Xlib shared library.\n");
+        return -1;
+    }
+    x11 = native->dylib_x11;
+
+    native->display = x11->XOpenDisplay(NULL);
+    if (native->display == NULL) {
+        PYI_DEBUG("SPLASH: failed to open X display.\n");
+        return -1;
+    }
+    screen = x11->XDefaultScreen(native->display);
+
+    /* The frame is drawn as 32-bit 0x00RRGGBB pixels, which requires
+     * a TrueColor visual with matching layout (practically universal). */
+    visual = x11->XDefaultVisual(native->display, screen);
+    depth = x11->XDefaultDepth(native->display, screen);
+    if ((depth != 24 && depth != 32) || visual->red_mask != 0xFF0000 || visual->green_mask != 0x00FF00 || visual->blue_mask != 0x0000FF) {
+        PYI_DEBUG("SPLASH: unsupported X visual (depth %d).\n", depth);
+        return -1;
+    }
+
+    native->frame = (uint32_t *)malloc((size_t)native->width * native->height * sizeof(uint32_t));
+    if (native->frame == NULL) {
+        PYI_ERROR("SPLASH: could not allocate memory for splash screen frame.\n");
+        return -1;
+    }
+    native->ximage = x11->XCreateImage(native->display, visual, depth, ZPixmap, 0, (char *)native->frame, native->width, native->height, 32, 0);
+    if (native->ximage == NULL || native->ximage->bits_per_pixel != 32) {
+        PYI_DEBUG("SPLASH: failed to create X image.\n");
+        return -1;
+    }
+    /* The pixels are stored in host byte order; Xlib converts them if
+     * the server uses the other one. */
+    native->ximage->byte_order = *(const unsigned char *)&byte_order_probe ? LSBFirst : MSBFirst;
+
+    /* Center the window on the screen */
+    x = (x11->XDisplayWidth(native->display, screen) - native->width) / 2;
+    y = (x11->XDisplayHeight(native->display, screen) - native->height) / 2;
+
+    native->window = x11->XCreateSimpleWindow(
+        native->display, x11->XRootWindow(native->display, screen),
+        x, y, native->width, native->height, 0, 0, 0
+    );
+
+    memset(&size_hints, 0, sizeof(size_hints));
+    size_hints.flags = USPosition | PPosition | PSize | PMinSize | PMaxSize;
+    size_hints.x = x;
+    size_hints.y = y;
+    size_hints.width = size_hints.min_width = size_hints.max_width = native->width;
+    size_hints.height = size_hints.min_height = size_hints.max_height = native->height;
+    x11->XSetWMNormalHints(native->display, native->window, &size_hints);
+
+    /* Let the window manager know that this is a splash screen (no
+     * decorations); same as `wm attributes . -type splash` in Tk. */
+    _pyi_splash_native_set_atom_property(native, "_NET_WM_WINDOW_TYPE", "_NET_WM_WINDOW_TYPE_SPLASH");
+    if (splash->flags & PYI_SPLASH_FLAG_ALWAYS_ON_TOP) {
+        _pyi_splash_native_set_atom_property(native, "_NET_WM_STATE", "_NET_WM_STATE_ABOVE");
+    }
+
+    x11->XSelectInput(native->display, native->window, ExposureMask);
+    native->gc = x11->XCreateGC(native->display, native->window, 0, NULL);
+
+    if (splash->flags & PYI_SPLASH_FLAG_TEXT) {
+        native->font = _pyi_splash_native_load_font(splash, native);
+        if (native->font != NULL) {
+            x11->XSetFont(native->display, native->gc, native->font->fid);
+        }
+        x11->XSetForeground(native->display, native->gc, splash->text_color & 0x00FFFFFF);
+    }
+
+    x11->XMapRaised(native->display, native->window);
+    x11->XFlush(native->display);
+
+    return 0;
+}
+
+/*
+ * Run the event loop until the splash screen is closed. Waiting for X
+ * events and IPC connections is done with select(), with timeout that
+ * also serves as the status slot poll interval.
+ */
+static void
+_pyi_splash_native_window_run(struct SPLASH_CONTEXT *splash, struct SPLASH_NATIVE *native)
+{
+    const struct DYLIB_X11 *x11 = native->dylib_x11;
+    int display_fd = x11->XConnectionNumber(native->display);
+    bool redraw = true;
+
+    _pyi_splash_native_poll_status(native);
+
+    for (;;) {
+        struct timeval timeout;
+        fd_set read_fds;
+        int max_fd = display_fd;
+        int i;
+
+        /* Process the events that have already been read from the
+         * connection, as select() does not report them. */
+        while (x11->XPending(native->display) > 0) {
+            XEvent event;
+            x11->XNextEvent(native->display, &event);
+            if (event.type == Expose) {
+                redraw = true;
+            }
+        }
+
+        if (_pyi_splash_native_poll_status(native)) {
+            redraw = true;
+        }
+        if (redraw) {
+            _pyi_splash_native_draw(splash, native);
+            redraw = false;
+        }
+
+        if (_pyi_splash_native_exit_requested(native)) {
+            break;
+        }
+
+        FD_ZERO(&read_fds);
+        FD_SET(display_fd, &read_fds);
+        FD_SET(native->ipc_socket, &read_fds);
+        max_fd = native->ipc_socket > max_fd ? native->ipc_socket : max_fd;
+        for (i = 0; i < PYI_SPLASH_NATIVE_MAX_CLIENTS; i++) {
+            if (native->clients[i].socket != PYI_INVALID_SOCKET) {
+                FD_SET(native->clients[i].socket, &read_fds);
+                max_fd = native->clients[i].socket > max_fd ? native->clients[i].socket : max_fd;
+            }
+        }
+
+        timeout.tv_sec = 0;
+        timeout.tv_usec = PYI_SPLASH_STATUS_POLL_INTERVAL * 1000;
+        if (select(max_fd + 1, &read_fds, NULL, NULL, &timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            PYI_DEBUG("SPLASH: select() failed.\n");
+            break;
+        }
+
+        if (FD_ISSET(native->ipc_socket, &read_fds)) {
+            _pyi_splash_native_ipc_accept(native);
+        }
+        for (i = 0; i < PYI_SPLASH_NATIVE_MAX_CLIENTS; i++) {
+            struct SPLASH_NATIVE_CLIENT *client = &native->clients[i];
+            if (client->socket != PYI_INVALID_SOCKET && FD_ISSET(client->socket, &read_fds)) {
+                if (_pyi_splash_native_ipc_receive(native, client) < 0) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+/* Destroy the window and free the associated resources. */
+static void
+_pyi_splash_native_window_destroy(struct SPLASH_NATIVE *native)
+{
+    const struct DYLIB_X11 *x11 = native->dylib_x11;
+
+    if (x11 == NULL) {
+        return;
+    }
+
+    if (native->display != NULL) {
+        if (native->ximage != NULL) {
+            /* The pixel buffer is owned by us. */
+            native->ximage->data = NULL;
+            XDestroyImage(native->ximage);
+        }
+        if (native->font != NULL) {
+            x11->XFreeFont(native->display, native->font);
+        }
+        if (native->gc != NULL) {
+            x11->XFreeGC(native->display, native->gc);
+        }
+        if (native->window != 0) {
+            x11->XDestroyWindow(native->display, native->window);
+        }
+        x11->XCloseDisplay(native->display);
+    }
+    free(native->frame);
+    native->frame = NULL;
+
+    pyi_dylib_x11_cleanup(&native->dylib_x11);
+}
+
+#endif /* defined(_WIN32) */
+
+
+/**********************************************************************\
+ *                        Splash screen thread                        *
+\**********************************************************************/
+
+static PYI_THREAD_PROC_TYPE
+_pyi_splash_native_thread(void *arg)
+{
+    struct SPLASH_CONTEXT *splash = (struct SPLASH_CONTEXT *)arg;
+    struct SPLASH_NATIVE *native = splash->native;
+
+    if (_pyi_splash_native_window_create(splash, native) == 0) {
+        PYI_DEBUG("SPLASH: native splash screen is shown.\n");
+        _pyi_splash_native_set_state(native, 1);
+        _pyi_splash_native_window_run(splash, native);
+    } else {
+        _pyi_splash_native_set_state(native, -1);
+    }
+
+    _pyi_splash_native_window_destroy(native);
+    PYI_DEBUG("SPLASH: native splash screen is closed.\n");
+
+    PYI_THREAD_PROC_RETURN;
+}
+
+
+/**********************************************************************\
+ *                              API                                   *
+\**********************************************************************/
+
+/*
+ * Start the native splash screen. The IPC server socket is opened here,
+ * and the window is created and serviced by a separate thread. This
+ * function returns after the splash screen is shown (or failed to be
+ * shown), so that the `_PYI_SPLASH_IPC` environment variable is set
+ * before the python interpreter is initialized.
+ */
+int
+pyi_splash_native_start(struct SPLASH_CONTEXT *splash)
+{
+    struct SPLASH_NATIVE *native;
+    char port_string[16];
+    int port;
+    int state;
+    int i;
+
+    PYI_DEBUG("SPLASH: starting native splash screen...\n");
+
+    native = (struct SPLASH_NATIVE *)calloc(1, sizeof(struct SPLASH_NATIVE));
+    if (native == NULL) {
+        PYI_PERROR("calloc", "Could not allocate memory for SPLASH_NATIVE.\n");
+        return -1;
+    }
+    native->ipc_socket = PYI_INVALID_SOCKET;
+    for (i = 0; i < PYI_SPLASH_NATIVE_MAX_CLIENTS; i++) {
+        native->clients[i].socket = PYI_INVALID_SOCKET;
+    }
+    if (pyi_mutex_init(&native->mutex) < 0) {
+        free(native);
+        return -1;
+    }
+    if (pyi_cond_init(&native->cond) < 0) {
+        pyi_mutex_destroy(&native->mutex);
+        free(native);
+        return -1;
+    }
+    splash->native = native;
+
+    /* Prepare the image in the native format. */
+    if (_pyi_splash_native_prepare_image(splash, native) < 0) {
+        return -1;
+    }
+    /* The initial status text is stored in place of the script. */
+    if (splash->script != NULL) {
+        _pyi_splash_native_set_text(native, splash->script, (size_t)splash->script_len);
+    }
+
+#if defined(_WIN32)
+    if (1) {
+        WSADATA wsa_data;
+        if (WSAStartup(MAKEWORD(1, 1), &wsa_data) != 0) {
+            PYI_DEBUG("SPLASH: failed to initialize Winsock.\n");
+            return -1;
+        }
+        native->wsa_initialized = true;
+    }
+#endif
+
+    port = _pyi_splash_native_ipc_open(native);
+    if (port < 0) {
+        return -1;
+    }
+
+    if (pyi_thread_create(&native->thread, _pyi_splash_native_thread, splash) < 0) {
+        PYI_DEBUG("SPLASH: failed to create splash screen thread.\n");
+        return -1;
+    }
+    native->thread_started = true;
+
+    /* Wait for the splash screen to be shown */
+    pyi_mutex_lock(&native->mutex);
+    while (native->state == 0) {
+        pyi_cond_wait(&native->cond, &native->mutex);
+    }
+    state = native->state;
+    pyi_mutex_unlock(&native->mutex);
+
+    if (state < 0) {
+        PYI_DEBUG("SPLASH: failed to show native splash screen.\n");
+        return -1;
+    }
+
+    /* Publish the IPC port to the `pyi_splash` module. */
+    snprintf(port_string, sizeof(port_string), "%d", port);
+    pyi_setenv("_PYI_SPLASH_IPC", port_string);
+
+    PYI_DEBUG("SPLASH: native splash screen started.\n");
+    return 0;
+}
+
+/*
+ * Close the native splash screen (if it is still shown), and free the
+ * resources of the backend.
+ */
+void
+pyi_splash_native_finalize(struct SPLASH_CONTEXT *splash)
+{
+    struct SPLASH_NATIVE *native = splash->native;
+
+    if (native == NULL) {
+        return;
+    }
+
+    PYI_DEBUG("SPLASH: cleaning up native splash screen resources...\n");
+
+    if (native->thread_started) {
+#if defined(_WIN32)
+        HWND hwnd;
+#endif
+
+        pyi_mutex_lock(&native->mutex);
+        native->exit_requested = true;
+#if defined(_WIN32)
+        hwnd = native->hwnd;
+#endif
+        pyi_mutex_unlock(&native->mutex);
+
+#if defined(_WIN32)
+        /* Wake up the message loop; otherwise, the request is noticed
+         * at the next timer tick. */
+        if (hwnd != NULL) {
+            PostMessageW(hwnd, WM_CLOSE, 0, 0);
+        }
+#endif
+
+        pyi_thread_join(native->thread);
+    }
+
+    _pyi_splash_native_ipc_close(native);
+
+#if defined(_WIN32)
+    if (native->wsa_initialized) {
+        WSACleanup();
+    }
+#endif
+
+    pyi_cond_destroy(&native->cond);
+    pyi_mutex_destroy(&native->mutex);
+
+    free(native->image);
+    free(native);
+    splash->native = NULL;
+}
+
+void
+pyi_splash_native_update_text(struct SPLASH_CONTEXT *splash, const char *text)
+{
+    if (splash->native == NULL) {
+        return;
+    }
+    _pyi_splash_native_set_text(splash->native, text, strlen(text));
+}
+
+void
+pyi_splash_native_update_progress(struct SPLASH_CONTEXT *splash, uint64_t bytes_done, uint64_t bytes_total)
+{
+    struct SPLASH_NATIVE *native = splash->native;
+
+    if (native == NULL) {
+        return;
+    }
+
+    pyi_mutex_lock(&native->mutex);
+    native->bytes_done = bytes_done;
+    native->bytes_total = bytes_total;
+    native->status_dirty = true;
+    pyi_mutex_unlock(&native->mutex);
+}
+
+#else /* defined(PYI_SPLASH_NATIVE_AVAILABLE) */
+
+/* The native backend is not available on this platform (or build). */
+int
+pyi_splash_native_start(struct SPLASH_CONTEXT *splash)
+{
+    PYI_DEBUG("SPLASH: native splash screen backend is not available on this platform.\n");
+    return -1;
+}
+
+void
+pyi_splash_native_finalize(struct SPLASH_CONTEXT *splash)
+{
+}
+
+void
+pyi_splash_native_update_text(struct SPLASH_CONTEXT *splash, const char *text)
+{
+}
+
+void
+pyi_splash_native_update_progress(struct SPLASH_CONTEXT *splash, uint64_t bytes_done, uint64_t bytes_total)
+{
+}
+
+#endif /* defined(PYI_SPLASH_NATIVE_AVAILABLE) */
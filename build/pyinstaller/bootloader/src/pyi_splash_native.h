@@ -0,0 +1,35 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+#ifndef PYI_SPLASH_NATIVE_H
+#define PYI_SPLASH_NATIVE_H
+
+#include "pyi_global.h"
+#include "pyi_splash.h"
+
+/* Maximum number of simultaneous IPC connections (from `pyi_splash`
+ * module) that the native splash screen services. */
+#define PYI_SPLASH_NATIVE_MAX_CLIENTS 4
+
+/**
+ * Public API functions for the native splash screen backend; these
+ * are called by their pyi_splash counterparts if the native backend
+ * is selected.
+ */
+int pyi_splash_native_start(struct SPLASH_CONTEXT *splash);
+void pyi_splash_native_finalize(struct SPLASH_CONTEXT *splash);
+
+void pyi_splash_native_update_text(struct SPLASH_CONTEXT *splash, const char *text);
+void pyi_splash_native_update_progress(struct SPLASH_CONTEXT *splash, uint64_t bytes_done, uint64_t bytes_total);
+
+#endif /* PYI_SPLASH_NATIVE_H */
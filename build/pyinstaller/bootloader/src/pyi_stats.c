@@ -0,0 +1,236 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Run-time statistics of the bootloader.
+ *
+ * The bootloader counts the work it performs during the startup (the
+ * amount of data read from the PKG archive and decompressed, the number
+ * of created files and directories, the number of processed TOC
+ * entries), and measures the wall-clock duration of its startup phases.
+ * The statistics are published to the frozen application as a read-only
+ * mapping in sys._pyi_stats, right before the bootstrap modules are
+ * executed; the values are therefore a snapshot, and do not include the
+ * work performed afterwards (e.g., loading of modules from PYZ).
+ *
+ * In onefile mode, the parent process passes its statistics to the
+ * child process via the _PYI_PARENT_STATS environment variable.
+ */
+
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h> /* free, strtoull */
+
+#include "pyi_global.h"
+#include "pyi_main.h"
+#include "pyi_stats.h"
+#include "pyi_trace.h"
+#include "pyi_utils.h"
+#include "pyi_dylib_python.h"
+
+
+/* Name of the environment variable used to pass the statistics from
+ * the onefile parent process to its child process. */
+#define _PYI_STATS_PARENT_ENV_VAR "_PYI_PARENT_STATS"
+
+/* Maximal length of the formatted value of the above environment
+ * variable; six decimal numbers, each up to 20 digits long. */
+#define _PYI_STATS_PARENT_ENV_LENGTH 128
+
+
+/*
+ * Atomically add the value to the specified counter. The counters are
+ * updated from extraction worker threads as well, but they are read
+ * only after the workers are joined, so relaxed ordering suffices.
+ */
+void
+pyi_stats_add(uint64_t *counter, uint64_t value)
+{
+#if defined(_WIN32)
+    InterlockedExchangeAdd64((volatile LONG64 *)counter, (LONG64)value);
+#elif defined(__GNUC__) || defined(__clang__)
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+#else
+    *counter += value;
+#endif
+}
+
+
+/*
+ * Mark the beginning of a startup phase; returns the start timestamp that
+ * needs to be passed to pyi_stats_phase_end().
+ */
+uint64_t
+pyi_stats_phase_begin(void)
+{
+    return pyi_trace_get_timestamp();
+}
+
+/*
+ * Mark the end of a startup phase, and add its duration to the phase's
+ * total.
+ */
+void
+pyi_stats_phase_end(struct PYI_CONTEXT *pyi_ctx, enum PYI_STATS_PHASE phase, uint64_t start_time)
+{
+    pyi_ctx->stats.phase_time[phase] += pyi_trace_get_timestamp() - start_time;
+}
+
+
+/*
+ * Pass the statistics of the onefile parent process to its child
+ * process, via environment variable. Must be called before the child
+ * process is spawned.
+ */
+int
+pyi_stats_export_to_child(const struct PYI_CONTEXT *pyi_ctx)
+{
+    const struct PYI_STATS *stats = &pyi_ctx->stats;
+    char value[_PYI_STATS_PARENT_ENV_LENGTH];
+
+    snprintf(
+        value,
+        sizeof(value),
+        "%llu %llu %llu %llu %llu %llu",
+        (unsigned long long)stats->phase_time[PYI_STATS_PHASE_EXTRACTION],
+        (unsigned long long)stats->archive_bytes_read,
+        (unsigned long long)stats->bytes_inflated,
+        (unsigned long long)stats->files_created,
+        (unsigned long long)stats->directories_created,
+        (unsigned long long)stats->toc_entries_processed
+    );
+
+    return pyi_setenv(_PYI_STATS_PARENT_ENV_VAR, value);
+}
+
+/*
+ * In the onefile child process, add the statistics received from the
+ * parent process to our own, and remove the environment variable, so
+ * that it is not inherited by processes spawned by the application.
+ */
+void
+pyi_stats_import_from_parent(struct PYI_CONTEXT *pyi_ctx)
+{
+    struct PYI_STATS *stats = &pyi_ctx->stats;
+    unsigned long long values[6];
+    char *env_var_value;
+
+    env_var_value = pyi_getenv(_PYI_STATS_PARENT_ENV_VAR);
+    if (env_var_value == NULL) {
+        return;
+    }
+    pyi_unsetenv(_PYI_STATS_PARENT_ENV_VAR);
+
+    if (sscanf(env_var_value, "%llu %llu %llu %llu %llu %llu", &values[0], &values[1], &values[2], &values[3], &values[4], &values[5]) != 6) {
+        PYI_DEBUG("LOADER: ignoring malformed %s: %s\n", _PYI_STATS_PARENT_ENV_VAR, env_var_value);
+        free(env_var_value);
+        return;
+    }
+    free(env_var_value);
+
+    stats->parent_extraction_time = values[0];
+    pyi_stats_add(&stats->archive_bytes_read, values[1]);
+    pyi_stats_add(&stats->bytes_inflated, values[2]);
+    pyi_stats_add(&stats->files_created, values[3]);
+    pyi_stats_add(&stats->directories_created, values[4]);
+    pyi_stats_add(&stats->toc_entries_processed, values[5]);
+}
+
+
+/*
+ * Publish the statistics to python interpreter as a read-only mapping
+ * in sys._pyi_stats. The time values are converted to seconds.
+ *
+ * The read-only mapping type (types.MappingProxyType) is obtained as
+ * the type of type.__dict__, which avoids importing the types module
+ * at this early stage.
+ */
+int
+pyi_stats_publish(const struct PYI_CONTEXT *pyi_ctx)
+{
+    const struct DYLIB_PYTHON *dylib_python = pyi_ctx->dylib_python;
+    const struct PYI_STATS *stats = &pyi_ctx->stats;
+    PyObject *builtins_module;
+    PyObject *type_obj = NULL;
+    PyObject *type_dict = NULL;
+    PyObject *mappingproxy_type = NULL;
+    PyObject *stats_obj = NULL;
+    int ret = -1;
+
+    builtins_module = dylib_python->PyImport_ImportModule("builtins");
+    if (builtins_module == NULL) {
+        goto cleanup;
+    }
+    type_obj = dylib_python->PyObject_GetAttrString(builtins_module, "type");
+    if (type_obj == NULL) {
+        goto cleanup;
+    }
+    type_dict = dylib_python->PyObject_GetAttrString(type_obj, "__dict__");
+    if (type_dict == NULL) {
+        goto cleanup;
+    }
+    mappingproxy_type = dylib_python->PyObject_GetAttrString(type_dict, "__class__");
+    if (mappingproxy_type == NULL) {
+        goto cleanup;
+    }
+
+    stats_obj = dylib_python->PyObject_CallFunction(
+        mappingproxy_type,
+        "({s:K,s:K,s:K,s:K,s:K,s:d,s:d,s:d,s:d,s:d,s:d})",
+        "archive_bytes_read", (unsigned long long)stats->archive_bytes_read,
+        "bytes_inflated", (unsigned long long)stats->bytes_inflated,
+        "files_created", (unsigned long long)stats->files_created,
+        "directories_created", (unsigned long long)stats->directories_created,
+        "toc_entries_processed", (unsigned long long)stats->toc_entries_processed,
+        "time_archive_open", stats->phase_time[PYI_STATS_PHASE_ARCHIVE_OPEN] / 1e6,
+        "time_splash_setup", stats->phase_time[PYI_STATS_PHASE_SPLASH_SETUP] / 1e6,
+        "time_extraction", stats->phase_time[PYI_STATS_PHASE_EXTRACTION] / 1e6,
+        "time_python_load", stats->phase_time[PYI_STATS_PHASE_PYTHON_LOAD] / 1e6,
+        "time_python_init", stats->phase_time[PYI_STATS_PHASE_PYTHON_INIT] / 1e6,
+        "parent_extraction_time", stats->parent_extraction_time / 1e6
+    );
+    if (stats_obj == NULL) {
+        goto cleanup;
+    }
+
+    ret = dylib_python->PySys_SetObject("_pyi_stats", stats_obj);
+
+cleanup:
+    if (ret < 0) {
+        PYI_WARNING("Failed to set sys._pyi_stats!\n");
+        if (dylib_python->PyErr_Occurred()) {
+            dylib_python->PyErr_Clear();
+        }
+    }
+
+    if (stats_obj) {
+        dylib_python->Py_DecRef(stats_obj);
+    }
+    if (mappingproxy_type) {
+        dylib_python->Py_DecRef(mappingproxy_type);
+    }
+    if (type_dict) {
+        dylib_python->Py_DecRef(type_dict);
+    }
+    if (type_obj) {
+        dylib_python->Py_DecRef(type_obj);
+    }
+    if (builtins_module) {
+        dylib_python->Py_DecRef(builtins_module);
+    }
+
+    return ret;
+}
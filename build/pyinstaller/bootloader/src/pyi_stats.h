@@ -0,0 +1,76 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Run-time statistics of the bootloader, published to the frozen
+ * application as sys._pyi_stats.
+ */
+
+#ifndef PYI_STATS_H
+#define PYI_STATS_H
+
+#include "pyi_global.h"
+
+struct PYI_CONTEXT;
+
+/* Startup phases whose wall-clock duration is recorded. */
+enum PYI_STATS_PHASE
+{
+    PYI_STATS_PHASE_ARCHIVE_OPEN = 0,
+    PYI_STATS_PHASE_SPLASH_SETUP,
+    PYI_STATS_PHASE_EXTRACTION,
+    PYI_STATS_PHASE_PYTHON_LOAD,
+    PYI_STATS_PHASE_PYTHON_INIT,
+    PYI_STATS_PHASE_COUNT
+};
+
+/* Counters of the work performed by the bootloader. The counters are
+ * updated atomically (via pyi_stats_add()), because the extraction
+ * might be performed by several threads. In the onefile child process,
+ * the counters also include the work performed by the parent process;
+ * see pyi_stats_export_to_child(). */
+struct PYI_STATS
+{
+    /* Number of bytes of entries' data read from the PKG archive. */
+    uint64_t archive_bytes_read;
+
+    /* Number of bytes produced by decompression of entries' data. */
+    uint64_t bytes_inflated;
+
+    /* Number of files (including symbolic links) and directories
+     * created in the application's top-level directory. */
+    uint64_t files_created;
+    uint64_t directories_created;
+
+    /* Number of TOC entries processed during the extraction. */
+    uint64_t toc_entries_processed;
+
+    /* Duration of individual startup phases, in microseconds. */
+    uint64_t phase_time[PYI_STATS_PHASE_COUNT];
+
+    /* Duration of the extraction performed by the onefile parent
+     * process, in microseconds; received by the child process. */
+    uint64_t parent_extraction_time;
+};
+
+void pyi_stats_add(uint64_t *counter, uint64_t value);
+
+uint64_t pyi_stats_phase_begin(void);
+void pyi_stats_phase_end(struct PYI_CONTEXT *pyi_ctx, enum PYI_STATS_PHASE phase, uint64_t start_time);
+
+int pyi_stats_export_to_child(const struct PYI_CONTEXT *pyi_ctx);
+void pyi_stats_import_from_parent(struct PYI_CONTEXT *pyi_ctx);
+
+int pyi_stats_publish(const struct PYI_CONTEXT *pyi_ctx);
+
+#endif /* PYI_STATS_H */
@@ -0,0 +1,232 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Minimal portable threading primitives. On Windows, these are thin
+ * wrappers around Win32 threads, critical sections, and condition
+ * variables; on POSIX systems, around pthreads.
+ */
+
+#if !defined(_WIN32)
+    #include <unistd.h> /* sysconf */
+    #include <signal.h> /* pthread_sigmask */
+#endif
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_thread.h"
+
+
+#if defined(_WIN32)
+
+int
+pyi_thread_create(pyi_thread_t *thread, pyi_thread_proc *proc, void *arg)
+{
+    *thread = CreateThread(NULL, 0, proc, arg, 0, NULL);
+    if (*thread == NULL) {
+        PYI_WINERROR_W(L"CreateThread", L"Failed to create thread!\n");
+        return -1;
+    }
+    return 0;
+}
+
+int
+pyi_thread_join(pyi_thread_t thread)
+{
+    if (WaitForSingleObject(thread, INFINITE) != WAIT_OBJECT_0) {
+        PYI_WINERROR_W(L"WaitForSingleObject", L"Failed to join thread!\n");
+        CloseHandle(thread);
+        return -1;
+    }
+    CloseHandle(thread);
+    return 0;
+}
+
+int
+pyi_mutex_init(pyi_mutex_t *mutex)
+{
+    InitializeCriticalSection(mutex);
+    return 0;
+}
+
+void
+pyi_mutex_destroy(pyi_mutex_t *mutex)
+{
+    DeleteCriticalSection(mutex);
+}
+
+void
+pyi_mutex_lock(pyi_mutex_t *mutex)
+{
+    EnterCriticalSection(mutex);
+}
+
+void
+pyi_mutex_unlock(pyi_mutex_t *mutex)
+{
+    LeaveCriticalSection(mutex);
+}
+
+int
+pyi_cond_init(pyi_cond_t *cond)
+{
+    InitializeConditionVariable(cond);
+    return 0;
+}
+
+void
+pyi_cond_destroy(pyi_cond_t *cond)
+{
+    /* Win32 condition variables need no explicit clean-up */
+    (void)cond;
+}
+
+void
+pyi_cond_wait(pyi_cond_t *cond, pyi_mutex_t *mutex)
+{
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+}
+
+void
+pyi_cond_signal(pyi_cond_t *cond)
+{
+    WakeConditionVariable(cond);
+}
+
+void
+pyi_cond_broadcast(pyi_cond_t *cond)
+{
+    WakeAllConditionVariable(cond);
+}
+
+int
+pyi_thread_get_cpu_count(void)
+{
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    return system_info.dwNumberOfProcessors > 0 ? (int)system_info.dwNumberOfProcessors : 1;
+}
+
+#else /* defined(_WIN32) */
+
+#if defined(HAVE_PTHREAD_H)
+
+int
+pyi_thread_create(pyi_thread_t *thread, pyi_thread_proc *proc, void *arg)
+{
+    sigset_t blocked_signals;
+    sigset_t original_signal_mask;
+    int rc;
+
+    /* Create the thread with asynchronous signals blocked, so that the
+     * signals that are directed at the process are always handled by
+     * the main thread (for example, forwarded to the child process of
+     * onefile program). The new thread inherits the signal mask of the
+     * calling thread. */
+    sigfillset(&blocked_signals);
+    sigdelset(&blocked_signals, SIGSEGV);
+    sigdelset(&blocked_signals, SIGBUS);
+    sigdelset(&blocked_signals, SIGFPE);
+    sigdelset(&blocked_signals, SIGILL);
+    pthread_sigmask(SIG_BLOCK, &blocked_signals, &original_signal_mask);
+
+    rc = pthread_create(thread, NULL, proc, arg);
+
+    pthread_sigmask(SIG_SETMASK, &original_signal_mask, NULL);
+
+    if (rc != 0) {
+        PYI_ERROR("Failed to create thread: pthread_create() returned %d!\n", rc);
+        return -1;
+    }
+    return 0;
+}
+
+int
+pyi_thread_join(pyi_thread_t thread)
+{
+    int rc = pthread_join(thread, NULL);
+    if (rc != 0) {
+        PYI_ERROR("Failed to join thread: pthread_join() returned %d!\n", rc);
+        return -1;
+    }
+    return 0;
+}
+
+int
+pyi_mutex_init(pyi_mutex_t *mutex)
+{
+    return pthread_mutex_init(mutex, NULL) == 0 ? 0 : -1;
+}
+
+void
+pyi_mutex_destroy(pyi_mutex_t *mutex)
+{
+    pthread_mutex_destroy(mutex);
+}
+
+void
+pyi_mutex_lock(pyi_mutex_t *mutex)
+{
+    pthread_mutex_lock(mutex);
+}
+
+void
+pyi_mutex_unlock(pyi_mutex_t *mutex)
+{
+    pthread_mutex_unlock(mutex);
+}
+
+int
+pyi_cond_init(pyi_cond_t *cond)
+{
+    return pthread_cond_init(cond, NULL) == 0 ? 0 : -1;
+}
+
+void
+pyi_cond_destroy(pyi_cond_t *cond)
+{
+    pthread_cond_destroy(cond);
+}
+
+void
+pyi_cond_wait(pyi_cond_t *cond, pyi_mutex_t *mutex)
+{
+    pthread_cond_wait(cond, mutex);
+}
+
+void
+pyi_cond_signal(pyi_cond_t *cond)
+{
+    pthread_cond_signal(cond);
+}
+
+void
+pyi_cond_broadcast(pyi_cond_t *cond)
+{
+    pthread_cond_broadcast(cond);
+}
+
+#endif /* defined(HAVE_PTHREAD_H) */
+
+int
+pyi_thread_get_cpu_count(void)
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#else
+    return 1;
+#endif
+}
+
+#endif /* defined(_WIN32) */
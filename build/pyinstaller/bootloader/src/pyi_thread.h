@@ -0,0 +1,88 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Minimal portable threading primitives (threads, mutexes, and
+ * condition variables) used by the bootloader for parallel work.
+ */
+
+#ifndef PYI_THREAD_H
+#define PYI_THREAD_H
+
+#include "pyi_global.h"
+
+#if defined(_WIN32)
+    #include <windows.h>
+#elif defined(HAVE_PTHREAD_H)
+    #include <pthread.h>
+#endif
+
+/* PYI_HAVE_THREADS is defined to 1 if threading primitives are
+ * available on this platform; otherwise, callers need to fall back
+ * to serial code paths. */
+#if defined(_WIN32)
+
+    #define PYI_HAVE_THREADS 1
+
+typedef HANDLE pyi_thread_t;
+typedef CRITICAL_SECTION pyi_mutex_t;
+typedef CONDITION_VARIABLE pyi_cond_t;
+
+/* Thread procedure signature and return statement */
+    #define PYI_THREAD_PROC_TYPE DWORD WINAPI
+    #define PYI_THREAD_PROC_RETURN return 0
+typedef DWORD (WINAPI pyi_thread_proc)(void *);
+
+#elif defined(HAVE_PTHREAD_H)
+
+    #define PYI_HAVE_THREADS 1
+
+typedef pthread_t pyi_thread_t;
+typedef pthread_mutex_t pyi_mutex_t;
+typedef pthread_cond_t pyi_cond_t;
+
+/* Thread procedure signature and return statement */
+    #define PYI_THREAD_PROC_TYPE void *
+    #define PYI_THREAD_PROC_RETURN return NULL
+typedef void *(pyi_thread_proc)(void *);
+
+#else
+
+    #define PYI_HAVE_THREADS 0
+
+#endif
+
+
+#if PYI_HAVE_THREADS
+
+int pyi_thread_create(pyi_thread_t *thread, pyi_thread_proc *proc, void *arg);
+int pyi_thread_join(pyi_thread_t thread);
+
+int pyi_mutex_init(pyi_mutex_t *mutex);
+void pyi_mutex_destroy(pyi_mutex_t *mutex);
+void pyi_mutex_lock(pyi_mutex_t *mutex);
+void pyi_mutex_unlock(pyi_mutex_t *mutex);
+
+int pyi_cond_init(pyi_cond_t *cond);
+void pyi_cond_destroy(pyi_cond_t *cond);
+void pyi_cond_wait(pyi_cond_t *cond, pyi_mutex_t *mutex);
+void pyi_cond_signal(pyi_cond_t *cond);
+void pyi_cond_broadcast(pyi_cond_t *cond);
+
+#endif /* PYI_HAVE_THREADS */
+
+/* Number of online processors; always at least 1. Available even if
+ * threading primitives are not. */
+int pyi_thread_get_cpu_count(void);
+
+#endif /* PYI_THREAD_H */
@@ -0,0 +1,340 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Startup phase tracing.
+ *
+ * The events are recorded into an in-memory buffer, and written to the
+ * trace file when the process exits (or before it restarts itself).
+ * The file uses the JSON Array Format of the Trace Event Format, in
+ * which the closing bracket is optional; this allows all processes of
+ * the application (onefile parent and child, restarted processes, and
+ * spawned subprocesses) to simply append their events to the same file.
+ * The timestamps are based on a system-wide monotonic clock, so that
+ * the events from different processes line up on the same timeline.
+ */
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>  /* clock_gettime */
+    #include <sys/time.h>  /* gettimeofday */
+    #include <unistd.h>  /* getpid */
+#endif
+#include <stdio.h>
+#include <stdlib.h>  /* malloc, realloc, atexit */
+#include <string.h>  /* strdup */
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_path.h"
+#include "pyi_utils.h"
+#include "pyi_thread.h"
+#include "pyi_trace.h"
+
+
+/* Recorded trace event */
+struct _PYI_TRACE_EVENT
+{
+    uint64_t timestamp; /* microseconds */
+    unsigned long thread_id;
+    const char *name; /* static string */
+    char *detail; /* optional; dynamically allocated */
+    char phase; /* 'B' (begin) or 'E' (end) */
+};
+
+/* Tracing state */
+static bool _pyi_trace_enabled = false;
+static char *_pyi_trace_filename = NULL;
+static const char *_pyi_trace_process_name = NULL;
+
+static struct _PYI_TRACE_EVENT *_pyi_trace_events = NULL;
+static size_t _pyi_trace_num_events = 0;
+static size_t _pyi_trace_capacity = 0;
+
+static unsigned long _pyi_trace_process_id = 0;
+static unsigned long _pyi_trace_main_thread_id = 0;
+
+#if defined(_WIN32)
+static LARGE_INTEGER _pyi_trace_frequency;
+#endif
+
+#if PYI_HAVE_THREADS
+static pyi_mutex_t _pyi_trace_mutex;
+#endif
+
+
+/*
+ * Return the timestamp, in microseconds, from the system-wide
+ * monotonic clock. Also used by the run-time statistics, so it works
+ * regardless of whether tracing is enabled or not.
+ */
+uint64_t
+pyi_trace_get_timestamp(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER counter;
+    if (_pyi_trace_frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&_pyi_trace_frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / _pyi_trace_frequency.QuadPart) * 1000000 +
+        (uint64_t)(counter.QuadPart % _pyi_trace_frequency.QuadPart) * 1000000 / _pyi_trace_frequency.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+#endif
+}
+
+/*
+ * Return the identifier of the calling thread. The main thread is
+ * reported under the process ID, as is customary in trace viewers.
+ */
+static unsigned long
+_pyi_trace_get_thread_id(void)
+{
+    unsigned long thread_id;
+
+#if defined(_WIN32)
+    thread_id = (unsigned long)GetCurrentThreadId();
+#elif defined(HAVE_PTHREAD_H)
+    thread_id = (unsigned long)(uintptr_t)pthread_self();
+#else
+    thread_id = 0;
+#endif
+
+    if (thread_id == _pyi_trace_main_thread_id) {
+        return _pyi_trace_process_id;
+    }
+    return thread_id;
+}
+
+/*
+ * Enable tracing if PYINSTALLER_STARTUP_TRACE environment variable is
+ * set. The top-level process of the application (i.e., the one that
+ * was not started by the bootloader itself) creates a new trace file;
+ * other processes append their events to it.
+ */
+void
+pyi_trace_init(void)
+{
+    char *env_var_value;
+
+    _pyi_trace_filename = pyi_getenv("PYINSTALLER_STARTUP_TRACE"); /* strdup'd copy or NULL */
+    if (_pyi_trace_filename == NULL) {
+        return;
+    }
+    if (_pyi_trace_filename[0] == 0) {
+        free(_pyi_trace_filename);
+        _pyi_trace_filename = NULL;
+        return;
+    }
+
+    env_var_value = pyi_getenv("_PYI_PARENT_PROCESS_LEVEL");
+    if (env_var_value == NULL) {
+        FILE *fp = pyi_path_fopen(_pyi_trace_filename, "wb");
+        if (fp == NULL) {
+            PYI_WARNING("Failed to create startup trace file %s!\n", _pyi_trace_filename);
+            free(_pyi_trace_filename);
+            _pyi_trace_filename = NULL;
+            return;
+        }
+        fputs("[\n", fp);
+        fclose(fp);
+    }
+    free(env_var_value);
+
+#if PYI_HAVE_THREADS
+    if (pyi_mutex_init(&_pyi_trace_mutex) < 0) {
+        free(_pyi_trace_filename);
+        _pyi_trace_filename = NULL;
+        return;
+    }
+#endif
+
+#if defined(_WIN32)
+    _pyi_trace_process_id = (unsigned long)GetCurrentProcessId();
+#else
+    _pyi_trace_process_id = (unsigned long)getpid();
+#endif
+    _pyi_trace_main_thread_id = 0;
+    _pyi_trace_main_thread_id = _pyi_trace_get_thread_id();
+
+    _pyi_trace_enabled = true;
+
+    /* Write the events when process exits; this also covers the case
+     * when python interpreter calls exit() due to SystemExit. */
+    atexit(pyi_trace_flush);
+}
+
+/*
+ * Record an event into the buffer. If the buffer cannot be grown, the
+ * event is dropped.
+ */
+static void
+_pyi_trace_record(char phase, const char *name, const char *detail)
+{
+    struct _PYI_TRACE_EVENT *event;
+    uint64_t timestamp = pyi_trace_get_timestamp();
+    unsigned long thread_id = _pyi_trace_get_thread_id();
+
+#if PYI_HAVE_THREADS
+    pyi_mutex_lock(&_pyi_trace_mutex);
+#endif
+
+    if (_pyi_trace_num_events == _pyi_trace_capacity) {
+        size_t new_capacity = _pyi_trace_capacity ? 2 * _pyi_trace_capacity : PYI_TRACE_INITIAL_CAPACITY;
+        struct _PYI_TRACE_EVENT *new_events = (struct _PYI_TRACE_EVENT *)realloc(_pyi_trace_events, new_capacity * sizeof(struct _PYI_TRACE_EVENT));
+        if (new_events == NULL) {
+            goto cleanup;
+        }
+        _pyi_trace_events = new_events;
+        _pyi_trace_capacity = new_capacity;
+    }
+
+    event = &_pyi_trace_events[_pyi_trace_num_events++];
+    event->timestamp = timestamp;
+    event->thread_id = thread_id;
+    event->name = name;
+    event->detail = detail ? strdup(detail) : NULL;
+    event->phase = phase;
+
+cleanup:
+#if PYI_HAVE_THREADS
+    pyi_mutex_unlock(&_pyi_trace_mutex);
+#endif
+    return;
+}
+
+/*
+ * Record the start of a phase. The optional detail string (for example,
+ * the name of archive entry that is being processed) is copied.
+ */
+void
+pyi_trace_begin(const char *name, const char *detail)
+{
+    if (!_pyi_trace_enabled) {
+        return;
+    }
+    _pyi_trace_record('B', name, detail);
+}
+
+/*
+ * Record the end of a phase; must be called from the same thread as
+ * the matching pyi_trace_begin().
+ */
+void
+pyi_trace_end(const char *name)
+{
+    if (!_pyi_trace_enabled) {
+        return;
+    }
+    _pyi_trace_record('E', name, NULL);
+}
+
+/*
+ * Set the name under which the process is shown in the trace viewer;
+ * the name must be a static string.
+ */
+void
+pyi_trace_set_process_name(const char *name)
+{
+    _pyi_trace_process_name = name;
+}
+
+/*
+ * Write a JSON string literal, escaping the characters as necessary.
+ */
+static void
+_pyi_trace_write_string(FILE *fp, const char *str)
+{
+    fputc('"', fp);
+    for (; *str; str++) {
+        unsigned char c = (unsigned char)*str;
+        if (c == '"' || c == '\\') {
+            fputc('\\', fp);
+            fputc(c, fp);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+/*
+ * Append the recorded events to the trace file, and clear the buffer.
+ * Called at exit, and before the process restarts itself or re-raises
+ * the signal received by its child.
+ */
+void
+pyi_trace_flush(void)
+{
+    FILE *fp;
+    size_t i;
+
+    if (!_pyi_trace_enabled) {
+        return;
+    }
+
+#if PYI_HAVE_THREADS
+    pyi_mutex_lock(&_pyi_trace_mutex);
+#endif
+
+    fp = pyi_path_fopen(_pyi_trace_filename, "ab");
+    if (fp != NULL) {
+        if (_pyi_trace_process_name) {
+            fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%lu,\"args\":{\"name\":", _pyi_trace_process_id, _pyi_trace_process_id);
+            _pyi_trace_write_string(fp, _pyi_trace_process_name);
+            fputs("}},\n", fp);
+        }
+
+        for (i = 0; i < _pyi_trace_num_events; i++) {
+            const struct _PYI_TRACE_EVENT *event = &_pyi_trace_events[i];
+
+            fputs("{\"name\":", fp);
+            _pyi_trace_write_string(fp, event->name);
+            fprintf(
+                fp,
+                ",\"cat\":\"bootloader\",\"ph\":\"%c\",\"ts\":%" PRIu64 ",\"pid\":%lu,\"tid\":%lu",
+                event->phase,
+                event->timestamp,
+                _pyi_trace_process_id,
+                event->thread_id
+            );
+            if (event->detail) {
+                fputs(",\"args\":{\"detail\":", fp);
+                _pyi_trace_write_string(fp, event->detail);
+                fputc('}', fp);
+            }
+            fputs("},\n", fp);
+        }
+
+        fclose(fp);
+    }
+
+    for (i = 0; i < _pyi_trace_num_events; i++) {
+        free(_pyi_trace_events[i].detail);
+    }
+    _pyi_trace_num_events = 0;
+
+#if PYI_HAVE_THREADS
+    pyi_mutex_unlock(&_pyi_trace_mutex);
+#endif
+}
@@ -0,0 +1,43 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Startup phase tracing. When PYINSTALLER_STARTUP_TRACE environment
+ * variable is set to a file path, the bootloader records the start and
+ * end of its startup phases, and writes them into the specified file
+ * in Trace Event Format (JSON array), which can be viewed in Perfetto
+ * UI or chrome://tracing.
+ *
+ * When tracing is not enabled, the recording functions return
+ * immediately, so the calls can be left in release builds.
+ */
+
+#ifndef PYI_TRACE_H
+#define PYI_TRACE_H
+
+#include "pyi_global.h"
+
+/* Initial capacity of the buffer of recorded events. */
+#define PYI_TRACE_INITIAL_CAPACITY 256
+
+void pyi_trace_init(void);
+
+void pyi_trace_begin(const char *name, const char *detail);
+void pyi_trace_end(const char *name);
+void pyi_trace_set_process_name(const char *name);
+
+void pyi_trace_flush(void);
+
+uint64_t pyi_trace_get_timestamp(void);
+
+#endif /* PYI_TRACE_H */
@@ -0,0 +1,369 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Deferred clean-up of temporary directories of onefile applications.
+ *
+ * When enabled, the onefile parent process does not remove the
+ * application's temporary directory after the child process exits;
+ * instead, it renames the directory into
+ *
+ *   <temporary directory root>/_MEI-trash-XXXXXX
+ *
+ * which is a single, fast operation, and exits right away. This way,
+ * neither the user nor the shell that launched the program need to wait
+ * for the recursive removal of the directory. If the directory cannot be
+ * renamed (for example, because some of its files are still locked on
+ * Windows), it is removed in the usual way.
+ *
+ * The trashed directories are swept by the next launch of a program with
+ * deferred clean-up enabled: while its parent process waits for the child
+ * process, a low-priority background thread removes the trashed
+ * directories that it finds in the same temporary directory root (and
+ * that are owned by the current user). The sweep is normally not waited
+ * for; if the program exits first, the remaining directories are removed
+ * by a subsequent launch. However, if a series of short-lived launches
+ * left PYI_TRASH_MAX_PENDING or more directories in the trash, the
+ * exiting parent process waits for the sweep to finish, so that the
+ * amount of trash stays bounded.
+ */
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <dirent.h>
+    #include <errno.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #if defined(__linux__)
+        #include <sys/resource.h> /* setpriority */
+        #include <sys/syscall.h> /* SYS_gettid */
+    #endif
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* PyInstaller headers. */
+#include "pyi_global.h"
+#include "pyi_main.h"
+#include "pyi_path.h"
+#include "pyi_thread.h"
+#include "pyi_trash.h"
+#include "pyi_utils.h"
+
+
+/* State of the background sweep. */
+struct PYI_TRASH_SWEEP
+{
+    /* Root directory of temporary directories. */
+    char root_dir[PYI_PATH_MAX];
+
+    /* Set when the parent process is about to exit; the sweep stops
+     * after the directory that it is currently removing. */
+    volatile bool cancelled;
+
+#if PYI_HAVE_THREADS
+    pyi_thread_t thread;
+
+    /* Protects the `finished` flag. */
+    pyi_mutex_t mutex;
+    bool finished;
+#endif
+};
+
+
+/**********************************************************************\
+ *                     Platform-specific helpers                      *
+\**********************************************************************/
+#ifdef _WIN32
+
+static int
+_pyi_trash_rename(const char *src, const char *dest)
+{
+    wchar_t src_w[PYI_PATH_MAX];
+    wchar_t dest_w[PYI_PATH_MAX];
+
+    if (pyi_win32_utf8_to_wcs(src, src_w, PYI_PATH_MAX) == NULL) {
+        return -1;
+    }
+    if (pyi_win32_utf8_to_wcs(dest, dest_w, PYI_PATH_MAX) == NULL) {
+        return -1;
+    }
+
+    return MoveFileExW(src_w, dest_w, 0) ? 0 : -1;
+}
+
+/* Lower the CPU and I/O priority of the calling thread. */
+static void
+_pyi_trash_lower_thread_priority(void)
+{
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+}
+
+/* Scan the root directory for trashed directories, and remove them
+ * if `remove` is set; returns the number of found directories. */
+static int
+_pyi_trash_scan_directories(struct PYI_TRASH_SWEEP *sweep, bool remove)
+{
+    wchar_t pattern_w[PYI_PATH_MAX];
+    char pattern[PYI_PATH_MAX];
+    WIN32_FIND_DATAW find_data;
+    HANDLE handle;
+    int count = 0;
+
+    if (snprintf(pattern, PYI_PATH_MAX, "%s\\%s*", sweep->root_dir, PYI_TRASH_PREFIX) >= PYI_PATH_MAX) {
+        return 0;
+    }
+    if (pyi_win32_utf8_to_wcs(pattern, pattern_w, PYI_PATH_MAX) == NULL) {
+        return 0;
+    }
+
+    handle = FindFirstFileW(pattern_w, &find_data);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    do {
+        char name[PYI_PATH_MAX];
+        char path[PYI_PATH_MAX];
+
+        /* Skip files and directory junctions/symbolic links. */
+        if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || (find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+            continue;
+        }
+        if (pyi_win32_wcs_to_utf8(find_data.cFileName, name, PYI_PATH_MAX) == NULL) {
+            continue;
+        }
+        if (pyi_path_join(path, sweep->root_dir, name) == NULL) {
+            continue;
+        }
+
+        count++;
+        if (remove) {
+            PYI_DEBUG("LOADER: trash: removing %s\n", path);
+            pyi_recursive_rmdir(path);
+        }
+    } while (!(remove && sweep->cancelled) && FindNextFileW(handle, &find_data));
+
+    FindClose(handle);
+    return count;
+}
+
+#else /* ifdef _WIN32 */
+
+static int
+_pyi_trash_rename(const char *src, const char *dest)
+{
+    return rename(src, dest);
+}
+
+/* Lower the CPU priority of the calling thread; on Linux, setpriority()
+ * applies to individual threads. */
+static void
+_pyi_trash_lower_thread_priority(void)
+{
+#if defined(__linux__) && defined(SYS_gettid)
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+#endif
+}
+
+/* Scan the root directory for trashed directories, and remove them
+ * if `remove` is set; returns the number of found directories. */
+static int
+_pyi_trash_scan_directories(struct PYI_TRASH_SWEEP *sweep, bool remove)
+{
+    DIR *dir;
+    struct dirent *entry;
+    uid_t uid = geteuid();
+    int count = 0;
+
+    dir = opendir(sweep->root_dir);
+    if (dir == NULL) {
+        return 0;
+    }
+
+    while (!(remove && sweep->cancelled) && (entry = readdir(dir)) != NULL) {
+        char path[PYI_PATH_MAX];
+        struct stat stat_buf;
+
+        if (strncmp(entry->d_name, PYI_TRASH_PREFIX, strlen(PYI_TRASH_PREFIX)) != 0) {
+            continue;
+        }
+        if (pyi_path_join(path, sweep->root_dir, entry->d_name) == NULL) {
+            continue;
+        }
+
+        /* The temporary directory root might be shared by all users (e.g.,
+         * /tmp); consider only real directories owned by the current user. */
+        if (lstat(path, &stat_buf) < 0 || !S_ISDIR(stat_buf.st_mode) || stat_buf.st_uid != uid) {
+            continue;
+        }
+
+        count++;
+        if (remove) {
+            PYI_DEBUG("LOADER: trash: removing %s\n", path);
+            pyi_recursive_rmdir(path);
+        }
+    }
+
+    closedir(dir);
+    return count;
+}
+
+#endif /* ifdef _WIN32 */
+
+
+/**********************************************************************\
+ *                          Public interface                          *
+\**********************************************************************/
+/*
+ * Move the application's temporary directory (_MEIXXXXXX) into the trash,
+ * i.e., rename it into _MEI-trash-XXXXXX in the same root directory.
+ *
+ * Returns 0 on success, -1 on error; in the latter case, the caller
+ * should remove the temporary directory.
+ */
+int
+pyi_trash_move_application_directory(const struct PYI_CONTEXT *pyi_ctx)
+{
+    char root_dir[PYI_PATH_MAX];
+    char trash_name[PYI_PATH_MAX];
+    char trash_dir[PYI_PATH_MAX];
+    const char *name;
+
+    name = strrchr(pyi_ctx->application_home_dir, PYI_SEP);
+    if (name == NULL || strncmp(name + 1, "_MEI", 4) != 0) {
+        return -1;
+    }
+    name += 5; /* Skip separator and _MEI */
+
+    if (!pyi_path_dirname(root_dir, pyi_ctx->application_home_dir)) {
+        return -1;
+    }
+    if (snprintf(trash_name, PYI_PATH_MAX, "%s%s", PYI_TRASH_PREFIX, name) >= PYI_PATH_MAX) {
+        return -1;
+    }
+    if (pyi_path_join(trash_dir, root_dir, trash_name) == NULL) {
+        return -1;
+    }
+
+    if (_pyi_trash_rename(pyi_ctx->application_home_dir, trash_dir) < 0) {
+        PYI_DEBUG("LOADER: trash: failed to rename %s to %s!\n", pyi_ctx->application_home_dir, trash_dir);
+        return -1;
+    }
+
+    PYI_DEBUG("LOADER: trash: moved temporary directory to %s\n", trash_dir);
+    return 0;
+}
+
+#if PYI_HAVE_THREADS
+
+static PYI_THREAD_PROC_TYPE
+_pyi_trash_sweep_worker(void *arg)
+{
+    struct PYI_TRASH_SWEEP *sweep = (struct PYI_TRASH_SWEEP *)arg;
+
+    _pyi_trash_lower_thread_priority();
+    _pyi_trash_scan_directories(sweep, true);
+
+    pyi_mutex_lock(&sweep->mutex);
+    sweep->finished = true;
+    pyi_mutex_unlock(&sweep->mutex);
+
+    PYI_THREAD_PROC_RETURN;
+}
+
+#endif /* PYI_HAVE_THREADS */
+
+/*
+ * Start removing the previously trashed temporary directories from the
+ * root directory of the application's temporary directory. Failure to
+ * start the sweep is not an error. If threads are not available, the
+ * sweep is performed synchronously.
+ */
+void
+pyi_trash_start_sweep(struct PYI_CONTEXT *pyi_ctx)
+{
+    struct PYI_TRASH_SWEEP *sweep;
+
+    sweep = (struct PYI_TRASH_SWEEP *)calloc(1, sizeof(struct PYI_TRASH_SWEEP));
+    if (sweep == NULL) {
+        return;
+    }
+    if (!pyi_path_dirname(sweep->root_dir, pyi_ctx->application_home_dir)) {
+        free(sweep);
+        return;
+    }
+
+#if PYI_HAVE_THREADS
+    if (pyi_mutex_init(&sweep->mutex) < 0) {
+        free(sweep);
+        return;
+    }
+    if (pyi_thread_create(&sweep->thread, _pyi_trash_sweep_worker, sweep) < 0) {
+        pyi_mutex_destroy(&sweep->mutex);
+        free(sweep);
+        return;
+    }
+    PYI_DEBUG("LOADER: trash: started background sweep of %s\n", sweep->root_dir);
+    pyi_ctx->trash_sweep_state = sweep;
+#else
+    _pyi_trash_scan_directories(sweep, true);
+    free(sweep);
+#endif
+}
+
+/*
+ * Stop the background sweep. If the sweep is still running, it is
+ * cancelled but not waited for; the thread (and its state structure)
+ * are left to the process exit. However, if PYI_TRASH_MAX_PENDING or
+ * more trashed directories are still left, the sweep is waited for
+ * instead, so that the trash does not keep growing when the program is
+ * launched repeatedly for short periods of time.
+ */
+void
+pyi_trash_stop_sweep(struct PYI_CONTEXT *pyi_ctx)
+{
+#if PYI_HAVE_THREADS
+    struct PYI_TRASH_SWEEP *sweep = pyi_ctx->trash_sweep_state;
+    bool finished;
+    int num_pending;
+
+    if (sweep == NULL) {
+        return;
+    }
+    pyi_ctx->trash_sweep_state = NULL;
+
+    pyi_mutex_lock(&sweep->mutex);
+    finished = sweep->finished;
+    pyi_mutex_unlock(&sweep->mutex);
+
+    if (!finished) {
+        num_pending = _pyi_trash_scan_directories(sweep, false);
+        if (num_pending < PYI_TRASH_MAX_PENDING) {
+            sweep->cancelled = true;
+            PYI_DEBUG("LOADER: trash: background sweep still running (%d directories left); not waiting for it.\n", num_pending);
+            return;
+        }
+        PYI_DEBUG("LOADER: trash: background sweep still running (%d directories left); waiting for it.\n", num_pending);
+    }
+
+    pyi_thread_join(sweep->thread);
+    pyi_mutex_destroy(&sweep->mutex);
+    free(sweep);
+#else
+    (void)pyi_ctx;
+#endif
+}
@@ -0,0 +1,39 @@
+/*
+ * ****************************************************************************
+ * Copyright (c) 2013-2023, PyInstaller Development Team.
+ *
+ * Distributed under the terms of the GNU General Public License (version 2
+ * or later) with exception for distributing the bootloader.
+ *
+ * The full license is in the file COPYING.txt, distributed with this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+ * ****************************************************************************
+ */
+
+/*
+ * Deferred clean-up of temporary directories of onefile applications.
+ */
+
+#ifndef PYI_TRASH_H
+#define PYI_TRASH_H
+
+#include "pyi_global.h"
+
+struct PYI_CONTEXT;
+
+/* Name prefix of the temporary directories that were moved aside for
+ * deferred removal; the rest of the name is the random suffix of the
+ * original _MEIXXXXXX directory. */
+#define PYI_TRASH_PREFIX "_MEI-trash-"
+
+/* Number of trashed directories at which the exiting parent process
+ * waits for the background sweep to finish instead of cancelling it. */
+#define PYI_TRASH_MAX_PENDING 4
+
+int pyi_trash_move_application_directory(const struct PYI_CONTEXT *pyi_ctx);
+
+void pyi_trash_start_sweep(struct PYI_CONTEXT *pyi_ctx);
+void pyi_trash_stop_sweep(struct PYI_CONTEXT *pyi_ctx);
+
+#endif /* PYI_TRASH_H */
@@ -16,16 +16,41 @@
  * to all platforms/OSes.
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE /* copy_file_range, memfd_create, F_ADD_SEALS */
+#endif
+
 #include <stdio.h>
 
+#include <stdlib.h>
+
 #ifdef _WIN32
     #include <windows.h>
+    #include <io.h> /* _get_osfhandle */
+    #include <psapi.h> /* GetProcessMemoryInfo */
 #else
-    #include <stdlib.h>
+    #include <errno.h>
     #include <unistd.h>
+    #include <sys/mman.h> /* mmap */
     #include <sys/stat.h>
 #endif
 
+#if defined(__linux__)
+    #include <fcntl.h>
+    #include <sys/ioctl.h>
+    #include <sys/mman.h> /* memfd_create */
+    #include <sys/sendfile.h>
+    #include <linux/fs.h> /* FICLONE */
+    #if defined(HAVE_MALLOC_TRIM)
+        #include <malloc.h> /* malloc_trim */
+    #endif
+#elif defined(__APPLE__)
+    #include <copyfile.h>
+    #include <sys/clonefile.h>
+    #include <malloc/malloc.h> /* malloc_zone_pressure_relief */
+    #include <mach/mach.h> /* task_info */
+#endif
+
 #include <string.h>
 
 /* PyInstaller headers. */
@@ -38,15 +63,162 @@
 /**********************************************************************\
  *                    Misc. file/directory helpers                    *
 \**********************************************************************/
+/*
+ * Cache of directories that were already created (or found to exist)
+ * during extraction of the application's contents; an open-addressing
+ * hash set of directory names, relative to the extraction prefix path.
+ * It allows pyi_create_parent_directory_tree() to skip the ancestor
+ * directories that were created for the preceding entries, so that
+ * in the common case, no file-system calls are made for them.
+ */
+struct PYI_DIRECTORY_CACHE
+{
+    char **names;
+    size_t capacity; /* Always a power of two */
+    size_t count;
+};
+
+#define _PYI_DIRECTORY_CACHE_INITIAL_CAPACITY 256
+
+static uint32_t
+_pyi_directory_cache_hash(const char *name, size_t length)
+{
+    /* FNV-1a */
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Find the slot for the given name; returns the slot index, which
+ * either contains the name, or is empty. */
+static size_t
+_pyi_directory_cache_find_slot(const struct PYI_DIRECTORY_CACHE *cache, const char *name, size_t length)
+{
+    size_t mask = cache->capacity - 1;
+    size_t index = _pyi_directory_cache_hash(name, length) & mask;
+
+    while (cache->names[index] != NULL) {
+        if (strncmp(cache->names[index], name, length) == 0 && cache->names[index][length] == 0) {
+            break;
+        }
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+struct PYI_DIRECTORY_CACHE *
+pyi_directory_cache_new(void)
+{
+    struct PYI_DIRECTORY_CACHE *cache;
+
+    cache = (struct PYI_DIRECTORY_CACHE *)calloc(1, sizeof(struct PYI_DIRECTORY_CACHE));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->capacity = _PYI_DIRECTORY_CACHE_INITIAL_CAPACITY;
+    cache->names = (char **)calloc(cache->capacity, sizeof(char *));
+    if (cache->names == NULL) {
+        free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+void
+pyi_directory_cache_free(struct PYI_DIRECTORY_CACHE **cache_ref)
+{
+    struct PYI_DIRECTORY_CACHE *cache = *cache_ref;
+    size_t index;
+
+    *cache_ref = NULL;
+
+    if (cache == NULL) {
+        return;
+    }
+
+    for (index = 0; index < cache->capacity; index++) {
+        free(cache->names[index]);
+    }
+    free(cache->names);
+    free(cache);
+}
+
+static bool
+_pyi_directory_cache_contains(const struct PYI_DIRECTORY_CACHE *cache, const char *name, size_t length)
+{
+    return cache->names[_pyi_directory_cache_find_slot(cache, name, length)] != NULL;
+}
+
+/* Add the name to the cache. Failures (to allocate memory) are silently
+ * ignored, as they only make the cache less effective. */
+static void
+_pyi_directory_cache_add(struct PYI_DIRECTORY_CACHE *cache, const char *name, size_t length)
+{
+    size_t index;
+    char *name_copy;
+
+    /* Grow the table when it becomes half-full */
+    if (2 * (cache->count + 1) > cache->capacity) {
+        size_t new_capacity = 2 * cache->capacity;
+        char **new_names;
+        size_t new_index;
+        size_t mask = new_capacity - 1;
+
+        new_names = (char **)calloc(new_capacity, sizeof(char *));
+        if (new_names == NULL) {
+            return;
+        }
+        for (index = 0; index < cache->capacity; index++) {
+            if (cache->names[index] == NULL) {
+                continue;
+            }
+            new_index = _pyi_directory_cache_hash(cache->names[index], strlen(cache->names[index])) & mask;
+            while (new_names[new_index] != NULL) {
+                new_index = (new_index + 1) & mask;
+            }
+            new_names[new_index] = cache->names[index];
+        }
+        free(cache->names);
+        cache->names = new_names;
+        cache->capacity = new_capacity;
+    }
+
+    index = _pyi_directory_cache_find_slot(cache, name, length);
+    if (cache->names[index] != NULL) {
+        return; /* Already present */
+    }
+
+    name_copy = (char *)malloc(length + 1);
+    if (name_copy == NULL) {
+        return;
+    }
+    memcpy(name_copy, name, length);
+    name_copy[length] = 0;
+
+    cache->names[index] = name_copy;
+    cache->count++;
+}
+
 /*
  * Helper that creates parent directory tree for the given filename,
  * rooted under the given prefix path. The prefix path is assumed to
  * already exist.
  *
+ * If directory cache is given, it is used to skip the directories that
+ * were already created for the preceding files; it must be used only
+ * with the same prefix path.
+ *
  * Returns 0 on success, -1 on failure.
  */
 int
-pyi_create_parent_directory_tree(const struct PYI_CONTEXT *pyi_ctx, const char *prefix_path, const char *filename)
+pyi_create_parent_directory_tree(const struct PYI_CONTEXT *pyi_ctx, struct PYI_DIRECTORY_CACHE *cache, const char *prefix_path, const char *filename)
 {
     char path[PYI_PATH_MAX];
     char *subpath_cursor;
@@ -57,6 +229,16 @@ pyi_create_parent_directory_tree(const struct PYI_CONTEXT *pyi_ctx, const char *
         return -1;
     }
 
+    /* Fast path: the parent directory itself was already created,
+     * and so were all its ancestors. */
+    subpath_cursor = strrchr(filename, PYI_SEP);
+    if (subpath_cursor == NULL) {
+        return 0; /* File in top-level directory */
+    }
+    if (cache && _pyi_directory_cache_contains(cache, filename, subpath_cursor - filename)) {
+        return 0;
+    }
+
     /* Write prefix path, append separator, and store length; so we
      * can keep appending sub-paths at the end */
     path_length = snprintf(path, PYI_PATH_MAX, "%s%c", prefix_path, PYI_SEP);
@@ -65,23 +247,36 @@ pyi_create_parent_directory_tree(const struct PYI_CONTEXT *pyi_ctx, const char *
     for (subpath_cursor = strchr(filename, PYI_SEP); subpath_cursor != NULL; subpath_cursor = strchr(++subpath_cursor, PYI_SEP)) {
         int subpath_length = (int)(subpath_cursor - filename);
 
+        if (cache && _pyi_directory_cache_contains(cache, filename, subpath_length)) {
+            continue;
+        }
+
         snprintf(path + path_length, PYI_PATH_MAX - path_length, "%.*s", subpath_length, filename);
 
-        /* Create path if necessary */
-        if (pyi_path_exists(path) == 0) {
+        /* Create the directory; instead of checking for its existence
+         * first, treat the "already exists" error as success. */
 #ifdef _WIN32
+        {
             wchar_t path_w[PYI_PATH_MAX];
             pyi_win32_utf8_to_wcs(path, path_w, PYI_PATH_MAX);
 
             /* CreateDirectoryW returns 0 on failure. */
-            if (CreateDirectoryW(path_w, pyi_ctx->security_attr) == 0) {
+            if (CreateDirectoryW(path_w, pyi_ctx->security_attr) != 0) {
+                pyi_stats_add(&global_pyi_ctx->stats.directories_created, 1);
+            } else if (GetLastError() != ERROR_ALREADY_EXISTS) {
                 return -1;
             }
+        }
 #else
-            if (mkdir(path, 0700) < 0) {
-                return -1;
-            }
+        if (mkdir(path, 0700) == 0) {
+            pyi_stats_add(&global_pyi_ctx->stats.directories_created, 1);
+        } else if (errno != EEXIST) {
+            return -1;
+        }
 #endif
+
+        if (cache) {
+            _pyi_directory_cache_add(cache, filename, subpath_length);
         }
     }
 
@@ -89,8 +284,232 @@ pyi_create_parent_directory_tree(const struct PYI_CONTEXT *pyi_ctx, const char *
 }
 
 /*
- * Copy the source file to destination, in chunkc of 4 kB. The parent
- * directory tree of the destination must file must already exist
+ * Copy `length` bytes from the file descriptor `in_fd`, starting at
+ * `in_offset`, to the current position of file descriptor `out_fd`,
+ * without passing the data through user space (Linux only).
+ *
+ * Returns 0 on success, 1 if the kernel-side copy is not supported for
+ * the given pair of files (in which case nothing was copied, and the
+ * caller should fall back to copying the data itself), and -1 on error.
+ */
+int
+pyi_utils_copy_file_range(int in_fd, uint64_t in_offset, int out_fd, uint64_t length)
+{
+#if defined(__linux__)
+    /* Maximum number of bytes requested in a single call; the kernel
+     * might copy fewer */
+    const size_t MAX_CHUNK_SIZE = 0x40000000; /* 1 GiB */
+    off_t offset = (off_t)in_offset;
+    uint64_t remaining_size = length;
+    ssize_t rc;
+    #if defined(HAVE_COPY_FILE_RANGE)
+    bool use_copy_file_range = true;
+    #endif
+
+    while (remaining_size > 0) {
+        size_t chunk_size = (MAX_CHUNK_SIZE < remaining_size) ? MAX_CHUNK_SIZE : (size_t)remaining_size;
+
+    #if defined(HAVE_COPY_FILE_RANGE)
+        /* copy_file_range() performs in-kernel copy, or reflinks the
+         * data on filesystems that support it. It is not available on
+         * older kernels or across filesystems on kernels before 5.3. */
+        if (use_copy_file_range) {
+            rc = copy_file_range(in_fd, &offset, out_fd, NULL, chunk_size, 0);
+            if (rc < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP || errno == EPERM)) {
+                use_copy_file_range = false;
+                continue; /* Retry with sendfile() */
+            }
+        } else
+    #endif
+        {
+            rc = sendfile(out_fd, in_fd, &offset, chunk_size);
+            if (rc < 0 && remaining_size == length && (errno == ENOSYS || errno == EINVAL)) {
+                return 1; /* Nothing copied yet; fall back */
+            }
+        }
+
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (rc == 0) {
+            errno = EIO; /* Unexpected end of input file */
+            return -1;
+        }
+        remaining_size -= (uint64_t)rc;
+    }
+
+    return 0;
+#else
+    (void)in_fd;
+    (void)in_offset;
+    (void)out_fd;
+    (void)length;
+    return 1;
+#endif
+}
+
+/*
+ * Create an anonymous, memory-backed file (Linux only), into which a
+ * binary can be extracted and then loaded via its /proc/self/fd/N path.
+ * The file descriptor is deliberately left inheritable, so that the
+ * path remains valid (with the same descriptor number) in the child
+ * process of onefile application.
+ *
+ * Returns the file descriptor, or -1 if memory-backed files are not
+ * available.
+ */
+int
+pyi_utils_create_memfd(const char *name)
+{
+#if defined(__linux__) && defined(HAVE_MEMFD_CREATE)
+    unsigned int flags = MFD_ALLOW_SEALING;
+    int fd;
+
+    #if defined(MFD_EXEC)
+    /* On kernels that support it (6.3 and later), explicitly request an
+     * executable memfd; with `vm.memfd_noexec` sysctl set to 1, memfds
+     * are otherwise created as non-executable. */
+    fd = memfd_create(name, flags | MFD_EXEC);
+    if (fd >= 0 || errno != EINVAL) {
+        return fd;
+    }
+    #endif
+
+    fd = memfd_create(name, flags);
+    return fd;
+#else
+    (void)name;
+    return -1;
+#endif
+}
+
+/*
+ * Seal the memory-backed file created by pyi_utils_create_memfd(), so
+ * that its contents cannot be modified anymore. Failure to seal the
+ * file is not an error.
+ */
+void
+pyi_utils_seal_memfd(int fd)
+{
+#if defined(__linux__) && defined(F_ADD_SEALS)
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#else
+    (void)fd;
+#endif
+}
+
+/*
+ * Return the memory that was freed by the process back to the operating
+ * system, to the extent that the C runtime's allocator allows it: the
+ * glibc heap is trimmed with malloc_trim(), macOS malloc zones are asked
+ * to relieve memory pressure, and on Windows, the process heap is
+ * compacted and the working set is trimmed. Used by onefile parent
+ * process before it starts waiting for the child process.
+ */
+void
+pyi_utils_trim_memory(void)
+{
+#if defined(_WIN32)
+    HeapCompact(GetProcessHeap(), 0);
+    SetProcessWorkingSetSize(GetCurrentProcess(), (SIZE_T)-1, (SIZE_T)-1);
+#elif defined(__linux__) && defined(HAVE_MALLOC_TRIM)
+    malloc_trim(0);
+#elif defined(__APPLE__)
+    malloc_zone_pressure_relief(NULL, 0);
+#endif
+}
+
+/*
+ * Return the resident set size (working set size on Windows) of the
+ * process in bytes, or 0 if it cannot be determined. Used for debug
+ * output.
+ */
+uint64_t
+pyi_utils_get_resident_memory(void)
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return (uint64_t)counters.WorkingSetSize;
+    }
+    return 0;
+#elif defined(__linux__)
+    unsigned long long total_pages = 0;
+    unsigned long long resident_pages = 0;
+    FILE *fp;
+
+    fp = fopen("/proc/self/statm", "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    if (fscanf(fp, "%llu %llu", &total_pages, &resident_pages) != 2) {
+        resident_pages = 0;
+    }
+    fclose(fp);
+
+    return (uint64_t)resident_pages * (uint64_t)sysconf(_SC_PAGESIZE);
+#elif defined(__APPLE__)
+    struct mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS) {
+        return (uint64_t)info.resident_size;
+    }
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Helper for pyi_copy_file that copies the whole source file into the
+ * (empty) destination file using platform-specific fast path: cloning
+ * (reflink) or kernel-side copy on Linux, and fcopyfile() on macOS.
+ *
+ * Returns 0 on success, 1 if fast path is not available (the caller
+ * should fall back to copying the data itself), and -1 on error.
+ */
+static int
+_pyi_copy_file_fast(FILE *fp_in, FILE *fp_out)
+{
+#if defined(__linux__)
+    struct stat stat_buf;
+
+    if (fstat(fileno(fp_in), &stat_buf) < 0 || !S_ISREG(stat_buf.st_mode)) {
+        return 1;
+    }
+
+    #if defined(FICLONE)
+    /* Share the data blocks on copy-on-write filesystems (btrfs, XFS,
+     * ...); fails with EOPNOTSUPP or EXDEV elsewhere. */
+    if (ioctl(fileno(fp_out), FICLONE, fileno(fp_in)) == 0) {
+        return 0;
+    }
+    #endif
+
+    return pyi_utils_copy_file_range(fileno(fp_in), 0, fileno(fp_out), (uint64_t)stat_buf.st_size);
+#elif defined(__APPLE__)
+    /* Uses cloning on APFS, and kernel-side copy otherwise. */
+    if (fcopyfile(fileno(fp_in), fileno(fp_out), NULL, COPYFILE_DATA) == 0) {
+        return 0;
+    }
+    return 1;
+#else
+    (void)fp_in;
+    (void)fp_out;
+    return 1;
+#endif
+}
+
+/*
+ * Copy the source file to destination. The parent directory tree of
+ * the destination file must already exist.
+ *
+ * The platform-specific fast path (CopyFileExW on Windows; cloning or
+ * kernel-side copy on Linux and macOS) is tried first; if unavailable,
+ * the file is copied in chunks of 4 kB.
  */
 int
 pyi_copy_file(const char *src_filename, const char *dest_filename)
@@ -101,6 +520,29 @@ pyi_copy_file(const char *src_filename, const char *dest_filename)
     size_t byte_count = 0;
     int error = 0;
 
+#if defined(_WIN32)
+    if (1) {
+        wchar_t src_filename_w[PYI_PATH_MAX];
+        wchar_t dest_filename_w[PYI_PATH_MAX];
+
+        if (pyi_win32_utf8_to_wcs(src_filename, src_filename_w, PYI_PATH_MAX) != NULL &&
+            pyi_win32_utf8_to_wcs(dest_filename, dest_filename_w, PYI_PATH_MAX) != NULL &&
+            CopyFileExW(src_filename_w, dest_filename_w, NULL, NULL, NULL, 0)) {
+            return 0;
+        }
+    }
+#elif defined(__APPLE__)
+    /* Clone the file on APFS. This creates the destination file, and
+     * copies the permissions as well. */
+    if (clonefile(src_filename, dest_filename, CLONE_NOFOLLOW) == 0) {
+        struct stat stat_buf;
+        if (stat(dest_filename, &stat_buf) == 0) {
+            chmod(dest_filename, stat_buf.st_mode | S_IRUSR | S_IWUSR);
+        }
+        return 0;
+    }
+#endif
+
     fp_in = pyi_path_fopen(src_filename, "rb");
     if (fp_in == NULL) {
         return -1;
@@ -112,24 +554,29 @@ pyi_copy_file(const char *src_filename, const char *dest_filename)
         return -1;
     }
 
-    while (!feof(fp_in)) {
-        /* Read chunk */
-        byte_count = fread(buffer, 1, 4096, fp_in);
-        if (byte_count <= 0) {
-            /* No data left or error */
-            if (ferror(fp_in)) {
-                clearerr(fp_in);
-                error = -1;
+    error = _pyi_copy_file_fast(fp_in, fp_out);
+    if (error == 1) {
+        error = 0;
+
+        while (!feof(fp_in)) {
+            /* Read chunk */
+            byte_count = fread(buffer, 1, 4096, fp_in);
+            if (byte_count <= 0) {
+                /* No data left or error */
+                if (ferror(fp_in)) {
+                    clearerr(fp_in);
+                    error = -1;
+                }
+                break;
             }
-            break;
-        }
 
-        /* Write chunk */
-        byte_count = fwrite(buffer, 1, byte_count, fp_out);
-        if (byte_count <= 0 || ferror(fp_out)) {
-            clearerr(fp_out);
-            error = -1;
-            break;
+            /* Write chunk */
+            byte_count = fwrite(buffer, 1, byte_count, fp_out);
+            if (byte_count <= 0 || ferror(fp_out)) {
+                clearerr(fp_out);
+                error = -1;
+                break;
+            }
         }
     }
 
@@ -155,6 +602,107 @@ pyi_copy_file(const char *src_filename, const char *dest_filename)
     return error;
 }
 
+/*
+ * Helper for pyi_clone_file that creates the destination file as a
+ * copy-on-write clone (reflink) of the source file, and applies the
+ * same permission bits as pyi_copy_file.
+ *
+ * Returns 0 on success, and 1 if cloning is not supported (either by
+ * the platform or by the file system). In the latter case, the
+ * destination file does not exist.
+ */
+static int
+_pyi_reflink_file(const char *src_filename, const char *dest_filename)
+{
+#if defined(__linux__) && defined(FICLONE)
+    struct stat stat_buf;
+    int fd_in;
+    int fd_out;
+    int rc = 1;
+
+    fd_in = open(src_filename, O_RDONLY | O_CLOEXEC);
+    if (fd_in < 0) {
+        return 1;
+    }
+    if (fstat(fd_in, &stat_buf) < 0 || !S_ISREG(stat_buf.st_mode)) {
+        close(fd_in);
+        return 1;
+    }
+
+    fd_out = open(dest_filename, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, (stat_buf.st_mode | S_IRUSR | S_IWUSR) & 07777);
+    if (fd_out < 0) {
+        close(fd_in);
+        return 1;
+    }
+
+    /* Fails with EOPNOTSUPP or EXDEV on file systems without support
+     * for shared data blocks. */
+    if (ioctl(fd_out, FICLONE, fd_in) == 0) {
+        fchmod(fd_out, (stat_buf.st_mode | S_IRUSR | S_IWUSR) & 07777);
+        rc = 0;
+    }
+
+    close(fd_out);
+    close(fd_in);
+
+    if (rc != 0) {
+        unlink(dest_filename);
+    }
+    return rc;
+#elif defined(__APPLE__)
+    struct stat stat_buf;
+
+    if (clonefile(src_filename, dest_filename, CLONE_NOFOLLOW) != 0) {
+        return 1;
+    }
+    if (stat(dest_filename, &stat_buf) == 0) {
+        chmod(dest_filename, stat_buf.st_mode | S_IRUSR | S_IWUSR);
+    }
+    return 0;
+#else
+    (void)src_filename;
+    (void)dest_filename;
+    return 1;
+#endif
+}
+
+/*
+ * Create the destination file as a clone of the source file; used for
+ * files whose contents are identical. The file is cloned (reflinked) if
+ * the file system supports sharing of data blocks; otherwise, a hard
+ * link to the source file is created, and if that fails as well (for
+ * example, on file systems without hard links), the file is copied.
+ * The parent directory tree of the destination file must already exist.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+pyi_clone_file(const char *src_filename, const char *dest_filename)
+{
+    if (_pyi_reflink_file(src_filename, dest_filename) == 0) {
+        return 0;
+    }
+
+#if defined(_WIN32)
+    if (1) {
+        wchar_t src_filename_w[PYI_PATH_MAX];
+        wchar_t dest_filename_w[PYI_PATH_MAX];
+
+        if (pyi_win32_utf8_to_wcs(src_filename, src_filename_w, PYI_PATH_MAX) != NULL &&
+            pyi_win32_utf8_to_wcs(dest_filename, dest_filename_w, PYI_PATH_MAX) != NULL &&
+            CreateHardLinkW(dest_filename_w, src_filename_w, NULL)) {
+            return 0;
+        }
+    }
+#else
+    if (link(src_filename, dest_filename) == 0) {
+        return 0;
+    }
+#endif
+
+    return pyi_copy_file(src_filename, dest_filename);
+}
+
 
 /**********************************************************************\
  *                       Magic pattern scanning                       *
@@ -171,24 +719,221 @@ const unsigned char MAGIC_BASE[8] = {
     013, 012, 013, 016
 };
 
+/*
+ * Back-to-front search for a pattern within a memory buffer.
+ *
+ * The candidate positions are filtered by comparing the first and the
+ * last byte of the pattern against 16 (or 32) positions at once, using
+ * SIMD instructions that are part of the baseline instruction set of the
+ * target architecture (SSE2 on x86-64 (and on x86 if enabled), AVX2 if
+ * enabled at compile time, NEON on arm64); only the candidates that pass
+ * the filter are compared in full. Other architectures use the scalar
+ * version of the same filter.
+ */
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define PYI_SCAN_VECTOR_SIZE 32
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define PYI_SCAN_VECTOR_SIZE 16
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define PYI_SCAN_VECTOR_SIZE 16
+#endif
+
+#if defined(PYI_SCAN_VECTOR_SIZE)
+
+/* Compute the bit mask of positions in the block starting at `data`,
+ * at which the pattern's first and last byte match. On NEON, each
+ * position corresponds to four bits of the mask. */
+static inline uint64_t
+_pyi_utils_scan_block(const unsigned char *data, size_t last_offset, unsigned char first_byte, unsigned char last_byte)
+{
+#if defined(__AVX2__)
+    __m256i first = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)data), _mm256_set1_epi8((char)first_byte));
+    __m256i last = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + last_offset)), _mm256_set1_epi8((char)last_byte));
+    return (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(first, last));
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+    uint8x16_t first = vceqq_u8(vld1q_u8(data), vdupq_n_u8(first_byte));
+    uint8x16_t last = vceqq_u8(vld1q_u8(data + last_offset), vdupq_n_u8(last_byte));
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(vandq_u8(first, last)), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+#else
+    __m128i first = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)data), _mm_set1_epi8((char)first_byte));
+    __m128i last = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + last_offset)), _mm_set1_epi8((char)last_byte));
+    return (uint32_t)_mm_movemask_epi8(_mm_and_si128(first, last));
+#endif
+}
+
+/* Index of the highest set bit in a non-zero mask. */
+static inline int
+_pyi_utils_highest_bit(uint64_t mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    #if defined(_M_X64) || defined(_M_ARM64)
+        _BitScanReverse64(&index, mask);
+    #else
+        if (mask >> 32) {
+            _BitScanReverse(&index, (unsigned long)(mask >> 32));
+            return (int)index + 32;
+        }
+        _BitScanReverse(&index, (unsigned long)mask);
+    #endif
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(mask);
+#endif
+}
+
+#endif /* defined(PYI_SCAN_VECTOR_SIZE) */
+
+/*
+ * Find the last occurrence of the pattern within the buffer. Returns
+ * pointer to the match, or NULL if the pattern is not found.
+ */
+const unsigned char *
+pyi_utils_find_last_pattern(const unsigned char *data, size_t size, const unsigned char *pattern, size_t pattern_len)
+{
+    unsigned char first_byte;
+    unsigned char last_byte;
+    size_t num_positions;
+
+    if (pattern_len == 0 || size < pattern_len) {
+        return NULL;
+    }
+    first_byte = pattern[0];
+    last_byte = pattern[pattern_len - 1];
+
+    /* Number of candidate positions; the match starts at most at
+     * position num_positions - 1. */
+    num_positions = size - pattern_len + 1;
+
+#if defined(PYI_SCAN_VECTOR_SIZE)
+    /* Process the blocks of candidate positions from the end. The loads
+     * of the last bytes end at the last byte of the buffer. */
+    while (num_positions >= PYI_SCAN_VECTOR_SIZE) {
+        const unsigned char *block = data + num_positions - PYI_SCAN_VECTOR_SIZE;
+        uint64_t mask = _pyi_utils_scan_block(block, pattern_len - 1, first_byte, last_byte);
+
+        while (mask != 0) {
+            int bit = _pyi_utils_highest_bit(mask);
+    #if defined(__ARM_NEON) || defined(_M_ARM64)
+            int index = bit / 4;
+            mask &= ~((uint64_t)0xF << (index * 4));
+    #else
+            int index = bit;
+            mask &= ~((uint64_t)1 << index);
+    #endif
+            if (memcmp(block + index, pattern, pattern_len) == 0) {
+                return block + index;
+            }
+        }
+
+        num_positions -= PYI_SCAN_VECTOR_SIZE;
+    }
+#endif
+
+    /* Remaining positions (or all of them, in scalar version) */
+    while (num_positions > 0) {
+        const unsigned char *candidate = data + --num_positions;
+        if (candidate[0] == first_byte && candidate[pattern_len - 1] == last_byte && memcmp(candidate, pattern, pattern_len) == 0) {
+            return candidate;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Search the given memory-mapped file for the last occurrence of the
+ * pattern. Returns 0 if the search was performed (with the result
+ * stored in `offset`), and -1 if the file could not be mapped.
+ */
+static int
+_pyi_utils_find_magic_pattern_mapped(FILE *fp, const unsigned char *magic, size_t magic_len, uint64_t *offset)
+{
+    const unsigned char *data;
+    const unsigned char *match;
+    uint64_t file_size;
+#ifdef _WIN32
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+    LARGE_INTEGER size;
+
+    file_handle = (HANDLE)_get_osfhandle(_fileno(fp));
+    if (file_handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_handle, &size)) {
+        return -1;
+    }
+    file_size = (uint64_t)size.QuadPart;
+    if (file_size == 0 || file_size > (uint64_t)SIZE_MAX) {
+        return -1;
+    }
+
+    mapping_handle = CreateFileMappingW(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping_handle == NULL) {
+        return -1;
+    }
+    data = (const unsigned char *)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, (SIZE_T)file_size);
+    CloseHandle(mapping_handle);
+    if (data == NULL) {
+        return -1;
+    }
+#else
+    struct stat statbuf;
+    void *mapped;
+
+    if (fstat(fileno(fp), &statbuf) < 0) {
+        return -1;
+    }
+    file_size = (uint64_t)statbuf.st_size;
+    if (file_size == 0 || file_size > (uint64_t)SIZE_MAX) {
+        return -1;
+    }
+
+    mapped = mmap(NULL, (size_t)file_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    if (mapped == MAP_FAILED) {
+        return -1;
+    }
+    data = (const unsigned char *)mapped;
+#endif
+
+    match = pyi_utils_find_last_pattern(data, (size_t)file_size, magic, magic_len);
+    *offset = match ? (uint64_t)(match - data) : 0;
+
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap(mapped, (size_t)file_size);
+#endif
+
+    return 0;
+}
+
 /*
  * Perform full back-to-front scan of the given file and search for the
- * specified MAGIC pattern.
+ * specified MAGIC pattern. The file is memory-mapped, if possible;
+ * otherwise, it is read in large overlapping chunks.
  *
  * Returns offset within the file if MAGIC pattern is found, 0 otherwise.
  */
 uint64_t
 pyi_utils_find_magic_pattern(FILE *fp, const unsigned char *magic, size_t magic_len)
 {
-    static const int SEARCH_CHUNK_SIZE = 8192;
+    static const size_t SEARCH_CHUNK_SIZE = 1024 * 1024;
     unsigned char *buffer = NULL;
     uint64_t start_pos, end_pos;
     uint64_t offset = 0;  /* return value */
 
+    /* Search the memory-mapped file, if possible */
+    if (_pyi_utils_find_magic_pattern_mapped(fp, magic, magic_len, &offset) == 0) {
+        return offset;
+    }
+
     /* Allocate the read buffer */
     buffer = malloc(SEARCH_CHUNK_SIZE);
     if (!buffer) {
-        PYI_DEBUG("LOADER: failed to allocate read buffer (%d bytes)!\n", SEARCH_CHUNK_SIZE);
+        PYI_DEBUG("LOADER: failed to allocate read buffer (%zu bytes)!\n", SEARCH_CHUNK_SIZE);
         goto cleanup;
     }
 
@@ -208,7 +953,8 @@ pyi_utils_find_magic_pattern(FILE *fp, const unsigned char *magic, size_t magic_
     /* Search the file back to front, in overlapping SEARCH_CHUNK_SIZE
      * chunks. */
     do {
-        size_t chunk_size, i;
+        const unsigned char *match;
+        size_t chunk_size;
         start_pos = (end_pos >= SEARCH_CHUNK_SIZE) ? (end_pos - SEARCH_CHUNK_SIZE) : 0;
         chunk_size = (size_t)(end_pos - start_pos);
 
@@ -217,7 +963,9 @@ pyi_utils_find_magic_pattern(FILE *fp, const unsigned char *magic, size_t magic_
             break;
         }
 
-        /* Read the chunk */
+        /* Read the chunk; on POSIX, use positional read, which avoids
+         * the separate seek (and the stdio buffering). */
+#ifdef _WIN32
         if (pyi_fseek(fp, start_pos, SEEK_SET) < 0) {
             PYI_DEBUG("LOADER: failed to seek to the offset 0x%" PRIX64 "!\n", start_pos);
             goto cleanup;
@@ -226,13 +974,18 @@ pyi_utils_find_magic_pattern(FILE *fp, const unsigned char *magic, size_t magic_
             PYI_DEBUG("LOADER: failed to read chunk (%zd bytes)!\n", chunk_size);
             goto cleanup;
         }
+#else
+        if (pread(fileno(fp), buffer, chunk_size, (off_t)start_pos) != (ssize_t)chunk_size) {
+            PYI_DEBUG("LOADER: failed to read chunk (%zd bytes)!\n", chunk_size);
+            goto cleanup;
+        }
+#endif
 
         /* Scan the chunk */
-        for (i = chunk_size - magic_len + 1; i > 0; i--) {
-            if (memcmp(buffer + i -1, magic, magic_len) == 0) {
-                offset = start_pos + i - 1;
-                goto cleanup;
-            }
+        match = pyi_utils_find_last_pattern(buffer, chunk_size, magic, magic_len);
+        if (match) {
+            offset = start_pos + (uint64_t)(match - buffer);
+            goto cleanup;
         }
 
         /* Adjust search location for next chunk; ensure proper overlap */
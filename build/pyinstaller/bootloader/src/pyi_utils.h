@@ -22,27 +22,47 @@
 #include <inttypes.h> /* uint64_t */
 
 struct PYI_CONTEXT;
+struct PYI_ARENA;
 
 /* Environment variables. */
 char *pyi_getenv(const char *variable);
+char *pyi_arena_getenv(struct PYI_ARENA *arena, const char *variable);
 int pyi_setenv(const char *variable, const char *value);
 int pyi_unsetenv(const char *variable);
 
 /* Temporary top-level application directory (onefile). */
 int pyi_create_temporary_application_directory(struct PYI_CONTEXT *pyi_ctx);
 
-/* Recursive directory deletion. */
+/* Recursive directory deletion. Sibling sub-directory trees of the
+ * given directory are removed in parallel, using up to
+ * PYI_RMDIR_MAX_THREADS worker threads. */
+#define PYI_RMDIR_MAX_THREADS 4
+
 int pyi_recursive_rmdir(const char *dir);
 
 /* Misc. file/directory manipulation. */
-int pyi_create_parent_directory_tree(const struct PYI_CONTEXT *pyi_ctx, const char *prefix_path, const char *filename);
+struct PYI_DIRECTORY_CACHE;
+
+struct PYI_DIRECTORY_CACHE *pyi_directory_cache_new(void);
+void pyi_directory_cache_free(struct PYI_DIRECTORY_CACHE **cache_ref);
+
+int pyi_create_parent_directory_tree(const struct PYI_CONTEXT *pyi_ctx, struct PYI_DIRECTORY_CACHE *cache, const char *prefix_path, const char *filename);
 int pyi_copy_file(const char *src_filename, const char *dest_filename);
+int pyi_clone_file(const char *src_filename, const char *dest_filename);
+int pyi_utils_copy_file_range(int in_fd, uint64_t in_offset, int out_fd, uint64_t length);
+int pyi_utils_create_memfd(const char *name);
+void pyi_utils_seal_memfd(int fd);
+
+/* Process memory footprint. */
+void pyi_utils_trim_memory(void);
+uint64_t pyi_utils_get_resident_memory(void);
 
 /* Child process */
 int pyi_utils_create_child(struct PYI_CONTEXT *pyi_ctx);
 
 #if !defined(_WIN32) && !defined(__APPLE__)
 int pyi_utils_set_library_search_path(const char *path);
+int pyi_utils_preload_library(const char *home_dir, const char *name);
 #endif
 
 /* Argument handling (POSIX only) */
@@ -56,6 +76,7 @@ char *const *pyi_prepend_dynamic_loader_to_argv(const int argc, char *const argv
 /* Magic pattern matching */
 extern const unsigned char MAGIC_BASE[8];
 uint64_t pyi_utils_find_magic_pattern(FILE *fp, const unsigned char *magic, size_t magic_len);
+const unsigned char *pyi_utils_find_last_pattern(const unsigned char *data, size_t size, const unsigned char *pattern, size_t pattern_len);
 
 /* Security descriptor for temporary directory (Windows only) */
 #if defined(_WIN32)
@@ -31,6 +31,7 @@
 #include <signal.h> /* kill */
 #include <sys/stat.h> /* struct stat */
 #include <sys/wait.h>
+#include <dlfcn.h> /* dlopen */
 
 #if defined(PYI_USE_POSIX_SEMAPHORE)
     #include <sys/mman.h> /* mmap */
@@ -48,6 +49,33 @@
 #endif
 
 #include <dirent.h>
+#include <fcntl.h> /* openat, O_DIRECTORY */
+
+#if defined(HAVE_POSIX_SPAWNP)
+    #include <spawn.h> /* posix_spawnp */
+    extern char **environ;
+#endif
+
+#if defined(__linux__)
+    #include <sys/statfs.h> /* statfs, for file system type */
+    #include <sys/statvfs.h> /* statvfs, for free space and mount flags */
+#endif
+
+/* Event loop used by onefile parent process while waiting for the child
+ * process; on macOS, windowed bootloader needs to process Apple Events
+ * instead. */
+#if defined(__linux__) && defined(HAVE_SIGNALFD)
+    #include <sys/syscall.h> /* SYS_pidfd_open */
+    #if defined(SYS_pidfd_open)
+        #include <sys/signalfd.h>
+        #include <poll.h>
+        #define PYI_CHILD_EVENT_LOOP_PIDFD
+    #endif
+#elif defined(HAVE_KQUEUE) && !(defined(__APPLE__) && defined(WINDOWED))
+    #include <sys/types.h>
+    #include <sys/event.h> /* kqueue */
+    #define PYI_CHILD_EVENT_LOOP_KQUEUE
+#endif
 
 #ifndef SIGCLD
     #define SIGCLD SIGCHLD /* not defined on macOS */
@@ -59,9 +87,12 @@
 
 /* PyInstaller headers. */
 #include "pyi_utils.h"
+#include "pyi_arena.h"
+#include "pyi_archive.h"
 #include "pyi_path.h"
 #include "pyi_main.h"
 #include "pyi_apple_events.h"
+#include "pyi_thread.h"
 
 
 /**********************************************************************\
@@ -82,6 +113,15 @@ pyi_getenv(const char *variable)
     return (value && value[0]) ? strdup(value) : NULL; /* Return a copy */
 }
 
+/* Same as pyi_getenv(), except that the copy is allocated from the
+ * given arena. */
+char *
+pyi_arena_getenv(struct PYI_ARENA *arena, const char *variable)
+{
+    char *value = getenv(variable);
+    return (value && value[0]) ? pyi_arena_strdup(arena, value) : NULL;
+}
+
 int
 pyi_setenv(const char *variable, const char *value)
 {
@@ -208,10 +248,141 @@ _pyi_format_and_create_tmpdir(char *tmpdir_path)
     if (mkdtemp(tmpdir_path) == NULL) {
         return -1;
     }
+    pyi_stats_add(&global_pyi_ctx->stats.directories_created, 1);
 
     return 0;
 }
 
+#if defined(__linux__)
+
+/* File system magic numbers of RAM-backed file systems (see statfs(2)) */
+#define _PYI_TMPFS_MAGIC 0x01021994
+#define _PYI_RAMFS_MAGIC 0x858458F6
+
+/* Declared by glibc only if _GNU_SOURCE is defined; the value is fixed
+ * by the Linux kernel ABI. */
+#ifndef ST_NOEXEC
+    #define ST_NOEXEC 8
+#endif
+
+/*
+ * Compute the amount of space that the onefile application occupies
+ * when extracted into its temporary directory, based on uncompressed
+ * lengths of extractable entries recorded in the TOC. Binaries that are
+ * extracted into memory-backed files (see pyi_launch.c) are not counted.
+ */
+static uint64_t
+_pyi_get_extraction_size(const struct PYI_CONTEXT *pyi_ctx, bool *has_binaries)
+{
+    const struct TOC_ENTRY *const *toc_entries;
+    size_t num_entries;
+    size_t i;
+    uint64_t size = 0;
+
+    *has_binaries = false;
+
+    toc_entries = pyi_archive_get_toc_group(pyi_ctx->archive, ARCHIVE_TOC_GROUP_EXTRACTABLE, &num_entries);
+    for (i = 0; i < num_entries; i++) {
+        if (toc_entries[i]->typecode == ARCHIVE_ITEM_BINARY) {
+            if (pyi_ctx->memfd_binaries) {
+                continue;
+            }
+            *has_binaries = true;
+        }
+        size += toc_entries[i]->uncompressed_length;
+    }
+
+    return size;
+}
+
+/*
+ * Check whether the given directory is on a RAM-backed file system with
+ * enough free space for extraction of the application, and (if the
+ * application contains binaries that are loaded from there) without
+ * `noexec` mount flag. To leave room for the application's own use of
+ * the file system (and for other processes), the extracted contents are
+ * allowed to take at most half of the available space.
+ */
+static bool
+_pyi_is_suitable_ram_backed_tmpdir(const char *path, uint64_t required_size, bool needs_exec)
+{
+    struct statfs fs_info;
+    struct statvfs vfs_info;
+    uint64_t available_size;
+
+    if (statfs(path, &fs_info) != 0 || statvfs(path, &vfs_info) != 0) {
+        return false;
+    }
+
+    if ((unsigned long)fs_info.f_type != _PYI_TMPFS_MAGIC && (unsigned long)fs_info.f_type != _PYI_RAMFS_MAGIC) {
+        PYI_DEBUG("LOADER: %s is not on a RAM-backed file system.\n", path);
+        return false;
+    }
+
+    if (needs_exec && (vfs_info.f_flag & ST_NOEXEC)) {
+        PYI_DEBUG("LOADER: %s is mounted with noexec flag.\n", path);
+        return false;
+    }
+
+    /* ramfs reports no size limit; it is used only if it is the target
+     * of $XDG_RUNTIME_DIR, which is managed by the system. */
+    if (vfs_info.f_blocks == 0) {
+        return true;
+    }
+
+    available_size = (uint64_t)vfs_info.f_bavail * (uint64_t)vfs_info.f_frsize;
+    if (required_size > available_size / 2) {
+        PYI_DEBUG("LOADER: not enough free space in %s (%llu bytes required, %llu bytes available).\n", path, (unsigned long long)required_size, (unsigned long long)available_size);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Try creating the temporary directory on a RAM-backed file system, as
+ * per `auto` policy of the runtime_tmpdir option. The candidate
+ * locations are $XDG_RUNTIME_DIR (a per-user directory, typically on
+ * tmpfs) and /dev/shm. Returns 0 on success, and -1 if no candidate is
+ * suitable, in which case the caller should fall back to the standard
+ * temporary directory locations.
+ */
+static int
+_pyi_create_ram_backed_tmpdir(struct PYI_CONTEXT *pyi_ctx)
+{
+    char *candidate_dirs[2];
+    uint64_t required_size;
+    bool has_binaries;
+    int rc = -1;
+    int i;
+
+    required_size = _pyi_get_extraction_size(pyi_ctx, &has_binaries);
+    PYI_DEBUG("LOADER: runtime_tmpdir=auto: application requires %llu bytes when extracted.\n", (unsigned long long)required_size);
+
+    candidate_dirs[0] = pyi_getenv("XDG_RUNTIME_DIR");
+    candidate_dirs[1] = strdup("/dev/shm");
+
+    for (i = 0; i < 2 && rc != 0; i++) {
+        if (candidate_dirs[i] == NULL || candidate_dirs[i][0] != PYI_SEP) {
+            continue;
+        }
+        if (!_pyi_is_suitable_ram_backed_tmpdir(candidate_dirs[i], required_size, has_binaries)) {
+            continue;
+        }
+        if (snprintf(pyi_ctx->application_home_dir, PYI_PATH_MAX, "%s", candidate_dirs[i]) >= PYI_PATH_MAX) {
+            continue;
+        }
+        rc = _pyi_format_and_create_tmpdir(pyi_ctx->application_home_dir);
+    }
+
+    free(candidate_dirs[0]);
+    free(candidate_dirs[1]);
+
+    return rc;
+}
+
+#endif /* defined(__linux__) */
+
 int
 pyi_create_temporary_application_directory(struct PYI_CONTEXT *pyi_ctx)
 {
@@ -252,6 +423,17 @@ pyi_create_temporary_application_directory(struct PYI_CONTEXT *pyi_ctx)
         return _pyi_format_and_create_tmpdir(pyi_ctx->application_home_dir);
     }
 
+    /* With `auto` policy, prefer RAM-backed file system if the
+     * application fits there; otherwise, use the standard locations. */
+#if defined(__linux__)
+    if (pyi_ctx->runtime_tmpdir_auto) {
+        if (_pyi_create_ram_backed_tmpdir(pyi_ctx) == 0) {
+            return 0;
+        }
+        PYI_DEBUG("LOADER: runtime_tmpdir=auto: no suitable RAM-backed location; using standard temporary directory.\n");
+    }
+#endif
+
     /* Check the standard environment variables */
     for (i = 0; i < sizeof(candidate_env_vars)/sizeof(candidate_env_vars[0]); i++) {
         char *env_var_value = pyi_getenv(candidate_env_vars[i]);
@@ -288,6 +470,264 @@ pyi_create_temporary_application_directory(struct PYI_CONTEXT *pyi_ctx)
 /**********************************************************************\
  *                  Recursive removal of a directory                  *
 \**********************************************************************/
+#if defined(HAVE_FDOPENDIR)
+
+/* Collection of sub-directories of the top-level directory, which are
+ * removed in parallel by the worker threads. */
+struct _PYI_RMDIR_SUBDIRS
+{
+    int dir_fd; /* Descriptor of the top-level directory */
+
+    char **names;
+    size_t count;
+    size_t capacity;
+
+#if PYI_HAVE_THREADS
+    /* Mutex protecting the `next` field; used only if `use_mutex` is
+     * set (i.e., if worker threads are used) */
+    pyi_mutex_t mutex;
+    bool use_mutex;
+#endif
+    size_t next;
+};
+
+static int _pyi_recursive_rmdir_at(int parent_fd, const char *name);
+
+/*
+ * Add the sub-directory name to the collection. Returns 0 on success,
+ * -1 on failure (in which case the caller should remove the directory
+ * itself).
+ */
+static int
+_pyi_rmdir_subdirs_add(struct _PYI_RMDIR_SUBDIRS *subdirs, const char *name)
+{
+    char *name_copy;
+
+    if (subdirs->count == subdirs->capacity) {
+        size_t new_capacity = subdirs->capacity ? 2 * subdirs->capacity : 16;
+        char **new_names = (char **)realloc(subdirs->names, new_capacity * sizeof(char *));
+        if (new_names == NULL) {
+            return -1;
+        }
+        subdirs->names = new_names;
+        subdirs->capacity = new_capacity;
+    }
+
+    name_copy = strdup(name);
+    if (name_copy == NULL) {
+        return -1;
+    }
+    subdirs->names[subdirs->count++] = name_copy;
+
+    return 0;
+}
+
+/*
+ * Remove the contents of directory with given open descriptor. The
+ * descriptor is consumed (closed) by this function. If `subdirs` is
+ * not NULL, the sub-directories are collected into it instead of being
+ * removed; in that case, the descriptor is kept open, and the caller
+ * becomes responsible for closing it.
+ *
+ * The removal is performed relative to the directory descriptor (i.e.,
+ * using unlinkat()), so we do not need to construct full paths to the
+ * entries, and the kernel does not need to resolve them. The entry type
+ * is determined from `d_type` field of the directory entry, so in
+ * general no stat call is required; fstatat() is used only for file
+ * systems that do not report the entry type.
+ */
+static void
+_pyi_rmdir_contents(int dir_fd, struct _PYI_RMDIR_SUBDIRS *subdirs)
+{
+    DIR *dir_handle;
+    struct dirent *dir_entry;
+    struct stat stat_buf;
+    bool is_dir;
+
+    /* If we are collecting sub-directories, the descriptor needs to
+     * outlive the directory handle. */
+    if (subdirs) {
+        dir_fd = dup(dir_fd);
+        if (dir_fd < 0) {
+            return;
+        }
+    }
+
+    dir_handle = fdopendir(dir_fd);
+    if (dir_handle == NULL) {
+        close(dir_fd);
+        return;
+    }
+
+    /* Iterate over directory contents */
+    for (dir_entry = readdir(dir_handle); dir_entry != NULL; dir_entry = readdir(dir_handle)) {
+        /* Skip . and .. */
+        if (strcmp(dir_entry->d_name, ".") == 0 || strcmp(dir_entry->d_name, "..") == 0) {
+            continue;
+        }
+
+        /* Deteremine the type of entry, and remove it. Symbolic links
+         * are not followed, in order to prevent recursion into
+         * symlinked directories. On errors, emit debug messages to
+         * simplify debugging, and keep going on. We want to remove
+         * everything we can; if we fail to remove an entry here, we
+         * will also fail to remove the top-level directory, and will
+         * return error there and then. */
+#if defined(DT_DIR)
+        if (dir_entry->d_type != DT_UNKNOWN) {
+            is_dir = dir_entry->d_type == DT_DIR;
+        } else
+#endif
+        if (fstatat(dirfd(dir_handle), dir_entry->d_name, &stat_buf, AT_SYMLINK_NOFOLLOW) == 0) {
+            is_dir = S_ISDIR(stat_buf.st_mode);
+        } else {
+            continue;
+        }
+
+        if (is_dir) {
+            if (subdirs && _pyi_rmdir_subdirs_add(subdirs, dir_entry->d_name) == 0) {
+                continue; /* Removed later, by the worker threads */
+            }
+            /* Recurse into sub-directory */
+            if (_pyi_recursive_rmdir_at(dirfd(dir_handle), dir_entry->d_name) < 0) {
+                PYI_DEBUG("LOADER: failed to remove directory: %s\n", dir_entry->d_name);
+            }
+        } else {
+            if (unlinkat(dirfd(dir_handle), dir_entry->d_name, 0) < 0) {
+                PYI_DEBUG("LOADER: failed to remove file: %s\n", dir_entry->d_name);
+            }
+        }
+    }
+    closedir(dir_handle);
+}
+
+/*
+ * Recursively remove the directory with given name, relative to the
+ * parent directory descriptor. Returns 0 on success, -1 on error.
+ */
+static int
+_pyi_recursive_rmdir_at(int parent_fd, const char *name)
+{
+    int dir_fd;
+
+    dir_fd = openat(parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dir_fd < 0) {
+        return -1;
+    }
+    _pyi_rmdir_contents(dir_fd, NULL);
+
+    return unlinkat(parent_fd, name, AT_REMOVEDIR);
+}
+
+/*
+ * Remove the collected sub-directories, until there are none left.
+ * Run by the worker threads as well as the calling thread.
+ */
+static void
+_pyi_rmdir_remove_subdirs(struct _PYI_RMDIR_SUBDIRS *subdirs)
+{
+    size_t index;
+
+    while (1) {
+#if PYI_HAVE_THREADS
+        if (subdirs->use_mutex) {
+            pyi_mutex_lock(&subdirs->mutex);
+            index = subdirs->next++;
+            pyi_mutex_unlock(&subdirs->mutex);
+        } else
+#endif
+        {
+            index = subdirs->next++;
+        }
+        if (index >= subdirs->count) {
+            break;
+        }
+
+        if (_pyi_recursive_rmdir_at(subdirs->dir_fd, subdirs->names[index]) < 0) {
+            PYI_DEBUG("LOADER: failed to remove directory: %s\n", subdirs->names[index]);
+        }
+    }
+}
+
+#if PYI_HAVE_THREADS
+
+static PYI_THREAD_PROC_TYPE
+_pyi_rmdir_worker(void *arg)
+{
+    _pyi_rmdir_remove_subdirs((struct _PYI_RMDIR_SUBDIRS *)arg);
+    PYI_THREAD_PROC_RETURN;
+}
+
+#endif
+
+int
+pyi_recursive_rmdir(const char *dir_path)
+{
+    struct _PYI_RMDIR_SUBDIRS subdirs;
+    size_t index;
+#if PYI_HAVE_THREADS
+    pyi_thread_t threads[PYI_RMDIR_MAX_THREADS];
+    int num_threads = 0;
+    int max_threads;
+#endif
+
+    memset(&subdirs, 0, sizeof(subdirs));
+
+    /* Open the directory */
+    subdirs.dir_fd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (subdirs.dir_fd < 0) {
+        return -1;
+    }
+
+    /* Remove the files in the top-level directory, and collect its
+     * sub-directories. */
+    _pyi_rmdir_contents(subdirs.dir_fd, &subdirs);
+
+    /* Remove the sibling sub-directory trees in parallel, using a small
+     * pool of worker threads; the calling thread participates as well.
+     * If threads cannot be started, the calling thread removes all of
+     * them by itself. */
+#if PYI_HAVE_THREADS
+    if (subdirs.count > 1 && pyi_mutex_init(&subdirs.mutex) == 0) {
+        subdirs.use_mutex = true;
+        max_threads = pyi_thread_get_cpu_count() - 1;
+        if (max_threads > PYI_RMDIR_MAX_THREADS) {
+            max_threads = PYI_RMDIR_MAX_THREADS;
+        }
+        if ((size_t)max_threads > subdirs.count - 1) {
+            max_threads = (int)(subdirs.count - 1);
+        }
+        for (num_threads = 0; num_threads < max_threads; num_threads++) {
+            if (pyi_thread_create(&threads[num_threads], _pyi_rmdir_worker, &subdirs) < 0) {
+                break;
+            }
+        }
+
+        _pyi_rmdir_remove_subdirs(&subdirs);
+
+        for (index = 0; index < (size_t)num_threads; index++) {
+            pyi_thread_join(threads[index]);
+        }
+        pyi_mutex_destroy(&subdirs.mutex);
+    } else
+#endif
+    {
+        _pyi_rmdir_remove_subdirs(&subdirs);
+    }
+
+    for (index = 0; index < subdirs.count; index++) {
+        free(subdirs.names[index]);
+    }
+    free(subdirs.names);
+    close(subdirs.dir_fd);
+
+    /* Finally, remove the directory; the return value of rmdir (0 on
+     * success, -1 on error) maps directly to this function's return. */
+    return rmdir(dir_path);
+}
+
+#else /* defined(HAVE_FDOPENDIR) */
+
 int
 pyi_recursive_rmdir(const char *dir_path)
 {
@@ -356,6 +796,8 @@ pyi_recursive_rmdir(const char *dir_path)
     return rmdir(dir_path);
 }
 
+#endif /* defined(HAVE_FDOPENDIR) */
+
 
 /**********************************************************************\
  *                  Child process spawning (onefile)                  *
@@ -415,6 +857,32 @@ pyi_utils_set_library_search_path(const char *path)
     return rc;
 }
 
+/* Load the bundled shared library with given name (relative to the
+ * application's top-level directory) by its absolute path. The library
+ * is never unloaded; once it is loaded, the dynamic linker resolves the
+ * subsequent references to its SONAME to it, including those from the
+ * libraries and extension modules loaded later. Lazy binding allows the
+ * library to reference symbols that become available only later (for
+ * example, those of python shared library). */
+int
+pyi_utils_preload_library(const char *home_dir, const char *name)
+{
+    char library_path[PYI_PATH_MAX];
+
+    if (pyi_path_join(library_path, home_dir, name) == NULL) {
+        PYI_DEBUG("LOADER: path of library to preload is too long: %s\n", name);
+        return -1;
+    }
+
+    PYI_DEBUG("LOADER: preloading shared library: %s\n", library_path);
+    if (dlopen(library_path, RTLD_LAZY | RTLD_LOCAL) == NULL) {
+        PYI_DEBUG("LOADER: failed to preload shared library: %s\n", dlerror());
+        return -1;
+    }
+
+    return 0;
+}
+
 #endif /* !defined(__APPLE__) */
 
 /*
@@ -500,6 +968,328 @@ _signal_handler(int signum)
     errno = original_errno; /* Restore original errno */
 }
 
+/* Set the signal mask of the calling thread. */
+static void
+_pyi_set_signal_mask(int how, const sigset_t *set, sigset_t *old_set)
+{
+#if PYI_HAVE_THREADS
+    pthread_sigmask(how, set, old_set);
+#else
+    sigprocmask(how, set, old_set);
+#endif
+}
+
+#if defined(HAVE_POSIX_SPAWNP)
+
+/* Start the child process using posix_spawnp(). Unlike fork(), this does
+ * not duplicate the parent's address space (glibc and musl implement it
+ * using clone() with CLONE_VM and CLONE_VFORK, and macOS has a dedicated
+ * system call), so the cost of creating the child does not depend on how
+ * much memory the parent has accumulated by this point (archive TOC, splash
+ * screen resources and Tcl interpreter, zlib state). The child starts with
+ * the given signal mask. Returns the PID of the child process, or -1 on
+ * error (with errno set). */
+static pid_t
+_pyi_utils_spawn_child(const struct PYI_CONTEXT *pyi_ctx, const int argc, char *const argv[], const sigset_t *signal_mask)
+{
+    posix_spawnattr_t spawn_attr;
+    char *const *exec_argv = argv;
+    const char *exec_filename = pyi_ctx->executable_filename;
+    pid_t child_pid = -1;
+    int rc;
+
+    rc = posix_spawnattr_init(&spawn_attr);
+    if (rc != 0) {
+        errno = rc;
+        return -1;
+    }
+
+    posix_spawnattr_setsigmask(&spawn_attr, signal_mask);
+    posix_spawnattr_setflags(&spawn_attr, POSIX_SPAWN_SETSIGMASK);
+
+    if (pyi_ctx->dynamic_loader_filename[0] != 0) {
+        PYI_DEBUG("LOADER: starting child process via posix_spawnp and dynamic linker/loader: %s\n", pyi_ctx->dynamic_loader_filename);
+        exec_argv = pyi_prepend_dynamic_loader_to_argv(argc, argv, (char *)pyi_ctx->dynamic_loader_filename);
+        if (exec_argv == NULL) {
+            PYI_ERROR("LOADER: failed to allocate argv array for posix_spawnp!\n");
+            posix_spawnattr_destroy(&spawn_attr);
+            errno = ENOMEM;
+            return -1;
+        }
+        exec_filename = pyi_ctx->dynamic_loader_filename;
+    } else {
+        PYI_DEBUG("LOADER: starting child process via posix_spawnp\n");
+    }
+
+    rc = posix_spawnp(&child_pid, exec_filename, NULL, &spawn_attr, exec_argv, environ);
+    if (rc != 0) {
+        child_pid = -1;
+    }
+
+    if (exec_argv != argv) {
+        free((void *)exec_argv);
+    }
+    posix_spawnattr_destroy(&spawn_attr);
+
+    errno = rc;
+    return child_pid;
+}
+
+#endif /* defined(HAVE_POSIX_SPAWNP) */
+
+#if defined(PYI_CHILD_EVENT_LOOP_PIDFD) || defined(PYI_CHILD_EVENT_LOOP_KQUEUE)
+
+/*
+ * Event loop for onefile parent process, which waits for the child process
+ * to exit while forwarding the received signals to it. Instead of using
+ * asynchronous signal handlers and blocking waitpid(), both the signals
+ * and the child's exit are received as events on file descriptors - on
+ * Linux, via signalfd(2) and pidfd_open(2); on macOS and BSDs, via kqueue(2)
+ * with EVFILT_SIGNAL and EVFILT_PROC filters. Signals are thus forwarded
+ * synchronously, child's exit is noticed immediately, and the parent does
+ * not wake up while idle.
+ *
+ * If the event loop cannot be set up (e.g., pidfd_open() is unavailable on
+ * kernels older than 5.3), we fall back to signal handlers and waitpid().
+ */
+struct CHILD_EVENT_LOOP
+{
+#if defined(PYI_CHILD_EVENT_LOOP_PIDFD)
+    int pid_fd;
+    int signal_fd;
+#else
+    int kqueue_fd;
+#endif
+};
+
+/* Forward the signal to the child process, unless we are ignoring the
+ * signals. Avoid generating debug messages here, to avoid endless
+ * SIGPIPE forwarding loop if stderr is a broken pipe (see #5270). */
+static void
+_pyi_child_event_loop_forward_signal(struct PYI_CONTEXT *pyi_ctx, pid_t child_pid, int signum)
+{
+    if (pyi_ctx->ignore_signals) {
+        return;
+    }
+
+#if defined(LAUNCH_DEBUG)
+    pyi_ctx->signal_forward_all++;
+#endif
+
+    /* No-op if child process does not exist anymore. NOTE: kill() with
+     * PID 0 would signal the whole process group! */
+    if (child_pid <= 0) {
+#if defined(LAUNCH_DEBUG)
+        pyi_ctx->signal_forward_noop++;
+#endif
+        return;
+    }
+
+#if defined(LAUNCH_DEBUG)
+    if (kill(child_pid, signum) == 0) {
+        pyi_ctx->signal_forward_ok++;
+    } else {
+        pyi_ctx->signal_forward_error++;
+    }
+#else
+    kill(child_pid, signum);
+#endif
+}
+
+#if defined(PYI_CHILD_EVENT_LOOP_PIDFD)
+
+/* Set up the event loop for the given child process and set of signals.
+ * The caller is responsible for blocking the signals (so that they are
+ * received via signalfd instead of being delivered) before running the
+ * loop. Returns 0 on success, -1 on error. */
+static int
+_pyi_child_event_loop_init(struct CHILD_EVENT_LOOP *loop, struct PYI_CONTEXT *pyi_ctx, pid_t child_pid, const sigset_t *signals, int num_signals)
+{
+    (void)pyi_ctx;
+    (void)num_signals;
+
+    /* NOTE: pidfd_open() always sets the close-on-exec flag. */
+    loop->pid_fd = (int)syscall(SYS_pidfd_open, child_pid, 0);
+    if (loop->pid_fd < 0) {
+        PYI_DEBUG("LOADER: pidfd_open() failed (errno %d) - using signal handlers instead of event loop.\n", errno);
+        return -1;
+    }
+
+    loop->signal_fd = signalfd(-1, signals, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (loop->signal_fd < 0) {
+        PYI_DEBUG("LOADER: signalfd() failed (errno %d) - using signal handlers instead of event loop.\n", errno);
+        close(loop->pid_fd);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Receive and forward the pending signals. */
+static void
+_pyi_child_event_loop_read_signals(struct CHILD_EVENT_LOOP *loop, struct PYI_CONTEXT *pyi_ctx, pid_t child_pid)
+{
+    struct signalfd_siginfo info[8];
+    ssize_t num_read;
+    size_t i;
+
+    while ((num_read = read(loop->signal_fd, info, sizeof(info))) > 0) {
+        for (i = 0; i < (size_t)num_read / sizeof(info[0]); i++) {
+            _pyi_child_event_loop_forward_signal(pyi_ctx, child_pid, (int)info[i].ssi_signo);
+        }
+    }
+}
+
+/* Run the event loop until the child process exits, and reap it. Returns
+ * the result of waitpid() call. */
+static pid_t
+_pyi_child_event_loop_run(struct CHILD_EVENT_LOOP *loop, struct PYI_CONTEXT *pyi_ctx, pid_t child_pid, int *status)
+{
+    struct pollfd fds[2];
+
+    fds[0].fd = loop->signal_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = loop->pid_fd;
+    fds[1].events = POLLIN;
+
+    for (;;) {
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            PYI_WARNING("LOADER: event loop failed to poll: %s\n", strerror(errno));
+            break;
+        }
+
+        /* Forward signals first, so that signals received before the child
+         * exited are not lost. */
+        if (fds[0].revents & POLLIN) {
+            _pyi_child_event_loop_read_signals(loop, pyi_ctx, child_pid);
+        }
+
+        if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            break;
+        }
+    }
+
+    return waitpid(child_pid, status, 0);
+}
+
+static void
+_pyi_child_event_loop_cleanup(struct CHILD_EVENT_LOOP *loop, struct PYI_CONTEXT *pyi_ctx)
+{
+    /* Drain the signals that arrived after the child exited; otherwise,
+     * they would be delivered (with their default action) as soon as the
+     * signals are unblocked, and might terminate the parent before it
+     * cleans up. */
+    _pyi_child_event_loop_read_signals(loop, pyi_ctx, 0);
+
+    close(loop->signal_fd);
+    close(loop->pid_fd);
+}
+
+#else /* PYI_CHILD_EVENT_LOOP_KQUEUE */
+
+/* Set up the event loop for the given child process and set of signals.
+ * The signals are set to be ignored, as EVFILT_SIGNAL records them
+ * regardless of their disposition. Returns 0 on success, -1 on error. */
+static int
+_pyi_child_event_loop_init(struct CHILD_EVENT_LOOP *loop, struct PYI_CONTEXT *pyi_ctx, pid_t child_pid, const sigset_t *signals, int num_signals)
+{
+    struct kevent change;
+    sigset_t pending_signals;
+    int signum;
+
+    loop->kqueue_fd = kqueue();
+    if (loop->kqueue_fd < 0) {
+        PYI_DEBUG("LOADER: kqueue() failed (errno %d) - using signal handlers instead of event loop.\n", errno);
+        return -1;
+    }
+    fcntl(loop->kqueue_fd, F_SETFD, FD_CLOEXEC);
+
+    /* This fails with ESRCH if the child has already exited; in that case,
+     * the fall-back waitpid() returns immediately. */
+    EV_SET(&change, child_pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, NULL);
+    if (kevent(loop->kqueue_fd, &change, 1, NULL, 0, NULL) < 0) {
+        PYI_DEBUG("LOADER: failed to register child process with kqueue (errno %d) - using signal handlers instead of event loop.\n", errno);
+        close(loop->kqueue_fd);
+        return -1;
+    }
+
+    /* Signals that are pending at this point (e.g., have been received
+     * while being blocked during child process creation) are not recorded
+     * by kqueue, and are discarded once the signal is set to be ignored,
+     * so forward them right away. */
+    sigemptyset(&pending_signals);
+    sigpending(&pending_signals);
+
+    for (signum = 1; signum < num_signals; ++signum) {
+        if (sigismember(signals, signum) != 1) {
+            continue;
+        }
+        EV_SET(&change, signum, EVFILT_SIGNAL, EV_ADD, 0, 0, NULL);
+        if (kevent(loop->kqueue_fd, &change, 1, NULL, 0, NULL) < 0) {
+            continue;
+        }
+        if (sigismember(&pending_signals, signum) == 1) {
+            _pyi_child_event_loop_forward_signal(pyi_ctx, child_pid, signum);
+        }
+        signal(signum, SIG_IGN);
+    }
+
+    return 0;
+}
+
+/* Run the event loop until the child process exits, and reap it. Returns
+ * the result of waitpid() call. */
+static pid_t
+_pyi_child_event_loop_run(struct CHILD_EVENT_LOOP *loop, struct PYI_CONTEXT *pyi_ctx, pid_t child_pid, int *status)
+{
+    struct kevent events[8];
+    int num_events;
+    int i;
+
+    for (;;) {
+        num_events = kevent(loop->kqueue_fd, NULL, 0, events, 8, NULL);
+        if (num_events < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            PYI_WARNING("LOADER: event loop failed to wait for events: %s\n", strerror(errno));
+            break;
+        }
+
+        /* Forward signals first, so that signals received before the child
+         * exited are not lost. */
+        for (i = 0; i < num_events; i++) {
+            if (events[i].filter == EVFILT_SIGNAL) {
+                _pyi_child_event_loop_forward_signal(pyi_ctx, child_pid, (int)events[i].ident);
+            }
+        }
+        for (i = 0; i < num_events; i++) {
+            if (events[i].filter == EVFILT_PROC) {
+                return waitpid(child_pid, status, 0);
+            }
+        }
+    }
+
+    return waitpid(child_pid, status, 0);
+}
+
+static void
+_pyi_child_event_loop_cleanup(struct CHILD_EVENT_LOOP *loop, struct PYI_CONTEXT *pyi_ctx)
+{
+    (void)pyi_ctx;
+    close(loop->kqueue_fd);
+}
+
+#endif /* PYI_CHILD_EVENT_LOOP_KQUEUE */
+
+#endif /* defined(PYI_CHILD_EVENT_LOOP_PIDFD) || defined(PYI_CHILD_EVENT_LOOP_KQUEUE) */
+
 /* Start frozen application in a subprocess. The frozen application runs
  * in a subprocess. */
 int
@@ -516,14 +1306,37 @@ pyi_utils_create_child(struct PYI_CONTEXT *pyi_ctx)
     sighandler_t signal_handler;
     int signum;
 
-    /* Create semaphore for synchronizing child and parent; we need to
-     * ensure that the child starts executing user's python code only
-     * *after* the parent has fully completed the `fork()` call *and* stored
-     * the child process ID to `pyi_ctx->child_pid` for the forwarding
-     * signal handlers (as well as installed the said handlers).
-     * Failing to do so leads to sporadic failures in our signal handling
-     * test (`test_onefile_signal_handling`) when performed under heavy
-     * CPU load.
+    /* Signals to forward to the child (or ignore). */
+    sigset_t forwarded_signals;
+    bool use_event_loop = false;
+#if defined(PYI_CHILD_EVENT_LOOP_PIDFD) || defined(PYI_CHILD_EVENT_LOOP_KQUEUE)
+    struct CHILD_EVENT_LOOP event_loop;
+#endif
+
+    /* Prefer creating the child process via posix_spawnp(), which avoids
+     * the cost of duplicating the parent's address space. The exception
+     * is activation by systemd socket, where the child needs to set
+     * LISTEN_PID to its own PID before exec (see _pyi_set_systemd_env()),
+     * and thus requires fork(). */
+    bool use_posix_spawn = false;
+    sigset_t original_signal_mask;
+    bool signals_blocked = false;
+#if defined(HAVE_POSIX_SPAWNP)
+    sigset_t blocked_signals;
+
+    use_posix_spawn = getenv("LISTEN_PID") == NULL;
+#endif
+
+    /* When using fork(), create semaphore for synchronizing child and
+     * parent; we need to ensure that the child starts executing user's
+     * python code only *after* the parent has fully completed the `fork()`
+     * call *and* stored the child process ID to `pyi_ctx->child_pid` for
+     * the forwarding signal handlers (as well as installed the said
+     * handlers). Failing to do so leads to sporadic failures in our signal
+     * handling test (`test_onefile_signal_handling`) when performed under
+     * heavy CPU load. With posix_spawnp(), we instead block signals in the
+     * parent until the handlers are installed, so that the signals received
+     * in the meantime are held pending instead of being lost.
      *
      * Our first choice of API are unnamed POSIX semaphores, which should
      * be available on most POSIX platforms. However, they are unavailable
@@ -531,20 +1344,22 @@ pyi_utils_create_child(struct PYI_CONTEXT *pyi_ctx)
      * the old SysV semaphore API... */
 
 #if defined(PYI_USE_POSIX_SEMAPHORE)
-    sem_t *sem_ptr;
-
-    /* Create anonymous shared memory region for the semaphore. */
-    PYI_DEBUG("LOADER: creating sync semaphore...\n");
-    sem_ptr = mmap(NULL, sizeof(sem_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-    if (sem_ptr == MAP_FAILED) {
-        PYI_DEBUG("LOADER: failed to create shared memory region for sync semaphore (errno %d) - disabling sync.\n", errno);
-    } else {
-        /* Initialize semaphore with pshared=1 and value=0 (locked/acquired). */
-        if (sem_init(sem_ptr, 1, 0) < 0) {
-            PYI_DEBUG("LOADER: failed to initialize sync semaphore (errno %d) - disabling sync.\n", errno);
-            /* Unmap shared memory, and reset pointer to it for later checks. */
-            munmap(sem_ptr, sizeof(sem_t));
-            sem_ptr = MAP_FAILED;
+    sem_t *sem_ptr = MAP_FAILED;
+
+    if (!use_posix_spawn) {
+        /* Create anonymous shared memory region for the semaphore. */
+        PYI_DEBUG("LOADER: creating sync semaphore...\n");
+        sem_ptr = mmap(NULL, sizeof(sem_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (sem_ptr == MAP_FAILED) {
+            PYI_DEBUG("LOADER: failed to create shared memory region for sync semaphore (errno %d) - disabling sync.\n", errno);
+        } else {
+            /* Initialize semaphore with pshared=1 and value=0 (locked/acquired). */
+            if (sem_init(sem_ptr, 1, 0) < 0) {
+                PYI_DEBUG("LOADER: failed to initialize sync semaphore (errno %d) - disabling sync.\n", errno);
+                /* Unmap shared memory, and reset pointer to it for later checks. */
+                munmap(sem_ptr, sizeof(sem_t));
+                sem_ptr = MAP_FAILED;
+            }
         }
     }
 #elif defined(PYI_USE_SYSV_SEMAPHORE)
@@ -560,9 +1375,11 @@ pyi_utils_create_child(struct PYI_CONTEXT *pyi_ctx)
     int sem_id = -1;  /* Semaphore (array) ID */
 
     /* Create semaphore */
-    PYI_DEBUG("LOADER: creating sync semaphore...\n");
-    sem_id = semget(IPC_PRIVATE, 1, 0660 | IPC_CREAT | IPC_EXCL);
-    if (sem_id < 0) {
+    if (!use_posix_spawn) {
+        PYI_DEBUG("LOADER: creating sync semaphore...\n");
+        sem_id = semget(IPC_PRIVATE, 1, 0660 | IPC_CREAT | IPC_EXCL);
+    }
+    if (!use_posix_spawn && sem_id < 0) {
         /* Allow semaphore creation to fail, for whatever reason, and
          * disable parent/child sync in that case. Not having the sync
          * should be of little consequence outside of PyInstaller's own
@@ -598,17 +1415,34 @@ pyi_utils_create_child(struct PYI_CONTEXT *pyi_ctx)
         goto cleanup;
     }
 
-    /* argv emulation; do a short (250 ms) cycle of Apple Events processing
-     * before bringing up the child process */
+    /* argv emulation; process the launch Apple Events (waiting at most
+     * 250 ms for them) before bringing up the child process */
     if (pyi_ctx->macos_argv_emulation) {
-        pyi_apple_process_events(pyi_ctx->ae_ctx, 0.25);  /* short timeout (250 ms) */
+        pyi_apple_process_launch_events(pyi_ctx->ae_ctx, 0.25);  /* safety-net timeout (250 ms) */
     }
 #endif
 
-    /* Fork the child process. */
-    child_pid = fork();
+    /* Spawn or fork the child process. */
+#if defined(HAVE_POSIX_SPAWNP)
+    if (use_posix_spawn) {
+        char *const *argv = (pyi_ctx->pyi_argv != NULL) ? pyi_ctx->pyi_argv : pyi_ctx->argv;
+        const int argc = (pyi_ctx->pyi_argv != NULL) ? pyi_ctx->pyi_argc : pyi_ctx->argc;
+
+        /* Block all signals until the forwarding (or ignoring) signal
+         * handlers are installed; the child starts with the original
+         * signal mask. */
+        sigfillset(&blocked_signals);
+        _pyi_set_signal_mask(SIG_BLOCK, &blocked_signals, &original_signal_mask);
+        signals_blocked = true;
+
+        child_pid = _pyi_utils_spawn_child(pyi_ctx, argc, argv, &original_signal_mask);
+    } else
+#endif
+    {
+        child_pid = fork();
+    }
     if (child_pid < 0) {
-        PYI_WARNING("LOADER: failed to fork child process: %s\n", strerror(errno));
+        PYI_WARNING("LOADER: failed to create child process: %s\n", strerror(errno));
         goto cleanup;
     }
 
@@ -678,30 +1512,75 @@ pyi_utils_create_child(struct PYI_CONTEXT *pyi_ctx)
 
     /* From here to end-of-function is parent code (since the child exec'd,
      * or exited on exec failure). */
-    PYI_DEBUG("LOADER: forked child process with PID: %d\n", child_pid);
+    PYI_DEBUG("LOADER: created child process with PID: %d\n", child_pid);
 
     /* Store child PID to context structure for use in forwarding signal
      * handler (as well as Apple event handler on macOS). */
     pyi_ctx->child_pid = child_pid;
 
-    /* Install signal handlers to either forward received signals to the
-     * child process, or ignore them (effectively blocking them). */
-    if (pyi_ctx->ignore_signals) {
-        PYI_DEBUG("LOADER: registering signal handlers to ignore received signals.\n");
-        signal_handler = &_ignoring_signal_handler;
-    } else {
-        PYI_DEBUG("LOADER: registering signal handlers to forward received signals to child.\n");
-        signal_handler = &_signal_handler;
-    }
-
-    for (signum = 0; signum < num_signals; ++signum) {
-        /* Don't mess with SIGCHLD/SIGCLD; it affects our ability
-         * to wait() for the child to exit. Similarly, do not change
-         * don't change SIGTSP handling to allow Ctrl-Z */
+    /* Collect the signals to forward to the child process (or ignore).
+     * Don't mess with SIGCHLD/SIGCLD; it affects our ability to wait()
+     * for the child to exit. Similarly, do not change SIGTSP handling
+     * to allow Ctrl-Z. */
+    sigemptyset(&forwarded_signals);
+    for (signum = 1; signum < num_signals; ++signum) {
         if (signum == SIGCHLD || signum == SIGCLD || signum == SIGTSTP) {
             continue;
         }
-        signal(signum, signal_handler);
+        sigaddset(&forwarded_signals, signum); /* Fails for invalid or reserved signal numbers. */
+    }
+
+    /* Try setting up the event loop that receives signals and child's exit
+     * via file descriptors. */
+#if defined(PYI_CHILD_EVENT_LOOP_PIDFD) || defined(PYI_CHILD_EVENT_LOOP_KQUEUE)
+    if (_pyi_child_event_loop_init(&event_loop, pyi_ctx, child_pid, &forwarded_signals, num_signals) == 0) {
+        PYI_DEBUG("LOADER: waiting for child process using event loop; received signals are %s.\n", pyi_ctx->ignore_signals ? "ignored" : "forwarded to child");
+        use_event_loop = true;
+    }
+#endif
+
+    if (!use_event_loop) {
+        /* Install signal handlers to either forward received signals to the
+         * child process, or ignore them (effectively blocking them). */
+        if (pyi_ctx->ignore_signals) {
+            PYI_DEBUG("LOADER: registering signal handlers to ignore received signals.\n");
+            signal_handler = &_ignoring_signal_handler;
+        } else {
+            PYI_DEBUG("LOADER: registering signal handlers to forward received signals to child.\n");
+            signal_handler = &_signal_handler;
+        }
+
+        for (signum = 0; signum < num_signals; ++signum) {
+            if (signum == SIGCHLD || signum == SIGCLD || signum == SIGTSTP) {
+                continue;
+            }
+            signal(signum, signal_handler);
+        }
+    }
+
+    /* Unblock signals (if blocked for posix_spawnp()); this delivers the
+     * signals that were received in the meantime. With signalfd-based
+     * event loop, the forwarded signals must remain blocked, so that they
+     * are received via signalfd. */
+#if defined(PYI_CHILD_EVENT_LOOP_PIDFD)
+    if (use_event_loop) {
+        if (signals_blocked) {
+            sigset_t waiting_signal_mask = original_signal_mask;
+            for (signum = 1; signum < num_signals; ++signum) {
+                if (sigismember(&forwarded_signals, signum) == 1) {
+                    sigaddset(&waiting_signal_mask, signum);
+                }
+            }
+            _pyi_set_signal_mask(SIG_SETMASK, &waiting_signal_mask, NULL);
+        } else {
+            _pyi_set_signal_mask(SIG_BLOCK, &forwarded_signals, &original_signal_mask);
+            signals_blocked = true;
+        }
+    } else
+#endif
+    if (signals_blocked) {
+        _pyi_set_signal_mask(SIG_SETMASK, &original_signal_mask, NULL);
+        signals_blocked = false;
     }
 
     /* Signal the sync semaphore */
@@ -755,13 +1634,30 @@ pyi_utils_create_child(struct PYI_CONTEXT *pyi_ctx)
     /* Uninstall event handlers */
     pyi_apple_uninstall_event_handlers(&pyi_ctx->ae_ctx);
 #else
-    wait_rc = waitpid(child_pid, &rc, 0);
+#if defined(PYI_CHILD_EVENT_LOOP_PIDFD) || defined(PYI_CHILD_EVENT_LOOP_KQUEUE)
+    if (use_event_loop) {
+        wait_rc = _pyi_child_event_loop_run(&event_loop, pyi_ctx, child_pid, &rc);
+    } else
+#endif
+    {
+        wait_rc = waitpid(child_pid, &rc, 0);
+    }
 #endif
 
     /* Reset stored child PID - this aims to immediately turn forwarding
      * signal handler into no-op (due to `pyi_ctx->child_pid != 0` check). */
      pyi_ctx->child_pid = 0;
 
+#if defined(PYI_CHILD_EVENT_LOOP_PIDFD) || defined(PYI_CHILD_EVENT_LOOP_KQUEUE)
+    if (use_event_loop) {
+        _pyi_child_event_loop_cleanup(&event_loop, pyi_ctx);
+    }
+#endif
+    if (signals_blocked) {
+        _pyi_set_signal_mask(SIG_SETMASK, &original_signal_mask, NULL);
+        signals_blocked = false;
+    }
+
     if (wait_rc < 0) {
         PYI_WARNING("LOADER: failed to wait for child process: %s\n", strerror(errno));
     }
@@ -786,6 +1682,10 @@ pyi_utils_create_child(struct PYI_CONTEXT *pyi_ctx)
 #endif
 
 cleanup:
+    if (signals_blocked) {
+        _pyi_set_signal_mask(SIG_SETMASK, &original_signal_mask, NULL);
+    }
+
     /* Destroy the sync semaphore (if available) */
 #if defined(PYI_USE_POSIX_SEMAPHORE)
     if (sem_ptr != MAP_FAILED) {
@@ -33,47 +33,83 @@
 
 /* PyInstaller headers. */
 #include "pyi_utils.h"
+#include "pyi_arena.h"
 #include "pyi_path.h"
 #include "pyi_main.h"
+#include "pyi_thread.h"
 
 
 /**********************************************************************\
  *                  Environment variable management                   *
 \**********************************************************************/
-char *
-pyi_getenv(const char *variable)
+/* Retrieve the value of environment variable into the given buffer
+ * (of PYI_PATH_MAX characters), with environment variables within
+ * the value expanded. Returns -1 if the variable is unavailable. */
+static int
+_pyi_getenv_expanded(const char *variable, wchar_t *expanded_value)
 {
-    wchar_t *variable_w;
+    wchar_t variable_w[PYI_PATH_MAX];
     wchar_t value[PYI_PATH_MAX];
-    wchar_t expanded_value[PYI_PATH_MAX];
     DWORD rc;
 
     /* Convert the variable name from UTF-8 to wide-char */
-    variable_w = pyi_win32_utf8_to_wcs(variable, NULL, 0);
+    if (pyi_win32_utf8_to_wcs(variable, variable_w, PYI_PATH_MAX) == NULL) {
+        return -1;
+    }
 
     /* Retrieve environment variable */
     rc = GetEnvironmentVariableW(variable_w, value, PYI_PATH_MAX);
     if (rc >= PYI_PATH_MAX) {
-        return NULL; /* Insufficient buffer size */
+        return -1; /* Insufficient buffer size */
     }
     if (rc == 0) {
-        return NULL; /* Variable unavailable */
+        return -1; /* Variable unavailable */
     }
 
     /* Expand environment variables within the environment variable's
      * value */
     rc = ExpandEnvironmentStringsW(value, expanded_value, PYI_PATH_MAX);
     if (rc >= PYI_PATH_MAX) {
-        return NULL; /* Insufficient buffer size */
+        return -1; /* Insufficient buffer size */
     }
     if (rc == 0) {
-        return NULL; /* Error during expansion */
+        return -1; /* Error during expansion */
+    }
+
+    return 0;
+}
+
+char *
+pyi_getenv(const char *variable)
+{
+    wchar_t expanded_value[PYI_PATH_MAX];
+
+    if (_pyi_getenv_expanded(variable, expanded_value) < 0) {
+        return NULL;
     }
 
     /* Convert to UTF-8 and return */
     return pyi_win32_wcs_to_utf8(expanded_value, NULL, 0);
 }
 
+/* Same as pyi_getenv(), except that the copy is allocated from the
+ * given arena. */
+char *
+pyi_arena_getenv(struct PYI_ARENA *arena, const char *variable)
+{
+    wchar_t expanded_value[PYI_PATH_MAX];
+    char value[PYI_PATH_MAX * 3]; /* Up to three UTF-8 bytes per UTF-16 code unit */
+
+    if (_pyi_getenv_expanded(variable, expanded_value) < 0) {
+        return NULL;
+    }
+
+    if (pyi_win32_wcs_to_utf8(expanded_value, value, sizeof(value)) == NULL) {
+        return NULL;
+    }
+    return pyi_arena_strdup(arena, value);
+}
+
 int
 pyi_setenv(const char *variable, const char *value)
 {
@@ -286,6 +322,8 @@ pyi_create_temporary_application_directory(struct PYI_CONTEXT *pyi_ctx)
             free(application_home_dir_w);
             ret = -1; /* In case we reached max. retries */
         } else {
+            pyi_stats_add(&pyi_ctx->stats.directories_created, 1);
+
             /* Convert path to UTF-8 and store it in main context structure */
             if (pyi_win32_wcs_to_utf8(application_home_dir_w, pyi_ctx->application_home_dir, PYI_PATH_MAX) == NULL) {
                 PYI_ERROR_W(L"LOADER: length of teporary directory path exceeds maximum path length!\n");
@@ -316,9 +354,53 @@ pyi_create_temporary_application_directory(struct PYI_CONTEXT *pyi_ctx)
 /**********************************************************************\
  *                  Recursive removal of a directory                  *
 \**********************************************************************/
-/* The actual implementation with wide-char path */
+/* Collection of sub-directories of the top-level directory, which are
+ * removed in parallel by the worker threads. */
+struct _PYI_RMDIR_SUBDIRS
+{
+    wchar_t **paths;
+    size_t count;
+    size_t capacity;
+
+    /* Mutex protecting the `next` field */
+    pyi_mutex_t mutex;
+    size_t next;
+};
+
+/*
+ * Add a copy of sub-directory path to the collection. Returns 0 on
+ * success, -1 on failure (in which case the caller should remove the
+ * directory itself).
+ */
+static int
+_pyi_rmdir_subdirs_add(struct _PYI_RMDIR_SUBDIRS *subdirs, const wchar_t *path)
+{
+    wchar_t *path_copy;
+
+    if (subdirs->count == subdirs->capacity) {
+        size_t new_capacity = subdirs->capacity ? 2 * subdirs->capacity : 16;
+        wchar_t **new_paths = (wchar_t **)realloc(subdirs->paths, new_capacity * sizeof(wchar_t *));
+        if (new_paths == NULL) {
+            return -1;
+        }
+        subdirs->paths = new_paths;
+        subdirs->capacity = new_capacity;
+    }
+
+    path_copy = _wcsdup(path);
+    if (path_copy == NULL) {
+        return -1;
+    }
+    subdirs->paths[subdirs->count++] = path_copy;
+
+    return 0;
+}
+
+/* The actual implementation with wide-char path. If `subdirs` is not
+ * NULL, the sub-directories are collected into it instead of being
+ * removed, and the directory itself is not removed, either. */
 static int
-_pyi_recursive_rmdir(const wchar_t *dir_path)
+_pyi_recursive_rmdir(const wchar_t *dir_path, struct _PYI_RMDIR_SUBDIRS *subdirs)
 {
     int dir_path_length;
     int buffer_size;
@@ -327,7 +409,7 @@ _pyi_recursive_rmdir(const wchar_t *dir_path)
     WIN32_FIND_DATAW entry_info;
 
     /* Copy the directory path, and append separator and a wildcard for
-     * the `FindFirstFileW()` call. Store the length of the directory
+     * the `FindFirstFileExW()` call. Store the length of the directory
      * path plus the separator; this allows us to re-use the same buffer
      * for constructing entries' full paths, by overwriting only the
      * part of the string that follows the path separator that we added. */
@@ -338,8 +420,13 @@ _pyi_recursive_rmdir(const wchar_t *dir_path)
     dir_path_length--; /* Ignore the wildcard at the end */
     buffer_size = PYI_PATH_MAX - dir_path_length; /* Remaining buffer size */
 
-    /* Start the search by looking for first entry */
-    handle = FindFirstFileW(entry_path, &entry_info);
+    /* Start the search by looking for first entry. The entry attributes
+     * returned by the search are sufficient to determine entry type, so
+     * no additional query is needed per entry. Do not query the 8.3 short
+     * names (FindExInfoBasic), and request larger buffer for directory
+     * queries (FIND_FIRST_EX_LARGE_FETCH), to reduce the number of round
+     * trips to the file system. */
+    handle = FindFirstFileExW(entry_path, FindExInfoBasic, &entry_info, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
     if (handle == INVALID_HANDLE_VALUE) {
         return -1;
     }
@@ -380,10 +467,12 @@ _pyi_recursive_rmdir(const wchar_t *dir_path)
                 if (RemoveDirectoryW(entry_path) == 0) {
                     PYI_DEBUG_W(L"LOADER: failed to remove directory symbolic link: %ls\n", entry_path);
                 }
+            } else if (subdirs && _pyi_rmdir_subdirs_add(subdirs, entry_path) == 0) {
+                /* Removed later, by the worker threads */
             } else {
                 /* Recurse into directory; return value is 0 on success,
                  * -1 on failure. */
-                if (_pyi_recursive_rmdir(entry_path) < 0) {
+                if (_pyi_recursive_rmdir(entry_path, NULL) < 0) {
                     PYI_DEBUG_W(L"LOADER: failed to remove directory: %ls\n", entry_path);
                 }
             }
@@ -398,18 +487,97 @@ _pyi_recursive_rmdir(const wchar_t *dir_path)
 
     FindClose(handle);
 
+    if (subdirs) {
+        return 0;
+    }
+
     /* Finally, remove the directory */
     return RemoveDirectoryW(dir_path) != 1 ? -1 : 0; /* false/true-> -1/0 */
 }
 
+/*
+ * Remove the collected sub-directories, until there are none left.
+ * Run by the worker threads as well as the calling thread.
+ */
+static PYI_THREAD_PROC_TYPE
+_pyi_rmdir_worker(void *arg)
+{
+    struct _PYI_RMDIR_SUBDIRS *subdirs = (struct _PYI_RMDIR_SUBDIRS *)arg;
+    size_t index;
+
+    while (1) {
+        pyi_mutex_lock(&subdirs->mutex);
+        index = subdirs->next++;
+        pyi_mutex_unlock(&subdirs->mutex);
+        if (index >= subdirs->count) {
+            break;
+        }
+
+        if (_pyi_recursive_rmdir(subdirs->paths[index], NULL) < 0) {
+            PYI_DEBUG_W(L"LOADER: failed to remove directory: %ls\n", subdirs->paths[index]);
+        }
+    }
+
+    PYI_THREAD_PROC_RETURN;
+}
+
 
 /* For now, the caller is supplying narrow-char path in  UTF-8 encoding. */
 int
 pyi_recursive_rmdir(const char *dir_path)
 {
     wchar_t dir_path_w[PYI_PATH_MAX];
+    struct _PYI_RMDIR_SUBDIRS subdirs;
+    pyi_thread_t threads[PYI_RMDIR_MAX_THREADS];
+    int num_threads = 0;
+    int max_threads;
+    size_t index;
+
     pyi_win32_utf8_to_wcs(dir_path, dir_path_w, PYI_PATH_MAX);
-    return _pyi_recursive_rmdir(dir_path_w);
+
+    memset(&subdirs, 0, sizeof(subdirs));
+    pyi_mutex_init(&subdirs.mutex);
+
+    /* Remove the files in the top-level directory, and collect its
+     * sub-directories. */
+    if (_pyi_recursive_rmdir(dir_path_w, &subdirs) < 0) {
+        pyi_mutex_destroy(&subdirs.mutex);
+        return -1;
+    }
+
+    /* Remove the sibling sub-directory trees in parallel, using a small
+     * pool of worker threads; the calling thread participates as well.
+     * If threads cannot be started, the calling thread removes all of
+     * them by itself. */
+    if (subdirs.count > 1) {
+        max_threads = pyi_thread_get_cpu_count() - 1;
+        if (max_threads > PYI_RMDIR_MAX_THREADS) {
+            max_threads = PYI_RMDIR_MAX_THREADS;
+        }
+        if ((size_t)max_threads > subdirs.count - 1) {
+            max_threads = (int)(subdirs.count - 1);
+        }
+        for (num_threads = 0; num_threads < max_threads; num_threads++) {
+            if (pyi_thread_create(&threads[num_threads], _pyi_rmdir_worker, &subdirs) < 0) {
+                break;
+            }
+        }
+    }
+
+    _pyi_rmdir_worker(&subdirs);
+
+    for (index = 0; index < (size_t)num_threads; index++) {
+        pyi_thread_join(threads[index]);
+    }
+    pyi_mutex_destroy(&subdirs.mutex);
+
+    for (index = 0; index < subdirs.count; index++) {
+        free(subdirs.paths[index]);
+    }
+    free(subdirs.paths);
+
+    /* Finally, remove the directory */
+    return RemoveDirectoryW(dir_path_w) != 1 ? -1 : 0; /* false/true-> -1/0 */
 }
 
 
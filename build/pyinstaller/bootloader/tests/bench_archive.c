@@ -0,0 +1,361 @@
+// -----------------------------------------------------------------------------
+// Copyright (c) 2023, PyInstaller Development Team.
+//
+// Distributed under the terms of the GNU General Public License (version 2
+// or later) with exception for distributing the bootloader.
+//
+// The full license is in the file COPYING.txt, distributed with this software.
+//
+// SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+// -----------------------------------------------------------------------------
+
+// Micro-benchmarks of the archive-related hot paths of the bootloader.
+//
+// The program times the archive functions on the given executable with
+// embedded PKG archive; the `bench` command of waf generates a synthetic
+// one with configurable size and number of entries (see `--bench-*`
+// options). The results are written to stdout as JSON lines, one per
+// benchmark, e.g.:
+//
+//   {"benchmark": "archive_extract_zlib", "iterations": 1000, "ns_per_op": 15234.1, "mb_per_s": 4301.2}
+//
+// Usage: bench_archive [-i iterations] filename
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+    #include <sys/time.h>
+    #include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pyi_global.h"
+#include "pyi_archive.h"
+#include "pyi_utils.h"
+
+#define BENCH_DEFAULT_ITERATIONS 10
+
+struct bench_options
+{
+    unsigned long iterations;
+    const char *filename;
+};
+
+static uint64_t
+bench_get_time_ns(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000 +
+        (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000000 + (uint64_t)tv.tv_usec * 1000;
+#endif
+}
+
+// Report the result of a benchmark; `num_bytes` is the number of bytes
+// processed by all operations (0 if throughput is not meaningful).
+static void
+bench_report(const char *name, uint64_t num_ops, uint64_t num_bytes, uint64_t elapsed_ns)
+{
+    double ns_per_op = num_ops ? (double)elapsed_ns / (double)num_ops : 0.0;
+
+    printf("{\"benchmark\": \"%s\", \"iterations\": %" PRIu64 ", \"ns_per_op\": %.1f", name, num_ops, ns_per_op);
+    if (num_bytes) {
+        double mb_per_s = elapsed_ns ? ((double)num_bytes / (1024.0 * 1024.0)) / ((double)elapsed_ns / 1e9) : 0.0;
+        printf(", \"mb_per_s\": %.1f", mb_per_s);
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+/*
+ * Benchmarks
+ */
+
+static int
+bench_archive_open(const struct bench_options *options)
+{
+    uint64_t start, elapsed;
+    unsigned long i;
+
+    start = bench_get_time_ns();
+    for (i = 0; i < options->iterations; i++) {
+        struct ARCHIVE *archive = pyi_archive_open(options->filename);
+        if (archive == NULL) {
+            fprintf(stderr, "Failed to open archive!\n");
+            return -1;
+        }
+        pyi_archive_free(&archive);
+    }
+    elapsed = bench_get_time_ns() - start;
+
+    bench_report("archive_open", options->iterations, 0, elapsed);
+    return 0;
+}
+
+static int
+bench_find_magic_pattern(const struct bench_options *options)
+{
+    unsigned char magic[8];
+    uint64_t start, elapsed;
+    unsigned long i;
+    FILE *fp;
+
+    memcpy(magic, MAGIC_BASE, sizeof(magic));
+    magic[3] += 0x0C; /* 0x00 -> 0x0C */
+
+    fp = fopen(options->filename, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open %s!\n", options->filename);
+        return -1;
+    }
+
+    start = bench_get_time_ns();
+    for (i = 0; i < options->iterations; i++) {
+        if (pyi_utils_find_magic_pattern(fp, magic, sizeof(magic)) == 0) {
+            fprintf(stderr, "Failed to find the cookie!\n");
+            fclose(fp);
+            return -1;
+        }
+    }
+    elapsed = bench_get_time_ns() - start;
+    fclose(fp);
+
+    bench_report("find_magic_pattern", options->iterations, 0, elapsed);
+    return 0;
+}
+
+// Full scan of the file for a pattern that is not present; this is the
+// worst case of the cookie search (for example, in an executable that
+// contains no archive).
+static int
+bench_find_magic_pattern_full_scan(const struct bench_options *options, uint64_t file_size)
+{
+    unsigned char magic[8];
+    uint64_t start, elapsed;
+    unsigned long i;
+    FILE *fp;
+
+    memcpy(magic, MAGIC_BASE, sizeof(magic));
+    magic[3] += 0x0E; /* 0x00 -> 0x0E; not used by any of our patterns */
+
+    fp = fopen(options->filename, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open %s!\n", options->filename);
+        return -1;
+    }
+
+    start = bench_get_time_ns();
+    for (i = 0; i < options->iterations; i++) {
+        if (pyi_utils_find_magic_pattern(fp, magic, sizeof(magic)) != 0) {
+            fprintf(stderr, "Unexpectedly found the pattern!\n");
+            fclose(fp);
+            return -1;
+        }
+    }
+    elapsed = bench_get_time_ns() - start;
+    fclose(fp);
+
+    bench_report("find_magic_pattern_full_scan", options->iterations, file_size * options->iterations, elapsed);
+    return 0;
+}
+
+static int
+bench_find_entry_by_name(const struct bench_options *options, const struct ARCHIVE *archive)
+{
+    const struct TOC_ENTRY *toc_entry;
+    uint64_t num_ops = 0;
+    uint64_t start, elapsed;
+    unsigned long i;
+
+    start = bench_get_time_ns();
+    for (i = 0; i < options->iterations; i++) {
+        for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
+            const char *name = pyi_archive_get_entry_name(toc_entry);
+            if (pyi_archive_find_entry_by_name(archive, name) == NULL) {
+                fprintf(stderr, "Failed to find entry %s!\n", name);
+                return -1;
+            }
+            num_ops++;
+        }
+    }
+    elapsed = bench_get_time_ns() - start;
+
+    bench_report("find_entry_by_name", num_ops, 0, elapsed);
+    return 0;
+}
+
+// Benchmark extraction of all entries with given compression method,
+// either into memory or onto filesystem. If `use_session` is set, all
+// entries are extracted within a single extraction session.
+static int
+bench_extract(const struct bench_options *options, const struct ARCHIVE *archive, unsigned char compression_flag, bool to_fs, bool use_session)
+{
+    struct ARCHIVE_SESSION *session = NULL;
+    char output_filename[PYI_PATH_MAX];
+    const char *name;
+    uint64_t num_ops = 0;
+    uint64_t num_bytes = 0;
+    uint64_t start, elapsed;
+    const struct TOC_ENTRY *toc_entry;
+    unsigned long i;
+
+    if (snprintf(output_filename, PYI_PATH_MAX, "%s.extracted", options->filename) >= PYI_PATH_MAX) {
+        fprintf(stderr, "Output file name is too long!\n");
+        return -1;
+    }
+
+    start = bench_get_time_ns();
+    if (use_session) {
+        session = pyi_archive_session_new(0);
+        if (session == NULL) {
+            fprintf(stderr, "Failed to create extraction session!\n");
+            return -1;
+        }
+    }
+    for (i = 0; i < options->iterations; i++) {
+        for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
+            if (toc_entry->compression_flag != compression_flag) {
+                continue;
+            }
+            if (to_fs) {
+                int rc = session ? pyi_archive_session_extract2fs(session, archive, toc_entry, output_filename) : pyi_archive_extract2fs(archive, toc_entry, output_filename);
+                if (rc < 0) {
+                    fprintf(stderr, "Failed to extract entry!\n");
+                    pyi_archive_session_free(&session);
+                    return -1;
+                }
+            } else {
+                unsigned char *buffer = session ? pyi_archive_session_extract(session, archive, toc_entry) : pyi_archive_extract(archive, toc_entry);
+                if (buffer == NULL) {
+                    fprintf(stderr, "Failed to extract entry!\n");
+                    pyi_archive_session_free(&session);
+                    return -1;
+                }
+                free(buffer);
+            }
+            num_ops++;
+            num_bytes += toc_entry->uncompressed_length;
+        }
+    }
+    pyi_archive_session_free(&session);
+    elapsed = bench_get_time_ns() - start;
+    remove(output_filename);
+
+    if (compression_flag == ARCHIVE_COMPRESSION_ZLIB) {
+        if (use_session) {
+            name = to_fs ? "archive_session_extract2fs_zlib" : "archive_session_extract_zlib";
+        } else {
+            name = to_fs ? "archive_extract2fs_zlib" : "archive_extract_zlib";
+        }
+    } else {
+        if (use_session) {
+            name = to_fs ? "archive_session_extract2fs_uncompressed" : "archive_session_extract_uncompressed";
+        } else {
+            name = to_fs ? "archive_extract2fs_uncompressed" : "archive_extract_uncompressed";
+        }
+    }
+    bench_report(name, num_ops, num_bytes, elapsed);
+    return 0;
+}
+
+static int
+bench_parse_options(int argc, char **argv, struct bench_options *options)
+{
+    int i;
+
+    options->iterations = BENCH_DEFAULT_ITERATIONS;
+    options->filename = NULL;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            char *end;
+            options->iterations = strtoul(argv[++i], &end, 10);
+            if (*end != 0 || options->iterations == 0) {
+                return -1;
+            }
+        } else if (options->filename == NULL) {
+            options->filename = argv[i];
+        } else {
+            return -1;
+        }
+    }
+
+    return options->filename ? 0 : -1;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct bench_options options;
+    struct ARCHIVE *archive = NULL;
+    const struct TOC_ENTRY *toc_entry;
+    unsigned long num_entries = 0;
+    uint64_t file_size;
+    FILE *fp;
+    int rc = 1;
+
+    if (bench_parse_options(argc, argv, &options) < 0) {
+        fprintf(stderr, "Usage: %s [-i iterations] filename\n", argv[0]);
+        return 2;
+    }
+
+    fp = fopen(options.filename, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open %s!\n", options.filename);
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    file_size = (uint64_t)ftell(fp);
+    fclose(fp);
+
+    archive = pyi_archive_open(options.filename);
+    if (archive == NULL) {
+        fprintf(stderr, "Failed to open archive!\n");
+        return 1;
+    }
+    for (toc_entry = archive->toc; toc_entry < archive->toc_end; toc_entry = pyi_archive_next_toc_entry(archive, toc_entry)) {
+        num_entries++;
+    }
+
+    printf(
+        "{\"config\": {\"file_size\": %" PRIu64 ", \"entries\": %lu, \"format_version\": %d, \"mapped\": %s, \"iterations\": %lu}}\n",
+        file_size,
+        num_entries,
+        archive->format_version,
+        archive->pkg_data ? "true" : "false",
+        options.iterations
+    );
+
+    if (bench_archive_open(&options) < 0 ||
+        bench_find_magic_pattern(&options) < 0 ||
+        bench_find_magic_pattern_full_scan(&options, file_size) < 0 ||
+        bench_find_entry_by_name(&options, archive) < 0 ||
+        bench_extract(&options, archive, ARCHIVE_COMPRESSION_NONE, false, false) < 0 ||
+        bench_extract(&options, archive, ARCHIVE_COMPRESSION_ZLIB, false, false) < 0 ||
+        bench_extract(&options, archive, ARCHIVE_COMPRESSION_NONE, true, false) < 0 ||
+        bench_extract(&options, archive, ARCHIVE_COMPRESSION_ZLIB, true, false) < 0 ||
+        bench_extract(&options, archive, ARCHIVE_COMPRESSION_ZLIB, false, true) < 0 ||
+        bench_extract(&options, archive, ARCHIVE_COMPRESSION_NONE, true, true) < 0 ||
+        bench_extract(&options, archive, ARCHIVE_COMPRESSION_ZLIB, true, true) < 0) {
+        goto cleanup;
+    }
+
+    rc = 0;
+
+cleanup:
+    pyi_archive_free(&archive);
+    return rc;
+}
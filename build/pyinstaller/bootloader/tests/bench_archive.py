@@ -0,0 +1,70 @@
+# -----------------------------------------------------------------------------
+# Copyright (c) 2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+# -----------------------------------------------------------------------------
+"""
+Generate synthetic executable for the `bench_archive` benchmark program: a stub of pseudo-random bytes that emulates the
+bootloader executable, followed by PKG archive that is written by PyInstaller's CArchiveWriter. Every other entry in the
+archive is compressed.
+"""
+
+import argparse
+import os
+import random
+import shutil
+import sys
+import tempfile
+
+# Use the PyInstaller from this source tree.
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..'))
+
+from PyInstaller.archive.writers import CArchiveWriter  # noqa: E402
+
+# Text-like data drawn from a small vocabulary compresses reasonably well, similar to python bytecode.
+_WORDS = [b'import ', b'def ', b'return ', b'self', b'.', b'(', b')', b':', b'\n    ', b'None', b'value', b'=']
+
+
+def generate(filename, num_entries, entry_size, stub_size, format_version):
+    rng = random.Random(0)  # Deterministic content, so that runs are comparable.
+
+    # Entries' data are slices of a common pool, taken at random positions.
+    pool = b''.join(rng.choice(_WORDS) for _ in range((2 * entry_size + 1024 * 1024) // 4))
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        entries = []
+        for idx in range(num_entries):
+            start = rng.randrange(len(pool) - entry_size)
+            src_name = os.path.join(tmpdir, f'entry{idx:06d}.bin')
+            with open(src_name, 'wb') as fp:
+                fp.write(pool[start:start + entry_size])
+            entries.append((f'data/entry{idx:06d}.bin', src_name, idx % 2 == 1, 'x'))
+
+        pkg_filename = os.path.join(tmpdir, 'archive.pkg')
+        CArchiveWriter(pkg_filename, entries, 'libpython3.so', format_version=format_version)
+
+        with open(filename, 'wb') as fp:
+            fp.write(rng.getrandbits(8 * stub_size).to_bytes(stub_size, 'little') if stub_size else b'')
+            with open(pkg_filename, 'rb') as pkg_fp:
+                shutil.copyfileobj(pkg_fp, fp)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--entries', type=int, default=1000, help='Number of entries in the archive.')
+    parser.add_argument('--entry-size', type=int, default=64 * 1024, help='Size of (uncompressed) entries, in bytes.')
+    parser.add_argument('--stub-size', type=int, default=1024 * 1024, help='Size of the executable stub, in bytes.')
+    parser.add_argument('--format-version', type=int, default=1, choices=(1, 2), help='Archive format version.')
+    parser.add_argument('filename', help='Name of the generated file.')
+    args = parser.parse_args()
+
+    generate(args.filename, args.entries, args.entry_size, args.stub_size, args.format_version)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,495 @@
+// -----------------------------------------------------------------------------
+// Copyright (c) 2023, PyInstaller Development Team.
+//
+// Distributed under the terms of the GNU General Public License (version 2
+// or later) with exception for distributing the bootloader.
+//
+// The full license is in the file COPYING.txt, distributed with this software.
+//
+// SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+// -----------------------------------------------------------------------------
+
+#include <sys/types.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "zlib.h"
+
+#include "pyi_global.h"
+#include "pyi_archive.h"
+#include "pyi_thread.h"
+#include "pyi_utils.h"
+
+#include <setjmp.h> // required fo cmocka :-(
+#include <cmocka.h>
+
+// The tests write a synthetic (format version 1) archive with a mix of
+// compressed and uncompressed entries, preceded by a few bytes that
+// stand in for the executable, and then read it from several threads
+// at once, with the archive structure shared by all of them. The
+// archive also contains a few framed entries, and a large framed entry
+// whose frames are decompressed by multiple threads.
+
+#define TEST_NUM_ENTRIES 48
+#define TEST_FRAME_SIZE 4096
+#define TEST_LARGE_LENGTH (6 * 1024 * 1024 + 123)
+#define TEST_LARGE_FRAME_SIZE (64 * 1024)
+#define TEST_NUM_THREADS 8
+#define TEST_NUM_ITERATIONS 16
+#define TEST_PREFIX_LENGTH 1000
+
+struct test_entry
+{
+    unsigned char *data;
+    unsigned char *blob;  // data as stored in the archive
+    size_t data_length;
+    size_t blob_length;
+    size_t offset;
+    unsigned char compression_flag;
+};
+
+static char test_filename[64];
+// The last entry is the large framed entry
+static struct test_entry test_entries[TEST_NUM_ENTRIES + 1];
+
+static void write_be32(unsigned char *buffer, uint32_t value)
+{
+    buffer[0] = (unsigned char)(value >> 24);
+    buffer[1] = (unsigned char)(value >> 16);
+    buffer[2] = (unsigned char)(value >> 8);
+    buffer[3] = (unsigned char)value;
+}
+
+static void write_le(unsigned char *buffer, uint64_t value, int length)
+{
+    int i;
+    for (i = 0; i < length; i++) {
+        buffer[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+// Encode the data as zlib stream with stored (uncompressed) deflate
+// blocks; the bundled zlib provides only the decompression functions.
+// Returns the length of the stream written into `out`, which needs to
+// provide zlib_stored_bound() bytes.
+static size_t zlib_stored_bound(size_t length)
+{
+    return 2 + 5 * (length / 65535 + 1) + length + 4;
+}
+
+static size_t zlib_store(unsigned char *out, const unsigned char *data, size_t length)
+{
+    size_t out_length = 0;
+    size_t remaining = length;
+    uLong checksum = adler32(adler32(0, Z_NULL, 0), data, (uInt)length);
+
+    out[out_length++] = 0x78;
+    out[out_length++] = 0x01;
+    do {
+        size_t block_length = remaining < 65535 ? remaining : 65535;
+        out[out_length++] = block_length == remaining ? 1 : 0;  // BFINAL, BTYPE=00
+        out[out_length++] = (unsigned char)(block_length & 0xFF);
+        out[out_length++] = (unsigned char)(block_length >> 8);
+        out[out_length++] = (unsigned char)(~block_length & 0xFF);
+        out[out_length++] = (unsigned char)((~block_length >> 8) & 0xFF);
+        memcpy(out + out_length, data, block_length);
+        out_length += block_length;
+        data += block_length;
+        remaining -= block_length;
+    } while (remaining > 0);
+    write_be32(out + out_length, (uint32_t)checksum);
+
+    return out_length + 4;
+}
+
+// Encode the data as framed blob: the frame header and the frame index,
+// followed by frames, each of which is a zlib stream (see above) that
+// holds `frame_size` bytes of data.
+static size_t framed_bound(size_t length, size_t frame_size)
+{
+    size_t num_frames = (length + frame_size - 1) / frame_size;
+    return sizeof(struct ARCHIVE_FRAME_HEADER) + 8 * (num_frames + 1) + num_frames * zlib_stored_bound(frame_size);
+}
+
+static size_t framed_store(unsigned char *out, const unsigned char *data, size_t length, size_t frame_size)
+{
+    size_t num_frames = (length + frame_size - 1) / frame_size;
+    size_t out_length = sizeof(struct ARCHIVE_FRAME_HEADER) + 8 * (num_frames + 1);
+    size_t i;
+
+    memset(out, 0, sizeof(struct ARCHIVE_FRAME_HEADER));
+    write_le(out, frame_size, 4);
+    write_le(out + 4, num_frames, 4);
+    out[8] = ARCHIVE_COMPRESSION_ZLIB;
+
+    for (i = 0; i < num_frames; i++) {
+        size_t frame_length = (i == num_frames - 1) ? length - i * frame_size : frame_size;
+        write_le(out + sizeof(struct ARCHIVE_FRAME_HEADER) + 8 * i, out_length, 8);
+        out_length += zlib_store(out + out_length, data + i * frame_size, frame_length);
+    }
+    write_le(out + sizeof(struct ARCHIVE_FRAME_HEADER) + 8 * num_frames, out_length, 8);
+
+    return out_length;
+}
+
+// Deterministic pseudo-random generator (xorshift), so that the test
+// data is the same on every run.
+static uint32_t next_random(uint32_t *seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+static int setup_archive(void **state)
+{
+    unsigned char toc[(TEST_NUM_ENTRIES + 1) * 64];
+    unsigned char cookie[88];
+    size_t toc_length = 0;
+    size_t pkg_length = 0;
+    uint32_t seed = 0x12345678;
+    FILE *fp;
+    int i;
+
+    snprintf(test_filename, sizeof(test_filename), "test_archive_%lu.pkg", (unsigned long)time(NULL));
+
+    fp = fopen(test_filename, "wb");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    // Stand-in for the executable; the archive does not start at the
+    // beginning of the file, nor at page boundary
+    for (i = 0; i < TEST_PREFIX_LENGTH; i++) {
+        fputc('E', fp);
+    }
+
+    // Data blobs; sizes range from a few bytes to a few times the
+    // size of the session buffers. Every other entry is stored as zlib
+    // stream, and every fourth one as framed blob.
+    for (i = 0; i <= TEST_NUM_ENTRIES; i++) {
+        struct test_entry *entry = &test_entries[i];
+        size_t j;
+
+        if (i == TEST_NUM_ENTRIES) {
+            entry->data_length = TEST_LARGE_LENGTH;
+            entry->compression_flag = ARCHIVE_COMPRESSION_FRAMED;
+        } else {
+            entry->data_length = 1 + next_random(&seed) % (3 * PYI_ARCHIVE_SESSION_DEFAULT_BUFFER_SIZE);
+            entry->compression_flag = (i % 4 == 3) ? ARCHIVE_COMPRESSION_FRAMED : (i % 2) ? ARCHIVE_COMPRESSION_ZLIB : ARCHIVE_COMPRESSION_NONE;
+        }
+        entry->data = malloc(entry->data_length);
+        for (j = 0; j < entry->data_length; j++) {
+            entry->data[j] = (unsigned char)next_random(&seed);
+        }
+
+        if (entry->compression_flag == ARCHIVE_COMPRESSION_FRAMED) {
+            size_t frame_size = (i == TEST_NUM_ENTRIES) ? TEST_LARGE_FRAME_SIZE : TEST_FRAME_SIZE;
+            entry->blob = malloc(framed_bound(entry->data_length, frame_size));
+            entry->blob_length = framed_store(entry->blob, entry->data, entry->data_length, frame_size);
+        } else if (entry->compression_flag == ARCHIVE_COMPRESSION_ZLIB) {
+            entry->blob = malloc(zlib_stored_bound(entry->data_length));
+            entry->blob_length = zlib_store(entry->blob, entry->data, entry->data_length);
+        } else {
+            entry->blob = entry->data;
+            entry->blob_length = entry->data_length;
+        }
+
+        entry->offset = pkg_length;
+        fwrite(entry->blob, 1, entry->blob_length, fp);
+        pkg_length += entry->blob_length;
+
+        // TOC entry: header, followed by the name, padded to multiple of 16
+        {
+            unsigned char *raw_entry = toc + toc_length;
+            size_t entry_length = 18 + 16;
+            memset(raw_entry, 0, entry_length);
+            write_be32(raw_entry, (uint32_t)entry_length);
+            write_be32(raw_entry + 4, (uint32_t)entry->offset);
+            write_be32(raw_entry + 8, (uint32_t)entry->blob_length);
+            write_be32(raw_entry + 12, (uint32_t)entry->data_length);
+            raw_entry[16] = entry->compression_flag;
+            raw_entry[17] = ARCHIVE_ITEM_DATA;
+            if (i == TEST_NUM_ENTRIES) {
+                snprintf((char *)raw_entry + 18, 16, "large");
+            } else {
+                snprintf((char *)raw_entry + 18, 16, "entry%03d", i);
+            }
+            toc_length += entry_length;
+        }
+    }
+
+    // TOC and cookie
+    fwrite(toc, 1, toc_length, fp);
+
+    memset(cookie, 0, sizeof(cookie));
+    memcpy(cookie, MAGIC_BASE, 8);
+    cookie[3] += 0x0C;
+    write_be32(cookie + 8, (uint32_t)(pkg_length + toc_length + sizeof(cookie)));
+    write_be32(cookie + 12, (uint32_t)pkg_length);
+    write_be32(cookie + 16, (uint32_t)toc_length);
+    write_be32(cookie + 20, 311);
+    snprintf((char *)cookie + 24, 64, "%s", "libpython3.11.so");
+    fwrite(cookie, 1, sizeof(cookie), fp);
+
+    fclose(fp);
+    return 0;
+}
+
+static int teardown_archive(void **state)
+{
+    int i;
+
+    for (i = 0; i <= TEST_NUM_ENTRIES; i++) {
+        if (test_entries[i].blob != test_entries[i].data) {
+            free(test_entries[i].blob);
+        }
+        free(test_entries[i].data);
+    }
+    remove(test_filename);
+    return 0;
+}
+
+struct test_thread
+{
+    const struct ARCHIVE *archive;
+    int index;
+    int num_failures;
+};
+
+// Extract all entries in a thread-specific order, and read random
+// ranges of their raw data; compare the data with the originals. The
+// failures are counted rather than asserted, as cmocka's assertions
+// are not thread-safe.
+static PYI_THREAD_PROC_TYPE test_thread_proc(void *arg)
+{
+    struct test_thread *thread = (struct test_thread *)arg;
+    struct ARCHIVE_SESSION *session;
+    unsigned char *buffer;
+    uint32_t seed = 0x9E3779B9 + (uint32_t)thread->index;
+    int iteration;
+    int i;
+
+    session = pyi_archive_session_new(0);
+    buffer = malloc(3 * PYI_ARCHIVE_SESSION_DEFAULT_BUFFER_SIZE);
+    if (session == NULL || buffer == NULL) {
+        thread->num_failures++;
+        goto cleanup;
+    }
+
+    for (iteration = 0; iteration < TEST_NUM_ITERATIONS; iteration++) {
+        for (i = 0; i < TEST_NUM_ENTRIES; i++) {
+            int index = (i * (2 * thread->index + 1) + iteration) % TEST_NUM_ENTRIES;
+            const struct test_entry *entry = &test_entries[index];
+            char name[16];
+            const struct TOC_ENTRY *toc_entry;
+            unsigned char *data;
+            size_t offset;
+            size_t length;
+
+            snprintf(name, sizeof(name), "entry%03d", index);
+            toc_entry = pyi_archive_find_entry_by_name(thread->archive, name);
+            if (toc_entry == NULL) {
+                thread->num_failures++;
+                continue;
+            }
+
+            // Whole entry
+            data = pyi_archive_session_extract(session, thread->archive, toc_entry);
+            if (data == NULL || memcmp(data, entry->data, entry->data_length) != 0) {
+                thread->num_failures++;
+            }
+            free(data);
+
+            // Range of raw data
+            offset = next_random(&seed) % entry->blob_length;
+            length = next_random(&seed) % (entry->blob_length - offset + 1);
+            if (pyi_archive_read_at(thread->archive, entry->offset + offset, buffer, length) < 0 ||
+                memcmp(buffer, entry->blob + offset, length) != 0) {
+                thread->num_failures++;
+            }
+        }
+    }
+
+cleanup:
+    free(buffer);
+    pyi_archive_session_free(&session);
+
+    PYI_THREAD_PROC_RETURN;
+}
+
+static void run_threads(const struct ARCHIVE *archive)
+{
+    pyi_thread_t threads[TEST_NUM_THREADS];
+    struct test_thread thread_args[TEST_NUM_THREADS];
+    int num_failures = 0;
+    int i;
+
+    for (i = 0; i < TEST_NUM_THREADS; i++) {
+        thread_args[i].archive = archive;
+        thread_args[i].index = i;
+        thread_args[i].num_failures = 0;
+        assert_int_equal(pyi_thread_create(&threads[i], test_thread_proc, &thread_args[i]), 0);
+    }
+    for (i = 0; i < TEST_NUM_THREADS; i++) {
+        pyi_thread_join(threads[i]);
+        num_failures += thread_args[i].num_failures;
+    }
+
+    assert_int_equal(num_failures, 0);
+}
+
+
+static void test_concurrent_mapped(void **state)
+{
+    struct ARCHIVE *archive = pyi_archive_open(test_filename);
+    assert_non_null(archive);
+
+    run_threads(archive);
+
+    pyi_archive_free(&archive);
+}
+
+
+static void test_concurrent_unmapped(void **state)
+{
+    struct ARCHIVE *archive = pyi_archive_open(test_filename);
+    assert_non_null(archive);
+    assert_non_null(archive->file);
+
+    // Hide the mapping (but keep it, so that it is released when the
+    // archive is freed), so that the data is read from the shared file
+    // handle with positional reads.
+    archive->pkg_data = NULL;
+    archive->pkg_data_length = 0;
+
+    run_threads(archive);
+
+    pyi_archive_free(&archive);
+}
+
+
+static void test_read_at_bounds(void **state)
+{
+    unsigned char buffer[16];
+    struct ARCHIVE *archive = pyi_archive_open(test_filename);
+    assert_non_null(archive);
+
+    // Reads are relative to the start of PKG archive
+    assert_int_equal(pyi_archive_read_at(archive, 0, buffer, 4), 0);
+    assert_memory_equal(buffer, test_entries[0].blob, 4);
+
+    // ... and must not extend past its end
+    assert_int_equal(pyi_archive_read_at(archive, archive->pkg_length - 4, buffer, 4), 0);
+    assert_int_equal(pyi_archive_read_at(archive, archive->pkg_length - 4, buffer, 5), -1);
+    assert_int_equal(pyi_archive_read_at(archive, archive->pkg_length + 1, buffer, 0), -1);
+
+    pyi_archive_free(&archive);
+}
+
+
+// Read random ranges of the entries' data (which, for framed entries,
+// are decompressed from the frames that cover them), and extract the
+// large framed entry as a whole.
+static void run_read_range(const struct ARCHIVE *archive)
+{
+    const struct test_entry *large = &test_entries[TEST_NUM_ENTRIES];
+    const struct TOC_ENTRY *toc_entry;
+    unsigned char *buffer;
+    unsigned char *data;
+    uint32_t seed = 0xCAFEBABE;
+    int iteration;
+    int i;
+
+    buffer = malloc(TEST_LARGE_LENGTH);
+    assert_non_null(buffer);
+
+    for (iteration = 0; iteration < 4; iteration++) {
+        for (i = 0; i <= TEST_NUM_ENTRIES; i++) {
+            const struct test_entry *entry = &test_entries[i];
+            char name[16];
+            size_t offset;
+            size_t length;
+
+            if (i == TEST_NUM_ENTRIES) {
+                snprintf(name, sizeof(name), "large");
+            } else {
+                snprintf(name, sizeof(name), "entry%03d", i);
+            }
+            toc_entry = pyi_archive_find_entry_by_name(archive, name);
+            assert_non_null(toc_entry);
+
+            offset = next_random(&seed) % entry->data_length;
+            length = next_random(&seed) % (entry->data_length - offset + 1);
+            assert_int_equal(pyi_archive_read_range(archive, toc_entry, offset, buffer, length), 0);
+            assert_memory_equal(buffer, entry->data + offset, length);
+        }
+    }
+
+    toc_entry = pyi_archive_find_entry_by_name(archive, "large");
+    assert_non_null(toc_entry);
+
+    // Range that starts and ends in the middle of a frame, and spans
+    // frames that are decompressed directly into the buffer
+    assert_int_equal(pyi_archive_read_range(archive, toc_entry, 1000, buffer, 5 * TEST_LARGE_FRAME_SIZE), 0);
+    assert_memory_equal(buffer, large->data + 1000, 5 * TEST_LARGE_FRAME_SIZE);
+
+    // Ranges must not extend past the end of data
+    assert_int_equal(pyi_archive_read_range(archive, toc_entry, TEST_LARGE_LENGTH - 10, buffer, 10), 0);
+    assert_memory_equal(buffer, large->data + TEST_LARGE_LENGTH - 10, 10);
+    assert_int_equal(pyi_archive_read_range(archive, toc_entry, TEST_LARGE_LENGTH - 10, buffer, 11), -1);
+
+    data = pyi_archive_extract(archive, toc_entry);
+    assert_non_null(data);
+    assert_memory_equal(data, large->data, TEST_LARGE_LENGTH);
+    free(data);
+
+    free(buffer);
+}
+
+
+static void test_read_range_mapped(void **state)
+{
+    struct ARCHIVE *archive = pyi_archive_open(test_filename);
+    assert_non_null(archive);
+
+    run_read_range(archive);
+
+    pyi_archive_free(&archive);
+}
+
+
+static void test_read_range_unmapped(void **state)
+{
+    struct ARCHIVE *archive = pyi_archive_open(test_filename);
+    assert_non_null(archive);
+    assert_non_null(archive->file);
+
+    archive->pkg_data = NULL;
+    archive->pkg_data_length = 0;
+
+    run_read_range(archive);
+
+    pyi_archive_free(&archive);
+}
+
+
+#if defined(_WIN32)
+int wmain(void)
+#else
+int main(void)
+#endif
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_concurrent_mapped),
+        cmocka_unit_test(test_concurrent_unmapped),
+        cmocka_unit_test(test_read_at_bounds),
+        cmocka_unit_test(test_read_range_mapped),
+        cmocka_unit_test(test_read_range_unmapped),
+    };
+    return cmocka_run_group_tests(tests, setup_archive, teardown_archive);
+}
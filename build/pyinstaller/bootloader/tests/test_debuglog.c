@@ -0,0 +1,260 @@
+// -----------------------------------------------------------------------------
+// Copyright (c) 2023, PyInstaller Development Team.
+//
+// Distributed under the terms of the GNU General Public License (version 2
+// or later) with exception for distributing the bootloader.
+//
+// The full license is in the file COPYING.txt, distributed with this software.
+//
+// SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+// -----------------------------------------------------------------------------
+
+#include <sys/types.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#ifdef _WIN32
+    #include <io.h>
+    #define dup _dup
+    #define dup2 _dup2
+    #define close _close
+#else
+    #include <unistd.h>
+#endif
+
+#include "pyi_global.h"
+#include "pyi_debuglog.h"
+#include "pyi_thread.h"
+#include "pyi_utils.h"
+
+#include <setjmp.h> // required fo cmocka :-(
+#include <cmocka.h>
+
+// The tests record debug messages into the buffered debug log, flush
+// it into a file (by temporarily redirecting stderr), and compare the
+// flushed messages with the messages formatted directly.
+
+#if defined(LAUNCH_DEBUG)
+
+#define TEST_NUM_THREADS 4
+#define TEST_NUM_MESSAGES 500
+
+static char test_filename[64];
+static const char *null_string = NULL;
+
+// Read the flushed messages, without their prefix, into a (NUL
+// separated) buffer; returns the number of messages.
+static int flush_messages(char **messages)
+{
+    size_t length = 0;
+    size_t capacity = 4096;
+    char line[8192];
+    int num_messages = 0;
+    FILE *fp;
+    int saved_fd;
+
+    fflush(stderr);
+    saved_fd = dup(2);
+    fp = fopen(test_filename, "w");
+    assert_non_null(fp);
+    dup2(fileno(fp), 2);
+    pyi_debuglog_flush();
+    fflush(stderr);
+    dup2(saved_fd, 2);
+    close(saved_fd);
+    fclose(fp);
+
+    *messages = malloc(capacity);
+    fp = fopen(test_filename, "r");
+    assert_non_null(fp);
+    while (fgets(line, sizeof(line), fp)) {
+        // [PYI-{PID}:DEBUG] [{timestamp} T{thread}] {message}
+        const char *message = strstr(line, "] ");
+        message = message ? strstr(message + 2, "] ") : NULL;
+        message = message ? message + 2 : line;
+        while (length + strlen(message) + 1 > capacity) {
+            capacity *= 2;
+            *messages = realloc(*messages, capacity);
+        }
+        strcpy(*messages + length, message);
+        length += strlen(message) + 1;
+        num_messages++;
+    }
+    fclose(fp);
+    remove(test_filename);
+
+    return num_messages;
+}
+
+static int setup_debuglog(void **state)
+{
+    snprintf(test_filename, sizeof(test_filename), "test_debuglog_%lu.txt", (unsigned long)time(NULL));
+    pyi_setenv("PYINSTALLER_DEBUG_LOG_BUFFER", "1");
+    pyi_debuglog_init();
+    return 0;
+}
+
+
+// Record the message, and format it directly into the next of the
+// expected messages. The messages must have at most
+// PYI_DEBUGLOG_MAX_ARGS arguments; otherwise, they are written out
+// right away, after the buffered messages are flushed.
+#define RECORD_MESSAGE(fmt, ...) \
+    do { \
+        snprintf(expected[num_expected++], sizeof(expected[0]), fmt, __VA_ARGS__); \
+        PYI_DEBUG(fmt, __VA_ARGS__); \
+    } while (0)
+
+static void test_formats(void **state)
+{
+    char volatile_string[32];
+    char expected[8][256];
+    int num_expected = 0;
+    char *messages;
+    char *message;
+    int i;
+
+    RECORD_MESSAGE("%d %i %u %ld %lu %lld %llu\n", -42, 7, 42u, -1234567L, 1234567UL, -123456789012LL, 123456789012ULL);
+    RECORD_MESSAGE("%zu %zd %" PRIu64 " %" PRIX64 "\n", (size_t)12345, (ptrdiff_t)-12345, (uint64_t)1 << 40, (uint64_t)0xDEADBEEF);
+    RECORD_MESSAGE("%x %#X %o %hd %hhu %+05d\n", 255, 255, 8, (short)-5, (unsigned char)200, 42);
+    RECORD_MESSAGE("%c %% %.2f %e %g %p\n", 'Z', 3.14159, 1e-10, 0.5, (void *)&num_expected);
+    RECORD_MESSAGE("%5s|%-6s|%.3s|%.*s|%*d|\n", "ab", "cd", "abcdef", 2, "xyz", 6, 42);
+    RECORD_MESSAGE("%-*.*s|%.*s|\n", 8, 2, "left", -1, "whole");
+
+    // NULL strings (which are formatted as "(null)" by glibc and MSVC)
+    PYI_DEBUG("%s|\n", null_string);
+    snprintf(expected[num_expected++], sizeof(expected[0]), "(null)|\n");
+
+    // Recorded string arguments are copied
+    strcpy(volatile_string, "before");
+    RECORD_MESSAGE("%s\n", volatile_string);
+    strcpy(volatile_string, "after");
+
+    assert_int_equal(flush_messages(&messages), num_expected);
+    for (message = messages, i = 0; i < num_expected; i++, message += strlen(message) + 1) {
+        assert_string_equal(message, expected[i]);
+    }
+    free(messages);
+
+    // Flushed messages are not flushed again
+    assert_int_equal(flush_messages(&messages), 0);
+    free(messages);
+}
+
+
+static void test_truncated_strings(void **state)
+{
+    char long_string[2 * PYI_DEBUGLOG_RECORD_SIZE];
+    char *messages;
+    size_t length;
+
+    memset(long_string, 'a', sizeof(long_string) - 1);
+    long_string[sizeof(long_string) - 1] = 0;
+
+    PYI_DEBUG("%s|%s|%d\n", long_string, "second", 42);
+
+    assert_int_equal(flush_messages(&messages), 1);
+    length = strlen(messages);
+    assert_true(length < PYI_DEBUGLOG_RECORD_SIZE);
+    assert_memory_equal(messages, long_string, 16);
+    // The first string ends with an ellipsis; the second one does not fit
+    assert_string_equal(messages + length - 12, "a...|...|42\n");
+    free(messages);
+}
+
+
+static PYI_THREAD_PROC_TYPE test_thread_proc(void *arg)
+{
+    int index = (int)(intptr_t)arg;
+    int i;
+
+    for (i = 0; i < TEST_NUM_MESSAGES; i++) {
+        PYI_DEBUG("thread %d message %d\n", index, i);
+    }
+
+    PYI_THREAD_PROC_RETURN;
+}
+
+static void test_threads(void **state)
+{
+    pyi_thread_t threads[TEST_NUM_THREADS];
+    int next_message[TEST_NUM_THREADS];
+    char *messages;
+    char *message;
+    int num_messages;
+    int i;
+
+    for (i = 0; i < TEST_NUM_THREADS; i++) {
+        next_message[i] = 0;
+        assert_int_equal(pyi_thread_create(&threads[i], test_thread_proc, (void *)(intptr_t)i), 0);
+    }
+    for (i = 0; i < TEST_NUM_THREADS; i++) {
+        pyi_thread_join(threads[i]);
+    }
+
+    // The messages of each thread are flushed in order
+    num_messages = flush_messages(&messages);
+    assert_int_equal(num_messages, TEST_NUM_THREADS * TEST_NUM_MESSAGES);
+    for (message = messages, i = 0; i < num_messages; i++, message += strlen(message) + 1) {
+        int index;
+        int number;
+        assert_int_equal(sscanf(message, "thread %d message %d", &index, &number), 2);
+        assert_true(index >= 0 && index < TEST_NUM_THREADS);
+        assert_int_equal(number, next_message[index]);
+        next_message[index]++;
+    }
+    free(messages);
+}
+
+
+static void test_overflow(void **state)
+{
+    char *messages;
+    char *message;
+    char expected[128];
+    int num_messages;
+    int i;
+
+    for (i = 0; i < PYI_DEBUGLOG_RING_CAPACITY + 100; i++) {
+        PYI_DEBUG("message %d\n", i);
+    }
+
+    // The oldest messages are overwritten, and reported as lost; the
+    // last record of the ring is kept free for the next message
+    num_messages = flush_messages(&messages);
+    assert_int_equal(num_messages, PYI_DEBUGLOG_RING_CAPACITY - 1 + 1);
+    assert_string_equal(messages, "message 101\n");
+    for (message = messages, i = 0; i < num_messages - 1; i++) {
+        message += strlen(message) + 1;
+    }
+    snprintf(expected, sizeof(expected), "%d debug message(s) were lost due to full log buffer!\n", 101);
+    assert_non_null(strstr(message, expected));
+    free(messages);
+}
+
+#endif /* defined(LAUNCH_DEBUG) */
+
+
+#if defined(_WIN32)
+int wmain(void)
+#else
+int main(void)
+#endif
+{
+#if defined(LAUNCH_DEBUG)
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_formats),
+        cmocka_unit_test(test_truncated_strings),
+        cmocka_unit_test(test_threads),
+        cmocka_unit_test(test_overflow),
+    };
+    return cmocka_run_group_tests(tests, setup_debuglog, NULL);
+#else
+    // The buffered debug log is available only in debug builds.
+    return 0;
+#endif
+}
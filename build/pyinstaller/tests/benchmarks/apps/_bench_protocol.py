@@ -0,0 +1,71 @@
+# -----------------------------------------------------------------------------
+# Copyright (c) 2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+# -----------------------------------------------------------------------------
+"""
+The side of the launch-latency benchmark protocol that runs in the reference applications. Once an application is
+ready (i.e., it would start responding to its user), it writes a `READY` line to standard output. It then reads
+commands from standard input, one per line:
+
+- `SIZE`: reply with `SIZE <n>`, where `n` is the total size of files in the application's top-level directory (in
+  onefile mode, this is the amount of data that was extracted).
+- `QUIT` (or end of input): exit.
+"""
+
+import os
+import queue
+import sys
+import threading
+
+
+def report_ready():
+    print("READY", flush=True)
+
+
+def top_level_directory_size():
+    size = 0
+    for root, dirs, files in os.walk(getattr(sys, '_MEIPASS', os.path.dirname(os.path.abspath(__file__)))):
+        for name in files:
+            size += os.lstat(os.path.join(root, name)).st_size
+    return size
+
+
+def handle_command(command):
+    """
+    Handle the given command; return False if the application should exit.
+    """
+    if command == 'SIZE':
+        print(f"SIZE {top_level_directory_size()}", flush=True)
+        return True
+    return False
+
+
+def serve():
+    """
+    Handle commands until the application is asked to exit.
+    """
+    for line in sys.stdin:
+        if not handle_command(line.strip()):
+            break
+
+
+def serve_in_background():
+    """
+    Read commands in a background thread; returns the queue into which they are put. The end of input is reported as
+    the `QUIT` command. Used by GUI applications, whose main thread runs the event loop.
+    """
+    commands = queue.Queue()
+
+    def _reader():
+        for line in sys.stdin:
+            commands.put(line.strip())
+        commands.put('QUIT')
+
+    threading.Thread(target=_reader, daemon=True).start()
+    return commands
@@ -0,0 +1,41 @@
+# -----------------------------------------------------------------------------
+# Copyright (c) 2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+# -----------------------------------------------------------------------------
+"""
+Reference application for the launch-latency benchmark: an application that ships many small data files (as, for
+example, translations or templates), and reads all of them during startup. The benchmark collects the files into the
+`bench_data` directory. Reports readiness once all files are read.
+
+See `_bench_protocol.py` for the protocol on standard input/output.
+"""
+
+import os
+import sys
+
+import _bench_protocol
+
+
+def main():
+    data_dir = os.path.join(getattr(sys, '_MEIPASS', os.path.dirname(os.path.abspath(__file__))), 'bench_data')
+
+    total_size = 0
+    for root, dirs, files in os.walk(data_dir):
+        for name in files:
+            with open(os.path.join(root, name), 'rb') as fp:
+                total_size += len(fp.read())
+    if total_size == 0:
+        sys.exit("No data files found!")
+
+    _bench_protocol.report_ready()
+    _bench_protocol.serve()
+
+
+if __name__ == '__main__':
+    main()
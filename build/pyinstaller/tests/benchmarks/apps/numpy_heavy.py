@@ -0,0 +1,35 @@
+# -----------------------------------------------------------------------------
+# Copyright (c) 2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+# -----------------------------------------------------------------------------
+"""
+Reference application for the launch-latency benchmark: a command-line tool dominated by a large binary dependency
+(numpy and its bundled linear-algebra libraries). Reports readiness once numpy is imported and has done a small amount
+of work.
+
+See `_bench_protocol.py` for the protocol on standard input/output.
+"""
+
+import numpy as np
+import numpy.linalg  # noqa: F401
+import numpy.random  # noqa: F401
+
+import _bench_protocol
+
+
+def main():
+    matrix = np.random.default_rng(0).random((64, 64))
+    np.linalg.inv(matrix @ matrix.T + np.eye(64))
+
+    _bench_protocol.report_ready()
+    _bench_protocol.serve()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,74 @@
+# -----------------------------------------------------------------------------
+# Copyright (c) 2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+# -----------------------------------------------------------------------------
+"""
+Reference application for the launch-latency benchmark: a small tkinter terminal (output log, prompt entry, and a
+button), shaped like a typical single-window Tk tool. Reports readiness once the main window is mapped.
+
+See `_bench_protocol.py` for the protocol on standard input/output.
+"""
+
+import queue
+import tkinter as tk
+from tkinter import ttk
+from tkinter.scrolledtext import ScrolledText
+
+import _bench_protocol
+
+
+def main():
+    root = tk.Tk()
+    root.title("Benchmark terminal")
+    root.config(bg="#B6B6B6")
+
+    style = ttk.Style()
+    style.configure("Bench.TLabel", font="{Courier} 10", foreground="#000000", background="#B6B6B6")
+
+    log = ScrolledText(root, state='disabled', background="#B6B6B6", foreground="black", font="{Courier} 10", bd=0)
+    log.pack(fill="both")
+    ttk.Label(root, text="Enter command", style="Bench.TLabel").pack(anchor="w")
+    prompt = tk.Entry(root, font="{Courier} 10", foreground="#000000", background="#949494")
+    prompt.pack(fill="x", expand=5)
+    ttk.Button(prompt, text="Exec", style="Bench.TLabel").pack(anchor='e')
+
+    log["state"] = "normal"
+    log.insert("end", "Benchmark terminal\n" * 20)
+    log["state"] = "disabled"
+
+    # Close the splash screen (if any) before the main window is shown.
+    try:
+        import pyi_splash
+        pyi_splash.close()
+    except ImportError:
+        pass
+
+    root.wait_visibility(root)
+    root.update_idletasks()
+    _bench_protocol.report_ready()
+
+    commands = _bench_protocol.serve_in_background()
+
+    def poll():
+        try:
+            command = commands.get_nowait()
+        except queue.Empty:
+            root.after(5, poll)
+            return
+        if _bench_protocol.handle_command(command):
+            root.after(5, poll)
+        else:
+            root.destroy()
+
+    root.after(5, poll)
+    root.mainloop()
+
+
+if __name__ == '__main__':
+    main()
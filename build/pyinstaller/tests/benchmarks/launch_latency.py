@@ -0,0 +1,414 @@
+# -----------------------------------------------------------------------------
+# Copyright (c) 2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+# -----------------------------------------------------------------------------
+"""
+End-to-end launch-latency benchmark for frozen applications.
+
+The `run` command builds the reference applications from the `apps` directory (in onefile and onedir mode, and, for
+the tkinter application, with and without splash screen), launches each of them repeatedly, and measures:
+
+- startup latency: the time from launching the executable until the application reports that it is ready (for the
+  tkinter application, that its main window is mapped);
+- shutdown latency: the time from asking the application to exit (for the tkinter application, by destroying its main
+  window) until the process exits, which in onefile mode includes the removal of the temporary directory;
+- the size of the application's top-level directory, i.e., the number of bytes extracted in onefile mode.
+
+Each build is launched with warm page cache (after a warm-up launch) and, on Linux, with cold page cache (its files
+are evicted from the page cache before each launch). The results (percentiles of latencies, in milliseconds) are
+written as JSON, and the results obtained with different PyInstaller versions can be compared using the `compare`
+command.
+
+The applications are built with PyInstaller that is importable by the interpreter that is given via the `--python`
+option (by default, the interpreter running this script), which allows comparing PyInstaller versions installed in
+different virtual environments.
+"""
+
+import argparse
+import json
+import os
+import platform
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import zlib
+
+APPS_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'apps')
+
+# Reference applications: script name, module that must be importable by the build interpreter, whether the
+# application is a GUI application (which requires a display, and is also built with a splash screen), and whether
+# the application needs a set of generated data files.
+APPS = {
+    'tk_terminal': dict(script='tk_terminal.py', requires='tkinter', gui=True, data_files=False),
+    'numpy_heavy': dict(script='numpy_heavy.py', requires='numpy', gui=False, data_files=False),
+    'many_files': dict(script='many_files.py', requires=None, gui=False, data_files=True),
+}
+
+MODES = ('onefile', 'onedir')
+
+PERCENTILES = (50, 90, 99)
+
+
+# --- Building -----------------------------------------------------------------
+
+
+def _write_splash_image(filename, width=320, height=160):
+    # Minimal solid-color RGB PNG; written by hand so that the benchmark does not require Pillow.
+    def chunk(tag, data):
+        return struct.pack('>I', len(data)) + tag + data + struct.pack('>I', zlib.crc32(tag + data) & 0xFFFFFFFF)
+
+    row = b'\x00' + b'\x30\x60\x90' * width
+    with open(filename, 'wb') as fp:
+        fp.write(b'\x89PNG\r\n\x1a\n')
+        fp.write(chunk(b'IHDR', struct.pack('>IIBBBBB', width, height, 8, 2, 0, 0, 0)))
+        fp.write(chunk(b'IDAT', zlib.compress(row * height)))
+        fp.write(chunk(b'IEND', b''))
+
+
+def _write_data_files(directory, num_files):
+    # Deterministic contents of varying size (0.5 to 4 KiB), spread over a two-level directory structure.
+    for idx in range(num_files):
+        subdir = os.path.join(directory, f'group{idx % 16:02d}', f'sub{idx % 7}')
+        os.makedirs(subdir, exist_ok=True)
+        size = 512 + (idx * 7919) % 3584
+        with open(os.path.join(subdir, f'file{idx:05d}.txt'), 'wb') as fp:
+            fp.write((f'{idx:05d} lorem ipsum dolor sit amet\n'.encode() * (size // 32 + 1))[:size])
+
+
+def _tree_size(path):
+    if os.path.isfile(path):
+        return os.lstat(path).st_size
+    size = 0
+    for root, dirs, files in os.walk(path):
+        for name in files:
+            size += os.lstat(os.path.join(root, name)).st_size
+    return size
+
+
+def _interpreter_can_import(python, module):
+    return subprocess.run([python, '-c', f'import {module}'], capture_output=True).returncode == 0
+
+
+def _get_pyinstaller_version(python):
+    result = subprocess.run([python, '-c', 'import PyInstaller; print(PyInstaller.__version__)'],
+                            capture_output=True,
+                            text=True)
+    return result.stdout.strip() if result.returncode == 0 else None
+
+
+def build_variant(python, workdir, app_name, mode, splash, num_data_files):
+    """
+    Build the given variant of the reference application; return the path to the executable and the path to the
+    build output (executable in onefile mode, application directory in onedir mode).
+    """
+    app = APPS[app_name]
+    name = f'{app_name}-{mode}' + ('-splash' if splash else '')
+    distpath = os.path.join(workdir, 'dist')
+
+    cmd = [
+        python, '-m', 'PyInstaller', '--noconfirm', '--log-level', 'WARN', '--distpath', distpath, '--workpath',
+        os.path.join(workdir, 'build'), '--specpath', os.path.join(workdir, 'spec'), '--name', name, f'--{mode}',
+        '--paths', APPS_DIR
+    ]
+    # NOTE: the applications are always built in console mode, because the benchmark communicates with them via
+    # standard input and output.
+    if splash:
+        splash_image = os.path.join(workdir, 'splash.png')
+        if not os.path.exists(splash_image):
+            _write_splash_image(splash_image)
+        cmd += ['--splash', splash_image]
+    if app['data_files']:
+        data_dir = os.path.join(workdir, 'bench_data')
+        if not os.path.exists(data_dir):
+            _write_data_files(data_dir, num_data_files)
+        cmd += ['--add-data', f'{data_dir}{os.pathsep}bench_data']
+    cmd.append(os.path.join(APPS_DIR, app['script']))
+
+    subprocess.run(cmd, check=True)
+
+    exe_name = name + ('.exe' if sys.platform == 'win32' else '')
+    if mode == 'onefile':
+        output = os.path.join(distpath, exe_name)
+        executable = output
+    else:
+        output = os.path.join(distpath, name)
+        executable = os.path.join(output, exe_name)
+    return executable, output
+
+
+# --- Launching ----------------------------------------------------------------
+
+
+def _evict_from_page_cache(path):
+    """
+    Evict the files of the given build output from the page cache (Linux only). Only the pages that are not dirty and
+    not mapped by running processes are evicted, which is the case for the files of a finished build after `sync`.
+    """
+    paths = [path] if os.path.isfile(path) else [os.path.join(root, name)
+                                                   for root, dirs, files in os.walk(path)
+                                                   for name in files]
+    for filename in paths:
+        if os.path.islink(filename):
+            continue
+        fd = os.open(filename, os.O_RDONLY)
+        try:
+            os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_DONTNEED)
+        finally:
+            os.close(fd)
+
+
+def _read_reply(proc, prefix):
+    # Skip unrelated output (if any) until the reply with the given prefix.
+    while True:
+        line = proc.stdout.readline()
+        if not line:
+            raise RuntimeError(f"Application exited before replying with {prefix!r}!")
+        if line.startswith(prefix):
+            return line[len(prefix):].strip()
+
+
+def launch(executable, timeout):
+    """
+    Launch the executable once; return startup latency, shutdown latency (both in seconds), and the size of the
+    application's top-level directory (in bytes).
+    """
+    start_time = time.perf_counter()
+    proc = subprocess.Popen([executable],
+                            stdin=subprocess.PIPE,
+                            stdout=subprocess.PIPE,
+                            stderr=subprocess.DEVNULL,
+                            text=True,
+                            bufsize=1)
+    watchdog = threading.Timer(timeout, proc.kill)
+    watchdog.start()
+    try:
+        _read_reply(proc, 'READY')
+        startup = time.perf_counter() - start_time
+
+        proc.stdin.write('SIZE\n')
+        proc.stdin.flush()
+        size = int(_read_reply(proc, 'SIZE '))
+
+        quit_time = time.perf_counter()
+        proc.stdin.write('QUIT\n')
+        proc.stdin.flush()
+        proc.wait()
+        shutdown = time.perf_counter() - quit_time
+    finally:
+        watchdog.cancel()
+        if proc.poll() is None:
+            proc.kill()
+            proc.wait()
+        proc.stdin.close()
+        proc.stdout.close()
+
+    if proc.returncode != 0:
+        raise RuntimeError(f"Application exited with code {proc.returncode}!")
+
+    return startup, shutdown, size
+
+
+def percentile(values, pct):
+    # Linear interpolation between closest ranks.
+    values = sorted(values)
+    position = (len(values) - 1) * pct / 100
+    lower = int(position)
+    upper = min(lower + 1, len(values) - 1)
+    return values[lower] + (values[upper] - values[lower]) * (position - lower)
+
+
+def summarize(values):
+    values_ms = [value * 1000 for value in values]
+    summary = {f'p{pct}': round(percentile(values_ms, pct), 2) for pct in PERCENTILES}
+    summary['min'] = round(min(values_ms), 2)
+    summary['max'] = round(max(values_ms), 2)
+    summary['mean'] = round(sum(values_ms) / len(values_ms), 2)
+    return summary
+
+
+def measure(executable, output, cache, runs, warmup, timeout):
+    if cache == 'warm':
+        for _ in range(warmup):
+            launch(executable, timeout)
+
+    startups = []
+    shutdowns = []
+    sizes = []
+    for _ in range(runs):
+        if cache == 'cold':
+            _evict_from_page_cache(output)
+        startup, shutdown, size = launch(executable, timeout)
+        startups.append(startup)
+        shutdowns.append(shutdown)
+        sizes.append(size)
+
+    return {
+        'startup_ms': summarize(startups),
+        'shutdown_ms': summarize(shutdowns),
+        'top_level_directory_size': sorted(sizes)[len(sizes) // 2],
+    }
+
+
+# --- Commands -----------------------------------------------------------------
+
+
+def run(args):
+    python = args.python
+    version = _get_pyinstaller_version(python)
+    if version is None:
+        sys.exit(f"PyInstaller is not importable by {python}!")
+
+    caches = ['warm']
+    if args.cold and sys.platform.startswith('linux'):
+        caches.append('cold')
+
+    report = {
+        'format_version': 1,
+        'environment': {
+            'pyinstaller_version': version,
+            'python': subprocess.run([python, '-c', 'import sys; print(sys.version)'], capture_output=True,
+                                     text=True).stdout.strip(),
+            'platform': platform.platform(),
+            'machine': platform.machine(),
+            'cpu_count': os.cpu_count(),
+        },
+        'settings': {
+            'runs': args.runs,
+            'warmup': args.warmup,
+            'data_files': args.data_files,
+        },
+        'results': [],
+        'skipped': [],
+    }
+
+    workdir = args.workdir or tempfile.mkdtemp(prefix='pyi-launch-bench-')
+    os.makedirs(workdir, exist_ok=True)
+    try:
+        for app_name in args.apps:
+            app = APPS[app_name]
+            if app['requires'] and not _interpreter_can_import(python, app['requires']):
+                report['skipped'].append({'app': app_name, 'reason': f"{app['requires']} is not available"})
+                continue
+            if app['gui'] and sys.platform.startswith('linux') and not os.environ.get('DISPLAY'):
+                report['skipped'].append({'app': app_name, 'reason': 'no display available'})
+                continue
+
+            # Splash screen is not supported on macOS.
+            splash_options = [False]
+            if app['gui'] and args.splash and sys.platform != 'darwin':
+                splash_options.append(True)
+
+            for mode in args.modes:
+                for splash in splash_options:
+                    print(f"Building {app_name} ({mode}{', splash' if splash else ''})...", file=sys.stderr)
+                    executable, output = build_variant(python, workdir, app_name, mode, splash, args.data_files)
+                    if hasattr(os, 'sync'):
+                        os.sync()  # Make the build's pages clean, so that they can be evicted.
+                    dist_size = _tree_size(output)
+
+                    for cache in caches:
+                        print(f"  launching {args.runs} times ({cache} cache)...", file=sys.stderr)
+                        result = {
+                            'app': app_name,
+                            'mode': mode,
+                            'splash': splash,
+                            'cache': cache,
+                            'dist_size': dist_size,
+                        }
+                        result.update(measure(executable, output, cache, args.runs, args.warmup, args.timeout))
+                        if mode == 'onefile':
+                            result['bytes_extracted'] = result['top_level_directory_size']
+                        report['results'].append(result)
+    finally:
+        if not args.keep and not args.workdir:
+            shutil.rmtree(workdir, ignore_errors=True)
+
+    text = json.dumps(report, indent=2)
+    if args.output:
+        with open(args.output, 'w', encoding='utf-8') as fp:
+            fp.write(text + '\n')
+    else:
+        print(text)
+
+
+def _result_key(result):
+    return result['app'], result['mode'], result['splash'], result['cache']
+
+
+def compare(args):
+    with open(args.baseline, encoding='utf-8') as fp:
+        baseline = json.load(fp)
+    with open(args.current, encoding='utf-8') as fp:
+        current = json.load(fp)
+
+    print(
+        f"baseline: PyInstaller {baseline['environment']['pyinstaller_version']}, "
+        f"current: PyInstaller {current['environment']['pyinstaller_version']}"
+    )
+    baseline_results = {_result_key(result): result for result in baseline['results']}
+
+    header = f"{'variant':<40} {'metric':<16} {'baseline':>10} {'current':>10} {'ratio':>7}"
+    print(header)
+    print('-' * len(header))
+    for result in current['results']:
+        key = _result_key(result)
+        base = baseline_results.get(key)
+        if base is None:
+            continue
+        app, mode, splash, cache = key
+        variant = f"{app} {mode}{' splash' if splash else ''} {cache}"
+        for metric in ('startup_ms', 'shutdown_ms'):
+            for pct in ('p50', 'p90'):
+                old = base[metric][pct]
+                new = result[metric][pct]
+                ratio = f"{new / old:.2f}" if old else '-'
+                print(f"{variant:<40} {metric[:-3] + ' ' + pct:<16} {old:>10.1f} {new:>10.1f} {ratio:>7}")
+        if 'bytes_extracted' in result and 'bytes_extracted' in base:
+            old = base['bytes_extracted']
+            new = result['bytes_extracted']
+            ratio = f"{new / old:.2f}" if old else '-'
+            print(f"{variant:<40} {'bytes extracted':<16} {old:>10} {new:>10} {ratio:>7}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    subparsers = parser.add_subparsers(dest='command', required=True)
+
+    run_parser = subparsers.add_parser('run', help='Build and launch the reference applications.')
+    run_parser.add_argument('--python', default=sys.executable, help='Interpreter used to run PyInstaller.')
+    run_parser.add_argument('--apps', nargs='+', choices=sorted(APPS), default=sorted(APPS), help='Applications.')
+    run_parser.add_argument('--modes', nargs='+', choices=MODES, default=list(MODES), help='Build modes.')
+    run_parser.add_argument('--runs', type=int, default=20, help='Number of measured launches per variant.')
+    run_parser.add_argument('--warmup', type=int, default=2, help='Number of warm-up launches (warm cache only).')
+    run_parser.add_argument('--timeout', type=float, default=120, help='Timeout of a single launch, in seconds.')
+    run_parser.add_argument('--data-files', type=int, default=2000, help='Number of data files in many_files.')
+    run_parser.add_argument('--no-splash', dest='splash', action='store_false', help='Skip splash screen variants.')
+    run_parser.add_argument('--no-cold', dest='cold', action='store_false', help='Skip cold page cache runs.')
+    run_parser.add_argument('--workdir', help='Directory for builds (kept); by default, a temporary directory.')
+    run_parser.add_argument('--keep', action='store_true', help='Keep the temporary build directory.')
+    run_parser.add_argument('--output', '-o', help='Output JSON file; by default, written to standard output.')
+    run_parser.set_defaults(func=run)
+
+    compare_parser = subparsers.add_parser('compare', help='Compare two result files.')
+    compare_parser.add_argument('baseline', help='JSON file with baseline results.')
+    compare_parser.add_argument('current', help='JSON file with current results.')
+    compare_parser.set_defaults(func=compare)
+
+    args = parser.parse_args()
+    if getattr(args, 'runs', 1) < 1:
+        parser.error("--runs must be at least 1")
+    args.func(args)
+
+
+if __name__ == '__main__':
+    main()
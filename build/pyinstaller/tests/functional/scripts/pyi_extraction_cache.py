@@ -0,0 +1,24 @@
+#-----------------------------------------------------------------------------
+# Copyright (c) 2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+#-----------------------------------------------------------------------------
+
+# Check the contents of the data file in the application directory (the extraction cache entry), so that the program
+# fails if it is run from a damaged cache entry.
+
+import os
+import sys
+
+print(f"Application directory: {sys._MEIPASS}")
+
+data_file = os.path.join(sys._MEIPASS, 'data.txt')
+with open(data_file, 'rb') as fp:
+    data = fp.read()
+
+assert data == b'Extraction cache test data.\n', f"Unexpected contents of {data_file}: {data!r}"
@@ -0,0 +1,33 @@
+# -*- mode: python -*-
+#-----------------------------------------------------------------------------
+# Copyright (c) 2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+#-----------------------------------------------------------------------------
+
+# Onefile program that is unpacked into the extraction cache, and validates the files of the existing cache entries
+# against the checksums stored in its archive.
+import os
+
+a = Analysis(
+    [os.path.join(SPECPATH, '..', 'scripts', 'pyi_extraction_cache.py')],
+    datas=[(os.path.join(SPECPATH, '..', 'data', 'extraction_cache', 'data.txt'), '.')],
+)
+pyz = PYZ(a.pure)
+
+exe = EXE(
+    pyz,
+    a.scripts,
+    a.binaries,
+    a.datas,
+    name='pyi_extraction_cache',
+    debug=False,
+    extraction_cache=True,
+    verify_checksums=True,
+    console=True,
+)
@@ -18,6 +18,9 @@
 # If set and different from '0', collect tkinter via hidden import.
 with_tkinter = os.environ.get('_TEST_SPLASH_WITH_TKINTER', '0')
 
+# Splash screen backend; either 'tcltk' (default) or 'native'.
+backend = os.environ.get('_TEST_SPLASH_BACKEND', 'tcltk')
+
 if with_tkinter != '0':
     # Force tkinter collection via hiddenimports; this simulates a program importing tkinter.
     a = Analysis(
@@ -37,6 +40,7 @@
     datas=a.datas,
     text_pos=(10, 50),
     text_color='red',
+    backend=backend,
 )
 
 pyz = PYZ(a.pure, a.zipped_data)
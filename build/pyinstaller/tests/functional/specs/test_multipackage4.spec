@@ -19,6 +19,9 @@
 __testname__ = 'test_multipackage4'
 __testdep__ = 'multipackage4_B'
 
+# If set and different from '0', enable the shared dependency store in the program that references the others.
+shared_dependency_store = os.environ.get('_TEST_MULTIPACKAGE_SHARED_DEPENDENCY_STORE', '0') != '0'
+
 a = Analysis([os.path.join(SCRIPT_DIR, __testname__ + '.py')],
              hookspath=[os.path.join(SPECPATH, SCRIPT_DIR, 'extra-hooks')],
              pathex=['.'])
@@ -37,6 +40,7 @@
           name=os.path.join('build', 'pyi.'+sys.platform, __testname__,
                             __testname__),
           debug=True,
+          shared_dependency_store=shared_dependency_store,
           strip=False,
           upx=True,
           console=1 )
@@ -21,6 +21,9 @@
 __testdep__ = 'multipackage5_B'
 __testdep2__ = 'multipackage5_C'
 
+# If set and different from '0', enable the shared dependency store in the program that references the others.
+shared_dependency_store = os.environ.get('_TEST_MULTIPACKAGE_SHARED_DEPENDENCY_STORE', '0') != '0'
+
 a = Analysis([os.path.join(SCRIPT_DIR, __testname__ + '.py')],
              hookspath=[os.path.join(SPECPATH, SCRIPT_DIR, 'extra-hooks')],
              pathex=['.'])
@@ -44,6 +47,7 @@
           name=os.path.join('build', 'pyi.'+sys.platform, __testname__,
                             __testname__),
           debug=True,
+          shared_dependency_store=shared_dependency_store,
           strip=False,
           upx=True,
           console=1 )
@@ -880,3 +880,45 @@ def test_spec_options(pyi_builder_spec, spec_dir, capsys):
     with pytest.raises(SystemExit) as ex:
         pyi_builder_spec.test_spec(spec_dir / "pyi_spec_options.spec", pyi_args=["--", "--onefile"])
     assert "pyi_spec_options.spec: error: unrecognized arguments: --onefile" in capsys.readouterr().err
+
+
+# Test that the files of an existing extraction cache entry are validated against the checksums stored in the archive,
+# and that a damaged entry is extracted anew.
+def test_extraction_cache_damaged_entry(pyi_builder_spec, spec_dir, monkeypatch, tmp_path):
+    # Keep the extraction cache in the temporary directory of the test.
+    cache_base_dir = tmp_path / 'cache'
+    if is_win:
+        monkeypatch.setenv('LOCALAPPDATA', str(cache_base_dir))
+        cache_root = cache_base_dir / 'pyinstaller'
+    elif is_darwin:
+        monkeypatch.setenv('HOME', str(cache_base_dir))
+        cache_root = cache_base_dir / 'Library' / 'Caches' / 'pyinstaller'
+    else:
+        monkeypatch.setenv('XDG_CACHE_HOME', str(cache_base_dir))
+        cache_root = cache_base_dir / 'pyinstaller'
+
+    # Build the program; the test run populates the cache entry.
+    pyi_builder_spec.test_spec(spec_dir / "pyi_extraction_cache.spec")
+    exe, = pyi_builder_spec._find_executables("pyi_extraction_cache")
+
+    cache_entries = list(cache_root.glob('pyi_extraction_cache-*'))
+    assert len(cache_entries) == 1, f"Expected exactly one extraction cache entry, found: {cache_entries}"
+    data_file = cache_entries[0] / 'data.txt'
+    data = data_file.read_bytes()
+
+    # Damage the cached data file, keeping its size and modification time.
+    stat_result = data_file.stat()
+    data_file.write_bytes(data.swapcase())
+    os.utime(data_file, ns=(stat_result.st_atime_ns, stat_result.st_mtime_ns))
+
+    # Without the validation, the program is run from the damaged entry, and fails.
+    monkeypatch.setenv('PYINSTALLER_VERIFY_CHECKSUMS', '0')
+    p = subprocess.run([exe], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8")
+    assert p.returncode != 0, "Program unexpectedly succeeded when run from the damaged cache entry!"
+
+    # With the validation, the damaged entry is detected, and the program is extracted anew.
+    monkeypatch.delenv('PYINSTALLER_VERIFY_CHECKSUMS')
+    p = subprocess.run([exe], stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="utf-8")
+    assert p.returncode == 0, f"Program failed:\n{p.stdout}\n{p.stderr}"
+    assert "is damaged; extracting the application anew" in p.stderr
+    assert data_file.read_bytes() == data
@@ -11,6 +11,7 @@
 
 import pytest
 
+from PyInstaller.compat import is_darwin, is_win
 from PyInstaller.utils.tests import importorskip
 
 
@@ -31,5 +32,21 @@
         "onedir_and_onefile_depends_on_onedir",
     )
 )
-def test_spec_with_multipackage(pyi_builder_spec, spec_file):
+@pytest.mark.parametrize("shared_dependency_store", [False, True], ids=["extract", "shared-store"])
+def test_spec_with_multipackage(pyi_builder_spec, monkeypatch, tmp_path, spec_file, shared_dependency_store):
+    if shared_dependency_store:
+        monkeypatch.setenv('_TEST_MULTIPACKAGE_SHARED_DEPENDENCY_STORE', '1')
+        # Keep the shared dependency store (which lives in the extraction cache root directory) in the temporary
+        # directory of the test.
+        cache_root = tmp_path / 'cache'
+        monkeypatch.setenv('LOCALAPPDATA' if is_win else 'XDG_CACHE_HOME', str(cache_root))
+
     pyi_builder_spec.test_spec(spec_file)
+
+    # Only the onefile program that references another onefile program extracts the dependencies into the store;
+    # the dependencies referenced from onedir programs are cloned from their directory. On macOS, the extraction
+    # cache root directory is always in user's home directory.
+    if shared_dependency_store and spec_file == "test_multipackage1.spec" and not is_darwin:
+        store_entries = list((cache_root / 'pyinstaller' / 'shared').glob('multipackage1_B-*'))
+        assert len(store_entries) == 1, "Shared dependency store entry was not created!"
+        assert any(path.is_file() for path in store_entries[0].rglob('*')), "Shared dependency store entry is empty!"
@@ -9,85 +9,86 @@
 # SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
 #-----------------------------------------------------------------------------
 
+import platform
 import sys
 import signal
 import subprocess
 
 import pytest
 
+from PyInstaller.compat import is_linux
 from PyInstaller.utils.tests import onefile_only
 
 
-@pytest.mark.darwin
-@pytest.mark.linux
-@pytest.mark.parametrize('forward_signals', [True, False], ids=['forward', 'ignore'])
-@onefile_only
-def test_onefile_signal_handling(pyi_builder, forward_signals):
+# The test program sends the signal given on command-line to its parent process (the parent process of the onefile
+# frozen application), and exits with the signal number as its return code if the signal is forwarded to it.
+_SIGNAL_TEST_PROGRAM = """
+import os
+import sys
+import signal
+import time
+
+# Quietly exit if no signal number is given on command-line. This accommodates the fact that
+# `pyi_builder.test_source()` always runs the program after building it.
+if len(sys.argv) < 3:
+    print(f"Usage: {sys.argv[0]} <signal-number> <timeout>", file=sys.stderr)
+    sys.exit(0)
+
+# Signal number is passed as the first command-line argument
+signal_number = int(sys.argv[1])
+signal_name = signal.Signals(signal_number).name  # This implicitly validates signal number
+
+# Timeout is passed as the second command-line argument
+timeout = float(sys.argv[2])
+
+# Return code: received signal number, or zero if signal was not received.
+return_code = 0
+
+# Install signal handler
+def signal_handler(signum, *args):
+    global return_code
+    return_code = signum  # Set program's return code to signal number
+
+print(f"Installing signal handler for signal={signal_number} ({signal_name})", file=sys.stderr)
+signal.signal(signal_number, signal_handler)
+
+# Send signal to parent process of the onefile frozen application.
+parent_pid = os.getppid()
+print(
+    f"Sending signal={signal_number} ({signal_name}) to parent process with PID={parent_pid}",
+    file=sys.stderr,
+)
+os.kill(parent_pid, signal_number)
+
+# Wait for signal to be delivered or the specified timeout interval to pass.
+start_time = time.time()
+while True:
+    elapsed_time = time.time() - start_time
+    if elapsed_time >= timeout:
+        print(f"Signal not received within {timeout} seconds!", file=sys.stderr)
+        break
+    if return_code != 0:
+        print(f"Signal received! Elapsed time: {elapsed_time:.2f} seconds.", file=sys.stderr)
+        break
+    time.sleep(0.1)  # 100 ms steps
+
+sys.exit(return_code)
+"""
+
+
+def _build_signal_test_program(pyi_builder, pyi_args):
     # Build the test program. The `pyi_builder.test_soruce` also runs the built program, but since no arguments are
     # passed via command-line, this program run is a no-op.
-    pyi_builder.test_source(
-        """
-        import os
-        import sys
-        import signal
-        import time
-
-        # Quietly exit if no signal number is given on command-line. This accommodates the fact that
-        # `pyi_builder.test_source()` always runs the program after building it.
-        if len(sys.argv) < 3:
-            print(f"Usage: {sys.argv[0]} <signal-number> <timeout>", file=sys.stderr)
-            sys.exit(0)
-
-        # Signal number is passed as the first command-line argument
-        signal_number = int(sys.argv[1])
-        signal_name = signal.Signals(signal_number).name  # This implicitly validates signal number
-
-        # Timeout is passed as the second command-line argument
-        timeout = float(sys.argv[2])
-
-        # Return code: received signal number, or zero if signal was not received.
-        return_code = 0
-
-        # Install signal handler
-        def signal_handler(signum, *args):
-            global return_code
-            return_code = signum  # Set program's return code to signal number
-
-        print(f"Installing signal handler for signal={signal_number} ({signal_name})", file=sys.stderr)
-        signal.signal(signal_number, signal_handler)
-
-        # Send signal to parent process of the onefile frozen application.
-        parent_pid = os.getppid()
-        print(
-            f"Sending signal={signal_number} ({signal_name}) to parent process with PID={parent_pid}",
-            file=sys.stderr,
-        )
-        os.kill(parent_pid, signal_number)
-
-        # Wait for signal to be delivered or the specified timeout interval to pass.
-        start_time = time.time()
-        while True:
-            elapsed_time = time.time() - start_time
-            if elapsed_time >= timeout:
-                print(f"Signal not received within {timeout} seconds!", file=sys.stderr)
-                break
-            if return_code != 0:
-                print(f"Signal received! Elapsed time: {elapsed_time:.2f} seconds.", file=sys.stderr)
-                break
-            time.sleep(0.1)  # 100 ms steps
-
-        sys.exit(return_code)
-        """,
-        pyi_args=[] if forward_signals else ['--bootloader-ignore-signals'],
-    )
+    pyi_builder.test_source(_SIGNAL_TEST_PROGRAM, pyi_args=pyi_args)
 
     exes = pyi_builder._find_executables('test_source')
     assert len(exes) == 1
-    program_exe = exes[0]
+    return exes[0]
 
-    # Use the built executable with all applicable signals.
+
+def _run_signal_tests(program_exe, forward_signals, signals):
     failures = []
-    for signal_entry in signal.Signals:
+    for signal_entry in signals:
         signal_name = signal_entry.name
         signal_number = signal_entry.value
 
@@ -126,4 +127,54 @@ def signal_handler(signum, *args):
         if ret_code != expected_code:
             failures.append((signal_name, f"Unexpected exit code: {ret_code} (expected={expected_code})!"))
 
+    return failures
+
+
+@pytest.mark.darwin
+@pytest.mark.linux
+@pytest.mark.parametrize('forward_signals', [True, False], ids=['forward', 'ignore'])
+@onefile_only
+def test_onefile_signal_handling(pyi_builder, forward_signals):
+    program_exe = _build_signal_test_program(
+        pyi_builder,
+        pyi_args=[] if forward_signals else ['--bootloader-ignore-signals'],
+    )
+
+    # Use the built executable with all applicable signals.
+    failures = _run_signal_tests(program_exe, forward_signals, signal.Signals)
+    assert not failures, "Not all signals were handled as expected!"
+
+
+# On Linux (with kernel 5.3 or newer) and in macOS console builds, the onefile parent process waits for the child
+# process in an event loop, and receives the signals via signalfd (Linux) or kqueue (macOS), instead of via signal
+# handlers. Use the debug bootloader to check that the event loop is used, and that the signals are forwarded (or
+# ignored) through it.
+@pytest.mark.darwin
+@pytest.mark.linux
+@pytest.mark.parametrize('forward_signals', [True, False], ids=['forward', 'ignore'])
+@onefile_only
+def test_onefile_signal_handling_event_loop(pyi_builder, forward_signals):
+    if is_linux and tuple(int(part) for part in platform.release().split('.')[:2] if part.isdigit()) < (5, 3):
+        pytest.skip("pidfd_open() requires Linux kernel 5.3 or newer.")
+
+    program_exe = _build_signal_test_program(
+        pyi_builder,
+        pyi_args=['--debug', 'bootloader'] + ([] if forward_signals else ['--bootloader-ignore-signals']),
+    )
+
+    expected_mode = "forwarded to child" if forward_signals else "ignored"
+    status = subprocess.run([program_exe, str(signal.SIGUSR1.value), '5' if forward_signals else '1'],
+                            stderr=subprocess.PIPE,
+                            encoding='utf-8',
+                            errors='replace')
+    print(status.stderr, file=sys.stderr)
+    assert f"waiting for child process using event loop; received signals are {expected_mode}" in status.stderr, \
+        "Bootloader did not use the event loop to wait for the child process!"
+    assert status.returncode == (signal.SIGUSR1.value if forward_signals else 0)
+
+    failures = _run_signal_tests(
+        program_exe,
+        forward_signals,
+        [signal.SIGHUP, signal.SIGINT, signal.SIGTERM, signal.SIGUSR1, signal.SIGUSR2],
+    )
     assert not failures, "Not all signals were handled as expected!"
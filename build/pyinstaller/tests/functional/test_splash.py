@@ -29,13 +29,18 @@
 # Test that splash screen is successfully started. This is an "interactive"
 # test (see test_interactive.py), where we expect the program to run for
 # specified amount of time, before we terminate it.
+#
+# The native backend draws the splash screen in the bootloader; the test program communicates with it over the same
+# IPC protocol as with the Tcl/Tk backend.
 @pytest.mark.parametrize("build_mode", ['onedir', 'onefile'])
 @pytest.mark.parametrize("with_tkinter", [False, True], ids=['notkinter', 'tkinter'])
-def test_splash_screen_running(pyi_builder_spec, capfd, monkeypatch, build_mode, with_tkinter):
+@pytest.mark.parametrize("backend", ['tcltk', 'native'])
+def test_splash_screen_running(pyi_builder_spec, capfd, monkeypatch, build_mode, with_tkinter, backend):
     if build_mode == 'onefile':
         monkeypatch.setenv('_TEST_SPLASH_BUILD_MODE', 'onefile')
     if with_tkinter:
         monkeypatch.setenv('_TEST_SPLASH_WITH_TKINTER', '1')
+    monkeypatch.setenv('_TEST_SPLASH_BACKEND', backend)
 
     pyi_builder_spec.test_spec(
         'spec_with_splash.spec',
@@ -43,7 +48,8 @@ def test_splash_screen_running(pyi_builder_spec, capfd, monkeypatch, build_mode,
     )
 
     out, err = capfd.readouterr()
-    assert 'SPLASH: splash screen started' in err, \
+    expected = 'SPLASH: native splash screen started' if backend == 'native' else 'SPLASH: splash screen started'
+    assert expected in err, \
         f"Cannot find log entry indicating start of splash screen in:\n{err}"
 
 
@@ -0,0 +1,449 @@
+#-----------------------------------------------------------------------------
+# Copyright (c) 2023, PyInstaller Development Team.
+#
+# Distributed under the terms of the GNU General Public License (version 2
+# or later) with exception for distributing the bootloader.
+#
+# The full license is in the file COPYING.txt, distributed with this software.
+#
+# SPDX-License-Identifier: (GPL-2.0-or-later WITH Bootloader-exception)
+#-----------------------------------------------------------------------------
+"""
+Round-trip tests for the archive writers (PyInstaller.archive.writers) and readers (PyInstaller.archive.readers and
+PyInstaller.loader.pyimod01_archive).
+"""
+
+import random
+import struct
+
+import pytest
+
+from PyInstaller.archive.readers import (
+    CArchiveReader, PKG_COMPRESSION_FRAMED, PKG_COMPRESSION_NONE, PKG_COMPRESSION_SOLID, PKG_COMPRESSION_ZLIB,
+    PKG_FRAME_HEADER_FORMAT, PKG_ITEM_SOLID_BLOCK
+)
+from PyInstaller.archive.writers import CArchiveWriter, ZlibArchiveWriter, append_carchive_locator
+from PyInstaller.loader.pyimod01_archive import (
+    PYZ_ITEM_MODULE, PYZ_ITEM_NSPKG, PYZ_ITEM_PKG, ZlibArchiveReader, ZlibArchiveTOC, build_pyz_prefix_tree
+)
+
+# Modules of the test PYZ archive: name -> source code, or None for namespace package. The names include non-ASCII ones,
+# whose UTF-8 encodings have different lengths, and are listed out of order.
+PYZ_MODULES = {
+    'mod_a': 'value = "a"',
+    'mod_ab': 'value = "ab"',
+    'pkg': 'value = "pkg"',
+    'pkg.sub': 'value = "pkg.sub"',
+    'nspkg': None,
+    'nspkg.mod': 'value = "nspkg.mod"',
+    'mod_é': 'value = "e-acute"',
+    'mod_￠': 'value = "fullwidth-cent"',
+    'mod_\U0001f600': 'value = "emoji"',
+    'zzz': 'value = "zzz"',
+}
+
+
+def _write_pyz(tmp_path, modules=PYZ_MODULES, **kwargs):
+    """
+    Write the PYZ archive with the given modules, and return its filename.
+    """
+    entries = []
+    code_dict = {}
+    for name, source in modules.items():
+        if source is None:
+            entries.append((name, '-', 'PYMODULE'))
+            continue
+        # The writer recognizes packages by the basename of their source file.
+        src_path = tmp_path / 'src' / name.replace('.', '_')
+        if any(other.startswith(name + '.') for other in modules):
+            src_path = src_path / '__init__.py'
+        else:
+            src_path = src_path.with_suffix('.py')
+        src_path.parent.mkdir(parents=True, exist_ok=True)
+        src_path.write_text(source, encoding='utf-8')
+        entries.append((name, str(src_path), 'PYMODULE'))
+        code_dict[name] = compile(source, str(src_path), 'exec')
+
+    pyz_filename = str(tmp_path / 'test.pyz')
+    ZlibArchiveWriter(pyz_filename, entries, code_dict=code_dict, **kwargs)
+    return pyz_filename
+
+
+def _open_pyz(pyz_filename, backing):
+    """
+    Open the PYZ archive either from the file, or from a memoryview of its data (the way the bootloader provides it).
+    """
+    if backing == 'file':
+        return ZlibArchiveReader(pyz_filename)
+    with open(pyz_filename, 'rb') as fp:
+        return ZlibArchiveReader(pyz_filename, data=memoryview(fp.read()))
+
+
+def _run_module(code_object):
+    namespace = {}
+    exec(code_object, namespace)
+    return namespace['value']
+
+
+@pytest.mark.parametrize('backing', ['file', 'memoryview'])
+def test_pyz_roundtrip(tmp_path, backing):
+    reader = _open_pyz(_write_pyz(tmp_path), backing)
+
+    # Version 2 archive has sorted binary TOC (searched in place).
+    assert isinstance(reader.toc, ZlibArchiveTOC)
+    assert len(reader.toc) == len(PYZ_MODULES)
+    assert list(reader.toc.keys()) == sorted(PYZ_MODULES, key=lambda name: name.encode('utf-8'))
+
+    for name, source in PYZ_MODULES.items():
+        typecode, _, _ = reader.toc[name]
+        if source is None:
+            assert typecode == PYZ_ITEM_NSPKG
+            assert reader.extract(name) is None
+            continue
+        assert typecode == (PYZ_ITEM_PKG if name == 'pkg' else PYZ_ITEM_MODULE)
+        assert name in reader.toc
+        assert _run_module(reader.extract(name)) == _run_module(compile(source, name, 'exec'))
+
+
+@pytest.mark.parametrize('backing', ['file', 'memoryview'])
+def test_pyz_missing_names(tmp_path, backing):
+    reader = _open_pyz(_write_pyz(tmp_path), backing)
+
+    # Names that sort before, between, and after the existing entries, prefixes of existing names, and names that
+    # cannot be encoded (lone surrogate) or are not strings at all.
+    missing_names = ['', 'a', 'mod_', 'mod_aa', 'mod_b', 'pkg.', 'pkg.sub.x', 'zzzz', '\U0010ffff', '\udc80', None, 42]
+    for name in missing_names:
+        assert name not in reader.toc
+        assert reader.toc.get(name) is None
+        assert reader.toc.get(name, 'default') == 'default'
+        with pytest.raises(KeyError):
+            reader.toc[name]
+        with pytest.raises(KeyError):
+            reader.extract(name)
+
+
+@pytest.mark.parametrize('backing', ['file', 'memoryview'])
+def test_pyz_prefix_tree(tmp_path, backing):
+    reader = _open_pyz(_write_pyz(tmp_path), backing)
+
+    expected_tree = build_pyz_prefix_tree((name, typecode) for name, (typecode, _, _) in reader.toc.items())
+    assert reader.load_prefix_tree() == expected_tree
+    assert expected_tree['pkg'] == {'sub': ''}
+    assert expected_tree['nspkg'] == {'mod': ''}
+
+
+@pytest.mark.parametrize('backing', ['file', 'memoryview'])
+def test_pyz_empty(tmp_path, backing):
+    reader = _open_pyz(_write_pyz(tmp_path, modules={}), backing)
+
+    assert len(reader.toc) == 0
+    assert list(reader.toc.items()) == []
+    assert 'mod_a' not in reader.toc
+    assert reader.load_prefix_tree() == {}
+
+
+def test_pyz_offset_in_filename(tmp_path):
+    # The archive embedded in another file is opened with its offset appended to the filename.
+    pyz_filename = _write_pyz(tmp_path)
+    embedded_filename = tmp_path / 'embedded.bin'
+    with open(pyz_filename, 'rb') as fp:
+        embedded_filename.write_bytes(b'\0' * 1234 + fp.read())
+
+    reader = ZlibArchiveReader(f'{embedded_filename}?1234')
+    assert _run_module(reader.extract('pkg.sub')) == 'pkg.sub'
+    assert 'missing' not in reader.toc
+
+
+# Entries of the test PKG archive: dest_name -> (data, compress, typecode).
+PKG_FILES = {
+    'data/small.txt': (b'small file\n', True, 'x'),
+    'data/empty.txt': (b'', True, 'x'),
+    'data/uncompressed.bin': (random.Random(1).randbytes(10000), False, 'x'),
+    'data/n\u00e4me-\U0001f600.txt': ('non-ASCII name\n'.encode('utf-8'), True, 'x'),
+    'lib/binary.so': (random.Random(2).randbytes(50000), True, 'b'),
+    'data/compressible.txt': (b'compressible data\n' * 10000, True, 'x'),
+}
+
+PKG_OPTIONS = ['pyi-runtime-option-a', 'pyi-runtime-option-b']
+
+
+def _write_pkg(tmp_path, files=PKG_FILES, options=PKG_OPTIONS, name='test.pkg', **kwargs):
+    """
+    Write the PKG archive with the given files and OPTION entries, and return its filename.
+    """
+    entries = []
+    for idx, (dest_name, (data, compress, typecode)) in enumerate(files.items()):
+        src_path = tmp_path / 'src' / f'file{idx}'
+        src_path.parent.mkdir(parents=True, exist_ok=True)
+        src_path.write_bytes(data)
+        entries.append((dest_name, str(src_path), compress, typecode))
+    entries += [(option, '', False, 'o') for option in options]
+
+    pkg_filename = str(tmp_path / name)
+    CArchiveWriter(pkg_filename, entries, 'libpython3.so', **kwargs)
+    return pkg_filename
+
+
+def _embed_pkg(tmp_path, pkg_filename, locator):
+    """
+    Append the PKG archive to a fake executable, optionally followed by the locator footer; return its filename.
+    """
+    executable_filename = tmp_path / 'executable'
+    with open(pkg_filename, 'rb') as fp:
+        executable_filename.write_bytes(b'\x7fELF' + random.Random(3).randbytes(20000) + fp.read())
+    if locator:
+        append_carchive_locator(str(executable_filename))
+    return str(executable_filename)
+
+
+def _check_pkg_contents(reader, files=PKG_FILES, options=PKG_OPTIONS):
+    assert reader.options == options
+    for dest_name, (data, compress, typecode) in files.items():
+        _, _, uncompressed_length, compression_flag, entry_typecode = reader.toc[dest_name]
+        assert entry_typecode == typecode
+        assert uncompressed_length == len(data)
+        assert compression_flag == (PKG_COMPRESSION_ZLIB if compress else PKG_COMPRESSION_NONE)
+        assert reader.extract(dest_name) == data
+
+
+@pytest.mark.parametrize('format_version', [None, 1, 2])
+def test_pkg_roundtrip(tmp_path, format_version):
+    reader = CArchiveReader(_write_pkg(tmp_path, format_version=format_version))
+
+    # Small archives are written in format version 1, unless version 2 is requested.
+    assert reader.format_version == (format_version or 1)
+    assert set(reader.toc) == set(PKG_FILES)
+    _check_pkg_contents(reader)
+
+
+@pytest.mark.parametrize('format_version', [1, 2])
+def test_pkg_missing_names(tmp_path, format_version):
+    reader = CArchiveReader(_write_pkg(tmp_path, format_version=format_version))
+
+    # OPTION entries are not part of the TOC dictionary.
+    for name in ['missing', 'data', 'data/', 'data/small.tx', 'data/small.txt2', PKG_OPTIONS[0]]:
+        assert name not in reader.toc
+        with pytest.raises(KeyError):
+            reader.extract(name)
+        with pytest.raises(KeyError):
+            reader.open_embedded_archive(name)
+
+
+@pytest.mark.parametrize('format_version', [1, 2])
+def test_pkg_empty(tmp_path, format_version):
+    reader = CArchiveReader(_write_pkg(tmp_path, files={}, options=[], format_version=format_version))
+
+    assert reader.format_version == format_version
+    assert reader.toc == {}
+    assert reader.options == []
+
+
+def test_pkg_unsupported_format_version(tmp_path):
+    with pytest.raises(ValueError, match="Unsupported archive format version"):
+        _write_pkg(tmp_path, format_version=3)
+
+
+@pytest.mark.parametrize('locator', [False, True], ids=['scan', 'locator'])
+@pytest.mark.parametrize('format_version', [1, 2])
+def test_pkg_embedded_in_executable(tmp_path, format_version, locator):
+    pkg_filename = _write_pkg(tmp_path, format_version=format_version)
+    executable_filename = _embed_pkg(tmp_path, pkg_filename, locator)
+
+    # With the locator footer, the cookie is found without scanning for its magic pattern.
+    with open(executable_filename, 'rb') as fp:
+        cookie_offset = CArchiveReader._find_magic_pattern(fp, CArchiveReader._COOKIE_MAGIC_PATTERN)
+        assert CArchiveReader._read_locator(fp) == (cookie_offset if locator else -1)
+
+    reader = CArchiveReader(executable_filename)
+    assert reader.format_version == format_version
+    _check_pkg_contents(reader)
+    with open(pkg_filename, 'rb') as fp:
+        assert reader.raw_pkg_data() == fp.read()
+
+
+@pytest.mark.parametrize('format_version', [1, 2])
+def test_pkg_damaged_locator(tmp_path, format_version):
+    executable_filename = _embed_pkg(tmp_path, _write_pkg(tmp_path, format_version=format_version), True)
+
+    # Damage the checksum of the locator; the reader falls back to scanning for the cookie.
+    with open(executable_filename, 'r+b') as fp:
+        fp.seek(-1, 2)
+        last_byte = fp.read(1)
+        fp.seek(-1, 2)
+        fp.write(bytes([last_byte[0] ^ 0xFF]))
+    with open(executable_filename, 'rb') as fp:
+        assert CArchiveReader._read_locator(fp) == -1
+
+    _check_pkg_contents(CArchiveReader(executable_filename))
+
+
+@pytest.mark.parametrize('format_version', [1, 2])
+def test_pkg_embedded_pyz(tmp_path, format_version):
+    # The PYZ archive stored in the PKG is opened at its offset within the PKG (and the executable).
+    pyz_filename = _write_pyz(tmp_path)
+    with open(pyz_filename, 'rb') as fp:
+        files = {**PKG_FILES, 'PYZ.pyz': (fp.read(), False, 'z')}
+    pkg_filename = _write_pkg(tmp_path, files=files, format_version=format_version)
+    reader = CArchiveReader(_embed_pkg(tmp_path, pkg_filename, True))
+
+    pyz_reader = reader.open_embedded_archive('PYZ.pyz')
+    assert isinstance(pyz_reader.toc, ZlibArchiveTOC)
+    assert _run_module(pyz_reader.extract('mod_\U0001f600')) == 'emoji'
+    assert 'missing' not in pyz_reader.toc
+
+
+# Entries for the solid block tests; small compressed DATA entries are interleaved with the ineligible ones (large,
+# uncompressed, and BINARY entries), which split the runs of eligible entries.
+SOLID_FILES = {
+    **{f'data/run1/file{idx}.txt': (f'file {idx} of the first run\n'.encode() * 10, True, 'x') for idx in range(10)},
+    'data/large.bin': (random.Random(4).randbytes(100 * 1024), True, 'x'),
+    **{f'data/run2/file{idx}.txt': (f'file {idx} of the second run\n'.encode() * 10, True, 'x') for idx in range(3)},
+    'data/uncompressed.txt': (b'uncompressed\n', False, 'x'),
+    'data/lone.txt': (b'lone eligible entry\n', True, 'x'),
+    'lib/binary.so': (b'small binary\n', True, 'b'),
+    'data/empty.txt': (b'', True, 'x'),
+}
+
+
+def _get_solid_blocks(reader):
+    # Map the data offsets of solid blocks to their names.
+    return {entry[0]: name for name, entry in reader.toc.items() if entry[4] == PKG_ITEM_SOLID_BLOCK}
+
+
+@pytest.mark.parametrize('format_version', [1, 2])
+def test_pkg_solid_blocks(tmp_path, format_version):
+    pkg_filename = _write_pkg(tmp_path, files=SOLID_FILES, format_version=format_version, solid_block_size=1000)
+    reader = CArchiveReader(pkg_filename)
+    solid_blocks = _get_solid_blocks(reader)
+
+    # The first run spans several blocks, so that the entries of each block add up to (at least) the block size.
+    members = {}
+    for dest_name, (data, compress, typecode) in SOLID_FILES.items():
+        entry_offset, member_offset, member_length, compression_flag, entry_typecode = reader.toc[dest_name]
+        assert entry_typecode == typecode
+        assert reader.extract(dest_name) == data
+        if compression_flag == PKG_COMPRESSION_SOLID:
+            assert member_length == len(data)
+            members.setdefault(solid_blocks[entry_offset], []).append((member_offset, dest_name))
+
+    # Large, uncompressed, BINARY and lone entries are not placed into solid blocks.
+    assert set(SOLID_FILES) - {dest_name for block_members in members.values() for _, dest_name in block_members} == {
+        'data/large.bin', 'data/uncompressed.txt', 'data/lone.txt', 'lib/binary.so', 'data/empty.txt'
+    }
+    assert len(solid_blocks) == len(members) == 3
+
+    # The decompressed data of the block is the concatenation of its members' data.
+    for block_name, block_members in members.items():
+        block_data = b''.join(SOLID_FILES[dest_name][0] for _, dest_name in sorted(block_members))
+        assert sorted(block_members)[0][0] == 0
+        assert reader.extract(block_name) == block_data
+        assert reader.toc[block_name][2] == len(block_data)
+        if block_name != max(members):
+            assert len(block_data) >= 1000
+
+
+def test_pkg_solid_blocks_disabled(tmp_path):
+    reader = CArchiveReader(_write_pkg(tmp_path, files=SOLID_FILES))
+
+    assert _get_solid_blocks(reader) == {}
+    assert all(reader.toc[dest_name][3] != PKG_COMPRESSION_SOLID for dest_name in SOLID_FILES)
+
+
+@pytest.mark.parametrize('format_version', [1, 2])
+def test_pkg_solid_blocks_missing_names(tmp_path, format_version):
+    pkg_filename = _write_pkg(tmp_path, files=SOLID_FILES, format_version=format_version, solid_block_size=1000)
+    reader = CArchiveReader(pkg_filename)
+
+    for name in ['missing', 'data/run1', 'data/run1/file1', 'data/run1/file10.txt', 'pyi-solid-block-3']:
+        assert name not in reader.toc
+        with pytest.raises(KeyError):
+            reader.extract(name)
+
+
+FRAME_SIZE = 4096
+
+# Data of the framed entry; ten full frames of partly compressible data, and a short last frame.
+FRAMED_DATA = b''.join(
+    random.Random(idx).randbytes(FRAME_SIZE // 2) + bytes([idx]) * (FRAME_SIZE // 2) for idx in range(10)
+) + b'short last frame'
+
+FRAMED_FILES = {
+    'data/framed.bin': (FRAMED_DATA, True, 'x'),
+    'data/frame-sized.bin': (FRAMED_DATA[:FRAME_SIZE], True, 'x'),
+    'data/uncompressed.bin': (FRAMED_DATA, False, 'x'),
+    'lib/binary.so': (FRAMED_DATA, True, 'b'),
+}
+
+
+def _write_framed_pkg(tmp_path, monkeypatch, streaming=False, **kwargs):
+    # With streaming enabled, the framed entries are compressed in chunks (that do not align with the frames) into a
+    # temporary file, same as large files.
+    if streaming:
+        monkeypatch.setattr(CArchiveWriter, '_STREAMING_THRESHOLD', FRAME_SIZE)
+        monkeypatch.setattr(CArchiveWriter, '_STREAMING_CHUNK_SIZE', 1000)
+    return CArchiveReader(_write_pkg(tmp_path, files=FRAMED_FILES, frame_size=FRAME_SIZE, **kwargs))
+
+
+@pytest.mark.parametrize('streaming', [False, True], ids=['in-memory', 'streaming'])
+@pytest.mark.parametrize('format_version', [1, 2])
+def test_pkg_framed_roundtrip(tmp_path, monkeypatch, format_version, streaming):
+    reader = _write_framed_pkg(tmp_path, monkeypatch, streaming, format_version=format_version)
+
+    # Only the compressed DATA entries that are larger than the frame size are framed.
+    assert reader.toc['data/framed.bin'][3] == PKG_COMPRESSION_FRAMED
+    assert reader.toc['data/frame-sized.bin'][3] == PKG_COMPRESSION_ZLIB
+    assert reader.toc['data/uncompressed.bin'][3] == PKG_COMPRESSION_NONE
+    assert reader.toc['lib/binary.so'][3] == PKG_COMPRESSION_ZLIB
+    for dest_name, (data, _, _) in FRAMED_FILES.items():
+        assert reader.toc[dest_name][2] == len(data)
+        assert reader.extract(dest_name) == data
+
+    # The frame header and the frame index are stored at the start of the entry's data.
+    entry_offset, data_length, *_ = reader.toc['data/framed.bin']
+    data = reader.raw_pkg_data()[entry_offset:(entry_offset + data_length)]
+    frame_size, num_frames, frame_compression_flag = struct.unpack_from(PKG_FRAME_HEADER_FORMAT, data)
+    assert (frame_size, num_frames, frame_compression_flag) == (FRAME_SIZE, 11, PKG_COMPRESSION_ZLIB)
+    offsets = struct.unpack_from(f'<{num_frames + 1}Q', data, struct.calcsize(PKG_FRAME_HEADER_FORMAT))
+    assert offsets[0] == struct.calcsize(PKG_FRAME_HEADER_FORMAT) + (num_frames + 1) * 8
+    assert offsets[-1] == data_length
+    assert list(offsets) == sorted(offsets)
+
+
+@pytest.mark.parametrize(
+    'offset,length',
+    [
+        (0, 0),  # Zero-length read
+        (3 * FRAME_SIZE, 0),  # Zero-length read at the frame boundary
+        (len(FRAMED_DATA), 0),  # Zero-length read at the end of data
+        (0, FRAME_SIZE),  # First frame
+        (FRAME_SIZE, FRAME_SIZE),  # Second frame, exactly
+        (FRAME_SIZE - 1, 2),  # Last byte of the first frame and the first byte of the second one
+        (FRAME_SIZE + 1, FRAME_SIZE - 2),  # Within the second frame
+        (100, 5 * FRAME_SIZE),  # Spanning several frames
+        (10 * FRAME_SIZE, len(FRAMED_DATA) - 10 * FRAME_SIZE),  # Last, short frame
+        (10 * FRAME_SIZE - 1, 2),  # Last byte of the last full frame and the first byte of the short one
+        (len(FRAMED_DATA) - 1, 1),  # Last byte
+        (0, len(FRAMED_DATA)),  # Complete data
+    ],
+)
+@pytest.mark.parametrize('dest_name', ['data/framed.bin', 'data/uncompressed.bin'])
+def test_pkg_framed_range_reads(tmp_path, monkeypatch, dest_name, offset, length):
+    reader = _write_framed_pkg(tmp_path, monkeypatch)
+
+    assert reader.extract_range(dest_name, offset, length) == FRAMED_DATA[offset:(offset + length)]
+
+
+def test_pkg_framed_range_reads_out_of_bounds(tmp_path, monkeypatch):
+    reader = _write_framed_pkg(tmp_path, monkeypatch)
+
+    for offset, length in [(len(FRAMED_DATA), 1), (len(FRAMED_DATA) - 1, 2), (0, len(FRAMED_DATA) + 1), (-1, 1)]:
+        with pytest.raises(ValueError, match="Requested range exceeds the data"):
+            reader.extract_range('data/framed.bin', offset, length)
+    with pytest.raises(KeyError):
+        reader.extract_range('data/framed', 0, 0)
+
+
+@pytest.mark.parametrize('frame_size', [0, -1, CArchiveWriter._FRAME_SIZE_MAX + 1])
+def test_pkg_invalid_frame_size(tmp_path, frame_size):
+    with pytest.raises(ValueError, match="Frame size must be between"):
+        _write_pkg(tmp_path, frame_size=frame_size)
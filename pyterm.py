@@ -1,3 +1,6 @@
+import ctypes
+import queue
+import threading
 import tkinter as tk
 from tkinter import ttk
 from tkinter import messagebox
@@ -9,22 +12,68 @@ class Files:
 
     icon_ico = base_dir / "icon.ico"
 
+# commands run on a worker thread, so everything that touches the widgets
+# is queued here and done by the Tk loop (see drain_ui_queue); text for the
+# log is queued as str, everything else as a function
+ui_queue = queue.Queue()
+
+# number of lines kept in the log (see PyTerm.scrollback)
+scrollback_lines = 5000
+
+def on_ui(func):
+    ui_queue.put(func)
+
+def write_log(text):
+    ui_queue.put(text)
+
+def flush_log(pending):
+    # all the text queued since the last tick goes in with a single insert,
+    # and the lines over the scrollback limit are trimmed at once
+    if not pending:
+        return
+    text = "".join(pending)
+    pending.clear()
+    lines = text.splitlines(keepends=True)
+    if len(lines) > scrollback_lines:
+        text = "".join(lines[-scrollback_lines:])
+
+    log["state"] = "normal"
+    log.insert("end", text)
+    excess = int(log.index("end-1c").split(".")[0]) - 1 - scrollback_lines
+    if excess > 0:
+        log.delete("1.0", f"{excess + 1}.0")
+    log["state"] = "disabled"
+
+def drain_ui_queue():
+    pending = []
+    while True:
+        try:
+            item = ui_queue.get_nowait()
+        except queue.Empty:
+            break
+        if isinstance(item, str):
+            pending.append(item)
+        else:
+            flush_log(pending)
+            item()
+    flush_log(pending)
+    root.after(50, drain_ui_queue)
+
 class output:
     def oerror(self):
-        log["state"] = "normal"
-        log.insert("end", f"Error: {self}\n")
-        log["state"] = "disabled"
+        write_log(f"Error: {self}\n")
 
     def oprint(self):
-        log["state"] = "normal"
-        log.insert("end", f"{self}\n")
-        log["state"] = "disabled"
+        write_log(f"{self}\n")
     
+
 class PyTerm:
     commands = (
         "PyTerm.commandlist() - shows a command list\n"
         "PyTerm.help()- help\n"
         "PyTerm.clear() - clear screen\n"
+        "PyTerm.scrollback(lines) - sets how many lines the output screen keeps\n"
+        "Esc or Stop button - interrupt the running command\n"
         "PyTerm.outputfont(font) - changes output screen bg color #example: PyTerm.outputfont('{Arial} 14 bold')\n"
         "outputbackground(self)\n"
         "outputbackground(color)\n")
@@ -35,16 +84,33 @@ class PyTerm:
         output.oprint(PyTerm.commands)
     
     def clear():
-        log.delete("1.0")
+        def clear_log():
+            log["state"] = "normal"
+            log.delete("1.0", "end")
+            log["state"] = "disabled"
+        on_ui(clear_log)
     
     def outputfont(self):
+        def change_font():
+            try:
+                log["font"] = self
+                write_log(f"font changed to {self}\n")
+            except Exception as exc:
+                write_log(f"Error: {exc}\n")
+        on_ui(change_font)
+    def scrollback(self):
+        global scrollback_lines
         try:
-            log["font"] = self
-            output.oprint(f"font changed to {self}")
+            lines = int(self)
+            if lines < 1:
+                raise ValueError("scrollback must be at least 1 line")
         except Exception as exc:
             output.oerror(exc)
+            return
+        scrollback_lines = lines
+        output.oprint(f"scrollback set to {lines} lines")
     def outputbackground(self):
-        log["background"] = self
+        on_ui(lambda: log.configure(background=self))
     
     def execute(self):
         try:
@@ -55,19 +121,49 @@ class PyTerm:
         except Exception as exc:
             return exc
     
-def execute_promt(event):
-    command = promt.get()
+class Worker:
+    thread = None
 
-    log["state"] = "normal"
-    log.insert("end", f"{command}\n")
-    log["state"] = "disabled"
-    try:
-        result = eval(command)
-        if result:
-            output.oprint("result:"+command)
+    def run(command):
+        try:
+            # compiled first, so that tracebacks show <pyterm> as the filename
+            result = eval(compile(command, "<pyterm>", "eval"))
+            if result:
+                output.oprint(f"result: {result}")
+        except KeyboardInterrupt:
+            output.oerror("command interrupted")
+        except Exception as exc:
+            output.oerror(exc)
 
-    except Exception as exc:
-        output.oerror(exc)
+    def busy():
+        return Worker.thread is not None and Worker.thread.is_alive()
+
+    def start(command):
+        Worker.thread = threading.Thread(target=Worker.run, args=(command,), daemon=True)
+        Worker.thread.start()
+
+    def interrupt(event=None):
+        if not Worker.busy():
+            return
+        # raises KeyboardInterrupt in the worker thread once it gets back to
+        # python code; a blocking call (e.g. time.sleep) has to return first
+        ident = ctypes.c_ulong(Worker.thread.ident)
+        affected = ctypes.pythonapi.PyThreadState_SetAsyncExc(ident, ctypes.py_object(KeyboardInterrupt))
+        if affected == 0:
+            write_log("Error: could not interrupt the command, its thread was not found\n")
+        elif affected > 1:
+            # more than one thread got the exception; undo it
+            ctypes.pythonapi.PyThreadState_SetAsyncExc(ident, None)
+            write_log("Error: could not interrupt the command\n")
+
+def execute_promt(event=None):
+    command = promt.get()
+
+    write_log(f"{command}\n")
+    if Worker.busy():
+        write_log("Error: previous command is still running, press Esc to interrupt it\n")
+        return
+    Worker.start(command)
 
 
 root = tk.Tk()
@@ -80,6 +176,7 @@ root.config(bg="#B6B6B6")
 
 #binds
 root.bind('<Return>', execute_promt)
+root.bind('<Escape>', Worker.interrupt)
 
 
 label_style = ttk.Style()
@@ -99,7 +196,11 @@ promt = tk.Entry(font="{Cascadia Code} 10",foreground="#000000", background="#94
 promt.pack(fill="x", expand=5)
 
 execbttn = ttk.Button(promt, text="Exec",command=execute_promt, style="My.TLabel", cursor="hand2")
-execbttn.pack(anchor='e')
+execbttn.pack(side="right")
+
+stopbttn = ttk.Button(promt, text="Stop",command=Worker.interrupt, style="My.TLabel", cursor="hand2")
+stopbttn.pack(side="right")
 
 PyTerm.help()
+drain_ui_queue()
 root.mainloop()
\ No newline at end of file